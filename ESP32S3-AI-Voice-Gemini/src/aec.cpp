@@ -0,0 +1,219 @@
+// src/aec.cpp - Two-path NLMS acoustic echo canceller
+
+#include "aec.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AEC_MAX_TAPS        2048
+#define AEC_REG_LEVEL       64.0f   // Reference level below which the step shrinks (~-54 dBFS)
+#define AEC_COPY_RATIO      0.7f    // Background error must be this far below the foreground's
+#define AEC_COPY_BLOCKS     2       // ... for this many blocks in a row
+#define AEC_COPY_MAX_ERR    0.0625f // ... and below the mic by 12 dB, which near-end speech prevents
+#define AEC_RESET_RATIO     4.0f    // Background error this far above the foreground's: diverged
+#define AEC_ERLE_SMOOTH     0.05f   // Per block
+#define AEC_LEAK_SMOOTH     0.02f   // Per block, for the residual echo estimate
+#define AEC_MIN_STEP        0.01f   // Fraction of the step kept during double talk
+#define AEC_CONVERGED_DB10  60
+
+struct aec {
+    aec_config_t cfg;
+    uint16_t taps;
+    uint16_t pos;               // Next write index in the history
+    float mu;                   // Largest step size
+    float step;                 // Step size for the current block
+    float delta;                // Regularisation of the NLMS normalisation
+    float *hist;                // Reference history, stored twice so the window is contiguous
+    float *fg;                  // Foreground coefficients, oldest sample first
+    float *bg;                  // Background coefficients
+    float power;                // Sum of squares over the window
+    uint32_t silent;            // Consecutive zero reference samples
+    uint16_t in_block;
+    uint8_t better_blocks;
+    bool adapted;               // Foreground has taken over a filter since the reset
+    float block_ref, block_mic, block_fg, block_bg, block_echo, block_cross;
+    float cov, var;             // Smoothed error x echo and echo x echo, for the leak
+    float smooth_mic, smooth_err;
+    aec_stats_t stats;
+};
+
+static int16_t sat16f(float v) {
+    if (v >= 32767.0f) return INT16_MAX;
+    if (v <= -32768.0f) return INT16_MIN;
+    return (int16_t)lrintf(v);
+}
+
+// Step size for the next block. The residual echo is estimated from the
+// correlation of the foreground error with its echo estimate (the leak):
+// near-end speech adds error that is uncorrelated with the echo, and the
+// step shrinks with the share of error that is not residual echo. The
+// foreground is used because it does not adapt to the near end itself.
+// Until it has adapted, the full step is used.
+static void update_step(aec_t *a) {
+    a->cov += AEC_LEAK_SMOOTH * (a->block_cross - a->cov);
+    a->var += AEC_LEAK_SMOOTH * (a->block_echo - a->var);
+
+    if (!a->adapted) {
+        a->step = a->mu;
+        return;
+    }
+    float leak = a->var > 0 ? fabsf(a->cov) / a->var : 0;
+    if (leak > 1) leak = 1;
+    float ratio = a->block_fg > 0 ? leak * a->block_echo / a->block_fg : 1;
+    if (ratio > 1) ratio = 1;
+    if (ratio < AEC_MIN_STEP) ratio = AEC_MIN_STEP;
+    a->step = a->mu * ratio;
+}
+
+// Foreground/background bookkeeping once per block
+static void end_block(aec_t *a) {
+    const uint16_t L = a->taps;
+
+    // Exact window power, so rounding in the running sum cannot build up
+    const float *win = a->hist + a->pos;
+    float p = 0;
+    for (uint16_t j = 0; j < L; j++) p += win[j] * win[j];
+    a->power = p;
+
+    if (a->block_ref > 0) {
+        update_step(a);
+        if (a->block_bg < AEC_COPY_RATIO * a->block_fg && a->block_bg < AEC_COPY_MAX_ERR * a->block_mic) {
+            if (++a->better_blocks >= AEC_COPY_BLOCKS) {
+                memcpy(a->fg, a->bg, L * sizeof(float));
+                a->adapted = true;
+                a->better_blocks = 0;
+                a->stats.copies++;
+            }
+        } else {
+            a->better_blocks = 0;
+            if (a->block_bg > AEC_RESET_RATIO * a->block_fg) {
+                memcpy(a->bg, a->fg, L * sizeof(float));
+                a->stats.resets++;
+            }
+        }
+
+        a->smooth_mic += AEC_ERLE_SMOOTH * (a->block_mic - a->smooth_mic);
+        a->smooth_err += AEC_ERLE_SMOOTH * (a->block_fg - a->smooth_err);
+        float erle = 10.0f * log10f((a->smooth_mic + 1.0f) / (a->smooth_err + 1.0f));
+        a->stats.erle_db10 = (int16_t)lrintf(erle * 10.0f);
+        a->stats.converged = a->stats.erle_db10 >= AEC_CONVERGED_DB10;
+    }
+
+    a->in_block = 0;
+    a->block_ref = a->block_mic = a->block_fg = a->block_bg = a->block_echo = a->block_cross = 0;
+}
+
+extern "C" {
+
+void aec_config_default(aec_config_t *cfg, uint32_t sample_rate) {
+    if (!cfg) return;
+    cfg->taps = (uint16_t)(sample_rate * 24 / 1000);
+    cfg->step_q15 = 16384;                          // 0.5
+    cfg->block = (uint16_t)(sample_rate / 250);     // 4 ms
+}
+
+aec_t *aec_create(const aec_config_t *cfg) {
+    if (!cfg || cfg->taps == 0 || cfg->taps > AEC_MAX_TAPS || cfg->block == 0 ||
+        cfg->step_q15 == 0 || cfg->step_q15 > 32768) {
+        return NULL;
+    }
+
+    aec_t *a = (aec_t *)calloc(1, sizeof(aec_t));
+    if (!a) return NULL;
+    a->cfg = *cfg;
+    a->taps = cfg->taps;
+    a->mu = cfg->step_q15 / 32768.0f;
+    a->delta = cfg->taps * AEC_REG_LEVEL * AEC_REG_LEVEL;
+    a->hist = (float *)calloc(2 * cfg->taps, sizeof(float));
+    a->fg = (float *)calloc(cfg->taps, sizeof(float));
+    a->bg = (float *)calloc(cfg->taps, sizeof(float));
+    if (!a->hist || !a->fg || !a->bg) {
+        aec_destroy(a);
+        return NULL;
+    }
+    aec_reset(a);
+    return a;
+}
+
+void aec_destroy(aec_t *a) {
+    if (!a) return;
+    free(a->hist);
+    free(a->fg);
+    free(a->bg);
+    free(a);
+}
+
+void aec_reset(aec_t *a) {
+    if (!a) return;
+    memset(a->hist, 0, 2 * a->taps * sizeof(float));
+    memset(a->fg, 0, a->taps * sizeof(float));
+    memset(a->bg, 0, a->taps * sizeof(float));
+    a->pos = 0;
+    a->power = 0;
+    a->silent = a->taps;
+    a->in_block = 0;
+    a->better_blocks = 0;
+    a->block_ref = a->block_mic = a->block_fg = a->block_bg = a->block_echo = a->block_cross = 0;
+    a->cov = a->var = 0;
+    a->adapted = false;
+    a->step = a->mu;
+    a->smooth_mic = a->smooth_err = 0;
+    memset(&a->stats, 0, sizeof(a->stats));
+}
+
+void aec_process(aec_t *a, const int16_t *ref, int16_t *mic, size_t count) {
+    if (!a || !ref || !mic) return;
+    const uint16_t L = a->taps;
+    float *fg = a->fg, *bg = a->bg;
+
+    for (size_t i = 0; i < count; i++) {
+        const float x = ref[i];
+
+        // With a window of zeros there is no echo to estimate
+        if (ref[i] == 0 && a->silent >= L) {
+            if (++a->pos == L) a->pos = 0;
+            continue;
+        }
+        a->silent = ref[i] == 0 ? a->silent + 1 : 0;
+
+        const float old = a->hist[a->pos];
+        a->hist[a->pos] = x;
+        a->hist[a->pos + L] = x;
+        if (++a->pos == L) a->pos = 0;
+        const float *win = a->hist + a->pos;           // Oldest .. newest
+        a->power += x * x - old * old;
+        if (a->power < 0) a->power = 0;
+
+        float yf = 0, yb = 0;
+        for (uint16_t j = 0; j < L; j++) {
+            yf += fg[j] * win[j];
+            yb += bg[j] * win[j];
+        }
+
+        const float d = mic[i];
+        const float ef = d - yf, eb = d - yb;
+        const float g = a->step * eb / (a->power + a->delta);
+        for (uint16_t j = 0; j < L; j++) {
+            bg[j] += g * win[j];
+        }
+
+        mic[i] = sat16f(ef);
+        a->block_ref += x * x;
+        a->block_mic += d * d;
+        a->block_fg += ef * ef;
+        a->block_bg += eb * eb;
+        a->block_echo += yf * yf;
+        a->block_cross += ef * yf;
+        a->stats.samples++;
+        if (++a->in_block == a->cfg.block) {
+            end_block(a);
+        }
+    }
+}
+
+void aec_get_stats(const aec_t *a, aec_stats_t *stats) {
+    if (!a || !stats) return;
+    *stats = a->stats;
+}
+
+} // extern "C"
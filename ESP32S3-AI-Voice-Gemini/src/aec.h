@@ -0,0 +1,71 @@
+#ifndef AEC_H
+#define AEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Acoustic echo canceller for 16-bit mono PCM.
+ *
+ * An NLMS filter models the path from the speaker reference to the
+ * microphone and its echo estimate is subtracted from the mic signal.
+ * Two copies of the filter run side by side: a background filter that
+ * always adapts and a foreground filter that produces the output and only
+ * takes over the background coefficients when they cancel better. During
+ * near-end speech (double talk) the step shrinks with the estimated share
+ * of residual echo in the error, so the filters keep their estimate
+ * without a separate double-talk detector.
+ *
+ * Filtering is single-precision float (the S3 has an FPU); state is
+ * allocated by aec_create() and aec_process() never allocates. The
+ * reference must be time aligned with the mic so that its echo arrives
+ * within the filter length; the canceller adds no delay.
+ */
+typedef struct aec aec_t;
+
+typedef struct {
+    uint16_t taps;              // Echo tail covered by the filter, in samples
+    uint16_t step_q15;          // NLMS step size of the background filter
+    uint16_t block;             // Samples between foreground/background comparisons
+} aec_config_t;
+
+typedef struct {
+    uint32_t samples;           // Samples processed with an active reference
+    uint32_t copies;            // Background filter adopted by the foreground
+    uint32_t resets;            // Background filter restored after diverging
+    int16_t erle_db10;          // Echo return loss enhancement, 0.1 dB, smoothed
+    bool converged;             // ERLE above 6 dB
+} aec_stats_t;
+
+/**
+ * @brief 24 ms tail (384 taps at 16 kHz), step 0.5, 4 ms comparison blocks.
+ */
+void aec_config_default(aec_config_t *cfg, uint32_t sample_rate);
+
+aec_t *aec_create(const aec_config_t *cfg);
+void aec_destroy(aec_t *aec);
+
+/**
+ * @brief Forget the echo path, e.g. after the speaker or its volume changed.
+ */
+void aec_reset(aec_t *aec);
+
+/**
+ * @brief Cancel the echo of ref in mic, in place.
+ *
+ * ref[i] is the speaker sample played at the time mic[i] was captured (or
+ * earlier, by less than the filter length).
+ */
+void aec_process(aec_t *aec, const int16_t *ref, int16_t *mic, size_t count);
+
+void aec_get_stats(const aec_t *aec, aec_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AEC_H
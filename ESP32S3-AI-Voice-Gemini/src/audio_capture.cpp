@@ -0,0 +1,235 @@
+// src/audio_capture.cpp - INMP441 I2S reader feeding the capture ring
+
+#include "audio_capture.h"
+#include "audio_hal.h"
+#include "capture_pipeline.h"
+#include "pcm_convert.h"
+#include "fft_q15.h"
+#include "esp_log.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+static const char *TAG = "CAPTURE";
+
+#define I2S_BITS_PER_SAMPLE     32
+#define I2S_CHANNELS            1
+
+// Capture task
+#define CAPTURE_TASK_STACK      4096
+#define CAPTURE_TASK_PRIORITY   4
+#define CAPTURE_TASK_CORE       1
+#define CAPTURE_READ_TIMEOUT_MS 100
+
+static audio_ring_t *s_ring = NULL;
+static audio_source_t *s_source = NULL;
+static capture_pipeline_t *s_pipeline = NULL;
+static TaskHandle_t s_capture_task_handle = NULL;
+static volatile bool s_running = false;
+static volatile bool s_listening = false;
+static volatile bool s_task_idle = true;
+static audio_capture_frame_stats_t s_frame_stats;
+
+static void capture_task(void *pvParameters) {
+    ESP_LOGI(TAG, "Capture task started");
+
+    while (true) {
+        if (!s_running) {
+            s_task_idle = true;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        s_task_idle = false;
+
+        int32_t *frame = NULL;
+        int64_t start_us = 0;
+        size_t samples = audio_source_read(s_source, &frame, &start_us, CAPTURE_READ_TIMEOUT_MS);
+        if (samples == 0) {
+            continue;
+        }
+        capture_pipeline_process(s_pipeline, frame, samples, start_us, s_ring);
+        s_frame_stats.frames++;
+    }
+}
+
+extern "C" {
+
+esp_err_t audio_capture_init(void) {
+    if (s_ring) {
+        ESP_LOGW(TAG, "Capture already initialized");
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "Initializing I2S for INMP441 microphone...");
+
+    if (!pcm_convert_self_test()) {
+        ESP_LOGW(TAG, "SIMD PCM converter mismatch, using scalar path");
+    }
+    ESP_LOGI(TAG, "PCM converter: %s", pcm_convert_has_simd() ? "PIE SIMD" : "scalar");
+    if (!fft_q15_self_test()) {
+        ESP_LOGW(TAG, "SIMD FFT mismatch, using scalar path");
+    }
+    ESP_LOGI(TAG, "FFT: %s", fft_q15_has_simd() ? "ESP-DSP SIMD" : "scalar");
+
+    s_source = audio_source_i2s_create();
+    if (!s_source) {
+        return ESP_FAIL;
+    }
+
+    s_pipeline = capture_pipeline_create();
+    if (!s_pipeline) {
+        ESP_LOGE(TAG, "Failed to create capture pipeline (%d -> %d Hz)",
+                 AUDIO_CAPTURE_I2S_RATE, AUDIO_CAPTURE_SAMPLE_RATE);
+        audio_source_destroy(s_source);
+        s_source = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    if (!capture_pipeline_is_echo_cancel_enabled(s_pipeline)) {
+        ESP_LOGW(TAG, "Echo canceller unavailable, capturing without it");
+    }
+    if (!capture_pipeline_is_noise_suppression_enabled(s_pipeline)) {
+        ESP_LOGW(TAG, "Noise suppressor unavailable, capturing without it");
+    }
+
+    s_ring = audio_ring_create(AUDIO_CAPTURE_RING_SAMPLES);
+    if (!s_ring) {
+        ESP_LOGE(TAG, "Failed to allocate capture ring");
+        capture_pipeline_destroy(s_pipeline);
+        s_pipeline = NULL;
+        audio_source_destroy(s_source);
+        s_source = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        capture_task,
+        "audio_capture",
+        CAPTURE_TASK_STACK,
+        NULL,
+        CAPTURE_TASK_PRIORITY,
+        &s_capture_task_handle,
+        CAPTURE_TASK_CORE
+    );
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create capture task");
+        audio_ring_destroy(s_ring);
+        s_ring = NULL;
+        capture_pipeline_destroy(s_pipeline);
+        s_pipeline = NULL;
+        audio_source_destroy(s_source);
+        s_source = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "I2S initialized successfully");
+    ESP_LOGI(TAG, "Sample rate: %d Hz (I2S %d Hz), Channels: %d, Bits: %d, Ring: %d samples",
+             AUDIO_CAPTURE_SAMPLE_RATE, AUDIO_CAPTURE_I2S_RATE, I2S_CHANNELS, I2S_BITS_PER_SAMPLE,
+             (int)audio_ring_capacity(s_ring));
+    return ESP_OK;
+}
+
+esp_err_t audio_capture_start(void) {
+    if (!s_ring || !s_capture_task_handle) {
+        ESP_LOGE(TAG, "Capture not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_running) {
+        return ESP_OK;
+    }
+
+    audio_source_start(s_source);
+
+    // Filter state from the last session does not belong to this signal
+    capture_pipeline_reset(s_pipeline);
+    s_running = true;
+    xTaskNotifyGive(s_capture_task_handle);
+    return ESP_OK;
+}
+
+void audio_capture_stop(void) {
+    if (!s_running || s_listening) {
+        return;
+    }
+    s_running = false;
+
+    // Let the reader finish the frame it is currently pushing
+    int wait = 0;
+    while (!s_task_idle && wait < (CAPTURE_READ_TIMEOUT_MS / 10) * 2) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        wait++;
+    }
+
+    audio_source_stop(s_source);
+}
+
+void audio_capture_set_listening(bool listening) {
+    s_listening = listening;
+    if (listening) {
+        audio_capture_start();
+    }
+    ESP_LOGI(TAG, "Always-listening %s", listening ? "on" : "off");
+}
+
+bool audio_capture_is_listening(void) {
+    return s_listening;
+}
+
+void audio_capture_set_dsp(bool enabled) {
+    capture_pipeline_set_dsp(s_pipeline, enabled);
+    ESP_LOGI(TAG, "Front-end DSP %s", enabled ? "enabled" : "disabled");
+}
+
+void audio_capture_set_noise_suppression(bool enabled) {
+    capture_pipeline_set_noise_suppression(s_pipeline, enabled);
+    ESP_LOGI(TAG, "Noise suppression %s", enabled ? "enabled" : "disabled");
+}
+
+bool audio_capture_is_noise_suppression_enabled(void) {
+    return capture_pipeline_is_noise_suppression_enabled(s_pipeline);
+}
+
+void audio_capture_set_echo_cancel(bool enabled) {
+    capture_pipeline_set_echo_cancel(s_pipeline, enabled);
+    ESP_LOGI(TAG, "Echo cancellation %s", enabled ? "enabled" : "disabled");
+}
+
+bool audio_capture_is_echo_cancel_enabled(void) {
+    return capture_pipeline_is_echo_cancel_enabled(s_pipeline);
+}
+
+void audio_capture_get_dsp_stats(audio_capture_dsp_stats_t *stats) {
+    if (!stats) return;
+    if (s_pipeline) {
+        capture_pipeline_get_stats(s_pipeline, stats);
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+void audio_capture_get_level(audio_level_stats_t *stats) {
+    capture_pipeline_get_level(s_pipeline, stats);
+}
+
+void audio_capture_set_gain(int16_t gain, uint8_t shift) {
+    if (shift > 31) shift = 31;
+    capture_pipeline_set_gain(s_pipeline, gain, shift);
+    ESP_LOGI(TAG, "Capture gain set to %d >> %d", gain, shift);
+}
+
+void audio_capture_get_frame_stats(audio_capture_frame_stats_t *stats) {
+    if (!stats) return;
+    *stats = s_frame_stats;
+    if (s_source) {
+        stats->dropped_frames = s_source->dropped_samples / CAPTURE_PIPELINE_I2S_FRAME;
+    }
+}
+
+bool audio_capture_is_running(void) {
+    return s_running;
+}
+
+audio_ring_t *audio_capture_get_ring(void) {
+    return s_ring;
+}
+
+} // extern "C"
@@ -0,0 +1,104 @@
+#ifndef AUDIO_CAPTURE_H
+#define AUDIO_CAPTURE_H
+
+#include "esp_err.h"
+#include "audio_ring.h"
+#include "capture_pipeline.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_CAPTURE_RING_SAMPLES    131072  // ~8 s of 16-bit audio in PSRAM, covers upload stalls
+
+/**
+ * @brief Install the I2S driver for the INMP441 and allocate the capture ring.
+ *        Call once at startup.
+ */
+esp_err_t audio_capture_init(void);
+
+/**
+ * @brief Start the I2S reader. Converted 16-bit frames are pushed into the
+ *        capture ring until audio_capture_stop() is called.
+ */
+esp_err_t audio_capture_start(void);
+
+/**
+ * @brief Stop the I2S reader. Returns once the last frame has been pushed.
+ *        Does nothing while listening; the reader keeps filling the ring.
+ */
+void audio_capture_stop(void);
+
+/**
+ * @brief Always-listening mode: keep the microphone running between
+ *        recordings so the ring always holds the most recent audio, which
+ *        recordings can then start from (see audio_ring_reader_open_at()).
+ *
+ * Enabling starts capture. Disabling only clears the mode; the next
+ * audio_capture_stop() stops the reader.
+ */
+void audio_capture_set_listening(bool listening);
+bool audio_capture_is_listening(void);
+
+// Per-stage cost and state, see capture_pipeline.h
+typedef capture_pipeline_stats_t audio_capture_dsp_stats_t;
+
+typedef struct {
+    uint32_t frames;            // 20 ms frames delivered to the ring
+    uint32_t dropped_frames;    // Frames the driver overwrote before the task got to them
+} audio_capture_frame_stats_t;
+
+/**
+ * @brief Frame delivery counters since boot, from the I2S task's view.
+ *        Ring overruns downstream are in audio_ring_get_stats().
+ */
+void audio_capture_get_frame_stats(audio_capture_frame_stats_t *stats);
+
+/**
+ * @brief Enable the front-end DSP chain (DC blocker, 80 Hz high-pass, AGC
+ *        with peak limiter; see audio_dsp.h). Enabled by default.
+ */
+void audio_capture_set_dsp(bool enabled);
+void audio_capture_get_dsp_stats(audio_capture_dsp_stats_t *stats);
+
+/**
+ * @brief Mic level of the last 20 ms frame (see audio_level.h). Lock-free,
+ *        cheap enough for the UI to poll at its frame rate.
+ */
+void audio_capture_get_level(audio_level_stats_t *stats);
+
+/**
+ * @brief Enable spectral noise suppression on the ring-rate audio (see
+ *        denoise.h). Adds 16 ms of delay. Enabled by default.
+ */
+void audio_capture_set_noise_suppression(bool enabled);
+bool audio_capture_is_noise_suppression_enabled(void);
+
+/**
+ * @brief Cancel the TTS speaker's echo (see aec.h, echo_ref.h) before noise
+ *        suppression, so the mic can stay open while the device talks.
+ *        Costs nothing while the speaker is silent. Enabled by default.
+ */
+void audio_capture_set_echo_cancel(bool enabled);
+bool audio_capture_is_echo_cancel_enabled(void);
+
+/**
+ * @brief Saturating gain applied while converting to 16-bit.
+ *        See pcm_convert_cfg_t; (1, 0) is unity.
+ */
+void audio_capture_set_gain(int16_t gain, uint8_t shift);
+
+bool audio_capture_is_running(void);
+
+/**
+ * @brief The ring that carries captured audio to downstream stages.
+ *        Each stage opens its own reader with audio_ring_reader_open().
+ */
+audio_ring_t *audio_capture_get_ring(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AUDIO_CAPTURE_H
@@ -0,0 +1,574 @@
+// src/audio_codec.cpp - Streaming PCM, mu-law, IMA-ADPCM and FLAC encoders
+
+#include "audio_codec.h"
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    const char *mime;
+    size_t (*header)(audio_encoder_t *enc, uint8_t *out, size_t cap);
+    size_t (*encode)(audio_encoder_t *enc, const int16_t *pcm, size_t count, uint8_t *out);
+    size_t (*flush)(audio_encoder_t *enc, uint8_t *out);
+    size_t (*max_output)(const audio_encoder_t *enc, size_t count);
+} codec_ops_t;
+
+// ---------------------------------------------------------------------------
+// PCM16
+// ---------------------------------------------------------------------------
+
+static size_t pcm16_encode(audio_encoder_t * /*enc*/, const int16_t *pcm, size_t count, uint8_t *out) {
+    // Little-endian target, samples are already in WAV byte order
+    memcpy(out, pcm, count * sizeof(int16_t));
+    return count * sizeof(int16_t);
+}
+
+static size_t pcm16_max_output(const audio_encoder_t * /*enc*/, size_t count) {
+    return count * sizeof(int16_t);
+}
+
+// ---------------------------------------------------------------------------
+// G.711 mu-law
+// ---------------------------------------------------------------------------
+
+// 14-bit magnitude domain, as in the classic g711.c reference
+#define ULAW_BIAS   (0x84 >> 2)
+#define ULAW_CLIP   8159
+
+static uint8_t ulaw_encode_sample(int16_t sample) {
+    int32_t s = sample >> 2;
+    uint8_t mask = 0xFF;
+    if (s < 0) {
+        s = -s;
+        mask = 0x7F;
+    }
+    if (s > ULAW_CLIP) s = ULAW_CLIP;
+    s += ULAW_BIAS;
+
+    if (s > 0x1FFF) {
+        return 0x7F ^ mask;
+    }
+
+    // Segment = position of the highest set bit above bit 5
+    uint8_t seg = 0;
+    while (s >= (0x40 << seg)) {
+        seg++;
+    }
+    uint8_t uval = (uint8_t)((seg << 4) | ((s >> (seg + 1)) & 0x0F));
+    return uval ^ mask;
+}
+
+static size_t ulaw_encode(audio_encoder_t * /*enc*/, const int16_t *pcm, size_t count, uint8_t *out) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = ulaw_encode_sample(pcm[i]);
+    }
+    return count;
+}
+
+static size_t ulaw_max_output(const audio_encoder_t * /*enc*/, size_t count) {
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+// IMA ADPCM (WAV block layout, mono)
+// ---------------------------------------------------------------------------
+
+static const int16_t s_ima_step[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t s_ima_index[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static uint8_t adpcm_encode_sample(audio_encoder_t *enc, int16_t sample) {
+    int32_t step = s_ima_step[enc->u.adpcm.index];
+    int32_t diff = sample - enc->u.adpcm.predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+
+    int32_t vpdiff = step >> 3;
+    if (diff >= step) { nibble |= 4; diff -= step; vpdiff += step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 2; diff -= step; vpdiff += step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 1; vpdiff += step; }
+
+    int32_t pred = enc->u.adpcm.predictor + ((nibble & 8) ? -vpdiff : vpdiff);
+    if (pred > INT16_MAX) pred = INT16_MAX;
+    if (pred < INT16_MIN) pred = INT16_MIN;
+    enc->u.adpcm.predictor = pred;
+
+    int index = enc->u.adpcm.index + s_ima_index[nibble & 7];
+    if (index < 0) index = 0;
+    if (index > 88) index = 88;
+    enc->u.adpcm.index = (int8_t)index;
+    return nibble;
+}
+
+// Block header carries the first sample verbatim, then two samples per byte
+// with the earlier sample in the low nibble.
+static size_t adpcm_emit_block(audio_encoder_t *enc, uint8_t *out) {
+    const int16_t *block = enc->u.adpcm.block;
+    enc->u.adpcm.predictor = block[0];
+
+    out[0] = (uint8_t)(block[0] & 0xFF);
+    out[1] = (uint8_t)((block[0] >> 8) & 0xFF);
+    out[2] = (uint8_t)enc->u.adpcm.index;
+    out[3] = 0;
+
+    uint8_t *p = out + 4;
+    for (int i = 1; i < AUDIO_CODEC_ADPCM_BLOCK_SAMPLES; i += 2) {
+        uint8_t lo = adpcm_encode_sample(enc, block[i]);
+        uint8_t hi = adpcm_encode_sample(enc, block[i + 1]);
+        *p++ = (uint8_t)(lo | (hi << 4));
+    }
+
+    enc->u.adpcm.fill = 0;
+    return AUDIO_CODEC_ADPCM_BLOCK_ALIGN;
+}
+
+static size_t adpcm_encode(audio_encoder_t *enc, const int16_t *pcm, size_t count, uint8_t *out) {
+    size_t written = 0;
+    while (count > 0) {
+        size_t room = AUDIO_CODEC_ADPCM_BLOCK_SAMPLES - enc->u.adpcm.fill;
+        size_t n = count < room ? count : room;
+        memcpy(enc->u.adpcm.block + enc->u.adpcm.fill, pcm, n * sizeof(int16_t));
+        enc->u.adpcm.fill += n;
+        pcm += n;
+        count -= n;
+        if (enc->u.adpcm.fill == AUDIO_CODEC_ADPCM_BLOCK_SAMPLES) {
+            written += adpcm_emit_block(enc, out + written);
+        }
+    }
+    return written;
+}
+
+static size_t adpcm_flush(audio_encoder_t *enc, uint8_t *out) {
+    uint16_t fill = enc->u.adpcm.fill;
+    if (fill == 0) return 0;
+
+    // WAV decoders expect whole blocks; hold the last sample to the end
+    int16_t last = enc->u.adpcm.block[fill - 1];
+    for (int i = fill; i < AUDIO_CODEC_ADPCM_BLOCK_SAMPLES; i++) {
+        enc->u.adpcm.block[i] = last;
+    }
+    return adpcm_emit_block(enc, out);
+}
+
+static size_t adpcm_max_output(const audio_encoder_t *enc, size_t count) {
+    size_t blocks = (enc->u.adpcm.fill + count) / AUDIO_CODEC_ADPCM_BLOCK_SAMPLES + 1;
+    return blocks * AUDIO_CODEC_ADPCM_BLOCK_ALIGN;
+}
+
+// ---------------------------------------------------------------------------
+// FLAC (fixed-predictor subframes, Rice-coded residuals)
+// ---------------------------------------------------------------------------
+
+#define FLAC_MAX_FIXED_ORDER    4
+#define FLAC_MAX_PARTITION_ORDER 4
+#define FLAC_MAX_RICE_PARAM     14
+#define FLAC_FRAME_OVERHEAD     24      // Frame header, subframe header, CRCs, padding
+
+typedef struct {
+    uint8_t *out;
+    size_t pos;
+    uint64_t acc;
+    uint32_t bits;
+} bit_writer_t;
+
+static void bw_put(bit_writer_t *bw, uint32_t value, uint32_t nbits) {
+    if (nbits == 0) return;
+    if (nbits < 32) value &= (1u << nbits) - 1;
+    bw->acc = (bw->acc << nbits) | value;
+    bw->bits += nbits;
+    while (bw->bits >= 8) {
+        bw->bits -= 8;
+        bw->out[bw->pos++] = (uint8_t)(bw->acc >> bw->bits);
+    }
+}
+
+// q zeros followed by a one
+static void bw_put_unary(bit_writer_t *bw, uint32_t q) {
+    while (q >= 32) {
+        bw_put(bw, 0, 32);
+        q -= 32;
+    }
+    bw_put(bw, 1, q + 1);
+}
+
+static void bw_align(bit_writer_t *bw) {
+    if (bw->bits > 0) {
+        bw_put(bw, 0, 8 - bw->bits);
+    }
+}
+
+static uint8_t flac_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t flac_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint32_t flac_rate_code(uint32_t rate) {
+    switch (rate) {
+        case 8000:  return 4;
+        case 16000: return 5;
+        case 22050: return 6;
+        case 24000: return 7;
+        case 32000: return 8;
+        case 44100: return 9;
+        case 48000: return 10;
+        default:    return 0;   // Take it from STREAMINFO
+    }
+}
+
+static inline int32_t fixed_residual(const int16_t *x, int i, int order) {
+    switch (order) {
+        case 0: return x[i];
+        case 1: return x[i] - x[i - 1];
+        case 2: return x[i] - 2 * x[i - 1] + x[i - 2];
+        case 3: return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        default: return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+    }
+}
+
+static inline uint32_t zigzag(int32_t r) {
+    return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+// Pick the fixed predictor order with the smallest absolute residual sum
+static int flac_best_order(const int16_t *x, int n) {
+    int best = 0;
+    uint64_t best_sum = UINT64_MAX;
+    int max_order = n > FLAC_MAX_FIXED_ORDER ? FLAC_MAX_FIXED_ORDER : n - 1;
+    for (int order = 0; order <= max_order; order++) {
+        uint64_t sum = 0;
+        for (int i = order; i < n; i++) {
+            int32_t r = fixed_residual(x, i, order);
+            sum += (uint32_t)(r < 0 ? -r : r);
+        }
+        if (sum < best_sum) {
+            best_sum = sum;
+            best = order;
+        }
+    }
+    return best;
+}
+
+// Exact bit cost of Rice-coding residuals [from, to) with parameter k
+static uint64_t rice_cost(const int16_t *x, int from, int to, int order, uint32_t k) {
+    uint64_t bits = (uint64_t)(to - from) * (k + 1);
+    for (int i = from; i < to; i++) {
+        bits += zigzag(fixed_residual(x, i, order)) >> k;
+    }
+    return bits;
+}
+
+static uint32_t rice_best_param(const int16_t *x, int from, int to, int order, uint64_t *cost) {
+    int count = to - from;
+    uint64_t sum = 0;
+    for (int i = from; i < to; i++) {
+        sum += zigzag(fixed_residual(x, i, order));
+    }
+
+    // Start from log2(mean) and check its neighbours exactly
+    uint32_t k = 0;
+    uint64_t mean = count > 0 ? sum / count : 0;
+    while (k < FLAC_MAX_RICE_PARAM && (mean >> (k + 1)) > 0) {
+        k++;
+    }
+
+    uint32_t best_k = k;
+    uint64_t best = rice_cost(x, from, to, order, k);
+    if (k > 0) {
+        uint64_t c = rice_cost(x, from, to, order, k - 1);
+        if (c < best) { best = c; best_k = k - 1; }
+    }
+    if (k < FLAC_MAX_RICE_PARAM) {
+        uint64_t c = rice_cost(x, from, to, order, k + 1);
+        if (c < best) { best = c; best_k = k + 1; }
+    }
+    *cost = best;
+    return best_k;
+}
+
+static size_t flac_header(audio_encoder_t *enc, uint8_t *out, size_t cap) {
+    if (cap < 42) return 0;
+
+    bit_writer_t bw = { out, 0, 0, 0 };
+    bw_put(&bw, 'f', 8);
+    bw_put(&bw, 'L', 8);
+    bw_put(&bw, 'a', 8);
+    bw_put(&bw, 'C', 8);
+
+    // Metadata block header: last block, STREAMINFO, 34 bytes
+    bw_put(&bw, 1, 1);
+    bw_put(&bw, 0, 7);
+    bw_put(&bw, 34, 24);
+
+    bw_put(&bw, AUDIO_CODEC_FLAC_BLOCK_SAMPLES, 16);   // Min block size
+    bw_put(&bw, AUDIO_CODEC_FLAC_BLOCK_SAMPLES, 16);   // Max block size
+    bw_put(&bw, 0, 24);                                 // Min frame size unknown
+    bw_put(&bw, 0, 24);                                 // Max frame size unknown
+    bw_put(&bw, enc->sample_rate, 20);
+    bw_put(&bw, 0, 3);                                  // Channels - 1
+    bw_put(&bw, 15, 5);                                 // Bits per sample - 1
+    bw_put(&bw, 0, 4);                                  // Total samples unknown (36 bits)
+    bw_put(&bw, 0, 32);
+    for (int i = 0; i < 4; i++) {
+        bw_put(&bw, 0, 32);                             // MD5 not computed
+    }
+    return bw.pos;
+}
+
+// UTF-8 style frame number coding from the FLAC frame header
+static void flac_put_utf8(bit_writer_t *bw, uint32_t v) {
+    if (v < 0x80) {
+        bw_put(bw, v, 8);
+        return;
+    }
+    int extra = v < 0x800 ? 1 : v < 0x10000 ? 2 : v < 0x200000 ? 3 : v < 0x4000000 ? 4 : 5;
+    uint32_t lead_mask = (0xFF00u >> (extra + 1)) & 0xFF;
+    bw_put(bw, lead_mask | (v >> (6 * extra)), 8);
+    for (int i = extra - 1; i >= 0; i--) {
+        bw_put(bw, 0x80 | ((v >> (6 * i)) & 0x3F), 8);
+    }
+}
+
+static size_t flac_emit_frame(audio_encoder_t *enc, uint8_t *out) {
+    const int16_t *x = enc->u.flac.block;
+    const int n = enc->u.flac.fill;
+    bit_writer_t bw = { out, 0, 0, 0 };
+
+    // Frame header
+    const bool full = n == AUDIO_CODEC_FLAC_BLOCK_SAMPLES;
+    bw_put(&bw, 0xFFF8, 16);                            // Sync, fixed block size
+    bw_put(&bw, full ? 10 : 7, 4);                      // 1024, or 16-bit size at end of header
+    bw_put(&bw, flac_rate_code(enc->sample_rate), 4);
+    bw_put(&bw, 0, 4);                                  // Mono
+    bw_put(&bw, 4, 3);                                  // 16 bits per sample
+    bw_put(&bw, 0, 1);
+    flac_put_utf8(&bw, enc->u.flac.frame_number++);
+    if (!full) {
+        bw_put(&bw, (uint32_t)(n - 1), 16);
+    }
+    bw_put(&bw, flac_crc8(out, bw.pos), 8);
+
+    // Constant subframe for digital silence
+    bool constant = true;
+    for (int i = 1; i < n && constant; i++) {
+        constant = x[i] == x[0];
+    }
+
+    if (constant) {
+        bw_put(&bw, 0, 8);                              // Pad, CONSTANT, no wasted bits
+        bw_put(&bw, (uint16_t)x[0], 16);
+    } else {
+        int order = flac_best_order(x, n);
+
+        // Choose the partition order with the lowest total cost
+        uint64_t best_bits = UINT64_MAX;
+        int best_porder = 0;
+        for (int porder = 0; porder <= FLAC_MAX_PARTITION_ORDER; porder++) {
+            int parts = 1 << porder;
+            if (n % parts != 0 || (n >> porder) <= order) break;
+            uint64_t bits = 0;
+            for (int p = 0; p < parts; p++) {
+                int from = p == 0 ? order : p * (n >> porder);
+                int to = (p + 1) * (n >> porder);
+                uint64_t cost;
+                rice_best_param(x, from, to, order, &cost);
+                bits += 4 + cost;
+            }
+            if (bits < best_bits) {
+                best_bits = bits;
+                best_porder = porder;
+            }
+        }
+
+        uint64_t fixed_bits = 8 + (uint64_t)order * 16 + 6 + best_bits;
+        uint64_t verbatim_bits = 8 + (uint64_t)n * 16;
+
+        if (fixed_bits >= verbatim_bits) {
+            bw_put(&bw, 0x02, 8);                       // Pad, VERBATIM, no wasted bits
+            for (int i = 0; i < n; i++) {
+                bw_put(&bw, (uint16_t)x[i], 16);
+            }
+        } else {
+            bw_put(&bw, 0, 1);
+            bw_put(&bw, 0x08 | order, 6);               // FIXED, order
+            bw_put(&bw, 0, 1);
+            for (int i = 0; i < order; i++) {
+                bw_put(&bw, (uint16_t)x[i], 16);        // Warm-up samples
+            }
+
+            bw_put(&bw, 0, 2);                          // Rice, 4-bit parameters
+            bw_put(&bw, best_porder, 4);
+            int parts = 1 << best_porder;
+            for (int p = 0; p < parts; p++) {
+                int from = p == 0 ? order : p * (n >> best_porder);
+                int to = (p + 1) * (n >> best_porder);
+                uint64_t cost;
+                uint32_t k = rice_best_param(x, from, to, order, &cost);
+                bw_put(&bw, k, 4);
+                for (int i = from; i < to; i++) {
+                    uint32_t u = zigzag(fixed_residual(x, i, order));
+                    bw_put_unary(&bw, u >> k);
+                    bw_put(&bw, u, k);
+                }
+            }
+        }
+    }
+
+    bw_align(&bw);
+    uint16_t crc = flac_crc16(out, bw.pos);
+    bw_put(&bw, crc, 16);
+
+    enc->u.flac.fill = 0;
+    return bw.pos;
+}
+
+static size_t flac_encode(audio_encoder_t *enc, const int16_t *pcm, size_t count, uint8_t *out) {
+    size_t written = 0;
+    while (count > 0) {
+        size_t room = AUDIO_CODEC_FLAC_BLOCK_SAMPLES - enc->u.flac.fill;
+        size_t n = count < room ? count : room;
+        memcpy(enc->u.flac.block + enc->u.flac.fill, pcm, n * sizeof(int16_t));
+        enc->u.flac.fill += n;
+        pcm += n;
+        count -= n;
+        if (enc->u.flac.fill == AUDIO_CODEC_FLAC_BLOCK_SAMPLES) {
+            written += flac_emit_frame(enc, out + written);
+        }
+    }
+    return written;
+}
+
+static size_t flac_flush(audio_encoder_t *enc, uint8_t *out) {
+    return enc->u.flac.fill > 0 ? flac_emit_frame(enc, out) : 0;
+}
+
+static size_t flac_max_output(const audio_encoder_t *enc, size_t count) {
+    size_t frames = (enc->u.flac.fill + count) / AUDIO_CODEC_FLAC_BLOCK_SAMPLES + 1;
+    return frames * (AUDIO_CODEC_FLAC_BLOCK_SAMPLES * sizeof(int16_t) + FLAC_FRAME_OVERHEAD);
+}
+
+// ---------------------------------------------------------------------------
+// Codec table
+// ---------------------------------------------------------------------------
+
+static const codec_ops_t s_codecs[AUDIO_CODEC_COUNT] = {
+    { "pcm16", "audio/wav",  NULL,        pcm16_encode, NULL,        pcm16_max_output },
+    { "ulaw",  "audio/wav",  NULL,        ulaw_encode,  NULL,        ulaw_max_output  },
+    { "adpcm", "audio/wav",  NULL,        adpcm_encode, adpcm_flush, adpcm_max_output },
+    { "flac",  "audio/flac", flac_header, flac_encode,  flac_flush,  flac_max_output  },
+};
+
+static const codec_ops_t *ops_for(audio_codec_id_t id) {
+    return (id >= 0 && id < AUDIO_CODEC_COUNT) ? &s_codecs[id] : &s_codecs[AUDIO_CODEC_PCM16];
+}
+
+extern "C" {
+
+const char *audio_codec_name(audio_codec_id_t id) {
+    return ops_for(id)->name;
+}
+
+const char *audio_codec_mime(audio_codec_id_t id) {
+    return ops_for(id)->mime;
+}
+
+bool audio_codec_wav_format(audio_codec_id_t id, uint32_t sample_rate,
+                            audio_codec_wav_format_t *fmt) {
+    if (!fmt) return false;
+    memset(fmt, 0, sizeof(*fmt));
+
+    switch (id) {
+        case AUDIO_CODEC_PCM16:
+            fmt->format_tag = 1;
+            fmt->bits_per_sample = 16;
+            fmt->block_align = 2;
+            fmt->byte_rate = sample_rate * 2;
+            return true;
+        case AUDIO_CODEC_ULAW:
+            fmt->format_tag = 7;
+            fmt->bits_per_sample = 8;
+            fmt->block_align = 1;
+            fmt->byte_rate = sample_rate;
+            return true;
+        case AUDIO_CODEC_IMA_ADPCM:
+            fmt->format_tag = 0x11;
+            fmt->bits_per_sample = 4;
+            fmt->block_align = AUDIO_CODEC_ADPCM_BLOCK_ALIGN;
+            fmt->samples_per_block = AUDIO_CODEC_ADPCM_BLOCK_SAMPLES;
+            fmt->byte_rate = (uint32_t)((uint64_t)sample_rate * AUDIO_CODEC_ADPCM_BLOCK_ALIGN /
+                                        AUDIO_CODEC_ADPCM_BLOCK_SAMPLES);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void audio_encoder_init(audio_encoder_t *enc, audio_codec_id_t id, uint32_t sample_rate) {
+    if (!enc) return;
+    memset(enc, 0, sizeof(*enc));
+    enc->id = (id >= 0 && id < AUDIO_CODEC_COUNT) ? id : AUDIO_CODEC_PCM16;
+    enc->sample_rate = sample_rate;
+}
+
+size_t audio_encoder_header(audio_encoder_t *enc, uint8_t *out, size_t cap) {
+    if (!enc || !out) return 0;
+    const codec_ops_t *ops = ops_for(enc->id);
+    size_t n = ops->header ? ops->header(enc, out, cap) : 0;
+    enc->bytes_out += n;
+    return n;
+}
+
+size_t audio_encoder_max_output(const audio_encoder_t *enc, size_t count) {
+    return enc ? ops_for(enc->id)->max_output(enc, count) : 0;
+}
+
+size_t audio_encoder_encode(audio_encoder_t *enc, const int16_t *pcm, size_t count,
+                            uint8_t *out, size_t cap) {
+    if (!enc || !pcm || !out || count == 0) return 0;
+    if (cap < audio_encoder_max_output(enc, count)) return 0;
+
+    size_t n = ops_for(enc->id)->encode(enc, pcm, count, out);
+    enc->samples_in += count;
+    enc->bytes_out += n;
+    return n;
+}
+
+size_t audio_encoder_flush(audio_encoder_t *enc, uint8_t *out, size_t cap) {
+    if (!enc || !out) return 0;
+    const codec_ops_t *ops = ops_for(enc->id);
+    if (!ops->flush || cap < ops->max_output(enc, 0)) return 0;
+
+    size_t n = ops->flush(enc, out);
+    enc->bytes_out += n;
+    return n;
+}
+
+} // extern "C"
@@ -0,0 +1,102 @@
+#ifndef AUDIO_CODEC_H
+#define AUDIO_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming encoders for uploads.
+ *
+ * Every codec consumes 16-bit mono PCM a frame at a time and keeps its
+ * state in audio_encoder_t, so encoders can live in static storage and
+ * never allocate. Codecs that use a WAV container describe their fmt chunk
+ * through audio_codec_wav_format(); the others (FLAC) write their own
+ * stream header with audio_encoder_header().
+ */
+typedef enum {
+    AUDIO_CODEC_PCM16 = 0,      // WAV, 16-bit linear PCM (256 kbit/s at 16 kHz)
+    AUDIO_CODEC_ULAW,           // WAV, G.711 mu-law (128 kbit/s)
+    AUDIO_CODEC_IMA_ADPCM,      // WAV, IMA/DVI ADPCM 4-bit (~65 kbit/s)
+    AUDIO_CODEC_FLAC,           // Native FLAC stream, lossless
+    AUDIO_CODEC_COUNT
+} audio_codec_id_t;
+
+#define AUDIO_CODEC_ADPCM_BLOCK_ALIGN   256
+#define AUDIO_CODEC_ADPCM_BLOCK_SAMPLES ((AUDIO_CODEC_ADPCM_BLOCK_ALIGN - 4) * 2 + 1)
+#define AUDIO_CODEC_FLAC_BLOCK_SAMPLES  1024
+#define AUDIO_CODEC_MAX_HEADER          64
+
+// WAV fmt chunk fields for codecs stored in a RIFF/WAVE container
+typedef struct {
+    uint16_t format_tag;        // 1 = PCM, 7 = mu-law, 0x11 = IMA ADPCM
+    uint16_t bits_per_sample;
+    uint16_t block_align;
+    uint32_t byte_rate;
+    uint16_t samples_per_block; // Written as the fmt extension when non-zero
+} audio_codec_wav_format_t;
+
+typedef struct {
+    audio_codec_id_t id;
+    uint32_t sample_rate;
+    uint32_t samples_in;
+    uint32_t bytes_out;
+    union {
+        struct {
+            int16_t block[AUDIO_CODEC_ADPCM_BLOCK_SAMPLES];
+            uint16_t fill;
+            int32_t predictor;
+            int8_t index;
+        } adpcm;
+        struct {
+            int16_t block[AUDIO_CODEC_FLAC_BLOCK_SAMPLES];
+            uint16_t fill;
+            uint32_t frame_number;
+        } flac;
+    } u;
+} audio_encoder_t;
+
+const char *audio_codec_name(audio_codec_id_t id);
+const char *audio_codec_mime(audio_codec_id_t id);
+
+/**
+ * @brief WAV fmt description of the codec.
+ * @return false if the codec does not use a WAV container
+ */
+bool audio_codec_wav_format(audio_codec_id_t id, uint32_t sample_rate,
+                            audio_codec_wav_format_t *fmt);
+
+void audio_encoder_init(audio_encoder_t *enc, audio_codec_id_t id, uint32_t sample_rate);
+
+/**
+ * @brief Write a native stream header (FLAC "fLaC" + STREAMINFO).
+ * @return Bytes written; 0 for WAV-contained codecs
+ */
+size_t audio_encoder_header(audio_encoder_t *enc, uint8_t *out, size_t cap);
+
+/**
+ * @brief Worst-case output size for encoding count more samples plus a flush.
+ */
+size_t audio_encoder_max_output(const audio_encoder_t *enc, size_t count);
+
+/**
+ * @brief Encode count samples. Block-based codecs buffer partial blocks
+ *        internally and emit them when full.
+ * @return Bytes written to out (0 if out is too small for the worst case)
+ */
+size_t audio_encoder_encode(audio_encoder_t *enc, const int16_t *pcm, size_t count,
+                            uint8_t *out, size_t cap);
+
+/**
+ * @brief Emit any buffered partial block. Call once at end of stream.
+ */
+size_t audio_encoder_flush(audio_encoder_t *enc, uint8_t *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AUDIO_CODEC_H
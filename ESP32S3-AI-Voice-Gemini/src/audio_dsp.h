@@ -0,0 +1,308 @@
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+/**
+ * Fixed-point microphone front-end.
+ *
+ * Stages work in place on frames of Q31 samples (the INMP441's 24-bit data,
+ * left-justified in 32 bits) before they are narrowed to 16-bit, so gain is
+ * applied while the low bits still exist. A chain is a type:
+ *
+ *     typedef DspChain<DspDcBlocker<>, DspHighPass<80, 16000>, DspAgc> front_end_t;
+ *
+ * and each call to process() expands to one loop per stage with no virtual
+ * dispatch. A stage is any class with process(int32_t *, size_t) and reset().
+ *
+ * This header is C++ only.
+ */
+
+static inline int32_t dsp_sat32(int64_t v) {
+    if (v > INT32_MAX) return INT32_MAX;
+    if (v < INT32_MIN) return INT32_MIN;
+    return (int32_t)v;
+}
+
+/**
+ * Fixed-point log2 in Q8 (256 = one octave of power, ~3 dB), with
+ * log2(0) taken as 0. The fraction is exact to the last bit.
+ */
+static inline int32_t dsp_log2_q8(uint64_t value) {
+    if (value == 0) return 0;
+    int n = 63 - __builtin_clzll(value);
+
+    // Mantissa in [1, 2) as Q30, then one result bit per squaring
+    uint64_t x = n >= 30 ? value >> (n - 30) : value << (30 - n);
+    int32_t frac = 0;
+    for (int bit = 7; bit >= 0; bit--) {
+        x = (x * x) >> 30;
+        if (x >= (2ull << 30)) {
+            x >>= 1;
+            frac |= 1 << bit;
+        }
+    }
+    return n * 256 + frac;
+}
+
+/**
+ * 2^(x / 256) in Q8, the inverse of dsp_log2_q8(). x is clamped to
+ * [-16, 23] octaves; the fraction uses a quadratic within 0.3 %.
+ */
+static inline uint32_t dsp_exp2_q8(int32_t x) {
+    if (x < -16 * 256) x = -16 * 256;
+    if (x > 23 * 256) x = 23 * 256;
+    int32_t i = x >> 8;                 // Floor
+    uint32_t f = (uint32_t)(x & 255);
+    uint32_t m = 32768 + ((f * (21512 + ((11256 * f) >> 8))) >> 8);     // 2^f in Q15
+    int32_t shift = i - 7;
+    return shift >= 0 ? m << shift : m >> -shift;
+}
+
+/**
+ * One-pole DC blocker: y[n] = x[n] - x[n-1] + R * y[n-1].
+ * R is Q15; the default 0.995 puts the corner near 13 Hz at 16 kHz.
+ */
+template <int32_t PoleQ15 = 32604>
+class DspDcBlocker {
+public:
+    DspDcBlocker() { reset(); }
+
+    void reset() {
+        x1_ = 0;
+        y1_ = 0;
+    }
+
+    void process(int32_t *frame, size_t n) {
+        int32_t x1 = x1_;
+        int64_t y1 = y1_;
+        for (size_t i = 0; i < n; i++) {
+            int32_t x = frame[i];
+            int64_t y = (int64_t)x - x1 + ((y1 * PoleQ15) >> 15);
+            x1 = x;
+            y1 = dsp_sat32(y);
+            frame[i] = (int32_t)y1;
+        }
+        x1_ = x1;
+        y1_ = y1;
+    }
+
+private:
+    int32_t x1_;
+    int64_t y1_;
+};
+
+/**
+ * Second-order Butterworth high-pass (RBJ biquad, direct form I).
+ * Coefficients are Q29 so the 64-bit accumulator cannot overflow on
+ * full-scale input. They are computed once, in the constructor.
+ */
+template <unsigned CutoffHz, unsigned SampleRate>
+class DspHighPass {
+public:
+    DspHighPass() {
+        set_cutoff((float)CutoffHz);
+        reset();
+    }
+
+    void set_cutoff(float cutoff_hz) {
+        const float w0 = 2.0f * (float)M_PI * cutoff_hz / (float)SampleRate;
+        const float alpha = sinf(w0) / (2.0f * 0.70710678f);
+        const float cw = cosf(w0);
+        const float a0 = 1.0f + alpha;
+        b0_ = to_q29((1.0f + cw) / 2.0f / a0);
+        b1_ = to_q29(-(1.0f + cw) / a0);
+        b2_ = b0_;
+        a1_ = to_q29(-2.0f * cw / a0);
+        a2_ = to_q29((1.0f - alpha) / a0);
+    }
+
+    void reset() {
+        x1_ = x2_ = 0;
+        y1_ = y2_ = 0;
+    }
+
+    void process(int32_t *frame, size_t n) {
+        int32_t x1 = x1_, x2 = x2_, y1 = y1_, y2 = y2_;
+        for (size_t i = 0; i < n; i++) {
+            int32_t x = frame[i];
+            int64_t acc = (int64_t)b0_ * x + (int64_t)b1_ * x1 + (int64_t)b2_ * x2 -
+                          (int64_t)a1_ * y1 - (int64_t)a2_ * y2;
+            int32_t y = dsp_sat32(acc >> 29);
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            frame[i] = y;
+        }
+        x1_ = x1;
+        x2_ = x2;
+        y1_ = y1;
+        y2_ = y2;
+    }
+
+private:
+    static int32_t to_q29(float v) { return (int32_t)lrintf(v * (float)(1 << 29)); }
+
+    int32_t b0_, b1_, b2_, a1_, a2_;
+    int32_t x1_, x2_, y1_, y2_;
+};
+
+/**
+ * Automatic gain control with a peak limiter.
+ *
+ * Once per frame the AGC measures the frame's RMS and moves its gain toward
+ * target / RMS. The gain drops quickly and rises slowly, and it is held while
+ * the input is below the noise gate so background hiss is not pumped up.
+ * The limiter then caps the gain so the frame peak stays under the limit.
+ * Within a frame the gain ramps linearly when rising and steps down at once
+ * when falling, so the output never exceeds the limit.
+ */
+class DspAgc {
+public:
+    struct config_t {
+        int32_t target_rms;         // Q31, default -20 dBFS
+        int32_t gate_rms;           // Q31, default -60 dBFS; hold gain below this
+        int32_t limit;              // Q31, default -1 dBFS peak
+        uint32_t max_gain_q16;      // Default 32x (+30 dB)
+        uint32_t min_gain_q16;      // Default 1x
+        uint8_t attack_shift;       // Per-frame smoothing when gain drops
+        uint8_t release_shift;      // Per-frame smoothing when gain rises
+    };
+
+    static config_t default_config() {
+        config_t cfg;
+        cfg.target_rms = 214748365;     // 0.1
+        cfg.gate_rms = 2147484;         // 0.001
+        cfg.limit = 1913946815;         // 0.891
+        cfg.max_gain_q16 = 32u << 16;
+        cfg.min_gain_q16 = 1u << 16;
+        cfg.attack_shift = 1;
+        cfg.release_shift = 5;          // ~0.6 s time constant with 20 ms frames
+        return cfg;
+    }
+
+    DspAgc() : cfg_(default_config()) { reset(); }
+
+    void configure(const config_t &cfg) { cfg_ = cfg; }
+    const config_t &config() const { return cfg_; }
+
+    void reset() {
+        gain_q16_ = 1u << 16;
+        limited_frames_ = 0;
+    }
+
+    uint32_t gain_q16() const { return gain_q16_; }
+    uint32_t limited_frames() const { return limited_frames_; }
+
+    void process(int32_t *frame, size_t n) {
+        if (n == 0) return;
+
+        // Frame statistics on the top 16 bits are precise enough for control
+        uint64_t sum_sq = 0;
+        int32_t peak = 0;
+        for (size_t i = 0; i < n; i++) {
+            int32_t s = frame[i] >> 16;
+            sum_sq += (uint64_t)((int64_t)s * s);
+            int32_t a = s < 0 ? -s : s;
+            if (a > peak) peak = a;
+        }
+        uint32_t rms16 = (uint32_t)sqrtf((float)(sum_sq / n));
+
+        uint32_t g0 = gain_q16_;
+        uint32_t g1 = g0;
+        if (rms16 > (uint32_t)(cfg_.gate_rms >> 16) && rms16 > 0) {
+            uint64_t want = ((uint64_t)(cfg_.target_rms >> 16) << 16) / rms16;
+            if (want > cfg_.max_gain_q16) want = cfg_.max_gain_q16;
+            if (want < cfg_.min_gain_q16) want = cfg_.min_gain_q16;
+            if (want < g0) {
+                g1 = g0 - (uint32_t)((g0 - want) >> cfg_.attack_shift);
+            } else {
+                g1 = g0 + (uint32_t)((want - g0) >> cfg_.release_shift);
+            }
+        }
+
+        // Peak limiter
+        if (peak > 0) {
+            uint64_t max_gain = ((uint64_t)(cfg_.limit >> 16) << 16) / (uint32_t)peak;
+            if (g1 > max_gain) {
+                g1 = (uint32_t)max_gain;
+                limited_frames_++;
+            }
+        }
+
+        // Step down immediately, ramp up across the frame
+        int64_t g = g1 < g0 ? g1 : g0;
+        int64_t step = g1 > g0 ? ((int64_t)(g1 - g0) << 16) / (int64_t)n : 0;
+        int64_t g_acc = g << 16;
+        for (size_t i = 0; i < n; i++) {
+            g_acc += step;
+            frame[i] = dsp_sat32(((int64_t)frame[i] * (g_acc >> 16)) >> 16);
+        }
+        gain_q16_ = g1;
+    }
+
+private:
+    config_t cfg_;
+    uint32_t gain_q16_;
+    uint32_t limited_frames_;
+};
+
+/**
+ * Compile-time chain of stages, run in order over each frame.
+ */
+template <typename... Stages>
+class DspChain;
+
+template <>
+class DspChain<> {
+public:
+    void process(int32_t *, size_t) {}
+    void reset() {}
+};
+
+template <typename First, typename... Rest>
+class DspChain<First, Rest...> {
+public:
+    void process(int32_t *frame, size_t n) {
+        first.process(frame, n);
+        rest.process(frame, n);
+    }
+
+    void reset() {
+        first.reset();
+        rest.reset();
+    }
+
+    First first;
+    DspChain<Rest...> rest;
+};
+
+/**
+ * Access a stage by position: dsp_stage<2>(chain).configure(...)
+ */
+template <size_t I, typename Chain>
+struct DspChainElement;
+
+template <typename First, typename... Rest>
+struct DspChainElement<0, DspChain<First, Rest...> > {
+    typedef First type;
+    static type &get(DspChain<First, Rest...> &chain) { return chain.first; }
+};
+
+template <size_t I, typename First, typename... Rest>
+struct DspChainElement<I, DspChain<First, Rest...> > {
+    typedef typename DspChainElement<I - 1, DspChain<Rest...> >::type type;
+    static type &get(DspChain<First, Rest...> &chain) {
+        return DspChainElement<I - 1, DspChain<Rest...> >::get(chain.rest);
+    }
+};
+
+template <size_t I, typename Chain>
+typename DspChainElement<I, Chain>::type &dsp_stage(Chain &chain) {
+    return DspChainElement<I, Chain>::get(chain);
+}
+
+#endif // AUDIO_DSP_H
@@ -0,0 +1,67 @@
+// src/audio_hal.cpp - Audio clock selection and speaker playback
+
+#include "audio_hal.h"
+#include "echo_ref.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include <esp_idf_version.h>
+#include <esp_cpu.h>
+#else
+#include <chrono>
+#endif
+
+static audio_clock_t s_clock = { NULL, NULL };
+
+static int64_t virtual_now_us(void *ctx) {
+    return ((audio_virtual_clock_t *)ctx)->now_us;
+}
+
+extern "C" {
+
+void audio_hal_set_clock(const audio_clock_t *clock) {
+    if (clock && clock->now_us) {
+        s_clock = *clock;
+    } else {
+        s_clock.now_us = NULL;
+        s_clock.ctx = NULL;
+    }
+}
+
+int64_t audio_hal_now_us(void) {
+    if (s_clock.now_us) {
+        return s_clock.now_us(s_clock.ctx);
+    }
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint32_t audio_hal_cycle_count(void) {
+#ifdef ESP_PLATFORM
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    return esp_cpu_get_cycle_count();
+#else
+    return esp_cpu_get_ccount();
+#endif
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+audio_clock_t audio_virtual_clock(audio_virtual_clock_t *vc) {
+    audio_clock_t clock = { virtual_now_us, vc };
+    return clock;
+}
+
+size_t audio_hal_play(audio_sink_t *speaker, const int16_t *pcm, size_t count, uint32_t rate) {
+    if (!speaker || !pcm || count == 0) return 0;
+    echo_ref_write(pcm, count, rate);
+    return speaker->ops->write(speaker, pcm, count, rate);
+}
+
+} // extern "C"
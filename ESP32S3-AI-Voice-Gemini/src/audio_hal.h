@@ -0,0 +1,184 @@
+#ifndef AUDIO_HAL_H
+#define AUDIO_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Audio hardware abstraction: where samples come from (source), where they
+ * go (sink) and what time it is (clock).
+ *
+ * The capture pipeline, echo reference and their statistics only talk to
+ * these interfaces, so the same code runs against the I2S microphone on the
+ * device (audio_hal_i2s.cpp) and against WAV files or memory buffers in a
+ * native host build (audio_hal_file.cpp). With the virtual clock a host run
+ * is deterministic: time only advances as frames are read.
+ *
+ * This header and the file backends do not depend on ESP-IDF.
+ */
+
+// ---------------------------------------------------------------------------
+// Clock
+
+typedef struct {
+    int64_t (*now_us)(void *ctx);
+    void *ctx;
+} audio_clock_t;
+
+/**
+ * @brief Replace the time base used by the audio path; NULL restores the
+ *        platform clock (esp_timer on the device, steady_clock on a host).
+ *        Set it before capture or playback start.
+ */
+void audio_hal_set_clock(const audio_clock_t *clock);
+int64_t audio_hal_now_us(void);
+
+/**
+ * @brief Free-running counter for profiling: CPU cycles on the device,
+ *        nanoseconds on a host. Only differences are meaningful.
+ */
+uint32_t audio_hal_cycle_count(void);
+
+/**
+ * A clock that only moves when told to. File sources advance it to the end
+ * of each frame they hand out.
+ */
+typedef struct {
+    int64_t now_us;
+} audio_virtual_clock_t;
+
+audio_clock_t audio_virtual_clock(audio_virtual_clock_t *vc);
+
+// ---------------------------------------------------------------------------
+// Source: frames of 32-bit samples (16-bit data left-justified, like the
+// INMP441's I2S slots)
+
+typedef struct audio_source audio_source_t;
+
+typedef struct {
+    bool (*start)(audio_source_t *src);
+    void (*stop)(audio_source_t *src);
+
+    /**
+     * Wait up to timeout_ms for the next frame. On success *frame points to
+     * samples owned by the source, valid until the next read, which the
+     * caller may modify in place, and *start_us is when the first of them
+     * was captured. Returns the sample count, 0 on timeout or end of input.
+     */
+    size_t (*read)(audio_source_t *src, int32_t **frame, int64_t *start_us, uint32_t timeout_ms);
+    void (*destroy)(audio_source_t *src);
+} audio_source_ops_t;
+
+struct audio_source {
+    const audio_source_ops_t *ops;
+    uint32_t sample_rate;
+    uint32_t dropped_samples;   // Lost because the reader fell behind
+};
+
+static inline bool audio_source_start(audio_source_t *src) {
+    return src && src->ops->start(src);
+}
+
+static inline void audio_source_stop(audio_source_t *src) {
+    if (src) src->ops->stop(src);
+}
+
+static inline size_t audio_source_read(audio_source_t *src, int32_t **frame,
+                                       int64_t *start_us, uint32_t timeout_ms) {
+    return src ? src->ops->read(src, frame, start_us, timeout_ms) : 0;
+}
+
+static inline void audio_source_destroy(audio_source_t *src) {
+    if (src) src->ops->destroy(src);
+}
+
+// ---------------------------------------------------------------------------
+// Sink: 16-bit mono PCM being played
+
+typedef struct audio_sink audio_sink_t;
+
+typedef struct {
+    /**
+     * Play count samples at rate, blocking while the output is full.
+     * Returns the number of samples accepted.
+     */
+    size_t (*write)(audio_sink_t *sink, const int16_t *pcm, size_t count, uint32_t rate);
+    void (*destroy)(audio_sink_t *sink);
+} audio_sink_ops_t;
+
+struct audio_sink {
+    const audio_sink_ops_t *ops;
+};
+
+static inline size_t audio_sink_write(audio_sink_t *sink, const int16_t *pcm, size_t count, uint32_t rate) {
+    return sink && pcm && count ? sink->ops->write(sink, pcm, count, rate) : 0;
+}
+
+/**
+ * @brief Play through the speaker's sink. Unlike a plain write, everything
+ *        played is also the echo canceller's reference (see echo_ref.h).
+ */
+size_t audio_hal_play(audio_sink_t *speaker, const int16_t *pcm, size_t count, uint32_t rate);
+
+static inline void audio_sink_destroy(audio_sink_t *sink) {
+    if (sink) sink->ops->destroy(sink);
+}
+
+// ---------------------------------------------------------------------------
+// Device backends (audio_hal_i2s.cpp)
+
+/**
+ * @brief INMP441 on I2S1 at AUDIO_CAPTURE_I2S_RATE, one 20 ms frame per
+ *        read. Samples the driver discarded because the reader fell
+ *        behind are counted in dropped_samples.
+ * @return NULL if the driver could not be installed
+ */
+audio_source_t *audio_source_i2s_create(void);
+
+/**
+ * @brief The TTS speaker. The Audio library owns that I2S port and writes
+ *        to it itself, so this sink accepts the samples it reports from its
+ *        output hook without playing them again.
+ */
+audio_sink_t *audio_sink_speaker_create(void);
+
+// ---------------------------------------------------------------------------
+// File and memory backends (audio_hal_file.cpp)
+
+/**
+ * @brief Source reading a 16-bit mono PCM WAV file in frames of
+ *        frame_samples. If clock is given it is advanced to the end of each
+ *        frame read; frame times start at the clock's time when started.
+ * @return NULL if the file is missing or not 16-bit mono PCM
+ */
+audio_source_t *audio_source_wav_create(const char *path, size_t frame_samples,
+                                        audio_virtual_clock_t *clock);
+
+/**
+ * @brief Source over samples in memory, which must outlive it. The same
+ *        framing and clock handling as the WAV source.
+ */
+audio_source_t *audio_source_memory_create(const int16_t *pcm, size_t count, uint32_t rate,
+                                           size_t frame_samples, audio_virtual_clock_t *clock);
+
+/**
+ * @brief Sink writing a 16-bit mono WAV file. The rate is taken from the
+ *        first write; the header is completed when the sink is destroyed.
+ */
+audio_sink_t *audio_sink_wav_create(const char *path);
+
+/**
+ * @brief Sink collecting everything written, up to capacity samples.
+ */
+audio_sink_t *audio_sink_memory_create(size_t capacity);
+const int16_t *audio_sink_memory_data(const audio_sink_t *sink, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AUDIO_HAL_H
@@ -0,0 +1,271 @@
+// src/audio_hal_file.cpp - WAV file and memory sources and sinks
+
+#include "audio_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sources hand out frames of 32-bit samples, like the I2S microphone
+typedef struct {
+    audio_source_t base;        // First, so the source pointer converts back
+    FILE *file;                 // WAV data, or NULL for memory
+    const int16_t *pcm;         // Memory samples
+    size_t remaining;           // Samples left to read
+    size_t frame_samples;
+    int16_t *raw;
+    int32_t *frame;
+    audio_virtual_clock_t *clock;
+    int64_t start_us;
+    uint64_t delivered;         // Samples read since start
+    bool running;
+} pcm_source_t;
+
+typedef struct {
+    audio_sink_t base;
+    FILE *file;                 // WAV file, or NULL for memory
+    uint32_t rate;
+    uint32_t written;
+    int16_t *buf;               // Memory sink storage
+    size_t capacity;
+} pcm_sink_t;
+
+static uint32_t get_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+// Walk the RIFF chunks up to the data; returns its size in samples, or 0
+// if the file is not 16-bit mono PCM
+static size_t wav_open_data(FILE *f, uint32_t *rate) {
+    uint8_t hdr[12];
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+        return 0;
+    }
+
+    bool have_fmt = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+        uint32_t size = get_le32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, sizeof(fmt), f) != sizeof(fmt)) return 0;
+            if (get_le16(fmt) != 1 || get_le16(fmt + 2) != 1 || get_le16(fmt + 14) != 16) {
+                return 0;
+            }
+            *rate = get_le32(fmt + 4);
+            have_fmt = true;
+            size -= sizeof(fmt);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            return have_fmt ? size / sizeof(int16_t) : 0;
+        }
+        if (fseek(f, (long)(size + (size & 1)), SEEK_CUR) != 0) return 0;
+    }
+    return 0;
+}
+
+static bool pcm_source_start(audio_source_t *src) {
+    pcm_source_t *s = (pcm_source_t *)src;
+    s->start_us = s->clock ? s->clock->now_us : audio_hal_now_us();
+    s->delivered = 0;
+    s->running = true;
+    return true;
+}
+
+static void pcm_source_stop(audio_source_t *src) {
+    ((pcm_source_t *)src)->running = false;
+}
+
+static size_t pcm_source_read(audio_source_t *src, int32_t **frame, int64_t *start_us, uint32_t timeout_ms) {
+    (void)timeout_ms;                           // Samples are always at hand
+    pcm_source_t *s = (pcm_source_t *)src;
+    if (!s->running || s->remaining == 0) {
+        return 0;
+    }
+
+    size_t n = s->remaining < s->frame_samples ? s->remaining : s->frame_samples;
+    const int16_t *in = s->pcm;
+    if (s->file) {
+        n = fread(s->raw, sizeof(int16_t), n, s->file);
+        if (n == 0) {
+            s->remaining = 0;
+            return 0;
+        }
+        in = s->raw;
+    } else {
+        s->pcm += n;
+    }
+    s->remaining -= n;
+    for (size_t i = 0; i < n; i++) {
+        s->frame[i] = (int32_t)in[i] << 16;
+    }
+
+    *frame = s->frame;
+    *start_us = s->start_us + (int64_t)(s->delivered * 1000000 / src->sample_rate);
+    s->delivered += n;
+    if (s->clock) {
+        s->clock->now_us = s->start_us + (int64_t)(s->delivered * 1000000 / src->sample_rate);
+    }
+    return n;
+}
+
+static void pcm_source_destroy(audio_source_t *src) {
+    pcm_source_t *s = (pcm_source_t *)src;
+    if (s->file) fclose(s->file);
+    free(s->raw);
+    free(s->frame);
+    free(s);
+}
+
+static const audio_source_ops_t s_pcm_source_ops = {
+    pcm_source_start,
+    pcm_source_stop,
+    pcm_source_read,
+    pcm_source_destroy,
+};
+
+static pcm_source_t *pcm_source_alloc(uint32_t rate, size_t frame_samples, audio_virtual_clock_t *clock) {
+    if (rate == 0 || frame_samples == 0) return NULL;
+    pcm_source_t *s = (pcm_source_t *)calloc(1, sizeof(pcm_source_t));
+    if (!s) return NULL;
+    s->base.ops = &s_pcm_source_ops;
+    s->base.sample_rate = rate;
+    s->frame_samples = frame_samples;
+    s->clock = clock;
+    s->raw = (int16_t *)malloc(frame_samples * sizeof(int16_t));
+    s->frame = (int32_t *)malloc(frame_samples * sizeof(int32_t));
+    if (!s->raw || !s->frame) {
+        pcm_source_destroy(&s->base);
+        return NULL;
+    }
+    return s;
+}
+
+static size_t pcm_sink_write(audio_sink_t *sink, const int16_t *pcm, size_t count, uint32_t rate) {
+    pcm_sink_t *s = (pcm_sink_t *)sink;
+    if (s->rate == 0) s->rate = rate;
+
+    if (!s->file) {
+        size_t room = s->capacity - s->written;
+        if (count > room) count = room;
+        memcpy(s->buf + s->written, pcm, count * sizeof(int16_t));
+        s->written += (uint32_t)count;
+        return count;
+    }
+
+    if (s->written == 0 && ftell(s->file) == 0) {
+        uint8_t hdr[44] = { 0 };
+        fwrite(hdr, 1, sizeof(hdr), s->file);     // Filled in on destroy
+    }
+    count = fwrite(pcm, sizeof(int16_t), count, s->file);
+    s->written += (uint32_t)count;
+    return count;
+}
+
+static void pcm_sink_destroy(audio_sink_t *sink) {
+    pcm_sink_t *s = (pcm_sink_t *)sink;
+    if (s->file) {
+        uint8_t hdr[44];
+        uint32_t bytes = s->written * sizeof(int16_t);
+        memcpy(hdr, "RIFF", 4);
+        put_le32(hdr + 4, 36 + bytes);
+        memcpy(hdr + 8, "WAVEfmt ", 8);
+        put_le32(hdr + 16, 16);
+        put_le16(hdr + 20, 1);                      // PCM
+        put_le16(hdr + 22, 1);                      // Mono
+        put_le32(hdr + 24, s->rate);
+        put_le32(hdr + 28, s->rate * sizeof(int16_t));
+        put_le16(hdr + 32, sizeof(int16_t));
+        put_le16(hdr + 34, 16);
+        memcpy(hdr + 36, "data", 4);
+        put_le32(hdr + 40, bytes);
+        fseek(s->file, 0, SEEK_SET);
+        fwrite(hdr, 1, sizeof(hdr), s->file);
+        fclose(s->file);
+    }
+    free(s->buf);
+    free(s);
+}
+
+static const audio_sink_ops_t s_pcm_sink_ops = {
+    pcm_sink_write,
+    pcm_sink_destroy,
+};
+
+extern "C" {
+
+audio_source_t *audio_source_wav_create(const char *path, size_t frame_samples,
+                                        audio_virtual_clock_t *clock) {
+    FILE *f = path ? fopen(path, "rb") : NULL;
+    if (!f) return NULL;
+
+    uint32_t rate = 0;
+    size_t count = wav_open_data(f, &rate);
+    pcm_source_t *s = count ? pcm_source_alloc(rate, frame_samples, clock) : NULL;
+    if (!s) {
+        fclose(f);
+        return NULL;
+    }
+    s->file = f;
+    s->remaining = count;
+    return &s->base;
+}
+
+audio_source_t *audio_source_memory_create(const int16_t *pcm, size_t count, uint32_t rate,
+                                           size_t frame_samples, audio_virtual_clock_t *clock) {
+    if (!pcm && count) return NULL;
+    pcm_source_t *s = pcm_source_alloc(rate, frame_samples, clock);
+    if (!s) return NULL;
+    s->pcm = pcm;
+    s->remaining = count;
+    return &s->base;
+}
+
+audio_sink_t *audio_sink_wav_create(const char *path) {
+    FILE *f = path ? fopen(path, "wb") : NULL;
+    if (!f) return NULL;
+    pcm_sink_t *s = (pcm_sink_t *)calloc(1, sizeof(pcm_sink_t));
+    if (!s) {
+        fclose(f);
+        return NULL;
+    }
+    s->base.ops = &s_pcm_sink_ops;
+    s->file = f;
+    return &s->base;
+}
+
+audio_sink_t *audio_sink_memory_create(size_t capacity) {
+    pcm_sink_t *s = (pcm_sink_t *)calloc(1, sizeof(pcm_sink_t));
+    if (!s) return NULL;
+    s->base.ops = &s_pcm_sink_ops;
+    s->buf = (int16_t *)malloc((capacity ? capacity : 1) * sizeof(int16_t));
+    if (!s->buf) {
+        free(s);
+        return NULL;
+    }
+    s->capacity = capacity;
+    return &s->base;
+}
+
+const int16_t *audio_sink_memory_data(const audio_sink_t *sink, size_t *count) {
+    const pcm_sink_t *s = (const pcm_sink_t *)sink;
+    if (count) *count = s && !s->file ? s->written : 0;
+    return s && !s->file ? s->buf : NULL;
+}
+
+} // extern "C"
@@ -0,0 +1,172 @@
+// src/audio_hal_i2s.cpp - INMP441 I2S source and TTS speaker sink
+
+#include "audio_hal.h"
+#include "capture_pipeline.h"
+#include "pincfg.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <driver/i2s.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <string.h>
+
+static const char *TAG = "AUDIO_HAL";
+
+// I2S Configuration
+#define I2S_NUM                 I2S_NUM_1
+#define I2S_DMA_BUF_COUNT       8
+#define I2S_DMA_BUF_LEN         1024        // Samples per DMA buffer
+#define I2S_EVENT_QUEUE_LEN     8
+#define CAPTURE_I2S_FRAME       CAPTURE_PIPELINE_I2S_FRAME
+
+static audio_source_t s_source;
+
+static QueueHandle_t s_i2s_events = NULL;
+static int32_t s_frame_32[CAPTURE_I2S_FRAME] __attribute__((aligned(16)));
+static int64_t s_start_us = 0;                  // When the first sample was clocked in
+static uint64_t s_samples_in = 0;               // Samples clocked in since then
+
+// The driver reports a full receive queue when it had to discard a DMA
+// buffer because the reader fell behind
+static void poll_i2s_events(audio_source_t *src) {
+    i2s_event_t event;
+    while (s_i2s_events && xQueueReceive(s_i2s_events, &event, 0) == pdTRUE) {
+        if (event.type == I2S_EVENT_RX_Q_OVF) {
+            src->dropped_samples += I2S_DMA_BUF_LEN;
+            s_samples_in += I2S_DMA_BUF_LEN;
+        }
+    }
+}
+
+static size_t i2s_source_read(audio_source_t *src, int32_t **frame, int64_t *start_us, uint32_t timeout_ms) {
+    // Blocks until a full frame is in; no extra delay between reads
+    size_t bytes_read = 0;
+    esp_err_t ret = i2s_read(I2S_NUM, s_frame_32, sizeof(s_frame_32), &bytes_read,
+                             pdMS_TO_TICKS(timeout_ms));
+    poll_i2s_events(src);
+    if (ret != ESP_OK || bytes_read == 0) {
+        return 0;
+    }
+
+    // i2s_read() returns buffered data without telling when it came in, so
+    // frame times are counted from the start of capture
+    size_t samples = bytes_read / sizeof(int32_t);
+    *frame = s_frame_32;
+    *start_us = s_start_us + (int64_t)(s_samples_in * 1000000 / AUDIO_CAPTURE_I2S_RATE);
+    s_samples_in += samples;
+    return samples;
+}
+
+static esp_err_t i2s_backend_init(void) {
+    // I2S configuration for INMP441
+    i2s_config_t i2s_config = {
+        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
+        .sample_rate = AUDIO_CAPTURE_I2S_RATE,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = I2S_DMA_BUF_COUNT,
+        .dma_buf_len = I2S_DMA_BUF_LEN,
+        .use_apll = false,
+        .tx_desc_auto_clear = false,
+        .fixed_mclk = 0
+    };
+
+    // I2S pin configuration for INMP441
+    i2s_pin_config_t pin_config = {
+        .bck_io_num = MIC_I2S_SCK,    // Serial Clock (BCLK)
+        .ws_io_num = MIC_I2S_WS,      // Word Select (LRC)
+        .data_out_num = I2S_PIN_NO_CHANGE,
+        .data_in_num = MIC_I2S_SD     // Serial Data (DOUT)
+    };
+
+    // Install and start I2S driver
+    esp_err_t ret = i2s_driver_install(I2S_NUM, &i2s_config, I2S_EVENT_QUEUE_LEN, &s_i2s_events);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install I2S driver: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = i2s_set_pin(I2S_NUM, &pin_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set I2S pins: %s", esp_err_to_name(ret));
+        i2s_driver_uninstall(I2S_NUM);
+        return ret;
+    }
+
+    // Keep the microphone idle until a recording starts
+    i2s_stop(I2S_NUM);
+    i2s_zero_dma_buffer(I2S_NUM);
+    return ESP_OK;
+}
+
+static void i2s_backend_deinit(void) {
+    i2s_driver_uninstall(I2S_NUM);
+    s_i2s_events = NULL;
+}
+
+static bool i2s_source_start(audio_source_t *src) {
+    i2s_zero_dma_buffer(I2S_NUM);
+    s_samples_in = 0;
+    s_start_us = esp_timer_get_time();
+    esp_err_t ret = i2s_start(I2S_NUM);
+    if (s_i2s_events) xQueueReset(s_i2s_events);
+    return ret == ESP_OK;
+}
+
+static void i2s_source_stop(audio_source_t *src) {
+    i2s_stop(I2S_NUM);
+}
+
+static void i2s_source_destroy(audio_source_t *src) {
+    if (src->ops) {
+        i2s_backend_deinit();
+        src->ops = NULL;
+    }
+}
+
+static const audio_source_ops_t s_i2s_source_ops = {
+    i2s_source_start,
+    i2s_source_stop,
+    i2s_source_read,
+    i2s_source_destroy,
+};
+
+// The Audio library plays the samples itself right after its output hook
+static size_t speaker_write(audio_sink_t *sink, const int16_t *pcm, size_t count, uint32_t rate) {
+    return count;
+}
+
+static void speaker_destroy(audio_sink_t *sink) {
+}
+
+static const audio_sink_ops_t s_speaker_ops = {
+    speaker_write,
+    speaker_destroy,
+};
+
+static audio_sink_t s_speaker = { &s_speaker_ops };
+
+extern "C" {
+
+audio_source_t *audio_source_i2s_create(void) {
+    if (s_source.ops) {
+        return &s_source;
+    }
+    if (i2s_backend_init() != ESP_OK) {
+        return NULL;
+    }
+    memset(&s_source, 0, sizeof(s_source));
+    s_source.ops = &s_i2s_source_ops;
+    s_source.sample_rate = AUDIO_CAPTURE_I2S_RATE;
+    ESP_LOGI(TAG, "INMP441 on I2S%d at %d Hz", (int)I2S_NUM, AUDIO_CAPTURE_I2S_RATE);
+    return &s_source;
+}
+
+audio_sink_t *audio_sink_speaker_create(void) {
+    return &s_speaker;
+}
+
+} // extern "C"
@@ -0,0 +1,142 @@
+// src/audio_level.cpp - Per-frame mic level statistics with a lock-free snapshot
+
+#include "audio_level.h"
+#include <atomic>
+#include <math.h>
+#include <new>
+#include <string.h>
+
+// Noise floor tracking on the mean square: fall within a few frames, rise
+// over several seconds so speech does not lift it
+#define NOISE_FALL_SHIFT    2
+#define NOISE_RISE_SHIFT    8
+
+#define LEVEL_WORDS         (sizeof(audio_level_stats_t) / sizeof(uint32_t))
+
+static_assert(sizeof(audio_level_stats_t) % sizeof(uint32_t) == 0,
+              "snapshot is published in whole words");
+
+struct audio_level {
+    // Writer state
+    audio_level_stats_t stats;
+    uint32_t noise_ms;              // Mean-square noise floor, 0 until the first frame
+
+    // Published copy of stats, under a sequence count (odd while updating)
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> words[LEVEL_WORDS];
+};
+
+static void publish(audio_level_t *lvl) {
+    uint32_t w[LEVEL_WORDS];
+    memcpy(w, &lvl->stats, sizeof(w));
+
+    uint32_t seq = lvl->seq.load(std::memory_order_relaxed);
+    lvl->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < LEVEL_WORDS; i++) {
+        lvl->words[i].store(w[i], std::memory_order_relaxed);
+    }
+    lvl->seq.store(seq + 2, std::memory_order_release);
+}
+
+static uint16_t amplitude(uint64_t ms) {
+    float a = sqrtf((float)ms);
+    return a > 32767.0f ? 32767 : (uint16_t)lrintf(a);
+}
+
+extern "C" {
+
+int16_t audio_level_db10(uint32_t amplitude) {
+    if (amplitude == 0) {
+        return AUDIO_LEVEL_SILENCE_DB10;
+    }
+    return (int16_t)lrintf(200.0f * log10f((float)amplitude / 32768.0f));
+}
+
+audio_level_t *audio_level_create(void) {
+    audio_level_t *lvl = new (std::nothrow) audio_level_t();
+    if (lvl) {
+        audio_level_reset(lvl);
+    }
+    return lvl;
+}
+
+void audio_level_destroy(audio_level_t *lvl) {
+    delete lvl;
+}
+
+void audio_level_reset(audio_level_t *lvl) {
+    if (!lvl) return;
+    memset(&lvl->stats, 0, sizeof(lvl->stats));
+    lvl->stats.rms_db10 = AUDIO_LEVEL_SILENCE_DB10;
+    lvl->stats.peak_db10 = AUDIO_LEVEL_SILENCE_DB10;
+    lvl->stats.noise_floor_db10 = AUDIO_LEVEL_SILENCE_DB10;
+    lvl->noise_ms = 0;
+    publish(lvl);
+}
+
+void audio_level_process(audio_level_t *lvl, const int16_t *pcm, size_t count) {
+    if (!lvl || !pcm || count == 0) return;
+
+    int64_t sum = 0;
+    uint64_t sum_sq = 0;
+    uint32_t peak = 0;
+    uint16_t clipped = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t s = pcm[i];
+        uint32_t a = (uint32_t)(s < 0 ? -s : s);
+        sum += s;
+        sum_sq += (uint64_t)((int64_t)s * s);
+        if (a > peak) peak = a;
+        clipped += (a >= 32767);
+    }
+
+    int64_t mean = sum / (int64_t)count;
+    uint64_t ms = sum_sq / count;
+    uint64_t dc = (uint64_t)(mean * mean);
+    ms = ms > dc ? ms - dc : 0;
+    uint32_t energy = ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+
+    uint32_t floor = lvl->noise_ms;
+    if (lvl->stats.frames == 0) {
+        floor = energy;
+    } else if (energy < floor) {
+        floor -= (floor - energy) >> NOISE_FALL_SHIFT;
+    } else {
+        floor += (energy - floor) >> NOISE_RISE_SHIFT;
+    }
+    lvl->noise_ms = floor;
+
+    audio_level_stats_t *st = &lvl->stats;
+    st->frames++;
+    st->rms = amplitude(ms);
+    st->peak = (uint16_t)(peak > 32767 ? 32767 : peak);
+    st->noise_floor = amplitude(floor);
+    st->clipped = clipped;
+    st->clipped_samples += clipped;
+    st->rms_db10 = audio_level_db10(st->rms);
+    st->peak_db10 = audio_level_db10(st->peak);
+    st->noise_floor_db10 = audio_level_db10(st->noise_floor);
+    publish(lvl);
+}
+
+void audio_level_read(const audio_level_t *lvl, audio_level_stats_t *stats) {
+    if (!stats) return;
+    if (!lvl) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    uint32_t w[LEVEL_WORDS];
+    uint32_t seq;
+    do {
+        seq = lvl->seq.load(std::memory_order_acquire);
+        for (size_t i = 0; i < LEVEL_WORDS; i++) {
+            w[i] = lvl->words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != lvl->seq.load(std::memory_order_relaxed));
+    memcpy(stats, w, sizeof(*stats));
+}
+
+} // extern "C"
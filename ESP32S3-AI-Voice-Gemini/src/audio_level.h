@@ -0,0 +1,68 @@
+#ifndef AUDIO_LEVEL_H
+#define AUDIO_LEVEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming microphone level statistics.
+ *
+ * The capture task measures every 20 ms frame (RMS, peak, samples at full
+ * scale) and tracks a noise floor that falls quickly and rises slowly. The
+ * result is published as a snapshot under a sequence count, so any task,
+ * such as the UI drawing a level meter, can read a consistent copy at any
+ * time without locks and without slowing the capture task down.
+ *
+ * One writer, any number of readers. No platform dependency.
+ */
+
+#define AUDIO_LEVEL_SILENCE_DB10    (-960)  // Reported for digital silence
+
+typedef struct {
+    uint32_t frames;            // Frames measured since reset
+    uint32_t clipped_samples;   // Samples at full scale since reset
+    uint16_t rms;               // Last frame, DC removed
+    uint16_t peak;              // Last frame, absolute
+    uint16_t noise_floor;       // RMS of the background between sounds
+    uint16_t clipped;           // Samples at full scale in the last frame
+    int16_t rms_db10;           // The levels above in dBFS x10
+    int16_t peak_db10;
+    int16_t noise_floor_db10;
+    int16_t reserved;
+} audio_level_stats_t;
+
+typedef struct audio_level audio_level_t;
+
+audio_level_t *audio_level_create(void);
+void audio_level_destroy(audio_level_t *lvl);
+
+/**
+ * @brief Writer side: forget the statistics and the noise floor.
+ */
+void audio_level_reset(audio_level_t *lvl);
+
+/**
+ * @brief Writer side: measure one frame and publish the new snapshot.
+ */
+void audio_level_process(audio_level_t *lvl, const int16_t *pcm, size_t count);
+
+/**
+ * @brief Reader side, any task: copy the latest snapshot. Before the first
+ *        frame the levels read as silence.
+ */
+void audio_level_read(const audio_level_t *lvl, audio_level_stats_t *stats);
+
+/**
+ * @brief dBFS x10 of a 16-bit amplitude, AUDIO_LEVEL_SILENCE_DB10 for 0.
+ */
+int16_t audio_level_db10(uint32_t amplitude);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AUDIO_LEVEL_H
@@ -0,0 +1,355 @@
+// src/audio_ring.cpp - Lock-free multi-reader PCM ring buffer
+
+#include "audio_ring.h"
+#include "psram_alloc.h"
+#include <atomic>
+#include <new>
+#include <string.h>
+
+enum : uint8_t {
+    READER_FREE = 0,
+    READER_CLAIMED,
+    READER_ACTIVE,
+};
+
+struct audio_ring_reader_t {
+    std::atomic<uint32_t> tail;             // Also moved by the producer when lossy
+    std::atomic<uint8_t> state;
+    std::atomic<bool> lossy;
+    std::atomic<uint32_t> skipped;
+};
+
+struct audio_ring {
+    int16_t *buf;
+    uint32_t capacity;
+    uint32_t mask;
+
+    // Written only by the producer
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> filled;           // Valid samples behind head, up to capacity
+    std::atomic<uint32_t> pushed;
+    std::atomic<uint32_t> overruns;
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> skipped;
+
+    // Written by readers
+    std::atomic<uint32_t> underruns;
+    audio_ring_reader_t readers[AUDIO_RING_MAX_READERS];
+};
+
+static bool reader_valid(const audio_ring_t *ring, int reader) {
+    return ring && reader >= 0 && reader < AUDIO_RING_MAX_READERS &&
+           ring->readers[reader].state.load(std::memory_order_acquire) == READER_ACTIVE;
+}
+
+static bool reader_lossy(const audio_ring_t *ring, int reader) {
+    return ring->readers[reader].lossy.load(std::memory_order_relaxed);
+}
+
+// Samples ready for a reader. A lossy reader's tail can be moved between
+// the two loads, which is seen as more than a ring's worth; the caller
+// retries with the new tail.
+static uint32_t reader_avail(const audio_ring_t *ring, int reader, uint32_t *tail) {
+    *tail = ring->readers[reader].tail.load(std::memory_order_acquire);
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    return head - *tail;
+}
+
+// Move lossy readers that would be overwritten by n more samples past the
+// oldest ones. Runs before the samples are written, so a reader copying
+// from that region sees its tail change and copies again.
+static void skip_lossy_readers(audio_ring_t *ring, uint32_t head, uint32_t n) {
+    for (int i = 0; i < AUDIO_RING_MAX_READERS; i++) {
+        audio_ring_reader_t *r = &ring->readers[i];
+        if (r->state.load(std::memory_order_acquire) != READER_ACTIVE ||
+            !r->lossy.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        uint32_t tail = r->tail.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t used = head - tail;
+            if (used + n <= ring->capacity) break;
+            uint32_t skip = used + n - ring->capacity;
+            if (r->tail.compare_exchange_weak(tail, tail + skip, std::memory_order_acq_rel)) {
+                r->skipped.fetch_add(skip, std::memory_order_relaxed);
+                ring->skipped.fetch_add(skip, std::memory_order_relaxed);
+                break;
+            }
+        }
+    }
+}
+
+static int reader_open(audio_ring_t *ring, size_t history, bool lossy) {
+    if (!ring) return -1;
+
+    for (int i = 0; i < AUDIO_RING_MAX_READERS; i++) {
+        uint8_t expected = READER_FREE;
+        if (ring->readers[i].state.compare_exchange_strong(expected, READER_CLAIMED,
+                                                           std::memory_order_acq_rel)) {
+            // The producer may push once more before it sees this reader,
+            // which is why history is limited to half the ring
+            size_t max_history = audio_ring_history(ring);
+            if (history > max_history) history = max_history;
+            uint32_t head = ring->head.load(std::memory_order_acquire);
+            ring->readers[i].tail.store(head - (uint32_t)history, std::memory_order_relaxed);
+            ring->readers[i].lossy.store(lossy, std::memory_order_relaxed);
+            ring->readers[i].skipped.store(0, std::memory_order_relaxed);
+            ring->readers[i].state.store(READER_ACTIVE, std::memory_order_release);
+            return i;
+        }
+    }
+    return -1;
+}
+
+extern "C" {
+
+audio_ring_t *audio_ring_create(size_t capacity) {
+    if (capacity == 0 || capacity > (1u << 30)) {
+        return NULL;
+    }
+
+    uint32_t cap = 1;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    audio_ring_t *ring = new (std::nothrow) audio_ring();
+    if (!ring) {
+        return NULL;
+    }
+
+    ring->buf = (int16_t *)psram_calloc(cap, sizeof(int16_t));
+    if (!ring->buf) {
+        delete ring;
+        return NULL;
+    }
+
+    ring->capacity = cap;
+    ring->mask = cap - 1;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->filled.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < AUDIO_RING_MAX_READERS; i++) {
+        ring->readers[i].tail.store(0, std::memory_order_relaxed);
+        ring->readers[i].state.store(READER_FREE, std::memory_order_relaxed);
+        ring->readers[i].lossy.store(false, std::memory_order_relaxed);
+        ring->readers[i].skipped.store(0, std::memory_order_relaxed);
+    }
+    audio_ring_reset_stats(ring);
+    return ring;
+}
+
+void audio_ring_destroy(audio_ring_t *ring) {
+    if (!ring) return;
+    free(ring->buf);
+    delete ring;
+}
+
+size_t audio_ring_capacity(const audio_ring_t *ring) {
+    return ring ? ring->capacity : 0;
+}
+
+size_t audio_ring_push(audio_ring_t *ring, const int16_t *samples, size_t count) {
+    if (!ring || !samples || count == 0) return 0;
+
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+
+    // The slowest active reader limits how much can be written; lossy
+    // readers are skipped ahead instead
+    uint32_t space = ring->capacity;
+    for (int i = 0; i < AUDIO_RING_MAX_READERS; i++) {
+        if (ring->readers[i].state.load(std::memory_order_acquire) != READER_ACTIVE ||
+            ring->readers[i].lossy.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        uint32_t tail = ring->readers[i].tail.load(std::memory_order_acquire);
+        uint32_t free_space = ring->capacity - (head - tail);
+        if (free_space < space) {
+            space = free_space;
+        }
+    }
+
+    uint32_t n = count < space ? (uint32_t)count : space;
+    if (n > 0) {
+        skip_lossy_readers(ring, head, n);
+        uint32_t idx = head & ring->mask;
+        uint32_t first = ring->capacity - idx;
+        if (first > n) first = n;
+        memcpy(ring->buf + idx, samples, first * sizeof(int16_t));
+        if (n > first) {
+            memcpy(ring->buf, samples + first, (n - first) * sizeof(int16_t));
+        }
+        ring->head.store(head + n, std::memory_order_release);
+        uint32_t filled = ring->filled.load(std::memory_order_relaxed);
+        if (filled < ring->capacity) {
+            filled = ring->capacity - filled > n ? filled + n : ring->capacity;
+            ring->filled.store(filled, std::memory_order_relaxed);
+        }
+        ring->pushed.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    if (n < count) {
+        ring->overruns.fetch_add(1, std::memory_order_relaxed);
+        ring->dropped.fetch_add((uint32_t)(count - n), std::memory_order_relaxed);
+    }
+    return n;
+}
+
+int audio_ring_reader_open(audio_ring_t *ring) {
+    return audio_ring_reader_open_at(ring, 0);
+}
+
+int audio_ring_reader_open_at(audio_ring_t *ring, size_t history) {
+    return reader_open(ring, history, false);
+}
+
+int audio_ring_reader_open_lossy(audio_ring_t *ring, size_t history) {
+    return reader_open(ring, history, true);
+}
+
+uint32_t audio_ring_reader_skipped(const audio_ring_t *ring, int reader) {
+    if (!reader_valid(ring, reader)) return 0;
+    return ring->readers[reader].skipped.load(std::memory_order_relaxed);
+}
+
+size_t audio_ring_history(const audio_ring_t *ring) {
+    if (!ring) return 0;
+    uint32_t filled = ring->filled.load(std::memory_order_relaxed);
+    uint32_t half = ring->capacity / 2;
+    return filled < half ? filled : half;
+}
+
+void audio_ring_reader_close(audio_ring_t *ring, int reader) {
+    if (!reader_valid(ring, reader)) return;
+    ring->readers[reader].state.store(READER_FREE, std::memory_order_release);
+}
+
+size_t audio_ring_available(const audio_ring_t *ring, int reader) {
+    if (!reader_valid(ring, reader)) return 0;
+    uint32_t tail;
+    uint32_t avail = reader_avail(ring, reader, &tail);
+    return avail < ring->capacity ? avail : ring->capacity;
+}
+
+size_t audio_ring_peek(const audio_ring_t *ring, int reader,
+                       const int16_t **span1, size_t *len1,
+                       const int16_t **span2, size_t *len2) {
+    if (span1) *span1 = NULL;
+    if (len1) *len1 = 0;
+    if (span2) *span2 = NULL;
+    if (len2) *len2 = 0;
+    if (!reader_valid(ring, reader) || reader_lossy(ring, reader)) return 0;
+
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    uint32_t tail = ring->readers[reader].tail.load(std::memory_order_relaxed);
+    uint32_t avail = head - tail;
+    if (avail == 0) return 0;
+
+    uint32_t idx = tail & ring->mask;
+    uint32_t first = ring->capacity - idx;
+    if (first > avail) first = avail;
+
+    if (span1) *span1 = ring->buf + idx;
+    if (len1) *len1 = first;
+    if (avail > first) {
+        if (span2) *span2 = ring->buf;
+        if (len2) *len2 = avail - first;
+    }
+    return avail;
+}
+
+void audio_ring_consume(audio_ring_t *ring, int reader, size_t count) {
+    if (!reader_valid(ring, reader) || count == 0) return;
+
+    if (reader_lossy(ring, reader)) {
+        // The producer may move the tail too; never step back behind it
+        uint32_t tail;
+        for (;;) {
+            uint32_t avail = reader_avail(ring, reader, &tail);
+            uint32_t n = count < avail ? (uint32_t)count : avail;
+            if (ring->readers[reader].tail.compare_exchange_weak(tail, tail + n,
+                                                                 std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+    }
+
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    uint32_t tail = ring->readers[reader].tail.load(std::memory_order_relaxed);
+    uint32_t avail = head - tail;
+    if (count > avail) count = avail;
+    ring->readers[reader].tail.store(tail + (uint32_t)count, std::memory_order_release);
+}
+
+// Copy n samples starting at position pos
+static void copy_out(const audio_ring_t *ring, uint32_t pos, int16_t *dst, size_t n) {
+    uint32_t idx = pos & ring->mask;
+    size_t first = ring->capacity - idx;
+    if (first > n) first = n;
+    memcpy(dst, ring->buf + idx, first * sizeof(int16_t));
+    if (n > first) {
+        memcpy(dst + first, ring->buf, (n - first) * sizeof(int16_t));
+    }
+}
+
+// A lossy read: copy, then claim the samples. If the producer moved the
+// tail meanwhile, what was copied may have been overwritten; copy again
+// from the new tail.
+static size_t read_lossy(audio_ring_t *ring, int reader, int16_t *dst, size_t count) {
+    std::atomic<uint32_t> *tail_ptr = &ring->readers[reader].tail;
+    for (;;) {
+        uint32_t tail;
+        uint32_t avail = reader_avail(ring, reader, &tail);
+        if (avail > ring->capacity) continue;
+        size_t n = avail < count ? avail : count;
+        copy_out(ring, tail, dst, n);
+        if (tail_ptr->compare_exchange_strong(tail, tail + (uint32_t)n, std::memory_order_acq_rel)) {
+            if (n < count) ring->underruns.fetch_add(1, std::memory_order_relaxed);
+            return n;
+        }
+    }
+}
+
+size_t audio_ring_read(audio_ring_t *ring, int reader, int16_t *dst, size_t count) {
+    if (!dst || count == 0) return 0;
+    if (reader_valid(ring, reader) && reader_lossy(ring, reader)) {
+        return read_lossy(ring, reader, dst, count);
+    }
+
+    const int16_t *s1, *s2;
+    size_t n1, n2;
+    size_t avail = audio_ring_peek(ring, reader, &s1, &n1, &s2, &n2);
+    if (avail < count) {
+        if (ring) ring->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t n = avail < count ? avail : count;
+    size_t first = n < n1 ? n : n1;
+    if (first > 0) {
+        memcpy(dst, s1, first * sizeof(int16_t));
+    }
+    if (n > first) {
+        memcpy(dst + first, s2, (n - first) * sizeof(int16_t));
+    }
+    audio_ring_consume(ring, reader, n);
+    return n;
+}
+
+void audio_ring_get_stats(const audio_ring_t *ring, audio_ring_stats_t *stats) {
+    if (!ring || !stats) return;
+    stats->pushed = ring->pushed.load(std::memory_order_relaxed);
+    stats->overruns = ring->overruns.load(std::memory_order_relaxed);
+    stats->dropped = ring->dropped.load(std::memory_order_relaxed);
+    stats->underruns = ring->underruns.load(std::memory_order_relaxed);
+    stats->skipped = ring->skipped.load(std::memory_order_relaxed);
+}
+
+void audio_ring_reset_stats(audio_ring_t *ring) {
+    if (!ring) return;
+    ring->pushed.store(0, std::memory_order_relaxed);
+    ring->overruns.store(0, std::memory_order_relaxed);
+    ring->dropped.store(0, std::memory_order_relaxed);
+    ring->underruns.store(0, std::memory_order_relaxed);
+    ring->skipped.store(0, std::memory_order_relaxed);
+}
+
+} // extern "C"
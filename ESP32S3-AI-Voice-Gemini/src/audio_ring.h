@@ -0,0 +1,127 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of concurrent readers (encoder, uploader, level meter, ...)
+#define AUDIO_RING_MAX_READERS  4
+
+/**
+ * Lock-free ring of 16-bit PCM samples.
+ *
+ * There is exactly one producer (the capture task) and up to
+ * AUDIO_RING_MAX_READERS readers. Each reader owns its own read cursor, so
+ * every reader is a single-producer/single-consumer channel and no locks are
+ * needed on either side. The producer never blocks: if a reader is too far
+ * behind, the samples that do not fit are dropped and counted as an overrun.
+ *
+ * A lossy reader (audio_ring_reader_open_lossy) never holds the producer
+ * back. When it falls a full ring behind, the producer moves its cursor
+ * past the oldest samples instead and counts them as skipped; the other
+ * readers lose nothing. Meant for readers that may stall on I/O, such as
+ * the uploader.
+ */
+typedef struct audio_ring audio_ring_t;
+
+typedef struct {
+    uint32_t pushed;        // Samples accepted by the producer
+    uint32_t overruns;      // Push calls that had to drop samples
+    uint32_t dropped;       // Samples dropped because a reader was full
+    uint32_t underruns;     // Reads that got fewer samples than requested
+    uint32_t skipped;       // Samples lossy readers were moved past
+} audio_ring_stats_t;
+
+/**
+ * @brief Create a ring. Storage is allocated once, from PSRAM when present.
+ * @param capacity Capacity in samples, rounded up to a power of two
+ * @return The ring, or NULL if allocation failed
+ */
+audio_ring_t *audio_ring_create(size_t capacity);
+void audio_ring_destroy(audio_ring_t *ring);
+size_t audio_ring_capacity(const audio_ring_t *ring);
+
+/**
+ * @brief Producer side: append samples.
+ * @return Number of samples stored (less than count on overrun)
+ */
+size_t audio_ring_push(audio_ring_t *ring, const int16_t *samples, size_t count);
+
+/**
+ * @brief Open a reader positioned at the current write position.
+ * @return Reader id, or -1 if all reader slots are in use
+ */
+int audio_ring_reader_open(audio_ring_t *ring);
+
+/**
+ * @brief Open a reader positioned history samples behind the write position,
+ *        so audio captured before the reader existed can be read in place.
+ *
+ * history is clamped to what the ring has actually been written with and to
+ * half its capacity; the other half absorbs the producer while the reader
+ * is being opened.
+ *
+ * @return Reader id, or -1 if all reader slots are in use
+ */
+int audio_ring_reader_open_at(audio_ring_t *ring, size_t history);
+
+/**
+ * @brief Largest history audio_ring_reader_open_at() can currently provide.
+ */
+size_t audio_ring_history(const audio_ring_t *ring);
+
+/**
+ * @brief Open a lossy reader history samples behind the write position
+ *        (clamped as for audio_ring_reader_open_at). The producer skips it
+ *        ahead rather than dropping samples for everyone when it lags.
+ *
+ * Read it with audio_ring_read() only: peek spans can be overwritten
+ * while they are in use, so audio_ring_peek() returns nothing for it.
+ *
+ * @return Reader id, or -1 if all reader slots are in use
+ */
+int audio_ring_reader_open_lossy(audio_ring_t *ring, size_t history);
+
+/**
+ * @brief Samples a lossy reader has been moved past since it was opened.
+ */
+uint32_t audio_ring_reader_skipped(const audio_ring_t *ring, int reader);
+void audio_ring_reader_close(audio_ring_t *ring, int reader);
+
+/**
+ * @brief Number of samples ready for the given reader.
+ */
+size_t audio_ring_available(const audio_ring_t *ring, int reader);
+
+/**
+ * @brief Copy up to count samples out of the ring and consume them.
+ * @return Number of samples copied
+ */
+size_t audio_ring_read(audio_ring_t *ring, int reader, int16_t *dst, size_t count);
+
+/**
+ * @brief Zero-copy access to readable samples.
+ *
+ * Returns up to two contiguous spans (the second one is used when the data
+ * wraps around the end of the storage). Call audio_ring_consume() once the
+ * samples have been processed.
+ *
+ * @return Total number of samples in both spans
+ */
+size_t audio_ring_peek(const audio_ring_t *ring, int reader,
+                       const int16_t **span1, size_t *len1,
+                       const int16_t **span2, size_t *len2);
+void audio_ring_consume(audio_ring_t *ring, int reader, size_t count);
+
+void audio_ring_get_stats(const audio_ring_t *ring, audio_ring_stats_t *stats);
+void audio_ring_reset_stats(audio_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AUDIO_RING_H
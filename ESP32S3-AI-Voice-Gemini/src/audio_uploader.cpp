@@ -0,0 +1,289 @@
+// src/audio_uploader.cpp - Stream captured audio with HTTP chunked transfer
+
+#include "audio_uploader.h"
+#include "upload_stream.h"
+#include "http_session.h"
+#include "tls_conn.h"
+#include "ui_manager.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <string.h>
+
+static const char *TAG = "UPLOAD";
+
+#define UPLOAD_TASK_STACK       8192
+#define UPLOAD_TASK_PRIORITY    3
+#define UPLOAD_TASK_CORE        0
+#define UPLOAD_POLL_MS          20
+#define UPLOAD_MIN_CHUNK        1600        // 100 ms at 16 kHz; smaller writes waste TCP segments
+#define UPLOAD_MAX_CHUNK        8000        // Samples taken from the ring at once
+#define UPLOAD_TIMEOUT_MS       15000
+#define UPLOAD_MAX_RESPONSE     2048
+
+static TaskHandle_t s_task_handle = NULL;
+static SemaphoreHandle_t s_done = NULL;
+static audio_ring_t *s_ring = NULL;
+static int s_reader = -1;
+static volatile bool s_finish = false;
+static volatile bool s_abort = false;
+static uint32_t s_begin_ms = 0;
+static uint32_t s_finish_ms = 0;
+static char *s_result = NULL;
+static audio_uploader_stats_t s_stats;
+
+static char s_host[96];
+static char s_path[160];
+static char s_content_type[48];
+static uint16_t s_port = 80;
+static bool s_secure = false;
+static upload_stream_t s_stream;
+
+// Kept open between uploads to the same endpoint
+static tls_conn_t *s_conn = NULL;
+static bool s_conn_secure = false;
+
+static bool parse_url(const char *url) {
+    const char *p = url;
+    if (strncmp(p, "https://", 8) == 0) {
+        s_secure = true;
+        s_port = 443;
+        p += 8;
+    } else if (strncmp(p, "http://", 7) == 0) {
+        s_secure = false;
+        s_port = 80;
+        p += 7;
+    } else {
+        return false;
+    }
+
+    const char *path = strchr(p, '/');
+    const char *host_end = path ? path : p + strlen(p);
+    const char *colon = (const char *)memchr(p, ':', host_end - p);
+    const char *name_end = colon ? colon : host_end;
+
+    size_t host_len = name_end - p;
+    if (host_len == 0 || host_len >= sizeof(s_host)) return false;
+    memcpy(s_host, p, host_len);
+    s_host[host_len] = '\0';
+
+    if (colon) {
+        s_port = (uint16_t)atoi(colon + 1);
+    }
+
+    strncpy(s_path, path ? path : "/", sizeof(s_path) - 1);
+    s_path[sizeof(s_path) - 1] = '\0';
+    return true;
+}
+
+static tls_conn_t *upload_conn(void) {
+    if (s_conn && (s_conn_secure != s_secure || tls_conn_port(s_conn) != s_port ||
+                   strcmp(tls_conn_host(s_conn), s_host) != 0)) {
+        tls_conn_destroy(s_conn);
+        s_conn = NULL;
+    }
+    if (!s_conn) {
+        s_conn = tls_conn_create(tls_transport_mbedtls_create(s_secure), s_host, s_port, NULL);
+        s_conn_secure = s_secure;
+    }
+    return s_conn;
+}
+
+static void sleep_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+// The request body: upload_stream_body() with the timings taken around it
+static size_t upload_body(void *ctx, size_t offset, char *buf, size_t cap) {
+    if (offset == 0) {
+        s_stats.connect_ms = millis() - s_begin_ms;
+    }
+    size_t n = upload_stream_body(ctx, offset, buf, cap);
+    if (n == 0) {
+        s_stats.tail_ms = millis() - s_finish_ms;
+    } else if (s_stats.first_chunk_ms == 0 && s_stream.bytes > 0) {
+        s_stats.first_chunk_ms = millis() - s_begin_ms;
+    }
+    s_stats.chunks = s_stream.chunks;
+    s_stats.bytes = s_stream.bytes;
+    s_stats.samples_skipped = s_stream.skipped;
+    return n;
+}
+
+static void upload_task(void *pvParameters) {
+    char *result = NULL;
+    tls_conn_t *conn = upload_conn();
+    int status = HTTP_SESSION_ERR_CONNECT;
+
+    if (conn) {
+        http_request_t req = {};
+        req.method = "POST";
+        req.path = s_path;
+        req.content_type = s_content_type;
+        req.body_fn = upload_body;
+        req.body_ctx = &s_stream;
+        req.body_len = HTTP_SESSION_CHUNKED_BODY;
+        req.timeout_ms = UPLOAD_TIMEOUT_MS;
+        req.cancel = &s_abort;
+
+        // The body is streamed while capture runs; the reply is decoded
+        // whatever its framing (Content-Length, chunked or until close)
+        http_session_t session;
+        status = http_session_begin(&session, conn, &req);
+        if (status > 0) {
+            s_stats.http_status = status;
+            result = http_session_read_body(&session, UPLOAD_MAX_RESPONSE, NULL);
+            s_stats.response_ms = millis() - s_finish_ms;
+        }
+        http_session_end(&session);
+    }
+
+    if (s_abort) {
+        logi(TAG, "Upload aborted after %u bytes", (unsigned)s_stats.bytes);
+    } else if (status <= 0) {
+        loge(TAG, "Upload to %s:%d failed after %u bytes: %s", s_host, s_port,
+             (unsigned)s_stats.bytes, http_session_error_name(status));
+    } else if (status != 200) {
+        loge(TAG, "Upload failed: HTTP %d", status);
+        free(result);
+        result = NULL;
+    } else if (!result) {
+        loge(TAG, "Upload response lost");
+    } else {
+        if (s_stats.samples_skipped > 0) {
+            logw(TAG, "Upload fell behind capture, %u samples skipped",
+                 (unsigned)s_stats.samples_skipped);
+        }
+        logi(TAG, "Uploaded %u bytes (%s) in %u chunks, tail %u ms, response %u ms",
+             (unsigned)s_stats.bytes, s_stream.encode ? audio_codec_name(s_stream.encoder.id) : "pcm16",
+             (unsigned)s_stats.chunks,
+             (unsigned)s_stats.tail_ms, (unsigned)s_stats.response_ms);
+    }
+
+    audio_ring_reader_close(s_ring, s_reader);
+    s_reader = -1;
+
+    s_result = s_abort ? NULL : result;
+    if (s_abort && result) free(result);
+
+    s_task_handle = NULL;
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+extern "C" {
+
+esp_err_t audio_uploader_begin(const char *url, audio_ring_t *ring, size_t history,
+                               const audio_encoder_t *encoder,
+                               const void *header, size_t header_len,
+                               const char *content_type) {
+    if (s_task_handle) {
+        logw(TAG, "Upload already in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!url || !ring || header_len > UPLOAD_STREAM_HEADER_MAX || !parse_url(url)) {
+        loge(TAG, "Invalid upload parameters");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+        loge(TAG, "WiFi not connected!");
+        return ESP_FAIL;
+    }
+
+    if (!s_done) {
+        s_done = xSemaphoreCreateBinary();
+        if (!s_done) return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(s_done, 0);
+
+    if (s_result) {
+        free(s_result);
+        s_result = NULL;
+    }
+
+    // Lossy: a stalled upload must not hold the capture back for the
+    // wake word detector and the recorder
+    s_reader = audio_ring_reader_open_lossy(ring, history);
+    if (s_reader < 0) {
+        loge(TAG, "No free capture ring reader");
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_ring = ring;
+    static const upload_stream_config_t cfg = {
+        UPLOAD_MIN_CHUNK, UPLOAD_MAX_CHUNK, UPLOAD_POLL_MS, sleep_ms,
+    };
+    if (!upload_stream_init(&s_stream, &cfg, ring, s_reader, &s_finish, &s_abort,
+                            encoder, header, header_len)) {
+        loge(TAG, "Out of memory for the upload buffers");
+        audio_ring_reader_close(ring, s_reader);
+        s_reader = -1;
+        return ESP_ERR_NO_MEM;
+    }
+    strncpy(s_content_type, content_type ? content_type : "application/octet-stream",
+            sizeof(s_content_type) - 1);
+    s_content_type[sizeof(s_content_type) - 1] = '\0';
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_finish = false;
+    s_abort = false;
+    s_begin_ms = millis();
+    s_finish_ms = s_begin_ms;
+
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        upload_task,
+        "audio_upload",
+        UPLOAD_TASK_STACK,
+        NULL,
+        UPLOAD_TASK_PRIORITY,
+        &s_task_handle,
+        UPLOAD_TASK_CORE
+    );
+    if (ok != pdPASS) {
+        audio_ring_reader_close(ring, s_reader);
+        s_reader = -1;
+        s_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    logi(TAG, "Streaming upload to %s:%d%s", s_host, s_port, s_path);
+    return ESP_OK;
+}
+
+void audio_uploader_finish(void) {
+    if (!s_task_handle) return;
+    s_finish_ms = millis();
+    s_finish = true;
+}
+
+char *audio_uploader_wait_result(uint32_t timeout_ms) {
+    if (!s_done) return NULL;
+    if (s_task_handle && xSemaphoreTake(s_done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        logw(TAG, "Upload result timed out");
+        return NULL;
+    }
+    char *result = s_result;
+    s_result = NULL;
+    return result;
+}
+
+void audio_uploader_abort(void) {
+    if (!s_task_handle) return;
+    s_abort = true;
+    s_finish = true;
+    if (s_done) {
+        xSemaphoreTake(s_done, pdMS_TO_TICKS(UPLOAD_TIMEOUT_MS));
+    }
+}
+
+bool audio_uploader_is_active(void) {
+    return s_task_handle != NULL;
+}
+
+void audio_uploader_get_stats(audio_uploader_stats_t *stats) {
+    if (stats) *stats = s_stats;
+}
+
+} // extern "C"
@@ -0,0 +1,66 @@
+#ifndef AUDIO_UPLOADER_H
+#define AUDIO_UPLOADER_H
+
+#include "esp_err.h"
+#include "audio_ring.h"
+#include "audio_codec.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t chunks;            // HTTP chunks sent, including the header chunk
+    uint32_t bytes;             // Encoded audio payload bytes sent
+    uint32_t samples_skipped;   // Audio lost while the connection stalled
+    uint32_t connect_ms;        // begin() -> connected and request head sent
+    uint32_t first_chunk_ms;    // begin() -> first audio chunk written
+    uint32_t tail_ms;           // finish() -> final chunk written
+    uint32_t response_ms;       // finish() -> response body received
+    int http_status;
+} audio_uploader_stats_t;
+
+/**
+ * @brief Start streaming audio from the ring to url with HTTP chunked
+ *        transfer. A dedicated task reads the ring through its own lossy
+ *        reader, so audio is uploaded while the user is still talking and
+ *        a stalled connection skips audio rather than stopping capture. The
+ *        connection is kept open for the next upload to the same host.
+ * @param url http:// or https:// endpoint that accepts a chunked body
+ * @param history Samples already in the ring to send first (pre-roll)
+ * @param encoder Encoder state to continue from (copied), or NULL to send raw
+ *        PCM16 straight from the ring
+ * @param header Container header sent as the first chunk (e.g. WAV), may be NULL
+ * @param content_type Value of the Content-Type request header
+ */
+esp_err_t audio_uploader_begin(const char *url, audio_ring_t *ring, size_t history,
+                               const audio_encoder_t *encoder,
+                               const void *header, size_t header_len,
+                               const char *content_type);
+
+/**
+ * @brief Signal that capture has ended. The task sends what is left in
+ *        the ring, terminates the chunked body and reads the response.
+ */
+void audio_uploader_finish(void);
+
+/**
+ * @brief Wait for the upload to complete.
+ * @return The response body (caller frees), or NULL on error/timeout
+ */
+char *audio_uploader_wait_result(uint32_t timeout_ms);
+
+/**
+ * @brief Abort an upload in progress and discard its result.
+ */
+void audio_uploader_abort(void);
+
+bool audio_uploader_is_active(void);
+void audio_uploader_get_stats(audio_uploader_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AUDIO_UPLOADER_H
@@ -0,0 +1,194 @@
+// src/base64_stream.cpp - Streaming base64 encoder with a fixed output window
+
+#include "base64_stream.h"
+#include <atomic>
+#include <string.h>
+
+static const char B64_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Both chars for every 12-bit half of a group, first char in the low byte
+static uint16_t s_pairs[4096];
+static std::atomic<bool> s_pairs_ready(false);
+
+static void build_pairs(void) {
+    for (uint32_t v = 0; v < 4096; v++) {
+        s_pairs[v] = (uint16_t)((uint8_t)B64_ALPHABET[v >> 6] |
+                                ((uint16_t)(uint8_t)B64_ALPHABET[v & 0x3F] << 8));
+    }
+    // Racing initialisers write the same values
+    s_pairs_ready.store(true, std::memory_order_release);
+}
+
+static inline void encode_group(uint32_t v, char *out) {
+    out[0] = B64_ALPHABET[(v >> 18) & 0x3F];
+    out[1] = B64_ALPHABET[(v >> 12) & 0x3F];
+    out[2] = B64_ALPHABET[(v >> 6) & 0x3F];
+    out[3] = B64_ALPHABET[v & 0x3F];
+}
+
+// Final group of 1 or 2 bytes, padded with '='
+static void encode_tail(const uint8_t *in, size_t n, char *out) {
+    uint32_t v = (uint32_t)in[0] << 16;
+    if (n > 1) v |= (uint32_t)in[1] << 8;
+    encode_group(v, out);
+    out[3] = '=';
+    if (n < 2) out[2] = '=';
+}
+
+extern "C" {
+
+void base64_encode_groups_ref(const uint8_t *in, size_t groups, char *out) {
+    for (size_t g = 0; g < groups; g++, in += 3, out += 4) {
+        encode_group(((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2], out);
+    }
+}
+
+void base64_encode_groups_table(const uint8_t *in, size_t groups, char *out) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (!s_pairs_ready.load(std::memory_order_acquire)) {
+        build_pairs();
+    }
+    // Whole-word loads read one byte past the group, so the last group
+    // goes through the byte path
+    size_t g = 0;
+    for (; g + 1 < groups; g++, in += 3, out += 4) {
+        uint32_t w;
+        memcpy(&w, in, sizeof(w));
+        uint32_t v = __builtin_bswap32(w) >> 8;
+        uint32_t chars = s_pairs[v >> 12] | ((uint32_t)s_pairs[v & 0xFFF] << 16);
+        memcpy(out, &chars, sizeof(chars));
+    }
+    if (g < groups) {
+        uint32_t v = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+        uint32_t chars = s_pairs[v >> 12] | ((uint32_t)s_pairs[v & 0xFFF] << 16);
+        memcpy(out, &chars, sizeof(chars));
+    }
+#else
+    base64_encode_groups_ref(in, groups, out);
+#endif
+}
+
+void base64_encode_groups(const uint8_t *in, size_t groups, char *out) {
+    base64_encode_groups_table(in, groups, out);
+}
+
+size_t base64_encode(const void *in, size_t len, char *out) {
+    const uint8_t *p = (const uint8_t *)in;
+    size_t groups = len / 3;
+    base64_encode_groups(p, groups, out);
+    if (len % 3) {
+        encode_tail(p + groups * 3, len % 3, out + groups * 4);
+    }
+    return BASE64_ENCODED_SIZE(len);
+}
+
+void base64_stream_init(base64_stream_t *st) {
+    if (st) memset(st, 0, sizeof(*st));
+}
+
+size_t base64_stream_update(base64_stream_t *st, const void *in, size_t len, char *out) {
+    const uint8_t *p = (const uint8_t *)in;
+    size_t written = 0;
+
+    // Complete the group left over from the previous call
+    if (st->carry_len > 0) {
+        uint8_t group[3];
+        memcpy(group, st->carry, st->carry_len);
+        size_t need = 3 - st->carry_len;
+        if (len < need) {
+            memcpy(st->carry + st->carry_len, p, len);
+            st->carry_len += (uint8_t)len;
+            return 0;
+        }
+        memcpy(group + st->carry_len, p, need);
+        base64_encode_groups_ref(group, 1, out);
+        written = 4;
+        p += need;
+        len -= need;
+        st->carry_len = 0;
+    }
+
+    size_t groups = len / 3;
+    base64_encode_groups(p, groups, out + written);
+    written += groups * 4;
+
+    st->carry_len = (uint8_t)(len - groups * 3);
+    memcpy(st->carry, p + groups * 3, st->carry_len);
+    return written;
+}
+
+size_t base64_stream_finish(base64_stream_t *st, char *out) {
+    if (st->carry_len == 0) return 0;
+    encode_tail(st->carry, st->carry_len, out);
+    st->carry_len = 0;
+    return 4;
+}
+
+static bool writer_flush(base64_writer_t *w) {
+    if (w->fill > 0 && !w->failed) {
+        w->failed = !w->write(w->ctx, w->window, w->fill);
+        w->written += w->fill;
+    }
+    w->fill = 0;
+    return !w->failed;
+}
+
+bool base64_writer_init(base64_writer_t *w, char *window, size_t window_size,
+                        base64_write_fn write, void *ctx) {
+    if (!w) return false;
+    memset(w, 0, sizeof(*w));
+    window_size &= ~(size_t)3;
+    if (!window || window_size < 4 || !write) {
+        w->failed = true;
+        return false;
+    }
+    w->window = window;
+    w->window_size = window_size;
+    w->write = write;
+    w->ctx = ctx;
+    return true;
+}
+
+bool base64_writer_put(base64_writer_t *w, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0 && !w->failed) {
+        if (w->fill == w->window_size && !writer_flush(w)) break;
+
+        // A partial group only ever needs one more output group
+        base64_stream_t *st = &w->stream;
+        if (st->carry_len > 0) {
+            size_t need = 3 - (size_t)st->carry_len;
+            size_t take = need < len ? need : len;
+            w->fill += base64_stream_update(st, p, take, w->window + w->fill);
+            p += take;
+            len -= take;
+            continue;
+        }
+
+        // Whole groups straight into the window, as many as fit
+        size_t room = (w->window_size - w->fill) / 4;
+        size_t groups = len / 3 < room ? len / 3 : room;
+        if (groups == 0) {
+            memcpy(st->carry, p, len);
+            st->carry_len = (uint8_t)len;
+            break;
+        }
+        base64_encode_groups(p, groups, w->window + w->fill);
+        w->fill += groups * 4;
+        p += groups * 3;
+        len -= groups * 3;
+    }
+    return !w->failed;
+}
+
+bool base64_writer_finish(base64_writer_t *w) {
+    if (w->failed) return false;
+    if (w->stream.carry_len > 0) {
+        if (w->fill == w->window_size && !writer_flush(w)) return false;
+        w->fill += base64_stream_finish(&w->stream, w->window + w->fill);
+    }
+    return writer_flush(w);
+}
+
+} // extern "C"
@@ -0,0 +1,112 @@
+#ifndef BASE64_STREAM_H
+#define BASE64_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming base64 (RFC 4648, standard alphabet, padded, no line breaks).
+ *
+ * Input can arrive in pieces of any size, such as the two spans of a
+ * capture ring peek: up to two bytes that do not fill a group are carried
+ * to the next call. The writer encodes through a fixed window and hands
+ * each full window to a write function (a TCP or TLS socket), so uploading
+ * N bytes costs one window of memory instead of the 4N/3-byte String the
+ * Arduino base64 library builds.
+ *
+ * No platform dependency.
+ */
+
+#define BASE64_ENCODED_SIZE(n)  (((n) + 2) / 3 * 4)
+
+/**
+ * @brief Portable scalar reference: one group of 3 bytes at a time, each
+ *        6-bit index looked up in the alphabet.
+ * @param groups Number of whole 3-byte groups in in; writes 4 * groups chars
+ */
+void base64_encode_groups_ref(const uint8_t *in, size_t groups, char *out);
+
+/**
+ * @brief Table-driven version: each group is two lookups in a table of the
+ *        4096 possible 12-bit halves (8 KB, built on first use), with the
+ *        input read and the output written a word at a time.
+ */
+void base64_encode_groups_table(const uint8_t *in, size_t groups, char *out);
+
+/**
+ * @brief Encode whole groups with the fastest implementation.
+ */
+void base64_encode_groups(const uint8_t *in, size_t groups, char *out);
+
+/**
+ * @brief Encode a complete buffer, padded. out must hold
+ *        BASE64_ENCODED_SIZE(len) chars; no terminator is written.
+ * @return Number of chars written
+ */
+size_t base64_encode(const void *in, size_t len, char *out);
+
+typedef struct {
+    uint8_t carry[2];           // Input bytes waiting for a whole group
+    uint8_t carry_len;
+} base64_stream_t;
+
+void base64_stream_init(base64_stream_t *st);
+
+/**
+ * @brief Encode the next len bytes. Only whole groups are written; the
+ *        rest is carried. out must hold BASE64_ENCODED_SIZE(len + 2) chars.
+ * @return Number of chars written
+ */
+size_t base64_stream_update(base64_stream_t *st, const void *in, size_t len, char *out);
+
+/**
+ * @brief Pad and write the carried bytes: 0 or 4 chars.
+ */
+size_t base64_stream_finish(base64_stream_t *st, char *out);
+
+/**
+ * Writes len bytes to the destination. Returns false on failure, which
+ * stops the writer.
+ */
+typedef bool (*base64_write_fn)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    base64_stream_t stream;
+    char *window;
+    size_t window_size;         // Multiple of 4, at least 4
+    size_t fill;                // Chars waiting in the window
+    base64_write_fn write;
+    void *ctx;
+    size_t written;             // Chars handed to write so far
+    bool failed;
+} base64_writer_t;
+
+/**
+ * @brief Encode into window and flush it through write whenever it is
+ *        full. window_size is rounded down to a multiple of 4.
+ * @return false if the window is smaller than 4 chars or write is NULL
+ */
+bool base64_writer_init(base64_writer_t *w, char *window, size_t window_size,
+                        base64_write_fn write, void *ctx);
+
+/**
+ * @brief Encode len more bytes; call as often as needed.
+ * @return false once a write has failed
+ */
+bool base64_writer_put(base64_writer_t *w, const void *data, size_t len);
+
+/**
+ * @brief Pad and flush everything still in the window.
+ * @return false if any write failed
+ */
+bool base64_writer_finish(base64_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // BASE64_STREAM_H
@@ -0,0 +1,248 @@
+// src/capture_pipeline.cpp - Mic frame processing from I2S samples to the capture ring
+
+#include "capture_pipeline.h"
+#include "audio_hal.h"
+#include "audio_dsp.h"
+#include "pcm_convert.h"
+#include "resampler.h"
+#include "aec.h"
+#include "echo_ref.h"
+#include "denoise.h"
+#include "audio_level.h"
+#include <new>
+#include <string.h>
+
+// Front-end chain, run on the 32-bit samples before they are narrowed
+typedef DspChain<DspDcBlocker<>,
+                 DspHighPass<80, AUDIO_CAPTURE_I2S_RATE>,
+                 DspAgc> capture_dsp_t;
+
+struct capture_pipeline {
+    capture_dsp_t dsp;
+    pcm_convert_cfg_t convert_cfg;
+    resampler_t *resampler;
+    aec_t *aec;
+    denoise_t *denoise;
+    audio_level_t *level;
+    volatile bool dsp_enabled;
+    volatile bool aec_enabled;
+    volatile bool ns_enabled;
+    volatile bool reset;
+    uint64_t dsp_cycles_total;
+    uint64_t aec_cycles_total;
+    uint32_t aec_blocks;
+    uint64_t ns_cycles_total;
+    uint32_t ns_blocks;
+    capture_pipeline_stats_t stats;
+
+    // Frame buffers, so processing never allocates. 16-byte alignment lets
+    // the SIMD converter take the fast path.
+    int16_t frame_16[CAPTURE_PIPELINE_I2S_FRAME] __attribute__((aligned(16)));
+    int16_t frame_out[AUDIO_CAPTURE_FRAME_SAMPLES + 2];
+    int16_t frame_ref[AUDIO_CAPTURE_FRAME_SAMPLES + 2];
+};
+
+// Echo cancellation on ring-rate samples, in place. frame_start_us is when
+// the first of them reached the microphone.
+static void cancel_echo(capture_pipeline_t *p, int16_t *pcm, size_t count, int64_t frame_start_us) {
+    if (!p->aec_enabled || !p->aec) return;
+
+    uint32_t start = audio_hal_cycle_count();
+    echo_ref_read(p->frame_ref, count, frame_start_us);
+    aec_process(p->aec, p->frame_ref, pcm, count);
+    uint32_t cycles = audio_hal_cycle_count() - start;
+
+    p->aec_cycles_total += cycles;
+    p->aec_blocks++;
+    p->stats.aec_cycles_avg = (uint32_t)(p->aec_cycles_total / p->aec_blocks);
+    if (cycles > p->stats.aec_cycles_max) p->stats.aec_cycles_max = cycles;
+
+    aec_stats_t st;
+    aec_get_stats(p->aec, &st);
+    p->stats.aec_erle_db10 = st.erle_db10;
+}
+
+// Noise suppression on ring-rate samples, in place
+static void suppress_noise(capture_pipeline_t *p, int16_t *pcm, size_t count) {
+    if (!p->ns_enabled || !p->denoise) return;
+
+    uint32_t start = audio_hal_cycle_count();
+    denoise_process(p->denoise, pcm, count);
+    uint32_t cycles = audio_hal_cycle_count() - start;
+
+    p->ns_cycles_total += cycles;
+    p->ns_blocks++;
+    p->stats.ns_cycles_avg = (uint32_t)(p->ns_cycles_total / p->ns_blocks);
+    if (cycles > p->stats.ns_cycles_max) p->stats.ns_cycles_max = cycles;
+
+    denoise_stats_t st;
+    denoise_get_stats(p->denoise, &st);
+    p->stats.ns_gain_q15 = st.gain_q15;
+    p->stats.ns_noise_q8 = st.noise_q8;
+}
+
+static void apply_reset(capture_pipeline_t *p) {
+    p->dsp.reset();
+    resampler_reset(p->resampler);
+    aec_reset(p->aec);
+    denoise_reset(p->denoise);
+    audio_level_reset(p->level);
+    p->dsp_cycles_total = 0;
+    p->aec_cycles_total = 0;
+    p->aec_blocks = 0;
+    p->ns_cycles_total = 0;
+    p->ns_blocks = 0;
+    memset(&p->stats, 0, sizeof(p->stats));
+    p->reset = false;
+}
+
+// One frame of at most CAPTURE_PIPELINE_I2S_FRAME samples
+static size_t process_frame(capture_pipeline_t *p, int32_t *frame, size_t count,
+                            int64_t frame_start_us, audio_ring_t *ring) {
+    if (p->dsp_enabled) {
+        uint32_t start = audio_hal_cycle_count();
+        p->dsp.process(frame, count);
+        uint32_t cycles = audio_hal_cycle_count() - start;
+
+        p->dsp_cycles_total += cycles;
+        p->stats.frames++;
+        p->stats.cycles_avg = (uint32_t)(p->dsp_cycles_total / p->stats.frames);
+        if (cycles > p->stats.cycles_max) p->stats.cycles_max = cycles;
+        p->stats.agc_gain_q16 = dsp_stage<2>(p->dsp).gain_q16();
+        p->stats.limited_frames = dsp_stage<2>(p->dsp).limited_frames();
+    }
+
+    // Convert 32-bit samples to 16-bit with the configured gain
+    pcm_convert_s32_to_s16(frame, p->frame_16, count, &p->convert_cfg);
+
+    int16_t *pcm = p->frame_16;
+    size_t out_count = count;
+    if (p->resampler) {
+        out_count = resampler_process(p->resampler, p->frame_16, count,
+                                      p->frame_out, sizeof(p->frame_out) / sizeof(p->frame_out[0]));
+        pcm = p->frame_out;
+        // The resampler output lags its input by the filter delay
+        frame_start_us -= (int64_t)resampler_delay(p->resampler) * 1000000 / AUDIO_CAPTURE_SAMPLE_RATE;
+    }
+
+    // The level is what the mic hears, echo included, after the gain stages
+    // that could clip it
+    audio_level_process(p->level, pcm, out_count);
+    cancel_echo(p, pcm, out_count, frame_start_us);
+    suppress_noise(p, pcm, out_count);
+    return audio_ring_push(ring, pcm, out_count);
+}
+
+extern "C" {
+
+capture_pipeline_t *capture_pipeline_create(void) {
+    capture_pipeline_t *p = new (std::nothrow) capture_pipeline_t();
+    if (!p) {
+        return NULL;
+    }
+    p->convert_cfg.gain = 1;
+    p->convert_cfg.shift = 0;
+    p->dsp_enabled = true;
+    p->aec_enabled = true;
+    p->ns_enabled = true;
+
+    if (AUDIO_CAPTURE_I2S_RATE != AUDIO_CAPTURE_SAMPLE_RATE) {
+        p->resampler = resampler_create(AUDIO_CAPTURE_I2S_RATE, AUDIO_CAPTURE_SAMPLE_RATE, 0);
+        if (!p->resampler) {
+            delete p;
+            return NULL;
+        }
+    }
+
+    p->level = audio_level_create();
+    if (!p->level) {
+        capture_pipeline_destroy(p);
+        return NULL;
+    }
+
+    if (echo_ref_init(AUDIO_CAPTURE_SAMPLE_RATE)) {
+        aec_config_t aec_cfg;
+        aec_config_default(&aec_cfg, AUDIO_CAPTURE_SAMPLE_RATE);
+        p->aec = aec_create(&aec_cfg);
+    }
+
+    denoise_config_t ns_cfg;
+    denoise_config_default(&ns_cfg, AUDIO_CAPTURE_SAMPLE_RATE);
+    p->denoise = denoise_create(&ns_cfg);
+    return p;
+}
+
+void capture_pipeline_destroy(capture_pipeline_t *p) {
+    if (!p) return;
+    audio_level_destroy(p->level);
+    denoise_destroy(p->denoise);
+    aec_destroy(p->aec);
+    resampler_destroy(p->resampler);
+    delete p;
+}
+
+void capture_pipeline_reset(capture_pipeline_t *p) {
+    if (p) p->reset = true;
+}
+
+size_t capture_pipeline_process(capture_pipeline_t *p, int32_t *frame, size_t count,
+                                int64_t frame_start_us, audio_ring_t *ring) {
+    if (!p || !frame) return 0;
+    if (p->reset) {
+        apply_reset(p);
+    }
+
+    // Sources deliver 20 ms frames; anything longer goes through in pieces
+    size_t pushed = 0;
+    while (count > 0) {
+        size_t n = count < CAPTURE_PIPELINE_I2S_FRAME ? count : CAPTURE_PIPELINE_I2S_FRAME;
+        pushed += process_frame(p, frame, n, frame_start_us, ring);
+        frame += n;
+        count -= n;
+        frame_start_us += (int64_t)n * 1000000 / AUDIO_CAPTURE_I2S_RATE;
+    }
+    return pushed;
+}
+
+void capture_pipeline_set_dsp(capture_pipeline_t *p, bool enabled) {
+    if (!p) return;
+    p->reset = true;
+    p->dsp_enabled = enabled;
+}
+
+void capture_pipeline_set_echo_cancel(capture_pipeline_t *p, bool enabled) {
+    if (!p) return;
+    p->reset = true;
+    p->aec_enabled = enabled;
+}
+
+bool capture_pipeline_is_echo_cancel_enabled(const capture_pipeline_t *p) {
+    return p && p->aec_enabled && p->aec;
+}
+
+void capture_pipeline_set_noise_suppression(capture_pipeline_t *p, bool enabled) {
+    if (!p) return;
+    p->reset = true;
+    p->ns_enabled = enabled;
+}
+
+bool capture_pipeline_is_noise_suppression_enabled(const capture_pipeline_t *p) {
+    return p && p->ns_enabled && p->denoise;
+}
+
+void capture_pipeline_set_gain(capture_pipeline_t *p, int16_t gain, uint8_t shift) {
+    if (!p) return;
+    if (shift > 31) shift = 31;
+    p->convert_cfg.gain = gain;
+    p->convert_cfg.shift = shift;
+}
+
+void capture_pipeline_get_stats(const capture_pipeline_t *p, capture_pipeline_stats_t *stats) {
+    if (p && stats) *stats = p->stats;
+}
+
+void capture_pipeline_get_level(const capture_pipeline_t *p, audio_level_stats_t *stats) {
+    audio_level_read(p ? p->level : NULL, stats);
+}
+
+} // extern "C"
@@ -0,0 +1,104 @@
+#ifndef CAPTURE_PIPELINE_H
+#define CAPTURE_PIPELINE_H
+
+#include "audio_ring.h"
+#include "audio_level.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Rate of the audio in the capture ring (8000 or 16000 for speech)
+#ifndef AUDIO_CAPTURE_SAMPLE_RATE
+#define AUDIO_CAPTURE_SAMPLE_RATE     16000
+#endif
+
+// Rate the microphone is clocked at. When it differs from the ring rate,
+// frames are decimated with the polyphase resampler (e.g. 48000 -> 16000).
+#ifndef AUDIO_CAPTURE_I2S_RATE
+#define AUDIO_CAPTURE_I2S_RATE        AUDIO_CAPTURE_SAMPLE_RATE
+#endif
+
+#define AUDIO_CAPTURE_FRAME_SAMPLES   (AUDIO_CAPTURE_SAMPLE_RATE / 50)  // 20 ms per frame
+#define CAPTURE_PIPELINE_I2S_FRAME    (AUDIO_CAPTURE_I2S_RATE / 50)     // 20 ms at the I2S rate
+
+/**
+ * Everything between the microphone samples and the capture ring: the
+ * front-end DSP chain (audio_dsp.h), narrowing to 16-bit (pcm_convert.h),
+ * resampling to the ring rate, level statistics (audio_level.h), echo
+ * cancellation against the speaker reference (aec.h, echo_ref.h) and noise
+ * suppression (denoise.h).
+ *
+ * The pipeline has no I/O or task of its own: whoever owns the audio
+ * source hands it frames. It builds for the device and for a host, where
+ * tools feed it from the file backends in audio_hal.h. State is allocated
+ * by capture_pipeline_create(); processing never allocates.
+ */
+typedef struct capture_pipeline capture_pipeline_t;
+
+typedef struct {
+    uint32_t frames;            // Frames processed since capture started
+    uint32_t cycles_avg;        // CPU cycles per frame spent in the DSP chain
+    uint32_t cycles_max;
+    uint32_t agc_gain_q16;      // Current AGC gain, 1.0 = 65536
+    uint32_t limited_frames;    // Frames where the peak limiter cut the gain
+    uint32_t ns_cycles_avg;     // CPU cycles per frame spent in noise suppression
+    uint32_t ns_cycles_max;
+    uint16_t ns_gain_q15;       // Mean suppression gain of the last FFT frame
+    int16_t ns_noise_q8;        // Noise estimate, see denoise_stats_t
+    uint32_t aec_cycles_avg;    // CPU cycles per frame spent in echo cancellation
+    uint32_t aec_cycles_max;
+    int16_t aec_erle_db10;      // Echo return loss enhancement, 0.1 dB
+} capture_pipeline_stats_t;
+
+/**
+ * @brief Allocate all stages. A stage that cannot be allocated (the echo
+ *        canceller or noise suppressor) is left out and reported as off.
+ * @return NULL if the pipeline itself could not be allocated
+ */
+capture_pipeline_t *capture_pipeline_create(void);
+void capture_pipeline_destroy(capture_pipeline_t *p);
+
+/**
+ * @brief Clear filter state and statistics before the next frame, e.g.
+ *        when a new capture session starts. Safe to call from another task.
+ */
+void capture_pipeline_reset(capture_pipeline_t *p);
+
+/**
+ * @brief Run one frame of I2S-rate samples, which are modified in place,
+ *        and push the result into ring.
+ * @param frame_start_us Capture time of the first sample (audio_hal clock)
+ * @return Number of ring-rate samples pushed
+ */
+size_t capture_pipeline_process(capture_pipeline_t *p, int32_t *frame, size_t count,
+                                int64_t frame_start_us, audio_ring_t *ring);
+
+// Stage switches; each one also resets the pipeline
+void capture_pipeline_set_dsp(capture_pipeline_t *p, bool enabled);
+void capture_pipeline_set_echo_cancel(capture_pipeline_t *p, bool enabled);
+bool capture_pipeline_is_echo_cancel_enabled(const capture_pipeline_t *p);
+void capture_pipeline_set_noise_suppression(capture_pipeline_t *p, bool enabled);
+bool capture_pipeline_is_noise_suppression_enabled(const capture_pipeline_t *p);
+
+/**
+ * @brief Saturating gain applied while converting to 16-bit.
+ *        See pcm_convert_cfg_t; (1, 0) is unity.
+ */
+void capture_pipeline_set_gain(capture_pipeline_t *p, int16_t gain, uint8_t shift);
+
+void capture_pipeline_get_stats(const capture_pipeline_t *p, capture_pipeline_stats_t *stats);
+
+/**
+ * @brief Level of the last frame as the mic heard it, before echo
+ *        cancellation. Lock-free; any task may call it while frames run.
+ */
+void capture_pipeline_get_level(const capture_pipeline_t *p, audio_level_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // CAPTURE_PIPELINE_H
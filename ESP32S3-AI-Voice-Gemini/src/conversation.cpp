@@ -0,0 +1,335 @@
+// src/conversation.cpp - Conversation memory with a byte and token budget
+
+#include "conversation.h"
+#include "request_writer.h"
+#include "psram_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char SUMMARY_LEAD[] = "Earlier in this conversation:\n";
+static const char SYSTEM_OPEN[] = "\"systemInstruction\":{\"parts\":[{\"text\":\"";
+static const char SYSTEM_CLOSE[] = "\"}]},";
+static const char CONTENTS_OPEN[] = "\"contents\":[";
+static const char TURN_OPEN[] = "{\"role\":\"";
+static const char TURN_TEXT[] = "\",\"parts\":[{\"text\":\"";
+static const char TURN_CLOSE[] = "\"}]}";
+
+#define LIT_LEN(s) (sizeof(s) - 1)
+
+typedef struct {
+    char *text;                     // PSRAM, NUL-terminated
+    uint32_t json_bytes;            // conversation_turn_size()
+    uint32_t tokens;
+    uint8_t role;
+} turn_t;
+
+struct conversation {
+    conversation_config_t cfg;
+    turn_t turns[CONVERSATION_MAX_TURNS];
+    uint8_t head;                   // Oldest turn
+    uint8_t count;
+    uint32_t turn_bytes;            // Sum of json_bytes + 1 for each comma
+    uint32_t turn_tokens;
+    uint32_t summary_len;
+    uint32_t summary_tokens;
+    uint32_t added;
+    uint32_t folded;
+    uint32_t summary_dropped;
+    char summary[CONVERSATION_SUMMARY_MAX + 1];
+};
+
+static const char *role_name(conversation_role_t role) {
+    return role == CONVERSATION_MODEL ? "model" : "user";
+}
+
+// Output of a prefix read: the first skip bytes are dropped, the rest cut at cap
+typedef struct {
+    char *out;
+    size_t cap;
+    size_t skip;
+    size_t len;
+} span_t;
+
+static void span_lit(span_t *s, const char *p, size_t len) {
+    if (s->skip >= len) {
+        s->skip -= len;
+        return;
+    }
+    p += s->skip;
+    len -= s->skip;
+    s->skip = 0;
+    size_t k = len < s->cap - s->len ? len : s->cap - s->len;
+    memcpy(s->out + s->len, p, k);
+    s->len += k;
+}
+
+static void span_escaped(span_t *s, const char *p, size_t len, size_t size) {
+    if (s->skip >= size) {
+        s->skip -= size;
+        return;
+    }
+    s->len += json_escape_at(p, len, s->skip, s->out + s->len, s->cap - s->len);
+    s->skip = 0;
+}
+
+static char *write_lit(char *w, const char *s, size_t len) {
+    memcpy(w, s, len);
+    return w + len;
+}
+
+// Longest prefix of s[0..len) up to max bytes that ends between UTF-8 sequences
+static size_t utf8_cut(const char *s, size_t len, size_t max) {
+    if (len <= max) return len;
+    size_t n = max;
+    while (n > 0 && ((unsigned char)s[n] & 0xC0) == 0x80) n--;
+    return n;
+}
+
+static size_t system_size(const conversation_t *c) {
+    if (c->summary_len == 0) return 0;
+    return LIT_LEN(SYSTEM_OPEN) + json_escaped_size(SUMMARY_LEAD, LIT_LEN(SUMMARY_LEAD)) +
+           json_escaped_size(c->summary, c->summary_len) + LIT_LEN(SYSTEM_CLOSE);
+}
+
+static turn_t *turn_at(conversation_t *c, int i) {
+    return &c->turns[(c->head + i) % CONVERSATION_MAX_TURNS];
+}
+
+static void drop_summary_line(conversation_t *c) {
+    const char *nl = (const char *)memchr(c->summary, '\n', c->summary_len);
+    size_t n = nl ? (size_t)(nl - c->summary) + 1 : c->summary_len;
+    memmove(c->summary, c->summary + n, c->summary_len - n);
+    c->summary_len -= n;
+    c->summary[c->summary_len] = '\0';
+    c->summary_tokens = conversation_estimate_tokens(c->summary, c->summary_len);
+    c->summary_dropped++;
+}
+
+// "User: <first sentence>\n" at the end of the summary
+static void summarize(conversation_t *c, const turn_t *t) {
+    const char *s = t->text;
+    size_t len = strlen(s);
+    while (len > 0 && (*s == ' ' || *s == '\n')) {
+        s++;
+        len--;
+    }
+    size_t n = utf8_cut(s, len, CONVERSATION_CLAUSE_MAX);
+    for (size_t i = 20; i < n; i++) {
+        if (s[i] == '\n' || ((s[i - 1] == '.' || s[i - 1] == '?' || s[i - 1] == '!') && s[i] == ' ')) {
+            n = i;
+            break;
+        }
+    }
+    bool cut = n < len && s[n] != '\n' && s[n] != ' ';
+    const char *who = t->role == CONVERSATION_MODEL ? "AI: " : "User: ";
+    size_t need = strlen(who) + n + (cut ? 3 : 0) + 1;
+    if (need > CONVERSATION_SUMMARY_MAX) return;
+    while (c->summary_len + need > CONVERSATION_SUMMARY_MAX) drop_summary_line(c);
+
+    char *w = c->summary + c->summary_len;
+    w = write_lit(w, who, strlen(who));
+    for (size_t i = 0; i < n; i++) *w++ = s[i] == '\n' ? ' ' : s[i];
+    if (cut) w = write_lit(w, "...", 3);
+    *w++ = '\n';
+    *w = '\0';
+    c->summary_len = (uint32_t)(w - c->summary);
+    c->summary_tokens = conversation_estimate_tokens(c->summary, c->summary_len);
+}
+
+static void fold_oldest(conversation_t *c) {
+    turn_t *t = turn_at(c, 0);
+    summarize(c, t);
+    c->turn_bytes -= t->json_bytes + 1;
+    c->turn_tokens -= t->tokens;
+    free(t->text);
+    t->text = NULL;
+    c->head = (c->head + 1) % CONVERSATION_MAX_TURNS;
+    c->count--;
+    c->folded++;
+}
+
+static bool over_budget(const conversation_t *c) {
+    return conversation_prefix_size(c) > c->cfg.max_bytes ||
+           c->turn_tokens + c->summary_tokens > c->cfg.max_tokens;
+}
+
+static void enforce_budget(conversation_t *c) {
+    // The last exchange always stays whole
+    while (c->count > 2 && over_budget(c)) {
+        fold_oldest(c);
+    }
+    // The history starts with a user turn
+    while (c->count > 0 && turn_at(c, 0)->role == CONVERSATION_MODEL) {
+        fold_oldest(c);
+    }
+    while (c->summary_len > 0 && over_budget(c)) {
+        drop_summary_line(c);
+    }
+}
+
+extern "C" {
+
+conversation_t *conversation_create(const conversation_config_t *cfg) {
+    conversation_t *c = (conversation_t *)psram_calloc(1, sizeof(conversation_t));
+    if (!c) return NULL;
+    c->cfg.max_bytes = CONVERSATION_DEFAULT_MAX_BYTES;
+    c->cfg.max_tokens = CONVERSATION_DEFAULT_MAX_TOKENS;
+    if (cfg) {
+        if (cfg->max_bytes) c->cfg.max_bytes = cfg->max_bytes;
+        if (cfg->max_tokens) c->cfg.max_tokens = cfg->max_tokens;
+    }
+    return c;
+}
+
+void conversation_destroy(conversation_t *c) {
+    if (!c) return;
+    conversation_clear(c);
+    free(c);
+}
+
+bool conversation_add(conversation_t *c, conversation_role_t role, const char *text) {
+    if (!c || !text) return false;
+    size_t len = strlen(text);
+
+    // A turn alone may take half of the budget
+    size_t overhead = conversation_turn_size(role, "") + 1;
+    size_t room = c->cfg.max_bytes / 2 > overhead ? c->cfg.max_bytes / 2 - overhead : 0;
+    while (len > 0 && json_escaped_size(text, len) > room) {
+        len = utf8_cut(text, len, len - (len / 8 + 1));
+    }
+
+    char *copy = (char *)psram_malloc(len + 1);
+    if (!copy) return false;
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+
+    if (c->count == CONVERSATION_MAX_TURNS) {
+        fold_oldest(c);
+    }
+    turn_t *t = turn_at(c, c->count);
+    t->text = copy;
+    t->role = (uint8_t)role;
+    t->json_bytes = (uint32_t)conversation_turn_size(role, copy);
+    t->tokens = conversation_estimate_tokens(copy, len);
+    c->count++;
+    c->turn_bytes += t->json_bytes + 1;
+    c->turn_tokens += t->tokens;
+    c->added++;
+
+    enforce_budget(c);
+    return true;
+}
+
+void conversation_clear(conversation_t *c) {
+    if (!c) return;
+    for (int i = 0; i < c->count; i++) {
+        free(turn_at(c, i)->text);
+        turn_at(c, i)->text = NULL;
+    }
+    c->head = 0;
+    c->count = 0;
+    c->turn_bytes = 0;
+    c->turn_tokens = 0;
+    c->summary_len = 0;
+    c->summary_tokens = 0;
+    c->summary[0] = '\0';
+    c->added = 0;
+    c->folded = 0;
+    c->summary_dropped = 0;
+}
+
+void conversation_set_budget(conversation_t *c, uint32_t max_bytes, uint32_t max_tokens) {
+    if (!c) return;
+    if (max_bytes) c->cfg.max_bytes = max_bytes;
+    if (max_tokens) c->cfg.max_tokens = max_tokens;
+    enforce_budget(c);
+}
+
+size_t conversation_prefix_size(const conversation_t *c) {
+    size_t n = 1 + LIT_LEN(CONTENTS_OPEN);
+    if (c) n += system_size(c) + c->turn_bytes;
+    return n;
+}
+
+size_t conversation_write_prefix(const conversation_t *c, char *out, size_t cap) {
+    size_t size = conversation_prefix_size(c);
+    if (cap <= size) return 0;
+    size_t n = conversation_read_prefix(c, 0, out, size);
+    out[n] = '\0';
+    return n;
+}
+
+size_t conversation_read_prefix(const conversation_t *c, size_t offset, char *out, size_t cap) {
+    span_t s = { out, cap, offset, 0 };
+    span_lit(&s, "{", 1);
+    if (c && c->summary_len > 0) {
+        span_lit(&s, SYSTEM_OPEN, LIT_LEN(SYSTEM_OPEN));
+        span_escaped(&s, SUMMARY_LEAD, LIT_LEN(SUMMARY_LEAD), json_escaped_size(SUMMARY_LEAD, LIT_LEN(SUMMARY_LEAD)));
+        span_escaped(&s, c->summary, c->summary_len, json_escaped_size(c->summary, c->summary_len));
+        span_lit(&s, SYSTEM_CLOSE, LIT_LEN(SYSTEM_CLOSE));
+    }
+    span_lit(&s, CONTENTS_OPEN, LIT_LEN(CONTENTS_OPEN));
+    for (int i = 0; c && i < c->count && s.len < s.cap; i++) {
+        const turn_t *t = &c->turns[(c->head + i) % CONVERSATION_MAX_TURNS];
+        // Turns before the offset are passed over by their size
+        if (s.skip >= t->json_bytes + 1) {
+            s.skip -= t->json_bytes + 1;
+            continue;
+        }
+        const char *name = role_name((conversation_role_t)t->role);
+        size_t name_len = strlen(name);
+        span_lit(&s, TURN_OPEN, LIT_LEN(TURN_OPEN));
+        span_lit(&s, name, name_len);
+        span_lit(&s, TURN_TEXT, LIT_LEN(TURN_TEXT));
+        span_escaped(&s, t->text, strlen(t->text),
+                     t->json_bytes - LIT_LEN(TURN_OPEN) - name_len - LIT_LEN(TURN_TEXT) - LIT_LEN(TURN_CLOSE));
+        span_lit(&s, TURN_CLOSE, LIT_LEN(TURN_CLOSE));
+        span_lit(&s, ",", 1);
+    }
+    return s.len;
+}
+
+size_t conversation_turn_size(conversation_role_t role, const char *text) {
+    return LIT_LEN(TURN_OPEN) + strlen(role_name(role)) + LIT_LEN(TURN_TEXT) +
+           json_escaped_size(text, strlen(text)) + LIT_LEN(TURN_CLOSE);
+}
+
+size_t conversation_write_turn(conversation_role_t role, const char *text, char *out, size_t cap) {
+    size_t size = conversation_turn_size(role, text);
+    if (cap <= size) return 0;
+    const char *name = role_name(role);
+    char *w = write_lit(out, TURN_OPEN, LIT_LEN(TURN_OPEN));
+    w = write_lit(w, name, strlen(name));
+    w = write_lit(w, TURN_TEXT, LIT_LEN(TURN_TEXT));
+    w += json_escape_at(text, strlen(text), 0, w, size);
+    w = write_lit(w, TURN_CLOSE, LIT_LEN(TURN_CLOSE));
+    *w = '\0';
+    return size;
+}
+
+uint32_t conversation_estimate_tokens(const char *text, size_t len) {
+    uint32_t ascii = 0, other = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c < 0x80) {
+            ascii++;
+        } else if ((c & 0xC0) != 0x80) {
+            other++;
+        }
+    }
+    return (ascii + 3) / 4 + (other + 1) / 2;
+}
+
+void conversation_get_stats(const conversation_t *c, conversation_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    if (!c) return;
+    st->turns = c->count;
+    st->bytes = (uint32_t)conversation_prefix_size(c);
+    st->tokens = c->turn_tokens + c->summary_tokens;
+    st->summary_bytes = c->summary_len;
+    st->added = c->added;
+    st->folded = c->folded;
+    st->summary_dropped = c->summary_dropped;
+}
+
+} // extern "C"
@@ -0,0 +1,119 @@
+#ifndef CONVERSATION_H
+#define CONVERSATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Conversation memory for multi-turn requests.
+ *
+ * A ring of the latest user and model turns, kept in PSRAM, written as the
+ * "contents" of the next request so Gemini sees what was said before.
+ * Every turn carries its serialized size and a token estimate; when the
+ * history goes over the byte or token budget, the oldest turns are folded
+ * into a short summary (the first sentence of each) sent as the system
+ * instruction, and the oldest summary lines go once that is full. The
+ * request therefore stays about the same size however long the
+ * conversation runs.
+ *
+ * No platform dependency.
+ */
+
+#define CONVERSATION_MAX_TURNS          32
+#define CONVERSATION_SUMMARY_MAX        768     // Bytes of summary text
+#define CONVERSATION_CLAUSE_MAX         120     // Bytes of a folded turn kept in the summary
+#define CONVERSATION_DEFAULT_MAX_BYTES  6144
+#define CONVERSATION_DEFAULT_MAX_TOKENS 1536
+
+typedef enum {
+    CONVERSATION_USER = 0,
+    CONVERSATION_MODEL,
+} conversation_role_t;
+
+typedef struct {
+    uint32_t max_bytes;             // conversation_prefix_size() stays at or below this
+    uint32_t max_tokens;            // Estimated tokens of the turns and summary
+} conversation_config_t;
+
+typedef struct {
+    uint32_t turns;                 // Kept in full
+    uint32_t bytes;                 // conversation_prefix_size()
+    uint32_t tokens;                // Estimate for the turns and summary
+    uint32_t summary_bytes;
+    uint32_t added;                 // Since creation or the last clear
+    uint32_t folded;                // Turns moved into the summary
+    uint32_t summary_dropped;       // Summary lines dropped to make room
+} conversation_stats_t;
+
+typedef struct conversation conversation_t;
+
+/**
+ * @param cfg NULL for the defaults
+ */
+conversation_t *conversation_create(const conversation_config_t *cfg);
+void conversation_destroy(conversation_t *c);
+
+/**
+ * @brief Add a turn, then fold old turns until the history is within the
+ *        budget. A turn too large for half the byte budget is cut short.
+ * @return false when out of memory; the turn is not added
+ */
+bool conversation_add(conversation_t *c, conversation_role_t role, const char *text);
+
+/**
+ * @brief Forget everything, summary included.
+ */
+void conversation_clear(conversation_t *c);
+
+void conversation_set_budget(conversation_t *c, uint32_t max_bytes, uint32_t max_tokens);
+
+/**
+ * @brief Size of what conversation_write_prefix() writes.
+ */
+size_t conversation_prefix_size(const conversation_t *c);
+
+/**
+ * @brief Write the start of a request: '{', the summary as
+ *        "systemInstruction" if there is one, then "contents":[ and every
+ *        turn followed by a comma. The request's own user turn and the
+ *        closing ']' come next.
+ * @return Bytes written, NUL not counted; 0 if cap is too small
+ */
+size_t conversation_write_prefix(const conversation_t *c, char *out, size_t cap);
+
+/**
+ * @brief Bytes [offset, offset + cap) of what conversation_write_prefix()
+ *        writes, no NUL, for a body produced piece by piece (see
+ *        request_writer.h). Turns before offset are skipped by their size.
+ * @return Bytes written; fewer than cap only at the end of the prefix
+ */
+size_t conversation_read_prefix(const conversation_t *c, size_t offset, char *out, size_t cap);
+
+/**
+ * @brief Size of one turn written by conversation_write_turn().
+ */
+size_t conversation_turn_size(conversation_role_t role, const char *text);
+
+/**
+ * @brief Write {"role":...,"parts":[{"text":...}]} for text.
+ * @return Bytes written, NUL not counted; 0 if cap is too small
+ */
+size_t conversation_write_turn(conversation_role_t role, const char *text, char *out, size_t cap);
+
+/**
+ * @brief Rough token count: four ASCII characters or two other
+ *        characters to a token.
+ */
+uint32_t conversation_estimate_tokens(const char *text, size_t len);
+
+void conversation_get_stats(const conversation_t *c, conversation_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // CONVERSATION_H
@@ -0,0 +1,231 @@
+// src/denoise.cpp - Spectral Wiener noise suppressor on the real fft_q15
+
+#include "denoise.h"
+#include "fft_q15.h"
+#include "audio_dsp.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FFT_HEADROOM        16383   // Peak input to the FFT
+#define LOG_SMOOTH_SHIFT    2       // Power smoothing for the noise tracker, 1/4 per frame
+#define MAX_SNR_OCTAVES     20      // Clamp on the a-posteriori SNR (60 dB)
+#define MAX_PRIOR_Q8        65535   // Clamp on the a-priori SNR (24 dB), keeps the division 32-bit
+
+struct denoise {
+    denoise_config_t cfg;
+    fft_q15_t *fft;
+    uint16_t n;
+    uint16_t hop;
+    uint16_t bins;              // n / 2 + 1
+    uint16_t log2n;
+    uint16_t pos;               // Samples of the current hop consumed
+    int32_t rise_q16;           // Noise rise per frame, Q8 log2 << 8
+    int16_t *window;            // Square-root periodic Hann, Q15
+    int16_t *input;             // Last n input samples
+    int16_t *output;            // One hop of finished output
+    int32_t *overlap;           // Overlap-add accumulator, n samples
+    int16_t *fft_buf;           // n + 2 values, 16-byte aligned for the SIMD FFT
+    void *fft_mem;
+    int32_t *smooth_log;        // Smoothed bin power, Q8 log2
+    int32_t *noise_log;         // Tracked noise minimum, Q8 log2 << 8
+    uint32_t *prev_snr;         // Clean-to-noise ratio of the last frame, Q8
+    denoise_stats_t stats;
+};
+
+static int16_t sat16(int32_t v) {
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+}
+
+// One frame: window, transform, gain, inverse, window, overlap-add. The
+// first hop of the accumulator is complete afterwards and becomes output.
+static void process_frame(denoise_t *d) {
+    const uint16_t n = d->n, hop = d->hop;
+    int16_t *buf = d->fft_buf;
+
+    int16_t peak = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        int16_t v = (int16_t)(((int32_t)d->input[i] * d->window[i] + (1 << 14)) >> 15);
+        buf[i] = v;
+        int16_t a = v < 0 ? (int16_t)-v : v;
+        if (a > peak) peak = a;
+    }
+
+    if (peak > 0) {
+        // Normalise the block so quiet frames keep their precision
+        int shift = 0;
+        while ((peak << (shift + 1)) <= FFT_HEADROOM) shift++;
+        for (uint16_t i = 0; i < n; i++) {
+            buf[i] = (int16_t)(buf[i] << shift);
+        }
+        fft_q15_real_forward(d->fft, buf);
+
+        const bool first = d->stats.frames == 0;
+        const int32_t norm = 2 * shift * 256;
+        const uint32_t alpha = d->cfg.dd_alpha_q15;
+        uint32_t gain_sum = 0;
+        int32_t noise_sum = 0;
+
+        for (uint16_t k = 0; k < d->bins; k++) {
+            int32_t re = buf[2 * k], im = buf[2 * k + 1];
+            uint32_t p = (uint32_t)(re * re) + (uint32_t)(im * im);
+            int32_t log_p = dsp_log2_q8((uint64_t)p + 1) - norm;
+
+            // Minimum tracking on the smoothed power
+            int32_t s = first ? log_p : d->smooth_log[k] + ((log_p - d->smooth_log[k]) >> LOG_SMOOTH_SHIFT);
+            d->smooth_log[k] = s;
+            int32_t noise = first ? s << 8 : d->noise_log[k] + d->rise_q16;
+            if (noise > s << 8) noise = s << 8;
+            d->noise_log[k] = noise;
+            int32_t log_n = (noise >> 8) + d->cfg.noise_bias_q8;
+            noise_sum += log_n;
+
+            // A-posteriori SNR gamma and decision-directed a-priori SNR xi, Q8
+            int32_t diff = log_p - log_n;
+            if (diff > MAX_SNR_OCTAVES * 256) diff = MAX_SNR_OCTAVES * 256;
+            uint32_t gamma = dsp_exp2_q8(diff);
+            uint32_t excess = gamma > 256 ? gamma - 256 : 0;
+            uint64_t xi = first ? excess
+                                : ((uint64_t)alpha * d->prev_snr[k] + (uint64_t)(32768 - alpha) * excess) >> 15;
+            if (xi > MAX_PRIOR_Q8) xi = MAX_PRIOR_Q8;
+
+            // Wiener gain xi / (1 + xi) with a floor
+            uint32_t g = (uint32_t)((xi << 15) / (xi + 256));
+            if (g < d->cfg.min_gain_q15) g = d->cfg.min_gain_q15;
+            d->prev_snr[k] = (uint32_t)(((((uint64_t)g * g) >> 15) * gamma) >> 15);
+            gain_sum += g;
+
+            buf[2 * k] = (int16_t)((re * (int32_t)g + (1 << 14)) >> 15);
+            buf[2 * k + 1] = (int16_t)((im * (int32_t)g + (1 << 14)) >> 15);
+        }
+
+        d->stats.frames++;
+        d->stats.gain_q15 = (uint16_t)(gain_sum / d->bins);
+        d->stats.noise_q8 = (int16_t)(noise_sum / d->bins + (1 + d->log2n) * 256);
+
+        // Back to the time domain at the input's scale: x = buf * 2^(e - shift)
+        int e = fft_q15_real_inverse(d->fft, buf) - shift;
+        for (uint16_t i = 0; i < n; i++) {
+            int32_t v = (int32_t)buf[i] * d->window[i];            // Q15
+            int rs = 15 - e;
+            if (rs > 0) {
+                v = rs < 31 ? (v + (1 << (rs - 1))) >> rs : 0;
+            } else {
+                v <<= -rs;
+            }
+            d->overlap[i] += v;
+        }
+    }
+
+    for (uint16_t i = 0; i < hop; i++) {
+        d->output[i] = sat16(d->overlap[i]);
+    }
+    memmove(d->overlap, d->overlap + hop, (n - hop) * sizeof(int32_t));
+    memset(d->overlap + n - hop, 0, hop * sizeof(int32_t));
+    memmove(d->input, d->input + hop, (n - hop) * sizeof(int16_t));
+}
+
+extern "C" {
+
+void denoise_config_default(denoise_config_t *cfg, uint32_t sample_rate) {
+    if (!cfg) return;
+    cfg->sample_rate = sample_rate;
+    cfg->fft_size = 64;
+    while (cfg->fft_size < sample_rate / 64 && cfg->fft_size < 1024) cfg->fft_size <<= 1;
+    cfg->min_gain_q15 = 5827;           // -15 dB
+    cfg->dd_alpha_q15 = 32113;          // 0.98
+    cfg->noise_rise_q8 = 256;           // 3 dB per second
+    cfg->noise_bias_q8 = 384;           // 4.5 dB
+}
+
+denoise_t *denoise_create(const denoise_config_t *cfg) {
+    if (!cfg || cfg->sample_rate == 0 || cfg->fft_size < 64 || cfg->fft_size > 1024 ||
+        (cfg->fft_size & (cfg->fft_size - 1)) != 0 || cfg->dd_alpha_q15 > 32768) {
+        return NULL;
+    }
+
+    denoise_t *d = (denoise_t *)calloc(1, sizeof(denoise_t));
+    if (!d) return NULL;
+    d->cfg = *cfg;
+    d->n = cfg->fft_size;
+    d->hop = d->n / 2;
+    d->bins = d->n / 2 + 1;
+    while ((1u << d->log2n) < d->n) d->log2n++;
+
+    // Frames per second at 50 % overlap
+    uint32_t fps = cfg->sample_rate / d->hop;
+    d->rise_q16 = (int32_t)(((uint32_t)cfg->noise_rise_q8 << 8) / (fps ? fps : 1));
+
+    d->fft = fft_q15_create_real(d->n);
+    d->window = (int16_t *)malloc(d->n * sizeof(int16_t));
+    d->input = (int16_t *)malloc(d->n * sizeof(int16_t));
+    d->output = (int16_t *)malloc(d->hop * sizeof(int16_t));
+    d->overlap = (int32_t *)malloc(d->n * sizeof(int32_t));
+    d->fft_mem = malloc((d->n + 2) * sizeof(int16_t) + 15);
+    d->smooth_log = (int32_t *)malloc(d->bins * sizeof(int32_t));
+    d->noise_log = (int32_t *)malloc(d->bins * sizeof(int32_t));
+    d->prev_snr = (uint32_t *)malloc(d->bins * sizeof(uint32_t));
+    if (!d->fft || !d->window || !d->input || !d->output || !d->overlap || !d->fft_mem ||
+        !d->smooth_log || !d->noise_log || !d->prev_snr) {
+        denoise_destroy(d);
+        return NULL;
+    }
+    d->fft_buf = (int16_t *)(((uintptr_t)d->fft_mem + 15) & ~(uintptr_t)15);
+
+    for (uint16_t i = 0; i < d->n; i++) {
+        float w = sqrtf(0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / d->n));
+        d->window[i] = (int16_t)lrintf(w * 32767.0f);
+    }
+    denoise_reset(d);
+    return d;
+}
+
+void denoise_destroy(denoise_t *d) {
+    if (!d) return;
+    fft_q15_destroy(d->fft);
+    free(d->window);
+    free(d->input);
+    free(d->output);
+    free(d->overlap);
+    free(d->fft_mem);
+    free(d->smooth_log);
+    free(d->noise_log);
+    free(d->prev_snr);
+    free(d);
+}
+
+void denoise_reset(denoise_t *d) {
+    if (!d) return;
+    memset(d->input, 0, d->n * sizeof(int16_t));
+    memset(d->output, 0, d->hop * sizeof(int16_t));
+    memset(d->overlap, 0, d->n * sizeof(int32_t));
+    memset(d->prev_snr, 0, d->bins * sizeof(uint32_t));
+    memset(&d->stats, 0, sizeof(d->stats));
+    d->pos = 0;
+}
+
+void denoise_process(denoise_t *d, int16_t *pcm, size_t count) {
+    if (!d || !pcm) return;
+
+    int16_t *tail = d->input + d->n - d->hop;
+    for (size_t i = 0; i < count; i++) {
+        int16_t x = pcm[i];
+        pcm[i] = d->output[d->pos];
+        tail[d->pos] = x;
+        if (++d->pos == d->hop) {
+            process_frame(d);
+            d->pos = 0;
+        }
+    }
+}
+
+uint32_t denoise_delay(const denoise_t *d) {
+    return d ? d->n : 0;
+}
+
+void denoise_get_stats(const denoise_t *d, denoise_stats_t *stats) {
+    if (!d || !stats) return;
+    *stats = d->stats;
+}
+
+} // extern "C"
@@ -0,0 +1,77 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming spectral noise suppressor for 16-bit mono PCM.
+ *
+ * Frames of fft_size samples are taken every fft_size / 2 samples with a
+ * square-root Hann window, transformed with the real fft_q15, scaled per
+ * bin by a Wiener gain and overlap-added back after the same window (the
+ * squared windows sum to one, so unit gain reconstructs the input).
+ *
+ * The noise power in each bin is tracked in the log domain: it follows the
+ * smoothed power down at once and rises by a fixed rate otherwise, so it
+ * settles on the floor between words without a separate VAD. The gain
+ * comes from a decision-directed a-priori SNR, which keeps musical noise
+ * low, and never drops below min_gain_q15.
+ *
+ * All buffers are allocated by denoise_create(); denoise_process() runs in
+ * place, never allocates and adds a fixed delay of fft_size samples.
+ */
+typedef struct denoise denoise_t;
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t fft_size;          // Frame length, a power of two from 64 to 1024
+    uint16_t min_gain_q15;      // Gain floor, bounds the attenuation
+    uint16_t dd_alpha_q15;      // Weight of the previous frame in the a-priori SNR
+    uint16_t noise_rise_q8;     // Noise estimate rise per second, Q8 log2 (256 = 3 dB)
+    uint16_t noise_bias_q8;     // Mean noise power over the tracked minimum, Q8 log2
+} denoise_config_t;
+
+typedef struct {
+    uint32_t frames;            // Frames processed since reset
+    uint16_t gain_q15;          // Mean gain over the bins of the last frame
+    int16_t noise_q8;           // Mean noise estimate of the last frame, Q8 log2 of
+                                // mean-square amplitude (0 dB = 1 LSB)
+} denoise_stats_t;
+
+/**
+ * @brief 16 ms frames (256 at 16 kHz), at most 15 dB of attenuation.
+ */
+void denoise_config_default(denoise_config_t *cfg, uint32_t sample_rate);
+
+denoise_t *denoise_create(const denoise_config_t *cfg);
+void denoise_destroy(denoise_t *dn);
+
+/**
+ * @brief Clear buffered audio and forget the noise estimate.
+ */
+void denoise_reset(denoise_t *dn);
+
+/**
+ * @brief Suppress noise in count samples, in place. Output lags the input
+ *        by denoise_delay() samples; the first samples after a reset are
+ *        silence.
+ */
+void denoise_process(denoise_t *dn, int16_t *pcm, size_t count);
+
+/**
+ * @brief Delay added by denoise_process(), in samples.
+ */
+uint32_t denoise_delay(const denoise_t *dn);
+
+void denoise_get_stats(const denoise_t *dn, denoise_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // DENOISE_H
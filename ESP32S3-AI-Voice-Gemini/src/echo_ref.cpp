@@ -0,0 +1,188 @@
+// src/echo_ref.cpp - Speaker reference timeline for the echo canceller
+
+#include "echo_ref.h"
+#include "audio_hal.h"
+#include "resampler.h"
+#include "psram_alloc.h"
+#include <atomic>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+static const char *TAG = "ECHO_REF";
+#endif
+
+#define ECHO_REF_CHUNK          128     // Input samples per resampler call
+#define ECHO_REF_CHUNK_OUT      (ECHO_REF_CHUNK * 4)
+#define ECHO_REF_SLIP_US        2000    // Reader realigns when it is further off than this
+#define ECHO_REF_NEVER          (INT64_MIN / 2)
+
+static int16_t *s_buf = NULL;
+static uint32_t s_out_rate = 0;
+
+// Writer state
+static resampler_t *s_resampler = NULL;
+static uint32_t s_in_rate = 0;
+static int64_t s_last_write_us = ECHO_REF_NEVER;
+static int16_t s_chunk[ECHO_REF_CHUNK_OUT];
+static std::atomic<uint32_t> s_head(0);         // Timeline index of the next sample
+
+// Current stream, published under a sequence count (odd while updating)
+static std::atomic<uint32_t> s_stream_seq(0);
+static std::atomic<uint32_t> s_stream_first(0); // Timeline index played at s_stream_start_us
+static std::atomic<uint32_t> s_stream_start_us(0);
+
+// Reader state
+static uint32_t s_synced_seq = UINT32_MAX;
+static uint32_t s_pos = 0;                      // Timeline index of the next mic sample
+
+static echo_ref_stats_t s_stats;
+
+static void start_stream(uint32_t start_us) {
+    uint32_t seq = s_stream_seq.load(std::memory_order_relaxed);
+    s_stream_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    // Resampler output lags its input by the filter delay
+    uint32_t delay = s_resampler ? resampler_delay(s_resampler) : 0;
+    s_stream_first.store(s_head.load(std::memory_order_relaxed) + delay, std::memory_order_relaxed);
+    s_stream_start_us.store(start_us, std::memory_order_relaxed);
+    s_stream_seq.store(seq + 2, std::memory_order_release);
+    s_stats.streams++;
+}
+
+static void append(const int16_t *pcm, size_t count) {
+    uint32_t head = s_head.load(std::memory_order_relaxed);
+    const uint32_t mask = ECHO_REF_RING_SAMPLES - 1;
+    for (size_t i = 0; i < count; i++) {
+        s_buf[(head + i) & mask] = pcm[i];
+    }
+    s_head.store(head + (uint32_t)count, std::memory_order_release);
+    s_stats.written += count;
+}
+
+extern "C" {
+
+bool echo_ref_init(uint32_t out_rate) {
+    if (s_buf) {
+        return true;
+    }
+    if (out_rate == 0) {
+        return false;
+    }
+    s_buf = (int16_t *)psram_calloc(ECHO_REF_RING_SAMPLES, sizeof(int16_t));
+    if (!s_buf) {
+        return false;
+    }
+    s_out_rate = out_rate;
+    return true;
+}
+
+void echo_ref_reset(void) {
+    if (s_buf) memset(s_buf, 0, ECHO_REF_RING_SAMPLES * sizeof(int16_t));
+    resampler_destroy(s_resampler);
+    s_resampler = NULL;
+    s_in_rate = 0;
+    s_last_write_us = ECHO_REF_NEVER;
+    s_head.store(0);
+    s_stream_seq.store(0);
+    s_stream_first.store(0);
+    s_stream_start_us.store(0);
+    s_synced_seq = UINT32_MAX;
+    s_pos = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void echo_ref_write(const int16_t *pcm, size_t count, uint32_t rate) {
+    if (!s_buf || !pcm || count == 0 || rate == 0) {
+        return;
+    }
+
+    if (rate != s_in_rate) {
+        resampler_destroy(s_resampler);
+        s_resampler = NULL;
+        if (rate != s_out_rate) {
+            s_resampler = resampler_create(rate, s_out_rate, 0);
+#ifdef ESP_PLATFORM
+            if (!s_resampler) {
+                ESP_LOGW(TAG, "No %u -> %u Hz resampler, reference off", (unsigned)rate, (unsigned)s_out_rate);
+            }
+#endif
+        }
+        s_in_rate = rate;
+        s_last_write_us = ECHO_REF_NEVER;
+    }
+    if (!s_resampler && rate != s_out_rate) {
+        return;
+    }
+
+    // The samples start playing now; after a pause that starts a new stream
+    int64_t now = audio_hal_now_us();
+    if (now - s_last_write_us > ECHO_REF_GAP_MS * 1000) {
+        resampler_reset(s_resampler);
+        start_stream((uint32_t)now);
+    }
+    s_last_write_us = now + (int64_t)count * 1000000 / rate;
+
+    if (!s_resampler) {
+        append(pcm, count);
+        return;
+    }
+    while (count > 0) {
+        size_t n = count < ECHO_REF_CHUNK ? count : ECHO_REF_CHUNK;
+        size_t out = resampler_process(s_resampler, pcm, n, s_chunk, ECHO_REF_CHUNK_OUT);
+        append(s_chunk, out);
+        pcm += n;
+        count -= n;
+    }
+}
+
+void echo_ref_read(int16_t *dst, size_t count, int64_t frame_start_us) {
+    if (!dst || count == 0) {
+        return;
+    }
+    if (!s_buf) {
+        memset(dst, 0, count * sizeof(int16_t));
+        return;
+    }
+
+    uint32_t seq, first, start_us;
+    do {
+        seq = s_stream_seq.load(std::memory_order_acquire);
+        first = s_stream_first.load(std::memory_order_relaxed);
+        start_us = s_stream_start_us.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != s_stream_seq.load(std::memory_order_relaxed));
+
+    // Where this frame falls on the stream. Follow it sample by sample and
+    // realign only on a new stream or when the clocks have slipped, so the
+    // canceller sees a continuous reference.
+    int32_t since_us = (int32_t)((uint32_t)frame_start_us - start_us) + ECHO_REF_LEAD_US;
+    uint32_t pos = first + (uint32_t)(int32_t)((int64_t)since_us * s_out_rate / 1000000);
+    int32_t slip = (int32_t)(pos - s_pos);
+    int32_t slip_max = (int32_t)(ECHO_REF_SLIP_US * (int64_t)s_out_rate / 1000000);
+    if (seq != s_synced_seq || slip > slip_max || slip < -slip_max) {
+        s_pos = pos;
+        s_synced_seq = seq;
+        s_stats.syncs++;
+    }
+
+    const uint32_t head = s_head.load(std::memory_order_acquire);
+    const uint32_t mask = ECHO_REF_RING_SAMPLES - 1;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t idx = s_pos + (uint32_t)i;
+        if ((int32_t)(idx - first) < 0 || (int32_t)(head - idx) <= 0) {
+            dst[i] = 0;                             // Before the stream or not played yet
+        } else if (head - idx > ECHO_REF_RING_SAMPLES) {
+            dst[i] = 0;
+            s_stats.lost++;
+        } else {
+            dst[i] = s_buf[idx & mask];
+        }
+    }
+    s_pos += (uint32_t)count;
+}
+
+void echo_ref_get_stats(echo_ref_stats_t *stats) {
+    if (stats) *stats = s_stats;
+}
+
+} // extern "C"
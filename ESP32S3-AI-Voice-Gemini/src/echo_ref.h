@@ -0,0 +1,71 @@
+#ifndef ECHO_REF_H
+#define ECHO_REF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Speaker reference for the echo canceller.
+ *
+ * The TTS task writes what it hands to the I2S speaker; the capture task
+ * reads it back one sample per mic sample, aligned to the time the mic
+ * frame was captured. The reference is resampled to the capture rate on
+ * the way in and kept on a sample timeline: a write after a pause of more
+ * than ECHO_REF_GAP_MS starts a new stream whose start time is recorded,
+ * and the reader maps each mic frame onto that stream from the two
+ * timestamps. Between streams and before the first one it reads zeros.
+ *
+ * Times come from the audio_hal clock. One writer and one reader, no locks.
+ */
+
+#define ECHO_REF_RING_SAMPLES   16384   // ~1 s at 16 kHz, power of two
+#define ECHO_REF_GAP_MS         50      // Silence that separates two streams
+#define ECHO_REF_LEAD_US        2000    // Reference runs this much ahead of the mic, so
+                                        // the echo always lands inside the filter
+
+typedef struct {
+    uint32_t streams;           // Streams started by the writer
+    uint32_t written;           // Samples written at the capture rate
+    uint32_t syncs;             // Times the reader aligned to a stream
+    uint32_t lost;              // Samples overwritten before they were read
+} echo_ref_stats_t;
+
+/**
+ * @brief Allocate the reference timeline. Call before either side runs.
+ * @param out_rate Capture rate the reference is resampled to
+ * @return false if it could not be allocated
+ */
+bool echo_ref_init(uint32_t out_rate);
+
+/**
+ * @brief Forget all streams and statistics. Neither side may be running.
+ */
+void echo_ref_reset(void);
+
+/**
+ * @brief Writer side: mono samples at rate that start playing now.
+ *
+ * Must not be called from an ISR; recreates the resampler when the rate
+ * changes.
+ */
+void echo_ref_write(const int16_t *pcm, size_t count, uint32_t rate);
+
+/**
+ * @brief Reader side: the reference for count mic samples, the first of
+ *        which was captured at frame_start_us (esp_timer time).
+ *
+ * Always fills dst; samples with no speaker output are zero.
+ */
+void echo_ref_read(int16_t *dst, size_t count, int64_t frame_start_us);
+
+void echo_ref_get_stats(echo_ref_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // ECHO_REF_H
@@ -0,0 +1,399 @@
+// src/fft_q15.cpp - Radix-4/2 fixed-point FFT with real-input split and inverse
+
+#include "fft_q15.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && CONFIG_IDF_TARGET_ESP32S3 && defined(__has_include)
+#if __has_include("dsps_fft2r.h")
+#include "dsps_fft2r.h"
+#define FFT_Q15_HAVE_DSP 1
+#endif
+#endif
+#ifndef FFT_Q15_HAVE_DSP
+#define FFT_Q15_HAVE_DSP 0
+#endif
+
+#define SELF_TEST_SIZE      256
+#define SELF_TEST_TOLERANCE 12      // LSBs; the kernels round differently per stage
+
+// Block floating point: largest |re| + |im| that survives one unscaled
+// radix-2 stage, two of them, and a scaled one, with a little margin for
+// twiddle rounding
+#define BFP_ONE_STAGE       16000
+#define BFP_TWO_STAGES      8000
+#define BFP_SCALED          32000
+
+struct fft_q15 {
+    uint16_t n;                 // Points of the complex transform
+    uint16_t log2n;
+    bool real;                  // Real plan of 2n samples
+    int16_t *twiddle;           // W_n^k for k < n/2 as (cos, -sin), Q15
+    uint16_t *bitrev;           // Swap pairs (i, j) with i < j
+    uint16_t bitrev_pairs;
+    int16_t *split;             // W_2n^k for k <= n/2, real plans only
+};
+
+static bool s_simd_enabled = FFT_Q15_HAVE_DSP;
+
+static inline int16_t sat16(int32_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+static void fill_twiddles(int16_t *w, uint16_t count, uint32_t n) {
+    for (uint16_t k = 0; k < count; k++) {
+        double a = 2.0 * M_PI * k / n;
+        w[2 * k] = (int16_t)lround(cos(a) * 32767.0);
+        w[2 * k + 1] = (int16_t)lround(-sin(a) * 32767.0);
+    }
+}
+
+static void bit_reverse(const fft_q15_t *fft, int16_t *data) {
+    for (uint16_t p = 0; p < fft->bitrev_pairs; p++) {
+        uint16_t i = fft->bitrev[2 * p], j = fft->bitrev[2 * p + 1];
+        int16_t re = data[2 * i], im = data[2 * i + 1];
+        data[2 * i] = data[2 * j];
+        data[2 * i + 1] = data[2 * j + 1];
+        data[2 * j] = re;
+        data[2 * j + 1] = im;
+    }
+}
+
+static int32_t max_l1(const int16_t *data, uint16_t n) {
+    int32_t m = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        int32_t re = data[2 * i], im = data[2 * i + 1];
+        int32_t v = (re < 0 ? -re : re) + (im < 0 ? -im : im);
+        if (v > m) m = v;
+    }
+    return m;
+}
+
+// Halve everything when even a scaled stage could overflow
+static int prescale(int16_t *data, uint16_t n, int32_t *m) {
+    if (*m <= BFP_SCALED) return 0;
+    for (uint16_t i = 0; i < 2 * n; i++) {
+        data[i] = (int16_t)(data[i] >> 1);
+    }
+    *m = (*m + 1) >> 1;
+    return 1;
+}
+
+// All stages after bit reversal. The forward transform halves every stage;
+// with bfp, a stage is only halved when the current peak requires it.
+// The inverse uses conjugate twiddles. Returns the number of halvings.
+template <bool INVERSE>
+static int run_stages(const fft_q15_t *fft, int16_t *data, bool bfp) {
+    const uint16_t n = fft->n;
+    const int16_t *tw = fft->twiddle;
+    int exponent = 0;
+    uint16_t half = 1;
+
+    if (fft->log2n & 1) {
+        // Radix-2 pass with unit twiddles
+        int sh = 1;
+        if (bfp) {
+            int32_t m = max_l1(data, n);
+            exponent += prescale(data, n, &m);
+            sh = m > BFP_ONE_STAGE;
+        }
+        exponent += sh;
+        for (uint16_t i = 0; i < n; i += 2) {
+            int16_t *a = data + 2 * i, *b = a + 2;
+            int32_t ar = a[0], ai = a[1], br = b[0], bi = b[1];
+            a[0] = (int16_t)((ar + br) >> sh);
+            a[1] = (int16_t)((ai + bi) >> sh);
+            b[0] = (int16_t)((ar - br) >> sh);
+            b[1] = (int16_t)((ai - bi) >> sh);
+        }
+        half = 2;
+    }
+
+    // Radix-4 passes: the radix-2 stages with half sizes h and 2h fused.
+    // The second stage's odd twiddle W_4h^(k+h) is W_4h^k times -j (+j for
+    // the inverse), so three twiddle products cover four points.
+    for (; half < n; half <<= 2) {
+        int sh1 = 1, sh2 = 1;
+        if (bfp) {
+            int32_t m = max_l1(data, n);
+            exponent += prescale(data, n, &m);
+            sh1 = m > BFP_TWO_STAGES;
+            sh2 = m > BFP_ONE_STAGE;
+        }
+        exponent += sh1 + sh2;
+
+        const uint16_t stride1 = n / (2 * half), stride2 = n / (4 * half);
+        for (uint16_t start = 0; start < n; start += 4 * half) {
+            for (uint16_t k = 0; k < half; k++) {
+                const int32_t w1r = tw[2 * k * stride1];
+                const int32_t w1i = INVERSE ? -tw[2 * k * stride1 + 1] : tw[2 * k * stride1 + 1];
+                const int32_t w2r = tw[2 * k * stride2];
+                const int32_t w2i = INVERSE ? -tw[2 * k * stride2 + 1] : tw[2 * k * stride2 + 1];
+                int16_t *p0 = data + 2 * (start + k);
+                int16_t *p1 = p0 + 2 * half, *p2 = p1 + 2 * half, *p3 = p2 + 2 * half;
+
+                int32_t t1r = (p1[0] * w1r - p1[1] * w1i + (1 << 14)) >> 15;
+                int32_t t1i = (p1[0] * w1i + p1[1] * w1r + (1 << 14)) >> 15;
+                int32_t t3r = (p3[0] * w1r - p3[1] * w1i + (1 << 14)) >> 15;
+                int32_t t3i = (p3[0] * w1i + p3[1] * w1r + (1 << 14)) >> 15;
+                int32_t b0r = (p0[0] + t1r) >> sh1, b0i = (p0[1] + t1i) >> sh1;
+                int32_t b1r = (p0[0] - t1r) >> sh1, b1i = (p0[1] - t1i) >> sh1;
+                int32_t b2r = (p2[0] + t3r) >> sh1, b2i = (p2[1] + t3i) >> sh1;
+                int32_t b3r = (p2[0] - t3r) >> sh1, b3i = (p2[1] - t3i) >> sh1;
+
+                int32_t u2r = (b2r * w2r - b2i * w2i + (1 << 14)) >> 15;
+                int32_t u2i = (b2r * w2i + b2i * w2r + (1 << 14)) >> 15;
+                int32_t v3r = (b3r * w2r - b3i * w2i + (1 << 14)) >> 15;
+                int32_t v3i = (b3r * w2i + b3i * w2r + (1 << 14)) >> 15;
+                int32_t u3r = INVERSE ? -v3i : v3i;
+                int32_t u3i = INVERSE ? v3r : -v3r;
+
+                p0[0] = (int16_t)((b0r + u2r) >> sh2);
+                p0[1] = (int16_t)((b0i + u2i) >> sh2);
+                p2[0] = (int16_t)((b0r - u2r) >> sh2);
+                p2[1] = (int16_t)((b0i - u2i) >> sh2);
+                p1[0] = (int16_t)((b1r + u3r) >> sh2);
+                p1[1] = (int16_t)((b1i + u3i) >> sh2);
+                p3[0] = (int16_t)((b1r - u3r) >> sh2);
+                p3[1] = (int16_t)((b1i - u3i) >> sh2);
+            }
+        }
+    }
+    return exponent;
+}
+
+static void forward_portable(const fft_q15_t *fft, int16_t *data) {
+    bit_reverse(fft, data);
+    run_stages<false>(fft, data, false);
+}
+
+#if FFT_Q15_HAVE_DSP
+static bool s_dsp_ready = false;
+
+static bool dsp_init(void) {
+    if (!s_dsp_ready) {
+        s_dsp_ready = dsps_fft2r_init_sc16(NULL, FFT_Q15_MAX_SIZE) == ESP_OK;
+    }
+    return s_dsp_ready;
+}
+
+// ESP-DSP halves each stage with rounding and leaves the output in
+// bit-reversed order. The vector kernel needs 16-byte aligned data.
+static bool forward_dsp(const fft_q15_t *fft, int16_t *data) {
+    if (!s_dsp_ready || (((uintptr_t)data) & 15) != 0) return false;
+    if (dsps_fft2r_sc16(data, fft->n) != ESP_OK) return false;
+    dsps_bit_rev_sc16_ansi(data, fft->n);
+    return true;
+}
+#endif
+
+static void forward_complex(const fft_q15_t *fft, int16_t *data) {
+#if FFT_Q15_HAVE_DSP
+    if (s_simd_enabled && forward_dsp(fft, data)) return;
+#endif
+    forward_portable(fft, data);
+}
+
+static fft_q15_t *create_plan(uint16_t n, bool real) {
+    if (n < 4 || n > FFT_Q15_MAX_SIZE || (n & (n - 1)) != 0) {
+        return NULL;
+    }
+
+    fft_q15_t *fft = (fft_q15_t *)calloc(1, sizeof(fft_q15_t));
+    if (!fft) return NULL;
+    fft->n = n;
+    fft->real = real;
+    while ((1u << fft->log2n) < n) fft->log2n++;
+
+    fft->twiddle = (int16_t *)malloc(n * sizeof(int16_t));
+    fft->bitrev = (uint16_t *)malloc(n * sizeof(uint16_t));
+    if (real) {
+        fft->split = (int16_t *)malloc((n / 2 + 1) * 2 * sizeof(int16_t));
+    }
+    if (!fft->twiddle || !fft->bitrev || (real && !fft->split)) {
+        fft_q15_destroy(fft);
+        return NULL;
+    }
+
+    fill_twiddles(fft->twiddle, n / 2, n);
+    if (real) {
+        fill_twiddles(fft->split, n / 2 + 1, 2u * n);
+    }
+
+    for (uint16_t i = 0; i < n; i++) {
+        uint16_t j = 0;
+        for (uint16_t b = 0; b < fft->log2n; b++) {
+            j |= ((i >> b) & 1) << (fft->log2n - 1 - b);
+        }
+        if (i < j) {
+            fft->bitrev[2 * fft->bitrev_pairs] = i;
+            fft->bitrev[2 * fft->bitrev_pairs + 1] = j;
+            fft->bitrev_pairs++;
+        }
+    }
+
+#if FFT_Q15_HAVE_DSP
+    dsp_init();
+#endif
+    return fft;
+}
+
+extern "C" {
+
+fft_q15_t *fft_q15_create(uint16_t n) {
+    return create_plan(n, false);
+}
+
+fft_q15_t *fft_q15_create_real(uint16_t n) {
+    if (n < 8) return NULL;
+    return create_plan(n / 2, true);
+}
+
+void fft_q15_destroy(fft_q15_t *fft) {
+    if (!fft) return;
+    free(fft->twiddle);
+    free(fft->bitrev);
+    free(fft->split);
+    free(fft);
+}
+
+uint16_t fft_q15_size(const fft_q15_t *fft) {
+    if (!fft) return 0;
+    return fft->real ? (uint16_t)(2 * fft->n) : fft->n;
+}
+
+void fft_q15_forward(const fft_q15_t *fft, int16_t *data) {
+    if (!fft || !data || fft->real) return;
+    forward_complex(fft, data);
+}
+
+int fft_q15_inverse(const fft_q15_t *fft, int16_t *data) {
+    if (!fft || !data || fft->real) return 0;
+    bit_reverse(fft, data);
+    return run_stages<true>(fft, data, true);
+}
+
+// The n real samples are read as n/2 complex points z[m] = x[2m] + j x[2m+1].
+// With Z = FFT(z), the spectrum of x is
+//   X[k] = Xe[k] + W_n^k Xo[k],  X[n/2 - k] = conj(Xe[k] - W_n^k Xo[k])
+//   Xe[k] = (Z[k] + conj Z[M-k]) / 2,  Xo[k] = (Z[k] - conj Z[M-k]) / 2j
+// with M = n/2. One extra halving keeps the result at X / n.
+void fft_q15_real_forward(const fft_q15_t *fft, int16_t *data) {
+    if (!fft || !data || !fft->real) return;
+    const uint16_t M = fft->n;
+
+    forward_complex(fft, data);
+
+    int32_t zr = data[0], zi = data[1];
+    data[0] = (int16_t)((zr + zi) >> 1);
+    data[1] = 0;
+    data[2 * M] = (int16_t)((zr - zi) >> 1);
+    data[2 * M + 1] = 0;
+
+    for (uint16_t k = 1; k <= M / 2; k++) {
+        int16_t *a = data + 2 * k, *b = data + 2 * (M - k);
+        const int64_t wr = fft->split[2 * k], wi = fft->split[2 * k + 1];
+        int32_t ar = a[0], ai = a[1], br = b[0], bi = b[1];
+        int32_t er = ar + br, ei = ai - bi;         // 2 Xe
+        int32_t xr = ai + bi, xi = br - ar;         // 2 Xo
+        int32_t tr = (int32_t)((xr * wr - xi * wi + (1 << 14)) >> 15);
+        int32_t ti = (int32_t)((xr * wi + xi * wr + (1 << 14)) >> 15);
+        a[0] = sat16((er + tr) >> 2);
+        a[1] = sat16((ei + ti) >> 2);
+        b[0] = sat16((er - tr) >> 2);
+        b[1] = sat16((ti - ei) >> 2);
+    }
+}
+
+// Reverses the split: Z[k] = Xe[k] + j Xo[k] with
+//   Xe[k] = (X[k] + conj X[M-k]) / 2,  Xo[k] = (X[k] - conj X[M-k]) conj(W_n^k) / 2
+// The bins are first normalised to use the full range, Z is formed at half
+// scale and inverted with block floating point.
+int fft_q15_real_inverse(const fft_q15_t *fft, int16_t *data) {
+    if (!fft || !data || !fft->real) return 0;
+    const uint16_t M = fft->n;
+
+    data[1] = 0;
+    data[2 * M + 1] = 0;
+    int32_t m = max_l1(data, M + 1);
+    if (m == 0) {
+        memset(data, 0, 2 * M * sizeof(int16_t));
+        return 0;
+    }
+    int q = 0;
+    if (m > BFP_SCALED) {
+        q = -1;
+    } else {
+        while ((m << (q + 1)) <= BFP_SCALED) q++;
+    }
+    const int up = q > 0 ? q : 0, down = q < 0 ? -q : 0;
+
+    int32_t x0 = ((int32_t)data[0] << up) >> down;
+    int32_t xm = ((int32_t)data[2 * M] << up) >> down;
+    data[0] = (int16_t)((x0 + xm) >> 2);
+    data[1] = (int16_t)((x0 - xm) >> 2);
+
+    for (uint16_t k = 1; k <= M / 2; k++) {
+        int16_t *a = data + 2 * k, *b = data + 2 * (M - k);
+        const int64_t wr = fft->split[2 * k], wi = fft->split[2 * k + 1];
+        int32_t ar = ((int32_t)a[0] << up) >> down, ai = ((int32_t)a[1] << up) >> down;
+        int32_t br = ((int32_t)b[0] << up) >> down, bi = ((int32_t)b[1] << up) >> down;
+        int32_t er = ar + br, ei = ai - bi;         // 2 Xe
+        int32_t dr = ar - br, di = ai + bi;
+        int32_t orr = (int32_t)((dr * wr + di * wi + (1 << 14)) >> 15);    // 2 Xo
+        int32_t oi = (int32_t)((di * wr - dr * wi + (1 << 14)) >> 15);
+        a[0] = sat16((er - oi) >> 2);
+        a[1] = sat16((ei + orr) >> 2);
+        b[0] = sat16((er + oi) >> 2);
+        b[1] = sat16((orr - ei) >> 2);
+    }
+
+    bit_reverse(fft, data);
+    return run_stages<true>(fft, data, true) + 2 - q;
+}
+
+bool fft_q15_has_simd(void) {
+    return s_simd_enabled;
+}
+
+bool fft_q15_self_test(void) {
+#if FFT_Q15_HAVE_DSP
+    static int16_t ref[2 * SELF_TEST_SIZE] __attribute__((aligned(16)));
+    static int16_t simd[2 * SELF_TEST_SIZE] __attribute__((aligned(16)));
+
+    fft_q15_t *fft = fft_q15_create(SELF_TEST_SIZE);
+    bool ok = fft && dsp_init();
+    if (ok) {
+        // Deterministic pattern with magnitudes below full scale
+        uint32_t lcg = 0x2468ace1u;
+        for (int i = 0; i < 2 * SELF_TEST_SIZE; i++) {
+            lcg = lcg * 1664525u + 1013904223u;
+            ref[i] = (int16_t)((int32_t)lcg >> 17);
+        }
+        ref[0] = 23000;
+        ref[1] = -23000;
+        memcpy(simd, ref, sizeof(ref));
+
+        forward_portable(fft, ref);
+        ok = forward_dsp(fft, simd);
+        for (int i = 0; ok && i < 2 * SELF_TEST_SIZE; i++) {
+            int32_t d = (int32_t)ref[i] - simd[i];
+            ok = d <= SELF_TEST_TOLERANCE && d >= -SELF_TEST_TOLERANCE;
+        }
+    }
+    fft_q15_destroy(fft);
+    s_simd_enabled = ok;
+    return ok;
+#else
+    return true;
+#endif
+}
+
+} // extern "C"
@@ -0,0 +1,98 @@
+#ifndef FFT_Q15_H
+#define FFT_Q15_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fixed-point FFT on interleaved Q15 data (re, im, re, im, ...).
+ *
+ * Decimation in time with radix-4 passes (two radix-2 stages fused per
+ * pass, plus one radix-2 pass when log2(n) is odd). Twiddles and the
+ * bit-reversal table are built once by the create functions; transforms
+ * run in place and never allocate.
+ *
+ * The forward transform halves every stage, so its output is the DFT
+ * divided by n and cannot overflow as long as every input has a magnitude
+ * of at most 32767 (always true for real input). The inverse uses block
+ * floating point: a stage is only halved when it could overflow, and the
+ * number of halvings is returned as an exponent.
+ *
+ * On the ESP32-S3 the complex forward transform can use the ESP-DSP
+ * assembly kernel when ESP-DSP is available; fft_q15_self_test() decides.
+ */
+typedef struct fft_q15 fft_q15_t;
+
+#define FFT_Q15_MAX_SIZE    1024
+
+/**
+ * @param n Complex transform size, a power of two from 4 to FFT_Q15_MAX_SIZE
+ */
+fft_q15_t *fft_q15_create(uint16_t n);
+
+/**
+ * @brief Plan for n real samples, computed with an n/2-point complex
+ *        transform and a split pass.
+ * @param n Real transform size, a power of two from 8 to 2 * FFT_Q15_MAX_SIZE
+ */
+fft_q15_t *fft_q15_create_real(uint16_t n);
+void fft_q15_destroy(fft_q15_t *fft);
+
+/**
+ * @brief Points per transform: complex points, or real samples for a
+ *        real plan.
+ */
+uint16_t fft_q15_size(const fft_q15_t *fft);
+
+/**
+ * @brief Forward complex transform of n points in place, scaled by 1/n.
+ */
+void fft_q15_forward(const fft_q15_t *fft, int16_t *data);
+
+/**
+ * @brief Unnormalised inverse complex transform in place.
+ * @return e such that the inverse DFT times n equals data * 2^e
+ */
+int fft_q15_inverse(const fft_q15_t *fft, int16_t *data);
+
+/**
+ * @brief Forward transform of n real samples in place.
+ *
+ * data holds n samples on input and n / 2 + 1 complex bins (DC to Nyquist,
+ * n + 2 values) on output, scaled by 1/n like the complex transform.
+ */
+void fft_q15_real_forward(const fft_q15_t *fft, int16_t *data);
+
+/**
+ * @brief Inverse of fft_q15_real_forward(), in place.
+ *
+ * data holds n / 2 + 1 bins on input (the imaginary parts of DC and
+ * Nyquist are ignored) and n real samples on output.
+ *
+ * @return e such that the signal whose forward transform is the input
+ *         equals data * 2^e (e may be negative)
+ */
+int fft_q15_real_inverse(const fft_q15_t *fft, int16_t *data);
+
+/**
+ * @brief True when the SIMD kernel is compiled in and enabled.
+ */
+bool fft_q15_has_simd(void);
+
+/**
+ * @brief Compare the SIMD forward kernel with the portable one on a fixed
+ *        pattern. The SIMD path is disabled if they differ by more than
+ *        rounding.
+ * @return true if both agree (or there is no SIMD kernel)
+ */
+bool fft_q15_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // FFT_Q15_H
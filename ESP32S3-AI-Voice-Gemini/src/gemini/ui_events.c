@@ -11,6 +11,9 @@
 #include "gemini_client.h"
 #include "text_to_speech.h"
 #include "storage_manager.h"
+#include "audio_capture.h"
+#include "sentence_split.h"
+#include "ui_manager.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -109,6 +112,11 @@ void play_text_in_chunks(const char *text) {
             while (text_to_speech_is_playing()) {
                 vTaskDelay(pdMS_TO_TICKS(100));
             }
+
+            // The user talked over the playback; the rest is not wanted
+            if (is_voice_recording) {
+                break;
+            }
             
             vTaskDelay(pdMS_TO_TICKS(500)); // Pause between chunks
         }
@@ -130,17 +138,22 @@ void chat_screen_on_record_start(lv_event_t * e)
     if (text_to_speech_is_playing()) {
         // TTS is playing, stop it first
         text_to_speech_stop();
-        ui_manager_show_toast("Đã dừng phát âm");
-        return;
+        if (!audio_capture_is_echo_cancel_enabled()) {
+            ui_manager_show_toast("Đã dừng phát âm");
+            return;
+        }
+        // Barge-in: the echo canceller kept the mic usable during playback,
+        // so the pre-roll in the ring already holds the start of the request
     }
     
+    // A question still on its way is stale now: drop it, don't wait for it
+    gemini_client_cancel_all();
+    
     is_voice_recording = true;
     ui_manager_set_recording_indicator(true);
     ui_manager_show_toast("🎤 Bắt đầu ghi âm...");
     
-    speech_to_text_start();
-    
-    // Create voice recording task
+    // Create voice recording task; it starts the recording
     xTaskCreatePinnedToCore(
         voice_recording_task,
         "voice_record",
@@ -166,9 +179,16 @@ void chat_screen_on_record_stop(lv_event_t * e)
 // Voice recording task implementation
 void voice_recording_task(void *parameter)
 {
-    // Record for 5 seconds
-    ui_manager_show_toast("⏳ Đang ghi âm... (5 giây)");
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    // A cancelled request may still hold the last recording; it lets go
+    // within a moment. The pre-roll keeps what was said meanwhile.
+    gemini_client_wait_idle(1000);
+    speech_to_text_start();
+    
+    // Record until the user stops talking
+    ui_manager_show_toast("⏳ Đang ghi âm...");
+    while (!speech_to_text_update()) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
     
     // Stop recording and get audio data
     uint8_t *audio_buffer = NULL;
@@ -178,18 +198,31 @@ void voice_recording_task(void *parameter)
     ui_manager_set_recording_indicator(false);
     is_voice_recording = false;
     
-    if (audio_buffer && audio_length > 0) {
+    // The answer is shown from the network task; this one is done once
+    // the question is handed over
+    bool asked = false;
+    
+    if (audio_buffer && audio_length > 0 && gemini_client_is_voice_mode()) {
+        // Gemini hears the recording itself; no speech-to-text round trip.
+        // The buffer is given back once the answer is done.
+        handle_user_audio(audio_buffer, audio_length);
+        asked = true;
+    } else if (audio_buffer && audio_length > 0) {
         ui_manager_show_toast("🔄 Chuyển đổi giọng nói...");
         
         // Convert speech to text
         char *user_text = speech_to_text_process(audio_buffer, audio_length);
-        free(audio_buffer);
+        speech_to_text_release_buffer(audio_buffer);
         
-        if (user_text && strlen(user_text) > 0 && 
+        if (is_voice_recording) {
+            // The user started over while this was transcribed
+            free(user_text);
+        } else if (user_text && strlen(user_text) > 0 && 
             strcmp(user_text, "Không nhận diện được giọng nói") != 0) {
             
             // Process the recognized text
             handle_user_text(user_text);
+            asked = true;
             free(user_text);
         } else {
             ui_manager_show_toast("❌ Không nhận diện được giọng nói");
@@ -200,13 +233,28 @@ void voice_recording_task(void *parameter)
         ui_manager_show_toast("❌ Lỗi ghi âm");
         chat_screen_append_bot("Có lỗi trong quá trình ghi âm. Vui lòng thử lại.");
         handle_user_text("Xin chào");
+        asked = true;
     }
     
-    ui_manager_show_toast("✅ Sẵn sàng");
+    if (!asked) {
+        ui_manager_show_toast("✅ Sẵn sàng");
+    }
     voice_task_handle = NULL;
     vTaskDelete(NULL);
 }
 
+static void key_tested(void *ctx, gemini_result_t *res)
+{
+    if (res->cancelled) {
+        return;
+    }
+    if (res->err != ESP_OK) {
+        ui_manager_show_toast("API Key không hợp lệ");
+    } else {
+        ui_manager_switch_to_chat_screen();
+    }
+}
+
 // Event: save Wi-Fi & API key settings
 void config_screen_on_save(lv_event_t * e)
 {
@@ -228,39 +276,131 @@ void config_screen_on_save(lv_event_t * e)
     // Connect to Wi-Fi
     wifi_manager_connect(ssid, pass);
 
-    // Test API key and switch screen
-    if (gemini_client_test_key(key) != ESP_OK) {
+    // Test API key on the network task; key_tested() switches screen
+    gemini_async_t opts = { NULL, key_tested, NULL, NULL };
+    if (gemini_client_submit_key_test(key, &opts) == 0) {
         ui_manager_show_toast("API Key không hợp lệ");
     } else {
-        ui_manager_switch_to_chat_screen();
+        ui_manager_show_toast("⏳ Đang kiểm tra API Key...");
+    }
+}
+
+// The UI helpers below are also called from the network and recording
+// tasks. LVGL may only be used on the LVGL task, so they post their LVGL
+// calls there with ui_manager_post(), which runs them at once when already
+// on it. Text is copied into the post and freed once shown.
+static void run_append(void *arg)
+{
+    lv_textarea_add_text(ui_tachat, (const char *)arg);
+    free(arg);
+}
+
+static void run_toast(void *arg)
+{
+    lv_label_set_text(ui_lbtoast, (const char *)arg);
+    free(arg);
+}
+
+static void run_recording_indicator(void *arg)
+{
+    lv_color_t color = lv_color_hex(arg ? 0xFF0000 : 0x00FF00);
+    lv_obj_set_style_bg_color(ui_btnTalk, color, 0);
+}
+
+static void run_load_screen(void *arg)
+{
+    lv_scr_load((lv_obj_t *)arg);
+}
+
+// Post fn with prefix and the first len bytes of txt as one string
+static void post_text(ui_post_fn fn, const char *prefix, const char *txt, size_t len)
+{
+    size_t prefix_len = strlen(prefix);
+    char *copy = malloc(prefix_len + len + 1);
+    if (!copy) {
+        return;
+    }
+    memcpy(copy, prefix, prefix_len);
+    memcpy(copy + prefix_len, txt, len);
+    copy[prefix_len + len] = '\0';
+    if (!ui_manager_post(fn, copy)) {
+        free(copy);
     }
 }
 
 // UI helpers to append chat bubbles
 void chat_screen_append_user(const char *txt)
 {
-    lv_textarea_add_text(ui_tachat, "\nBạn: ");
-    lv_textarea_add_text(ui_tachat, txt);
+    post_text(run_append, "\nBạn: ", txt, strlen(txt));
 }
 
 void chat_screen_append_bot(const char *txt)
 {
-    lv_textarea_add_text(ui_tachat, "\nAI: ");
-    lv_textarea_add_text(ui_tachat, txt);
+    post_text(run_append, "\nAI: ", txt, strlen(txt));
 }
 
-// ✅ MODIFIED: Core flow with C-compatible chunked TTS
-void handle_user_text(const char *text)
+// A streamed answer: shown as it arrives and spoken a sentence at a time
+typedef struct {
+    sentence_split_t split;
+    bool shown;     // "AI: " is on screen
+} stream_view_t;
+
+static void speak_sentence(void *ctx, const char *sentence, size_t len)
 {
-    if (!text || strlen(text) == 0) {
+    // The user talked over the playback; the rest is not wanted
+    if (is_voice_recording) {
         return;
     }
-    
+    text_to_speech_enqueue(sentence);
+}
+
+static void show_transcript(void *ctx, const char *text)
+{
     chat_screen_append_user(text);
-    ui_manager_show_toast("🤖 Đang hỏi Gemini...");
-    
-    char *resp = gemini_client_request(text);
-    
+}
+
+static void show_answer_piece(void *ctx, const char *text, size_t len)
+{
+    stream_view_t *view = (stream_view_t *)ctx;
+    if (!view->shown) {
+        view->shown = true;
+        chat_screen_append_bot("");
+        ui_manager_show_toast("🔊 Đang phát âm thanh...");
+    }
+    post_text(run_append, "", text, len);
+    sentence_split_feed(&view->split, text, len);
+}
+
+static void stream_view_init(stream_view_t *view)
+{
+    sentence_split_init(&view->split, speak_sentence, view);
+    view->shown = false;
+}
+
+static void show_no_answer(void)
+{
+    chat_screen_append_bot("Xin lỗi, tôi không thể trả lời lúc này. Vui lòng thử lại.");
+    text_to_speech_play("Xin lỗi, có lỗi xảy ra");
+    ui_manager_show_toast("❌ Lỗi kết nối Gemini");
+}
+
+// Speak what is left of the answer and log it, or report the failure
+static void stream_view_finish(stream_view_t *view, const char *question, char *resp)
+{
+    if (view->shown) {
+        sentence_split_finish(&view->split);
+        if (resp) {
+            storage_manager_log(question, resp);
+        }
+    } else {
+        show_no_answer();
+    }
+    free(resp);
+}
+
+// An answer read whole: show it, speak it and log it
+static void show_answer(const char *question, char *resp)
+{
     if (resp && strlen(resp) > 0) {
         chat_screen_append_bot(resp);
         ui_manager_show_toast("🔊 Đang phát âm thanh...");
@@ -273,42 +413,120 @@ void handle_user_text(const char *text)
         // }
         
         // Log the conversation
-        storage_manager_log(text, resp);
-        
-        free(resp);
+        storage_manager_log(question, resp);
     } else {
-        chat_screen_append_bot("Xin lỗi, tôi không thể trả lời lúc này. Vui lòng thử lại.");
-        text_to_speech_play("Xin lỗi, có lỗi xảy ra");
-        ui_manager_show_toast("❌ Lỗi kết nối Gemini");
-        if (resp) free(resp);
+        show_no_answer();
     }
+    free(resp);
 }
 
-// UI manager callbacks
-void ui_manager_set_recording_indicator(bool recording)
+// A question handed to the network task: what its answer needs when done
+typedef struct {
+    stream_view_t view;
+    gemini_client_stream_handler_t handler;
+    bool streamed;
+    char *question;         // Typed or transcribed; NULL for voice queries
+    uint8_t *wav;           // Recording to give back to speech_to_text, or NULL
+} pending_question_t;
+
+// Runs on the network task once the answer is in, or the question was
+// cancelled by a newer one. What it shows goes through the posting helpers.
+static void answer_done(void *ctx, gemini_result_t *res)
 {
-    if (recording) {
-        lv_obj_set_style_bg_color(ui_btnTalk, lv_color_hex(0xFF0000), 0);
-        // lv_label_set_text(ui_lbTalkStatus, "🎤 ĐANG GHI ÂM...");
+    pending_question_t *q = (pending_question_t *)ctx;
+    if (q->wav) {
+        speech_to_text_release_buffer(q->wav);
+    }
+    
+    const char *question = q->question ? q->question : (res->transcript ? res->transcript : "");
+    if (res->cancelled) {
+        // What was shown of it stays; the rest is not wanted
+    } else if (q->streamed) {
+        stream_view_finish(&q->view, question, res->answer);
+        ui_manager_show_toast("✅ Sẵn sàng");
     } else {
-        lv_obj_set_style_bg_color(ui_btnTalk, lv_color_hex(0x00FF00), 0);
-        // lv_label_set_text(ui_lbTalkStatus, "👆 Chạm để nói");
+        if (!q->question && res->transcript && strlen(res->transcript) > 0) {
+            chat_screen_append_user(res->transcript);
+        }
+        show_answer(question, res->answer);
+        ui_manager_show_toast("✅ Sẵn sàng");
     }
+    
+    free(res->transcript);
+    free(q->question);
+    free(q);
+}
+
+// Hand a question to the network task without waiting for the answer
+static void ask_gemini(const char *text, uint8_t *wav, size_t len)
+{
+    pending_question_t *q = calloc(1, sizeof(pending_question_t));
+    if (q && text) {
+        q->question = strdup(text);
+    }
+    if (!q || (text && !q->question)) {
+        if (q) free(q);
+        if (wav) speech_to_text_release_buffer(wav);
+        show_no_answer();
+        return;
+    }
+    
+    q->wav = wav;
+    q->streamed = gemini_client_is_streaming();
+    stream_view_init(&q->view);
+    q->handler.on_transcript = wav ? show_transcript : NULL;
+    q->handler.on_text = show_answer_piece;
+    q->handler.ctx = &q->view;
+    
+    gemini_async_t opts = { q->streamed ? &q->handler : NULL, answer_done, q, NULL };
+    gemini_request_t id = wav ? gemini_client_submit_audio(wav, len, &opts)
+                              : gemini_client_submit(text, &opts);
+    if (id == 0) {
+        // Queue full: reported as a failed request
+        gemini_result_t res = { 0 };
+        answer_done(q, &res);
+    }
+}
+
+// ✅ MODIFIED: Core flow with C-compatible chunked TTS
+void handle_user_text(const char *text)
+{
+    if (!text || strlen(text) == 0) {
+        return;
+    }
+    
+    chat_screen_append_user(text);
+    ui_manager_show_toast("🤖 Đang hỏi Gemini...");
+    ask_gemini(text, NULL, 0);
+}
+
+// Voice query: one request returns both what the user said and the answer.
+// wav is the recording lent by speech_to_text, given back when it is done.
+void handle_user_audio(const uint8_t *wav, size_t len)
+{
+    ui_manager_show_toast("🤖 Đang hỏi Gemini...");
+    ask_gemini(NULL, (uint8_t *)wav, len);
+}
+
+// UI manager callbacks
+void ui_manager_set_recording_indicator(bool recording)
+{
+    ui_manager_post(run_recording_indicator, recording ? (void *)1 : NULL);
 }
 
 void ui_manager_switch_to_settings_screen(void)
 {
-    lv_scr_load(ui_Settings);
+    ui_manager_post(run_load_screen, ui_Settings);
 }
 
 void ui_manager_switch_to_chat_screen(void)
 {
-    lv_scr_load(ui_Main);
+    ui_manager_post(run_load_screen, ui_Main);
 }
 
 void ui_manager_show_toast(const char *msg)
 {
-    lv_label_set_text(ui_lbtoast, msg);
+    post_text(run_toast, "", msg, strlen(msg));
 }
 
 // Function to check if voice recording is active
@@ -11,20 +11,23 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Event handlers
 void chat_screen_on_record_start(lv_event_t * e);
 void chat_screen_on_record_stop(lv_event_t * e);
 void config_screen_on_save(lv_event_t * e);
 
-// Chat helpers
+// Chat helpers, safe from any task (posted to the LVGL task)
 void chat_screen_append_user(const char *txt);
 void chat_screen_append_bot(const char *txt);
 
 // Core text processing
 void handle_user_text(const char *text);
+void handle_user_audio(const uint8_t *wav, size_t len);
 
-// UI manager functions
+// UI manager functions, safe from any task as well
 void ui_manager_set_recording_indicator(bool recording);
 void ui_manager_switch_to_settings_screen(void);
 void ui_manager_switch_to_chat_screen(void);
@@ -3,181 +3,1066 @@
 #include "gemini_client.h"
 #include "ui_manager.h"
 #include "wifi_manager.h"
+#include "http_session.h"
+#include "request_writer.h"
+#include "gemini_reply.h"
+#include "text_query.h"
+#include "voice_query.h"
+#include "stream_collector.h"
+#include "conversation.h"
+#include "response_cache.h"
+#include "psram_alloc.h"
 #include <WiFi.h>
-#include <HTTPClient.h>
-#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "GEMINI";
 static char s_api_key[80] = {0};
 static const char *apiKey = "API-Key";
 
+#define GEMINI_DEFAULT_BASE_URL "https://generativelanguage.googleapis.com"
+#define GEMINI_MODEL            "gemini-2.0-flash"
+#define GEMINI_MAX_ANSWER       4096
+#define GEMINI_READ_CHUNK       512
+#define RESPONSE_CACHE_PARTITION "respcache"
+#define GEMINI_TASK_STACK       12288
+#define GEMINI_TASK_PRIORITY    3
+#define GEMINI_TASK_CORE        1
+#define GEMINI_QUEUE_LEN        4
+
+// Request paths up to the key
+static constexpr char GEMINI_MODEL_PATH[] = "/v1beta/models/" GEMINI_MODEL ":generateContent?key=";
+static constexpr char GEMINI_STREAM_PATH[] = "/v1beta/models/" GEMINI_MODEL ":streamGenerateContent?alt=sse&key=";
+#define GEMINI_PATH_MAX         (sizeof(GEMINI_STREAM_PATH) + sizeof(s_api_key))
+
+static char s_base_url[96] = GEMINI_DEFAULT_BASE_URL;
+static bool s_voice_mode = true;
+static bool s_streaming = true;
+
+// What was said so far; sent ahead of every question
+static conversation_t *s_history = NULL;
+
+// Answers to questions asked before, written back to flash by
+// gemini_client_flush_cache() from the main loop while requests run in
+// their own task
+static response_cache_t *s_cache = NULL;
+static SemaphoreHandle_t s_cache_lock = NULL;
+static bool s_cache_enabled = true;
+
+// One connection to the endpoint, kept open across turns. Replaced on the
+// next request after the base URL changes. Only the network task uses
+// s_conn; other tasks read the copies it publishes after each request.
+// s_state_lock guards s_base_url, s_conn_stale and those copies.
+static tls_conn_t *s_conn = NULL;
+static SemaphoreHandle_t s_state_lock = NULL;
+static bool s_conn_stale = false;
+static tls_conn_stats_t s_conn_stats;
+static gemini_stream_result_t s_stream_result;
+
+static void lock_state(void) {
+    if (s_state_lock) xSemaphoreTake(s_state_lock, portMAX_DELAY);
+}
+
+static void unlock_state(void) {
+    if (s_state_lock) xSemaphoreGive(s_state_lock);
+}
+
+// A request handed to the network task
+enum JobKind { JOB_KEY_TEST, JOB_TEXT, JOB_AUDIO };
+
+struct gemini_job {
+    gemini_job *next;               // In s_jobs
+    gemini_request_t id;
+    JobKind kind;
+    char *text;                     // Question or key
+    const uint8_t *wav;             // Lent until the result is delivered
+    size_t len;
+    gemini_async_t opts;
+    volatile bool cancel;
+    bool finished;                  // Result kept for gemini_client_take_result()
+    gemini_result_t res;
+};
+
+// The network task runs one job at a time from s_queue. s_jobs holds the
+// waiting, running and finished but untaken ones, for cancel and take.
+static TaskHandle_t s_worker = NULL;
+static QueueHandle_t s_queue = NULL;
+static SemaphoreHandle_t s_jobs_lock = NULL;
+static gemini_job *s_jobs = NULL;
+static gemini_request_t s_next_id = 1;
+static volatile uint32_t s_busy = 0;    // Jobs not delivered yet
+
+// Cancel flag of the running job; requests pass it to http_session
+static const volatile bool *s_cancel = NULL;
+
+static bool cancelled(void) {
+    return s_cancel && *s_cancel;
+}
+
+// "https://host[:port]" or "http://host[:port]"
+static bool parse_base_url(const char *url, char *host, size_t host_size, uint16_t *port, bool *secure) {
+    const char *p = url;
+    if (strncmp(p, "https://", 8) == 0) {
+        *secure = true;
+        *port = 443;
+        p += 8;
+    } else if (strncmp(p, "http://", 7) == 0) {
+        *secure = false;
+        *port = 80;
+        p += 7;
+    } else {
+        return false;
+    }
+    size_t n = strcspn(p, ":/");
+    if (n == 0 || n >= host_size) return false;
+    memcpy(host, p, n);
+    host[n] = '\0';
+    if (p[n] == ':') {
+        *port = (uint16_t)atoi(p + n + 1);
+    }
+    return *port != 0;
+}
+
+// Network task only
+static tls_conn_t *gemini_conn(void) {
+    char url[sizeof(s_base_url)];
+    lock_state();
+    bool stale = s_conn_stale;
+    s_conn_stale = false;
+    memcpy(url, s_base_url, sizeof(url));
+    unlock_state();
+
+    if (s_conn && stale) {
+        tls_conn_destroy(s_conn);
+        s_conn = NULL;
+    }
+    if (s_conn) return s_conn;
+
+    char host[80];
+    uint16_t port;
+    bool secure;
+    if (!parse_base_url(url, host, sizeof(host), &port, &secure)) {
+        loge(TAG, "Bad endpoint URL: %s", url);
+        return NULL;
+    }
+    s_conn = tls_conn_create(tls_transport_mbedtls_create(secure), host, port, NULL);
+    return s_conn;
+}
+
+// Copy what a request left for gemini_client_get_conn_stats() and
+// gemini_client_get_stream_result()
+static void publish_conn_stats(const gemini_stream_result_t *stream) {
+    tls_conn_stats_t st;
+    tls_conn_get_stats(s_conn, &st);
+    lock_state();
+    s_conn_stats = st;
+    if (stream) s_stream_result = *stream;
+    unlock_state();
+}
+
+// Path of a request: the constant part, then the key
+template <size_t N>
+static const char *request_path(char (&out)[GEMINI_PATH_MAX], const char (&fragment)[N], const char *key) {
+    size_t n = strnlen(key, sizeof(s_api_key) - 1);
+    memcpy(out, fragment, N - 1);
+    memcpy(out + N - 1, key, n);
+    out[N - 1 + n] = '\0';
+    return out;
+}
+
+// A request body (text_query_body, voice_query_body) is written into the
+// send buffer as it goes out: the conversation so far, then the constant
+// JSON around the escaped question or the base64 audio. Nothing is built
+// in memory, and any part can be written again for a retry.
+
+// A request reads the history while its body goes out, after its size
+// went into Content-Length, so only the network task changes it. Other
+// tasks ask for a change here and read a copy of the stats.
+static bool s_history_clear = false;        // Under s_state_lock, as are the rest
+static uint32_t s_history_max_bytes = 0;    // 0: as it is
+static uint32_t s_history_max_tokens = 0;
+static conversation_stats_t s_history_stats;
+
+static void publish_history_stats(void) {
+    conversation_stats_t st;
+    conversation_get_stats(s_history, &st);
+    lock_state();
+    s_history_stats = st;
+    unlock_state();
+}
+
+// Network task, between requests
+static void apply_history_changes(void) {
+    lock_state();
+    bool clear = s_history_clear;
+    uint32_t max_bytes = s_history_max_bytes, max_tokens = s_history_max_tokens;
+    s_history_clear = false;
+    s_history_max_bytes = s_history_max_tokens = 0;
+    unlock_state();
+    if (!clear && !max_bytes && !max_tokens) return;
+
+    if (clear) {
+        conversation_clear(s_history);
+        logi(TAG, "Conversation history cleared");
+    }
+    if (max_bytes || max_tokens) {
+        conversation_set_budget(s_history, max_bytes, max_tokens);
+    }
+    publish_history_stats();
+}
+
+// Remember an answered question for the next request
+static void remember(const char *question, const char *answer) {
+    if (!s_history || !question || !answer || !question[0] || !answer[0]) return;
+    conversation_add(s_history, CONVERSATION_USER, question);
+    conversation_add(s_history, CONVERSATION_MODEL, answer);
+    publish_history_stats();
+    conversation_stats_t st;
+    conversation_get_stats(s_history, &st);
+    logi(TAG, "History: %u turns, %u bytes, ~%u tokens, %u folded into the summary",
+         (unsigned)st.turns, (unsigned)st.bytes, (unsigned)st.tokens, (unsigned)st.folded);
+}
+
+static bool history_empty(void) {
+    conversation_stats_t st;
+    conversation_get_stats(s_history, &st);
+    return st.turns == 0 && st.summary_bytes == 0;
+}
+
+// The cached answer to input (caller frees), or NULL
+static char *cached_answer(const char *input) {
+    if (!s_cache || !s_cache_enabled) return NULL;
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    char *answer = response_cache_get(s_cache, input, wifi_manager_unix_time());
+    xSemaphoreGive(s_cache_lock);
+    if (answer) {
+        logi(TAG, "Answered from the cache: %s", input);
+    }
+    return answer;
+}
+
+// Keep an answer for next time. Only answers given with no earlier turns
+// are kept: one that leaned on the conversation ("and tomorrow?") would be
+// wrong for the same words asked afresh. round_trip_ms is 0 for voice
+// queries, whose time includes the upload a cached answer cannot save.
+static void cache_answer(const char *question, const char *answer, bool fresh, uint32_t round_trip_ms) {
+    if (!s_cache || !s_cache_enabled || !question || !answer) return;
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    if (round_trip_ms > 0) {
+        response_cache_note_miss(s_cache, round_trip_ms);
+    }
+    if (fresh) {
+        response_cache_put(s_cache, question, answer, wifi_manager_unix_time());
+    }
+    xSemaphoreGive(s_cache_lock);
+}
+
+// The answer is extracted straight into the buffer handed to the caller
+static void reply_init(gemini_reply_t *reply) {
+    char *buf = (char *)psram_malloc(GEMINI_MAX_ANSWER);
+    gemini_reply_init(reply, buf, buf ? GEMINI_MAX_ANSWER : 0);
+}
+
+// Send one request on the kept-alive connection and pull the answer out of
+// the reply as it is read; the body itself is never held. Returns the HTTP
+// status or an HTTP_SESSION_ERR_* code.
+static int gemini_exchange(http_request_t *req, gemini_reply_t *reply) {
+    tls_conn_t *conn = gemini_conn();
+    if (!conn) {
+        publish_conn_stats(NULL);
+        return HTTP_SESSION_ERR_CONNECT;
+    }
+
+    http_session_t session;
+    int status = http_session_begin(&session, conn, req);
+    if (status > 0) {
+        char chunk[GEMINI_READ_CHUNK];
+        int n;
+        while ((n = http_session_read(&session, chunk, sizeof(chunk))) > 0) {
+            gemini_reply_feed(reply, chunk, (size_t)n);
+        }
+        if (n < 0) status = n;
+    }
+    gemini_reply_finish(reply);
+    if (session.reused) {
+        logi(TAG, "Request sent on the open connection");
+    }
+    http_session_end(&session);
+    publish_conn_stats(NULL);
+    return status;
+}
+
+static size_t trim_in_place(char *s, size_t len) {
+    size_t a = 0;
+    while (a < len && (s[a] == ' ' || s[a] == '\n' || s[a] == '\t')) a++;
+    while (len > a && (s[len - 1] == ' ' || s[len - 1] == '\n' || s[len - 1] == '\t')) len--;
+    memmove(s, s + a, len - a);
+    s[len - a] = '\0';
+    return len - a;
+}
+
+// Turn the reply of a generateContent call into the text of the first
+// candidate, or an error message. The answer is reply's own buffer, shrunk
+// to fit; the caller frees the result.
+static char *read_answer(int httpCode, gemini_reply_t *reply) {
+    char *answer = reply->text;
+    logi(TAG, "HTTP Response Code: %d", httpCode);
+
+    if (httpCode != 200) {
+        if (httpCode > 0) {
+            loge(TAG, "HTTP error %d: %s", httpCode, reply->error);
+        } else {
+            loge(TAG, "HTTP POST failed: %s", http_session_error_name(httpCode));
+        }
+        free(answer);
+        return strdup("HTTP request failed");
+    }
+
+    if (reply->bytes == 0) {
+        loge(TAG, "No response data received");
+        free(answer);
+        return strdup("No response data");
+    }
+
+    logi(TAG, "Raw response received (%d chars)", (int)reply->bytes);
+
+    if (reply->failed || !reply->complete) {
+        loge(TAG, "JSON parsing failed after %d chars", (int)reply->bytes);
+        free(answer);
+        return strdup("Invalid JSON response");
+    }
+
+    if (reply->parts > 0 && answer) {
+        size_t len = trim_in_place(answer, reply->len);
+        if (reply->truncated) {
+            logw(TAG, "Answer cut to %d bytes", (int)len);
+        }
+        char *fit = (char *)psram_realloc(answer, len + 1);
+        logi(TAG, "✅ Gemini response parsed successfully");
+        logi(TAG, "Answer length: %d characters", (int)len);
+        return fit ? fit : answer;
+    }
+    free(answer);
+
+    // Check for API error
+    if (reply->error[0]) {
+        loge(TAG, "Gemini API error: %s", reply->error);
+        return strdup(reply->error);
+    }
+
+    loge(TAG, "No valid response found in JSON");
+    return strdup("No valid response found");
+}
+
+// The pieces of a streamed answer go to h, until the job is cancelled
+static void stream_handler(stream_collector_t *c, const gemini_client_stream_handler_t *h) {
+    if (h) {
+        c->on_transcript = h->on_transcript;
+        c->on_text = h->on_text;
+        c->ctx = h->ctx;
+    }
+    c->cancel = s_cancel;
+}
+
+// Run a streamGenerateContent request into c; the answer, or NULL.
+// complete: 200 read to the end, and none of the answer lost.
+static char *stream_exchange(http_request_t *req, stream_collector_t *c, bool *complete) {
+    *complete = false;
+    gemini_stream_result_t result;
+    memset(&result, 0, sizeof(result));
+    tls_conn_t *conn = gemini_conn();
+    if (!conn) {
+        publish_conn_stats(&result);
+        return NULL;
+    }
+
+    int status = gemini_stream_run(conn, req, stream_collector_feed, c, &result);
+    publish_conn_stats(&result);
+    const gemini_stream_result_t *r = &result;
+    logi(TAG, "Stream %d%s: headers %u ms, first text %u ms, end %u ms, %u events, %u bytes",
+         status, r->reused ? " (reused)" : "", (unsigned)r->headers_ms,
+         (unsigned)r->first_text_ms, (unsigned)r->total_ms, (unsigned)r->events,
+         (unsigned)r->text_bytes);
+    if (r->error[0]) {
+        loge(TAG, "Gemini API error: %s", r->error);
+    } else if (status < 0) {
+        loge(TAG, "Stream failed: %s", http_session_error_name(status));
+    }
+    if (r->dropped_events) {
+        logw(TAG, "%u events too long to read", (unsigned)r->dropped_events);
+    }
+    char *answer = stream_collector_finish(c);
+    // What a failed stream delivered is shown, but it may be cut short
+    *complete = answer && status == 200 && !r->error[0] && r->dropped_events == 0 && !c->lost;
+    return answer;
+}
+
 extern "C" {
+  static void network_task(void *param);
+
   void gemini_client_init(void) {
     strncpy(s_api_key, apiKey, sizeof(s_api_key) - 1);
     s_api_key[sizeof(s_api_key)-1] = '\0';
+    if (!s_history) {
+      s_history = conversation_create(NULL);
+      publish_history_stats();
+    }
+    if (!s_cache) {
+      response_cache_config_t cfg = {};
+      cfg.similarity = RESPONSE_CACHE_DEFAULT_SIMILARITY;
+      cfg.flash = response_cache_partition_flash(RESPONSE_CACHE_PARTITION);
+      s_cache = response_cache_create(&cfg);
+      s_cache_lock = xSemaphoreCreateMutex();
+      response_cache_stats_t st;
+      response_cache_get_stats(s_cache, &st);
+      logi(TAG, "Response cache: %u answers restored from flash", (unsigned)st.loaded);
+    }
+    if (!s_worker) {
+      s_state_lock = xSemaphoreCreateMutex();
+      s_jobs_lock = xSemaphoreCreateMutex();
+      s_queue = xQueueCreate(GEMINI_QUEUE_LEN, sizeof(gemini_job *));
+      xTaskCreatePinnedToCore(network_task, "gemini_net", GEMINI_TASK_STACK, NULL,
+                              GEMINI_TASK_PRIORITY, &s_worker, GEMINI_TASK_CORE);
+    }
     logi(TAG, "Gemini client initialized (Pure Arduino)");
   }
 
-  esp_err_t gemini_client_test_key(const char *key) {
+  // The requests themselves, run on the network task
+
+  static esp_err_t run_test_key(const char *key) {
     const char *use_key = (key && strlen(key) > 0) ? key : apiKey;
-    
+
     if (WiFi.status() != WL_CONNECTED) {
       loge(TAG, "WiFi not connected!");
       return ESP_FAIL;
     }
-    
-    HTTPClient http;
-    
-    String url = "https://generativelanguage.googleapis.com/v1beta/models/gemini-2.0-flash:generateContent?key=" + String(use_key);
-    
+
+    char path[GEMINI_PATH_MAX];
+
     logi(TAG, "Testing API key...");
-    
-    if (!http.begin(url)) {
-        loge(TAG, "HTTP begin failed");
-        return ESP_FAIL;
-    }
-    
-    http.setTimeout(15000);
-    http.addHeader("Content-Type", "application/json; charset=utf-8");
-    
-    int httpCode = http.GET();
-    
+
+    http_request_t req = {};
+    req.method = "GET";
+    req.path = request_path(path, GEMINI_MODEL_PATH, use_key);
+    req.timeout_ms = 15000;
+    req.cancel = s_cancel;
+
+    // Only the status and error.message are looked at
+    gemini_reply_t reply;
+    gemini_reply_init(&reply, NULL, 0);
+    int httpCode = gemini_exchange(&req, &reply);
+
     logi(TAG, "API test response code: %d", httpCode);
-    
-    if (httpCode == HTTP_CODE_OK || httpCode == 200) {
-        String response = http.getString();
+
+    esp_err_t ret = ESP_FAIL;
+    if (httpCode == 200) {
         logi(TAG, "API key validation successful");
-        
-        http.end();
         strncpy(s_api_key, use_key, sizeof(s_api_key) - 1);
-        return ESP_OK;
+        ret = ESP_OK;
     } else if (httpCode > 0) {
-        String response = http.getString();
-        loge(TAG, "HTTP error %d: %s", httpCode, response.c_str());
+        loge(TAG, "HTTP error %d: %s", httpCode, reply.error);
     } else {
-        loge(TAG, "HTTP request failed: %s", http.errorToString(httpCode).c_str());
+        loge(TAG, "HTTP request failed: %s", http_session_error_name(httpCode));
     }
-    
-    http.end();
-    return ESP_FAIL;
+
+    return ret;
   }
 
-  char *gemini_client_request(const char *input) {
+  static char *run_request(const char *input) {
     if (!input || strlen(input) == 0) {
       loge(TAG, "Empty input");
       return strdup("Empty input provided");
     }
-    
+
+    char *cached = cached_answer(input);
+    if (cached) {
+      remember(input, cached);
+      return cached;
+    }
+
     if (WiFi.status() != WL_CONNECTED) {
       loge(TAG, "WiFi not connected!");
       return strdup("WiFi not connected");
     }
 
     const char *use_key = (strlen(s_api_key) > 0) ? s_api_key : apiKey;
-    
-    HTTPClient http;
-    
-    String url = "https://generativelanguage.googleapis.com/v1beta/models/gemini-2.0-flash:generateContent?key=" + String(use_key);
-    
-    // ✅ FIX 1: Create proper JSON with UTF-8 support
-    JsonDocument doc;
-    JsonArray contents = doc["contents"].to<JsonArray>();
-    JsonObject content = contents.add<JsonObject>();
-    JsonArray parts = content["parts"].to<JsonArray>();
-    JsonObject part = parts.add<JsonObject>();
-    part["text"] = input;
-    
-    JsonObject genConfig = doc["generationConfig"].to<JsonObject>();
-    genConfig["maxOutputTokens"] = 100;
-    genConfig["temperature"] = 0.7;
-    
-    String payload;
-    serializeJson(doc, payload);
-    
+
+    char path[GEMINI_PATH_MAX];
+    bool fresh = history_empty();
+    request_writer_t body;
+    text_query_body(&body, s_history, input);
+
     logi(TAG, "Sending request to Gemini...");
     logi(TAG, "Input text: %s", input);
-    
-    if (!http.begin(url)) {
-        loge(TAG, "HTTP begin failed");
-        return strdup("HTTP begin failed");
-    }
-    
+
     // ✅ FIX 2: Proper UTF-8 headers
-    http.setTimeout(30000);
-    http.addHeader("Content-Type", "application/json; charset=utf-8");
-    http.addHeader("Accept", "application/json");
-    http.addHeader("Accept-Charset", "utf-8");
-    
-    int httpCode = http.POST(payload);
-    
-    logi(TAG, "HTTP Response Code: %d", httpCode);
-    
-    if (httpCode != HTTP_CODE_OK && httpCode != 200) {
-        if (httpCode > 0) {
-            String error_response = http.getString();
-            loge(TAG, "HTTP error %d: %s", httpCode, error_response.c_str());
-        } else {
-            loge(TAG, "HTTP POST failed: %s", http.errorToString(httpCode).c_str());
-        }
-        http.end();
-        return strdup("HTTP request failed");
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = request_path(path, GEMINI_MODEL_PATH, use_key);
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "application/json";
+    req.body_fn = request_writer_read;
+    req.body_ctx = &body;
+    req.body_len = request_writer_size(&body);
+    req.timeout_ms = 30000;
+    req.cancel = s_cancel;
+
+    uint32_t start_ms = millis();
+    gemini_reply_t reply;
+    reply_init(&reply);
+    int httpCode = gemini_exchange(&req, &reply);
+    bool answered = httpCode == 200 && reply.parts > 0;
+    char *text = read_answer(httpCode, &reply);
+    if (answered) {
+        remember(input, text);
+        cache_answer(input, text, fresh, millis() - start_ms);
     }
-    
-    String response = http.getString();
-    http.end();
-    
-    if (response.length() == 0) {
-        loge(TAG, "No response data received");
-        return strdup("No response data");
+    return text;
+  }
+
+  static char *run_request_audio(const uint8_t *wav, size_t len, char **transcript) {
+    if (transcript) *transcript = NULL;
+    if (!wav || len == 0) {
+      loge(TAG, "Empty audio");
+      return strdup("Empty input provided");
     }
-    
-    logi(TAG, "Raw response received (%d chars)", response.length());
-    
-    // ✅ FIX 3: Proper UTF-8 JSON parsing
-    JsonDocument responseDoc;
-    
-    DeserializationError error = deserializeJson(responseDoc, response);
-    if (error) {
-        loge(TAG, "JSON parsing failed: %s", error.c_str());
-        // Try to extract partial response for debugging
-        int maxLen = response.length() > 200 ? 200 : response.length();
-        String preview = response.substring(0, maxLen);
-        loge(TAG, "Response preview: %s", preview.c_str());
-        return strdup("Invalid JSON response");
+
+    if (WiFi.status() != WL_CONNECTED) {
+      loge(TAG, "WiFi not connected!");
+      return strdup("WiFi not connected");
     }
-    
-    // ✅ FIX 4: Better response extraction with UTF-8 handling
-    if (responseDoc["candidates"][0]["content"]["parts"][0]["text"]) {
-        String answer = responseDoc["candidates"][0]["content"]["parts"][0]["text"].as<String>();
-        
-        // ✅ Clean up the text but preserve UTF-8 characters
-        answer.trim();
-        
-        // Remove any null bytes or invalid characters
-        String cleanAnswer = "";
-        for (int i = 0; i < answer.length(); i++) {
-            char c = answer.charAt(i);
-            if (c != 0 && c != '\r') {  // Keep newlines but remove carriage returns and null bytes
-                cleanAnswer += c;
-            }
-        }
-        
-        char *result = strdup(cleanAnswer.c_str());
-        logi(TAG, "✅ Gemini response parsed successfully");
-        logi(TAG, "Answer length: %d characters", strlen(result));
-        // logi(TAG, "Answer: %s", result);
-        return result;
-    } else {
-        // Check for API error
-        if (responseDoc["error"]["message"]) {
-            String errorMsg = responseDoc["error"]["message"].as<String>();
-            loge(TAG, "Gemini API error: %s", errorMsg.c_str());
-            return strdup(errorMsg.c_str());
+
+    const char *use_key = (strlen(s_api_key) > 0) ? s_api_key : apiKey;
+
+    char path[GEMINI_PATH_MAX];
+    bool fresh = history_empty();
+    request_writer_t body;
+    voice_query_body(&body, s_history, wav, len, VOICE_QUERY_SCHEMA);
+
+    logi(TAG, "Sending voice query to Gemini (%u bytes of audio)...", (unsigned)len);
+
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = request_path(path, GEMINI_MODEL_PATH, use_key);
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "application/json";
+    req.body_fn = request_writer_read;
+    req.body_ctx = &body;
+    req.body_len = request_writer_size(&body);
+    req.timeout_ms = 30000;
+    req.cancel = s_cancel;
+
+    gemini_reply_t raw;
+    reply_init(&raw);
+    int httpCode = gemini_exchange(&req, &raw);
+    bool answered = httpCode == 200 && raw.parts > 0;
+    char *text = read_answer(httpCode, &raw);
+    if (!answered) {
+        return text;
+    }
+
+    // The reply text is itself the JSON object the schema asked for
+    const char *said, *answer;
+    if (!voice_query_parse(text, &said, &answer)) {
+        logw(TAG, "Voice reply is not the expected JSON, using it as the answer");
+        return text;
+    }
+    if (transcript && said) {
+        *transcript = strdup(said);
+    }
+    remember(said, answer);
+    cache_answer(said, answer, fresh, 0);
+    char *result = strdup(answer);
+    free(text);
+    return result;
+  }
+
+  static char *run_stream(const char *input, const gemini_client_stream_handler_t *h) {
+    if (!input || strlen(input) == 0) {
+      loge(TAG, "Empty input");
+      return NULL;
+    }
+
+    // A cached answer arrives as one piece
+    char *cached = cached_answer(input);
+    if (cached) {
+      if (h && h->on_text) h->on_text(h->ctx, cached, strlen(cached));
+      remember(input, cached);
+      return cached;
+    }
+
+    if (WiFi.status() != WL_CONNECTED) {
+      loge(TAG, "WiFi not connected!");
+      return NULL;
+    }
+
+    const char *use_key = (strlen(s_api_key) > 0) ? s_api_key : apiKey;
+
+    char path[GEMINI_PATH_MAX];
+    bool fresh = history_empty();
+    request_writer_t body;
+    text_query_body(&body, s_history, input);
+    stream_collector_t collector;
+    stream_collector_t *c = &collector;
+    stream_collector_init(c, false);
+
+    logi(TAG, "Streaming request to Gemini...");
+    logi(TAG, "Input text: %s", input);
+
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = request_path(path, GEMINI_STREAM_PATH, use_key);
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "text/event-stream";
+    req.body_fn = request_writer_read;
+    req.body_ctx = &body;
+    req.body_len = request_writer_size(&body);
+    req.timeout_ms = 30000;
+    req.cancel = s_cancel;
+
+    uint32_t start_ms = millis();
+    stream_handler(c, h);
+    bool complete;
+    char *answer = stream_exchange(&req, c, &complete);
+    // Cut short, it is neither the answer to remember nor one to keep
+    if (complete && !cancelled()) {
+        remember(input, answer);
+        cache_answer(input, answer, fresh, millis() - start_ms);
+    }
+    return answer;
+  }
+
+  static char *run_stream_audio(const uint8_t *wav, size_t len, char **transcript,
+                                 const gemini_client_stream_handler_t *h) {
+    if (transcript) *transcript = NULL;
+    if (!wav || len == 0) {
+      loge(TAG, "Empty audio");
+      return NULL;
+    }
+
+    if (WiFi.status() != WL_CONNECTED) {
+      loge(TAG, "WiFi not connected!");
+      return NULL;
+    }
+
+    const char *use_key = (strlen(s_api_key) > 0) ? s_api_key : apiKey;
+
+    char path[GEMINI_PATH_MAX];
+    bool fresh = history_empty();
+    request_writer_t body;
+    voice_query_body(&body, s_history, wav, len, VOICE_QUERY_STREAM);
+    stream_collector_t collector;
+    stream_collector_t *c = &collector;
+    stream_collector_init(c, true);
+
+    logi(TAG, "Streaming voice query to Gemini (%u bytes of audio)...", (unsigned)len);
+
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = request_path(path, GEMINI_STREAM_PATH, use_key);
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "text/event-stream";
+    req.body_fn = request_writer_read;
+    req.body_ctx = &body;
+    req.body_len = request_writer_size(&body);
+    req.timeout_ms = 30000;
+    req.cancel = s_cancel;
+
+    stream_handler(c, h);
+    bool complete;
+    char *answer = stream_exchange(&req, c, &complete);
+    if (transcript && c->transcript_len > 0) {
+        *transcript = strdup(c->transcript);
+    }
+    if (complete && c->transcript_len > 0 && !cancelled()) {
+        remember(c->transcript, answer);
+        cache_answer(c->transcript, answer, fresh, 0);
+    }
+    return answer;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Network task
+
+  static void run_job(gemini_job *job) {
+    gemini_result_t *res = &job->res;
+    res->id = job->id;
+    switch (job->kind) {
+    case JOB_KEY_TEST:
+      res->err = run_test_key(job->text);
+      break;
+    case JOB_TEXT:
+      res->answer = job->opts.stream ? run_stream(job->text, job->opts.stream) : run_request(job->text);
+      break;
+    case JOB_AUDIO:
+      res->answer = job->opts.stream
+                        ? run_stream_audio(job->wav, job->len, &res->transcript, job->opts.stream)
+                        : run_request_audio(job->wav, job->len, &res->transcript);
+      break;
+    }
+  }
+
+  static void unlink_job(gemini_job *job) {
+    for (gemini_job **p = &s_jobs; *p; p = &(*p)->next) {
+      if (*p == job) {
+        *p = job->next;
+        return;
+      }
+    }
+  }
+
+  // Hand the result over; the job is freed unless kept for take
+  static void deliver(gemini_job *job) {
+    gemini_result_t *res = &job->res;
+    res->id = job->id;
+    if (job->cancel) {
+      free(res->answer);
+      free(res->transcript);
+      memset(res, 0, sizeof(*res));
+      res->id = job->id;
+      res->cancelled = true;
+      res->err = ESP_FAIL;
+    }
+    free(job->text);
+    job->text = NULL;
+    gemini_request_t id = job->id;
+    TaskHandle_t notify = job->opts.notify;
+
+    if (job->opts.on_done) {
+      xSemaphoreTake(s_jobs_lock, portMAX_DELAY);
+      unlink_job(job);
+      xSemaphoreGive(s_jobs_lock);
+      job->opts.on_done(job->opts.ctx, res);
+      free(job);
+      job = NULL;
+    }
+    xSemaphoreTake(s_jobs_lock, portMAX_DELAY);
+    if (job) job->finished = true;
+    s_busy--;
+    xSemaphoreGive(s_jobs_lock);
+    if (notify) {
+      xTaskNotify(notify, id, eSetValueWithOverwrite);
+    }
+  }
+
+  static void network_task(void *param) {
+    for (;;) {
+      gemini_job *job = NULL;
+      if (xQueueReceive(s_queue, &job, portMAX_DELAY) != pdTRUE) continue;
+      apply_history_changes();
+      if (!job) continue;         // Only woken for a history change
+      if (job->cancel) {
+        logi(TAG, "Request %u dropped before it started", (unsigned)job->id);
+      } else {
+        s_cancel = &job->cancel;
+        run_job(job);
+        s_cancel = NULL;
+        if (job->cancel) {
+          logi(TAG, "Request %u cancelled", (unsigned)job->id);
         }
-        
-        loge(TAG, "No valid response found in JSON");
-        return strdup("No valid response found");
+      }
+      deliver(job);
+    }
+  }
+
+  static gemini_request_t submit(JobKind kind, const char *text, const uint8_t *wav, size_t len,
+                                 const gemini_async_t *opts, TickType_t wait) {
+    if (!s_queue) return 0;
+    gemini_job *job = (gemini_job *)calloc(1, sizeof(gemini_job));
+    if (!job) return 0;
+    job->kind = kind;
+    job->text = text ? strdup(text) : NULL;
+    job->wav = wav;
+    job->len = len;
+    if (opts) job->opts = *opts;
+    if (text && !job->text) {
+      free(job);
+      return 0;
+    }
+
+    xSemaphoreTake(s_jobs_lock, portMAX_DELAY);
+    gemini_request_t id = s_next_id++;
+    if (s_next_id == 0) s_next_id = 1;
+    job->id = id;
+    job->next = s_jobs;
+    s_jobs = job;
+    s_busy++;
+    xSemaphoreGive(s_jobs_lock);
+
+    if (xQueueSend(s_queue, &job, wait) != pdTRUE) {
+      xSemaphoreTake(s_jobs_lock, portMAX_DELAY);
+      unlink_job(job);
+      s_busy--;
+      xSemaphoreGive(s_jobs_lock);
+      free(job->text);
+      free(job);
+      logw(TAG, "Request queue full");
+      return 0;
+    }
+    return id;
+  }
+
+  struct Waiter {
+    SemaphoreHandle_t done;
+    gemini_result_t res;
+  };
+
+  static void wake_waiter(void *ctx, gemini_result_t *res) {
+    Waiter *w = (Waiter *)ctx;
+    w->res = *res;
+    xSemaphoreGive(w->done);
+  }
+
+  // A blocking call: the job goes to the network task and this one waits.
+  // On the network task itself (from on_done), or before
+  // gemini_client_init(), it runs here.
+  static gemini_result_t run_blocking(JobKind kind, const char *text, const uint8_t *wav, size_t len,
+                                      const gemini_client_stream_handler_t *h) {
+    if (s_worker && xTaskGetCurrentTaskHandle() != s_worker) {
+      Waiter w = {};
+      w.res.err = ESP_FAIL;
+      w.done = xSemaphoreCreateBinary();
+      gemini_async_t opts = { h, wake_waiter, &w, NULL };
+      if (w.done && submit(kind, text, wav, len, &opts, portMAX_DELAY)) {
+        xSemaphoreTake(w.done, portMAX_DELAY);
+      } else {
+        loge(TAG, "Out of memory for the request");
+      }
+      if (w.done) vSemaphoreDelete(w.done);
+      return w.res;
+    }
+    gemini_job job = {};
+    job.kind = kind;
+    job.text = (char *)text;
+    job.wav = wav;
+    job.len = len;
+    job.opts.stream = h;
+    run_job(&job);
+    return job.res;
+  }
+
+  esp_err_t gemini_client_test_key(const char *key) {
+    return run_blocking(JOB_KEY_TEST, key, NULL, 0, NULL).err;
+  }
+
+  char *gemini_client_request(const char *input) {
+    return run_blocking(JOB_TEXT, input, NULL, 0, NULL).answer;
+  }
+
+  char *gemini_client_request_audio(const uint8_t *wav, size_t len, char **transcript) {
+    gemini_result_t res = run_blocking(JOB_AUDIO, NULL, wav, len, NULL);
+    if (transcript) *transcript = res.transcript;
+    else free(res.transcript);
+    return res.answer;
+  }
+
+  char *gemini_client_stream(const char *input, const gemini_client_stream_handler_t *h) {
+    // A handler is needed to pick the streamed call; one with no callbacks will do
+    static const gemini_client_stream_handler_t none = {};
+    return run_blocking(JOB_TEXT, input, NULL, 0, h ? h : &none).answer;
+  }
+
+  char *gemini_client_stream_audio(const uint8_t *wav, size_t len, char **transcript,
+                                   const gemini_client_stream_handler_t *h) {
+    static const gemini_client_stream_handler_t none = {};
+    gemini_result_t res = run_blocking(JOB_AUDIO, NULL, wav, len, h ? h : &none);
+    if (transcript) *transcript = res.transcript;
+    else free(res.transcript);
+    return res.answer;
+  }
+
+  gemini_request_t gemini_client_submit(const char *input, const gemini_async_t *opts) {
+    return submit(JOB_TEXT, input, NULL, 0, opts, 0);
+  }
+
+  gemini_request_t gemini_client_submit_audio(const uint8_t *wav, size_t len, const gemini_async_t *opts) {
+    return submit(JOB_AUDIO, NULL, wav, len, opts, 0);
+  }
+
+  gemini_request_t gemini_client_submit_key_test(const char *key, const gemini_async_t *opts) {
+    return submit(JOB_KEY_TEST, key, NULL, 0, opts, 0);
+  }
+
+  bool gemini_client_cancel(gemini_request_t id) {
+    if (!s_jobs_lock || id == 0) return false;
+    bool found = false;
+    xSemaphoreTake(s_jobs_lock, portMAX_DELAY);
+    for (gemini_job *job = s_jobs; job; job = job->next) {
+      if (job->id == id && !job->finished) {
+        job->cancel = true;
+        found = true;
+      }
+    }
+    xSemaphoreGive(s_jobs_lock);
+    return found;
+  }
+
+  void gemini_client_cancel_all(void) {
+    if (!s_jobs_lock) return;
+    int n = 0;
+    xSemaphoreTake(s_jobs_lock, portMAX_DELAY);
+    for (gemini_job *job = s_jobs; job; job = job->next) {
+      if (!job->finished && !job->cancel) {
+        job->cancel = true;
+        n++;
+      }
+    }
+    xSemaphoreGive(s_jobs_lock);
+    if (n > 0) {
+      logi(TAG, "Cancelling %d request(s)", n);
+    }
+  }
+
+  bool gemini_client_take_result(gemini_request_t id, gemini_result_t *res) {
+    if (!s_jobs_lock || id == 0) return false;
+    gemini_job *found = NULL;
+    xSemaphoreTake(s_jobs_lock, portMAX_DELAY);
+    for (gemini_job *job = s_jobs; job; job = job->next) {
+      if (job->id == id && job->finished) {
+        found = job;
+        unlink_job(job);
+        break;
+      }
+    }
+    xSemaphoreGive(s_jobs_lock);
+    if (!found) return false;
+    *res = found->res;
+    free(found);
+    return true;
+  }
+
+  bool gemini_client_wait_idle(uint32_t timeout_ms) {
+    uint32_t start = millis();
+    while (s_busy > 0) {
+      if (millis() - start >= timeout_ms) return false;
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return true;
+  }
+
+  // Hand a history change to the network task: at once if it is idle,
+  // else once the request it is running has been sent and answered
+  static void post_history_change(void) {
+    if (!s_worker) {
+      apply_history_changes();
+      return;
+    }
+    gemini_job *wake = NULL;
+    xQueueSend(s_queue, &wake, 0);  // Queue full: applied before the next job anyway
+  }
+
+  void gemini_client_clear_history(void) {
+    lock_state();
+    s_history_clear = true;
+    unlock_state();
+    post_history_change();
+  }
+
+  void gemini_client_set_history_budget(uint32_t max_bytes, uint32_t max_tokens) {
+    lock_state();
+    if (max_bytes) s_history_max_bytes = max_bytes;
+    if (max_tokens) s_history_max_tokens = max_tokens;
+    unlock_state();
+    post_history_change();
+  }
+
+  void gemini_client_get_history_stats(conversation_stats_t *stats) {
+    lock_state();
+    *stats = s_history_stats;
+    unlock_state();
+  }
+
+  void gemini_client_set_cache_enabled(bool enabled) {
+    s_cache_enabled = enabled;
+    logi(TAG, "Response cache %s", enabled ? "on" : "off");
+  }
+
+  bool gemini_client_is_cache_enabled(void) {
+    return s_cache_enabled;
+  }
+
+  void gemini_client_set_cache_similarity(float similarity) {
+    if (!s_cache) return;
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    response_cache_set_similarity(s_cache, similarity);
+    xSemaphoreGive(s_cache_lock);
+    logi(TAG, "Near matches %s", similarity > 0 ? "answered from the cache" : "off");
+  }
+
+  void gemini_client_flush_cache(void) {
+    if (!s_cache) return;
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    response_cache_stats_t st;
+    response_cache_get_stats(s_cache, &st);
+    if (st.pending > 0 && !response_cache_flush(s_cache, wifi_manager_unix_time())) {
+      logw(TAG, "Writing %u cached answers to flash failed", (unsigned)st.pending);
+    }
+    xSemaphoreGive(s_cache_lock);
+  }
+
+  void gemini_client_clear_cache(void) {
+    if (!s_cache) return;
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    response_cache_clear(s_cache);
+    xSemaphoreGive(s_cache_lock);
+    logi(TAG, "Response cache cleared");
+  }
+
+  void gemini_client_get_cache_stats(response_cache_stats_t *stats) {
+    if (s_cache_lock) xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+    response_cache_get_stats(s_cache, stats);
+    if (s_cache_lock) xSemaphoreGive(s_cache_lock);
+  }
+
+  void gemini_client_set_streaming(bool enabled) {
+    s_streaming = enabled;
+    logi(TAG, "Answers are %s", enabled ? "streamed" : "read whole");
+  }
+
+  bool gemini_client_is_streaming(void) {
+    return s_streaming;
+  }
+
+  void gemini_client_get_stream_result(gemini_stream_result_t *res) {
+    lock_state();
+    *res = s_stream_result;
+    unlock_state();
+  }
+
+  void gemini_client_set_voice_mode(bool enabled) {
+    s_voice_mode = enabled;
+    logi(TAG, "Voice queries %s", enabled ? "go straight to Gemini" : "use speech-to-text first");
+  }
+
+  bool gemini_client_is_voice_mode(void) {
+    return s_voice_mode;
+  }
+
+  void gemini_client_set_base_url(const char *url) {
+    if (!url || url[0] == '\0') {
+      url = GEMINI_DEFAULT_BASE_URL;
+    }
+    char base[sizeof(s_base_url)];
+    strncpy(base, url, sizeof(base) - 1);
+    base[sizeof(base) - 1] = '\0';
+    size_t n = strlen(base);
+    if (n > 0 && base[n - 1] == '/') {
+      base[n - 1] = '\0';
     }
+    lock_state();
+    memcpy(s_base_url, base, sizeof(s_base_url));
+    s_conn_stale = true;
+    unlock_state();
+    logi(TAG, "Gemini endpoint: %s", base);
+  }
+
+  void gemini_client_get_conn_stats(tls_conn_stats_t *stats) {
+    lock_state();
+    *stats = s_conn_stats;
+    unlock_state();
   }
-} // extern "C"
\ No newline at end of file
+} // extern "C"
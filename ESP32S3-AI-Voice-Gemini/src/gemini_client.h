@@ -2,13 +2,221 @@
 #define GEMINI_CLIENT_H
 
 #include "esp_err.h"
+#include "tls_conn.h"
+#include "gemini_stream.h"
+#include "conversation.h"
+#include "response_cache.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #ifdef __cplusplus
 extern "C" {
 #endif
+/**
+ * Requests run on a network task of their own, one at a time in the order
+ * they were made; it is the only user of the kept-alive connection. The
+ * blocking calls below hand their request to it and wait. The
+ * gemini_client_submit*() calls return at once with a handle, and the
+ * result is delivered when the request is done (see gemini_async_t). A
+ * request can be cancelled while it waits its turn or while it is sent and
+ * read, see HTTP_SESSION_CANCEL_POLL_MS.
+ */
 void gemini_client_init(void);
 esp_err_t gemini_client_test_key(const char *key);
+
+/**
+ * @return The answer or an error message (caller frees); NULL if cancelled
+ */
 char* gemini_client_request(const char *input);
 
+/**
+ * @brief Ask Gemini about a spoken question in one round trip: the WAV is
+ *        sent as inline audio with the prompt, and the model returns what
+ *        was said along with its answer. No separate speech-to-text call.
+ *
+ * The audio is base64-encoded while it is sent, so no copy of the request
+ * is built in memory.
+ *
+ * @param transcript Set to what the speaker said (caller frees), or NULL
+ *        if the request failed or the reply had no transcript
+ * @return The answer, or an error message, as with gemini_client_request()
+ */
+char* gemini_client_request_audio(const uint8_t *wav, size_t len, char **transcript);
+
+/**
+ * Where a streamed answer goes while it arrives. Either callback may be NULL.
+ */
+typedef struct {
+    void (*on_transcript)(void *ctx, const char *text);    // Voice queries, before any text
+    gemini_text_fn on_text;         // Next piece of the answer, NUL-terminated
+    void *ctx;
+} gemini_client_stream_handler_t;
+
+/**
+ * @brief gemini_client_request() over streamGenerateContent: the answer is
+ *        passed to h->on_text piece by piece while the model writes it.
+ * @return The whole answer (caller frees), or NULL if the request failed
+ *         before any text came
+ */
+char* gemini_client_stream(const char *input, const gemini_client_stream_handler_t *h);
+
+/**
+ * @brief gemini_client_request_audio() streamed. The model writes what was
+ *        said on its first line; that goes to h->on_transcript, the rest to
+ *        h->on_text as with gemini_client_stream().
+ * @param transcript Set to what the speaker said (caller frees), or NULL
+ */
+char* gemini_client_stream_audio(const uint8_t *wav, size_t len, char **transcript,
+                                 const gemini_client_stream_handler_t *h);
+
+typedef uint32_t gemini_request_t;  // 0 is no request
+
+typedef struct {
+    gemini_request_t id;
+    bool cancelled;                 // Nothing below is set
+    char *answer;                   // As the blocking call returns it; the receiver frees
+    char *transcript;               // Voice queries; the receiver frees
+    esp_err_t err;                  // Key tests
+} gemini_result_t;
+
+/**
+ * Where the result of a submitted request goes. on_done, if set, is called
+ * on the network task and owns the strings in the result; otherwise the
+ * result is kept for gemini_client_take_result(). Either way the task
+ * notify, if set, is then notified with the request id as its value.
+ */
+typedef struct {
+    const gemini_client_stream_handler_t *stream;  // Stream the answer here, kept until done; NULL reads it whole
+    void (*on_done)(void *ctx, gemini_result_t *res);
+    void *ctx;
+    TaskHandle_t notify;
+} gemini_async_t;
+
+/**
+ * @brief gemini_client_request(), or gemini_client_stream() with
+ *        opts->stream, on the network task. Returns at once.
+ * @return The request handle, or 0 if the queue is full
+ */
+gemini_request_t gemini_client_submit(const char *input, const gemini_async_t *opts);
+
+/**
+ * @brief gemini_client_request_audio() or gemini_client_stream_audio(), as
+ *        gemini_client_submit(). wav is not copied: it must stay valid
+ *        until the result is delivered, cancelled or not.
+ */
+gemini_request_t gemini_client_submit_audio(const uint8_t *wav, size_t len, const gemini_async_t *opts);
+
+/**
+ * @brief gemini_client_test_key() on the network task; the result is in err.
+ */
+gemini_request_t gemini_client_submit_key_test(const char *key, const gemini_async_t *opts);
+
+/**
+ * @brief Give up on a request: dropped if it has not started, else its
+ *        connection is closed at the next write or wait for data. The
+ *        result is still delivered, with cancelled set, and no more of a
+ *        streamed answer reaches the handler.
+ * @return false if the request is already done or unknown
+ */
+bool gemini_client_cancel(gemini_request_t id);
+
+/**
+ * @brief Cancel every request not yet done, e.g. when the user starts a new
+ *        question.
+ */
+void gemini_client_cancel_all(void);
+
+/**
+ * @brief The result of a request submitted without on_done, once done.
+ * @return false if it is not done yet or unknown
+ */
+bool gemini_client_take_result(gemini_request_t id, gemini_result_t *res);
+
+/**
+ * @brief Wait until no request is waiting or running, and their results
+ *        have been delivered.
+ * @return false on timeout
+ */
+bool gemini_client_wait_idle(uint32_t timeout_ms);
+
+/**
+ * @brief Start a new conversation: earlier turns are no longer sent. Done
+ *        by the network task, after the request it is running, if any.
+ */
+void gemini_client_clear_history(void);
+
+/**
+ * @brief Limit the history sent with each request; 0 keeps a limit as is.
+ *        Applied like gemini_client_clear_history().
+ */
+void gemini_client_set_history_budget(uint32_t max_bytes, uint32_t max_tokens);
+
+/**
+ * @brief The history as of the last change the network task made to it.
+ */
+void gemini_client_get_history_stats(conversation_stats_t *stats);
+
+/**
+ * @brief Whether repeated questions are answered from the response cache
+ *        (the default). While off, answers are neither looked up nor kept.
+ */
+void gemini_client_set_cache_enabled(bool enabled);
+bool gemini_client_is_cache_enabled(void);
+
+/**
+ * @brief How close an earlier question must be for its cached answer to be
+ *        used (estimated Jaccard of character 3-grams); 0 for exact matches
+ *        only. RESPONSE_CACHE_DEFAULT_SIMILARITY to start with.
+ */
+void gemini_client_set_cache_similarity(float similarity);
+
+/**
+ * @brief Write answers cached since the last call to flash. Flash writes
+ *        stall code running from flash, so call it while nothing plays.
+ */
+void gemini_client_flush_cache(void);
+
+/**
+ * @brief Forget every cached answer, in memory and in flash.
+ */
+void gemini_client_clear_cache(void);
+
+void gemini_client_get_cache_stats(response_cache_stats_t *stats);
+
+/**
+ * @brief Whether answers are streamed (the default) or read whole.
+ */
+void gemini_client_set_streaming(bool enabled);
+bool gemini_client_is_streaming(void);
+
+/**
+ * @brief Timing of the last streamed request, once it has ended; all zero
+ *        before the first. Safe from any task.
+ */
+void gemini_client_get_stream_result(gemini_stream_result_t *res);
+
+/**
+ * @brief Whether recordings go straight to gemini_client_request_audio()
+ *        (the default) or through speech_to_text_process() first.
+ */
+void gemini_client_set_voice_mode(bool enabled);
+bool gemini_client_is_voice_mode(void);
+
+/**
+ * @brief Scheme, host and port requests go to, e.g. "http://192.168.1.10:8080"
+ *        for a local mock server. NULL or "" restores Google's endpoint.
+ */
+void gemini_client_set_base_url(const char *url);
+
+/**
+ * @brief How requests used the kept-alive connection: reused, resumed or
+ *        full handshakes, as of the end of the last request. All zero
+ *        before the first request. Safe from any task.
+ */
+void gemini_client_get_conn_stats(tls_conn_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,363 @@
+// src/gemini_reply.cpp - Pulls the answer out of a generateContent reply as it streams in
+
+#include "gemini_reply.h"
+#include <string.h>
+
+enum {
+    ST_VALUE = 0,
+    ST_VALUE_OR_END,    // After '['
+    ST_KEY_OR_END,      // After '{'
+    ST_KEY,             // After ',' in an object
+    ST_COLON,
+    ST_NEXT,            // After a value: ',' or the end of the container
+    ST_STRING,
+    ST_ESCAPE,
+    ST_HEX,
+    ST_LITERAL,         // Number, true, false, null
+    ST_DONE,
+    ST_FAILED,
+};
+
+enum {
+    K_OTHER = 0,
+    K_CANDIDATES,
+    K_CONTENT,
+    K_PARTS,
+    K_TEXT,
+    K_ERROR,
+    K_MESSAGE,
+};
+
+enum {
+    T_NONE = 0,
+    T_TEXT,
+    T_ERROR,
+};
+
+static const char *const KEY_NAMES[] = {
+    "", "candidates", "content", "parts", "text", "error", "message",
+};
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_array(const gemini_reply_t *r, int level) {
+    return (r->arrays >> level) & 1;
+}
+
+static void fail(gemini_reply_t *r) {
+    r->state = ST_FAILED;
+    r->failed = true;
+}
+
+// Whether container `level` is an object whose current key is `key`
+static bool key_is(const gemini_reply_t *r, int level, uint8_t key) {
+    return !is_array(r, level) && r->keys[level] == key;
+}
+
+// Where a string value at the current position belongs
+static uint8_t value_target(const gemini_reply_t *r) {
+    if (r->depth == 6 && key_is(r, 0, K_CANDIDATES) && is_array(r, 1) && r->index[1] == 0 &&
+        key_is(r, 2, K_CONTENT) && key_is(r, 3, K_PARTS) && is_array(r, 4) && key_is(r, 5, K_TEXT)) {
+        return T_TEXT;
+    }
+    if (r->depth == 2 && key_is(r, 0, K_ERROR) && key_is(r, 1, K_MESSAGE)) {
+        return T_ERROR;
+    }
+    return T_NONE;
+}
+
+// One decoded byte of a string we keep. '\r' and NUL are dropped.
+static void put(gemini_reply_t *r, char c) {
+    if (c == '\r' || c == '\0') return;
+    if (r->target == T_TEXT) {
+        if (r->len + 1 < r->cap) {
+            r->text[r->len++] = c;
+        } else {
+            r->truncated = true;
+        }
+    } else if (r->target == T_ERROR) {
+        if (r->error_len + 1 < sizeof(r->error)) r->error[r->error_len++] = c;
+    }
+}
+
+static void put_code_point(gemini_reply_t *r, uint32_t cp) {
+    if (cp < 0x80) {
+        put(r, (char)cp);
+    } else if (cp < 0x800) {
+        put(r, (char)(0xC0 | (cp >> 6)));
+        put(r, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        put(r, (char)(0xE0 | (cp >> 12)));
+        put(r, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        put(r, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        put(r, (char)(0xF0 | (cp >> 18)));
+        put(r, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        put(r, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        put(r, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+// A high surrogate not followed by its low half
+static void flush_surrogate(gemini_reply_t *r) {
+    if (r->high_surrogate) {
+        r->high_surrogate = 0;
+        put_code_point(r, 0xFFFD);
+    }
+}
+
+static void code_unit(gemini_reply_t *r, uint16_t u) {
+    if (u >= 0xDC00 && u < 0xE000 && r->high_surrogate) {
+        put_code_point(r, 0x10000 + ((uint32_t)(r->high_surrogate - 0xD800) << 10) + (u - 0xDC00));
+        r->high_surrogate = 0;
+        return;
+    }
+    flush_surrogate(r);
+    if (u >= 0xD800 && u < 0xDC00) {
+        r->high_surrogate = u;
+    } else if (u >= 0xDC00 && u < 0xE000) {
+        put_code_point(r, 0xFFFD);
+    } else {
+        put_code_point(r, u);
+    }
+}
+
+static void value_done(gemini_reply_t *r) {
+    if (r->depth == 0) {
+        r->state = ST_DONE;
+        r->complete = true;
+    } else {
+        r->state = ST_NEXT;
+    }
+}
+
+static void open_container(gemini_reply_t *r, bool array) {
+    if (r->depth >= GEMINI_REPLY_DEPTH) {
+        fail(r);
+        return;
+    }
+    if (array) {
+        r->arrays |= 1u << r->depth;
+    } else {
+        r->arrays &= ~(1u << r->depth);
+    }
+    if (r->depth < GEMINI_REPLY_PATH) {
+        r->keys[r->depth] = K_OTHER;
+        r->index[r->depth] = 0;
+    }
+    r->depth++;
+    r->state = array ? ST_VALUE_OR_END : ST_KEY_OR_END;
+}
+
+static void close_container(gemini_reply_t *r, char c) {
+    if (r->depth == 0 || is_array(r, r->depth - 1) != (c == ']')) {
+        fail(r);
+        return;
+    }
+    r->depth--;
+    value_done(r);
+}
+
+static void begin_string(gemini_reply_t *r, bool key) {
+    r->in_key = key;
+    r->key_len = 0;
+    r->target = key ? (uint8_t)T_NONE : value_target(r);
+    r->high_surrogate = 0;
+    r->state = ST_STRING;
+}
+
+static void end_string(gemini_reply_t *r) {
+    flush_surrogate(r);
+    if (r->in_key) {
+        int level = r->depth - 1;
+        if (level < GEMINI_REPLY_PATH) {
+            uint8_t k = K_OTHER;
+            for (uint8_t i = 1; i < sizeof(KEY_NAMES) / sizeof(KEY_NAMES[0]); i++) {
+                if (r->key_len == strlen(KEY_NAMES[i]) && memcmp(r->key, KEY_NAMES[i], r->key_len) == 0) {
+                    k = i;
+                    break;
+                }
+            }
+            r->keys[level] = k;
+        }
+        r->in_key = false;
+        r->state = ST_COLON;
+        return;
+    }
+    if (r->target == T_TEXT) r->parts++;
+    r->target = T_NONE;
+    value_done(r);
+}
+
+// A value starts with c
+static void begin_value(gemini_reply_t *r, char c) {
+    if (c == '{') {
+        open_container(r, false);
+    } else if (c == '[') {
+        open_container(r, true);
+    } else if (c == '"') {
+        begin_string(r, false);
+    } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+        r->state = ST_LITERAL;
+    } else {
+        fail(r);
+    }
+}
+
+static bool is_literal(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' ||
+           c == 'E';
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Drop a UTF-8 sequence cut off at the end of buf[0..len)
+static size_t whole_utf8(const char *buf, size_t len) {
+    size_t start = len;
+    size_t back = 0;
+    while (start > 0 && back < 4 && ((uint8_t)buf[start - 1] & 0xC0) == 0x80) {
+        start--;
+        back++;
+    }
+    if (start == 0) return len;
+    uint8_t lead = (uint8_t)buf[start - 1];
+    size_t need = lead < 0x80 ? 1 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    return back + 1 < need ? start - 1 : len;
+}
+
+extern "C" {
+
+void gemini_reply_init(gemini_reply_t *r, char *text, size_t cap) {
+    memset(r, 0, sizeof(*r));
+    r->text = text;
+    r->cap = cap;
+    r->state = ST_VALUE;
+}
+
+bool gemini_reply_feed(gemini_reply_t *r, const char *data, size_t len) {
+    r->bytes += len;
+    for (size_t i = 0; i < len && r->state != ST_FAILED; i++) {
+        char c = data[i];
+        switch (r->state) {
+        case ST_STRING:
+            if (c == '"') {
+                end_string(r);
+            } else if (c == '\\') {
+                r->state = ST_ESCAPE;
+            } else if (r->in_key) {
+                if (r->key_len < GEMINI_REPLY_KEY_MAX) r->key[r->key_len] = c;
+                if (r->key_len < 0xFF) r->key_len++;
+            } else if (r->target) {
+                flush_surrogate(r);
+                put(r, c);
+            }
+            break;
+        case ST_ESCAPE:
+            r->state = ST_STRING;
+            if (c == 'u') {
+                r->hex = 0;
+                r->hex_len = 0;
+                r->state = ST_HEX;
+            } else if (r->in_key) {
+                r->key_len = 0xFF;      // None of the keys followed has escapes
+            } else if (r->target) {
+                flush_surrogate(r);
+                put(r, c == 'n' ? '\n' : c == 't' ? '\t' : c == 'b' ? '\b' : c == 'f' ? '\f' :
+                       c == 'r' ? '\r' : c);
+            }
+            break;
+        case ST_HEX: {
+            int d = hex_digit(c);
+            if (d < 0) {
+                fail(r);
+                break;
+            }
+            r->hex = (uint16_t)((r->hex << 4) | d);
+            if (++r->hex_len == 4) {
+                r->state = ST_STRING;
+                if (r->in_key) {
+                    r->key_len = 0xFF;
+                } else if (r->target) {
+                    code_unit(r, r->hex);
+                }
+            }
+            break;
+        }
+        case ST_LITERAL:
+            if (is_literal(c)) break;
+            value_done(r);
+            i--;                        // c belongs to what follows
+            break;
+        case ST_VALUE:
+            if (!is_space(c)) begin_value(r, c);
+            break;
+        case ST_VALUE_OR_END:
+            if (is_space(c)) break;
+            if (c == ']') {
+                close_container(r, c);
+            } else {
+                begin_value(r, c);
+            }
+            break;
+        case ST_KEY_OR_END:
+        case ST_KEY:
+            if (is_space(c)) break;
+            if (c == '"') {
+                begin_string(r, true);
+            } else if (c == '}' && r->state == ST_KEY_OR_END) {
+                close_container(r, c);
+            } else {
+                fail(r);
+            }
+            break;
+        case ST_COLON:
+            if (is_space(c)) break;
+            if (c == ':') {
+                r->state = ST_VALUE;
+            } else {
+                fail(r);
+            }
+            break;
+        case ST_NEXT:
+            if (is_space(c)) break;
+            if (c == ',') {
+                int level = r->depth - 1;
+                if (is_array(r, level)) {
+                    if (level < GEMINI_REPLY_PATH && r->index[level] < 0xFFFF) r->index[level]++;
+                    r->state = ST_VALUE;
+                } else {
+                    r->state = ST_KEY;
+                }
+            } else if (c == ']' || c == '}') {
+                close_container(r, c);
+            } else {
+                fail(r);
+            }
+            break;
+        default:                        // ST_DONE: trailing white space
+            break;
+        }
+    }
+    return !r->failed;
+}
+
+bool gemini_reply_finish(gemini_reply_t *r) {
+    // A number at the very end of the body
+    if (r->state == ST_LITERAL) value_done(r);
+    if (r->cap > 0) {
+        if (r->truncated) r->len = whole_utf8(r->text, r->len);
+        r->text[r->len] = '\0';
+    }
+    r->error_len = whole_utf8(r->error, r->error_len);
+    r->error[r->error_len] = '\0';
+    return r->complete;
+}
+
+} // extern "C"
@@ -0,0 +1,85 @@
+#ifndef GEMINI_REPLY_H
+#define GEMINI_REPLY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Incremental extractor for generateContent replies.
+ *
+ * The reply is fed as it comes off the connection, in pieces of any size.
+ * Only candidates[0].content.parts[*].text is kept, decoded and cleaned
+ * into a buffer the caller provides, along with error.message; the rest
+ * of the body (safety ratings, citations, usage metadata) is read past
+ * without being stored. Memory is the output buffer and this struct,
+ * whatever the size of the reply.
+ *
+ * Since decoded text is never longer than its JSON form, the output buffer
+ * may be the input itself, for a body that is already in memory.
+ *
+ * Not a validator: enough structure is checked to follow the path.
+ * No platform dependency.
+ */
+
+#define GEMINI_REPLY_ERROR_MAX  128
+#define GEMINI_REPLY_DEPTH      32      // Deeper documents are rejected
+#define GEMINI_REPLY_PATH       8       // Levels whose keys are followed
+#define GEMINI_REPLY_KEY_MAX    16
+
+typedef struct {
+    // Result
+    char *text;                     // parts[*].text joined, '\r' and NUL removed
+    size_t cap;
+    size_t len;
+    uint32_t parts;                 // Text parts found
+    size_t bytes;                   // Fed so far
+    bool truncated;                 // The text did not fit in cap
+    bool complete;                  // The document was read to its end
+    bool failed;                    // Not JSON; nothing more is read
+    char error[GEMINI_REPLY_ERROR_MAX];     // error.message, "" if none
+
+    // Parser state
+    uint8_t state;
+    uint8_t depth;
+    uint8_t target;                 // Where the current string goes
+    uint8_t key_len;
+    uint8_t hex_len;
+    bool in_key;
+    uint16_t hex;
+    uint16_t high_surrogate;        // First half of a \u pair, 0 if none
+    size_t error_len;
+    uint32_t arrays;                // Bit per level: set for arrays
+    uint8_t keys[GEMINI_REPLY_PATH];
+    uint16_t index[GEMINI_REPLY_PATH];
+    char key[GEMINI_REPLY_KEY_MAX];
+} gemini_reply_t;
+
+/**
+ * @brief Start a reply.
+ * @param text Output buffer; the text is NUL-terminated, so at most cap - 1
+ *        bytes of it are kept
+ */
+void gemini_reply_init(gemini_reply_t *r, char *text, size_t cap);
+
+/**
+ * @brief Read the next piece of the body.
+ * @return false once the body turned out not to be JSON
+ */
+bool gemini_reply_feed(gemini_reply_t *r, const char *data, size_t len);
+
+/**
+ * @brief End of the body: NUL-terminate the text and the error message,
+ *        dropping a UTF-8 sequence cut off by truncation.
+ * @return Whether the document was complete
+ */
+bool gemini_reply_finish(gemini_reply_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // GEMINI_REPLY_H
@@ -0,0 +1,115 @@
+// src/gemini_stream.cpp - streamGenerateContent over SSE with timing
+
+#include "gemini_stream.h"
+#include "sse_parser.h"
+#include "gemini_reply.h"
+#include "psram_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <chrono>
+#endif
+
+#define STREAM_READ_CHUNK   512
+
+static uint32_t now_ms(void) {
+#ifdef ESP_PLATFORM
+    return (uint32_t)(esp_timer_get_time() / 1000);
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct stream_ctx {
+    gemini_text_fn on_text;
+    void *ctx;
+    gemini_stream_result_t *res;
+    uint32_t start_ms;
+};
+
+static void take_error(gemini_stream_result_t *res, const gemini_reply_t *reply) {
+    if (reply->error[0]) {
+        strncpy(res->error, reply->error, sizeof(res->error) - 1);
+        res->error[sizeof(res->error) - 1] = '\0';
+    }
+}
+
+static void on_event(void *ctx, const char *event, char *data, size_t len) {
+    stream_ctx *sc = (stream_ctx *)ctx;
+    (void)event;
+    sc->res->events++;
+
+    // Each event is a whole GenerateContentResponse. Its text is decoded
+    // over the event itself; the stream can also end with an error object.
+    gemini_reply_t reply;
+    gemini_reply_init(&reply, data, len + 1);
+    gemini_reply_feed(&reply, data, len);
+    gemini_reply_finish(&reply);
+    take_error(sc->res, &reply);
+    if (reply.len == 0) return;
+
+    if (sc->res->first_text_ms == 0) {
+        uint32_t ms = now_ms() - sc->start_ms;
+        sc->res->first_text_ms = ms > 0 ? ms : 1;
+    }
+    sc->res->text_bytes += reply.len;
+    if (sc->on_text) sc->on_text(sc->ctx, reply.text, reply.len);
+}
+
+extern "C" {
+
+int gemini_stream_run(tls_conn_t *conn, const http_request_t *req,
+                      gemini_text_fn on_text, void *ctx, gemini_stream_result_t *res) {
+    memset(res, 0, sizeof(*res));
+    stream_ctx sc = { on_text, ctx, res, now_ms() };
+
+    http_session_t *s = (http_session_t *)malloc(sizeof(http_session_t));
+    char *event_buf = (char *)psram_malloc(GEMINI_STREAM_EVENT_MAX);
+    if (!s || !event_buf) {
+        free(s);
+        free(event_buf);
+        res->status = HTTP_SESSION_ERR_SEND;
+        return res->status;
+    }
+
+    res->status = http_session_begin(s, conn, req);
+    res->reused = s->reused;
+    res->headers_ms = now_ms() - sc.start_ms;
+
+    if (res->status == 200) {
+        sse_parser_t parser;
+        sse_parser_init(&parser, event_buf, GEMINI_STREAM_EVENT_MAX, on_event, &sc);
+        char chunk[STREAM_READ_CHUNK];
+        int n;
+        while ((n = http_session_read(s, chunk, sizeof(chunk))) > 0) {
+            sse_parser_feed(&parser, chunk, (size_t)n);
+        }
+        // A final event without its blank line still counts
+        sse_parser_feed(&parser, "\n\n", 2);
+        res->dropped_events = parser.dropped;
+        if (n < 0) res->status = n;
+    } else if (res->status > 0) {
+        // Only error.message of the reply is wanted
+        gemini_reply_t reply;
+        gemini_reply_init(&reply, NULL, 0);
+        char chunk[STREAM_READ_CHUNK];
+        int n;
+        while ((n = http_session_read(s, chunk, sizeof(chunk))) > 0) {
+            gemini_reply_feed(&reply, chunk, (size_t)n);
+        }
+        gemini_reply_finish(&reply);
+        take_error(res, &reply);
+    }
+    http_session_end(s);
+    res->total_ms = now_ms() - sc.start_ms;
+
+    free(s);
+    free(event_buf);
+    return res->status;
+}
+
+} // extern "C"
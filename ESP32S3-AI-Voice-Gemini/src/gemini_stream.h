@@ -0,0 +1,55 @@
+#ifndef GEMINI_STREAM_H
+#define GEMINI_STREAM_H
+
+#include "http_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * streamGenerateContent?alt=sse: the answer as it is generated.
+ *
+ * Each server-sent event is a GenerateContentResponse holding the next
+ * piece of the answer. The events are parsed as they arrive and the text of
+ * their parts is passed on at once, so the chat can show the answer and
+ * text-to-speech can start on its first sentence while the model is still
+ * writing the rest. The run is timed, most importantly the time to the
+ * first text (time to first token).
+ *
+ * No platform dependency: the host benchmark runs it against a local mock.
+ */
+
+#define GEMINI_STREAM_EVENT_MAX     4096    // Largest event kept; one chunk of the answer
+#define GEMINI_STREAM_ERROR_MAX     128
+
+/**
+ * A piece of the answer, NUL-terminated UTF-8. Pieces end anywhere,
+ * sometimes inside a word.
+ */
+typedef void (*gemini_text_fn)(void *ctx, const char *text, size_t len);
+
+typedef struct {
+    int status;                     // HTTP status, or HTTP_SESSION_ERR_*
+    bool reused;                    // Sent on the kept-alive connection
+    uint32_t headers_ms;            // From the start to the response headers
+    uint32_t first_text_ms;         // ... to the first piece of text, 0 if none came
+    uint32_t total_ms;              // ... to the end of the stream
+    uint32_t events;
+    uint32_t dropped_events;        // Longer than GEMINI_STREAM_EVENT_MAX
+    uint32_t text_bytes;
+    char error[GEMINI_STREAM_ERROR_MAX];    // error.message from the API, if any
+} gemini_stream_result_t;
+
+/**
+ * @brief Send req (a streamGenerateContent?alt=sse request) on conn and
+ *        pass the text of the answer to on_text until the stream ends.
+ * @return res->status: 200 when the stream was read to the end
+ */
+int gemini_stream_run(tls_conn_t *conn, const http_request_t *req,
+                      gemini_text_fn on_text, void *ctx, gemini_stream_result_t *res);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // GEMINI_STREAM_H
@@ -0,0 +1,404 @@
+// src/http_session.cpp - HTTP/1.1 keep-alive requests over a managed connection
+
+#include "http_session.h"
+#include "psram_alloc.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HTTP_LINE_MAX       256     // Longer header lines are cut; only short ones matter here
+#define HTTP_DRAIN_MAX      4096    // Unread body end() will still read to keep the connection
+#define HTTP_CHUNK_PREFIX   6       // "XXXX\r\n": fixed width, so data can be produced in place
+
+static bool cancelled(http_session_t *s) {
+    if (s->cancel && *s->cancel) s->cancelled = true;
+    return s->cancelled;
+}
+
+// tls_transport_read() waiting up to timeout_ms; with a cancel flag, in
+// short waits with a look at the flag between them. 0 on timeout or cancel.
+static int transport_read(http_session_t *s, void *buf, size_t len) {
+    if (!s->cancel) return tls_transport_read(s->transport, buf, len, s->timeout_ms);
+    uint32_t left = s->timeout_ms;
+    for (;;) {
+        if (cancelled(s)) return 0;
+        uint32_t wait = left < HTTP_SESSION_CANCEL_POLL_MS ? left : HTTP_SESSION_CANCEL_POLL_MS;
+        int n = tls_transport_read(s->transport, buf, len, wait);
+        if (n != 0 || wait == left) return n;
+        left -= wait;
+    }
+}
+
+static bool transport_write(http_session_t *s, const void *data, size_t len) {
+    return !cancelled(s) && tls_transport_write(s->transport, data, len, s->timeout_ms);
+}
+
+// Make sure there is buffered input: 1 if there is, 0 on timeout, -1 closed
+static int fill(http_session_t *s) {
+    if (s->buf_pos < s->buf_len) return 1;
+    int n = transport_read(s, s->buf, sizeof(s->buf));
+    if (n <= 0) return n < 0 ? -1 : 0;
+    s->buf_pos = 0;
+    s->buf_len = (size_t)n;
+    return 1;
+}
+
+static int fill_error(const http_session_t *s, int r) {
+    if (r == 0) return s->cancelled ? HTTP_SESSION_ERR_CANCELLED : HTTP_SESSION_ERR_TIMEOUT;
+    return HTTP_SESSION_ERR_RESPONSE;
+}
+
+// One line without its CRLF, cut to fit line. Returns its length or an error.
+static int read_line(http_session_t *s, char *line, size_t cap) {
+    size_t n = 0;
+    for (;;) {
+        int r = fill(s);
+        if (r <= 0) return fill_error(s, r);
+        char c = s->buf[s->buf_pos++];
+        if (c == '\n') break;
+        if (n + 1 < cap) line[n++] = c;
+    }
+    if (n > 0 && line[n - 1] == '\r') n--;
+    line[n] = '\0';
+    return (int)n;
+}
+
+static bool header_is(const char *line, const char *name, const char **value) {
+    size_t n = strlen(name);
+    if (strncasecmp(line, name, n) != 0 || line[n] != ':') return false;
+    const char *v = line + n + 1;
+    while (*v == ' ' || *v == '\t') v++;
+    *value = v;
+    return true;
+}
+
+static bool contains_token(const char *value, const char *token) {
+    size_t n = strlen(token);
+    for (const char *p = value; *p; p++) {
+        if (strncasecmp(p, token, n) == 0) return true;
+    }
+    return false;
+}
+
+static bool send_request(http_session_t *s, const http_request_t *req) {
+    const char *host = tls_conn_host(s->conn);
+    uint16_t port = tls_conn_port(s->conn);
+    bool has_body = strcmp(req->method, "GET") != 0 && strcmp(req->method, "HEAD") != 0;
+    bool chunked = has_body && req->body_len == HTTP_SESSION_CHUNKED_BODY;
+
+    char out[HTTP_SESSION_SEND_CHUNK];
+    char port_str[8] = "";
+    if (port != 443 && port != 80) {
+        snprintf(port_str, sizeof(port_str), ":%u", (unsigned)port);
+    }
+    int head = snprintf(out, sizeof(out), "%s %s HTTP/1.1\r\nHost: %s%s\r\nConnection: keep-alive\r\n",
+                        req->method, req->path, host, port_str);
+    if (head > 0 && req->accept && (size_t)head < sizeof(out)) {
+        head += snprintf(out + head, sizeof(out) - head, "Accept: %s\r\n", req->accept);
+    }
+    if (head > 0 && has_body && (size_t)head < sizeof(out)) {
+        head += snprintf(out + head, sizeof(out) - head, "Content-Type: %s\r\n",
+                         req->content_type ? req->content_type : "application/octet-stream");
+    }
+    if (head > 0 && has_body && (size_t)head < sizeof(out)) {
+        if (chunked) {
+            head += snprintf(out + head, sizeof(out) - head, "Transfer-Encoding: chunked\r\n");
+        } else {
+            head += snprintf(out + head, sizeof(out) - head, "Content-Length: %u\r\n",
+                             (unsigned)req->body_len);
+        }
+    }
+    if (head > 0 && (size_t)head < sizeof(out)) {
+        head += snprintf(out + head, sizeof(out) - head, "\r\n");
+    }
+    if (head <= 0 || (size_t)head >= sizeof(out)) {
+        return false;
+    }
+
+    // A chunked body: the head goes out on its own so the server has the
+    // request while the first chunk is still being produced, then one
+    // chunk per body_fn call. The size line has a fixed width (leading
+    // zeros are allowed) so the data can be produced straight into out.
+    if (chunked) {
+        if (!transport_write(s, out, (size_t)head)) return false;
+        char *data = out + HTTP_CHUNK_PREFIX;
+        const size_t cap = sizeof(out) - HTTP_CHUNK_PREFIX - 2;
+        size_t offset = 0;
+        for (;;) {
+            s->body_started = true;
+            size_t n = req->body_fn(req->body_ctx, offset, data, cap);
+            if (n == 0) break;
+            char size_line[HTTP_CHUNK_PREFIX + 1];
+            snprintf(size_line, sizeof(size_line), "%04X\r\n", (unsigned)n);
+            memcpy(out, size_line, HTTP_CHUNK_PREFIX);
+            memcpy(data + n, "\r\n", 2);
+            if (!transport_write(s, out, HTTP_CHUNK_PREFIX + n + 2)) return false;
+            offset += n;
+        }
+        return transport_write(s, "0\r\n\r\n", 5);
+    }
+
+    size_t body_len = has_body ? req->body_len : 0;
+    size_t used = (size_t)head;
+
+    // A body in memory goes out as it is, after the head unless both fit
+    // in one write
+    if (req->body || body_len == 0) {
+        if (body_len > 0 && used + body_len <= sizeof(out)) {
+            memcpy(out + used, req->body, body_len);
+            used += body_len;
+            body_len = 0;
+        }
+        if (!transport_write(s, out, used)) return false;
+        return body_len == 0 || transport_write(s, req->body, body_len);
+    }
+
+    // A produced body fills the rest of each write
+    size_t offset = 0;
+    while (used > 0 || offset < body_len) {
+        while (used < sizeof(out) && offset < body_len) {
+            size_t cap = sizeof(out) - used;
+            if (cap > body_len - offset) cap = body_len - offset;
+            size_t n = req->body_fn(req->body_ctx, offset, out + used, cap);
+            if (n == 0) return false;
+            used += n;
+            offset += n;
+        }
+        if (!transport_write(s, out, used)) return false;
+        used = 0;
+    }
+    return true;
+}
+
+// Status line and headers, skipping any 1xx interim responses
+static int read_head(http_session_t *s, const char *method) {
+    char line[HTTP_LINE_MAX];
+    for (;;) {
+        int n = read_line(s, line, sizeof(line));
+        if (n < 0) return n;
+        int major = 0, minor = 0, status = 0;
+        if (sscanf(line, "HTTP/%d.%d %d", &major, &minor, &status) != 3 || status < 100) {
+            return HTTP_SESSION_ERR_RESPONSE;
+        }
+
+        bool keep_alive = major > 1 || (major == 1 && minor >= 1);
+        bool chunked = false;
+        bool has_length = false;
+        size_t length = 0;
+        for (;;) {
+            n = read_line(s, line, sizeof(line));
+            if (n < 0) return n;
+            if (n == 0) break;
+            const char *value;
+            if (header_is(line, "Content-Length", &value)) {
+                length = (size_t)strtoul(value, NULL, 10);
+                has_length = true;
+            } else if (header_is(line, "Transfer-Encoding", &value)) {
+                chunked = contains_token(value, "chunked");
+            } else if (header_is(line, "Connection", &value)) {
+                if (contains_token(value, "close")) keep_alive = false;
+                else if (contains_token(value, "keep-alive")) keep_alive = true;
+            }
+        }
+        if (status < 200) continue;
+
+        s->status = status;
+        s->keep_alive = keep_alive;
+        if (status == 204 || status == 304 || strcmp(method, "HEAD") == 0) {
+            s->done = true;
+        } else if (chunked) {
+            s->chunked = true;
+        } else if (has_length) {
+            s->remaining = length;
+            s->done = length == 0;
+        } else {
+            s->until_close = true;
+            s->keep_alive = false;
+        }
+        return status;
+    }
+}
+
+// Size line of the next chunk; the end of the body at the last one
+static int next_chunk(http_session_t *s) {
+    char line[HTTP_LINE_MAX];
+    int n;
+    // The CRLF that ends the previous chunk's data reads as an empty line
+    do {
+        n = read_line(s, line, sizeof(line));
+        if (n < 0) return n;
+    } while (n == 0);
+
+    char *end;
+    unsigned long size = strtoul(line, &end, 16);
+    if (end == line) return HTTP_SESSION_ERR_RESPONSE;
+    if (size > 0) {
+        s->remaining = size;
+        return 0;
+    }
+    // Last chunk, then trailers up to an empty line
+    do {
+        n = read_line(s, line, sizeof(line));
+        if (n < 0) return n;
+    } while (n > 0);
+    s->done = true;
+    return 0;
+}
+
+extern "C" {
+
+int http_session_begin(http_session_t *s, tls_conn_t *conn, const http_request_t *req) {
+    if (!s) return HTTP_SESSION_ERR_SEND;
+    memset(s, 0, sizeof(*s));
+    s->conn = conn;
+    if (!conn || !req || !req->method || !req->path ||
+        (!req->body && !req->body_fn && req->body_len > 0) ||
+        (req->body_len == HTTP_SESSION_CHUNKED_BODY && !req->body_fn)) {
+        s->failed = true;
+        return HTTP_SESSION_ERR_SEND;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (req->cancel && *req->cancel) {
+            s->failed = true;
+            return HTTP_SESSION_ERR_CANCELLED;
+        }
+        bool reused = false;
+        tls_transport_t *t = tls_conn_acquire(conn, &reused);
+        if (!t) {
+            s->failed = true;
+            return HTTP_SESSION_ERR_CONNECT;
+        }
+        memset(s, 0, sizeof(*s));
+        s->conn = conn;
+        s->transport = t;
+        s->reused = reused;
+        s->timeout_ms = req->timeout_ms;
+        s->cancel = req->cancel;
+
+        int r;
+        if (send_request(s, req)) {
+            r = read_head(s, req->method);
+        } else {
+            r = s->cancelled ? HTTP_SESSION_ERR_CANCELLED : HTTP_SESSION_ERR_SEND;
+        }
+        if (r > 0) return r;
+
+        // Nothing came back on a connection that had been idle: it was
+        // closed under us, so try once more on a new one
+        if (reused && attempt == 0 && s->buf_len == 0 && !s->body_started &&
+            r != HTTP_SESSION_ERR_TIMEOUT && r != HTTP_SESSION_ERR_CANCELLED) {
+            tls_conn_release_stale(conn);
+            s->transport = NULL;
+            continue;
+        }
+        s->failed = true;
+        return r;
+    }
+    s->failed = true;
+    return HTTP_SESSION_ERR_SEND;
+}
+
+int http_session_read(http_session_t *s, void *buf, size_t len) {
+    if (!s || !s->transport || s->failed) return HTTP_SESSION_ERR_RESPONSE;
+    if (s->done || len == 0) return 0;
+
+    if (s->chunked && s->remaining == 0) {
+        int r = next_chunk(s);
+        if (r < 0) {
+            s->failed = true;
+            return r;
+        }
+        if (s->done) return 0;
+    }
+
+    size_t want = s->until_close || len < s->remaining ? len : s->remaining;
+    int n;
+    if (s->buf_pos < s->buf_len) {
+        size_t avail = s->buf_len - s->buf_pos;
+        n = (int)(want < avail ? want : avail);
+        memcpy(buf, s->buf + s->buf_pos, n);
+        s->buf_pos += n;
+    } else {
+        // Nothing buffered: read straight into the caller's buffer
+        n = transport_read(s, buf, want);
+        if (n == 0) {
+            s->failed = true;
+            return s->cancelled ? HTTP_SESSION_ERR_CANCELLED : HTTP_SESSION_ERR_TIMEOUT;
+        }
+        if (n < 0) {
+            if (s->until_close) {
+                s->done = true;
+                return 0;
+            }
+            s->failed = true;
+            return HTTP_SESSION_ERR_RESPONSE;
+        }
+    }
+
+    if (!s->until_close) {
+        s->remaining -= n;
+        if (!s->chunked && s->remaining == 0) s->done = true;
+    }
+    return n;
+}
+
+char *http_session_read_body(http_session_t *s, size_t max_len, size_t *len) {
+    if (len) *len = 0;
+    if (!s || !s->transport || s->failed) return NULL;
+
+    size_t cap = !s->chunked && !s->until_close && s->remaining > 0 ? s->remaining : 1024;
+    if (cap > max_len) cap = max_len;
+    char *body = (char *)psram_malloc(cap + 1);
+    if (!body) return NULL;
+
+    size_t got = 0;
+    while (got < max_len) {
+        if (got == cap) {
+            size_t grow = cap * 2 < max_len ? cap * 2 : max_len;
+            char *p = (char *)psram_realloc(body, grow + 1);
+            if (!p) break;
+            body = p;
+            cap = grow;
+        }
+        int n = http_session_read(s, body + got, cap - got);
+        if (n < 0) {
+            free(body);
+            return NULL;
+        }
+        if (n == 0) break;
+        got += n;
+    }
+    body[got] = '\0';
+    if (len) *len = got;
+    return body;
+}
+
+void http_session_end(http_session_t *s) {
+    if (!s || !s->transport) return;
+
+    char scrap[128];
+    size_t drained = 0;
+    while (!s->failed && !s->done && !s->until_close && drained < HTTP_DRAIN_MAX) {
+        int n = http_session_read(s, scrap, sizeof(scrap));
+        if (n <= 0) break;
+        drained += n;
+    }
+
+    tls_conn_release(s->conn, s->keep_alive && s->done && !s->failed);
+    s->transport = NULL;
+}
+
+const char *http_session_error_name(int err) {
+    switch (err) {
+    case HTTP_SESSION_ERR_CONNECT: return "connect failed";
+    case HTTP_SESSION_ERR_SEND: return "send failed";
+    case HTTP_SESSION_ERR_RESPONSE: return "bad or truncated response";
+    case HTTP_SESSION_ERR_TIMEOUT: return "timed out";
+    case HTTP_SESSION_ERR_CANCELLED: return "cancelled";
+    default: return err >= 0 ? "ok" : "error";
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,119 @@
+#ifndef HTTP_SESSION_H
+#define HTTP_SESSION_H
+
+#include "tls_conn.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * HTTP/1.1 requests over a tls_conn_t, keeping the connection alive.
+ *
+ * A response must be read to the end of its body (Content-Length or
+ * chunked) before the connection can carry the next request, so the body
+ * is read through this API rather than straight from the transport, either
+ * piece by piece as it arrives or all at once. A request that fails on a
+ * reused connection before any response arrives is sent again once on a
+ * new connection: the server closed the idle connection as the request
+ * went out.
+ *
+ * Another task can give up on a request by setting the flag its cancel
+ * points to. It is checked before each write and between short waits for
+ * data, so the request stops within HTTP_SESSION_CANCEL_POLL_MS of a wait;
+ * a connect in progress finishes first.
+ *
+ * No platform dependency.
+ */
+
+#define HTTP_SESSION_BUF            512     // Response read-ahead
+#define HTTP_SESSION_SEND_CHUNK     1400    // Request head and body go out in writes of up to this
+#define HTTP_SESSION_CANCEL_POLL_MS 100     // With a cancel flag, waits for data are cut into slices of this
+#define HTTP_SESSION_CHUNKED_BODY   SIZE_MAX // body_len of a body_fn body sent with chunked coding
+
+#define HTTP_SESSION_ERR_CONNECT    (-1)
+#define HTTP_SESSION_ERR_SEND       (-2)
+#define HTTP_SESSION_ERR_RESPONSE   (-3)    // Closed early or not HTTP
+#define HTTP_SESSION_ERR_TIMEOUT    (-4)
+#define HTTP_SESSION_ERR_CANCELLED  (-5)    // The cancel flag was set; the connection is closed
+
+/**
+ * Produces the request body: copy up to cap bytes starting at offset into
+ * buf and return how many. Called with increasing offsets, and from 0 again
+ * if the request is retried.
+ *
+ * With body_len HTTP_SESSION_CHUNKED_BODY the length is not known up front:
+ * the body goes out with chunked transfer coding, each call that returns
+ * data becomes one chunk, and returning 0 ends the body. body_fn may wait
+ * until it has more to send (audio still being captured). Once it has been
+ * called the request is not sent again on a new connection.
+ */
+typedef size_t (*http_body_fn)(void *ctx, size_t offset, char *buf, size_t cap);
+
+typedef struct {
+    const char *method;             // "GET", "POST"
+    const char *path;               // With the query string
+    const char *content_type;       // NULL without a body
+    const char *accept;             // NULL to leave out
+    const void *body;               // The whole body,
+    http_body_fn body_fn;           // or, when body is NULL, its producer
+    void *body_ctx;
+    size_t body_len;
+    uint32_t timeout_ms;            // For each write and each wait for data
+    const volatile bool *cancel;    // Set from elsewhere to give up; NULL if never
+} http_request_t;
+
+typedef struct {
+    tls_conn_t *conn;
+    tls_transport_t *transport;
+    int status;
+    bool reused;                    // Sent on a connection that was already open
+    bool keep_alive;                // The server allows another request after this one
+    bool chunked;
+    bool until_close;               // Neither length nor chunked: body ends at close
+    bool done;                      // Body read to the end
+    bool failed;
+    bool cancelled;
+    bool body_started;              // A chunked body has begun and cannot be produced again
+    size_t remaining;               // Of the body, or of the current chunk
+    uint32_t timeout_ms;
+    const volatile bool *cancel;
+    size_t buf_pos;
+    size_t buf_len;
+    char buf[HTTP_SESSION_BUF];
+} http_session_t;
+
+/**
+ * @brief Send the request and read the status line and headers.
+ * @return The HTTP status, or HTTP_SESSION_ERR_*. Call http_session_end()
+ *         either way.
+ */
+int http_session_begin(http_session_t *s, tls_conn_t *conn, const http_request_t *req);
+
+/**
+ * @brief Read the next part of the body.
+ * @return Bytes read, 0 at the end of the body, or HTTP_SESSION_ERR_*
+ */
+int http_session_read(http_session_t *s, void *buf, size_t len);
+
+/**
+ * @brief Read the rest of the body into a NUL-terminated buffer (free()
+ *        it), in PSRAM when there is some. A longer body is truncated.
+ * @param len Set to the length read; may be NULL
+ * @return NULL on error or out of memory
+ */
+char *http_session_read_body(http_session_t *s, size_t max_len, size_t *len);
+
+/**
+ * @brief Finish the request: a short unread rest of the body is drained so
+ *        the connection can stay open, and the connection goes back to the
+ *        manager.
+ */
+void http_session_end(http_session_t *s);
+
+const char *http_session_error_name(int err);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // HTTP_SESSION_H
@@ -0,0 +1,452 @@
+// src/kws.cpp - Template keyword spotter: MFCC features + open-begin DTW
+
+#include "kws.h"
+#include "mfcc.h"
+#include "vad.h"
+#include "psram_alloc.h"
+#include <string.h>
+
+#define DTW_INF             UINT32_MAX
+#define FLOOR_FALL_SHIFT    2
+#define FLOOR_RISE_SHIFT    9       // ~5 s, so a spoken keyword barely lifts the floor
+#define ENROLL_MAX_FRAMES   500     // 5 s of features while waiting for the utterance
+#define ENROLL_HANGOVER     15      // 300 ms of silence ends an enrollment utterance
+
+// One column of the DTW matrix per template: the cheapest alignment that
+// ends at each template frame for the current stream frame, and the
+// stream frame where that alignment began.
+typedef struct {
+    uint32_t cost[KWS_MAX_TEMPLATE_FRAMES];
+    uint32_t start[KWS_MAX_TEMPLATE_FRAMES];
+} dtw_column_t;
+
+struct kws {
+    kws_config_t cfg;
+    uint32_t sample_rate;
+    mfcc_t *mfcc;
+    uint32_t frame;                 // Feature frames since reset
+
+    int32_t mean[KWS_NUM_FEATURES]; // Cepstral means, Q8 log2 << 8
+    bool mean_valid;
+    int32_t floor;                  // Energy noise floor, Q8 log2
+    bool floor_valid;
+    uint16_t hold;                  // Frames DTW keeps running after the gate closes
+    bool dtw_live;
+    uint32_t refractory_until;
+
+    kws_template_t *templates;
+    size_t count;
+    dtw_column_t *columns;
+
+    bool enrolling;
+    vad_t vad;
+    int16_t *vad_buf;
+    uint16_t vad_fill;
+    uint32_t enroll_samples;        // Samples seen since kws_enroll_begin()
+    uint32_t enroll_first_end;      // enroll_samples when the first frame was produced
+    int16_t (*enroll_feat)[KWS_NUM_FEATURES];
+    uint16_t enroll_frames;
+
+    kws_stats_t stats;
+};
+
+static uint32_t frame_distance(const int16_t *a, const int16_t *b) {
+    uint32_t d = 0;
+    for (int k = 0; k < KWS_NUM_FEATURES; k++) {
+        int32_t diff = (int32_t)a[k] - b[k];
+        d += (uint32_t)(diff < 0 ? -diff : diff);
+    }
+    return d;
+}
+
+static void reset_columns(kws_t *kws) {
+    for (size_t t = 0; t < KWS_MAX_TEMPLATES; t++) {
+        for (int j = 0; j < KWS_MAX_TEMPLATE_FRAMES; j++) {
+            kws->columns[t].cost[j] = DTW_INF;
+        }
+    }
+    kws->dtw_live = false;
+}
+
+// c1..c12 minus their running means
+static void normalise(kws_t *kws, const int16_t *ceps, int16_t *feat) {
+    const uint8_t shift = kws->cfg.cmn_shift;
+    for (int k = 0; k < KWS_NUM_FEATURES; k++) {
+        int32_t x = (int32_t)ceps[k + 1] << 8;
+        if (!kws->mean_valid) {
+            kws->mean[k] = x;
+        } else {
+            kws->mean[k] += (x - kws->mean[k]) >> shift;
+        }
+        int32_t v = (x - kws->mean[k]) >> 8;
+        feat[k] = (int16_t)(v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+    }
+    kws->mean_valid = true;
+}
+
+// True while the frame, or one within the longest possible alignment
+// before it, rose above the noise floor by the gate margin.
+static bool update_gate(kws_t *kws, int32_t energy) {
+    if (!kws->floor_valid) {
+        kws->floor = energy;
+        kws->floor_valid = true;
+    } else if (energy < kws->floor) {
+        kws->floor -= (kws->floor - energy) >> FLOOR_FALL_SHIFT;
+    } else {
+        kws->floor += (energy - kws->floor) >> FLOOR_RISE_SHIFT;
+    }
+
+    if (energy > kws->floor + kws->cfg.gate_q8) {
+        kws->hold = 2 * KWS_MAX_TEMPLATE_FRAMES;
+    } else if (kws->hold > 0) {
+        kws->hold--;
+    }
+    return kws->hold > 0;
+}
+
+// Advance one template's column by a stream frame with the symmetric
+// step pattern (diagonal steps weigh 2), so the accumulated cost divided
+// by stream length + template length is a per-frame distance.
+// Returns that distance for an alignment ending on the last template
+// frame, or DTW_INF.
+static uint32_t dtw_step(const kws_template_t *tmpl, dtw_column_t *col,
+                         const int16_t *feat, uint32_t frame) {
+    const uint16_t T = tmpl->frames;
+    const uint32_t max_len = 2u * T;
+    uint32_t diag = DTW_INF, diag_start = 0;
+    uint32_t left = DTW_INF, left_start = 0;
+
+    for (uint16_t j = 0; j < T; j++) {
+        const uint32_t d = frame_distance(feat, tmpl->feat[j]);
+        const uint32_t up = col->cost[j], up_start = col->start[j];
+        uint32_t best = DTW_INF, best_start = frame;
+
+        if (j == 0) {
+            best = 2 * d;                       // Open begin: start here
+        } else if (diag != DTW_INF) {
+            best = diag + 2 * d;
+            best_start = diag_start;
+        }
+        if (up != DTW_INF && up + d < best) {
+            best = up + d;
+            best_start = up_start;
+        }
+        if (left != DTW_INF && left + d < best) {
+            best = left + d;
+            best_start = left_start;
+        }
+        // Prune alignments that have grown longer than any match can be
+        if (best != DTW_INF && frame - best_start + 1 > max_len) {
+            best = DTW_INF;
+        }
+
+        diag = up;
+        diag_start = up_start;
+        col->cost[j] = best;
+        col->start[j] = best_start;
+        left = best;
+        left_start = best_start;
+    }
+
+    const uint32_t cost = col->cost[T - 1];
+    if (cost == DTW_INF) return DTW_INF;
+    const uint32_t len = frame - col->start[T - 1] + 1;
+    if (2 * len < T) return DTW_INF;
+    return cost / (len + T);
+}
+
+// Closed-end DTW between two templates, same step pattern
+static uint32_t template_distance(const kws_template_t *a, const kws_template_t *b) {
+    uint32_t prev[KWS_MAX_TEMPLATE_FRAMES], cur[KWS_MAX_TEMPLATE_FRAMES];
+    for (uint16_t i = 0; i < a->frames; i++) {
+        for (uint16_t j = 0; j < b->frames; j++) {
+            const uint32_t d = frame_distance(a->feat[i], b->feat[j]);
+            uint32_t best = DTW_INF;
+            if (i == 0 && j == 0) best = 2 * d;
+            if (i > 0 && j > 0 && prev[j - 1] != DTW_INF) best = prev[j - 1] + 2 * d;
+            if (i > 0 && prev[j] != DTW_INF && prev[j] + d < best) best = prev[j] + d;
+            if (j > 0 && cur[j - 1] != DTW_INF && cur[j - 1] + d < best) best = cur[j - 1] + d;
+            cur[j] = best;
+        }
+        memcpy(prev, cur, b->frames * sizeof(uint32_t));
+    }
+    return prev[b->frames - 1] / (a->frames + b->frames);
+}
+
+static bool enroll_store(kws_t *kws, kws_result_t *result) {
+    size_t seg_start, seg_end;
+    if (!vad_get_segment(&kws->vad, &seg_start, &seg_end) || kws->enroll_frames == 0) {
+        return false;
+    }
+
+    // Frame f covers the window ending at enroll_first_end + f * hop; keep
+    // the frames whose window centre falls inside the speech segment
+    const mfcc_config_t *mc = mfcc_get_config(kws->mfcc);
+    const int32_t first_centre = (int32_t)kws->enroll_first_end - mc->frame_samples / 2;
+    int32_t from = ((int32_t)seg_start - first_centre + mc->hop_samples - 1) / mc->hop_samples;
+    int32_t to = ((int32_t)seg_end - first_centre + mc->hop_samples - 1) / mc->hop_samples;
+    if (from < 0) from = 0;
+    if (to > kws->enroll_frames) to = kws->enroll_frames;
+
+    const int32_t frames = to - from;
+    if (frames < KWS_MIN_TEMPLATE_FRAMES || frames > KWS_MAX_TEMPLATE_FRAMES) {
+        return false;
+    }
+
+    kws_template_t *tmpl = &kws->templates[kws->count];
+    tmpl->frames = (uint16_t)frames;
+    memcpy(tmpl->feat, kws->enroll_feat[from], frames * sizeof(tmpl->feat[0]));
+    if (result) result->template_index = (int8_t)kws->count;
+    kws->count++;
+    reset_columns(kws);
+    return true;
+}
+
+// Feed the enrollment VAD; returns an event once the utterance is over
+static kws_event_t enroll_feed(kws_t *kws, const int16_t *pcm, size_t n, kws_result_t *result) {
+    const uint16_t fs = kws->vad.cfg.frame_samples;
+    kws->enroll_samples += n;
+    while (n > 0) {
+        size_t take = fs - kws->vad_fill;
+        if (take > n) take = n;
+        memcpy(kws->vad_buf + kws->vad_fill, pcm, take * sizeof(int16_t));
+        kws->vad_fill += take;
+        pcm += take;
+        n -= take;
+        if (kws->vad_fill < fs) break;
+        kws->vad_fill = 0;
+
+        vad_event_t ev = vad_process_frame(&kws->vad, kws->vad_buf);
+        if (ev == VAD_EVENT_SPEECH_END || ev == VAD_EVENT_TIMEOUT) {
+            kws->enrolling = false;
+            bool ok = ev == VAD_EVENT_SPEECH_END && enroll_store(kws, result);
+            return ok ? KWS_EVENT_ENROLLED : KWS_EVENT_ENROLL_FAILED;
+        }
+    }
+    return KWS_EVENT_NONE;
+}
+
+static kws_event_t on_frame(kws_t *kws, kws_result_t *result) {
+    int16_t feat[KWS_NUM_FEATURES];
+    normalise(kws, mfcc_ceps(kws->mfcc), feat);
+    const uint32_t frame = kws->frame++;
+    kws->stats.frames++;
+
+    bool active = update_gate(kws, mfcc_log_energy(kws->mfcc));
+
+    if (kws->enrolling) {
+        if (kws->enroll_frames == 0) {
+            kws->enroll_first_end = kws->enroll_samples;
+        }
+        if (kws->enroll_frames < ENROLL_MAX_FRAMES) {
+            memcpy(kws->enroll_feat[kws->enroll_frames++], feat, sizeof(feat));
+        }
+        return KWS_EVENT_NONE;
+    }
+
+    if (!active || kws->count == 0) {
+        if (kws->dtw_live) reset_columns(kws);
+        return KWS_EVENT_NONE;
+    }
+    kws->dtw_live = true;
+    kws->stats.active_frames++;
+
+    uint32_t best = DTW_INF;
+    int best_index = -1;
+    for (size_t t = 0; t < kws->count; t++) {
+        uint32_t score = dtw_step(&kws->templates[t], &kws->columns[t], feat, frame);
+        if (score < best) {
+            best = score;
+            best_index = (int)t;
+        }
+    }
+    if (best < kws->stats.best_score) {
+        kws->stats.best_score = (uint16_t)best;
+    }
+
+    if (best <= kws->cfg.threshold && frame >= kws->refractory_until) {
+        kws->refractory_until = frame + kws->cfg.refractory_frames;
+        kws->stats.detections++;
+        reset_columns(kws);
+        if (result) {
+            result->template_index = (int8_t)best_index;
+            result->score = (uint16_t)best;
+            result->frame = frame;
+        }
+        return KWS_EVENT_DETECTED;
+    }
+    return KWS_EVENT_NONE;
+}
+
+// Enrollment outcomes outrank detections
+static kws_event_t merge_event(kws_event_t current, kws_event_t next) {
+    if (next == KWS_EVENT_NONE) return current;
+    if (current == KWS_EVENT_ENROLLED || current == KWS_EVENT_ENROLL_FAILED) return current;
+    return next;
+}
+
+extern "C" {
+
+void kws_config_default(kws_config_t *cfg) {
+    if (!cfg) return;
+    cfg->threshold = 3000;
+    cfg->refractory_frames = 100;       // 1 s
+    cfg->gate_q8 = 850;                 // ~10 dB
+    cfg->cmn_shift = 8;                 // 256 frames, ~2.5 s
+}
+
+kws_t *kws_create(uint32_t sample_rate, const kws_config_t *cfg) {
+    mfcc_config_t mc;
+    mfcc_config_default(&mc, sample_rate);
+
+    kws_t *kws = (kws_t *)calloc(1, sizeof(kws_t));
+    if (!kws) return NULL;
+    if (cfg) {
+        kws->cfg = *cfg;
+    } else {
+        kws_config_default(&kws->cfg);
+    }
+    kws->sample_rate = sample_rate;
+    kws->mfcc = mfcc_create(&mc);
+    kws->templates = (kws_template_t *)psram_calloc(KWS_MAX_TEMPLATES, sizeof(kws_template_t));
+    kws->columns = (dtw_column_t *)malloc(KWS_MAX_TEMPLATES * sizeof(dtw_column_t));
+    kws->enroll_feat = (int16_t (*)[KWS_NUM_FEATURES])psram_malloc(
+        ENROLL_MAX_FRAMES * KWS_NUM_FEATURES * sizeof(int16_t));
+    kws->vad_buf = (int16_t *)malloc((sample_rate / 50) * sizeof(int16_t));
+    if (!kws->mfcc || !kws->templates || !kws->columns || !kws->enroll_feat || !kws->vad_buf) {
+        kws_destroy(kws);
+        return NULL;
+    }
+    kws_reset(kws);
+    return kws;
+}
+
+void kws_destroy(kws_t *kws) {
+    if (!kws) return;
+    mfcc_destroy(kws->mfcc);
+    free(kws->templates);
+    free(kws->columns);
+    free(kws->enroll_feat);
+    free(kws->vad_buf);
+    free(kws);
+}
+
+void kws_reset(kws_t *kws) {
+    if (!kws) return;
+    mfcc_reset(kws->mfcc);
+    kws->frame = 0;
+    kws->mean_valid = false;
+    kws->floor_valid = false;
+    kws->hold = 0;
+    kws->refractory_until = 0;
+    kws->enrolling = false;
+    kws->stats.best_score = UINT16_MAX;
+    reset_columns(kws);
+}
+
+kws_event_t kws_process(kws_t *kws, const int16_t *pcm, size_t count, kws_result_t *result) {
+    if (result) {
+        result->template_index = -1;
+        result->score = UINT16_MAX;
+        result->frame = kws ? kws->frame : 0;
+    }
+    if (!kws || !pcm) return KWS_EVENT_NONE;
+
+    kws_event_t event = KWS_EVENT_NONE;
+    while (count > 0) {
+        bool ready;
+        size_t used = mfcc_feed(kws->mfcc, pcm, count, &ready);
+        if (kws->enrolling) {
+            event = merge_event(event, enroll_feed(kws, pcm, used, result));
+        }
+        pcm += used;
+        count -= used;
+        if (ready) {
+            event = merge_event(event, on_frame(kws, result));
+        }
+    }
+    return event;
+}
+
+bool kws_add_template(kws_t *kws, const kws_template_t *tmpl) {
+    if (!kws || !tmpl || kws->count >= KWS_MAX_TEMPLATES ||
+        tmpl->frames < KWS_MIN_TEMPLATE_FRAMES || tmpl->frames > KWS_MAX_TEMPLATE_FRAMES) {
+        return false;
+    }
+    kws->templates[kws->count++] = *tmpl;
+    reset_columns(kws);
+    return true;
+}
+
+void kws_clear_templates(kws_t *kws) {
+    if (!kws) return;
+    kws->count = 0;
+    reset_columns(kws);
+}
+
+size_t kws_template_count(const kws_t *kws) {
+    return kws ? kws->count : 0;
+}
+
+const kws_template_t *kws_get_template(const kws_t *kws, size_t index) {
+    return kws && index < kws->count ? &kws->templates[index] : NULL;
+}
+
+bool kws_enroll_begin(kws_t *kws) {
+    if (!kws || kws->count >= KWS_MAX_TEMPLATES) return false;
+
+    vad_config_t vc;
+    vad_config_default(&vc, kws->sample_rate);
+    vc.hangover_frames = ENROLL_HANGOVER;
+    vc.max_frames = ENROLL_MAX_FRAMES / 2;      // VAD frames are 20 ms
+    vc.no_speech_frames = vc.max_frames;
+    vc.lead_frames = 1;
+    vc.tail_frames = 1;
+    vad_init(&kws->vad, &vc);
+
+    kws->vad_fill = 0;
+    kws->enroll_samples = 0;
+    kws->enroll_frames = 0;
+    kws->enrolling = true;
+    return true;
+}
+
+void kws_enroll_cancel(kws_t *kws) {
+    if (kws) kws->enrolling = false;
+}
+
+bool kws_is_enrolling(const kws_t *kws) {
+    return kws && kws->enrolling;
+}
+
+uint16_t kws_calibrate(kws_t *kws) {
+    if (!kws) return 0;
+    if (kws->count < 2) return kws->cfg.threshold;
+
+    uint32_t worst = 0;
+    for (size_t a = 0; a < kws->count; a++) {
+        for (size_t b = a + 1; b < kws->count; b++) {
+            uint32_t d = template_distance(&kws->templates[a], &kws->templates[b]);
+            if (d > worst) worst = d;
+        }
+    }
+    uint32_t threshold = worst * 5 / 4;
+    kws->cfg.threshold = (uint16_t)(threshold > UINT16_MAX ? UINT16_MAX : threshold);
+    return kws->cfg.threshold;
+}
+
+void kws_set_threshold(kws_t *kws, uint16_t threshold) {
+    if (kws) kws->cfg.threshold = threshold;
+}
+
+uint16_t kws_get_threshold(const kws_t *kws) {
+    return kws ? kws->cfg.threshold : 0;
+}
+
+void kws_get_stats(kws_t *kws, kws_stats_t *stats) {
+    if (!kws || !stats) return;
+    *stats = kws->stats;
+    kws->stats.best_score = UINT16_MAX;
+}
+
+} // extern "C"
@@ -0,0 +1,118 @@
+#ifndef KWS_H
+#define KWS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Keyword spotter matching MFCC sequences against enrolled templates.
+ *
+ * Every 10 ms frame yields c1..c12 from mfcc with running cepstral mean
+ * normalisation. Each template is aligned against the stream with
+ * open-begin dynamic time warping (the keyword may start at any frame), and
+ * a keyword is reported when the length-normalised distance of a complete
+ * alignment drops below the threshold. DTW is skipped entirely while the
+ * input stays below an adaptive energy gate, so silence costs little more
+ * than the front-end.
+ *
+ * Templates are recorded with kws_enroll_begin(): the next utterance is cut
+ * with the voice activity detector and stored. The engine has no platform
+ * dependency and sees the same features on the device and on a host.
+ */
+typedef struct kws kws_t;
+
+#define KWS_NUM_FEATURES            12
+#define KWS_MAX_TEMPLATES           4
+#define KWS_MAX_TEMPLATE_FRAMES     150     // 1.5 s
+#define KWS_MIN_TEMPLATE_FRAMES     20
+
+typedef struct {
+    uint16_t frames;
+    int16_t feat[KWS_MAX_TEMPLATE_FRAMES][KWS_NUM_FEATURES];
+} kws_template_t;
+
+typedef struct {
+    uint16_t threshold;             // Largest normalised DTW distance accepted as a match
+    uint16_t refractory_frames;     // Frames ignored after a detection
+    uint16_t gate_q8;               // Energy above the noise floor that enables DTW, Q8 log2
+    uint8_t cmn_shift;              // Cepstral mean time constant, 2^shift frames
+} kws_config_t;
+
+typedef enum {
+    KWS_EVENT_NONE = 0,
+    KWS_EVENT_DETECTED,
+    KWS_EVENT_ENROLLED,             // An enrollment utterance was stored as a template
+    KWS_EVENT_ENROLL_FAILED,        // No usable utterance (silence, too short or too long)
+} kws_event_t;
+
+typedef struct {
+    int8_t template_index;          // Matched or newly stored template, -1 otherwise
+    uint16_t score;                 // Normalised DTW distance of the match
+    uint32_t frame;                 // Frame at which the event was raised
+} kws_result_t;
+
+typedef struct {
+    uint32_t frames;                // Feature frames computed
+    uint32_t active_frames;         // Frames that ran DTW
+    uint32_t detections;
+    uint16_t best_score;            // Lowest complete-alignment distance since the last read
+} kws_stats_t;
+
+/**
+ * @brief Threshold 3000, 1 s refractory, 10 dB gate, ~2.5 s mean.
+ */
+void kws_config_default(kws_config_t *cfg);
+
+/**
+ * @param cfg NULL for the defaults
+ */
+kws_t *kws_create(uint32_t sample_rate, const kws_config_t *cfg);
+void kws_destroy(kws_t *kws);
+
+/**
+ * @brief Forget the stream (front-end, means, alignments); templates stay.
+ */
+void kws_reset(kws_t *kws);
+
+/**
+ * @brief Run a block of samples through the engine.
+ * @return The most significant event raised by the block
+ */
+kws_event_t kws_process(kws_t *kws, const int16_t *pcm, size_t count, kws_result_t *result);
+
+bool kws_add_template(kws_t *kws, const kws_template_t *tmpl);
+void kws_clear_templates(kws_t *kws);
+size_t kws_template_count(const kws_t *kws);
+const kws_template_t *kws_get_template(const kws_t *kws, size_t index);
+
+/**
+ * @brief Store the next utterance as a template instead of matching it.
+ * @return false if all template slots are in use
+ */
+bool kws_enroll_begin(kws_t *kws);
+void kws_enroll_cancel(kws_t *kws);
+bool kws_is_enrolling(const kws_t *kws);
+
+/**
+ * @brief Derive the threshold from the spread between templates: 5/4 of
+ *        the largest pairwise distance. Needs at least two templates.
+ * @return The threshold now in use
+ */
+uint16_t kws_calibrate(kws_t *kws);
+void kws_set_threshold(kws_t *kws, uint16_t threshold);
+uint16_t kws_get_threshold(const kws_t *kws);
+
+/**
+ * @brief Read the counters; best_score restarts from the maximum.
+ */
+void kws_get_stats(kws_t *kws, kws_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // KWS_H
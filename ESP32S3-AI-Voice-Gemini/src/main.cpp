@@ -6,16 +6,19 @@
 #include <lvgl.h>
 #include <Arduino.h>
 #include <string.h>
+#include <algorithm>
 #include "pincfg.h"
 #include "dispcfg.h"
 #include "AXS15231B_touch.h"
 #include <Arduino_GFX_Library.h>
-#include <base64.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
 #include "storage_manager.h"
 #include "speech_to_text.h"
+#include "audio_uploader.h"
+#include "wake_word.h"
+#include "audio_capture.h"
 #include "text_to_speech.h"
 #include "gemini_client.h"
 #include "ui_manager.h"
@@ -36,6 +39,22 @@ static bool is_recording = false;
 static uint32_t last_button_press = 0;
 static const uint32_t BUTTON_DEBOUNCE_MS = 200;
 
+// What LVGL has drawn into the canvas since it was last pushed to the
+// panel, in the panel's own (unrotated) coordinates; empty when x1 > x2.
+// Pushed at most once per DISPLAY_PUSH_MS, so a fast-changing widget such
+// as the level meter costs one small transfer a frame, not a full screen.
+static const uint32_t DISPLAY_PUSH_MS = 33;
+static lv_area_t canvas_dirty = { 1, 1, 0, 0 };
+static uint32_t last_display_push = 0;
+
+// Rows of the dirty area that are not full width are copied out of the
+// canvas in pieces of this size before being sent
+static uint16_t push_buf[TFT_res_W * 16];
+
+// Cached answers are written to flash at most this often, while idle
+static const uint32_t CACHE_FLUSH_MS = 10000;
+static uint32_t last_cache_flush = 0;
+
 // ✅ Improved printf override with better filtering
 static int vprintf_to_ui(const char *fmt, va_list args) {
     char buf[256];
@@ -65,9 +84,59 @@ void my_disp_flush(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map) {
 
     gfx->draw16bitRGBBitmap(area->x1, area->y1, (uint16_t *)px_map, w, h);
 
+    // The canvas rotates as it draws; its framebuffer stays in panel order
+    lv_area_t a;
+    switch (TFT_rot) {
+    case 1:
+        a = { TFT_res_W - 1 - area->y2, area->x1, TFT_res_W - 1 - area->y1, area->x2 };
+        break;
+    case 2:
+        a = { TFT_res_W - 1 - area->x2, TFT_res_H - 1 - area->y2,
+              TFT_res_W - 1 - area->x1, TFT_res_H - 1 - area->y1 };
+        break;
+    case 3:
+        a = { area->y1, TFT_res_H - 1 - area->x2, area->y2, TFT_res_H - 1 - area->x1 };
+        break;
+    default:
+        a = *area;
+        break;
+    }
+    if (canvas_dirty.x1 > canvas_dirty.x2) {
+        canvas_dirty = a;
+    } else {
+        canvas_dirty.x1 = std::min(canvas_dirty.x1, a.x1);
+        canvas_dirty.y1 = std::min(canvas_dirty.y1, a.y1);
+        canvas_dirty.x2 = std::max(canvas_dirty.x2, a.x2);
+        canvas_dirty.y2 = std::max(canvas_dirty.y2, a.y2);
+    }
+
     lv_disp_flush_ready(disp);
 }
 
+// Send the dirty part of the canvas to the panel
+static void push_canvas_dirty(void) {
+    int32_t x1 = std::max<int32_t>(canvas_dirty.x1, 0), x2 = std::min<int32_t>(canvas_dirty.x2, TFT_res_W - 1);
+    int32_t y1 = std::max<int32_t>(canvas_dirty.y1, 0), y2 = std::min<int32_t>(canvas_dirty.y2, TFT_res_H - 1);
+    canvas_dirty = { 1, 1, 0, 0 };
+    if (x1 > x2 || y1 > y2) return;
+
+    uint16_t *fb = gfx->getFramebuffer();
+    int32_t w = x2 - x1 + 1;
+    if (w == TFT_res_W) {
+        // Whole rows are contiguous in the framebuffer
+        g->draw16bitRGBBitmap(0, y1, fb + y1 * TFT_res_W, w, y2 - y1 + 1);
+        return;
+    }
+    int32_t rows_per_push = (int32_t)(sizeof(push_buf) / sizeof(push_buf[0])) / w;
+    for (int32_t y = y1; y <= y2; y += rows_per_push) {
+        int32_t rows = std::min(rows_per_push, y2 - y + 1);
+        for (int32_t r = 0; r < rows; r++) {
+            memcpy(push_buf + r * w, fb + (y + r) * TFT_res_W + x1, w * sizeof(uint16_t));
+        }
+        g->draw16bitRGBBitmap(x1, y, push_buf, w, rows);
+    }
+}
+
 // Read the touchpad
 void my_touchpad_read(lv_indev_t *indev, lv_indev_data_t *data) {
     uint16_t x, y;
@@ -84,6 +153,11 @@ void my_touchpad_read(lv_indev_t *indev, lv_indev_data_t *data) {
             
             // Check if touch is on the talk button area (you need to adjust coordinates)
             if (x >= 100 && x <= 220 && y >= 350 && y <= 450) {
+                // With echo cancellation the user can talk over the playback
+                if (!is_recording && !speech_to_text_is_recording() &&
+                    audio_capture_is_echo_cancel_enabled() && text_to_speech_is_playing()) {
+                    text_to_speech_stop();
+                }
                 if (!is_recording && !speech_to_text_is_recording() && !text_to_speech_is_playing()) {
                     // Start recording
                     is_recording = true;
@@ -108,6 +182,131 @@ void my_touchpad_read(lv_indev_t *indev, lv_indev_data_t *data) {
     }
 }
 
+// Serial console: "enroll" records a wake word template, "forget" drops them all,
+// "ns" and "aec" toggle noise suppression and echo cancellation
+static void handle_serial_command(void) {
+    if (!Serial.available()) return;
+    String cmd = Serial.readStringUntil('\n');
+    cmd.trim();
+    if (cmd == "enroll") {
+        if (wake_word_enroll() == ESP_OK) {
+            chat_screen_append_txt(TAG, "🗣️ Say the wake word...");
+        }
+    } else if (cmd == "forget") {
+        wake_word_clear();
+        chat_screen_append_txt(TAG, "Wake word templates cleared");
+    } else if (cmd == "ns") {
+        bool on = !audio_capture_is_noise_suppression_enabled();
+        audio_capture_set_noise_suppression(on);
+        chat_screen_append_txt(TAG, on ? "Noise suppression on" : "Noise suppression off");
+    } else if (cmd == "aec") {
+        bool on = !audio_capture_is_echo_cancel_enabled();
+        audio_capture_set_echo_cancel(on);
+        chat_screen_append_txt(TAG, on ? "Echo cancellation on" : "Echo cancellation off");
+    } else if (cmd == "voice") {
+        bool on = !gemini_client_is_voice_mode();
+        gemini_client_set_voice_mode(on);
+        chat_screen_append_txt(TAG, on ? "Voice queries: audio to Gemini" : "Voice queries: speech-to-text first");
+    } else if (cmd == "stream") {
+        bool on = !gemini_client_is_streaming();
+        gemini_client_set_streaming(on);
+        chat_screen_append_txt(TAG, on ? "Answers streamed" : "Answers read whole");
+    } else if (cmd == "ttft") {
+        gemini_stream_result_t r;
+        gemini_client_get_stream_result(&r);
+        Serial.printf("Last stream: status %d, headers %u ms, first text %u ms, end %u ms, "
+                      "%u events (%u dropped), %u bytes%s\n",
+                      r.status, (unsigned)r.headers_ms, (unsigned)r.first_text_ms,
+                      (unsigned)r.total_ms, (unsigned)r.events, (unsigned)r.dropped_events,
+                      (unsigned)r.text_bytes, r.reused ? ", reused connection" : "");
+    } else if (cmd == "newchat") {
+        gemini_client_clear_history();
+        chat_screen_append_txt(TAG, "New conversation");
+    } else if (cmd == "history") {
+        conversation_stats_t st;
+        gemini_client_get_history_stats(&st);
+        Serial.printf("History: %u turns, %u bytes, ~%u tokens, summary %u bytes, "
+                      "%u turns folded, %u summary lines dropped\n",
+                      (unsigned)st.turns, (unsigned)st.bytes, (unsigned)st.tokens,
+                      (unsigned)st.summary_bytes, (unsigned)st.folded, (unsigned)st.summary_dropped);
+    } else if (cmd == "cache") {
+        bool on = !gemini_client_is_cache_enabled();
+        gemini_client_set_cache_enabled(on);
+        chat_screen_append_txt(TAG, on ? "Response cache on" : "Response cache off");
+    } else if (cmd.startsWith("similar")) {
+        // "similar 0.7" sets the threshold for near matches, "similar 0" turns them off
+        float threshold = cmd.substring(7).toFloat();
+        gemini_client_set_cache_similarity(threshold);
+        chat_screen_append_txt(TAG, "Near-match threshold %.2f", threshold);
+    } else if (cmd == "cacheclear") {
+        gemini_client_clear_cache();
+        chat_screen_append_txt(TAG, "Response cache cleared");
+    } else if (cmd == "cachestats") {
+        response_cache_stats_t st;
+        gemini_client_get_cache_stats(&st);
+        Serial.printf("Cache: %u answers, %u bytes, %u hits (%u near), %u misses (%u expired), "
+                      "%u evicted, ~%u ms saved (%u ms a miss)\n",
+                      (unsigned)st.entries, (unsigned)st.bytes, (unsigned)st.hits, (unsigned)st.near_hits,
+                      (unsigned)st.misses,
+                      (unsigned)st.expired, (unsigned)st.evicted, (unsigned)st.saved_ms,
+                      (unsigned)st.avg_miss_ms);
+        Serial.printf("Cache flash: %u restored, %u pending, log %u/%u bytes, %u flushes, "
+                      "%u compactions, %u errors\n",
+                      (unsigned)st.loaded, (unsigned)st.pending, (unsigned)st.log_used,
+                      (unsigned)st.log_size, (unsigned)st.flushes, (unsigned)st.compactions,
+                      (unsigned)st.flash_errors);
+    } else if (cmd.startsWith("gemini_url")) {
+        // "gemini_url http://host:port" for a mock server, bare to reset
+        String url = cmd.substring(10);
+        url.trim();
+        gemini_client_set_base_url(url.c_str());
+    } else if (cmd.startsWith("upload_url")) {
+        // "upload_url http://host:port/path" streams audio there while recording, bare to stop
+        String url = cmd.substring(10);
+        url.trim();
+        speech_to_text_set_upload_url(url.c_str());
+        chat_screen_append_txt(TAG, url.length() ? "Streaming uploads on" : "Streaming uploads off");
+    } else if (cmd.startsWith("codec")) {
+        // "codec flac" picks the upload encoding: pcm16, ulaw, adpcm or flac
+        String name = cmd.substring(5);
+        name.trim();
+        int id = 0;
+        while (id < AUDIO_CODEC_COUNT && name != audio_codec_name((audio_codec_id_t)id)) id++;
+        if (id == AUDIO_CODEC_COUNT) {
+            Serial.println("Codecs: pcm16, ulaw, adpcm, flac");
+        } else {
+            speech_to_text_set_upload_codec((audio_codec_id_t)id);
+        }
+    } else if (cmd == "upload") {
+        audio_uploader_stats_t st;
+        audio_uploader_get_stats(&st);
+        Serial.printf("Last upload: HTTP %d, %u bytes in %u chunks, %u samples skipped, connect %u ms, "
+                      "first chunk %u ms, tail %u ms, response %u ms\n",
+                      st.http_status, (unsigned)st.bytes, (unsigned)st.chunks,
+                      (unsigned)st.samples_skipped, (unsigned)st.connect_ms,
+                      (unsigned)st.first_chunk_ms, (unsigned)st.tail_ms, (unsigned)st.response_ms);
+    } else if (cmd == "level") {
+        audio_level_stats_t st;
+        audio_capture_get_level(&st);
+        Serial.printf("Mic level: rms %.1f dBFS, peak %.1f dBFS, noise floor %.1f dBFS, %u clipped samples\n",
+                      st.rms_db10 / 10.0f, st.peak_db10 / 10.0f, st.noise_floor_db10 / 10.0f,
+                      (unsigned)st.clipped_samples);
+    } else if (cmd == "conn") {
+        tls_conn_stats_t st;
+        gemini_client_get_conn_stats(&st);
+        Serial.printf("Gemini connection: %u requests, %u reused (%u%%), %u full handshakes (avg %u ms), "
+                      "%u resumed (avg %u ms), %u failed, %u closed by server, %u idle, %u stale\n",
+                      (unsigned)st.requests, (unsigned)st.reused,
+                      st.requests ? (unsigned)(st.reused * 100 / st.requests) : 0,
+                      (unsigned)st.full_handshakes,
+                      st.full_handshakes ? (unsigned)(st.full_ms_total / st.full_handshakes) : 0,
+                      (unsigned)st.resumed_handshakes,
+                      st.resumed_handshakes ? (unsigned)(st.resumed_ms_total / st.resumed_handshakes) : 0,
+                      (unsigned)st.connect_failures, (unsigned)st.peer_closed,
+                      (unsigned)st.idle_expired, (unsigned)st.stale);
+    }
+}
+
 void setup() {
     // ✅ Extended delay for proper initialization
     delay(3000);
@@ -153,6 +352,7 @@ void setup() {
     Serial.println("Initializing LVGL...");
     lv_init();
     lv_tick_set_cb(millis_cb);
+    ui_manager_init();
 
     // ✅ 4) LVGL display driver with PSRAM buffer
     uint32_t w = gfx->width(), h = gfx->height();
@@ -189,6 +389,7 @@ void setup() {
     Serial.println("Loading UI...");
     ui_init();
     lv_scr_load(ui_Main);
+    ui_manager_level_meter_init();
 
     // Process UI a few times
     for (int i = 0; i < 5; i++) {
@@ -219,6 +420,8 @@ void setup() {
     
     Serial.println("Initializing speech-to-text...");
     speech_to_text_init();
+    speech_to_text_set_listening(true); // Pre-roll keeps the first syllable
+    wake_word_init();
     delay(200);
     
     Serial.println("Initializing Gemini client...");
@@ -245,14 +448,32 @@ void setup() {
 }
 
 void loop() {
-    // ✅ Prioritize LVGL task handling
+    // ✅ Prioritize LVGL task handling; UI work posted by other tasks first
+    ui_manager_run_posted();
     lv_task_handler();
     
     // ✅ TTS loop is now handled by dedicated task, just call lightweight version
     text_to_speech_loop();
+
+    // Hands-free: a detected wake word acts like pressing the talk button
+    handle_serial_command();
+    if (wake_word_poll() && !speech_to_text_is_recording()) {
+        chat_screen_on_record_start(NULL);
+    }
+
+    // Write-back of cached answers, never while audio is running
+    if (millis() - last_cache_flush > CACHE_FLUSH_MS) {
+        last_cache_flush = millis();
+        if (!speech_to_text_is_recording() && !text_to_speech_is_playing()) {
+            gemini_client_flush_cache();
+        }
+    }
     
-    // ✅ Flush display
-    gfx->flush();
+    // ✅ Flush display: only what LVGL redrew, at most once a frame
+    if (canvas_dirty.x1 <= canvas_dirty.x2 && millis() - last_display_push >= DISPLAY_PUSH_MS) {
+        last_display_push = millis();
+        push_canvas_dirty();
+    }
     
     // ✅ Small delay to prevent watchdog and allow other tasks
     delay(5);
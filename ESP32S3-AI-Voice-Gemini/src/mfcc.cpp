@@ -0,0 +1,248 @@
+// src/mfcc.cpp - Fixed-point log-mel / MFCC front-end
+
+#include "mfcc.h"
+#include "fft_q15.h"
+#include "audio_dsp.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PREEMPH_Q15     31785   // 0.97
+#define FFT_HEADROOM    16383   // Peak input to the FFT
+#define NO_BAND         0xFF
+
+struct mfcc {
+    mfcc_config_t cfg;
+    fft_q15_t *fft;
+    uint16_t log2_fft;
+    uint16_t bins;              // fft_size / 2 + 1
+    int16_t *window;            // Hamming, Q15
+    int16_t *frame;             // Pre-emphasised samples of the current window
+    uint16_t filled;
+    int16_t prev_sample;
+    int16_t *fft_buf;           // Real samples in, fft_size / 2 + 1 bins out
+    uint8_t *bin_band;          // Lower band edge at or below the bin, or NO_BAND
+    uint16_t *bin_weight;       // Falling-edge weight in Q15; the next band gets the rest
+    int16_t *dct;               // num_ceps x num_filters, Q15
+    int16_t *ceps;
+    int32_t log_energy;
+};
+
+static float hz_to_mel(float hz) {
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float mel_to_hz(float mel) {
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+// Band edges at equal mel spacing. Band b (0-based) rises from edge b to
+// its peak at edge b + 1 and falls to edge b + 2, so each bin lies on the
+// falling edge of at most one band and the rising edge of the next.
+// bin_band holds the edge index e: the falling band is e - 1 and the
+// rising band is e, which compute_frame() accumulates at e and e + 1.
+static void build_filterbank(mfcc_t *m) {
+    const mfcc_config_t *c = &m->cfg;
+    const int edges = c->num_filters + 2;
+    float edge_bin[MFCC_MAX_FILTERS + 2];
+    float mel_lo = hz_to_mel(c->low_hz), mel_hi = hz_to_mel(c->high_hz);
+    for (int e = 0; e < edges; e++) {
+        float hz = mel_to_hz(mel_lo + (mel_hi - mel_lo) * e / (edges - 1));
+        edge_bin[e] = hz * c->fft_size / c->sample_rate;
+    }
+
+    for (uint16_t k = 0; k < m->bins; k++) {
+        m->bin_band[k] = NO_BAND;
+        m->bin_weight[k] = 0;
+        for (int e = 0; e + 1 < edges; e++) {
+            if (k >= edge_bin[e] && k < edge_bin[e + 1]) {
+                float fall = (edge_bin[e + 1] - k) / (edge_bin[e + 1] - edge_bin[e]);
+                m->bin_band[k] = (uint8_t)e;
+                m->bin_weight[k] = (uint16_t)lrintf(fall * 32767.0f);
+                break;
+            }
+        }
+    }
+}
+
+static void build_dct(mfcc_t *m) {
+    const int M = m->cfg.num_filters;
+    for (int k = 0; k < m->cfg.num_ceps; k++) {
+        float scale = sqrtf((k == 0 ? 1.0f : 2.0f) / M);
+        for (int b = 0; b < M; b++) {
+            float v = scale * cosf((float)M_PI * k * (b + 0.5f) / M);
+            m->dct[k * M + b] = (int16_t)lrintf(v * 32767.0f);
+        }
+    }
+}
+
+static int16_t sat16(int32_t v) {
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+}
+
+static void compute_frame(mfcc_t *m) {
+    const mfcc_config_t *c = &m->cfg;
+    const uint16_t N = c->fft_size;
+
+    // Window, then normalise the block so the FFT sees full scale
+    int16_t peak = 0;
+    memset(m->fft_buf + c->frame_samples, 0, (N - c->frame_samples) * sizeof(int16_t));
+    for (uint16_t i = 0; i < c->frame_samples; i++) {
+        int16_t v = (int16_t)(((int32_t)m->frame[i] * m->window[i] + (1 << 14)) >> 15);
+        m->fft_buf[i] = v;
+        int16_t a = v < 0 ? (int16_t)-v : v;
+        if (a > peak) peak = a;
+    }
+    int shift = 0;
+    if (peak > 0) {
+        while ((peak << (shift + 1)) <= FFT_HEADROOM) shift++;
+        for (uint16_t i = 0; i < c->frame_samples; i++) {
+            m->fft_buf[i] = (int16_t)(m->fft_buf[i] << shift);
+        }
+    }
+
+    fft_q15_real_forward(m->fft, m->fft_buf);
+
+    // |X|^2 = P * N^2 / 4^shift, so log2 gains 2 * (log2 N - shift)
+    const int32_t offset = 2 * ((int32_t)m->log2_fft - shift) * 256;
+
+    uint64_t band[MFCC_MAX_FILTERS + 2] = { 0 };
+    uint64_t total = 0;
+    for (uint16_t k = 0; k < m->bins; k++) {
+        int32_t re = m->fft_buf[2 * k], im = m->fft_buf[2 * k + 1];
+        uint32_t p = (uint32_t)(re * re) + (uint32_t)(im * im);
+        total += p;
+        uint8_t e = m->bin_band[k];
+        if (e == NO_BAND) continue;
+        uint64_t fall = (uint64_t)p * m->bin_weight[k];
+        band[e] += fall;                                    // Band e - 1, stored at e
+        band[e + 1] += (uint64_t)p * 32767 - fall;          // Band e, stored at e + 1
+    }
+
+    int32_t logmel[MFCC_MAX_FILTERS];
+    for (uint8_t b = 0; b < c->num_filters; b++) {
+        logmel[b] = dsp_log2_q8((band[b + 1] >> 15) + 1) + offset;
+    }
+    m->log_energy = dsp_log2_q8(total + 1) + offset;
+
+    for (uint8_t k = 0; k < c->num_ceps; k++) {
+        const int16_t *row = m->dct + k * c->num_filters;
+        int64_t acc = 0;
+        for (uint8_t b = 0; b < c->num_filters; b++) {
+            acc += (int64_t)logmel[b] * row[b];
+        }
+        m->ceps[k] = sat16((int32_t)((acc + (1 << 14)) >> 15));
+    }
+}
+
+extern "C" {
+
+void mfcc_config_default(mfcc_config_t *cfg, uint32_t sample_rate) {
+    if (!cfg) return;
+    cfg->sample_rate = sample_rate;
+    cfg->frame_samples = (uint16_t)(sample_rate / 40);             // 25 ms
+    cfg->hop_samples = (uint16_t)(sample_rate / 100);              // 10 ms
+    cfg->fft_size = 1;
+    while (cfg->fft_size < cfg->frame_samples) cfg->fft_size <<= 1;
+    cfg->num_filters = 26;
+    cfg->num_ceps = 13;
+    cfg->low_hz = 20;
+    cfg->high_hz = (uint16_t)(sample_rate / 2 > 7600 ? 7600 : sample_rate / 2 - 100);
+}
+
+mfcc_t *mfcc_create(const mfcc_config_t *cfg) {
+    if (!cfg || cfg->frame_samples == 0 || cfg->hop_samples == 0 ||
+        cfg->hop_samples > cfg->frame_samples || cfg->fft_size < cfg->frame_samples ||
+        cfg->num_filters == 0 || cfg->num_filters > MFCC_MAX_FILTERS ||
+        cfg->num_ceps == 0 || cfg->num_ceps > cfg->num_filters ||
+        cfg->low_hz >= cfg->high_hz || cfg->high_hz > cfg->sample_rate / 2) {
+        return NULL;
+    }
+
+    mfcc_t *m = (mfcc_t *)calloc(1, sizeof(mfcc_t));
+    if (!m) return NULL;
+    m->cfg = *cfg;
+    m->bins = cfg->fft_size / 2 + 1;
+    while ((1u << m->log2_fft) < cfg->fft_size) m->log2_fft++;
+
+    m->fft = fft_q15_create_real(cfg->fft_size);
+    m->window = (int16_t *)malloc(cfg->frame_samples * sizeof(int16_t));
+    m->frame = (int16_t *)calloc(cfg->frame_samples, sizeof(int16_t));
+    m->fft_buf = (int16_t *)malloc((cfg->fft_size + 2) * sizeof(int16_t));
+    m->bin_band = (uint8_t *)malloc(m->bins);
+    m->bin_weight = (uint16_t *)malloc(m->bins * sizeof(uint16_t));
+    m->dct = (int16_t *)malloc(cfg->num_ceps * cfg->num_filters * sizeof(int16_t));
+    m->ceps = (int16_t *)calloc(cfg->num_ceps, sizeof(int16_t));
+    if (!m->fft || !m->window || !m->frame || !m->fft_buf || !m->bin_band ||
+        !m->bin_weight || !m->dct || !m->ceps) {
+        mfcc_destroy(m);
+        return NULL;
+    }
+
+    for (uint16_t i = 0; i < cfg->frame_samples; i++) {
+        float w = 0.54f - 0.46f * cosf(2.0f * (float)M_PI * i / (cfg->frame_samples - 1));
+        m->window[i] = (int16_t)lrintf(w * 32767.0f);
+    }
+    build_filterbank(m);
+    build_dct(m);
+    return m;
+}
+
+void mfcc_destroy(mfcc_t *m) {
+    if (!m) return;
+    fft_q15_destroy(m->fft);
+    free(m->window);
+    free(m->frame);
+    free(m->fft_buf);
+    free(m->bin_band);
+    free(m->bin_weight);
+    free(m->dct);
+    free(m->ceps);
+    free(m);
+}
+
+void mfcc_reset(mfcc_t *m) {
+    if (!m) return;
+    m->filled = 0;
+    m->prev_sample = 0;
+}
+
+const mfcc_config_t *mfcc_get_config(const mfcc_t *m) {
+    return m ? &m->cfg : NULL;
+}
+
+size_t mfcc_feed(mfcc_t *m, const int16_t *pcm, size_t count, bool *frame_ready) {
+    if (frame_ready) *frame_ready = false;
+    if (!m || !pcm) return count;
+
+    const uint16_t len = m->cfg.frame_samples;
+    size_t used = 0;
+    while (used < count) {
+        int32_t x = pcm[used];
+        int32_t y = x - (((int32_t)m->prev_sample * PREEMPH_Q15 + (1 << 14)) >> 15);
+        m->prev_sample = (int16_t)x;
+        m->frame[m->filled++] = sat16(y);
+        used++;
+
+        if (m->filled == len) {
+            compute_frame(m);
+            // Keep the overlap for the next window
+            const uint16_t keep = len - m->cfg.hop_samples;
+            memmove(m->frame, m->frame + m->cfg.hop_samples, keep * sizeof(int16_t));
+            m->filled = keep;
+            if (frame_ready) *frame_ready = true;
+            break;
+        }
+    }
+    return used;
+}
+
+const int16_t *mfcc_ceps(const mfcc_t *m) {
+    return m ? m->ceps : NULL;
+}
+
+int32_t mfcc_log_energy(const mfcc_t *m) {
+    return m ? m->log_energy : 0;
+}
+
+} // extern "C"
@@ -0,0 +1,75 @@
+#ifndef MFCC_H
+#define MFCC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming fixed-point MFCC extractor for 16-bit mono PCM.
+ *
+ * Samples are pre-emphasised, cut into overlapping Hamming-windowed frames,
+ * transformed with fft_q15, summed into a triangular mel filterbank, taken
+ * to log2 and decorrelated with an orthonormal DCT-II. Everything after
+ * mfcc_create() is integer arithmetic on preallocated buffers.
+ *
+ * Log values are Q8 log2 of power (256 = 3 dB); the absolute level
+ * includes a constant offset that cepstral mean normalisation removes.
+ */
+typedef struct mfcc mfcc_t;
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t frame_samples;     // Analysis window
+    uint16_t hop_samples;       // Frame advance
+    uint16_t fft_size;          // Power of two >= frame_samples
+    uint8_t num_filters;        // Mel bands
+    uint8_t num_ceps;           // Coefficients c0..c(num_ceps-1)
+    uint16_t low_hz;            // Lower edge of the first band
+    uint16_t high_hz;           // Upper edge of the last band
+} mfcc_config_t;
+
+#define MFCC_MAX_FILTERS    40
+
+/**
+ * @brief 25 ms windows every 10 ms, 26 bands, 13 coefficients.
+ */
+void mfcc_config_default(mfcc_config_t *cfg, uint32_t sample_rate);
+
+mfcc_t *mfcc_create(const mfcc_config_t *cfg);
+void mfcc_destroy(mfcc_t *mfcc);
+
+/**
+ * @brief Drop buffered samples and the pre-emphasis state.
+ */
+void mfcc_reset(mfcc_t *mfcc);
+const mfcc_config_t *mfcc_get_config(const mfcc_t *mfcc);
+
+/**
+ * @brief Consume samples until a frame completes or the input runs out.
+ *
+ * Call in a loop; when *frame_ready is set, mfcc_ceps() and
+ * mfcc_log_energy() describe the new frame until the next call.
+ *
+ * @return Number of samples consumed
+ */
+size_t mfcc_feed(mfcc_t *mfcc, const int16_t *pcm, size_t count, bool *frame_ready);
+
+/**
+ * @brief Cepstral coefficients of the last frame, Q8 log2 units.
+ */
+const int16_t *mfcc_ceps(const mfcc_t *mfcc);
+
+/**
+ * @brief Total power of the last frame, Q8 log2.
+ */
+int32_t mfcc_log_energy(const mfcc_t *mfcc);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // MFCC_H
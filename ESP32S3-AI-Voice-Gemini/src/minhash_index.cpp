@@ -0,0 +1,215 @@
+// src/minhash_index.cpp - MinHash signatures with LSH buckets for near-duplicate lookup
+
+#include "minhash_index.h"
+#include "psram_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_ID (-1)
+
+struct minhash_index {
+    uint16_t capacity;
+    uint32_t bucket_mask;
+    minhash_sig_t *sigs;
+    int16_t *heads;                 // BANDS tables of buckets, each a chain of ids
+    int16_t *next;                  // capacity * BANDS: next id in the same bucket
+    uint16_t *seen;                 // Query stamp, so a candidate is compared once
+    uint16_t stamp;
+    uint8_t *present;
+    minhash_index_stats_t st;
+};
+
+static uint64_t mix64(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+// Value i of a shingle hash: one pass of mixing per signature value
+static uint16_t permute(uint64_t x, int i) {
+    return (uint16_t)(mix64(x + (uint64_t)(i + 1) * 0x9e3779b97f4a7c15ull) >> 48);
+}
+
+static void add_shingle(minhash_sig_t *sig, const uint8_t *p, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull;     // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    for (int i = 0; i < MINHASH_K; i++) {
+        uint16_t v = permute(h, i);
+        if (v < sig->v[i]) sig->v[i] = v;
+    }
+}
+
+static bool is_continuation(uint8_t c) {
+    return (c & 0xC0) == 0x80;
+}
+
+static uint32_t band_bucket(const minhash_index_t *idx, const minhash_sig_t *sig, int band) {
+    const uint16_t *v = &sig->v[band * MINHASH_ROWS];
+    uint64_t h = (uint64_t)band << 48;
+    for (int r = 0; r < MINHASH_ROWS; r++) h = (h << 16) ^ v[r] ^ (h >> 48);
+    return (uint32_t)mix64(h) & idx->bucket_mask;
+}
+
+static void unlink_band(minhash_index_t *idx, uint16_t id, int band) {
+    int16_t *link = &idx->heads[band * (idx->bucket_mask + 1) + band_bucket(idx, &idx->sigs[id], band)];
+    while (*link != NO_ID) {
+        if (*link == (int16_t)id) {
+            *link = idx->next[id * MINHASH_BANDS + band];
+            return;
+        }
+        link = &idx->next[*link * MINHASH_BANDS + band];
+    }
+}
+
+extern "C" {
+
+void minhash_signature(const char *text, size_t len, minhash_sig_t *sig) {
+    for (int i = 0; i < MINHASH_K; i++) sig->v[i] = 0xFFFF;
+
+    // " text ": a shingle spans MINHASH_NGRAM code points, so UTF-8 starts
+    // are tracked in a small ring
+    uint8_t buf[2 + 256];
+    size_t n = len < sizeof(buf) - 2 ? len : sizeof(buf) - 2;
+    while (n > 0 && n < len && is_continuation((uint8_t)text[n])) n--;
+    buf[0] = ' ';
+    memcpy(buf + 1, text, n);
+    buf[n + 1] = ' ';
+    size_t total = n + 2;
+
+    size_t starts[MINHASH_NGRAM + 1];
+    size_t count = 0;
+    bool any = false;
+    for (size_t i = 0; i <= total; i++) {
+        if (i < total && is_continuation(buf[i])) continue;
+        starts[count % (MINHASH_NGRAM + 1)] = i;
+        count++;
+        if (count > MINHASH_NGRAM) {
+            size_t from = starts[(count - 1 - MINHASH_NGRAM) % (MINHASH_NGRAM + 1)];
+            add_shingle(sig, buf + from, i - from);
+            any = true;
+        }
+    }
+    // Shorter than a shingle: the whole text is the one shingle
+    if (!any) add_shingle(sig, buf, total);
+}
+
+float minhash_similarity(const minhash_sig_t *a, const minhash_sig_t *b) {
+    int same = 0;
+    for (int i = 0; i < MINHASH_K; i++) same += a->v[i] == b->v[i];
+    return (float)same / MINHASH_K;
+}
+
+minhash_index_t *minhash_index_create(uint16_t capacity) {
+    if (capacity == 0 || capacity > MINHASH_MAX_CAPACITY) return NULL;
+    minhash_index_t *idx = (minhash_index_t *)psram_calloc(1, sizeof(minhash_index_t));
+    if (!idx) return NULL;
+    uint32_t buckets = 16;
+    while (buckets < capacity) buckets <<= 1;
+    idx->capacity = capacity;
+    idx->bucket_mask = buckets - 1;
+    idx->sigs = (minhash_sig_t *)psram_malloc(capacity * sizeof(minhash_sig_t));
+    idx->heads = (int16_t *)psram_malloc((size_t)MINHASH_BANDS * buckets * sizeof(int16_t));
+    idx->next = (int16_t *)psram_malloc((size_t)capacity * MINHASH_BANDS * sizeof(int16_t));
+    idx->seen = (uint16_t *)psram_calloc(capacity, sizeof(uint16_t));
+    idx->present = (uint8_t *)psram_calloc(capacity, 1);
+    if (!idx->sigs || !idx->heads || !idx->next || !idx->seen || !idx->present) {
+        minhash_index_destroy(idx);
+        return NULL;
+    }
+    idx->st.capacity = capacity;
+    idx->st.memory = sizeof(*idx) + capacity * (sizeof(minhash_sig_t) + MINHASH_BANDS * sizeof(int16_t) +
+                                                sizeof(uint16_t) + 1) +
+                     MINHASH_BANDS * buckets * sizeof(int16_t);
+    minhash_index_clear(idx);
+    return idx;
+}
+
+void minhash_index_destroy(minhash_index_t *idx) {
+    if (!idx) return;
+    free(idx->sigs);
+    free(idx->heads);
+    free(idx->next);
+    free(idx->seen);
+    free(idx->present);
+    free(idx);
+}
+
+void minhash_index_set(minhash_index_t *idx, uint16_t id, const minhash_sig_t *sig) {
+    if (!idx || id >= idx->capacity) return;
+    minhash_index_remove(idx, id);
+    idx->sigs[id] = *sig;
+    for (int band = 0; band < MINHASH_BANDS; band++) {
+        int16_t *head = &idx->heads[band * (idx->bucket_mask + 1) + band_bucket(idx, sig, band)];
+        idx->next[id * MINHASH_BANDS + band] = *head;
+        *head = (int16_t)id;
+    }
+    idx->present[id] = 1;
+    idx->st.entries++;
+}
+
+void minhash_index_remove(minhash_index_t *idx, uint16_t id) {
+    if (!idx || id >= idx->capacity || !idx->present[id]) return;
+    for (int band = 0; band < MINHASH_BANDS; band++) unlink_band(idx, id, band);
+    idx->present[id] = 0;
+    idx->st.entries--;
+}
+
+void minhash_index_clear(minhash_index_t *idx) {
+    if (!idx) return;
+    size_t heads = (size_t)MINHASH_BANDS * (idx->bucket_mask + 1);
+    for (size_t i = 0; i < heads; i++) idx->heads[i] = NO_ID;
+    memset(idx->present, 0, idx->capacity);
+    idx->st.entries = 0;
+}
+
+int minhash_index_query(minhash_index_t *idx, const minhash_sig_t *sig, float threshold, float *similarity) {
+    if (similarity) *similarity = 0;
+    if (!idx || idx->st.entries == 0) return NO_ID;
+    if (++idx->stamp == 0) {
+        memset(idx->seen, 0, idx->capacity * sizeof(uint16_t));
+        idx->stamp = 1;
+    }
+    idx->st.queries++;
+    int best = NO_ID;
+    float best_sim = threshold;
+    uint32_t probes = 0;
+    uint32_t candidates = 0;
+    for (int band = 0; band < MINHASH_BANDS; band++) {
+        int id = idx->heads[band * (idx->bucket_mask + 1) + band_bucket(idx, sig, band)];
+        for (; id != NO_ID; id = idx->next[id * MINHASH_BANDS + band]) {
+            if (probes == MINHASH_MAX_PROBES || candidates == MINHASH_MAX_CANDIDATES) {
+                idx->st.capped++;
+                goto done;
+            }
+            probes++;
+            if (idx->seen[id] == idx->stamp) continue;
+            idx->seen[id] = idx->stamp;
+            candidates++;
+            // Equal to the threshold counts; a better one replaces it
+            float s = minhash_similarity(sig, &idx->sigs[id]);
+            if (s > best_sim || (best == NO_ID && s == best_sim)) {
+                best = id;
+                best_sim = s;
+                if (s == 1.0f) goto done;
+            }
+        }
+    }
+done:
+    idx->st.probes += probes;
+    idx->st.candidates += candidates;
+    if (best != NO_ID && similarity) *similarity = best_sim;
+    return best;
+}
+
+void minhash_index_get_stats(const minhash_index_t *idx, minhash_index_stats_t *st) {
+    if (!idx) {
+        memset(st, 0, sizeof(*st));
+        return;
+    }
+    *st = idx->st;
+}
+
+} // extern "C"
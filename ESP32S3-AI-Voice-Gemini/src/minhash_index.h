@@ -0,0 +1,86 @@
+#ifndef MINHASH_INDEX_H
+#define MINHASH_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Near-duplicate lookup over short texts: MinHash signatures of character
+ * 3-grams, with locality-sensitive hashing to find candidates.
+ *
+ * The share of equal values in two signatures estimates the Jaccard
+ * similarity of the texts' 3-gram sets, so "mấy giờ mở cửa" and "cửa hàng
+ * mở cửa mấy giờ" come out close while sharing no exact key. The signature
+ * is cut into bands; texts whose values agree on a whole band land in the
+ * same bucket, and only those are compared. Pairs at 0.6 share a band
+ * almost always, unrelated ones rarely. A query stops after a fixed number
+ * of bucket entries and candidates, so its time does not grow with the
+ * index, and memory is fixed at creation for the given capacity.
+ *
+ * Texts are expected normalized (response_cache_normalize()). Entries are
+ * identified by the caller's ids, 0 to capacity - 1. No platform dependency.
+ */
+
+#define MINHASH_K               48      // Values in a signature
+#define MINHASH_BANDS           16
+#define MINHASH_ROWS            3       // Values in a band; BANDS * ROWS == K
+#define MINHASH_NGRAM           3       // Characters in a shingle
+#define MINHASH_MAX_PROBES      256     // Bucket entries walked by a query
+#define MINHASH_MAX_CANDIDATES  64      // Signatures compared by a query
+#define MINHASH_MAX_CAPACITY    0x7FFF
+
+typedef struct {
+    uint16_t v[MINHASH_K];
+} minhash_sig_t;
+
+typedef struct {
+    uint32_t entries;
+    uint32_t capacity;
+    uint32_t memory;                // Bytes allocated
+    uint32_t queries;
+    uint32_t probes;                // Bucket entries walked, all queries
+    uint32_t candidates;            // Signatures compared, all queries
+    uint32_t capped;                // Queries stopped by a limit
+} minhash_index_stats_t;
+
+typedef struct minhash_index minhash_index_t;
+
+/**
+ * @brief Signature of text's character 3-grams, with a space at either
+ *        end so word starts and ends count too.
+ */
+void minhash_signature(const char *text, size_t len, minhash_sig_t *sig);
+
+/**
+ * @brief Estimated Jaccard similarity, 0 to 1.
+ */
+float minhash_similarity(const minhash_sig_t *a, const minhash_sig_t *b);
+
+minhash_index_t *minhash_index_create(uint16_t capacity);
+void minhash_index_destroy(minhash_index_t *idx);
+
+/**
+ * @brief Index sig under id, replacing what id had.
+ */
+void minhash_index_set(minhash_index_t *idx, uint16_t id, const minhash_sig_t *sig);
+void minhash_index_remove(minhash_index_t *idx, uint16_t id);
+void minhash_index_clear(minhash_index_t *idx);
+
+/**
+ * @brief The most similar entry at or above threshold among the candidates.
+ * @param similarity Set to its estimated similarity; may be NULL
+ * @return Its id, or -1
+ */
+int minhash_index_query(minhash_index_t *idx, const minhash_sig_t *sig, float threshold, float *similarity);
+
+void minhash_index_get_stats(const minhash_index_t *idx, minhash_index_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // MINHASH_INDEX_H
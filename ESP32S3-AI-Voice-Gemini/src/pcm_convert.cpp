@@ -0,0 +1,131 @@
+// src/pcm_convert.cpp - 32-bit I2S to 16-bit PCM conversion kernels
+
+#include "pcm_convert.h"
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && CONFIG_IDF_TARGET_ESP32S3
+#define PCM_CONVERT_HAVE_PIE 1
+#else
+#define PCM_CONVERT_HAVE_PIE 0
+#endif
+
+#define SIMD_BLOCK_SAMPLES  8
+#define SELF_TEST_SAMPLES   67   // Not a multiple of the block size on purpose
+
+static bool s_simd_enabled = PCM_CONVERT_HAVE_PIE;
+
+static inline int16_t sat16(int32_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+extern "C" {
+
+void pcm_convert_s32_to_s16_ref(const int32_t *in, int16_t *out, size_t count,
+                                const pcm_convert_cfg_t *cfg) {
+    const int32_t gain = cfg ? cfg->gain : 1;
+    const uint8_t shift = cfg ? cfg->shift : 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t s = (int32_t)(int16_t)(in[i] >> 16);
+        out[i] = sat16((s * gain) >> shift);
+    }
+}
+
+void pcm_convert_s32_to_s16_simd(const int32_t *in, int16_t *out, size_t count,
+                                 const pcm_convert_cfg_t *cfg) {
+#if PCM_CONVERT_HAVE_PIE
+    const bool aligned = ((((uintptr_t)in) | ((uintptr_t)out)) & 15) == 0;
+    size_t blocks = aligned ? count / SIMD_BLOCK_SAMPLES : 0;
+
+    if (blocks > 0) {
+        // vldbc needs the gain in memory; keep it on the stack
+        int16_t gain = cfg ? cfg->gain : 1;
+        uint32_t shift = cfg ? cfg->shift : 0;
+        const int32_t *src = in;
+        int16_t *dst = out;
+        uint32_t n = (uint32_t)blocks;
+
+        // q0/q1: two loads of 4 x int32. vunzip.16 splits them into the low
+        // halves (q0) and the high halves (q1), i.e. 8 x (in >> 16). vmul.s16
+        // then multiplies by the broadcast gain, shifts right by SAR and
+        // saturates to 16 bits.
+        asm volatile(
+            "wsr.sar      %[shift]\n"
+            "ee.vldbc.16  q3, %[gain]\n"
+            "1:\n"
+            "ee.vld.128.ip q0, %[src], 16\n"
+            "ee.vld.128.ip q1, %[src], 16\n"
+            "ee.vunzip.16 q0, q1\n"
+            "ee.vmul.s16  q2, q1, q3\n"
+            "ee.vst.128.ip q2, %[dst], 16\n"
+            "addi         %[n], %[n], -1\n"
+            "bnez         %[n], 1b\n"
+            : [src] "+r"(src), [dst] "+r"(dst), [n] "+r"(n)
+            : [shift] "r"(shift), [gain] "r"(&gain)
+            : "memory"
+        );
+    }
+
+    size_t done = blocks * SIMD_BLOCK_SAMPLES;
+    if (done < count) {
+        pcm_convert_s32_to_s16_ref(in + done, out + done, count - done, cfg);
+    }
+#else
+    pcm_convert_s32_to_s16_ref(in, out, count, cfg);
+#endif
+}
+
+void pcm_convert_s32_to_s16(const int32_t *in, int16_t *out, size_t count,
+                            const pcm_convert_cfg_t *cfg) {
+    if (s_simd_enabled) {
+        pcm_convert_s32_to_s16_simd(in, out, count, cfg);
+    } else {
+        pcm_convert_s32_to_s16_ref(in, out, count, cfg);
+    }
+}
+
+bool pcm_convert_has_simd(void) {
+    return s_simd_enabled;
+}
+
+bool pcm_convert_self_test(void) {
+    static int32_t in[SELF_TEST_SAMPLES] __attribute__((aligned(16)));
+    static int16_t ref[SELF_TEST_SAMPLES] __attribute__((aligned(16)));
+    static int16_t simd[SELF_TEST_SAMPLES] __attribute__((aligned(16)));
+
+    static const pcm_convert_cfg_t cfgs[] = {
+        { 1, 0 },       // Plain >> 16
+        { 4, 0 },       // x4, saturates on loud input
+        { 384, 8 },     // x1.5 in Q8
+        { -3, 1 },      // Negative gain
+    };
+
+    // Deterministic pattern with full-scale extremes at both ends
+    uint32_t lcg = 0x12345678u;
+    for (int i = 0; i < SELF_TEST_SAMPLES; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        in[i] = (int32_t)lcg;
+    }
+    in[0] = INT32_MAX;
+    in[1] = INT32_MIN;
+    in[2] = 0;
+    in[3] = -1;
+
+    bool ok = true;
+    for (size_t c = 0; c < sizeof(cfgs) / sizeof(cfgs[0]) && ok; c++) {
+        pcm_convert_s32_to_s16_ref(in, ref, SELF_TEST_SAMPLES, &cfgs[c]);
+        pcm_convert_s32_to_s16_simd(in, simd, SELF_TEST_SAMPLES, &cfgs[c]);
+        ok = memcmp(ref, simd, sizeof(ref)) == 0;
+    }
+
+    s_simd_enabled = PCM_CONVERT_HAVE_PIE && ok;
+    return ok;
+}
+
+} // extern "C"
@@ -0,0 +1,66 @@
+#ifndef PCM_CONVERT_H
+#define PCM_CONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sample format conversion for the I2S capture path.
+ *
+ * Each 32-bit I2S sample is reduced to its upper 16 bits, multiplied by
+ * gain and shifted right by shift, then saturated to int16:
+ *
+ *     out = sat16(((in >> 16) * gain) >> shift)
+ *
+ * gain = 1, shift = 0 reproduces a plain ">> 16". The gain is in Q(shift)
+ * format, e.g. gain = 384, shift = 8 is x1.5.
+ */
+typedef struct {
+    int16_t gain;
+    uint8_t shift;      // 0..31
+} pcm_convert_cfg_t;
+
+/**
+ * @brief Portable scalar reference implementation.
+ */
+void pcm_convert_s32_to_s16_ref(const int32_t *in, int16_t *out, size_t count,
+                                const pcm_convert_cfg_t *cfg);
+
+/**
+ * @brief ESP32-S3 PIE (128-bit SIMD) implementation.
+ *
+ * Processes 8 samples per iteration and needs 16-byte aligned input and
+ * output; misaligned buffers and the tail are handled by the scalar path.
+ * Falls back to the reference on targets without PIE.
+ */
+void pcm_convert_s32_to_s16_simd(const int32_t *in, int16_t *out, size_t count,
+                                 const pcm_convert_cfg_t *cfg);
+
+/**
+ * @brief Convert using the fastest implementation that passed the self test.
+ */
+void pcm_convert_s32_to_s16(const int32_t *in, int16_t *out, size_t count,
+                            const pcm_convert_cfg_t *cfg);
+
+/**
+ * @brief True when a SIMD kernel is compiled in and enabled.
+ */
+bool pcm_convert_has_simd(void);
+
+/**
+ * @brief Compare the SIMD kernel against the reference on a fixed pattern
+ *        that includes saturating values. The SIMD path is disabled for
+ *        pcm_convert_s32_to_s16() if the outputs differ.
+ * @return true if both paths produce identical output
+ */
+bool pcm_convert_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // PCM_CONVERT_H
@@ -0,0 +1,44 @@
+#ifndef PSRAM_ALLOC_H
+#define PSRAM_ALLOC_H
+
+#include <stdlib.h>
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocate from PSRAM when it is available, falling back to the
+ *        default heap. The result can be released with free().
+ */
+static inline void *psram_malloc(size_t size) {
+#ifdef ESP_PLATFORM
+    void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p) return p;
+#endif
+    return malloc(size);
+}
+
+static inline void *psram_calloc(size_t n, size_t size) {
+#ifdef ESP_PLATFORM
+    void *p = heap_caps_calloc(n, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p) return p;
+#endif
+    return calloc(n, size);
+}
+
+static inline void *psram_realloc(void *ptr, size_t size) {
+#ifdef ESP_PLATFORM
+    void *p = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p) return p;
+#endif
+    return realloc(ptr, size);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif // PSRAM_ALLOC_H
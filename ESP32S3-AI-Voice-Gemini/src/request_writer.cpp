@@ -0,0 +1,214 @@
+// src/request_writer.cpp - Request bodies written piece by piece into the send buffer
+
+#include "request_writer.h"
+#include "base64_stream.h"
+#include <string.h>
+
+enum {
+    PART_LITERAL,
+    PART_ESCAPED,
+    PART_BASE64,
+    PART_PRODUCED,
+};
+
+static inline bool needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// The sequence for a byte that needs escaping; returns its length
+static size_t escape_seq(unsigned char c, char seq[6]) {
+    static const char HEX[] = "0123456789abcdef";
+    seq[0] = '\\';
+    switch (c) {
+    case '"': seq[1] = '"'; return 2;
+    case '\\': seq[1] = '\\'; return 2;
+    case '\n': seq[1] = 'n'; return 2;
+    case '\r': seq[1] = 'r'; return 2;
+    case '\t': seq[1] = 't'; return 2;
+    default:
+        memcpy(seq, "\\u00", 4);
+        seq[4] = HEX[c >> 4];
+        seq[5] = HEX[c & 0xF];
+        return 6;
+    }
+}
+
+// Escape text from source byte *src on, whose output starts at *src_out,
+// writing the output from skip (not before *src_out) into out. The cursor
+// is left after the last source byte written whole.
+static size_t escape_from(const char *text, size_t len, size_t *src, size_t *src_out,
+                          size_t skip, char *out, size_t cap) {
+    size_t n = 0;
+    size_t i = *src;
+    size_t at = *src_out;
+    while (i < len && n < cap) {
+        unsigned char c = (unsigned char)text[i];
+        if (!needs_escape(c)) {
+            // A run written as it is, no longer than what is skipped and fits
+            size_t want = (skip > at ? skip - at : 0) + (cap - n);
+            size_t end = i + 1;
+            while (end < len && end - i < want && !needs_escape((unsigned char)text[end])) end++;
+            size_t run = end - i;
+            if (at + run > skip) {
+                size_t from = skip > at ? skip - at : 0;
+                memcpy(out + n, text + i + from, run - from);
+                n += run - from;
+            }
+            i = end;
+            at += run;
+        } else {
+            char seq[6];
+            size_t k = escape_seq(c, seq);
+            if (at + k > skip) {
+                size_t from = skip > at ? skip - at : 0;
+                size_t take = k - from < cap - n ? k - from : cap - n;
+                memcpy(out + n, seq + from, take);
+                n += take;
+                if (from + take < k) break;     // Cut inside the sequence: start there next time
+            }
+            i++;
+            at += k;
+        }
+    }
+    *src = i;
+    *src_out = at;
+    return n;
+}
+
+// Base64 characters [off, off + cap) of data: whole groups straight from
+// the input, a group split across reads or the padded last one through a
+// small buffer
+static size_t base64_at(const uint8_t *data, size_t len, size_t off, char *out, size_t cap) {
+    size_t size = BASE64_ENCODED_SIZE(len);
+    size_t n = 0;
+    while (n < cap && off < size) {
+        size_t group = off / 4;
+        size_t whole = len / 3 > group ? len / 3 - group : 0;
+        size_t groups = (cap - n) / 4 < whole ? (cap - n) / 4 : whole;
+        if (off % 4 == 0 && groups > 0) {
+            base64_encode_groups(data + group * 3, groups, out + n);
+            n += groups * 4;
+            off += groups * 4;
+        } else {
+            char chars[4];
+            size_t in = len - group * 3 < 3 ? len - group * 3 : 3;
+            base64_encode(data + group * 3, in, chars);
+            size_t k = 4 - off % 4 < cap - n ? 4 - off % 4 : cap - n;
+            memcpy(out + n, chars + off % 4, k);
+            n += k;
+            off += k;
+        }
+    }
+    return n;
+}
+
+static bool add_part(request_writer_t *w, uint8_t kind, const void *data, size_t len, size_t size) {
+    if (w->count == REQUEST_WRITER_MAX_PARTS) {
+        w->overflow = true;
+        return false;
+    }
+    request_part_t *p = &w->parts[w->count++];
+    memset(p, 0, sizeof(*p));
+    p->kind = kind;
+    p->data = data;
+    p->len = len;
+    p->size = size;
+    w->size += size;
+    return true;
+}
+
+static void restart(request_writer_t *w) {
+    w->at_part = 0;
+    w->at_part_start = 0;
+    w->at_src = 0;
+    w->at_src_out = 0;
+}
+
+extern "C" {
+
+void request_writer_init(request_writer_t *w) {
+    memset(w, 0, sizeof(*w));
+}
+
+bool request_writer_literal(request_writer_t *w, const char *s, size_t len) {
+    return add_part(w, PART_LITERAL, s, len, len);
+}
+
+bool request_writer_escaped(request_writer_t *w, const char *text, size_t len) {
+    return add_part(w, PART_ESCAPED, text, len, json_escaped_size(text, len));
+}
+
+bool request_writer_base64(request_writer_t *w, const uint8_t *data, size_t len) {
+    return add_part(w, PART_BASE64, data, len, BASE64_ENCODED_SIZE(len));
+}
+
+bool request_writer_part(request_writer_t *w, request_part_fn fn, void *ctx, size_t size) {
+    if (!add_part(w, PART_PRODUCED, NULL, 0, size)) return false;
+    w->parts[w->count - 1].fn = fn;
+    w->parts[w->count - 1].ctx = ctx;
+    return true;
+}
+
+size_t request_writer_size(const request_writer_t *w) {
+    return w->size;
+}
+
+size_t request_writer_read(void *ctx, size_t offset, char *buf, size_t cap) {
+    request_writer_t *w = (request_writer_t *)ctx;
+    if (offset < w->at_part_start) restart(w);
+
+    size_t n = 0;
+    while (n < cap && w->at_part < w->count) {
+        const request_part_t *p = &w->parts[w->at_part];
+        size_t pos = offset + n - w->at_part_start;
+        if (pos >= p->size) {
+            w->at_part_start += p->size;
+            w->at_part++;
+            w->at_src = 0;
+            w->at_src_out = 0;
+            continue;
+        }
+        size_t room = p->size - pos < cap - n ? p->size - pos : cap - n;
+        size_t k;
+        switch (p->kind) {
+        case PART_LITERAL:
+            memcpy(buf + n, (const char *)p->data + pos, room);
+            k = room;
+            break;
+        case PART_ESCAPED:
+            if (pos < w->at_src_out) {
+                w->at_src = 0;
+                w->at_src_out = 0;
+            }
+            k = escape_from((const char *)p->data, p->len, &w->at_src, &w->at_src_out, pos, buf + n, room);
+            break;
+        case PART_BASE64:
+            k = base64_at((const uint8_t *)p->data, p->len, pos, buf + n, room);
+            break;
+        default:
+            k = p->fn(p->ctx, pos, buf + n, room);
+            break;
+        }
+        if (k == 0) break;      // A producer came up short
+        n += k;
+    }
+    return n;
+}
+
+size_t json_escaped_size(const char *text, size_t len) {
+    size_t n = len;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (needs_escape(c)) {
+            n += c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t' ? 1 : 5;
+        }
+    }
+    return n;
+}
+
+size_t json_escape_at(const char *text, size_t len, size_t skip, char *out, size_t cap) {
+    size_t src = 0, src_out = 0;
+    return escape_from(text, len, &src, &src_out, skip, out, cap);
+}
+
+} // extern "C"
@@ -0,0 +1,102 @@
+#ifndef REQUEST_WRITER_H
+#define REQUEST_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Request bodies written straight into the send buffer, never built in
+ * memory.
+ *
+ * A body is a short list of parts: literal fragments (the constant JSON
+ * around the variable parts, compile-time strings in the caller), text
+ * that is JSON-escaped as it is written, bytes that are base64-encoded as
+ * they are written, and parts produced by a function (the conversation so
+ * far). The size of each part is known when it is added, so Content-Length
+ * is known before anything is written. request_writer_read() then fills a
+ * buffer from any offset: it is the http_body_fn of a request and writes
+ * into http_session's send chunk. A read at a later offset picks up where
+ * the previous one stopped.
+ *
+ * Nothing is allocated. The writer keeps pointers to the caller's data,
+ * which must not change until the request is sent. No platform dependency.
+ */
+
+#define REQUEST_WRITER_MAX_PARTS    8
+
+/**
+ * Produces bytes [offset, offset + cap) of a part; same contract as
+ * http_body_fn.
+ */
+typedef size_t (*request_part_fn)(void *ctx, size_t offset, char *buf, size_t cap);
+
+typedef struct {
+    uint8_t kind;
+    const void *data;
+    size_t len;                     // Of data
+    size_t size;                    // Bytes the part writes
+    request_part_fn fn;             // Produced parts
+    void *ctx;
+} request_part_t;
+
+typedef struct {
+    request_part_t parts[REQUEST_WRITER_MAX_PARTS];
+    uint8_t count;
+    bool overflow;                  // A part was refused: more than MAX_PARTS
+    size_t size;
+    // Where the last read stopped
+    uint8_t at_part;
+    size_t at_part_start;           // Body offset of parts[at_part]
+    size_t at_src;                  // Escaped text: source bytes done,
+    size_t at_src_out;              // and the bytes they wrote
+} request_writer_t;
+
+void request_writer_init(request_writer_t *w);
+
+/**
+ * @brief Add a part. The length of a string literal is known at compile
+ *        time; REQUEST_WRITER_LITERAL() passes it.
+ * @return false if the writer has no room for another part
+ */
+bool request_writer_literal(request_writer_t *w, const char *s, size_t len);
+bool request_writer_escaped(request_writer_t *w, const char *text, size_t len);
+bool request_writer_base64(request_writer_t *w, const uint8_t *data, size_t len);
+bool request_writer_part(request_writer_t *w, request_part_fn fn, void *ctx, size_t size);
+
+#define REQUEST_WRITER_LITERAL(w, lit)  request_writer_literal((w), (lit), sizeof(lit) - 1)
+
+/**
+ * @brief Bytes the whole body writes.
+ */
+size_t request_writer_size(const request_writer_t *w);
+
+/**
+ * @brief Write bytes [offset, offset + cap) of the body into buf. Reads
+ *        from increasing offsets continue where the last one stopped; an
+ *        offset behind it starts again from the beginning (a retry).
+ * @param ctx The request_writer_t
+ * @return Bytes written; fewer than cap only at the end of the body
+ */
+size_t request_writer_read(void *ctx, size_t offset, char *buf, size_t cap);
+
+/**
+ * @brief Bytes text takes as the inside of a JSON string: quote and
+ *        backslash escaped, \n \r \t as such, other controls as \u00XX.
+ */
+size_t json_escaped_size(const char *text, size_t len);
+
+/**
+ * @brief Escaped bytes [skip, skip + cap) of text.
+ * @return Bytes written, no NUL
+ */
+size_t json_escape_at(const char *text, size_t len, size_t skip, char *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // REQUEST_WRITER_H
@@ -0,0 +1,179 @@
+// src/resampler.cpp - Rational polyphase FIR resampler
+
+#include "resampler.h"
+#include "psram_alloc.h"
+#include <math.h>
+#include <string.h>
+
+#define RESAMPLER_MAX_PHASES    1024
+#define RESAMPLER_MAX_TAPS      256
+#define RESAMPLER_PASSBAND      0.85f   // Cutoff as a fraction of the lower Nyquist rate
+#define RESAMPLER_KAISER_BETA   7.0f    // ~70 dB stopband
+
+struct resampler {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t L;                 // Interpolation factor
+    uint32_t M;                 // Decimation factor
+    uint16_t taps;              // Taps per phase
+    uint16_t pos;               // Next write index in the delay line
+    uint32_t phase;             // Upsampled-time offset of the next output
+    int16_t *coeffs;            // L phases x taps, Q15, oldest sample first
+    int16_t *hist;              // Delay line, stored twice so the window is contiguous
+};
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static float bessel_i0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 32; k++) {
+        float t = x / (2.0f * k);
+        term *= t * t;
+        sum += term;
+        if (term < sum * 1e-9f) break;
+    }
+    return sum;
+}
+
+// Windowed-sinc prototype at the upsampled rate, split into polyphase
+// branches. Branch p, tap j multiplies x[n - (taps - 1 - j)].
+static bool design_filter(resampler_t *rs) {
+    const uint32_t L = rs->L, T = rs->taps;
+    const uint32_t N = L * T;
+    const float center = (N - 1) / 2.0f;
+    const uint32_t min_rate = rs->in_rate < rs->out_rate ? rs->in_rate : rs->out_rate;
+    const float fc = RESAMPLER_PASSBAND * 0.5f * min_rate / ((float)rs->in_rate * L);
+    const float i0_beta = bessel_i0(RESAMPLER_KAISER_BETA);
+
+    for (uint32_t p = 0; p < L; p++) {
+        int32_t abs_sum = 0;
+        for (uint32_t j = 0; j < T; j++) {
+            uint32_t k = p + L * (T - 1 - j);
+            float t = k - center;
+            float sinc = t == 0.0f ? 1.0f : sinf(2.0f * (float)M_PI * fc * t) / (2.0f * (float)M_PI * fc * t);
+            float r = t / (center > 0 ? center : 1.0f);
+            float w = bessel_i0(RESAMPLER_KAISER_BETA * sqrtf(fmaxf(0.0f, 1.0f - r * r))) / i0_beta;
+            float h = L * 2.0f * fc * sinc * w;
+
+            int32_t q = (int32_t)lrintf(h * 32768.0f);
+            if (q > INT16_MAX) q = INT16_MAX;
+            if (q < INT16_MIN) q = INT16_MIN;
+            rs->coeffs[p * T + j] = (int16_t)q;
+            abs_sum += q < 0 ? -q : q;
+        }
+        // Keeps the 32-bit accumulator in process() from overflowing
+        if (abs_sum >= 2 * 32768) {
+            return false;
+        }
+    }
+    return true;
+}
+
+extern "C" {
+
+resampler_t *resampler_create(uint32_t in_rate, uint32_t out_rate, uint16_t taps) {
+    if (in_rate == 0 || out_rate == 0) return NULL;
+    if (taps == 0) taps = RESAMPLER_DEFAULT_TAPS;
+
+    uint32_t g = gcd_u32(in_rate, out_rate);
+    uint32_t L = out_rate / g;
+    uint32_t M = in_rate / g;
+    if (L > RESAMPLER_MAX_PHASES) return NULL;
+
+    // Scale the filter length with the decimation ratio
+    uint32_t T = taps;
+    if (M > L) {
+        T = (taps * M + L - 1) / L;
+    }
+    if (T > RESAMPLER_MAX_TAPS) T = RESAMPLER_MAX_TAPS;
+
+    resampler_t *rs = (resampler_t *)calloc(1, sizeof(resampler_t));
+    if (!rs) return NULL;
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->L = L;
+    rs->M = M;
+    rs->taps = (uint16_t)T;
+    rs->coeffs = (int16_t *)psram_malloc((size_t)L * T * sizeof(int16_t));
+    rs->hist = (int16_t *)calloc(2 * T, sizeof(int16_t));
+    if (!rs->coeffs || !rs->hist || !design_filter(rs)) {
+        resampler_destroy(rs);
+        return NULL;
+    }
+    resampler_reset(rs);
+    return rs;
+}
+
+void resampler_destroy(resampler_t *rs) {
+    if (!rs) return;
+    free(rs->coeffs);
+    free(rs->hist);
+    free(rs);
+}
+
+void resampler_reset(resampler_t *rs) {
+    if (!rs) return;
+    memset(rs->hist, 0, 2 * rs->taps * sizeof(int16_t));
+    rs->pos = 0;
+    rs->phase = 0;
+}
+
+size_t resampler_max_output(const resampler_t *rs, size_t in_count) {
+    if (!rs) return 0;
+    return (size_t)(((uint64_t)in_count * rs->L + rs->M - 1) / rs->M) + 1;
+}
+
+size_t resampler_process(resampler_t *rs, const int16_t *in, size_t in_count,
+                         int16_t *out, size_t out_cap) {
+    if (!rs || !in || !out) return 0;
+
+    const uint32_t L = rs->L, M = rs->M, T = rs->taps;
+    int16_t *hist = rs->hist;
+    uint32_t pos = rs->pos;
+    uint32_t phase = rs->phase;
+    size_t produced = 0;
+
+    for (size_t i = 0; i < in_count; i++) {
+        hist[pos] = in[i];
+        hist[pos + T] = in[i];
+        if (++pos == T) pos = 0;
+        const int16_t *window = hist + pos;     // Oldest .. newest
+
+        while (phase < L) {
+            if (produced == out_cap) {
+                goto out_full;
+            }
+            const int16_t *c = rs->coeffs + phase * T;
+            int32_t acc = 1 << 14;
+            for (uint32_t j = 0; j < T; j++) {
+                acc += (int32_t)window[j] * c[j];
+            }
+            acc >>= 15;
+            if (acc > INT16_MAX) acc = INT16_MAX;
+            if (acc < INT16_MIN) acc = INT16_MIN;
+            out[produced++] = (int16_t)acc;
+            phase += M;
+        }
+        phase -= L;
+    }
+
+out_full:
+    rs->pos = (uint16_t)pos;
+    rs->phase = phase;
+    return produced;
+}
+
+uint32_t resampler_delay(const resampler_t *rs) {
+    if (!rs) return 0;
+    return (rs->L * rs->taps - 1) / 2 / rs->M;
+}
+
+} // extern "C"
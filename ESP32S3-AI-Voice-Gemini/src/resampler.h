@@ -0,0 +1,62 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Rational polyphase FIR resampler for 16-bit mono PCM.
+ *
+ * The ratio out_rate / in_rate is reduced to L / M. Conceptually the input
+ * is upsampled by L, low-pass filtered, and every M-th sample is kept. Only
+ * the filter phases that produce output are evaluated. Coefficients and the
+ * delay line are allocated by resampler_create(); process() never
+ * allocates and keeps its state between calls, so frames of any size can
+ * be fed.
+ */
+typedef struct resampler resampler_t;
+
+// Taps per polyphase branch when upsampling. Decimators scale this by M/L
+// so the transition band stays the same width at the output rate.
+#define RESAMPLER_DEFAULT_TAPS  32
+
+/**
+ * @brief Design the filter and allocate state.
+ * @param taps Taps per phase before decimation scaling, 0 for the default
+ * @return NULL if the ratio is unsupported or allocation failed
+ */
+resampler_t *resampler_create(uint32_t in_rate, uint32_t out_rate, uint16_t taps);
+void resampler_destroy(resampler_t *rs);
+
+/**
+ * @brief Clear the delay line and phase, e.g. between unrelated streams.
+ */
+void resampler_reset(resampler_t *rs);
+
+/**
+ * @brief Upper bound on the output of one process() call for in_count samples.
+ */
+size_t resampler_max_output(const resampler_t *rs, size_t in_count);
+
+/**
+ * @brief Resample in_count samples.
+ * @return Number of samples written to out. Stops early (and drops the rest
+ *         of the input) only if out_cap is smaller than resampler_max_output().
+ */
+size_t resampler_process(resampler_t *rs, const int16_t *in, size_t in_count,
+                         int16_t *out, size_t out_cap);
+
+/**
+ * @brief Group delay of the filter, in output samples.
+ */
+uint32_t resampler_delay(const resampler_t *rs);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // RESAMPLER_H
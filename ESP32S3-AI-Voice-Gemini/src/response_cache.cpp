@@ -0,0 +1,655 @@
+// src/response_cache.cpp - LRU cache of answers with a TTL and a flash write-back log
+
+#include "response_cache.h"
+#include "minhash_index.h"
+#include "psram_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HALF_MAGIC      0x31484352u     // "RCH1"
+#define RECORD_MAGIC    0xCAC1u
+#define HALF_HEADER     16
+#define RECORD_HEADER   20
+#define NO_SLOT         (-1)
+#define NO_HALF         0xFF
+
+// Worst case flash bytes of an entry besides its text: header and padding
+#define RECORD_OVERHEAD (RECORD_HEADER + 3)
+
+typedef struct {
+    uint64_t hash;
+    char *data;                     // Question, NUL, answer, NUL; PSRAM
+    uint32_t created;
+    uint16_t q_len;
+    uint16_t a_len;
+    int16_t newer;                  // Use list; free list through newer
+    int16_t older;
+    bool used;
+    bool dirty;                     // Not in the flash log yet
+} entry_t;
+
+struct response_cache {
+    response_cache_config_t cfg;
+    response_cache_flash_t flash;
+    bool has_flash;
+    entry_t *entries;
+    minhash_index_t *similar;       // Questions by slot, for near matches
+    int16_t *table;                 // Open addressing, slot or NO_SLOT
+    uint32_t table_mask;
+    int16_t newest;
+    int16_t oldest;
+    int16_t free_list;
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t pending;
+    // Flash log
+    uint8_t *record;                // One record being read or written
+    uint32_t half;                  // Bytes of each half
+    uint8_t active;                 // 0, 1 or NO_HALF before the first write
+    uint32_t generation;
+    uint32_t write_pos;             // Next record, within the active half
+    uint32_t erased_to;             // Sectors before this are erased or written
+    bool log_broken;                // A record could not be written or read back
+    response_cache_stats_t st;
+};
+
+// ---------------------------------------------------------------------------
+// Normalizing
+
+static const uint8_t *decode_utf8(const uint8_t *p, uint32_t *cp) {
+    uint8_t c = p[0];
+    size_t n = c >= 0xF0 && c < 0xF8 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    if (n == 1 || c >= 0xF8) {
+        *cp = c;                    // ASCII, or a stray byte kept as is
+        return p + 1;
+    }
+    uint32_t v = c & (0x3F >> (n - 1));
+    for (size_t i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *cp = c;
+            return p + 1;
+        }
+        v = (v << 6) | (p[i] & 0x3F);
+    }
+    *cp = v;
+    return p + n;
+}
+
+static size_t encode_utf8(uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+static bool is_separator(uint32_t cp) {
+    if (cp < 0x80) {
+        return !((cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') || (cp >= '0' && cp <= '9'));
+    }
+    return (cp >= 0xA0 && cp <= 0xBF) || cp == 0xD7 || cp == 0xF7 || (cp >= 0x2000 && cp <= 0x206F) ||
+           (cp >= 0x3000 && cp <= 0x303F);
+}
+
+// Capitals of Latin-1, Latin Extended-A, Ơ, Ư and Latin Extended Additional,
+// which cover precomposed Vietnamese
+static uint32_t to_lower(uint32_t cp) {
+    if (cp >= 'A' && cp <= 'Z') return cp + 0x20;
+    if (cp < 0xC0) return cp;
+    if (cp <= 0xDE) return cp == 0xD7 ? cp : cp + 0x20;
+    if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177)) return cp | 1;
+    if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) return (cp & 1) ? cp + 1 : cp;
+    if (cp == 0x1A0 || cp == 0x1AF) return cp + 1;
+    if (cp >= 0x1EA0 && cp <= 0x1EFF) return cp | 1;
+    return cp;
+}
+
+static uint64_t hash_key(const char *key, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull;     // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)key[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// ---------------------------------------------------------------------------
+// Index and use list
+
+static uint32_t bucket_of(const response_cache_t *c, uint64_t hash) {
+    return (uint32_t)(hash ^ (hash >> 32)) & c->table_mask;
+}
+
+static int find(const response_cache_t *c, uint64_t hash, const char *key, size_t len, uint32_t *bucket) {
+    for (uint32_t b = bucket_of(c, hash);; b = (b + 1) & c->table_mask) {
+        int slot = c->table[b];
+        if (slot == NO_SLOT) return NO_SLOT;
+        const entry_t *e = &c->entries[slot];
+        if (e->hash == hash && e->q_len == len && memcmp(e->data, key, len) == 0) {
+            if (bucket) *bucket = b;
+            return slot;
+        }
+    }
+}
+
+// Backward shift: later entries of the run move up so no probe stops early
+static void table_remove(response_cache_t *c, uint32_t b) {
+    c->table[b] = NO_SLOT;
+    for (uint32_t next = (b + 1) & c->table_mask; c->table[next] != NO_SLOT; next = (next + 1) & c->table_mask) {
+        uint32_t home = bucket_of(c, c->entries[c->table[next]].hash);
+        // Move it unless its home lies cyclically in (b, next]
+        bool stays = b <= next ? (home > b && home <= next) : (home > b || home <= next);
+        if (!stays) {
+            c->table[b] = c->table[next];
+            c->table[next] = NO_SLOT;
+            b = next;
+        }
+    }
+}
+
+static void unlink_entry(response_cache_t *c, int slot) {
+    entry_t *e = &c->entries[slot];
+    if (e->newer != NO_SLOT) {
+        c->entries[e->newer].older = e->older;
+    } else {
+        c->newest = e->older;
+    }
+    if (e->older != NO_SLOT) {
+        c->entries[e->older].newer = e->newer;
+    } else {
+        c->oldest = e->newer;
+    }
+}
+
+static void link_newest(response_cache_t *c, int slot) {
+    entry_t *e = &c->entries[slot];
+    e->older = c->newest;
+    e->newer = NO_SLOT;
+    if (c->newest != NO_SLOT) {
+        c->entries[c->newest].newer = (int16_t)slot;
+    } else {
+        c->oldest = (int16_t)slot;
+    }
+    c->newest = (int16_t)slot;
+}
+
+static void remove_entry(response_cache_t *c, int slot) {
+    entry_t *e = &c->entries[slot];
+    uint32_t b = 0;
+    find(c, e->hash, e->data, e->q_len, &b);
+    table_remove(c, b);
+    minhash_index_remove(c->similar, (uint16_t)slot);
+    unlink_entry(c, slot);
+    c->count--;
+    c->bytes -= e->q_len + e->a_len;
+    if (e->dirty) c->pending--;
+    free(e->data);
+    memset(e, 0, sizeof(*e));
+    e->newer = c->free_list;
+    c->free_list = (int16_t)slot;
+}
+
+static bool expired(const response_cache_t *c, const entry_t *e, uint32_t now) {
+    // A time ahead of now wraps to a large age
+    return now - e->created >= c->cfg.ttl_sec;
+}
+
+// Add a normalized question and its answer as the most recently used entry
+static bool store(response_cache_t *c, const char *key, size_t q_len, const char *answer, size_t a_len,
+                  uint32_t created, bool dirty, bool count_evictions) {
+    uint64_t hash = hash_key(key, q_len);
+    uint32_t b = 0;
+    int old = find(c, hash, key, q_len, &b);
+    if (old != NO_SLOT) remove_entry(c, old);
+    while (c->count > 0 && (c->count >= c->cfg.max_entries || c->bytes + q_len + a_len > c->cfg.max_bytes)) {
+        remove_entry(c, c->oldest);
+        if (count_evictions) c->st.evicted++;
+    }
+    char *data = (char *)psram_malloc(q_len + a_len + 2);
+    if (!data) return false;
+    memcpy(data, key, q_len);
+    data[q_len] = '\0';
+    memcpy(data + q_len + 1, answer, a_len);
+    data[q_len + 1 + a_len] = '\0';
+
+    int slot = c->free_list;
+    entry_t *e = &c->entries[slot];
+    c->free_list = e->newer;
+    e->hash = hash;
+    e->data = data;
+    e->created = created;
+    e->q_len = (uint16_t)q_len;
+    e->a_len = (uint16_t)a_len;
+    e->used = true;
+    e->dirty = dirty;
+    link_newest(c, slot);
+    for (b = bucket_of(c, hash); c->table[b] != NO_SLOT; b = (b + 1) & c->table_mask) {
+    }
+    c->table[b] = (int16_t)slot;
+    if (c->similar) {
+        minhash_sig_t sig;
+        minhash_signature(key, q_len, &sig);
+        minhash_index_set(c->similar, (uint16_t)slot, &sig);
+    }
+    c->count++;
+    c->bytes += q_len + a_len;
+    if (dirty) c->pending++;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Flash log
+
+static uint32_t crc32(uint32_t crc, const uint8_t *p, size_t len) {
+    static const uint32_t NIBBLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 4) ^ NIBBLE[(crc ^ p[i]) & 0x0F];
+        crc = (crc >> 4) ^ NIBBLE[(crc ^ (p[i] >> 4)) & 0x0F];
+    }
+    return ~crc;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t record_size(size_t q_len, size_t a_len) {
+    return (uint32_t)((RECORD_HEADER + q_len + a_len + 3) & ~(size_t)3);
+}
+
+static uint32_t round_to_sector(const response_cache_t *c, uint32_t pos) {
+    uint32_t s = c->flash.sector_size;
+    return (pos + s - 1) / s * s;
+}
+
+static uint32_t half_base(const response_cache_t *c, uint8_t half) {
+    return half * c->half;
+}
+
+// Header: magic, lengths, generation, time, CRC of all the rest
+static uint32_t encode_record(response_cache_t *c, const entry_t *e, uint32_t generation) {
+    uint32_t size = record_size(e->q_len, e->a_len);
+    uint8_t *r = c->record;
+    put_u16(r, RECORD_MAGIC);
+    put_u16(r + 2, e->q_len);
+    put_u16(r + 4, e->a_len);
+    put_u16(r + 6, 0xFFFF);
+    put_u32(r + 8, generation);
+    put_u32(r + 12, e->created);
+    memcpy(r + RECORD_HEADER, e->data, e->q_len);
+    memcpy(r + RECORD_HEADER + e->q_len, e->data + e->q_len + 1, e->a_len);
+    memset(r + RECORD_HEADER + e->q_len + e->a_len, 0xFF, size - RECORD_HEADER - e->q_len - e->a_len);
+    put_u32(r + 16, crc32(crc32(0, r, 16), r + RECORD_HEADER, size - RECORD_HEADER));
+    return size;
+}
+
+// Write a record of the active half at write_pos, erasing what it reaches into
+static bool append(response_cache_t *c, uint32_t size) {
+    uint32_t base = half_base(c, c->active);
+    uint32_t end = c->write_pos + size;
+    if (end > c->erased_to) {
+        uint32_t to = round_to_sector(c, end);
+        if (!c->flash.erase(c->flash.ctx, base + c->erased_to, to - c->erased_to)) return false;
+        c->erased_to = to;
+    }
+    if (!c->flash.write(c->flash.ctx, base + c->write_pos, c->record, size)) return false;
+    c->write_pos = end;
+    return true;
+}
+
+static bool read_half_header(response_cache_t *c, uint8_t half, uint32_t *generation) {
+    uint8_t h[HALF_HEADER];
+    if (!c->flash.read(c->flash.ctx, half_base(c, half), h, sizeof(h))) return false;
+    if (get_u32(h) != HALF_MAGIC || get_u32(h + 8) != crc32(0, h, 8)) return false;
+    *generation = get_u32(h + 4);
+    return true;
+}
+
+static bool write_half_header(response_cache_t *c, uint8_t half, uint32_t generation) {
+    uint8_t h[HALF_HEADER];
+    memset(h, 0xFF, sizeof(h));
+    put_u32(h, HALF_MAGIC);
+    put_u32(h + 4, generation);
+    put_u32(h + 8, crc32(0, h, 8));
+    return c->flash.write(c->flash.ctx, half_base(c, half), h, sizeof(h));
+}
+
+static bool all_erased(const uint8_t *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// Replay the active half into memory, oldest record first
+static void load(response_cache_t *c) {
+    uint32_t gen[2];
+    bool valid[2] = { read_half_header(c, 0, &gen[0]), read_half_header(c, 1, &gen[1]) };
+    if (!valid[0] && !valid[1]) return;
+    c->active = !valid[1] || (valid[0] && gen[0] > gen[1]) ? 0 : 1;
+    c->generation = gen[c->active];
+    uint32_t base = half_base(c, c->active);
+    uint32_t pos = HALF_HEADER;
+    uint8_t *r = c->record;
+    while (pos + RECORD_HEADER <= c->half) {
+        if (!c->flash.read(c->flash.ctx, base + pos, r, RECORD_HEADER)) {
+            c->log_broken = true;
+            break;
+        }
+        uint16_t q_len = get_u16(r + 2);
+        uint16_t a_len = get_u16(r + 4);
+        uint32_t size = record_size(q_len, a_len);
+        if (get_u16(r) != RECORD_MAGIC || get_u32(r + 8) != c->generation || q_len == 0 ||
+            q_len > RESPONSE_CACHE_QUESTION_MAX || a_len == 0 || a_len > RESPONSE_CACHE_ANSWER_MAX ||
+            pos + size > c->half ||
+            !c->flash.read(c->flash.ctx, base + pos + RECORD_HEADER, r + RECORD_HEADER, size - RECORD_HEADER) ||
+            get_u32(r + 16) != crc32(crc32(0, r, 16), r + RECORD_HEADER, size - RECORD_HEADER)) {
+            // Sectors are erased whole before a record reaches into them, so
+            // past the last record of a sector there is only 0xFF, unless a
+            // reset cut a record short: nothing more can be written after it.
+            // A new sector may still hold an older log; it is erased before use.
+            if (!all_erased(r, RECORD_HEADER) && pos % c->flash.sector_size != 0) c->log_broken = true;
+            break;
+        }
+        // Later records replace earlier ones; the limits evict as they did
+        if (q_len + a_len <= c->cfg.max_bytes) {
+            store(c, (const char *)r + RECORD_HEADER, q_len, (const char *)r + RECORD_HEADER + q_len, a_len,
+                  get_u32(r + 12), false, false);
+        }
+        pos += size;
+    }
+    c->write_pos = pos;
+    c->erased_to = round_to_sector(c, pos);
+    c->st.loaded = c->count;
+}
+
+// Copy the live entries to the other half, oldest first, then make it active
+static bool compact(response_cache_t *c, uint32_t now) {
+    if (now != 0) {
+        for (int slot = c->oldest; slot != NO_SLOT;) {
+            int newer = c->entries[slot].newer;
+            if (expired(c, &c->entries[slot], now)) {
+                remove_entry(c, slot);
+                c->st.expired++;
+            }
+            slot = newer;
+        }
+    }
+    uint8_t target = c->active == NO_HALF ? 0 : (uint8_t)(c->active ^ 1);
+    uint32_t generation = c->generation + 1;
+    uint32_t live = HALF_HEADER;
+    for (int slot = c->oldest; slot != NO_SLOT; slot = c->entries[slot].newer) {
+        live += record_size(c->entries[slot].q_len, c->entries[slot].a_len);
+    }
+    uint32_t erase = round_to_sector(c, live);
+    if (!c->flash.erase(c->flash.ctx, half_base(c, target), erase)) return false;
+
+    // Write into the target as if it were active; its header goes last, so a
+    // reset before then leaves the old half in charge
+    uint8_t old_active = c->active;
+    uint32_t old_write_pos = c->write_pos;
+    uint32_t old_erased_to = c->erased_to;
+    c->active = target;
+    c->write_pos = HALF_HEADER;
+    c->erased_to = erase;
+    for (int slot = c->oldest; slot != NO_SLOT; slot = c->entries[slot].newer) {
+        if (!append(c, encode_record(c, &c->entries[slot], generation))) break;
+        live -= record_size(c->entries[slot].q_len, c->entries[slot].a_len);
+    }
+    if (live != HALF_HEADER || !write_half_header(c, target, generation)) {
+        c->active = old_active;
+        c->write_pos = old_write_pos;
+        c->erased_to = old_erased_to;
+        c->log_broken = true;
+        return false;
+    }
+    c->generation = generation;
+    c->log_broken = false;
+    for (int slot = c->oldest; slot != NO_SLOT; slot = c->entries[slot].newer) {
+        c->entries[slot].dirty = false;
+    }
+    c->pending = 0;
+    c->st.compactions++;
+    return true;
+}
+
+extern "C" {
+
+response_cache_t *response_cache_create(const response_cache_config_t *cfg) {
+    response_cache_t *c = (response_cache_t *)psram_calloc(1, sizeof(response_cache_t));
+    if (!c) return NULL;
+    if (cfg) c->cfg = *cfg;
+    if (c->cfg.max_entries == 0) c->cfg.max_entries = RESPONSE_CACHE_DEFAULT_ENTRIES;
+    if (c->cfg.max_entries > 0x4000) c->cfg.max_entries = 0x4000;
+    if (c->cfg.max_bytes == 0) c->cfg.max_bytes = RESPONSE_CACHE_DEFAULT_BYTES;
+    if (c->cfg.ttl_sec == 0) c->cfg.ttl_sec = RESPONSE_CACHE_DEFAULT_TTL;
+
+    uint32_t buckets = 2;
+    while (buckets < 2u * c->cfg.max_entries) buckets <<= 1;
+    c->table_mask = buckets - 1;
+    c->entries = (entry_t *)psram_calloc(c->cfg.max_entries, sizeof(entry_t));
+    c->similar = minhash_index_create(c->cfg.max_entries);      // Near matches off without it
+    c->table = (int16_t *)psram_malloc(buckets * sizeof(int16_t));
+    if (!c->entries || !c->table) {
+        response_cache_destroy(c);
+        return NULL;
+    }
+    for (uint32_t b = 0; b < buckets; b++) c->table[b] = NO_SLOT;
+    for (int i = 0; i < c->cfg.max_entries; i++) {
+        c->entries[i].newer = i + 1 < c->cfg.max_entries ? (int16_t)(i + 1) : (int16_t)NO_SLOT;
+    }
+    c->free_list = 0;
+    c->newest = NO_SLOT;
+    c->oldest = NO_SLOT;
+    c->active = NO_HALF;
+
+    // A compaction must always fit in one half
+    const response_cache_flash_t *f = c->cfg.flash;
+    if (f && f->sector_size > 0 && f->size % (2 * f->sector_size) == 0) {
+        uint32_t half = f->size / 2;
+        uint32_t overhead = HALF_HEADER + (uint32_t)c->cfg.max_entries * RECORD_OVERHEAD;
+        if (half > overhead + RESPONSE_CACHE_QUESTION_MAX + RESPONSE_CACHE_ANSWER_MAX) {
+            c->record = (uint8_t *)psram_malloc(record_size(RESPONSE_CACHE_QUESTION_MAX, RESPONSE_CACHE_ANSWER_MAX));
+        }
+        if (c->record) {
+            c->flash = *f;
+            c->has_flash = true;
+            c->half = half;
+            if (c->cfg.max_bytes > half - overhead) c->cfg.max_bytes = half - overhead;
+        }
+    }
+    c->cfg.flash = NULL;
+    if (c->has_flash) load(c);
+    return c;
+}
+
+void response_cache_destroy(response_cache_t *c) {
+    if (!c) return;
+    if (c->entries) {
+        for (int i = 0; i < c->cfg.max_entries; i++) free(c->entries[i].data);
+    }
+    free(c->entries);
+    minhash_index_destroy(c->similar);
+    free(c->table);
+    free(c->record);
+    free(c);
+}
+
+size_t response_cache_normalize(const char *text, char *out, size_t cap) {
+    if (!text || cap == 0) return 0;
+    const uint8_t *p = (const uint8_t *)text;
+    size_t n = 0;
+    bool gap = false;
+    while (*p) {
+        uint32_t cp;
+        p = decode_utf8(p, &cp);
+        if (is_separator(cp)) {
+            gap = n > 0;
+            continue;
+        }
+        char utf8[4];
+        size_t len = encode_utf8(to_lower(cp), utf8);
+        if (n + gap + len + 1 > cap) return 0;
+        if (gap) out[n++] = ' ';
+        gap = false;
+        memcpy(out + n, utf8, len);
+        n += len;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+char *response_cache_get(response_cache_t *c, const char *question, uint32_t now) {
+    if (!c || !question || now == 0) return NULL;
+    char key[RESPONSE_CACHE_QUESTION_MAX + 1];
+    size_t len = response_cache_normalize(question, key, sizeof(key));
+    if (len == 0) return NULL;
+    bool near = false;
+    int slot = find(c, hash_key(key, len), key, len, NULL);
+    if (slot == NO_SLOT && c->similar && c->cfg.similarity > 0) {
+        minhash_sig_t sig;
+        minhash_signature(key, len, &sig);
+        slot = minhash_index_query(c->similar, &sig, c->cfg.similarity, NULL);
+        near = slot != NO_SLOT;
+    }
+    if (slot == NO_SLOT) {
+        c->st.misses++;
+        return NULL;
+    }
+    entry_t *e = &c->entries[slot];
+    if (expired(c, e, now)) {
+        remove_entry(c, slot);
+        c->st.expired++;
+        c->st.misses++;
+        return NULL;
+    }
+    char *answer = (char *)psram_malloc(e->a_len + 1);
+    if (!answer) return NULL;
+    memcpy(answer, e->data + e->q_len + 1, e->a_len + 1);
+    unlink_entry(c, slot);
+    link_newest(c, slot);
+    c->st.hits++;
+    if (near) c->st.near_hits++;
+    c->st.saved_ms += c->st.avg_miss_ms;
+    return answer;
+}
+
+bool response_cache_put(response_cache_t *c, const char *question, const char *answer, uint32_t now) {
+    if (!c || !question || !answer || now == 0) return false;
+    char key[RESPONSE_CACHE_QUESTION_MAX + 1];
+    size_t q_len = response_cache_normalize(question, key, sizeof(key));
+    size_t a_len = strlen(answer);
+    if (q_len == 0 || a_len == 0 || a_len > RESPONSE_CACHE_ANSWER_MAX || q_len + a_len > c->cfg.max_bytes) {
+        return false;
+    }
+    return store(c, key, q_len, answer, a_len, now, c->has_flash, true);
+}
+
+void response_cache_set_similarity(response_cache_t *c, float similarity) {
+    if (c) c->cfg.similarity = similarity;
+}
+
+void response_cache_note_miss(response_cache_t *c, uint32_t ms) {
+    if (!c) return;
+    uint32_t avg = c->st.avg_miss_ms;
+    c->st.avg_miss_ms = avg == 0 ? ms : (uint32_t)((int32_t)avg + ((int32_t)ms - (int32_t)avg) / 8);
+}
+
+bool response_cache_flush(response_cache_t *c, uint32_t now) {
+    if (!c || !c->has_flash) return true;
+    if (c->pending == 0 && !c->log_broken) return true;
+    bool ok;
+    if (c->active == NO_HALF || c->log_broken) {
+        ok = compact(c, now);
+    } else {
+        uint32_t need = 0;
+        for (int slot = c->oldest; slot != NO_SLOT; slot = c->entries[slot].newer) {
+            const entry_t *e = &c->entries[slot];
+            if (e->dirty) need += record_size(e->q_len, e->a_len);
+        }
+        if (c->write_pos + need > c->half) {
+            ok = compact(c, now);
+        } else {
+            ok = true;
+            for (int slot = c->oldest; ok && slot != NO_SLOT; slot = c->entries[slot].newer) {
+                entry_t *e = &c->entries[slot];
+                if (!e->dirty) continue;
+                ok = append(c, encode_record(c, e, c->generation));
+                if (ok) {
+                    e->dirty = false;
+                    c->pending--;
+                } else {
+                    c->log_broken = true;
+                }
+            }
+        }
+    }
+    if (ok) {
+        c->st.flushes++;
+    } else {
+        c->st.flash_errors++;
+    }
+    return ok;
+}
+
+void response_cache_clear(response_cache_t *c) {
+    if (!c) return;
+    while (c->oldest != NO_SLOT) remove_entry(c, c->oldest);
+    if (!c->has_flash) return;
+    // Without a valid header neither half is replayed
+    for (uint8_t half = 0; half < 2; half++) {
+        if (!c->flash.erase(c->flash.ctx, half_base(c, half), c->flash.sector_size)) c->st.flash_errors++;
+    }
+    c->active = NO_HALF;
+    c->generation = 0;
+    c->write_pos = 0;
+    c->erased_to = 0;
+    c->log_broken = false;
+}
+
+void response_cache_get_stats(const response_cache_t *c, response_cache_stats_t *st) {
+    if (!c) {
+        memset(st, 0, sizeof(*st));
+        return;
+    }
+    *st = c->st;
+    st->entries = c->count;
+    st->bytes = c->bytes;
+    st->pending = c->pending;
+    st->log_used = c->active == NO_HALF ? 0 : c->write_pos;
+    st->log_size = c->half;
+}
+
+} // extern "C"
@@ -0,0 +1,152 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Answers to questions asked before, kept so a repeat skips the round trip.
+ *
+ * Questions are normalized (case, punctuation and spacing dropped, so
+ * "Xin chào!" and "xin chào" are the same) and hashed; a hash table over
+ * the entries finds them, and a list in use order picks the least recently
+ * used one to evict when the entry or byte limit is reached. Entries older
+ * than the TTL are not served. With a similarity threshold set, a question
+ * with no exact match can still be answered by the closest one in a
+ * MinHash index (minhash_index.h) over the stored questions, for the
+ * rewordings and transcription noise an exact key misses.
+ *
+ * With a flash region, new entries are written back to a log there by
+ * response_cache_flush(), not as they are added: flash writes stall code
+ * running from flash, so the owner flushes when the device is idle. The
+ * region is two halves; when the active one is full, the live entries are
+ * copied to the other in use order and it becomes active. The log is
+ * replayed at creation, so the cache survives a reboot. Flash sits behind
+ * response_cache_flash_t: a partition on the device
+ * (response_cache_partition.cpp), memory in the host tests.
+ *
+ * Times are Unix seconds passed in by the caller; 0 means the clock is not
+ * set yet, and then nothing is looked up or added. One user at a time.
+ * No platform dependency.
+ */
+
+#define RESPONSE_CACHE_QUESTION_MAX         192     // Normalized bytes; longer questions are not cached
+#define RESPONSE_CACHE_ANSWER_MAX           4096
+#define RESPONSE_CACHE_DEFAULT_ENTRIES      64
+#define RESPONSE_CACHE_DEFAULT_BYTES        (32 * 1024)
+#define RESPONSE_CACHE_DEFAULT_TTL          (7 * 24 * 3600)
+#define RESPONSE_CACHE_DEFAULT_SIMILARITY   0.6f    // Suggested; see tools/minhash_bench.cpp
+
+typedef struct {
+    uint32_t size;                  // Bytes; two halves of whole sectors
+    uint32_t sector_size;           // Erase unit
+    bool (*read)(void *ctx, uint32_t offset, void *buf, size_t len);
+    bool (*write)(void *ctx, uint32_t offset, const void *data, size_t len);
+    bool (*erase)(void *ctx, uint32_t offset, size_t len);     // Whole sectors
+    void *ctx;
+} response_cache_flash_t;
+
+typedef struct {
+    uint16_t max_entries;
+    uint32_t max_bytes;             // Questions and answers in memory; also bounded by half the flash
+    uint32_t ttl_sec;
+    float similarity;               // Estimated Jaccard for a near match; 0 for exact matches only
+    const response_cache_flash_t *flash;    // NULL keeps the cache in memory only
+} response_cache_config_t;
+
+typedef struct {
+    uint32_t entries;
+    uint32_t bytes;
+    uint32_t hits;
+    uint32_t near_hits;             // Of the hits, answered by a near match
+    uint32_t misses;                // Expired entries included
+    uint32_t expired;
+    uint32_t evicted;
+    uint32_t avg_miss_ms;           // Round trip of a miss, smoothed
+    uint32_t saved_ms;              // Round trips not made, at avg_miss_ms each
+    uint32_t loaded;                // Entries restored from flash at creation
+    uint32_t pending;               // Entries not written back yet
+    uint32_t log_used;              // Bytes of the active half in use
+    uint32_t log_size;              // Bytes of one half
+    uint32_t flushes;
+    uint32_t compactions;
+    uint32_t flash_errors;
+} response_cache_stats_t;
+
+typedef struct response_cache response_cache_t;
+
+/**
+ * @brief Create the cache and load what the flash log holds.
+ * @param cfg NULL for the defaults, memory only
+ */
+response_cache_t *response_cache_create(const response_cache_config_t *cfg);
+void response_cache_destroy(response_cache_t *c);
+
+/**
+ * @brief The answer stored for question, if younger than the TTL, or else
+ *        the answer to the most similar stored question at or above the
+ *        similarity threshold. Counts a hit or a miss; a hit also makes the
+ *        entry the most recently used.
+ * @return A copy (caller frees), or NULL
+ */
+char *response_cache_get(response_cache_t *c, const char *question, uint32_t now);
+
+/**
+ * @brief Store answer for question, replacing an older one, and evict the
+ *        least recently used entries until the limits hold. Nothing is
+ *        stored for a question or answer over the maximum.
+ * @return true if stored
+ */
+bool response_cache_put(response_cache_t *c, const char *question, const char *answer, uint32_t now);
+
+/**
+ * @brief Change the threshold for near matches; 0 turns them off.
+ */
+void response_cache_set_similarity(response_cache_t *c, float similarity);
+
+/**
+ * @brief How long a round trip took that the cache could not answer, for
+ *        response_cache_stats_t::saved_ms.
+ */
+void response_cache_note_miss(response_cache_t *c, uint32_t ms);
+
+/**
+ * @brief Write entries added since the last flush to the flash log,
+ *        compacting into the other half when the active one is full.
+ *        Entries expired by now are left out of a compaction.
+ * @return false if flash failed; the entries stay pending
+ */
+bool response_cache_flush(response_cache_t *c, uint32_t now);
+
+/**
+ * @brief Drop every entry, in memory and in flash.
+ */
+void response_cache_clear(response_cache_t *c);
+
+/**
+ * @brief Lower case, punctuation to spaces, runs of spaces to one, none at
+ *        either end. Vietnamese capitals in precomposed form are lowered.
+ * @return Bytes written, NUL not counted; 0 if it does not fit in cap
+ */
+size_t response_cache_normalize(const char *text, char *out, size_t cap);
+
+void response_cache_get_stats(const response_cache_t *c, response_cache_stats_t *st);
+
+// ---------------------------------------------------------------------------
+// Device backend (response_cache_partition.cpp)
+
+/**
+ * @brief Flash ops over the data partition with this label, or NULL if the
+ *        partition table has none.
+ */
+const response_cache_flash_t *response_cache_partition_flash(const char *label);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // RESPONSE_CACHE_H
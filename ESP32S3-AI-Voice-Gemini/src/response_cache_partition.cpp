@@ -0,0 +1,45 @@
+// src/response_cache_partition.cpp - Flash ops for response_cache over a data partition
+
+#include "response_cache.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+static const char *TAG = "RESP_CACHE";
+
+// Erase unit of the SPI flash
+#define FLASH_SECTOR_SIZE 4096
+
+static bool partition_read(void *ctx, uint32_t offset, void *buf, size_t len) {
+    return esp_partition_read((const esp_partition_t *)ctx, offset, buf, len) == ESP_OK;
+}
+
+static bool partition_write(void *ctx, uint32_t offset, const void *data, size_t len) {
+    return esp_partition_write((const esp_partition_t *)ctx, offset, data, len) == ESP_OK;
+}
+
+static bool partition_erase(void *ctx, uint32_t offset, size_t len) {
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len) == ESP_OK;
+}
+
+extern "C" {
+
+const response_cache_flash_t *response_cache_partition_flash(const char *label) {
+    static response_cache_flash_t s_flash;
+    const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!p) {
+        ESP_LOGW(TAG, "No \"%s\" partition, answers are cached in memory only", label);
+        return NULL;
+    }
+    // Two halves of whole sectors
+    s_flash.size = p->size / (2 * FLASH_SECTOR_SIZE) * (2 * FLASH_SECTOR_SIZE);
+    s_flash.sector_size = FLASH_SECTOR_SIZE;
+    s_flash.read = partition_read;
+    s_flash.write = partition_write;
+    s_flash.erase = partition_erase;
+    s_flash.ctx = (void *)p;
+    ESP_LOGI(TAG, "Answer log in \"%s\": %u KB at 0x%x", label, (unsigned)(s_flash.size / 1024),
+             (unsigned)p->address);
+    return &s_flash;
+}
+
+} // extern "C"
@@ -0,0 +1,95 @@
+// src/sentence_split.cpp - Sentence boundaries in streamed text for TTS
+
+#include "sentence_split.h"
+#include <string.h>
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Whether buf[0..end) ends with sentence punctuation
+static bool ends_sentence(const char *buf, size_t end) {
+    if (end == 0) return false;
+    char c = buf[end - 1];
+    if (c == '.' || c == '!' || c == '?' || c == ';') return true;
+    // "…" is E2 80 A6
+    return end >= 3 && (uint8_t)buf[end - 3] == 0xE2 && (uint8_t)buf[end - 2] == 0x80 &&
+           (uint8_t)buf[end - 1] == 0xA6;
+}
+
+// Hand over buf[0..n) trimmed, then keep only what follows it
+static void emit(sentence_split_t *s, size_t n) {
+    size_t a = 0, b = n;
+    while (a < b && is_space(s->buf[a])) a++;
+    while (b > a && is_space(s->buf[b - 1])) b--;
+    if (b > a) {
+        char saved = s->buf[b];
+        s->buf[b] = '\0';
+        s->emit(s->ctx, s->buf + a, b - a);
+        s->buf[b] = saved;
+        s->sentences++;
+    }
+    memmove(s->buf, s->buf + n, s->len - n);
+    s->len -= n;
+}
+
+static size_t trimmed_len(const sentence_split_t *s, size_t n) {
+    size_t a = 0;
+    while (a < n && is_space(s->buf[a])) a++;
+    return n - a;
+}
+
+// Too long without an end: cut at the last space or comma, or failing
+// that between two UTF-8 sequences
+static void cut_long(sentence_split_t *s) {
+    size_t cut = 0;
+    for (size_t i = s->len; i > SENTENCE_SPLIT_MIN; i--) {
+        if (s->buf[i - 1] == ' ' || s->buf[i - 1] == ',') {
+            cut = i;
+            break;
+        }
+    }
+    if (cut == 0) {
+        cut = s->len;
+        while (cut > 1 && ((uint8_t)s->buf[cut - 1] & 0xC0) == 0x80) cut--;
+        if (cut > 1 && (uint8_t)s->buf[cut - 1] >= 0xC0) cut--;
+    }
+    emit(s, cut);
+}
+
+extern "C" {
+
+void sentence_split_init(sentence_split_t *s, sentence_fn emit_fn, void *ctx) {
+    memset(s, 0, sizeof(*s));
+    s->emit = emit_fn;
+    s->ctx = ctx;
+}
+
+void sentence_split_feed(sentence_split_t *s, const char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        // Markdown marks would be read aloud
+        if (c == '*' || c == '#' || c == '`') continue;
+
+        if (c == '\n' || (is_space(c) && ends_sentence(s->buf, s->len))) {
+            if (trimmed_len(s, s->len) >= SENTENCE_SPLIT_MIN) {
+                emit(s, s->len);
+                continue;
+            }
+            // Too short to say on its own: joined to the next one
+            c = ' ';
+        }
+        s->buf[s->len++] = c;
+        if (s->len >= SENTENCE_SPLIT_MAX) {
+            cut_long(s);
+        }
+    }
+}
+
+void sentence_split_finish(sentence_split_t *s) {
+    if (s->len > 0) {
+        emit(s, s->len);
+    }
+}
+
+} // extern "C"
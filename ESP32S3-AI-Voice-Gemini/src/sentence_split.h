@@ -0,0 +1,54 @@
+#ifndef SENTENCE_SPLIT_H
+#define SENTENCE_SPLIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Cuts streamed text into sentences for text-to-speech.
+ *
+ * Text arrives in deltas that end anywhere, even inside a UTF-8 sequence.
+ * A sentence is handed over once its end is certain: '.', '!', '?', ';'
+ * or an ellipsis followed by white space, or a line break. Very short
+ * sentences ("1.", "Ok.") are joined to the next, and one that grows past
+ * SENTENCE_SPLIT_MAX is cut at its last space or comma, since the TTS
+ * service only takes short requests.
+ *
+ * No platform dependency.
+ */
+
+#define SENTENCE_SPLIT_MAX  180     // Bytes; the TTS request limit is around 200
+#define SENTENCE_SPLIT_MIN  12      // Shorter sentences wait for the next one
+
+/**
+ * One sentence, trimmed, NUL-terminated; the pointer is valid only during
+ * the call.
+ */
+typedef void (*sentence_fn)(void *ctx, const char *sentence, size_t len);
+
+typedef struct {
+    sentence_fn emit;
+    void *ctx;
+    size_t len;
+    uint32_t sentences;             // Handed over so far
+    char buf[SENTENCE_SPLIT_MAX + 8];
+} sentence_split_t;
+
+void sentence_split_init(sentence_split_t *s, sentence_fn emit, void *ctx);
+
+void sentence_split_feed(sentence_split_t *s, const char *text, size_t len);
+
+/**
+ * @brief End of the text: hand over whatever is left.
+ */
+void sentence_split_finish(sentence_split_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // SENTENCE_SPLIT_H
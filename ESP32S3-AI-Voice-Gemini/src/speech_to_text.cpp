@@ -3,115 +3,191 @@
 #include "ui_manager.h"
 #include "gemini_client.h"
 #include "wifi_manager.h"
-#include "pincfg.h"
-#include <driver/i2s.h>
+#include "audio_capture.h"
+#include "audio_ring.h"
+#include "psram_alloc.h"
+#include "vad.h"
+#include "audio_uploader.h"
+#include "audio_codec.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <string.h>
-#include <base64.h>
 #include <math.h>
 
 static const char *TAG = "STT";
 
-// I2S Configuration
-#define I2S_NUM                 I2S_NUM_1
-#define I2S_SAMPLE_RATE         16000
-#define I2S_BITS_PER_SAMPLE     I2S_BITS_PER_SAMPLE_32BIT
-#define I2S_CHANNELS            1
-#define I2S_DMA_BUF_COUNT       8
-#define I2S_DMA_BUF_LEN         1024
-
-// Recording Configuration
-#define RECORD_TIME_SECONDS     5
-#define RECORD_BUFFER_SIZE      (I2S_SAMPLE_RATE * RECORD_TIME_SECONDS * sizeof(int16_t))
+#define I2S_SAMPLE_RATE         AUDIO_CAPTURE_SAMPLE_RATE
+
+// Recording Configuration. Recordings end at end-of-speech or at the VAD's
+// max_frames (see vad.h); the record buffer is sized for that once, plus
+// what the ring may still hold when the end is noticed.
+#define RECORD_SLACK_MS         500
 #define WAV_HEADER_SIZE         44
+#define COLLECT_INTERVAL_MS     20
+#define UPLOAD_RESULT_TIMEOUT_MS 20000
+#define PREROLL_DEFAULT_MS      500     // Audio kept from before the touch while listening
 
 // Global variables
 static bool s_is_recording = false;
+static bool s_buffer_borrowed = false;
 static uint8_t *s_record_buffer = NULL;
 static size_t s_record_buffer_pos = 0;
+static size_t s_record_buffer_cap = 0;
+static int s_reader = -1;
+static vad_t s_vad;
+static size_t s_vad_pos = 0;
+static volatile bool s_speech_done = false;
+static char s_upload_url[160] = {0};
+static bool s_streaming = false;
+static audio_codec_id_t s_upload_codec = AUDIO_CODEC_PCM16;
+static uint32_t s_preroll_ms = PREROLL_DEFAULT_MS;
+static SemaphoreHandle_t s_collect_lock = NULL;
 static TaskHandle_t s_recording_task_handle = NULL;
 
-// WAV file header structure
-typedef struct {
-    char riff[4];           // "RIFF"
-    uint32_t file_size;     // File size - 8
-    char wave[4];           // "WAVE"
-    char fmt[4];            // "fmt "
-    uint32_t fmt_size;      // Format chunk size (16)
-    uint16_t audio_format;  // Audio format (1 = PCM)
-    uint16_t num_channels;  // Number of channels
-    uint32_t sample_rate;   // Sample rate
-    uint32_t byte_rate;     // Byte rate
-    uint16_t block_align;   // Block align
-    uint16_t bits_per_sample; // Bits per sample
-    char data[4];           // "data"
-    uint32_t data_size;     // Data size
-} wav_header_t;
-
-// Create WAV header
-static void create_wav_header(wav_header_t *header, uint32_t data_size) {
-    memcpy(header->riff, "RIFF", 4);
-    header->file_size = data_size + WAV_HEADER_SIZE - 8;
-    memcpy(header->wave, "WAVE", 4);
-    memcpy(header->fmt, "fmt ", 4);
-    header->fmt_size = 16;
-    header->audio_format = 1; // PCM
-    header->num_channels = 1;
-    header->sample_rate = I2S_SAMPLE_RATE;
-    header->byte_rate = I2S_SAMPLE_RATE * 2; // 16-bit mono
-    header->block_align = 2;
-    header->bits_per_sample = 16;
-    memcpy(header->data, "data", 4);
-    header->data_size = data_size;
+// Record buffer for the longest recording the VAD allows
+static size_t record_buffer_size(const vad_config_t *cfg) {
+    size_t samples = (size_t)cfg->max_frames * cfg->frame_samples +
+                     (size_t)I2S_SAMPLE_RATE * RECORD_SLACK_MS / 1000;
+    return WAV_HEADER_SIZE + samples * sizeof(int16_t);
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Write a RIFF/WAVE header for a mono stream in the given codec format.
+// PCM gets the canonical 44-byte header; other formats carry the cbSize
+// extension (and samplesPerBlock for ADPCM) in the fmt chunk.
+// Returns the header size.
+static size_t write_wav_header(uint8_t *out, const audio_codec_wav_format_t *fmt,
+                               uint32_t data_size) {
+    uint32_t fmt_size = 16;
+    if (fmt->format_tag != 1) {
+        fmt_size = fmt->samples_per_block ? 20 : 18;
+    }
+    size_t header_size = 20 + fmt_size + 8;
+
+    memcpy(out, "RIFF", 4);
+    put_le32(out + 4, data_size == 0xFFFFFFFF ? data_size : data_size + header_size - 8);
+    memcpy(out + 8, "WAVE", 4);
+    memcpy(out + 12, "fmt ", 4);
+    put_le32(out + 16, fmt_size);
+    put_le16(out + 20, fmt->format_tag);
+    put_le16(out + 22, 1);                      // Mono
+    put_le32(out + 24, I2S_SAMPLE_RATE);
+    put_le32(out + 28, fmt->byte_rate);
+    put_le16(out + 32, fmt->block_align);
+    put_le16(out + 34, fmt->bits_per_sample);
+    if (fmt_size > 16) {
+        put_le16(out + 36, (uint16_t)(fmt_size - 18));
+        if (fmt->samples_per_block) {
+            put_le16(out + 38, fmt->samples_per_block);
+        }
+    }
+    memcpy(out + 20 + fmt_size, "data", 4);
+    put_le32(out + 24 + fmt_size, data_size);
+    return header_size;
+}
+
+// Drain everything the capture ring holds for our reader into the record
+// buffer. The buffer is allocated once for the longest recording, so
+// capture never allocates; should it fill anyway, the rest is dropped and
+// the recording ends.
+static void collect_available(void) {
+    xSemaphoreTake(s_collect_lock, portMAX_DELAY);
+
+    audio_ring_t *ring = audio_capture_get_ring();
+    const int16_t *span1, *span2;
+    size_t len1, len2;
+    size_t avail = audio_ring_peek(ring, s_reader, &span1, &len1, &span2, &len2);
+
+    if (avail > 0 && s_record_buffer) {
+        size_t room = (s_record_buffer_cap - s_record_buffer_pos) / sizeof(int16_t);
+        size_t n1 = len1 < room ? len1 : room;
+        size_t n2 = len2 < room - n1 ? len2 : room - n1;
+        memcpy(s_record_buffer + s_record_buffer_pos, span1, n1 * sizeof(int16_t));
+        s_record_buffer_pos += n1 * sizeof(int16_t);
+        if (n2 > 0) {
+            memcpy(s_record_buffer + s_record_buffer_pos, span2, n2 * sizeof(int16_t));
+            s_record_buffer_pos += n2 * sizeof(int16_t);
+        }
+        if (n1 + n2 < avail && !s_speech_done) {
+            ESP_LOGW(TAG, "Record buffer full, dropping %d samples", (int)(avail - n1 - n2));
+            s_speech_done = true;
+        }
+    }
+    audio_ring_consume(ring, s_reader, avail);
+
+    // Run the VAD over every complete frame collected so far
+    const size_t frame_bytes = s_vad.cfg.frame_samples * sizeof(int16_t);
+    while (!s_speech_done && s_record_buffer_pos - s_vad_pos >= frame_bytes) {
+        vad_event_t event = vad_process_frame(&s_vad, (const int16_t *)(s_record_buffer + s_vad_pos));
+        s_vad_pos += frame_bytes;
+
+        if (event == VAD_EVENT_SPEECH_START) {
+            ESP_LOGI(TAG, "Speech started (noise floor %u)", (unsigned)s_vad.noise_floor);
+        } else if (event == VAD_EVENT_SPEECH_END) {
+            ESP_LOGI(TAG, "End of speech after %u frames", (unsigned)s_vad.frames);
+            s_speech_done = true;
+        } else if (event == VAD_EVENT_TIMEOUT) {
+            ESP_LOGW(TAG, "No speech detected, stopping");
+            s_speech_done = true;
+        }
+    }
+
+    xSemaphoreGive(s_collect_lock);
+}
+
+// Cut leading and trailing silence out of the record buffer
+static void trim_silence(void) {
+    size_t start, end;
+    if (!vad_get_segment(&s_vad, &start, &end)) {
+        return;
+    }
+
+    size_t total = (s_record_buffer_pos - WAV_HEADER_SIZE) / sizeof(int16_t);
+    if (end > total) end = total;
+    if (start >= end || (start == 0 && end == total)) {
+        return;
+    }
+
+    memmove(s_record_buffer + WAV_HEADER_SIZE,
+            s_record_buffer + WAV_HEADER_SIZE + start * sizeof(int16_t),
+            (end - start) * sizeof(int16_t));
+    s_record_buffer_pos = WAV_HEADER_SIZE + (end - start) * sizeof(int16_t);
+    ESP_LOGI(TAG, "Trimmed silence: kept samples %d..%d of %d", (int)start, (int)end, (int)total);
 }
 
 void speech_to_text_init(void) {
-    ESP_LOGI(TAG, "Initializing I2S for INMP441 microphone...");
-    
-    // I2S configuration for INMP441
-    i2s_config_t i2s_config = {
-        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-        .sample_rate = I2S_SAMPLE_RATE,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = I2S_DMA_BUF_COUNT,
-        .dma_buf_len = I2S_DMA_BUF_LEN,
-        .use_apll = false,
-        .tx_desc_auto_clear = false,
-        .fixed_mclk = 0
-    };
-    
-    // I2S pin configuration for INMP441
-    i2s_pin_config_t pin_config = {
-        .bck_io_num = MIC_I2S_SCK,    // Serial Clock (BCLK)
-        .ws_io_num = MIC_I2S_WS,      // Word Select (LRC)
-        .data_out_num = I2S_PIN_NO_CHANGE,
-        .data_in_num = MIC_I2S_SD     // Serial Data (DOUT)
-    };
-    
-    // Install and start I2S driver
-    esp_err_t ret = i2s_driver_install(I2S_NUM, &i2s_config, 0, NULL);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to install I2S driver: %s", esp_err_to_name(ret));
+    if (audio_capture_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Audio capture init failed");
         return;
     }
-    
-    ret = i2s_set_pin(I2S_NUM, &pin_config);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set I2S pins: %s", esp_err_to_name(ret));
+
+    s_collect_lock = xSemaphoreCreateMutex();
+
+    vad_config_t vad_cfg;
+    vad_config_default(&vad_cfg, I2S_SAMPLE_RATE);
+    vad_init(&s_vad, &vad_cfg);
+
+    s_record_buffer_cap = record_buffer_size(&vad_cfg);
+    s_record_buffer = (uint8_t *)psram_malloc(s_record_buffer_cap);
+    if (!s_record_buffer || !s_collect_lock) {
+        ESP_LOGE(TAG, "Failed to allocate recording buffer");
+        s_record_buffer_cap = 0;
         return;
     }
-    
-    // Clear I2S buffers
-    i2s_zero_dma_buffer(I2S_NUM);
-    
-    ESP_LOGI(TAG, "I2S initialized successfully");
-    ESP_LOGI(TAG, "Sample rate: %d Hz, Channels: %d, Bits: %d", 
-             I2S_SAMPLE_RATE, I2S_CHANNELS, I2S_BITS_PER_SAMPLE);
+
+    ESP_LOGI(TAG, "Speech-to-text initialized");
 }
 
 void speech_to_text_start(void) {
@@ -119,28 +195,70 @@ void speech_to_text_start(void) {
         ESP_LOGW(TAG, "Already recording!");
         return;
     }
-    
-    ESP_LOGI(TAG, "Starting speech recording...");
-    
-    // Allocate recording buffer
-    if (s_record_buffer) {
-        free(s_record_buffer);
+
+    if (s_buffer_borrowed) {
+        ESP_LOGW(TAG, "Previous recording is still being processed");
+        return;
     }
-    
-    s_record_buffer = (uint8_t *)malloc(RECORD_BUFFER_SIZE + WAV_HEADER_SIZE);
+
     if (!s_record_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate recording buffer");
+        ESP_LOGE(TAG, "Recording buffer not allocated");
         return;
     }
-    
+
+    ESP_LOGI(TAG, "Starting speech recording...");
+
+    // While listening, start the recording from the audio already in the
+    // ring so the first syllable is kept. The reader is simply placed
+    // behind the write position; nothing is copied.
+    audio_ring_t *ring = audio_capture_get_ring();
+    size_t history = 0;
+    if (audio_capture_is_running()) {
+        history = (size_t)s_preroll_ms * I2S_SAMPLE_RATE / 1000;
+    }
+    s_reader = audio_ring_reader_open_at(ring, history);
+    if (s_reader < 0) {
+        ESP_LOGE(TAG, "No free capture ring reader");
+        return;
+    }
+    size_t preroll = audio_ring_available(ring, s_reader);
+    if (preroll > 0) {
+        ESP_LOGI(TAG, "Pre-roll: %d ms", (int)(preroll * 1000 / I2S_SAMPLE_RATE));
+    }
+
     s_record_buffer_pos = WAV_HEADER_SIZE; // Skip header space
+    s_vad_pos = WAV_HEADER_SIZE;
+    s_speech_done = false;
+    vad_reset(&s_vad);
     s_is_recording = true;
-    
-    // Start I2S
-    i2s_start(I2S_NUM);
-    i2s_zero_dma_buffer(I2S_NUM);
-    
-    ESP_LOGI(TAG, "Recording started for %d seconds", RECORD_TIME_SECONDS);
+
+    // Stream to the upload endpoint while recording, if one is configured.
+    // Sizes are unknown up front, so WAV headers carry the streaming
+    // placeholder 0xFFFFFFFF. Not in voice mode: the recording goes to
+    // Gemini itself and the upload's transcript would never be read.
+    s_streaming = false;
+    if (s_upload_url[0] != '\0' && !gemini_client_is_voice_mode()) {
+        static audio_encoder_t encoder;
+        uint8_t stream_header[AUDIO_CODEC_MAX_HEADER];
+        size_t header_len;
+        audio_codec_wav_format_t fmt;
+
+        audio_encoder_init(&encoder, s_upload_codec, I2S_SAMPLE_RATE);
+        if (audio_codec_wav_format(s_upload_codec, I2S_SAMPLE_RATE, &fmt)) {
+            header_len = write_wav_header(stream_header, &fmt, 0xFFFFFFFF);
+        } else {
+            header_len = audio_encoder_header(&encoder, stream_header, sizeof(stream_header));
+        }
+        s_streaming = audio_uploader_begin(s_upload_url, ring, preroll, &encoder,
+                                           stream_header, header_len,
+                                           audio_codec_mime(s_upload_codec)) == ESP_OK;
+    }
+
+    // Start I2S (already running while listening)
+    audio_ring_reset_stats(ring);
+    audio_capture_start();
+
+    ESP_LOGI(TAG, "Recording started");
 }
 
 void speech_to_text_stop(uint8_t **out_buf, size_t *out_len) {
@@ -150,23 +268,39 @@ void speech_to_text_stop(uint8_t **out_buf, size_t *out_len) {
         if (out_len) *out_len = 0;
         return;
     }
-    
+
     s_is_recording = false;
-    
-    // Stop I2S
-    i2s_stop(I2S_NUM);
-    
-    ESP_LOGI(TAG, "Recording stopped. Recorded %d bytes", s_record_buffer_pos - WAV_HEADER_SIZE);
-    
+
+    // Stop I2S (unless listening) and pick up the frames still in the ring
+    audio_capture_stop();
+    collect_available();
+    audio_ring_reader_close(audio_capture_get_ring(), s_reader);
+    s_reader = -1;
+    if (s_streaming && gemini_client_is_voice_mode()) {
+        // Voice mode was switched on while recording: nobody will wait for
+        // the upload, and it would hold up the next one
+        audio_uploader_abort();
+        s_streaming = false;
+    } else if (s_streaming) {
+        audio_uploader_finish();
+    }
+    trim_silence();
+
+    audio_ring_stats_t stats;
+    audio_ring_get_stats(audio_capture_get_ring(), &stats);
+    ESP_LOGI(TAG, "Recording stopped. Recorded %d bytes (overruns: %u, dropped: %u)",
+             (int)(s_record_buffer_pos - WAV_HEADER_SIZE),
+             (unsigned)stats.overruns, (unsigned)stats.dropped);
+
     if (s_record_buffer && s_record_buffer_pos > WAV_HEADER_SIZE) {
-        // Create WAV header
-        wav_header_t wav_header;
-        create_wav_header(&wav_header, s_record_buffer_pos - WAV_HEADER_SIZE);
-        memcpy(s_record_buffer, &wav_header, WAV_HEADER_SIZE);
-        
+        // The local copy is always PCM16, which fills the reserved 44 bytes exactly
+        audio_codec_wav_format_t fmt;
+        audio_codec_wav_format(AUDIO_CODEC_PCM16, I2S_SAMPLE_RATE, &fmt);
+        write_wav_header(s_record_buffer, &fmt, s_record_buffer_pos - WAV_HEADER_SIZE);
+
         if (out_buf) {
             *out_buf = s_record_buffer;
-            s_record_buffer = NULL; // Transfer ownership
+            s_buffer_borrowed = true; // Lend until speech_to_text_release_buffer()
         }
         if (out_len) {
             *out_len = s_record_buffer_pos;
@@ -175,16 +309,79 @@ void speech_to_text_stop(uint8_t **out_buf, size_t *out_len) {
         ESP_LOGW(TAG, "No audio data recorded");
         if (out_buf) *out_buf = NULL;
         if (out_len) *out_len = 0;
-        
-        if (s_record_buffer) {
-            free(s_record_buffer);
-            s_record_buffer = NULL;
-        }
     }
-    
+
     s_record_buffer_pos = 0;
 }
 
+bool speech_to_text_update(void) {
+    if (!s_is_recording) {
+        return true;
+    }
+    collect_available();
+    return s_speech_done;
+}
+
+void speech_to_text_set_vad_config(const vad_config_t *cfg) {
+    if (!cfg || s_is_recording || s_buffer_borrowed) {
+        ESP_LOGW(TAG, "VAD config can only be changed while idle");
+        return;
+    }
+    // A longer max_frames needs a larger record buffer, resized here rather
+    // than while recording
+    size_t cap = record_buffer_size(cfg);
+    if (cap > s_record_buffer_cap) {
+        uint8_t *grown = (uint8_t *)psram_realloc(s_record_buffer, cap);
+        if (!grown) {
+            ESP_LOGE(TAG, "No memory for %d byte recordings", (int)cap);
+            return;
+        }
+        s_record_buffer = grown;
+        s_record_buffer_cap = cap;
+    }
+    vad_init(&s_vad, cfg);
+}
+
+void speech_to_text_set_upload_url(const char *url) {
+    if (!url) {
+        s_upload_url[0] = '\0';
+        return;
+    }
+    strncpy(s_upload_url, url, sizeof(s_upload_url) - 1);
+    s_upload_url[sizeof(s_upload_url) - 1] = '\0';
+}
+
+void speech_to_text_set_listening(bool listening) {
+    audio_capture_set_listening(listening);
+    if (!listening && !s_is_recording) {
+        audio_capture_stop();
+    }
+}
+
+void speech_to_text_set_preroll_ms(uint32_t ms) {
+    size_t max_ms = audio_ring_capacity(audio_capture_get_ring()) / 2 * 1000 / I2S_SAMPLE_RATE;
+    if (ms > max_ms) {
+        ESP_LOGW(TAG, "Pre-roll limited to %d ms", (int)max_ms);
+        ms = (uint32_t)max_ms;
+    }
+    s_preroll_ms = ms;
+}
+
+void speech_to_text_set_upload_codec(audio_codec_id_t codec) {
+    if (codec < 0 || codec >= AUDIO_CODEC_COUNT || s_is_recording) {
+        ESP_LOGW(TAG, "Upload codec can only be changed while idle");
+        return;
+    }
+    s_upload_codec = codec;
+    ESP_LOGI(TAG, "Upload codec: %s", audio_codec_name(codec));
+}
+
+void speech_to_text_release_buffer(uint8_t *buf) {
+    if (buf && buf == s_record_buffer) {
+        s_buffer_borrowed = false;
+    }
+}
+
 char* speech_to_text_process(const uint8_t *buf, size_t len) {
     if (!buf || len == 0) {
         ESP_LOGE(TAG, "Invalid audio buffer");
@@ -196,6 +393,17 @@ char* speech_to_text_process(const uint8_t *buf, size_t len) {
         return strdup("Error: WiFi not connected");
     }
     
+    // Most of the audio is already on the server when streaming; only the
+    // tail and the response are left to wait for
+    if (s_streaming) {
+        s_streaming = false;
+        char *text = audio_uploader_wait_result(UPLOAD_RESULT_TIMEOUT_MS);
+        if (text) {
+            return text;
+        }
+        ESP_LOGW(TAG, "Streaming upload failed, falling back to local processing");
+    }
+
     ESP_LOGI(TAG, "Processing audio buffer (%d bytes) with speech-to-text...", len);
     
     // For now, return a placeholder response
@@ -235,39 +443,9 @@ bool speech_to_text_is_recording(void) {
 void speech_to_text_task(void *pvParameters) {
     ESP_LOGI(TAG, "Speech-to-text recording task started");
     
-    const TickType_t record_duration = pdMS_TO_TICKS(RECORD_TIME_SECONDS * 1000);
-    TickType_t start_time = xTaskGetTickCount();
-    
-    uint8_t *i2s_read_buffer = (uint8_t *)malloc(I2S_DMA_BUF_LEN * 4);
-    if (!i2s_read_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate I2S read buffer");
-        goto cleanup;
-    }
-    
-    while (s_is_recording && (xTaskGetTickCount() - start_time) < record_duration) {
-        size_t bytes_read = 0;
-        esp_err_t ret = i2s_read(I2S_NUM, i2s_read_buffer, I2S_DMA_BUF_LEN * 4, &bytes_read, pdMS_TO_TICKS(100));
-        
-        if (ret == ESP_OK && bytes_read > 0) {
-            // Convert 32-bit samples to 16-bit
-            int32_t *samples_32 = (int32_t *)i2s_read_buffer;
-            int16_t *samples_16 = (int16_t *)(s_record_buffer + s_record_buffer_pos);
-            
-            size_t samples_count = bytes_read / 4;
-            for (size_t i = 0; i < samples_count && s_record_buffer_pos < RECORD_BUFFER_SIZE + WAV_HEADER_SIZE - 2; i++) {
-                // Convert 32-bit to 16-bit by taking upper 16 bits and scaling
-                samples_16[i] = (int16_t)(samples_32[i] >> 16);
-                s_record_buffer_pos += 2;
-            }
-        }
-        
-        // Small delay to prevent watchdog timeout
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-    
-cleanup:
-    if (i2s_read_buffer) {
-        free(i2s_read_buffer);
+    // Drain the capture ring until the VAD reports end of speech
+    while (!speech_to_text_update()) {
+        vTaskDelay(pdMS_TO_TICKS(COLLECT_INTERVAL_MS));
     }
     
     // Stop recording and process audio
@@ -276,10 +454,25 @@ cleanup:
     
     speech_to_text_stop(&audio_buffer, &audio_len);
     
-    if (audio_buffer && audio_len > 0) {
+    if (audio_buffer && audio_len > 0 && gemini_client_is_voice_mode()) {
+        chat_screen_append_txt(TAG, "🎤 Asking Gemini...");
+
+        char *transcript = NULL;
+        char *gemini_response = gemini_client_request_audio(audio_buffer, audio_len, &transcript);
+        speech_to_text_release_buffer(audio_buffer);
+        if (transcript) {
+            chat_screen_append_txt("You", "%s", transcript);
+            free(transcript);
+        }
+        if (gemini_response) {
+            chat_screen_append_txt("Gemini", "%s", gemini_response);
+            free(gemini_response);
+        }
+    } else if (audio_buffer && audio_len > 0) {
         chat_screen_append_txt(TAG, "🎤 Processing audio...");
         
         char *transcribed_text = speech_to_text_process(audio_buffer, audio_len);
+        speech_to_text_release_buffer(audio_buffer);
         if (transcribed_text) {
             chat_screen_append_txt("You", "%s", transcribed_text);
             
@@ -292,8 +485,6 @@ cleanup:
             
             free(transcribed_text);
         }
-        
-        free(audio_buffer);
     } else {
         chat_screen_append_txt(TAG, "❌ No audio recorded");
     }
@@ -302,4 +493,4 @@ cleanup:
     ESP_LOGI(TAG, "Recording task completed");
     
     vTaskDelete(NULL);
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #define SPEECH_TO_TEXT_H
 
 #include "esp_err.h"
+#include "vad.h"
+#include "audio_codec.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -12,7 +14,54 @@ extern "C" {
 
 void speech_to_text_init(void);
 void speech_to_text_start(void);
+/**
+ * @brief Stop recording and return the captured audio as a WAV buffer.
+ *
+ * The buffer is owned by the speech-to-text module and is reused for the next
+ * recording; hand it back with speech_to_text_release_buffer() instead of
+ * free() once it has been processed.
+ */
 void speech_to_text_stop(uint8_t **out_buf, size_t *out_len);
+void speech_to_text_release_buffer(uint8_t *buf);
+
+/**
+ * @brief Drain captured audio and run end-of-speech detection.
+ *        Call periodically while recording.
+ * @return true once recording should stop (end of speech, no speech within
+ *         the timeout, maximum length reached, or not recording)
+ */
+bool speech_to_text_update(void);
+
+/**
+ * @brief Stream audio to url with HTTP chunked transfer while recording.
+ *        The response body is used as the transcript. NULL or "" disables
+ *        streaming and audio is processed after capture ends.
+ */
+void speech_to_text_set_upload_url(const char *url);
+
+/**
+ * @brief Select how streamed audio is encoded (default PCM16 WAV).
+ *        Only allowed while idle; the local WAV buffer stays PCM16.
+ */
+void speech_to_text_set_upload_codec(audio_codec_id_t codec);
+
+/**
+ * @brief Keep the microphone running between recordings. Each recording
+ *        then starts with up to the pre-roll length of audio captured
+ *        before speech_to_text_start() was called.
+ */
+void speech_to_text_set_listening(bool listening);
+
+/**
+ * @brief Pre-roll length used while listening (default 500 ms, 0 disables).
+ *        Limited to half the capture ring.
+ */
+void speech_to_text_set_preroll_ms(uint32_t ms);
+
+/**
+ * @brief Tune the voice activity detector. Only allowed while idle.
+ */
+void speech_to_text_set_vad_config(const vad_config_t *cfg);
 char* speech_to_text_process(const uint8_t *buf, size_t len);
 bool speech_to_text_is_recording(void);
 void speech_to_text_task(void *pvParameters);
@@ -0,0 +1,135 @@
+// src/sse_parser.cpp - Incremental text/event-stream parser
+
+#include "sse_parser.h"
+#include <string.h>
+
+enum {
+    ST_FIELD = 0,       // Reading the field name at the start of a line
+    ST_DATA_START,      // After "data:", an optional space
+    ST_DATA,
+    ST_EVENT_START,
+    ST_EVENT,
+    ST_IGNORE,          // Comment or unknown field: skip to the end of the line
+};
+
+static bool field_is(const sse_parser_t *p, const char *name) {
+    size_t n = strlen(name);
+    return p->field_len == n && memcmp(p->field, name, n) == 0;
+}
+
+static void append_data(sse_parser_t *p, char c) {
+    if (p->overflow) return;
+    if (p->len + 1 >= p->cap) {
+        p->overflow = true;
+        return;
+    }
+    p->data[p->len++] = c;
+}
+
+// Each data line after the first starts with the '\n' that joins them
+static void begin_data_line(sse_parser_t *p) {
+    if (p->has_data) append_data(p, '\n');
+    p->has_data = true;
+}
+
+static void dispatch(sse_parser_t *p) {
+    if (p->has_data) {
+        if (p->overflow) {
+            p->dropped++;
+        } else {
+            p->data[p->len] = '\0';
+            p->event[p->event_len] = '\0';
+            p->events++;
+            p->on_event(p->ctx, p->event, p->data, p->len);
+        }
+    }
+    p->len = 0;
+    p->has_data = false;
+    p->overflow = false;
+    p->event_len = 0;
+}
+
+static void end_line(sse_parser_t *p) {
+    if (p->state == ST_FIELD) {
+        if (p->field_len == 0) {
+            dispatch(p);
+        } else if (field_is(p, "data")) {
+            // "data" without a colon is an empty data line
+            begin_data_line(p);
+        }
+    }
+    p->state = ST_FIELD;
+    p->field_len = 0;
+}
+
+extern "C" {
+
+void sse_parser_init(sse_parser_t *p, char *buf, size_t cap, sse_event_fn on_event, void *ctx) {
+    memset(p, 0, sizeof(*p));
+    p->data = buf;
+    p->cap = cap;
+    p->on_event = on_event;
+    p->ctx = ctx;
+}
+
+void sse_parser_reset(sse_parser_t *p) {
+    p->len = 0;
+    p->field_len = 0;
+    p->state = ST_FIELD;
+    p->last_cr = false;
+    p->has_data = false;
+    p->overflow = false;
+    p->event_len = 0;
+}
+
+void sse_parser_feed(sse_parser_t *p, const char *bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = bytes[i];
+        if (p->last_cr) {
+            p->last_cr = false;
+            if (c == '\n') continue;
+        }
+        if (c == '\r' || c == '\n') {
+            p->last_cr = c == '\r';
+            end_line(p);
+            continue;
+        }
+
+        switch (p->state) {
+        case ST_FIELD:
+            if (c != ':') {
+                // Longer names than the buffer can never match a known field
+                if (p->field_len < sizeof(p->field)) p->field[p->field_len] = c;
+                if (p->field_len < 0xFF) p->field_len++;
+            } else if (field_is(p, "data")) {
+                begin_data_line(p);
+                p->state = ST_DATA_START;
+            } else if (field_is(p, "event")) {
+                p->event_len = 0;
+                p->state = ST_EVENT_START;
+            } else {
+                p->state = ST_IGNORE;
+            }
+            break;
+        case ST_DATA_START:
+            p->state = ST_DATA;
+            if (c == ' ') break;
+            append_data(p, c);
+            break;
+        case ST_DATA:
+            append_data(p, c);
+            break;
+        case ST_EVENT_START:
+            p->state = ST_EVENT;
+            if (c == ' ') break;
+            // fall through
+        case ST_EVENT:
+            if (p->event_len + 1 < SSE_EVENT_NAME_MAX) p->event[p->event_len++] = c;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+} // extern "C"
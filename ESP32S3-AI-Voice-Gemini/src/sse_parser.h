@@ -0,0 +1,66 @@
+#ifndef SSE_PARSER_H
+#define SSE_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Incremental parser for server-sent events (text/event-stream).
+ *
+ * Bytes are fed as they come off the connection, split anywhere. Each
+ * event's data lines are collected into a caller-provided buffer, joined
+ * with '\n', and the event is handed over at the blank line that ends it.
+ * LF, CR and CRLF line ends are accepted; comments and fields other than
+ * "data" and "event" are skipped. An event too long for the buffer is
+ * dropped and counted.
+ *
+ * No platform dependency.
+ */
+
+#define SSE_EVENT_NAME_MAX  32
+
+/**
+ * One complete event. data is NUL-terminated and may be modified in place
+ * until the callback returns.
+ */
+typedef void (*sse_event_fn)(void *ctx, const char *event, char *data, size_t len);
+
+typedef struct {
+    sse_event_fn on_event;
+    void *ctx;
+    char *data;
+    size_t cap;
+    size_t len;
+    char field[8];                  // Field name of the current line, cut
+    uint8_t field_len;
+    uint8_t state;
+    bool last_cr;                   // Swallow the LF of a CRLF
+    bool has_data;                  // A data line was seen in this event
+    bool overflow;                  // This event did not fit
+    char event[SSE_EVENT_NAME_MAX];
+    uint8_t event_len;
+    uint32_t events;                // Delivered
+    uint32_t dropped;               // Too long for the buffer
+} sse_parser_t;
+
+/**
+ * @param buf Holds the data of one event; cap includes the terminator
+ */
+void sse_parser_init(sse_parser_t *p, char *buf, size_t cap, sse_event_fn on_event, void *ctx);
+
+void sse_parser_feed(sse_parser_t *p, const char *bytes, size_t len);
+
+/**
+ * @brief Forget any partial event, e.g. before the next stream.
+ */
+void sse_parser_reset(sse_parser_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // SSE_PARSER_H
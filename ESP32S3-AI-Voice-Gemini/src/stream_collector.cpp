@@ -0,0 +1,112 @@
+// src/stream_collector.cpp - Streamed answers and voice transcripts
+
+#include "stream_collector.h"
+#include "psram_alloc.h"
+#include <string.h>
+
+static bool cancelled(const stream_collector_t *c) {
+    return c->cancel && *c->cancel;
+}
+
+static void collect_answer(stream_collector_t *c, const char *text, size_t len) {
+    if (c->len == 0) {
+        // The line break after the transcript, or a leading space
+        while (len > 0 && (*text == '\n' || *text == '\r' || *text == ' ')) {
+            text++;
+            len--;
+        }
+        if (len == 0) return;
+    }
+    if (c->len + len + 1 > c->cap) {
+        size_t cap = c->cap ? c->cap * 2 : 512;
+        while (cap < c->len + len + 1) cap *= 2;
+        char *p = (char *)psram_realloc(c->answer, cap);
+        if (p) {
+            c->answer = p;
+            c->cap = cap;
+        }
+    }
+    if (c->len + len + 1 <= c->cap) {
+        memcpy(c->answer + c->len, text, len);
+        c->len += len;
+        c->answer[c->len] = '\0';
+    } else {
+        c->lost = true;
+    }
+    if (c->on_text && !cancelled(c)) c->on_text(c->ctx, text, len);
+}
+
+// The first line is done: drop the "Q:" label and hand it over
+static void end_transcript(stream_collector_t *c) {
+    c->in_answer = true;
+    c->transcript[c->transcript_len] = '\0';
+    char *t = c->transcript;
+    while (*t == ' ' || *t == '*') t++;
+    if (strncmp(t, "Q:", 2) == 0) t += 2;
+    while (*t == ' ' || *t == '*') t++;
+    size_t n = strlen(t);
+    while (n > 0 && (t[n - 1] == ' ' || t[n - 1] == '\r' || t[n - 1] == '*')) n--;
+    memmove(c->transcript, t, n);
+    c->transcript[n] = '\0';
+    c->transcript_len = n;
+    if (n > 0 && c->on_transcript && !cancelled(c)) c->on_transcript(c->ctx, c->transcript);
+}
+
+extern "C" {
+
+void stream_collector_init(stream_collector_t *c, bool voice) {
+    memset(c, 0, sizeof(*c));
+    c->voice = voice;
+    c->in_answer = !voice;
+}
+
+void stream_collector_feed(void *ctx, const char *text, size_t len) {
+    stream_collector_t *c = (stream_collector_t *)ctx;
+    if (c->voice && !c->in_answer) {
+        const char *nl = (const char *)memchr(text, '\n', len);
+        size_t head = nl ? (size_t)(nl - text) : len;
+        if (c->transcript_len + head >= sizeof(c->transcript)) {
+            // No transcript line after all: it is all answer
+            c->in_answer = true;
+            c->transcript[c->transcript_len] = '\0';
+            collect_answer(c, c->transcript, c->transcript_len);
+            c->transcript_len = 0;
+            c->transcript[0] = '\0';
+            collect_answer(c, text, len);
+            return;
+        }
+        memcpy(c->transcript + c->transcript_len, text, head);
+        c->transcript_len += head;
+        if (!nl) return;
+        end_transcript(c);
+        text = nl + 1;
+        len -= head + 1;
+        if (len == 0) return;
+    }
+    collect_answer(c, text, len);
+}
+
+char *stream_collector_finish(stream_collector_t *c) {
+    if (c->voice && !c->in_answer && c->transcript_len > 0) {
+        // A single line: the transcript alone if labelled, else the answer
+        c->transcript[c->transcript_len] = '\0';
+        if (strstr(c->transcript, "Q:")) {
+            end_transcript(c);
+        } else {
+            c->in_answer = true;
+            collect_answer(c, c->transcript, c->transcript_len);
+            c->transcript_len = 0;
+            c->transcript[0] = '\0';
+        }
+    }
+    char *answer = c->answer;
+    if (c->len == 0) {
+        free(answer);
+        answer = NULL;
+    }
+    c->answer = NULL;
+    c->len = c->cap = 0;
+    return answer;
+}
+
+} // extern "C"
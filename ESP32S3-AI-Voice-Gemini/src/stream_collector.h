@@ -0,0 +1,64 @@
+#ifndef STREAM_COLLECTOR_H
+#define STREAM_COLLECTOR_H
+
+#include "gemini_stream.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A streamed answer, kept whole for the caller while each piece is passed
+ * on. Fed by gemini_stream_run() through stream_collector_feed().
+ *
+ * For a voice query (voice_query_body with VOICE_QUERY_STREAM) the first
+ * line is what the speaker said: it is held back until complete, its "Q:"
+ * label dropped, and handed to on_transcript before any answer text. A
+ * first line too long to be a transcript, or a reply of one unlabelled
+ * line, is taken as all answer. Leading blank space of the answer is
+ * dropped.
+ *
+ * No platform dependency.
+ */
+
+#define STREAM_COLLECTOR_TRANSCRIPT_MAX 512
+
+typedef struct {
+    void (*on_transcript)(void *ctx, const char *text);     // May be NULL
+    gemini_text_fn on_text;         // Next piece of the answer; may be NULL
+    void *ctx;
+    const volatile bool *cancel;    // Nothing is passed on once set; may be NULL
+
+    bool voice;
+    bool in_answer;                 // Past the transcript line
+    size_t transcript_len;
+    char transcript[STREAM_COLLECTOR_TRANSCRIPT_MAX];
+    char *answer;                   // The answer so far, NUL-terminated
+    size_t len;
+    size_t cap;
+    bool lost;                      // Out of memory: a piece is missing
+} stream_collector_t;
+
+/**
+ * @brief Start collecting. Set the callbacks and cancel after this.
+ * @param voice The first line is the transcript
+ */
+void stream_collector_init(stream_collector_t *c, bool voice);
+
+/**
+ * @brief The next piece of the reply; a gemini_text_fn with c as ctx.
+ */
+void stream_collector_feed(void *ctx, const char *text, size_t len);
+
+/**
+ * @brief The reply has ended: settle a first line still held back.
+ * @return The answer (caller frees), or NULL if there was none
+ */
+char *stream_collector_finish(stream_collector_t *c);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // STREAM_COLLECTOR_H
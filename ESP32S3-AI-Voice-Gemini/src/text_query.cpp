@@ -0,0 +1,25 @@
+// src/text_query.cpp - Text query request bodies
+
+#include "text_query.h"
+#include <string.h>
+
+// The user turn around the escaped input
+static constexpr char TEXT_TURN_OPEN[] = "{\"role\":\"user\",\"parts\":[{\"text\":\"";
+static constexpr char TEXT_QUERY_TAIL[] =
+    "\"}]}],\"generationConfig\":{\"maxOutputTokens\":100,\"temperature\":0.7}}";
+
+static size_t read_history(void *ctx, size_t offset, char *buf, size_t cap) {
+    return conversation_read_prefix((const conversation_t *)ctx, offset, buf, cap);
+}
+
+extern "C" {
+
+void text_query_body(request_writer_t *w, const conversation_t *history, const char *input) {
+    request_writer_init(w);
+    request_writer_part(w, read_history, (void *)history, conversation_prefix_size(history));
+    REQUEST_WRITER_LITERAL(w, TEXT_TURN_OPEN);
+    request_writer_escaped(w, input, strlen(input));
+    REQUEST_WRITER_LITERAL(w, TEXT_QUERY_TAIL);
+}
+
+} // extern "C"
@@ -0,0 +1,28 @@
+#ifndef TEXT_QUERY_H
+#define TEXT_QUERY_H
+
+#include "request_writer.h"
+#include "conversation.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Text queries: the typed or transcribed question as the user turn of a
+ * generateContent or streamGenerateContent request, after the
+ * conversation so far. The same body serves both endpoints.
+ *
+ * No platform dependency.
+ */
+
+/**
+ * @brief Set up w to write the request body. Nothing is copied: history
+ *        and input must not change until the request is sent.
+ */
+void text_query_body(request_writer_t *w, const conversation_t *history, const char *input);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // TEXT_QUERY_H
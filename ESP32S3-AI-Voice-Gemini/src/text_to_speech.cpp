@@ -1,7 +1,9 @@
 #include "text_to_speech.h"
 #include "ui_manager.h"
+#include "audio_hal.h"
 #include <Audio.h>
 #include <Arduino.h>
+#include <freertos/queue.h>
 
 static const char *TAG = "TTS";
 
@@ -10,17 +12,78 @@ static const char *TAG = "TTS";
 #define I2S_BCLK 42
 #define I2S_LRC  2
 
+// Speaker samples collected before they are handed to the echo reference
+#define TTS_REF_BLOCK 32
+
+// Sentences waiting to be spoken after the current one
+#define TTS_QUEUE_LEN 16
+
 // Biến toàn cục
 Audio audio;
 static bool is_initialized = false;
 static bool is_speaking = false;
 static TaskHandle_t audio_task_handle = NULL;
+static audio_sink_t *speaker = NULL;
+static int16_t ref_block[TTS_REF_BLOCK];
+static size_t ref_fill = 0;
+static QueueHandle_t speech_queue = NULL;     // char *, strdup'd
+static volatile bool speech_starting = false;  // Taken off the queue, not yet playing
+
+// Text as the TTS request can take it
+static String clean_text(const char *text) {
+    String cleanText = String(text);
+    cleanText.trim();
+    
+    // Remove problematic characters
+    cleanText.replace("\"", "");
+    cleanText.replace("\\", "");
+    cleanText.replace("\n", " ");
+    cleanText.replace("\r", "");
+    return cleanText;
+}
+
+static void drop_queued(void) {
+    char *text;
+    while (speech_queue && xQueueReceive(speech_queue, &text, 0) == pdTRUE) {
+        free(text);
+    }
+}
+
+// Audio task: start the next queued sentence once the last one has ended
+static void start_next_queued(void) {
+    if (!speech_queue || uxQueueMessagesWaiting(speech_queue) == 0 || audio.isRunning()) return;
+    char *text;
+    speech_starting = true;
+    if (xQueueReceive(speech_queue, &text, 0) == pdTRUE) {
+        String cleanText = clean_text(text);
+        free(text);
+        if (cleanText.length() > 0) {
+            logi(TAG, "Playing queued TTS: %.50s", cleanText.c_str());
+            is_speaking = audio.connecttospeech(cleanText.c_str(), "vi");
+        }
+    }
+    speech_starting = false;
+}
+
+// Audio library hook, called on the audio task for every sample right
+// before it is written to I2S. The output is mono (forceMono), so the left
+// channel is what the speaker plays; playing it through the speaker sink
+// also makes it the echo canceller's reference.
+void audio_process_i2s(uint32_t *sample, bool *continueI2S) {
+    ref_block[ref_fill++] = (int16_t)(*sample & 0xFFFF);
+    if (ref_fill == TTS_REF_BLOCK) {
+        audio_hal_play(speaker, ref_block, ref_fill, audio.getSampleRate());
+        ref_fill = 0;
+    }
+    *continueI2S = true;
+}
 
 // ✅ NEW: Audio task with minimal delay for smooth streaming
 void audio_task(void *parameter) {
     while (true) {
         if (is_initialized) {
             audio.loop();
+            start_next_queued();
         }
         vTaskDelay(pdMS_TO_TICKS(1)); // Minimal 1ms delay for streaming
     }
@@ -49,6 +112,8 @@ void text_to_speech_init(void) {
     audio.setConnectionTimeout(10000, 8000);  // Longer timeouts
     audio.forceMono(true);  // Force mono for better performance
     audio.setTone(0, 0, 0); // Disable tone processing
+    speaker = audio_sink_speaker_create();
+    speech_queue = xQueueCreate(TTS_QUEUE_LEN, sizeof(char *));
     
     is_initialized = true;
     is_speaking = false;
@@ -83,6 +148,8 @@ void text_to_speech_play(const char *text) {
         return;
     }
     
+    drop_queued();
+    
     // ✅ FIX 6: Proper audio stop and wait
     if (is_speaking) {
         logw(TAG, "Stopping previous TTS");
@@ -107,14 +174,7 @@ void text_to_speech_play(const char *text) {
     logi(TAG, "Playing TTS: %.50s%s", text, strlen(text) > 50 ? "..." : "");
     
     // ✅ FIX 7: Split long text into shorter chunks
-    String cleanText = String(text);
-    cleanText.trim();
-    
-    // Remove problematic characters
-    cleanText.replace("\"", "");
-    cleanText.replace("\\", "");
-    cleanText.replace("\n", " ");
-    cleanText.replace("\r", "");
+    String cleanText = clean_text(text);
     
     // ✅ CRITICAL: Limit to SHORT sentences for stability
     // if (cleanText.length() > 50) {
@@ -148,6 +208,18 @@ void text_to_speech_play(const char *text) {
     }
 }
 
+void text_to_speech_enqueue(const char *text) {
+    if (!is_initialized || !speech_queue || !text || text[0] == '\0') {
+        return;
+    }
+    char *copy = strdup(text);
+    if (!copy) return;
+    if (xQueueSend(speech_queue, &copy, 0) != pdTRUE) {
+        logw(TAG, "TTS queue full, dropping: %.30s", text);
+        free(copy);
+    }
+}
+
 // ✅ FIX 9: Simplified loop - audio task handles the heavy lifting
 void text_to_speech_loop(void) {
     if (!is_initialized) return;
@@ -167,10 +239,11 @@ bool text_to_speech_is_playing(void) {
         is_speaking = false;
     }
     
-    return is_speaking;
+    return is_speaking || speech_starting || uxQueueMessagesWaiting(speech_queue) > 0;
 }
 
 void text_to_speech_stop(void) {
+    drop_queued();
     if (is_speaking) {
         logi(TAG, "Stopping TTS playback");
         audio.stopSong();
@@ -18,6 +18,14 @@ void text_to_speech_init(void);
  */
 void text_to_speech_play(const char *text);
 
+/**
+ * @brief Queue text to be spoken after everything already playing or
+ *        queued, e.g. the sentences of an answer as it is streamed in.
+ *        The first one starts at once when nothing is playing.
+ * @param text Copied; dropped if the queue is full
+ */
+void text_to_speech_enqueue(const char *text);
+
 /**
  * @brief Loop function to maintain audio processing
  * Must be called regularly in main loop
@@ -31,7 +39,7 @@ void text_to_speech_loop(void);
 bool text_to_speech_is_playing(void);
 
 /**
- * @brief Stop current TTS playback
+ * @brief Stop current TTS playback and drop anything queued
  */
 void text_to_speech_stop(void);
 
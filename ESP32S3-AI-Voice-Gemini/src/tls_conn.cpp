@@ -0,0 +1,200 @@
+// src/tls_conn.cpp - Keep-alive connection manager with session resumption
+
+#include "tls_conn.h"
+#include <new>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <chrono>
+#endif
+
+#define TLS_CONN_HOST_MAX   96
+
+struct tls_conn {
+    tls_transport_t *transport;
+    char host[TLS_CONN_HOST_MAX];
+    uint16_t port;
+    tls_conn_config_t cfg;
+
+    bool open;
+    bool in_use;
+    bool have_session;          // A connection has completed since the last forget
+    uint32_t conn_requests;     // Requests on the open connection
+    uint32_t idle_since_ms;
+
+    tls_conn_stats_t stats;
+};
+
+static uint32_t now_ms(const tls_conn_t *conn) {
+    if (conn->cfg.now_ms) {
+        return conn->cfg.now_ms(conn->cfg.clock_ctx);
+    }
+#ifdef ESP_PLATFORM
+    return (uint32_t)(esp_timer_get_time() / 1000);
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void close_open(tls_conn_t *conn) {
+    if (conn->open) {
+        conn->transport->ops->close(conn->transport);
+        conn->open = false;
+    }
+    conn->conn_requests = 0;
+}
+
+// Open a new connection, resumed if a session is saved. A server that
+// refuses the session falls back to a full handshake by itself; a resumed
+// connect that fails outright is retried once without it.
+static bool reconnect(tls_conn_t *conn) {
+    tls_transport_t *t = conn->transport;
+    bool resume = conn->cfg.resume && conn->have_session;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint32_t t0 = now_ms(conn);
+        tls_connect_result_t r = t->ops->connect(t, conn->host, conn->port, resume,
+                                                 conn->cfg.connect_timeout_ms);
+        uint32_t ms = now_ms(conn) - t0;
+        if (r == TLS_CONNECT_RESUMED) {
+            conn->stats.resumed_handshakes++;
+            conn->stats.resumed_ms_total += ms;
+        } else if (r == TLS_CONNECT_FULL) {
+            conn->stats.full_handshakes++;
+            conn->stats.full_ms_total += ms;
+        } else {
+            conn->stats.connect_failures++;
+            if (resume) {
+                t->ops->forget_session(t);
+                conn->have_session = false;
+                resume = false;
+                continue;
+            }
+            return false;
+        }
+        conn->open = true;
+        conn->have_session = true;
+        conn->conn_requests = 0;
+        return true;
+    }
+    return false;
+}
+
+extern "C" {
+
+void tls_conn_default_config(tls_conn_config_t *cfg) {
+    if (!cfg) return;
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->idle_timeout_ms = 60000;
+    cfg->connect_timeout_ms = 10000;
+    cfg->max_requests = 0;
+    cfg->resume = true;
+}
+
+tls_conn_t *tls_conn_create(tls_transport_t *transport, const char *host, uint16_t port,
+                            const tls_conn_config_t *cfg) {
+    if (!transport || !host || strlen(host) >= TLS_CONN_HOST_MAX) {
+        tls_transport_destroy(transport);
+        return NULL;
+    }
+    tls_conn_t *conn = new (std::nothrow) tls_conn_t();
+    if (!conn) {
+        tls_transport_destroy(transport);
+        return NULL;
+    }
+    conn->transport = transport;
+    strcpy(conn->host, host);
+    conn->port = port;
+    if (cfg) {
+        conn->cfg = *cfg;
+    } else {
+        tls_conn_default_config(&conn->cfg);
+    }
+    return conn;
+}
+
+void tls_conn_destroy(tls_conn_t *conn) {
+    if (!conn) return;
+    close_open(conn);
+    tls_transport_destroy(conn->transport);
+    delete conn;
+}
+
+const char *tls_conn_host(const tls_conn_t *conn) {
+    return conn ? conn->host : "";
+}
+
+uint16_t tls_conn_port(const tls_conn_t *conn) {
+    return conn ? conn->port : 0;
+}
+
+tls_transport_t *tls_conn_acquire(tls_conn_t *conn, bool *reused) {
+    if (reused) *reused = false;
+    if (!conn || conn->in_use) return NULL;
+
+    if (conn->open) {
+        tls_transport_t *t = conn->transport;
+        if (conn->cfg.idle_timeout_ms > 0 &&
+            now_ms(conn) - conn->idle_since_ms >= conn->cfg.idle_timeout_ms) {
+            // Likely dropped by the server or a NAT by now, without a FIN
+            // to tell; a request sent into that would wait out its timeout
+            conn->stats.idle_expired++;
+            close_open(conn);
+        } else if (!t->ops->alive(t)) {
+            conn->stats.peer_closed++;
+            close_open(conn);
+        }
+    }
+
+    bool was_open = conn->open;
+    if (!conn->open && !reconnect(conn)) {
+        return NULL;
+    }
+
+    conn->in_use = true;
+    conn->conn_requests++;
+    conn->stats.requests++;
+    if (was_open) conn->stats.reused++;
+    if (reused) *reused = was_open;
+    return conn->transport;
+}
+
+void tls_conn_release(tls_conn_t *conn, bool reusable) {
+    if (!conn || !conn->in_use) return;
+    conn->in_use = false;
+    if (!reusable ||
+        (conn->cfg.max_requests > 0 && conn->conn_requests >= conn->cfg.max_requests)) {
+        close_open(conn);
+        return;
+    }
+    conn->idle_since_ms = now_ms(conn);
+}
+
+void tls_conn_release_stale(tls_conn_t *conn) {
+    if (!conn || !conn->in_use) return;
+    conn->stats.stale++;
+    tls_conn_release(conn, false);
+}
+
+void tls_conn_close(tls_conn_t *conn) {
+    if (!conn || conn->in_use) return;
+    close_open(conn);
+}
+
+void tls_conn_get_stats(const tls_conn_t *conn, tls_conn_stats_t *stats) {
+    if (!stats) return;
+    if (conn) {
+        *stats = conn->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+void tls_conn_reset_stats(tls_conn_t *conn) {
+    if (conn) memset(&conn->stats, 0, sizeof(conn->stats));
+}
+
+} // extern "C"
@@ -0,0 +1,177 @@
+#ifndef TLS_CONN_H
+#define TLS_CONN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One long-lived connection to a server, kept open between requests.
+ *
+ * A new HTTPS connection to Google costs a DNS lookup, a TCP round trip and
+ * a full TLS handshake with its public key operations: hundreds of ms to
+ * seconds on the S3, paid on every turn when each request opens its own.
+ * The manager hands out the open connection while the server keeps it
+ * alive, reconnects when the server dropped it or it sat idle too long,
+ * and offers the session of the previous connection when it does, so the
+ * reconnect is an abbreviated handshake. The statistics show how often
+ * each of those happened.
+ *
+ * Sockets and TLS live behind tls_transport_ops_t: mbedTLS on the device
+ * (tls_conn_mbedtls.cpp), OpenSSL in the host tests. One user at a time;
+ * callers serialise their requests. No platform dependency.
+ */
+
+typedef enum {
+    TLS_CONNECT_FAILED = 0,
+    TLS_CONNECT_FULL,           // Full handshake, or a plain TCP connection
+    TLS_CONNECT_RESUMED,        // Abbreviated handshake with the saved session
+} tls_connect_result_t;
+
+typedef struct tls_transport tls_transport_t;
+
+typedef struct {
+    /**
+     * Open a connection. With resume set, offer the session saved from the
+     * last connection (ticket or session ID); the result says whether the
+     * server accepted it.
+     */
+    tls_connect_result_t (*connect)(tls_transport_t *t, const char *host, uint16_t port,
+                                    bool resume, uint32_t timeout_ms);
+
+    /**
+     * Whether an idle connection can take another request: still open, and
+     * the peer has neither closed it nor sent anything since the last
+     * response. Must not block.
+     */
+    bool (*alive)(tls_transport_t *t);
+
+    /** Write all len bytes. false on error. */
+    bool (*write)(tls_transport_t *t, const void *data, size_t len, uint32_t timeout_ms);
+
+    /**
+     * Read up to len bytes: the count read, 0 if nothing arrived within
+     * timeout_ms, -1 once the connection is closed or broken.
+     */
+    int (*read)(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms);
+
+    /** Close the connection. The session is kept for the next connect. */
+    void (*close)(tls_transport_t *t);
+
+    /** Drop the saved session. */
+    void (*forget_session)(tls_transport_t *t);
+
+    void (*destroy)(tls_transport_t *t);
+} tls_transport_ops_t;
+
+struct tls_transport {
+    const tls_transport_ops_t *ops;
+};
+
+static inline bool tls_transport_write(tls_transport_t *t, const void *data, size_t len,
+                                       uint32_t timeout_ms) {
+    return t->ops->write(t, data, len, timeout_ms);
+}
+
+static inline int tls_transport_read(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms) {
+    return t->ops->read(t, buf, len, timeout_ms);
+}
+
+static inline void tls_transport_destroy(tls_transport_t *t) {
+    if (t) t->ops->destroy(t);
+}
+
+// ---------------------------------------------------------------------------
+// Connection manager
+
+typedef struct {
+    uint32_t idle_timeout_ms;       // Reconnect rather than reuse a connection idle this long
+    uint32_t connect_timeout_ms;
+    uint32_t max_requests;          // Per connection, 0 for no limit
+    bool resume;                    // Offer saved sessions when reconnecting
+    uint32_t (*now_ms)(void *ctx);  // NULL for the platform clock
+    void *clock_ctx;
+} tls_conn_config_t;
+
+/**
+ * @brief 60 s idle timeout, 10 s to connect, no request limit, resumption on.
+ */
+void tls_conn_default_config(tls_conn_config_t *cfg);
+
+typedef struct {
+    uint32_t requests;              // Successful acquires
+    uint32_t reused;                // ... that got the connection already open
+    uint32_t full_handshakes;
+    uint32_t resumed_handshakes;
+    uint32_t connect_failures;
+    uint32_t peer_closed;           // Idle connections the server had closed
+    uint32_t idle_expired;          // Idle connections closed here, see idle_timeout_ms
+    uint32_t stale;                 // Reused connections that failed before any response
+    uint32_t full_ms_total;         // Time spent connecting with a full handshake
+    uint32_t resumed_ms_total;      // ... and with an abbreviated one
+} tls_conn_stats_t;
+
+typedef struct tls_conn tls_conn_t;
+
+/**
+ * @brief Manage connections to host:port through transport, which the
+ *        manager owns from here on. Nothing is connected until the first
+ *        acquire.
+ * @param cfg NULL for tls_conn_default_config()
+ */
+tls_conn_t *tls_conn_create(tls_transport_t *transport, const char *host, uint16_t port,
+                            const tls_conn_config_t *cfg);
+void tls_conn_destroy(tls_conn_t *conn);
+
+const char *tls_conn_host(const tls_conn_t *conn);
+uint16_t tls_conn_port(const tls_conn_t *conn);
+
+/**
+ * @brief Get a connected transport for one request: the open connection if
+ *        it is still usable, otherwise a new one (resumed when possible).
+ * @param reused Set to whether the connection was already open
+ * @return NULL if connecting failed
+ */
+tls_transport_t *tls_conn_acquire(tls_conn_t *conn, bool *reused);
+
+/**
+ * @brief Done with the request. reusable: the whole response was read and
+ *        the server did not ask to close, so the connection stays open.
+ */
+void tls_conn_release(tls_conn_t *conn, bool reusable);
+
+/**
+ * @brief A reused connection failed before any of the response arrived:
+ *        the server closed it while it sat idle. Closes it and counts it,
+ *        so the caller can retry on a fresh connection.
+ */
+void tls_conn_release_stale(tls_conn_t *conn);
+
+/**
+ * @brief Close the open connection now (e.g. Wi-Fi went down), keeping the
+ *        session for the next connect.
+ */
+void tls_conn_close(tls_conn_t *conn);
+
+void tls_conn_get_stats(const tls_conn_t *conn, tls_conn_stats_t *stats);
+void tls_conn_reset_stats(tls_conn_t *conn);
+
+// ---------------------------------------------------------------------------
+// Device backend (tls_conn_mbedtls.cpp)
+
+/**
+ * @brief lwIP socket with mbedTLS on top when secure, plain TCP otherwise
+ *        (a mock server on the LAN). Keeps the session of each connection
+ *        for resumption. The server certificate is not verified, the same
+ *        trust model as HTTPClient::begin(url).
+ */
+tls_transport_t *tls_transport_mbedtls_create(bool secure);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // TLS_CONN_H
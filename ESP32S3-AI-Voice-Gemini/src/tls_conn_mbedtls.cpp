@@ -0,0 +1,266 @@
+// src/tls_conn_mbedtls.cpp - lwIP socket and mbedTLS transport for tls_conn
+
+#include "tls_conn.h"
+#include "esp_log.h"
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/version.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "TLS_CONN";
+
+// mbedTLS 3 (IDF 5) hides struct members behind MBEDTLS_PRIVATE
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+#define SESSION_MASTER(s)   ((s).MBEDTLS_PRIVATE(master))
+#else
+#define SESSION_MASTER(s)   ((s).master)
+#endif
+
+struct mbedtls_transport {
+    tls_transport_t base;
+    bool secure;
+    bool rng_ready;
+    bool ssl_ready;             // ssl and conf set up for the current connection
+    mbedtls_net_context net;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ssl_config conf;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_session session;
+    bool have_session;
+};
+
+static mbedtls_transport *self(tls_transport_t *t) {
+    return (mbedtls_transport *)t;
+}
+
+// Non-blocking connect bounded by timeout_ms, then back to blocking with
+// send and receive timeouts
+static int open_socket(const char *host, uint16_t port, uint32_t timeout_ms) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", (unsigned)port);
+
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || !res) {
+        ESP_LOGE(TAG, "DNS lookup for %s failed", host);
+        return -1;
+    }
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    int r = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (r < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    if (r < 0) {
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(fd, &wfds);
+        struct timeval tv = { (time_t)(timeout_ms / 1000), (suseconds_t)(timeout_ms % 1000) * 1000 };
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (select(fd + 1, NULL, &wfds, NULL, &tv) <= 0 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+            ESP_LOGE(TAG, "Connect to %s:%u failed", host, (unsigned)port);
+            close(fd);
+            return -1;
+        }
+    }
+    fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+
+    struct timeval tv = { (time_t)(timeout_ms / 1000), (suseconds_t)(timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static void free_ssl(mbedtls_transport *m) {
+    if (m->ssl_ready) {
+        mbedtls_ssl_free(&m->ssl);
+        mbedtls_ssl_config_free(&m->conf);
+        m->ssl_ready = false;
+    }
+}
+
+static void mt_close(tls_transport_t *t) {
+    mbedtls_transport *m = self(t);
+    if (m->ssl_ready && m->net.fd >= 0) {
+        mbedtls_ssl_close_notify(&m->ssl);
+    }
+    free_ssl(m);
+    mbedtls_net_free(&m->net);
+}
+
+static bool setup_ssl(mbedtls_transport *m, const char *host) {
+    if (!m->rng_ready) {
+        mbedtls_entropy_init(&m->entropy);
+        mbedtls_ctr_drbg_init(&m->drbg);
+        if (mbedtls_ctr_drbg_seed(&m->drbg, mbedtls_entropy_func, &m->entropy, NULL, 0) != 0) {
+            mbedtls_ctr_drbg_free(&m->drbg);
+            mbedtls_entropy_free(&m->entropy);
+            return false;
+        }
+        m->rng_ready = true;
+    }
+
+    mbedtls_ssl_config_init(&m->conf);
+    mbedtls_ssl_init(&m->ssl);
+    m->ssl_ready = true;
+    if (mbedtls_ssl_config_defaults(&m->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+        return false;
+    }
+    mbedtls_ssl_conf_authmode(&m->conf, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&m->conf, mbedtls_ctr_drbg_random, &m->drbg);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&m->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    return mbedtls_ssl_setup(&m->ssl, &m->conf) == 0 &&
+           mbedtls_ssl_set_hostname(&m->ssl, host) == 0;
+}
+
+static tls_connect_result_t mt_connect(tls_transport_t *t, const char *host, uint16_t port,
+                                       bool resume, uint32_t timeout_ms) {
+    mbedtls_transport *m = self(t);
+    mt_close(t);
+
+    m->net.fd = open_socket(host, port, timeout_ms);
+    if (m->net.fd < 0) return TLS_CONNECT_FAILED;
+    if (!m->secure) return TLS_CONNECT_FULL;
+
+    if (!setup_ssl(m, host)) {
+        mt_close(t);
+        return TLS_CONNECT_FAILED;
+    }
+    bool offered = resume && m->have_session && mbedtls_ssl_set_session(&m->ssl, &m->session) == 0;
+    mbedtls_ssl_conf_read_timeout(&m->conf, timeout_ms);
+    mbedtls_ssl_set_bio(&m->ssl, &m->net, mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
+
+    int r;
+    while ((r = mbedtls_ssl_handshake(&m->ssl)) != 0) {
+        if (r != MBEDTLS_ERR_SSL_WANT_READ && r != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGE(TAG, "TLS handshake with %s failed: -0x%04x", host, (unsigned)-r);
+            mt_close(t);
+            return TLS_CONNECT_FAILED;
+        }
+    }
+
+    // A resumed session keeps the master secret of the one offered
+    mbedtls_ssl_session now;
+    mbedtls_ssl_session_init(&now);
+    bool resumed = false;
+    if (mbedtls_ssl_get_session(&m->ssl, &now) == 0) {
+        resumed = offered && memcmp(SESSION_MASTER(now), SESSION_MASTER(m->session),
+                                    sizeof(SESSION_MASTER(now))) == 0;
+        mbedtls_ssl_session_free(&m->session);
+        m->session = now;
+        m->have_session = true;
+    } else {
+        mbedtls_ssl_session_free(&now);
+    }
+    return resumed ? TLS_CONNECT_RESUMED : TLS_CONNECT_FULL;
+}
+
+static bool mt_alive(tls_transport_t *t) {
+    mbedtls_transport *m = self(t);
+    if (m->net.fd < 0) return false;
+    if (m->ssl_ready && mbedtls_ssl_get_bytes_avail(&m->ssl) > 0) return false;
+    // Readable while idle means a FIN or an alert: either way it is closing
+    uint8_t b;
+    int n = recv(m->net.fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static bool mt_write(tls_transport_t *t, const void *data, size_t len, uint32_t timeout_ms) {
+    mbedtls_transport *m = self(t);
+    (void)timeout_ms;   // SO_SNDTIMEO from connect
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0) {
+        int n = m->secure ? mbedtls_ssl_write(&m->ssl, p, len) : mbedtls_net_send(&m->net, p, len);
+        if (n == MBEDTLS_ERR_SSL_WANT_WRITE || n == MBEDTLS_ERR_SSL_WANT_READ) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static int mt_read(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms) {
+    mbedtls_transport *m = self(t);
+    if (m->net.fd < 0) return -1;
+    int n;
+    if (m->secure) {
+        mbedtls_ssl_conf_read_timeout(&m->conf, timeout_ms);
+        n = mbedtls_ssl_read(&m->ssl, (unsigned char *)buf, len);
+    } else {
+        n = mbedtls_net_recv_timeout(&m->net, (unsigned char *)buf, len, timeout_ms);
+    }
+    if (n > 0) return n;
+    if (n == MBEDTLS_ERR_SSL_TIMEOUT || n == MBEDTLS_ERR_SSL_WANT_READ ||
+        n == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+#if defined(MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
+    if (n == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET) return 0;
+#endif
+    return -1;
+}
+
+static void mt_forget_session(tls_transport_t *t) {
+    mbedtls_transport *m = self(t);
+    if (m->have_session) {
+        mbedtls_ssl_session_free(&m->session);
+        mbedtls_ssl_session_init(&m->session);
+        m->have_session = false;
+    }
+}
+
+static void mt_destroy(tls_transport_t *t) {
+    mbedtls_transport *m = self(t);
+    mt_close(t);
+    mt_forget_session(t);
+    if (m->rng_ready) {
+        mbedtls_ctr_drbg_free(&m->drbg);
+        mbedtls_entropy_free(&m->entropy);
+    }
+    delete m;
+}
+
+static const tls_transport_ops_t s_mbedtls_ops = {
+    mt_connect, mt_alive, mt_write, mt_read, mt_close, mt_forget_session, mt_destroy,
+};
+
+extern "C" {
+
+tls_transport_t *tls_transport_mbedtls_create(bool secure) {
+    mbedtls_transport *m = new (std::nothrow) mbedtls_transport();
+    if (!m) return NULL;
+    m->base.ops = &s_mbedtls_ops;
+    m->secure = secure;
+    mbedtls_net_init(&m->net);
+    mbedtls_ssl_session_init(&m->session);
+    return &m->base;
+}
+
+} // extern "C"
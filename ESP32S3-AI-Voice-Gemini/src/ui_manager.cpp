@@ -1,7 +1,11 @@
 #include "ui_manager.h"
 #include <Arduino.h>
 #include <lvgl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include "ui.h"
+#include "audio_capture.h"
 #include <cstdlib>
 #include <cstring>
 #include <stdarg.h>
@@ -9,15 +13,53 @@
 
 #define CHAT_BUF_SIZE 128
 
-struct async_msg_t {
-    char *txt;
+// Mic level meter
+#define LEVEL_METER_PERIOD_MS     33      // ~30 fps
+#define LEVEL_METER_FLOOR_DB10    (-600)  // Bottom of the scale, dBFS x10
+#define LEVEL_METER_RELEASE       4       // Fall per update, percent of the scale
+#define LEVEL_METER_CLIP_HOLD_MS  1000    // Indicator stays red this long after a clip
+#define LEVEL_METER_STALE_MS      200     // No new frames: capture stopped, show nothing
+
+// UI work posted from other tasks, run by the LVGL task
+#define UI_POST_QUEUE_LEN         64
+
+struct ui_post_t {
+    ui_post_fn fn;
+    void *arg;
 };
 
-static void _async_append_cb(void *param) {
-    async_msg_t *m = static_cast<async_msg_t*>(param);
-    lv_textarea_add_text(ui_tachat, m->txt);
-    free(m->txt);
-    free(m);
+static QueueHandle_t s_post_queue = NULL;
+static TaskHandle_t s_lvgl_task = NULL;
+
+void ui_manager_init(void) {
+    if (s_post_queue) return;
+    s_lvgl_task = xTaskGetCurrentTaskHandle();
+    s_post_queue = xQueueCreate(UI_POST_QUEUE_LEN, sizeof(ui_post_t));
+}
+
+bool ui_manager_post(ui_post_fn fn, void *arg) {
+    if (s_lvgl_task && xTaskGetCurrentTaskHandle() == s_lvgl_task) {
+        fn(arg);
+        return true;
+    }
+    ui_post_t post = { fn, arg };
+    return s_post_queue && xQueueSend(s_post_queue, &post, 0) == pdTRUE;
+}
+
+void ui_manager_run_posted(void) {
+    if (!s_post_queue) return;
+    // Only what is queued now, so a busy poster cannot hold up rendering
+    UBaseType_t n = uxQueueMessagesWaiting(s_post_queue);
+    ui_post_t post;
+    while (n-- > 0 && xQueueReceive(s_post_queue, &post, 0) == pdTRUE) {
+        post.fn(post.arg);
+    }
+}
+
+static void _append_cb(void *param) {
+    char *txt = static_cast<char*>(param);
+    lv_textarea_add_text(ui_tachat, txt);
+    free(txt);
 }
 
 void chat_screen_append_txt(const char *tag, const char *format, ...) {
@@ -31,9 +73,9 @@ void chat_screen_append_txt(const char *tag, const char *format, ...) {
     size_t text_len  = strlen(local);
     size_t total_len = 1 + (tag_len ? tag_len + 2 : 0) + text_len + 1;
 
-    async_msg_t *m = static_cast<async_msg_t*>(malloc(sizeof(*m)));
-    m->txt = static_cast<char*>(malloc(total_len));
-    char *p = m->txt;
+    char *txt = static_cast<char*>(malloc(total_len));
+    if (!txt) return;
+    char *p = txt;
     *p++ = '\n';
     if (tag_len) {
         memcpy(p, tag, tag_len);
@@ -42,7 +84,7 @@ void chat_screen_append_txt(const char *tag, const char *format, ...) {
     }
     memcpy(p, local, text_len + 1);
 
-    lv_async_call(_async_append_cb, m);
+    if (!ui_manager_post(_append_cb, txt)) free(txt);
 }
 
 void loge(const char *tag, const char *fmt, ...) {
@@ -77,3 +119,62 @@ void logi(const char *tag, const char *fmt, ...) {
     Serial.println(buf);
     chat_screen_append_txt(tag, buf);
 }
+
+static lv_obj_t *s_level_bar = NULL;
+static uint32_t s_level_frames = 0;
+static uint32_t s_level_clipped = 0;
+static uint32_t s_level_fresh_ms = 0;
+static uint32_t s_level_clip_ms = 0;
+static bool s_level_clip_shown = false;
+
+static void level_meter_update(lv_timer_t *timer) {
+    // Nothing to draw while another screen is shown
+    if (lv_obj_get_screen(s_level_bar) != lv_screen_active()) return;
+
+    audio_level_stats_t st;
+    audio_capture_get_level(&st);
+    uint32_t now = lv_tick_get();
+
+    int32_t level = 0;
+    if (st.frames != s_level_frames) {
+        s_level_frames = st.frames;
+        s_level_fresh_ms = now;
+    }
+    if (st.frames > 0 && lv_tick_diff(now, s_level_fresh_ms) < LEVEL_METER_STALE_MS) {
+        int32_t db10 = st.rms_db10 < LEVEL_METER_FLOOR_DB10 ? LEVEL_METER_FLOOR_DB10 : st.rms_db10;
+        level = 100 - db10 * 100 / LEVEL_METER_FLOOR_DB10;
+    }
+
+    // Rise at once, fall gradually, like a VU meter. Setting an unchanged
+    // value does not invalidate anything, so a quiet room costs no redraws.
+    int32_t shown = lv_bar_get_value(s_level_bar);
+    if (level < shown - LEVEL_METER_RELEASE) level = shown - LEVEL_METER_RELEASE;
+    if (level != shown) {
+        lv_bar_set_value(s_level_bar, level, LV_ANIM_OFF);
+    }
+
+    if (st.clipped_samples != s_level_clipped) {
+        s_level_clipped = st.clipped_samples;
+        s_level_clip_ms = now;
+    }
+    bool clip = s_level_clipped > 0 && lv_tick_diff(now, s_level_clip_ms) < LEVEL_METER_CLIP_HOLD_MS;
+    if (clip != s_level_clip_shown) {
+        s_level_clip_shown = clip;
+        lv_obj_set_style_bg_color(s_level_bar, lv_color_hex(clip ? 0xFF3030 : 0x30C050), LV_PART_INDICATOR);
+    }
+}
+
+void ui_manager_level_meter_init(void) {
+    if (s_level_bar || !ui_Main) return;
+
+    // Between the settings and talk buttons
+    s_level_bar = lv_bar_create(ui_Main);
+    lv_obj_set_size(s_level_bar, 300, 8);
+    lv_obj_align(s_level_bar, LV_ALIGN_BOTTOM_MID, 0, -30);
+    lv_bar_set_range(s_level_bar, 0, 100);
+    lv_bar_set_value(s_level_bar, 0, LV_ANIM_OFF);
+    lv_obj_remove_flag(s_level_bar, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_style_bg_color(s_level_bar, lv_color_hex(0x30C050), LV_PART_INDICATOR);
+
+    lv_timer_create(level_meter_update, LEVEL_METER_PERIOD_MS, NULL);
+}
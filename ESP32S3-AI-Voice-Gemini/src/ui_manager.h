@@ -3,13 +3,41 @@
 #define UI_MANAGER_H
 
 #include "esp_err.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef void (*ui_post_fn)(void *arg);
+
+/**
+ * @brief Set up posting to the LVGL task. Call from the LVGL task (the
+ *        Arduino loop task) right after lv_init(), before other tasks start.
+ */
+void ui_manager_init(void);
+
+/**
+ * @brief Run fn(arg) on the LVGL task.
+ *
+ * LVGL is built without OS support (LV_USE_OS is LV_OS_NONE) and is not
+ * thread-safe, lv_async_call() included, so only the LVGL task may call
+ * it. Other tasks post their UI work here and the loop runs it through
+ * ui_manager_run_posted(). On the LVGL task itself fn runs at once.
+ *
+ * @return false if the queue is full; fn is then not called and arg is
+ *         still the caller's
+ */
+bool ui_manager_post(ui_post_fn fn, void *arg);
+
 /**
- * @brief Append text to the chat screen.
+ * @brief Run the work posted so far. Call from the LVGL task, before
+ *        lv_timer_handler().
+ */
+void ui_manager_run_posted(void);
+
+/**
+ * @brief Append text to the chat screen. Safe from any task.
  * 
  * This function adds a new line of text to the chat area,
  * typically used to display system messages or responses.
@@ -21,6 +49,16 @@ void loge(const char *tag, const char *format, ...);
 void logw(const char *tag, const char *format, ...);
 void logi(const char *tag, const char *format, ...);
 
+/**
+ * @brief Add the mic level meter to the chat screen.
+ *
+ * A bar polled from the capture statistics at ~30 fps; it only
+ * invalidates its own area, and only when the level changes. Turns red
+ * for a second after the input clipped. Call from the LVGL task once the
+ * UI is built.
+ */
+void ui_manager_level_meter_init(void);
+
 #ifdef __cplusplus
 }
 #endif
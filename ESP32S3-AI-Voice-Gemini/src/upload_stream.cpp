@@ -0,0 +1,144 @@
+// src/upload_stream.cpp - Chunked upload body read from a capture ring
+
+#include "upload_stream.h"
+#include "psram_alloc.h"
+#include <string.h>
+
+// Grow *buf to at least size bytes; buffers are kept between uploads
+static bool reserve(void **buf, size_t *cap, size_t size) {
+    if (size <= *cap) return true;
+    void *grown = psram_realloc(*buf, size);
+    if (!grown) return false;
+    *buf = grown;
+    *cap = size;
+    return true;
+}
+
+// Copy out what is left of the current piece
+static size_t take_stage(upload_stream_t *st, char *buf, size_t cap) {
+    size_t n = st->stage_len - st->stage_pos;
+    if (n > cap) n = cap;
+    memcpy(buf, st->stage + st->stage_pos, n);
+    st->stage_pos += n;
+    st->chunks++;
+    st->bytes += n;
+    return n;
+}
+
+// Wait for enough audio to make a piece. Returns the samples available, or
+// 0 once capture has finished and the ring is drained, or on abort.
+static size_t wait_for_audio(upload_stream_t *st) {
+    for (;;) {
+        if (st->abort && *st->abort) return 0;
+        size_t avail = audio_ring_available(st->ring, st->reader);
+        if (st->finish && *st->finish) return avail;
+        if (avail >= st->cfg.min_chunk) return avail;
+        st->cfg.sleep_ms(st->cfg.poll_ms);
+    }
+}
+
+extern "C" {
+
+bool upload_stream_init(upload_stream_t *st, const upload_stream_config_t *cfg,
+                        audio_ring_t *ring, int reader,
+                        const volatile bool *finish, const volatile bool *abort,
+                        const audio_encoder_t *encoder,
+                        const void *header, size_t header_len) {
+    if (!st || !cfg || !cfg->sleep_ms || cfg->max_chunk == 0 || !ring ||
+        header_len > sizeof(st->header)) {
+        return false;
+    }
+
+    st->cfg = *cfg;
+    if (st->cfg.min_chunk > st->cfg.max_chunk) st->cfg.min_chunk = st->cfg.max_chunk;
+    st->ring = ring;
+    st->reader = reader;
+    st->finish = finish;
+    st->abort = abort;
+    st->encode = encoder && encoder->id != AUDIO_CODEC_PCM16;
+    if (st->encode) {
+        st->encoder = *encoder;
+    }
+    st->header_pos = 0;
+    st->flushed = false;
+    st->header_len = header_len;
+    if (header_len > 0) {
+        memcpy(st->header, header, header_len);
+    }
+    st->stage_len = 0;
+    st->stage_pos = 0;
+    st->chunks = 0;
+    st->bytes = 0;
+    st->samples = 0;
+    st->skipped = 0;
+
+    // Raw samples are read straight into the stage; encoded ones go
+    // through pcm first, and the stage needs room for the encoder's worst
+    // case with up to a block already held back
+    size_t stage = st->cfg.max_chunk * sizeof(int16_t);
+    if (st->encode) {
+        size_t worst = audio_encoder_max_output(&st->encoder,
+                                                st->cfg.max_chunk + AUDIO_CODEC_FLAC_BLOCK_SAMPLES);
+        if (worst > stage) stage = worst;
+        if (!reserve((void **)&st->pcm, &st->pcm_cap, st->cfg.max_chunk * sizeof(int16_t))) {
+            return false;
+        }
+    }
+    return reserve((void **)&st->stage, &st->stage_cap, stage);
+}
+
+size_t upload_stream_body(void *ctx, size_t offset, char *buf, size_t cap) {
+    (void)offset;
+    upload_stream_t *st = (upload_stream_t *)ctx;
+    if (!st || cap == 0 || (st->abort && *st->abort)) return 0;
+
+    if (st->header_pos < st->header_len) {
+        size_t n = st->header_len - st->header_pos;
+        if (n > cap) n = cap;
+        memcpy(buf, st->header + st->header_pos, n);
+        st->header_pos += n;
+        st->chunks++;
+        return n;
+    }
+
+    while (st->stage_pos == st->stage_len) {
+        st->stage_len = 0;
+        st->stage_pos = 0;
+
+        size_t avail = wait_for_audio(st);
+        if (st->abort && *st->abort) return 0;
+        if (avail == 0) {
+            // Capture is over: the encoder's partial block, then the end
+            if (!st->encode || st->flushed) return 0;
+            st->flushed = true;
+            st->stage_len = audio_encoder_flush(&st->encoder, st->stage, st->stage_cap);
+            continue;
+        }
+
+        size_t want = avail < st->cfg.max_chunk ? avail : st->cfg.max_chunk;
+        if (!st->encode) {
+            size_t n = audio_ring_read(st->ring, st->reader, (int16_t *)st->stage, want);
+            st->samples += n;
+            st->stage_len = n * sizeof(int16_t);
+        } else {
+            size_t n = audio_ring_read(st->ring, st->reader, st->pcm, want);
+            st->samples += n;
+            // Block codecs may hold everything back until a block is full
+            st->stage_len = audio_encoder_encode(&st->encoder, st->pcm, n, st->stage, st->stage_cap);
+        }
+        st->skipped = audio_ring_reader_skipped(st->ring, st->reader);
+    }
+    return take_stage(st, buf, cap);
+}
+
+void upload_stream_free(upload_stream_t *st) {
+    if (!st) return;
+    free(st->pcm);
+    free(st->stage);
+    st->pcm = NULL;
+    st->pcm_cap = 0;
+    st->stage = NULL;
+    st->stage_cap = 0;
+}
+
+} // extern "C"
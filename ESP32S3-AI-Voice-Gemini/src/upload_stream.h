@@ -0,0 +1,96 @@
+#ifndef UPLOAD_STREAM_H
+#define UPLOAD_STREAM_H
+
+#include "audio_ring.h"
+#include "audio_codec.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Body of a streaming audio upload.
+ *
+ * The body is the container header, then the audio of a capture ring
+ * reader as it arrives, encoded or as raw PCM16, then whatever the encoder
+ * still holds once capture has finished. upload_stream_body() is the
+ * http_body_fn of a request sent with HTTP_SESSION_CHUNKED_BODY: while
+ * capture runs it waits until min_chunk samples are ready, so the socket
+ * sees a few larger writes rather than one per capture frame, and it ends
+ * the body once capture has finished and the ring is drained.
+ *
+ * Open the reader with audio_ring_reader_open_lossy() so a stalled
+ * connection costs the upload the samples it falls behind on, counted in
+ * skipped, rather than holding the capture back for every other reader.
+ *
+ * Buffers are allocated by upload_stream_init() and kept for the next
+ * upload, so the state starts out zeroed (static storage) and lives as long
+ * as the uploader. No platform dependency: waiting goes through the
+ * sleep_ms hook.
+ */
+
+#define UPLOAD_STREAM_HEADER_MAX    128
+
+typedef struct {
+    size_t min_chunk;               // Samples batched while capture runs
+    size_t max_chunk;               // Samples taken from the ring at once
+    uint32_t poll_ms;               // Wait between looks at the ring
+    void (*sleep_ms)(uint32_t ms);
+} upload_stream_config_t;
+
+typedef struct {
+    upload_stream_config_t cfg;
+    audio_ring_t *ring;
+    int reader;
+    const volatile bool *finish;    // Set when capture has ended
+    const volatile bool *abort;     // Set to end the body at once
+    audio_encoder_t encoder;
+    bool encode;                    // false: raw PCM16
+    bool flushed;
+    uint8_t header[UPLOAD_STREAM_HEADER_MAX];
+    size_t header_len;
+    size_t header_pos;
+    int16_t *pcm;                   // Samples read from the ring, when encoding
+    size_t pcm_cap;                 // In bytes
+    uint8_t *stage;                 // Bytes of the current piece not yet returned
+    size_t stage_cap;
+    size_t stage_len;
+    size_t stage_pos;
+    uint32_t chunks;                // Calls that returned data, header included
+    uint32_t bytes;                 // Audio bytes returned, header excluded
+    uint32_t samples;               // Samples read from the ring
+    uint32_t skipped;               // Samples a lossy reader was moved past
+} upload_stream_t;
+
+/**
+ * @brief Prepare an upload from reader of ring.
+ * @param encoder Encoder state to continue from (copied), or NULL / PCM16
+ *        to send the samples as they are
+ * @param header Sent first, up to UPLOAD_STREAM_HEADER_MAX bytes; may be NULL
+ * @return false if a buffer could not be allocated or the header is too long
+ */
+bool upload_stream_init(upload_stream_t *st, const upload_stream_config_t *cfg,
+                        audio_ring_t *ring, int reader,
+                        const volatile bool *finish, const volatile bool *abort,
+                        const audio_encoder_t *encoder,
+                        const void *header, size_t header_len);
+
+/**
+ * @brief http_body_fn: the next piece of the body, at most cap bytes.
+ *        Waits for audio while capture runs.
+ * @return Bytes written to buf; 0 once the body is complete or aborted
+ */
+size_t upload_stream_body(void *ctx, size_t offset, char *buf, size_t cap);
+
+/**
+ * @brief Release the buffers.
+ */
+void upload_stream_free(upload_stream_t *st);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // UPLOAD_STREAM_H
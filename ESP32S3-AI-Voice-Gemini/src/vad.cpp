@@ -0,0 +1,181 @@
+// src/vad.cpp - Energy/ZCR voice activity detector with adaptive noise floor
+
+#include "vad.h"
+#include <string.h>
+
+// Noise floor tracking: fall quickly, rise slowly
+#define NOISE_FALL_SHIFT    2
+#define NOISE_RISE_SHIFT    6
+
+static uint32_t scale_q8(uint32_t value, uint16_t ratio_q8) {
+    uint64_t v = ((uint64_t)value * ratio_q8) >> 8;
+    return v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+}
+
+// Mean-square energy with the frame's DC offset removed, and the number of
+// zero crossings around that mean.
+static void frame_features(const int16_t *frame, uint16_t n, uint32_t *energy, uint16_t *zcr) {
+    int64_t sum = 0;
+    uint64_t sum_sq = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        int32_t s = frame[i];
+        sum += s;
+        sum_sq += (uint64_t)((int64_t)s * s);
+    }
+
+    int32_t mean = (int32_t)(sum / n);
+    uint64_t ms = sum_sq / n;
+    uint64_t dc = (uint64_t)((int64_t)mean * mean);
+    ms = ms > dc ? ms - dc : 0;
+    *energy = ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+
+    uint16_t crossings = 0;
+    bool prev_neg = frame[0] < mean;
+    for (uint16_t i = 1; i < n; i++) {
+        bool neg = frame[i] < mean;
+        crossings += (neg != prev_neg);
+        prev_neg = neg;
+    }
+    *zcr = crossings;
+}
+
+static void update_noise_floor(vad_t *vad, uint32_t energy) {
+    uint32_t floor = vad->noise_floor;
+    if (energy < floor) {
+        floor -= (floor - energy) >> NOISE_FALL_SHIFT;
+    } else {
+        floor += (energy - floor) >> NOISE_RISE_SHIFT;
+    }
+    vad->noise_floor = floor < vad->cfg.min_energy ? vad->cfg.min_energy : floor;
+}
+
+extern "C" {
+
+void vad_config_default(vad_config_t *cfg, uint32_t sample_rate) {
+    if (!cfg) return;
+    cfg->frame_samples = (uint16_t)(sample_rate / 50);            // 20 ms
+    cfg->start_frames = 3;                                         // 60 ms
+    cfg->hangover_frames = 35;                                     // 700 ms
+    cfg->energy_ratio_q8 = 4 * 256;                                // +6 dB
+    cfg->unvoiced_ratio_q8 = 2 * 256;                              // +3 dB
+    cfg->zcr_unvoiced = (uint16_t)(cfg->frame_samples * 3 / 10);
+    cfg->min_energy = 400;                                         // ~20 LSB RMS
+    cfg->no_speech_frames = 250;                                   // 5 s
+    cfg->max_frames = 1500;                                        // 30 s
+    cfg->lead_frames = 10;                                         // 200 ms
+    cfg->tail_frames = 10;                                         // 200 ms
+}
+
+void vad_init(vad_t *vad, const vad_config_t *cfg) {
+    if (!vad) return;
+    if (cfg) {
+        vad->cfg = *cfg;
+    } else {
+        vad_config_default(&vad->cfg, 16000);
+    }
+    if (vad->cfg.frame_samples == 0) {
+        vad->cfg.frame_samples = 320;
+    }
+    vad_reset(vad);
+}
+
+void vad_reset(vad_t *vad) {
+    if (!vad) return;
+    vad->state = VAD_STATE_SILENCE;
+    vad->frames = 0;
+    vad->noise_floor = 0;
+    vad->last_energy = 0;
+    vad->last_zcr = 0;
+    vad->speech_run = 0;
+    vad->silence_run = 0;
+    vad->run_start_frame = 0;
+    vad->speech_start_frame = 0;
+    vad->speech_end_frame = 0;
+    vad->has_speech = false;
+}
+
+vad_event_t vad_process_frame(vad_t *vad, const int16_t *frame) {
+    if (!vad || !frame || vad->state == VAD_STATE_ENDED) {
+        return VAD_EVENT_NONE;
+    }
+
+    const vad_config_t *cfg = &vad->cfg;
+    uint32_t energy;
+    uint16_t zcr;
+    frame_features(frame, cfg->frame_samples, &energy, &zcr);
+    vad->last_energy = energy;
+    vad->last_zcr = zcr;
+
+    // Seed the noise floor from the first frame
+    if (vad->frames == 0) {
+        vad->noise_floor = energy < cfg->min_energy ? cfg->min_energy : energy;
+    }
+
+    uint32_t frame_idx = vad->frames++;
+    bool is_speech = energy > scale_q8(vad->noise_floor, cfg->energy_ratio_q8) ||
+                     (zcr >= cfg->zcr_unvoiced &&
+                      energy > scale_q8(vad->noise_floor, cfg->unvoiced_ratio_q8));
+
+    vad_event_t event = VAD_EVENT_NONE;
+
+    if (vad->state == VAD_STATE_SILENCE) {
+        if (is_speech) {
+            if (vad->speech_run == 0) {
+                vad->run_start_frame = frame_idx;
+            }
+            if (++vad->speech_run >= cfg->start_frames) {
+                vad->state = VAD_STATE_SPEECH;
+                vad->has_speech = true;
+                vad->speech_start_frame = vad->run_start_frame;
+                vad->speech_end_frame = frame_idx + 1;
+                vad->silence_run = 0;
+                event = VAD_EVENT_SPEECH_START;
+            }
+        } else {
+            vad->speech_run = 0;
+            update_noise_floor(vad, energy);
+            if (vad->frames >= cfg->no_speech_frames) {
+                vad->state = VAD_STATE_ENDED;
+                event = VAD_EVENT_TIMEOUT;
+            }
+        }
+    } else {
+        if (is_speech) {
+            vad->silence_run = 0;
+            vad->speech_end_frame = frame_idx + 1;
+        } else {
+            update_noise_floor(vad, energy);
+            if (++vad->silence_run >= cfg->hangover_frames) {
+                vad->state = VAD_STATE_ENDED;
+                event = VAD_EVENT_SPEECH_END;
+            }
+        }
+    }
+
+    if (vad->state != VAD_STATE_ENDED && vad->frames >= cfg->max_frames) {
+        vad->state = VAD_STATE_ENDED;
+        event = vad->has_speech ? VAD_EVENT_SPEECH_END : VAD_EVENT_TIMEOUT;
+    }
+
+    return event;
+}
+
+bool vad_get_segment(const vad_t *vad, size_t *start_sample, size_t *end_sample) {
+    if (!vad || !vad->has_speech) {
+        return false;
+    }
+
+    const vad_config_t *cfg = &vad->cfg;
+    uint32_t start = vad->speech_start_frame > cfg->lead_frames ?
+                     vad->speech_start_frame - cfg->lead_frames : 0;
+    uint32_t end = vad->speech_end_frame + cfg->tail_frames;
+    if (end > vad->frames) {
+        end = vad->frames;
+    }
+
+    if (start_sample) *start_sample = (size_t)start * cfg->frame_samples;
+    if (end_sample) *end_sample = (size_t)end * cfg->frame_samples;
+    return true;
+}
+
+} // extern "C"
@@ -0,0 +1,87 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frame-based voice activity detector.
+ *
+ * Each frame is classified from its mean energy and zero-crossing rate
+ * against an adaptive noise floor. Speech starts after start_frames
+ * consecutive speech frames and ends after hangover_frames consecutive
+ * non-speech frames. The detector only looks at 16-bit mono PCM and has no
+ * platform dependency.
+ */
+typedef struct {
+    uint16_t frame_samples;         // Samples per analysis frame
+    uint16_t start_frames;          // Speech frames needed to declare speech start
+    uint16_t hangover_frames;       // Silence frames after speech before declaring the end
+    uint16_t energy_ratio_q8;       // Voiced threshold: energy > floor * ratio / 256
+    uint16_t unvoiced_ratio_q8;     // Lower threshold used for high-ZCR (fricative) frames
+    uint16_t zcr_unvoiced;          // Zero crossings per frame marking a fricative
+    uint32_t min_energy;            // Absolute floor for the mean-square energy
+    uint16_t no_speech_frames;      // Give up if no speech starts within this many frames
+    uint16_t max_frames;            // Hard cap on the recording length
+    uint16_t lead_frames;           // Frames kept before speech when trimming
+    uint16_t tail_frames;           // Frames kept after speech when trimming
+} vad_config_t;
+
+typedef enum {
+    VAD_EVENT_NONE = 0,
+    VAD_EVENT_SPEECH_START,
+    VAD_EVENT_SPEECH_END,
+    VAD_EVENT_TIMEOUT,              // No speech, or max_frames reached
+} vad_event_t;
+
+typedef enum {
+    VAD_STATE_SILENCE = 0,
+    VAD_STATE_SPEECH,
+    VAD_STATE_ENDED,
+} vad_state_t;
+
+typedef struct {
+    vad_config_t cfg;
+    vad_state_t state;
+    uint32_t frames;                // Frames processed since reset
+    uint32_t noise_floor;           // Adaptive mean-square noise estimate
+    uint32_t last_energy;
+    uint16_t last_zcr;
+    uint16_t speech_run;            // Consecutive speech frames
+    uint16_t silence_run;           // Consecutive non-speech frames while in speech
+    uint32_t run_start_frame;       // First frame of the current speech run
+    uint32_t speech_start_frame;    // First frame of the detected speech
+    uint32_t speech_end_frame;      // One past the last speech frame
+    bool has_speech;
+} vad_t;
+
+/**
+ * @brief Defaults for 16 kHz capture: 20 ms frames, 60 ms to start,
+ *        700 ms hangover, 5 s without speech or 30 s total to give up.
+ */
+void vad_config_default(vad_config_t *cfg, uint32_t sample_rate);
+
+void vad_init(vad_t *vad, const vad_config_t *cfg);
+void vad_reset(vad_t *vad);
+
+/**
+ * @brief Classify one frame of cfg.frame_samples samples.
+ */
+vad_event_t vad_process_frame(vad_t *vad, const int16_t *frame);
+
+/**
+ * @brief Speech segment in samples, padded by lead/tail frames and clamped
+ *        to the samples processed so far.
+ * @return false if no speech was detected
+ */
+bool vad_get_segment(const vad_t *vad, size_t *start_sample, size_t *end_sample);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // VAD_H
@@ -0,0 +1,270 @@
+// src/voice_query.cpp - Voice query request bodies and schema replies
+
+#include "voice_query.h"
+#include <string.h>
+
+// The user turn around the base64 audio, after the conversation so far.
+// The schema makes the model return {"transcript": ..., "answer": ...} as
+// the text of its reply; the token limit leaves room for the transcript as
+// well as the answer.
+static constexpr char VOICE_BODY_TURN[] =
+    "{\"role\":\"user\",\"parts\":["
+    "{\"text\":\"Transcribe what the speaker in this audio says, then answer it "
+    "briefly in the same language. Reply with the transcript and the answer.\"},"
+    "{\"inline_data\":{\"mime_type\":\"audio/wav\",\"data\":\"";
+static constexpr char VOICE_BODY_SUFFIX[] =
+    "\"}}]}],"
+    "\"generationConfig\":{\"maxOutputTokens\":256,\"temperature\":0.7,"
+    "\"responseMimeType\":\"application/json\","
+    "\"responseSchema\":{\"type\":\"OBJECT\",\"properties\":{"
+    "\"transcript\":{\"type\":\"STRING\"},\"answer\":{\"type\":\"STRING\"}},"
+    "\"required\":[\"transcript\",\"answer\"]}}}";
+
+// Streamed: plain text, so the answer can be shown and spoken as it comes.
+// The transcript comes first, on a line of its own.
+static constexpr char VOICE_STREAM_TURN[] =
+    "{\"role\":\"user\",\"parts\":["
+    "{\"text\":\"First write exactly what the speaker in this audio says, on one line "
+    "starting with Q:. Then, on the next line, answer it briefly in the same language.\"},"
+    "{\"inline_data\":{\"mime_type\":\"audio/wav\",\"data\":\"";
+static constexpr char VOICE_STREAM_SUFFIX[] =
+    "\"}}]}],"
+    "\"generationConfig\":{\"maxOutputTokens\":256,\"temperature\":0.7}}";
+
+static size_t read_history(void *ctx, size_t offset, char *buf, size_t cap) {
+    return conversation_read_prefix((const conversation_t *)ctx, offset, buf, cap);
+}
+
+// ---------------------------------------------------------------------------
+// Schema reply. Not a validator: enough is checked to find the two members
+// and to decode them safely.
+
+struct Span {
+    char *start;                    // Just inside the quotes
+    char *end;                      // The closing quote
+};
+
+static char *skip_ws(char *p) {
+    while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') p++;
+    return p;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// The string whose opening quote is at p, escapes checked. Returns the
+// byte after the closing quote, or NULL.
+static char *scan_string(char *p, Span *s) {
+    if (*p != '"') return NULL;
+    s->start = ++p;
+    for (;;) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"') {
+            s->end = p;
+            return p + 1;
+        }
+        if (c < 0x20) return NULL;          // The end of the text, too
+        if (c == '\\') {
+            c = (unsigned char)*++p;
+            if (c == 'u') {
+                for (int i = 1; i <= 4; i++) {
+                    if (hex_digit(p[i]) < 0) return NULL;
+                }
+                p += 4;
+            } else if (c == '\0' || !strchr("\"\\/bfnrt", c)) {
+                return NULL;
+            }
+        }
+        p++;
+    }
+}
+
+// Past a member value of any type
+static char *skip_value(char *p) {
+    Span s;
+    if (*p == '"') return scan_string(p, &s);
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        do {
+            if (*p == '"') {
+                p = scan_string(p, &s);
+                if (!p) return NULL;
+                continue;
+            }
+            if (*p == '{' || *p == '[') depth++;
+            else if (*p == '}' || *p == ']') depth--;
+            else if (*p == '\0') return NULL;
+            p++;
+        } while (depth > 0);
+        return p;
+    }
+    char *start = p;
+    while ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') ||
+           *p == '-' || *p == '+' || *p == '.' || *p == 'E') {
+        p++;
+    }
+    return p > start ? p : NULL;
+}
+
+static size_t put_utf8(char *out, uint32_t cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Decode a scanned string in place and NUL-terminate it. Decoded text is
+// never longer than its escaped form; a lone surrogate becomes U+FFFD.
+static char *decode(const Span *s) {
+    char *in = s->start;
+    char *out = s->start;
+    uint32_t high = 0;              // First half of a \u pair, 0 if none
+    while (in < s->end) {
+        char c = *in++;
+        uint32_t cp = (unsigned char)c;
+        bool escaped = c == '\\';
+        if (escaped) {
+            c = *in++;
+            switch (c) {
+            case 'b': cp = '\b'; break;
+            case 'f': cp = '\f'; break;
+            case 'n': cp = '\n'; break;
+            case 'r': cp = '\r'; break;
+            case 't': cp = '\t'; break;
+            case 'u':
+                cp = 0;
+                for (int i = 0; i < 4; i++) cp = (cp << 4) | (uint32_t)hex_digit(*in++);
+                break;
+            default:  cp = (unsigned char)c; break;
+            }
+            if (c == 'u' && cp >= 0xD800 && cp < 0xDC00) {
+                if (high) out += put_utf8(out, 0xFFFD);
+                high = cp;
+                continue;
+            }
+            if (c == 'u' && cp >= 0xDC00 && cp < 0xE000) {
+                cp = high ? 0x10000 + ((high - 0xD800) << 10) + (cp - 0xDC00) : 0xFFFD;
+                high = 0;
+            }
+        }
+        if (high) {
+            out += put_utf8(out, 0xFFFD);
+            high = 0;
+        }
+        if (cp == 0 || cp == '\r') continue;
+        if (!escaped) {
+            *out++ = c;             // Raw UTF-8 bytes are copied as they are
+        } else {
+            out += put_utf8(out, cp);
+        }
+    }
+    if (high) out += put_utf8(out, 0xFFFD);
+    *out = '\0';
+    return s->start;
+}
+
+static bool key_is(const Span *key, const char *name) {
+    size_t len = strlen(name);
+    return (size_t)(key->end - key->start) == len && memcmp(key->start, name, len) == 0;
+}
+
+extern "C" {
+
+void voice_query_body(request_writer_t *w, const conversation_t *history,
+                      const uint8_t *wav, size_t len, voice_query_kind_t kind) {
+    request_writer_init(w);
+    request_writer_part(w, read_history, (void *)history, conversation_prefix_size(history));
+    if (kind == VOICE_QUERY_STREAM) {
+        REQUEST_WRITER_LITERAL(w, VOICE_STREAM_TURN);
+    } else {
+        REQUEST_WRITER_LITERAL(w, VOICE_BODY_TURN);
+    }
+    request_writer_base64(w, wav, len);
+    if (kind == VOICE_QUERY_STREAM) {
+        REQUEST_WRITER_LITERAL(w, VOICE_STREAM_SUFFIX);
+    } else {
+        REQUEST_WRITER_LITERAL(w, VOICE_BODY_SUFFIX);
+    }
+}
+
+bool voice_query_parse(char *text, const char **transcript, const char **answer) {
+    if (transcript) *transcript = NULL;
+    if (answer) *answer = NULL;
+    if (!text) return false;
+
+    // First find both members; nothing is written until the whole object
+    // has been read
+    Span said = {}, ans = {};
+    bool has_said = false, has_ans = false;
+    char *p = skip_ws(text);
+    if (*p++ != '{') return false;
+    p = skip_ws(p);
+    if (*p == '}') return false;
+    for (;;) {
+        Span key;
+        p = scan_string(p, &key);
+        if (!p) return false;
+        p = skip_ws(p);
+        if (*p++ != ':') return false;
+        p = skip_ws(p);
+
+        // A later member of the same name wins, as in a DOM parse
+        bool is_ans = key_is(&key, "answer");
+        bool is_said = key_is(&key, "transcript");
+        if ((is_ans || is_said) && *p == '"') {
+            Span value;
+            p = scan_string(p, &value);
+            if (!p) return false;
+            if (is_ans) {
+                ans = value;
+                has_ans = true;
+            } else {
+                said = value;
+                has_said = true;
+            }
+        } else {
+            if (is_ans) has_ans = false;
+            if (is_said) has_said = false;
+            p = skip_value(p);
+            if (!p) return false;
+        }
+
+        p = skip_ws(p);
+        if (*p == ',') {
+            p = skip_ws(p + 1);
+            continue;
+        }
+        if (*p != '}') return false;
+        break;
+    }
+    if (*skip_ws(p + 1) != '\0' || !has_ans) return false;
+
+    if (answer) *answer = decode(&ans);
+    if (has_said) {
+        const char *t = decode(&said);
+        if (transcript) *transcript = t;
+    }
+    return true;
+}
+
+} // extern "C"
@@ -0,0 +1,53 @@
+#ifndef VOICE_QUERY_H
+#define VOICE_QUERY_H
+
+#include "request_writer.h"
+#include "conversation.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Voice queries: a recorded WAV sent to generateContent as inline_data in
+ * the user turn, after the conversation so far, so one round trip gives
+ * both what was said and the answer.
+ *
+ * VOICE_QUERY_SCHEMA asks for a response schema, and the text of the reply
+ * is then the object {"transcript": ..., "answer": ...};
+ * voice_query_parse() takes it apart. VOICE_QUERY_STREAM asks for plain
+ * text that can be shown as it streams: the transcript on a first line
+ * starting with "Q:", then the answer.
+ *
+ * No platform dependency.
+ */
+
+typedef enum {
+    VOICE_QUERY_SCHEMA = 0,
+    VOICE_QUERY_STREAM,
+} voice_query_kind_t;
+
+/**
+ * @brief Set up w to write the request body. Nothing is copied: history
+ *        and wav must not change until the request is sent.
+ */
+void voice_query_body(request_writer_t *w, const conversation_t *history,
+                      const uint8_t *wav, size_t len, voice_query_kind_t kind);
+
+/**
+ * @brief Split the text of a VOICE_QUERY_SCHEMA reply into its transcript
+ *        and answer, decoded in place ('\r' and NUL removed, as in
+ *        gemini_reply). Other members are ignored.
+ * @param transcript Set to the transcript, or NULL if the reply has none
+ * @return false if text is not an object with a string "answer"; text is
+ *         then left as it was
+ */
+bool voice_query_parse(char *text, const char **transcript, const char **answer);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // VOICE_QUERY_H
@@ -0,0 +1,265 @@
+// src/wake_word.cpp - Wake word task, template storage and trigger
+
+#include "wake_word.h"
+#include "kws.h"
+#include "audio_capture.h"
+#include "audio_ring.h"
+#include "speech_to_text.h"
+#include "text_to_speech.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stddef.h>
+#include <stdio.h>
+
+static const char *TAG = "WAKE";
+
+#define WAKE_TASK_STACK         6144
+#define WAKE_TASK_PRIORITY      2
+#define WAKE_TASK_CORE          0       // Capture, LVGL and recording run on core 1
+#define WAKE_POLL_MS            10
+#define WAKE_NVS_NAMESPACE      "wakeword"
+#define WAKE_STATS_WINDOW       AUDIO_CAPTURE_SAMPLE_RATE   // Samples per CPU-load window
+
+static kws_t *s_kws = NULL;
+static TaskHandle_t s_task_handle = NULL;
+static volatile bool s_enabled = true;
+static volatile bool s_detected = false;
+static volatile bool s_enroll_request = false;
+static volatile bool s_clear_request = false;
+static volatile uint32_t s_detections = 0;
+static volatile uint32_t s_us_per_second = 0;
+static volatile uint16_t s_best_score = UINT16_MAX;
+
+// Templates are stored without their unused tail
+static size_t template_blob_size(uint16_t frames) {
+    return offsetof(kws_template_t, feat) + frames * sizeof(((kws_template_t *)0)->feat[0]);
+}
+
+static void load_templates(void) {
+    nvs_handle_t h;
+    if (nvs_open(WAKE_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) {
+        return;
+    }
+
+    uint8_t count = 0;
+    nvs_get_u8(h, "count", &count);
+    static kws_template_t tmpl;         // Too large for the caller's stack
+    for (uint8_t i = 0; i < count && i < KWS_MAX_TEMPLATES; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "t%u", i);
+        size_t len = sizeof(tmpl);
+        if (nvs_get_blob(h, key, &tmpl, &len) == ESP_OK && len == template_blob_size(tmpl.frames)) {
+            kws_add_template(s_kws, &tmpl);
+        } else {
+            ESP_LOGW(TAG, "Template %u unreadable, skipped", i);
+        }
+    }
+
+    uint16_t threshold;
+    if (nvs_get_u16(h, "threshold", &threshold) == ESP_OK) {
+        kws_set_threshold(s_kws, threshold);
+    }
+    nvs_close(h);
+}
+
+static void save_templates(void) {
+    nvs_handle_t h;
+    if (nvs_open(WAKE_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open NVS to save templates");
+        return;
+    }
+
+    size_t count = kws_template_count(s_kws);
+    esp_err_t err = nvs_erase_all(h);
+    for (size_t i = 0; i < count && err == ESP_OK; i++) {
+        const kws_template_t *tmpl = kws_get_template(s_kws, i);
+        char key[8];
+        snprintf(key, sizeof(key), "t%u", (unsigned)i);
+        err = nvs_set_blob(h, key, tmpl, template_blob_size(tmpl->frames));
+    }
+    if (err == ESP_OK) err = nvs_set_u8(h, "count", (uint8_t)count);
+    if (err == ESP_OK) err = nvs_set_u16(h, "threshold", kws_get_threshold(s_kws));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Saving templates failed: %s", esp_err_to_name(err));
+    }
+}
+
+static void handle_event(kws_event_t event, const kws_result_t *result) {
+    switch (event) {
+    case KWS_EVENT_DETECTED:
+        ESP_LOGI(TAG, "Wake word (template %d, score %u)", result->template_index, result->score);
+        s_detections++;
+        s_detected = true;
+        break;
+    case KWS_EVENT_ENROLLED:
+        ESP_LOGI(TAG, "Template %d enrolled, threshold %u",
+                 result->template_index, kws_calibrate(s_kws));
+        save_templates();
+        break;
+    case KWS_EVENT_ENROLL_FAILED:
+        ESP_LOGW(TAG, "Enrollment failed, say the wake word once after starting enrollment");
+        break;
+    default:
+        break;
+    }
+}
+
+static void wake_word_task(void *pvParameters) {
+    audio_ring_t *ring = audio_capture_get_ring();
+    int reader = audio_ring_reader_open(ring);
+    if (reader < 0) {
+        ESP_LOGE(TAG, "No free capture ring reader");
+        s_task_handle = NULL;
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "Wake word task started (%u template(s))", (unsigned)kws_template_count(s_kws));
+
+    int16_t block[AUDIO_CAPTURE_FRAME_SAMPLES];
+    bool paused = true;
+    uint32_t window_samples = 0;
+    int64_t window_us = 0;
+
+    for (;;) {
+        // Never listen to our own recording, nor to playback unless its echo
+        // is cancelled; drop that audio
+        bool wanted = s_enabled || s_enroll_request || kws_is_enrolling(s_kws);
+        bool idle = wanted && !speech_to_text_is_recording() &&
+                    (!text_to_speech_is_playing() || audio_capture_is_echo_cancel_enabled());
+        size_t avail = audio_ring_available(ring, reader);
+        if (!idle) {
+            audio_ring_consume(ring, reader, avail);
+            paused = true;
+            vTaskDelay(pdMS_TO_TICKS(WAKE_POLL_MS * 2));
+            continue;
+        }
+        if (paused) {
+            // Alignments and means from before the pause no longer apply
+            kws_reset(s_kws);
+            paused = false;
+        }
+
+        if (s_clear_request) {
+            s_clear_request = false;
+            kws_enroll_cancel(s_kws);
+            kws_clear_templates(s_kws);
+            save_templates();
+        }
+        if (s_enroll_request) {
+            s_enroll_request = false;
+            kws_enroll_begin(s_kws);
+        }
+
+        if (avail < AUDIO_CAPTURE_FRAME_SAMPLES) {
+            vTaskDelay(pdMS_TO_TICKS(WAKE_POLL_MS));
+            continue;
+        }
+
+        size_t n = audio_ring_read(ring, reader, block, AUDIO_CAPTURE_FRAME_SAMPLES);
+        int64_t t0 = esp_timer_get_time();
+        kws_result_t result;
+        kws_event_t event = kws_process(s_kws, block, n, &result);
+        window_us += esp_timer_get_time() - t0;
+        handle_event(event, &result);
+
+        window_samples += n;
+        if (window_samples >= WAKE_STATS_WINDOW) {
+            s_us_per_second = (uint32_t)(window_us * AUDIO_CAPTURE_SAMPLE_RATE / window_samples);
+            kws_stats_t st;
+            kws_get_stats(s_kws, &st);
+            s_best_score = st.best_score;
+            window_samples = 0;
+            window_us = 0;
+        }
+    }
+}
+
+extern "C" {
+
+esp_err_t wake_word_init(void) {
+    if (s_kws) {
+        ESP_LOGW(TAG, "Wake word already initialized");
+        return ESP_OK;
+    }
+    if (!audio_capture_get_ring()) {
+        ESP_LOGE(TAG, "Audio capture not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_kws = kws_create(AUDIO_CAPTURE_SAMPLE_RATE, NULL);
+    if (!s_kws) {
+        ESP_LOGE(TAG, "Failed to create keyword spotter");
+        return ESP_ERR_NO_MEM;
+    }
+    load_templates();
+
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        wake_word_task,
+        "wake_word",
+        WAKE_TASK_STACK,
+        NULL,
+        WAKE_TASK_PRIORITY,
+        &s_task_handle,
+        WAKE_TASK_CORE
+    );
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create wake word task");
+        kws_destroy(s_kws);
+        s_kws = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    audio_capture_set_listening(true);
+    if (kws_template_count(s_kws) == 0) {
+        ESP_LOGI(TAG, "No wake word enrolled yet");
+    }
+    return ESP_OK;
+}
+
+void wake_word_set_enabled(bool enabled) {
+    s_enabled = enabled;
+    ESP_LOGI(TAG, "Wake word %s", enabled ? "enabled" : "disabled");
+}
+
+bool wake_word_is_enabled(void) {
+    return s_enabled;
+}
+
+bool wake_word_poll(void) {
+    if (!s_detected) return false;
+    s_detected = false;
+    return true;
+}
+
+esp_err_t wake_word_enroll(void) {
+    if (!s_kws || !s_task_handle) return ESP_ERR_INVALID_STATE;
+    if (kws_template_count(s_kws) >= KWS_MAX_TEMPLATES) return ESP_ERR_NO_MEM;
+    s_enroll_request = true;
+    ESP_LOGI(TAG, "Say the wake word now");
+    return ESP_OK;
+}
+
+esp_err_t wake_word_clear(void) {
+    if (!s_kws || !s_task_handle) return ESP_ERR_INVALID_STATE;
+    s_clear_request = true;
+    return ESP_OK;
+}
+
+void wake_word_get_stats(wake_word_stats_t *stats) {
+    if (!stats) return;
+    stats->enabled = s_enabled;
+    stats->enrolling = s_kws && kws_is_enrolling(s_kws);
+    stats->templates = (uint8_t)kws_template_count(s_kws);
+    stats->threshold = kws_get_threshold(s_kws);
+    stats->detections = s_detections;
+    stats->us_per_second = s_us_per_second;
+    stats->best_score = s_best_score;
+}
+
+} // extern "C"
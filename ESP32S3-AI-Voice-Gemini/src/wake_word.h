@@ -0,0 +1,62 @@
+#ifndef WAKE_WORD_H
+#define WAKE_WORD_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hands-free wake word on top of the always-listening capture ring.
+ *
+ * A task on core 0 reads the ring with its own reader and runs the keyword
+ * spotter (see kws.h) on every 20 ms frame. It pauses while a recording is
+ * in progress or TTS is playing. Templates are enrolled by speaking the
+ * wake word after wake_word_enroll() and are kept in NVS.
+ */
+
+typedef struct {
+    bool enabled;
+    bool enrolling;
+    uint8_t templates;
+    uint16_t threshold;
+    uint16_t best_score;        // Closest match within the last second of audio
+    uint32_t detections;
+    uint32_t us_per_second;     // CPU time per second of audio
+} wake_word_stats_t;
+
+/**
+ * @brief Load templates, turn on always-listening and start the task.
+ *        Call after speech_to_text_init().
+ */
+esp_err_t wake_word_init(void);
+
+void wake_word_set_enabled(bool enabled);
+bool wake_word_is_enabled(void);
+
+/**
+ * @brief Consume a pending detection. Poll from the UI loop and start a
+ *        recording when it returns true.
+ */
+bool wake_word_poll(void);
+
+/**
+ * @brief Store the next utterance as a template. With two or more
+ *        templates the threshold is recalibrated from their spread.
+ */
+esp_err_t wake_word_enroll(void);
+
+/**
+ * @brief Delete all templates, in memory and in NVS.
+ */
+esp_err_t wake_word_clear(void);
+
+void wake_word_get_stats(wake_word_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // WAKE_WORD_H
@@ -4,10 +4,14 @@
 #include "ui_manager.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
+#include <time.h>
 
 static const char *TAG = "WIFI_MGR";
 static bool s_wifi_connected = false;
 
+// Any earlier time means SNTP has not set the clock yet
+#define CLOCK_SET_AFTER 1704067200     // 2024-01-01
+
 extern "C" {
 
 void wifi_manager_init(void) {
@@ -45,6 +49,9 @@ esp_err_t wifi_manager_connect(const char *ssid, const char *password) {
         s_wifi_connected = true;
         logi(TAG, "Connected with IP: %s", WiFi.localIP().toString().c_str());
         
+        // Wall-clock time for cache expiry; SNTP sets it in the background
+        configTime(0, 0, "pool.ntp.org", "time.google.com");
+        
         // ✅ Test internet connectivity
         delay(3000);
         HTTPClient test_http;
@@ -84,4 +91,9 @@ bool wifi_manager_wait_connected(uint32_t timeout_ms) {
     return false;
 }
 
+uint32_t wifi_manager_unix_time(void) {
+    time_t now = time(NULL);
+    return now >= CLOCK_SET_AFTER ? (uint32_t)now : 0;
+}
+
 } // extern "C"
\ No newline at end of file
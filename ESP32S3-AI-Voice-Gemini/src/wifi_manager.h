@@ -17,6 +17,11 @@ esp_err_t wifi_manager_connect(const char *ssid, const char *password);
 bool wifi_manager_is_connected(void);
 bool wifi_manager_wait_connected(uint32_t timeout_ms);
 
+/**
+ * @brief Unix time from SNTP, started on connect; 0 until the clock is set.
+ */
+uint32_t wifi_manager_unix_time(void);
+
 #ifdef __cplusplus
 }
 #endif
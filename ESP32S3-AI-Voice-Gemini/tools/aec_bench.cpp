@@ -0,0 +1,358 @@
+// tools/aec_bench.cpp - Host test and benchmark for src/aec (echo canceller)
+//
+// Builds synthetic echo fixtures: formant "speech" on the far end played
+// through a random decaying room response, plus mic noise, a stretch of
+// near-end speech over the echo (double talk) and a change of echo path.
+// Checks the echo return loss enhancement (ERLE), convergence time, that
+// near-end speech survives double talk, that the mic passes through
+// untouched while the speaker is silent, and reports the cost per 20 ms
+// frame.
+//
+// With WAV files (16-bit mono at 16 kHz, already time aligned), runs the
+// canceller on a recording and reports the ERLE it measures itself:
+//   ./aec_bench far.wav mic.wav [out.wav]
+// The synthetic signals can be written out as fixtures with:
+//   ./aec_bench --fixtures DIR
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src aec_bench.cpp ../src/aec.cpp -o aec_bench
+//   ./aec_bench
+//
+// Exits non-zero if a check fails.
+
+#include "aec.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define RATE            16000
+#define BLOCK           320         // Same 20 ms blocks the capture task feeds
+
+static int s_failures = 0;
+
+typedef std::vector<int16_t> pcm_t;
+
+static void check(const char *what, double value, double lo, double hi) {
+    bool ok = value >= lo && value <= hi;
+    printf("    %-44s %8.1f [%g .. %g] %s\n", what, value, lo, hi, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static float frand() {
+    return (float)rand() / RAND_MAX;
+}
+
+static float gauss() {
+    return (frand() + frand() + frand() - 1.5f) * 2.0f;
+}
+
+static int16_t clip16(float v) {
+    return (int16_t)fmaxf(-32768, fminf(32767, v));
+}
+
+// ---- Fixtures --------------------------------------------------------------
+
+struct resonator {
+    float y1 = 0, y2 = 0;
+    float step(float x, float f, float bw) {
+        float r = expf(-(float)M_PI * bw / RATE);
+        float a1 = 2 * r * cosf(2 * (float)M_PI * f / RATE), a2 = -r * r;
+        float y = (1 - r) * x + a1 * y1 + a2 * y2;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+// Continuous formant speech, a new vowel every syl_ms, from sample start
+// to end of a buffer of length n
+static std::vector<float> synth_speech(size_t n, size_t start, size_t end, float syl_ms,
+                                       float pitch, float amp) {
+    static const float F[][3] = {
+        { 730, 1090, 2440 }, { 270, 2290, 3010 }, { 300, 870, 2240 },
+        { 530, 1840, 2480 }, { 570, 840, 2410 },
+    };
+    std::vector<float> y(n, 0.0f);
+    resonator r1, r2, r3;
+    float phase = 0;
+    const size_t syl = (size_t)(syl_ms * RATE / 1000);
+    int v = 0;
+    for (size_t i = start; i < end && i < n; i++) {
+        if ((i - start) % syl == 0) v = rand() % 5;
+        float env = sinf((float)M_PI * ((i - start) % syl) / syl);
+        phase += pitch * (1.0f + 0.1f * sinf(5.0f * i / RATE)) / RATE;
+        float src = 0;
+        if (phase >= 1) {
+            phase -= 1;
+            src = 1;
+        }
+        float s = r1.step(src, F[v][0], 80) + 0.5f * r2.step(src, F[v][1], 100) + 0.25f * r3.step(src, F[v][2], 150);
+        y[i] = s * (0.3f + 0.7f * env) * amp;
+    }
+    return y;
+}
+
+// Room response: a bulk delay, then exponentially decaying noise
+static std::vector<float> room_response(size_t delay, size_t length, float gain) {
+    std::vector<float> h(delay + length, 0.0f);
+    double e = 0;
+    for (size_t k = 0; k < length; k++) {
+        h[delay + k] = gauss() * expf(-6.9f * k / length);     // -60 dB at the end
+        e += h[delay + k] * h[delay + k];
+    }
+    for (auto &v : h) v *= gain / (float)sqrt(e);
+    return h;
+}
+
+static std::vector<float> convolve(const std::vector<float> &x, const std::vector<float> &h,
+                                   size_t from, size_t to) {
+    std::vector<float> y(x.size(), 0.0f);
+    for (size_t i = from; i < to && i < x.size(); i++) {
+        float acc = 0;
+        for (size_t k = 0; k < h.size() && k <= i; k++) acc += h[k] * x[i - k];
+        y[i] = acc;
+    }
+    return y;
+}
+
+struct fixture {
+    pcm_t far, mic;
+    std::vector<float> echo, near;      // Components of mic, for scoring
+    size_t dt_start, dt_end;            // Double talk
+    size_t path_change;
+    size_t far_end;                     // Far end silent from here on
+};
+
+// 0-10 s far end only, 6-8 s near-end speech on top, path changes at
+// 10 s, far end again until 14 s, then near end alone until 16 s
+static fixture make_fixture() {
+    fixture f;
+    const size_t n = 16 * RATE;
+    f.dt_start = 6 * RATE;
+    f.dt_end = 8 * RATE;
+    f.path_change = 10 * RATE;
+    f.far_end = 14 * RATE;
+
+    std::vector<float> farf = synth_speech(n, 0, f.far_end, 150, 120, 30000);
+    f.far.resize(n);
+    for (size_t i = 0; i < n; i++) f.far[i] = clip16(farf[i]);
+    std::vector<float> farq(f.far.begin(), f.far.end());
+
+    std::vector<float> h1 = room_response(40, 240, 0.8f), h2 = room_response(60, 240, 0.6f);
+    std::vector<float> e1 = convolve(farq, h1, 0, f.path_change);
+    std::vector<float> e2 = convolve(farq, h2, f.path_change, n);
+    std::vector<float> near_dt = synth_speech(n, f.dt_start, f.dt_end, 110, 210, 9000);
+    std::vector<float> near_end = synth_speech(n, f.far_end, n, 110, 210, 9000);
+
+    f.echo.resize(n);
+    f.near.resize(n);
+    f.mic.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        f.echo[i] = i < f.path_change ? e1[i] : e2[i];
+        f.near[i] = near_dt[i] + near_end[i];
+        f.mic[i] = clip16(f.echo[i] + f.near[i] + 10 * gauss());
+    }
+    return f;
+}
+
+// ---- Scoring ---------------------------------------------------------------
+
+static double run_aec(aec_t *aec, const pcm_t &far, pcm_t &mic) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < mic.size(); i += BLOCK) {
+        size_t n = mic.size() - i < BLOCK ? mic.size() - i : BLOCK;
+        aec_process(aec, far.data() + i, mic.data() + i, n);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Echo left in the output over [from, to): output minus the near-end part
+static double erle_db(const fixture &f, const pcm_t &out, size_t from, size_t to) {
+    double e = 0, r = 0;
+    for (size_t i = from; i < to; i++) {
+        double res = out[i] - f.near[i];
+        e += f.echo[i] * f.echo[i];
+        r += res * res;
+    }
+    return 10 * log10(e / (r + 1e-9));
+}
+
+// First time after from where 100 ms windows reach the given ERLE
+static double converge_ms(const fixture &f, const pcm_t &out, size_t from, double target) {
+    const size_t win = RATE / 10;
+    for (size_t i = from; i + win <= out.size(); i += win / 4) {
+        if (erle_db(f, out, i, i + win) >= target) return (i - from) * 1000.0 / RATE;
+    }
+    return 1e9;
+}
+
+static void test_fixture() {
+    fixture f = make_fixture();
+    aec_config_t cfg;
+    aec_config_default(&cfg, RATE);
+    aec_t *aec = aec_create(&cfg);
+    pcm_t out = f.mic;
+    double cpu = run_aec(aec, f.far, out);
+
+    printf("Single talk\n");
+    check("time to 10 dB ERLE, ms", converge_ms(f, out, 0, 10), 0, 500);
+    check("ERLE 2-6 s, dB", erle_db(f, out, 2 * RATE, f.dt_start), 20, 99);
+
+    printf("Double talk\n");
+    double s = 0, d = 0;
+    for (size_t i = f.dt_start; i < f.dt_end; i++) {
+        s += f.near[i] * f.near[i];
+        d += (out[i] - f.near[i]) * (out[i] - f.near[i]);
+    }
+    // Unprocessed, the near end is 8 dB below the echo
+    check("near end over residual during double talk, dB", 10 * log10(s / d), 5, 99);
+    check("ERLE 8-10 s, after double talk, dB", erle_db(f, out, f.dt_end, f.path_change), 20, 99);
+
+    printf("Echo path change\n");
+    check("time to 10 dB ERLE again, ms", converge_ms(f, out, f.path_change, 10), 0, 800);
+    check("ERLE 12-14 s, dB", erle_db(f, out, f.path_change + 2 * RATE, f.far_end), 20, 99);
+
+    printf("Speaker silent\n");
+    size_t untouched = 0, quiet_from = f.far_end + cfg.taps;
+    for (size_t i = quiet_from; i < out.size(); i++) untouched += out[i] == f.mic[i];
+    check("mic samples passed through unchanged, %", 100.0 * untouched / (out.size() - quiet_from), 100, 100);
+
+    aec_stats_t st;
+    aec_get_stats(aec, &st);
+    printf("    canceller: ERLE estimate %.1f dB, %u copies, %u resets\n",
+           st.erle_db10 / 10.0, st.copies, st.resets);
+
+    printf("Cost (%u taps)\n", cfg.taps);
+    double active_s = (double)f.far_end / RATE;
+    double us_frame = cpu / (active_s * RATE / BLOCK) * 1e6;
+    printf("    %.1f us per 20 ms frame with the speaker active, %.4fx real time\n",
+           us_frame, cpu / active_s);
+    check("host cost per frame, us", us_frame, 0, 2000);
+    aec_destroy(aec);
+}
+
+// ---- WAV files -------------------------------------------------------------
+
+static bool load_wav(const char *path, pcm_t &out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t hdr[12];
+    bool ok = fread(hdr, 1, 12, f) == 12 && !memcmp(hdr, "RIFF", 4) && !memcmp(hdr + 8, "WAVE", 4);
+    uint16_t channels = 0, bits = 0;
+    uint32_t rate = 0;
+    while (ok) {
+        uint8_t ch[8];
+        if (fread(ch, 1, 8, f) != 8) { ok = false; break; }
+        uint32_t size = ch[4] | ch[5] << 8 | ch[6] << 16 | (uint32_t)ch[7] << 24;
+        if (!memcmp(ch, "fmt ", 4)) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16) { ok = false; break; }
+            channels = fmt[2] | fmt[3] << 8;
+            rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            bits = fmt[14] | fmt[15] << 8;
+            fseek(f, size - 16 + (size & 1), SEEK_CUR);
+        } else if (!memcmp(ch, "data", 4)) {
+            if (channels != 1 || bits != 16 || rate != RATE) {
+                fprintf(stderr, "%s: need 16-bit mono %d Hz\n", path, RATE);
+                ok = false;
+                break;
+            }
+            out.resize(size / 2);
+            out.resize(fread(out.data(), 2, out.size(), f));
+            break;
+        } else {
+            fseek(f, size + (size & 1), SEEK_CUR);
+        }
+    }
+    fclose(f);
+    return ok && !out.empty();
+}
+
+static bool save_wav(const char *path, const pcm_t &x) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    uint32_t data = (uint32_t)x.size() * 2, riff = 36 + data, fmt_size = 16, rate = RATE, bps = RATE * 2;
+    uint16_t pcm = 1, channels = 1, align = 2, bits = 16;
+    fwrite("RIFF", 1, 4, f);
+    fwrite(&riff, 4, 1, f);
+    fwrite("WAVEfmt ", 1, 8, f);
+    fwrite(&fmt_size, 4, 1, f);
+    fwrite(&pcm, 2, 1, f);
+    fwrite(&channels, 2, 1, f);
+    fwrite(&rate, 4, 1, f);
+    fwrite(&bps, 4, 1, f);
+    fwrite(&align, 2, 1, f);
+    fwrite(&bits, 2, 1, f);
+    fwrite("data", 1, 4, f);
+    fwrite(&data, 4, 1, f);
+    bool ok = fwrite(x.data(), 2, x.size(), f) == x.size();
+    return fclose(f) == 0 && ok;
+}
+
+static int run_files(int argc, char **argv) {
+    pcm_t far, mic;
+    if (!load_wav(argv[1], far) || !load_wav(argv[2], mic)) {
+        fprintf(stderr, "cannot read %s or %s\n", argv[1], argv[2]);
+        return 1;
+    }
+    far.resize(mic.size(), 0);
+
+    aec_config_t cfg;
+    aec_config_default(&cfg, RATE);
+    aec_t *aec = aec_create(&cfg);
+    pcm_t out = mic;
+    double cpu = run_aec(aec, far, out);
+    aec_stats_t st;
+    aec_get_stats(aec, &st);
+
+    double pm = 0, po = 0;
+    for (size_t i = 0; i < mic.size(); i++) {
+        pm += (double)mic[i] * mic[i];
+        po += (double)out[i] * out[i];
+    }
+    printf("%s: ERLE estimate %.1f dB, output %.1f dB below mic overall, %u copies, %u resets\n",
+           argv[2], st.erle_db10 / 10.0, 10 * log10(pm / (po + 1e-9)), st.copies, st.resets);
+    printf("    %.1f us per 20 ms frame\n", cpu / ((double)mic.size() / BLOCK) * 1e6);
+    aec_destroy(aec);
+
+    if (argc > 3) {
+        if (!save_wav(argv[3], out)) {
+            fprintf(stderr, "cannot write %s\n", argv[3]);
+            return 1;
+        }
+        printf("    output written to %s\n", argv[3]);
+    }
+    return 0;
+}
+
+static int write_fixtures(const char *dir) {
+    fixture f = make_fixture();
+    pcm_t near(f.near.size());
+    for (size_t i = 0; i < near.size(); i++) near[i] = clip16(f.near[i]);
+    std::string d(dir);
+    if (!save_wav((d + "/far.wav").c_str(), f.far) || !save_wav((d + "/mic.wav").c_str(), f.mic) ||
+        !save_wav((d + "/near.wav").c_str(), near)) {
+        fprintf(stderr, "cannot write fixtures to %s\n", dir);
+        return 1;
+    }
+    printf("wrote far.wav, mic.wav and near.wav to %s\n", dir);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && !strcmp(argv[1], "--fixtures")) return write_fixtures(argv[2]);
+    if (argc > 2) return run_files(argc, argv);
+    srand(1);
+
+    test_fixture();
+
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
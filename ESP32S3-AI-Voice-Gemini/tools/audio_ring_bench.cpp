@@ -0,0 +1,284 @@
+// tools/audio_ring_bench.cpp - Host checks and benchmark for src/audio_ring
+//
+// Checks the counters the ring reports: a reader that stops reading holds
+// the producer back until its slot is full, after which every push that
+// does not fit counts one overrun and the samples it loses as dropped;
+// short reads count underruns. A fast reader next to the slow one gets
+// every accepted sample in order. Then a producer and a reader run on two
+// threads, and every sample pushed is either read, in order, or counted
+// as dropped. A lossy reader that stops reading is skipped ahead instead
+// of holding the producer back, loses exactly the samples it is told it
+// lost, and on two threads never returns a run torn by the producer.
+// Reports push/read throughput in samples/us.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src audio_ring_bench.cpp ../src/audio_ring.cpp -lpthread -o audio_ring_bench
+//   ./audio_ring_bench
+//
+// Exits non-zero if a check fails.
+
+#include "audio_ring.h"
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define CAPACITY        1024
+#define PUSH_SAMPLES    100
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static void fill(int16_t *buf, size_t n, uint32_t *next) {
+    for (size_t i = 0; i < n; i++) buf[i] = (int16_t)(*next)++;
+}
+
+static void test_counters() {
+    printf("Counters\n");
+    audio_ring_t *ring = audio_ring_create(1000);
+    check("capacity rounded up to a power of two", audio_ring_capacity(ring) == CAPACITY);
+
+    int fast = audio_ring_reader_open(ring);
+    int slow = audio_ring_reader_open(ring);
+    check("two readers open", fast >= 0 && slow >= 0 && fast != slow);
+
+    // 15 pushes of 100: the slow reader fills after 1024 samples. The push
+    // that crosses the limit and the 4 after it lose samples.
+    int16_t chunk[PUSH_SAMPLES], out[CAPACITY];
+    uint32_t next = 0, expect = 0;
+    size_t accepted = 0;
+    bool in_order = true;
+    for (int i = 0; i < 15; i++) {
+        fill(chunk, PUSH_SAMPLES, &next);
+        accepted += audio_ring_push(ring, chunk, PUSH_SAMPLES);
+        size_t n = audio_ring_read(ring, fast, out, audio_ring_available(ring, fast));
+        for (size_t k = 0; k < n; k++) in_order = in_order && out[k] == (int16_t)expect++;
+    }
+    audio_ring_stats_t st;
+    audio_ring_get_stats(ring, &st);
+    check("slow reader full: pushes stop at capacity", accepted == CAPACITY && st.pushed == CAPACITY);
+    check("5 overruns, 476 samples dropped", st.overruns == 5 && st.dropped == 1500 - CAPACITY);
+    check("fast reader got every accepted sample in order", in_order && expect == CAPACITY);
+    check("no underruns yet", st.underruns == 0);
+
+    // The slow reader catches up on 300: room for 300 more
+    size_t n = audio_ring_read(ring, slow, out, 300);
+    bool slow_ok = n == 300;
+    for (size_t k = 0; k < n; k++) slow_ok = slow_ok && out[k] == (int16_t)k;
+    fill(chunk, PUSH_SAMPLES, &next);
+    size_t a = audio_ring_push(ring, chunk, PUSH_SAMPLES);
+    size_t b = audio_ring_push(ring, chunk, PUSH_SAMPLES);
+    size_t c = audio_ring_push(ring, chunk, PUSH_SAMPLES);
+    size_t d = audio_ring_push(ring, chunk, PUSH_SAMPLES);
+    audio_ring_get_stats(ring, &st);
+    check("slow reader reads the oldest samples", slow_ok);
+    check("room freed by the slow reader is used again",
+          a + b + c + d == 300 && st.pushed == CAPACITY + 300 && st.overruns == 6 &&
+              st.dropped == 1500 - CAPACITY + 100);
+
+    // Underruns: a read asking for more than is there
+    audio_ring_read(ring, fast, out, audio_ring_available(ring, fast));
+    audio_ring_get_stats(ring, &st);
+    uint32_t before = st.underruns;
+    size_t got = audio_ring_read(ring, fast, out, 10);
+    audio_ring_read(ring, slow, out, 5);
+    audio_ring_get_stats(ring, &st);
+    check("read from an empty reader: 1 underrun, nothing read", got == 0 && st.underruns == before + 1);
+
+    audio_ring_reader_close(ring, slow);
+    check("closed slow reader no longer holds the producer",
+          audio_ring_push(ring, chunk, PUSH_SAMPLES) == PUSH_SAMPLES);
+
+    audio_ring_reset_stats(ring);
+    audio_ring_get_stats(ring, &st);
+    check("reset clears every counter",
+          st.pushed == 0 && st.overruns == 0 && st.dropped == 0 && st.underruns == 0 &&
+              st.skipped == 0);
+
+    check("history limited to half the ring", audio_ring_history(ring) == CAPACITY / 2);
+    int late = audio_ring_reader_open_at(ring, 10000);
+    check("reader opened with history sees half the ring",
+          late >= 0 && audio_ring_available(ring, late) == CAPACITY / 2);
+    audio_ring_reader_close(ring, late);
+    audio_ring_reader_close(ring, fast);
+    audio_ring_destroy(ring);
+}
+
+// A producer and a reader on two threads: everything pushed is read in
+// order or counted as dropped
+static void test_threads() {
+    printf("Producer and reader on two threads\n");
+    const uint32_t total = 2000000;
+    audio_ring_t *ring = audio_ring_create(4096);
+    int reader = audio_ring_reader_open(ring);
+    std::atomic<bool> done{false};
+    uint32_t attempted = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread producer([&] {
+        int16_t chunk[160];
+        uint32_t next = 0;
+        while (next < total) {
+            uint32_t base = next;
+            size_t want = total - next < 160 ? total - next : 160;
+            fill(chunk, want, &next);
+            size_t n = audio_ring_push(ring, chunk, want);
+            next = base + (uint32_t)n;     // Dropped samples are pushed again
+            attempted += (uint32_t)want;
+            if (n < want) std::this_thread::yield();
+        }
+        done = true;
+    });
+
+    uint32_t expect = 0;
+    bool in_order = true;
+    size_t reads = 0;
+    int16_t out[512];
+    for (;;) {
+        bool finished = done.load();
+        size_t n = audio_ring_read(ring, reader, out, sizeof(out) / sizeof(out[0]));
+        for (size_t k = 0; k < n; k++) in_order = in_order && out[k] == (int16_t)expect++;
+        reads++;
+        if (finished && audio_ring_available(ring, reader) == 0) break;
+        if (n == 0) std::this_thread::yield();
+    }
+    producer.join();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+    audio_ring_stats_t st;
+    audio_ring_get_stats(ring, &st);
+    check("every sample read once, in order", in_order && expect == total && st.pushed == total);
+    check("pushes that did not fit counted as dropped", attempted - st.pushed == st.dropped);
+    printf("    %u samples through a 4096 sample ring: %.1f samples/us "
+           "(%u overruns, %u underruns in %zu reads)\n",
+           total, total / us, (unsigned)st.overruns, (unsigned)st.underruns, reads);
+    audio_ring_destroy(ring);
+}
+
+// A lossy reader that stops reading next to a fast full reader
+static void test_lossy() {
+    printf("Lossy reader\n");
+    audio_ring_t *ring = audio_ring_create(CAPACITY);
+    int fast = audio_ring_reader_open(ring);
+    int lossy = audio_ring_reader_open_lossy(ring, 0);
+    check("full and lossy reader open", fast >= 0 && lossy >= 0);
+
+    // The same 15 pushes of 100 as above: nothing is dropped this time, the
+    // lossy reader is moved past the 476 oldest samples
+    int16_t chunk[PUSH_SAMPLES], out[CAPACITY];
+    uint32_t next = 0, expect = 0;
+    bool in_order = true;
+    for (int i = 0; i < 15; i++) {
+        fill(chunk, PUSH_SAMPLES, &next);
+        audio_ring_push(ring, chunk, PUSH_SAMPLES);
+        size_t n = audio_ring_read(ring, fast, out, audio_ring_available(ring, fast));
+        for (size_t k = 0; k < n; k++) in_order = in_order && out[k] == (int16_t)expect++;
+    }
+    audio_ring_stats_t st;
+    audio_ring_get_stats(ring, &st);
+    check("producer never held back: 1500 pushed, none dropped",
+          st.pushed == 1500 && st.overruns == 0 && st.dropped == 0);
+    check("full reader got every sample in order", in_order && expect == 1500);
+    check("lossy reader skipped the 476 oldest samples",
+          audio_ring_reader_skipped(ring, lossy) == 1500 - CAPACITY && st.skipped == 1500 - CAPACITY);
+    check("and has exactly a ring's worth ready", audio_ring_available(ring, lossy) == CAPACITY);
+
+    const int16_t *s1, *s2;
+    size_t n1, n2;
+    check("peek gives a lossy reader nothing", audio_ring_peek(ring, lossy, &s1, &n1, &s2, &n2) == 0);
+
+    size_t n = audio_ring_read(ring, lossy, out, CAPACITY);
+    bool lossy_ok = n == CAPACITY;
+    for (size_t k = 0; k < n; k++) lossy_ok = lossy_ok && out[k] == (int16_t)(1500 - CAPACITY + k);
+    check("lossy reader resumes at the oldest sample kept", lossy_ok);
+
+    // Keeping up, it loses nothing more
+    for (int i = 0; i < 30; i++) {
+        fill(chunk, PUSH_SAMPLES, &next);
+        audio_ring_push(ring, chunk, PUSH_SAMPLES);
+        audio_ring_read(ring, fast, out, CAPACITY);
+        audio_ring_read(ring, lossy, out, CAPACITY);
+    }
+    check("no skips while it keeps up", audio_ring_reader_skipped(ring, lossy) == 1500 - CAPACITY);
+
+    audio_ring_consume(ring, lossy, 10);
+    check("consume past the end stays at the head", audio_ring_available(ring, lossy) == 0);
+    audio_ring_reader_close(ring, lossy);
+    audio_ring_reader_close(ring, fast);
+    audio_ring_destroy(ring);
+}
+
+// A producer that is never held back and a lossy reader that keeps
+// falling behind: every read is a contiguous run, and the gaps between
+// runs add up to the samples the ring says were skipped
+static void test_lossy_threads() {
+    printf("Producer and lossy reader on two threads\n");
+    const uint32_t total = 2000000;
+    audio_ring_t *ring = audio_ring_create(4096);
+    int reader = audio_ring_reader_open_lossy(ring, 0);
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> reads{0};
+
+    // Every 64 pushes (2.5 rings) the producer lets the reader in, so the
+    // gap between two reads stays within 16 bits of sample value
+    std::thread producer([&] {
+        int16_t chunk[160];
+        uint32_t next = 0, pushes = 0, seen = 0;
+        while (next < total) {
+            size_t want = total - next < 160 ? total - next : 160;
+            fill(chunk, want, &next);
+            audio_ring_push(ring, chunk, want);
+            if (++pushes % 64 == 0) {
+                while (reads.load() == seen) std::this_thread::yield();
+                seen = reads.load();
+            }
+        }
+        done = true;
+    });
+
+    uint32_t expect = 0, read = 0, gaps = 0;
+    bool contiguous = true;
+    int16_t out[512];
+    for (;;) {
+        bool finished = done.load();
+        size_t n = audio_ring_read(ring, reader, out, sizeof(out) / sizeof(out[0]));
+        if (n > 0) {
+            uint16_t gap = (uint16_t)(out[0] - (int16_t)expect);
+            gaps += gap;
+            expect += gap;
+            for (size_t k = 0; k < n; k++) contiguous = contiguous && out[k] == (int16_t)expect++;
+            read += (uint32_t)n;
+        }
+        if (finished && audio_ring_available(ring, reader) == 0) break;
+        if (++reads % 8 == 0) std::this_thread::yield();
+    }
+    producer.join();
+
+    audio_ring_stats_t st;
+    audio_ring_get_stats(ring, &st);
+    uint32_t skipped = audio_ring_reader_skipped(ring, reader);
+    check("nothing dropped", st.pushed == total && st.dropped == 0);
+    check("every read a contiguous run", contiguous);
+    check("gaps between runs are the samples counted as skipped", gaps == skipped && st.skipped == skipped);
+    check("read + skipped == pushed", read + skipped == total);
+    printf("    %u samples: %u read, %u skipped in %u reads\n", total, read, skipped, (unsigned)reads);
+    audio_ring_destroy(ring);
+}
+
+int main() {
+    test_counters();
+    test_threads();
+    test_lossy();
+    test_lossy_threads();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,258 @@
+// tools/base64_bench.cpp - Host checks and benchmark for src/base64_stream
+//
+// Checks the RFC 4648 vectors, then that the reference, table and
+// streaming encoders agree byte for byte over many lengths, input split
+// points and writer window sizes. Measures throughput against a port of
+// the libb64 encoder behind Arduino's base64::encode, and the peak extra
+// memory each way of uploading a 5 s, 16 kHz clip needs.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src base64_bench.cpp ../src/base64_stream.cpp -o base64_bench
+//   ./base64_bench
+//
+// Exits non-zero if any output differs.
+
+#include "base64_stream.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define BENCH_MIN_SECONDS   0.5
+#define CLIP_BYTES          (16000 * 2 * 5 + 44)
+#define SOCKET_WINDOW       1460
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-56s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+// libb64 as shipped with the Arduino core: a per-byte state machine
+static const char LIBB64_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t libb64_encode(const uint8_t *in, size_t len, char *out) {
+    const uint8_t *end = in + len;
+    char *p = out;
+    int step = 0;
+    char result = 0;
+    while (in < end) {
+        uint8_t c = *in++;
+        switch (step) {
+        case 0:
+            *p++ = LIBB64_ALPHABET[c >> 2];
+            result = (char)((c & 0x03) << 4);
+            step = 1;
+            break;
+        case 1:
+            *p++ = LIBB64_ALPHABET[(uint8_t)result | (c >> 4)];
+            result = (char)((c & 0x0F) << 2);
+            step = 2;
+            break;
+        default:
+            *p++ = LIBB64_ALPHABET[(uint8_t)result | (c >> 6)];
+            *p++ = LIBB64_ALPHABET[c & 0x3F];
+            step = 0;
+            break;
+        }
+    }
+    if (step == 1) {
+        *p++ = LIBB64_ALPHABET[(uint8_t)result];
+        *p++ = '=';
+        *p++ = '=';
+    } else if (step == 2) {
+        *p++ = LIBB64_ALPHABET[(uint8_t)result];
+        *p++ = '=';
+    }
+    return (size_t)(p - out);
+}
+
+// What base64::encode returns: a malloc'd buffer copied into a String
+static std::string arduino_encode(const uint8_t *in, size_t len) {
+    char *buf = (char *)malloc(BASE64_ENCODED_SIZE(len) + 1);
+    size_t n = libb64_encode(in, len, buf);
+    buf[n] = '\0';
+    std::string s(buf);
+    free(buf);
+    return s;
+}
+
+struct Sink {
+    std::string data;
+    size_t calls;
+    size_t largest;             // Longest single write
+    size_t fail_after;          // Write call that fails, 0 for never
+};
+
+static bool sink_write(void *ctx, const char *data, size_t len) {
+    Sink *s = (Sink *)ctx;
+    if (++s->calls == s->fail_after) return false;
+    if (len > s->largest) s->largest = len;
+    s->data.append(data, len);
+    return true;
+}
+
+// Stands in for a socket: touches every byte so nothing is optimised away
+static bool null_write(void *ctx, const char *data, size_t len) {
+    uint32_t *sum = (uint32_t *)ctx;
+    for (size_t i = 0; i < len; i += 64) *sum += (uint8_t)data[i];
+    return true;
+}
+
+static std::string encode_with(void (*groups_fn)(const uint8_t *, size_t, char *),
+                               const std::vector<uint8_t> &in) {
+    size_t groups = in.size() / 3;
+    std::string out(BASE64_ENCODED_SIZE(in.size()), '\0');
+    groups_fn(in.data(), groups, &out[0]);
+    if (in.size() % 3) {
+        base64_encode(in.data() + groups * 3, in.size() % 3, &out[groups * 4]);
+    }
+    return out;
+}
+
+static void test_vectors() {
+    printf("RFC 4648 vectors\n");
+    static const char *const plain[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar", "Man"};
+    static const char *const coded[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=",
+                                        "Zm9vYmFy", "TWFu"};
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(plain) / sizeof(plain[0]); i++) {
+        char out[16];
+        size_t n = base64_encode(plain[i], strlen(plain[i]), out);
+        ok = ok && n == strlen(coded[i]) && memcmp(out, coded[i], n) == 0;
+    }
+    check("base64_encode", ok);
+}
+
+static void test_agreement() {
+    printf("Agreement with libb64\n");
+    srand(1);
+    bool ref_ok = true, table_ok = true, stream_ok = true;
+    for (size_t len = 0; len <= 600; len++) {
+        std::vector<uint8_t> in(len);
+        for (size_t i = 0; i < len; i++) in[i] = (uint8_t)rand();
+        std::string want = arduino_encode(in.data(), len);
+
+        ref_ok = ref_ok && encode_with(base64_encode_groups_ref, in) == want;
+        table_ok = table_ok && encode_with(base64_encode_groups_table, in) == want;
+
+        // Every split into two pieces, like the two spans of a ring peek
+        for (size_t cut = 0; cut <= len && len <= 64; cut++) {
+            std::string got(BASE64_ENCODED_SIZE(len + 4), '\0');
+            base64_stream_t st;
+            base64_stream_init(&st);
+            size_t n = base64_stream_update(&st, in.data(), cut, &got[0]);
+            n += base64_stream_update(&st, in.data() + cut, len - cut, &got[n]);
+            n += base64_stream_finish(&st, &got[n]);
+            got.resize(n);
+            stream_ok = stream_ok && got == want;
+        }
+    }
+    check("base64_encode_groups_ref, lengths 0..600", ref_ok);
+    check("base64_encode_groups_table, lengths 0..600", table_ok);
+    check("base64_stream, every two-piece split up to 64 bytes", stream_ok);
+}
+
+static void test_writer() {
+    printf("Writer\n");
+    std::vector<uint8_t> clip(CLIP_BYTES + 1);
+    for (size_t i = 0; i < clip.size(); i++) clip[i] = (uint8_t)(i * 2654435761u >> 13);
+    std::string want = arduino_encode(clip.data(), clip.size());
+
+    static const size_t windows[] = {4, 7, 8, 64, 1000, SOCKET_WINDOW, 4096};
+    static const size_t pieces[] = {1, 2, 3, 5, 320, 640, 1021};
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        bool ok = true;
+        size_t max_chunk = 0;
+        for (size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++) {
+            std::vector<char> window(windows[w]);
+            Sink sink = {std::string(), 0, 0, 0};
+            base64_writer_t wr;
+            ok = ok && base64_writer_init(&wr, window.data(), window.size(), sink_write, &sink);
+            for (size_t i = 0; i < clip.size(); i += pieces[p]) {
+                size_t n = clip.size() - i < pieces[p] ? clip.size() - i : pieces[p];
+                ok = ok && base64_writer_put(&wr, &clip[i], n);
+            }
+            ok = ok && base64_writer_finish(&wr) && sink.data == want && wr.written == want.size();
+            max_chunk = sink.largest > max_chunk ? sink.largest : max_chunk;
+        }
+        char label[80];
+        snprintf(label, sizeof(label), "window %u, pieces of 1..1021 bytes", (unsigned)windows[w]);
+        check(label, ok && max_chunk <= windows[w]);
+    }
+
+    char window[8];
+    base64_writer_t wr;
+    check("window of 3 chars is refused", !base64_writer_init(&wr, window, 3, sink_write, NULL));
+
+    std::vector<char> big(64);
+    Sink sink = {std::string(), 0, 0, 2};
+    base64_writer_init(&wr, big.data(), big.size(), sink_write, &sink);
+    bool put_ok = base64_writer_put(&wr, clip.data(), 1000);
+    check("failed write stops the writer",
+          !put_ok && !base64_writer_finish(&wr) && sink.calls == 2 && sink.data.size() == 64);
+}
+
+template <typename F>
+static double mb_per_sec(size_t bytes, F fn) {
+    int runs = 0;
+    double elapsed;
+    auto t0 = std::chrono::steady_clock::now();
+    do {
+        fn();
+        runs++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return (double)bytes * runs / elapsed / 1e6;
+}
+
+static void bench() {
+    std::vector<uint8_t> clip(CLIP_BYTES);
+    for (size_t i = 0; i < clip.size(); i++) clip[i] = (uint8_t)rand();
+    std::vector<char> out(BASE64_ENCODED_SIZE(clip.size()));
+    size_t groups = clip.size() / 3;
+    volatile size_t keep = 0;
+    uint32_t sum = 0;
+
+    printf("\nThroughput, %u byte clip\n", (unsigned)clip.size());
+    printf("    %-34s %8.1f MB/s\n", "libb64 + String (base64::encode)",
+           mb_per_sec(clip.size(), [&] { keep = keep + arduino_encode(clip.data(), clip.size()).size(); }));
+    printf("    %-34s %8.1f MB/s\n", "libb64 into a buffer",
+           mb_per_sec(clip.size(), [&] { keep = keep + libb64_encode(clip.data(), clip.size(), out.data()); }));
+    printf("    %-34s %8.1f MB/s\n", "base64_encode_groups_ref",
+           mb_per_sec(clip.size(), [&] { base64_encode_groups_ref(clip.data(), groups, out.data()); }));
+    printf("    %-34s %8.1f MB/s\n", "base64_encode_groups_table",
+           mb_per_sec(clip.size(), [&] { base64_encode_groups_table(clip.data(), groups, out.data()); }));
+    char window[SOCKET_WINDOW];
+    printf("    %-34s %8.1f MB/s\n", "base64_writer, 1460 char window",
+           mb_per_sec(clip.size(), [&] {
+               base64_writer_t wr;
+               base64_writer_init(&wr, window, sizeof(window), null_write, &sum);
+               base64_writer_put(&wr, clip.data(), clip.size());
+               base64_writer_finish(&wr);
+           }));
+    (void)keep;
+
+    // base64::encode holds its buffer and the String copy at the same time,
+    // and the request body is then built around the String
+    size_t enc = BASE64_ENCODED_SIZE(clip.size());
+    printf("\nPeak extra memory to upload the clip\n");
+    printf("    %-34s %8u bytes\n", "base64::encode + body String", (unsigned)(enc + 1) * 3);
+    printf("    %-34s %8u bytes\n", "base64_writer", (unsigned)(SOCKET_WINDOW & ~3u));
+}
+
+int main() {
+    test_vectors();
+    test_agreement();
+    test_writer();
+    bench();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,488 @@
+// tools/cache_bench.cpp - Host checks and benchmark for src/response_cache
+//
+// The flash is a memory stand-in with NOR rules: erase sets whole sectors to
+// 0xFF, a write can only clear bits, and a "power cut" stops a write part
+// way through. The checks cover normalizing, LRU eviction by entries and by
+// bytes, the TTL, the hash table against a reference model over random
+// operations, and persistence: a reboot restores what was flushed, a cut
+// during a flush or a compaction loses at most the entries being written,
+// and the log keeps working afterwards. The benchmark times lookups and the
+// log, then replays a skewed question mix (a dozen questions make up most
+// of it) for the hit rate and the round trips saved.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src cache_bench.cpp ../src/response_cache.cpp ../src/minhash_index.cpp -o cache_bench
+//   ./cache_bench
+//
+// Exits non-zero if a check fails.
+
+#include "response_cache.h"
+#include <chrono>
+#include <list>
+#include <map>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_sec() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint32_t T0 = 1760000000;     // Some time in 2025
+
+// ---------------------------------------------------------------------------
+// Flash stand-in
+
+struct MemFlash {
+    std::vector<uint8_t> mem;
+    uint32_t sector;
+    long cut_after = -1;            // Bytes still written before the power goes
+    bool dead = false;
+    uint32_t nor_violations = 0;    // Writes that needed a 0 turned back into a 1
+    uint64_t written = 0;
+    uint32_t erased_sectors = 0;
+    response_cache_flash_t ops;
+
+    MemFlash(uint32_t size, uint32_t sector_size) : mem(size, 0xFF), sector(sector_size) {
+        ops.size = size;
+        ops.sector_size = sector_size;
+        ops.read = read;
+        ops.write = write;
+        ops.erase = erase;
+        ops.ctx = this;
+    }
+
+    static bool read(void *ctx, uint32_t off, void *buf, size_t len) {
+        MemFlash *f = (MemFlash *)ctx;
+        if (off + len > f->mem.size()) return false;
+        memcpy(buf, &f->mem[off], len);
+        return true;
+    }
+
+    static bool write(void *ctx, uint32_t off, const void *data, size_t len) {
+        MemFlash *f = (MemFlash *)ctx;
+        if (f->dead || off + len > f->mem.size()) return false;
+        const uint8_t *p = (const uint8_t *)data;
+        for (size_t i = 0; i < len; i++) {
+            if (f->cut_after == 0) {
+                f->dead = true;
+                return false;
+            }
+            if (f->cut_after > 0) f->cut_after--;
+            if ((f->mem[off + i] & p[i]) != p[i]) f->nor_violations++;
+            f->mem[off + i] &= p[i];
+            f->written++;
+        }
+        return true;
+    }
+
+    static bool erase(void *ctx, uint32_t off, size_t len) {
+        MemFlash *f = (MemFlash *)ctx;
+        if (f->dead || off % f->sector || len % f->sector || off + len > f->mem.size()) return false;
+        memset(&f->mem[off], 0xFF, len);
+        f->erased_sectors += len / f->sector;
+        return true;
+    }
+
+    void power_on() {
+        dead = false;
+        cut_after = -1;
+    }
+};
+
+static response_cache_t *open_cache(MemFlash *f, uint16_t entries = 0, uint32_t bytes = 0, uint32_t ttl = 0) {
+    response_cache_config_t cfg = {};
+    cfg.max_entries = entries;
+    cfg.max_bytes = bytes;
+    cfg.ttl_sec = ttl;
+    cfg.flash = f ? &f->ops : nullptr;
+    return response_cache_create(&cfg);
+}
+
+static std::string get(response_cache_t *c, const char *q, uint32_t now = T0) {
+    char *a = response_cache_get(c, q, now);
+    std::string s = a ? a : "";
+    free(a);
+    return s;
+}
+
+static std::string norm(const char *text) {
+    char out[RESPONSE_CACHE_QUESTION_MAX + 1];
+    size_t n = response_cache_normalize(text, out, sizeof(out));
+    return std::string(out, n);
+}
+
+static response_cache_stats_t stats(const response_cache_t *c) {
+    response_cache_stats_t st;
+    response_cache_get_stats(c, &st);
+    return st;
+}
+
+static std::string question(int i) {
+    return "Câu hỏi số " + std::to_string(i) + " về giờ mở cửa?";
+}
+
+static std::string answer(int i, int version = 0) {
+    std::string a = "Trả lời " + std::to_string(i) + "." + std::to_string(version) + ": ";
+    while (a.size() < 150 + (size_t)(i * 37) % 200) a += "cửa hàng mở từ 8 giờ đến 22 giờ. ";
+    return a;
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+
+static void check_normalize() {
+    printf("normalize\n");
+    check("case and punctuation", norm("Xin chào!") == "xin chào" && norm("  XIN   chào... ") == "xin chào");
+    check("Vietnamese capitals", norm("MẤY GIỜ MỞ CỬA?") == norm("Mấy giờ mở cửa") &&
+                                     norm("ĐƯỜNG ĂN ƠI") == "đường ăn ơi");
+    check("curly quotes and ellipsis are spaces", norm("“Giá” bao nhiêu…") == "giá bao nhiêu");
+    check("digits kept", norm("Phòng 101, tầng 2") == "phòng 101 tầng 2");
+    check("only punctuation normalizes to nothing", norm(" ?! ") == "");
+    std::string long_q(RESPONSE_CACHE_QUESTION_MAX + 1, 'a');
+    check("too long for the key", norm(long_q.c_str()) == "");
+}
+
+static void check_memory() {
+    printf("memory\n");
+    response_cache_t *c = open_cache(nullptr, 4, 0, 3600);
+    check("miss, then hit after put", get(c, "Xin chào") == "" &&
+                                          response_cache_put(c, "Xin chào", "Chào bạn!", T0) &&
+                                          get(c, "xin chào!!") == "Chào bạn!");
+    response_cache_stats_t st = stats(c);
+    check("hit and miss counted", st.hits == 1 && st.misses == 1 && st.entries == 1);
+    check("no clock, no lookup or put", !response_cache_put(c, "a", "b", 0) && get(c, "Xin chào", 0) == "" &&
+                                            stats(c).hits == 1 && stats(c).misses == 1);
+
+    response_cache_put(c, "Xin chào", "Xin chào lần nữa", T0);
+    check("same question replaces the answer", get(c, "Xin chào") == "Xin chào lần nữa" && stats(c).entries == 1);
+
+    check("TTL: served just before it ends", get(c, "Xin chào", T0 + 3599) != "");
+    check("TTL: expired after, and dropped",
+          get(c, "Xin chào", T0 + 3600) == "" && stats(c).expired == 1 && stats(c).entries == 0);
+    check("clock behind the entry: expired", response_cache_put(c, "x", "y", T0 + 100) && get(c, "x", T0) == "");
+
+    // LRU: A is used again, so B goes first
+    for (const char *q : { "A", "B", "C", "D" }) response_cache_put(c, q, q, T0);
+    get(c, "A");
+    response_cache_put(c, "E", "E", T0);
+    check("full: the least recently used goes",
+          get(c, "A") == "A" && get(c, "B") == "" && get(c, "C") == "C" && stats(c).evicted == 1);
+
+    response_cache_note_miss(c, 800);
+    uint32_t saved = stats(c).saved_ms;
+    get(c, "E");
+    check("a hit saves one average miss", stats(c).saved_ms == saved + 800);
+
+    std::string big(RESPONSE_CACHE_ANSWER_MAX + 1, 'x');
+    check("answer over the maximum not stored", !response_cache_put(c, "big", big.c_str(), T0));
+    response_cache_destroy(c);
+
+    // Byte limit
+    c = open_cache(nullptr, 64, 1000, 3600);
+    for (int i = 0; i < 20; i++) response_cache_put(c, question(i).c_str(), answer(i).c_str(), T0);
+    st = stats(c);
+    check("byte limit holds, newest kept",
+          st.bytes <= 1000 && st.entries < 20 && get(c, question(19).c_str()) == answer(19));
+    response_cache_clear(c);
+    check("clear empties", stats(c).entries == 0 && stats(c).bytes == 0 && get(c, question(19).c_str()) == "");
+    response_cache_destroy(c);
+}
+
+// Random operations against std::map plus a use list
+static void check_model() {
+    printf("model\n");
+    const int CAP = 16;
+    response_cache_t *c = open_cache(nullptr, CAP, 1 << 20, 1000);
+    std::map<std::string, std::pair<std::string, uint32_t>> model;
+    std::list<std::string> order;   // Most recent first
+    std::mt19937 rng(7);
+    bool ok = true;
+    uint32_t now = T0;
+    for (int op = 0; op < 200000 && ok; op++) {
+        now += rng() % 3;
+        std::string q = "q" + std::to_string(rng() % 48);
+        if (rng() % 3 == 0) {
+            std::string a = "a" + std::to_string(op);
+            response_cache_put(c, q.c_str(), a.c_str(), now);
+            if (model.count(q)) order.remove(q);
+            while (model.size() >= (size_t)CAP && !model.count(q)) {
+                model.erase(order.back());
+                order.pop_back();
+            }
+            model[q] = { a, now };
+            order.push_front(q);
+        } else {
+            std::string got = get(c, q.c_str(), now);
+            std::string want;
+            auto it = model.find(q);
+            if (it != model.end()) {
+                order.remove(q);
+                if (now - it->second.second >= 1000) {
+                    model.erase(it);
+                } else {
+                    want = it->second.first;
+                    order.push_front(q);
+                }
+            }
+            ok = got == want && stats(c).entries == model.size();
+        }
+    }
+    check("200000 random puts and gets match the model", ok);
+    response_cache_destroy(c);
+}
+
+static void check_flash() {
+    printf("flash\n");
+    MemFlash f(64 * 1024, 4096);
+    response_cache_t *c = open_cache(&f, 32, 0, 3600);
+    for (int i = 0; i < 5; i++) response_cache_put(c, question(i).c_str(), answer(i).c_str(), T0);
+    check("entries wait for the flush", stats(c).pending == 5 && f.written == 0);
+    check("flush writes them", response_cache_flush(c, T0) && stats(c).pending == 0 && f.written > 0);
+    response_cache_put(c, question(5).c_str(), answer(5).c_str(), T0);
+    response_cache_destroy(c);
+
+    c = open_cache(&f, 32, 0, 3600);
+    bool ok = stats(c).loaded == 5;
+    for (int i = 0; i < 5; i++) ok = ok && get(c, question(i).c_str()) == answer(i);
+    check("reboot restores what was flushed", ok);
+    check("reboot loses what was not", get(c, question(5).c_str()) == "");
+
+    // Keep writing: the halves take turns
+    for (int round = 0; round < 40; round++) {
+        for (int i = 0; i < 8; i++) {
+            int k = (round * 5 + i) % 50;
+            response_cache_put(c, question(k).c_str(), answer(k, round).c_str(), T0 + round);
+        }
+        response_cache_flush(c, T0 + round);
+    }
+    response_cache_stats_t st = stats(c);
+    check("full half compacts into the other", st.compactions > 0 && st.flash_errors == 0);
+    std::map<std::string, std::string> before;
+    for (int k = 0; k < 50; k++) {
+        char *a = response_cache_get(c, question(k).c_str(), T0 + 40);
+        if (a) before[question(k)] = a;
+        free(a);
+    }
+    response_cache_flush(c, T0 + 40);
+    response_cache_destroy(c);
+    c = open_cache(&f, 32, 0, 3600);
+    ok = stats(c).loaded == before.size();
+    for (auto &kv : before) ok = ok && get(c, kv.first.c_str(), T0 + 40) == kv.second;
+    check("after compactions a reboot restores the same entries", ok && !before.empty());
+    check("flash only ever written where erased", f.nor_violations == 0);
+
+    // Use order survives a compaction: the oldest restored is evicted first
+    response_cache_destroy(c);
+    MemFlash g(64 * 1024, 4096);
+    c = open_cache(&g, 4, 0, 3600);
+    for (int i = 0; i < 4; i++) response_cache_put(c, question(i).c_str(), answer(i).c_str(), T0);
+    get(c, question(0).c_str());
+    response_cache_flush(c, T0);    // First flush compacts: written in use order
+    response_cache_destroy(c);
+    c = open_cache(&g, 4, 0, 3600);
+    response_cache_put(c, question(9).c_str(), answer(9).c_str(), T0);
+    check("use order restored", get(c, question(0).c_str()) != "" && get(c, question(1).c_str()) == "");
+    response_cache_destroy(c);
+
+    // Expired entries are left out of a compaction
+    MemFlash h(32 * 1024, 4096);
+    c = open_cache(&h, 64, 0, 100);
+    response_cache_put(c, "cũ", "old", T0);
+    response_cache_put(c, "mới", "new", T0 + 90);
+    response_cache_flush(c, T0 + 150);
+    response_cache_destroy(c);
+    c = open_cache(&h, 64, 0, 100);
+    check("expired entries not carried over", stats(c).loaded == 1 && get(c, "mới", T0 + 150) == "new");
+
+    response_cache_clear(c);
+    response_cache_destroy(c);
+    c = open_cache(&h, 64, 0, 100);
+    check("clear reaches the flash", stats(c).loaded == 0);
+    response_cache_destroy(c);
+
+    MemFlash tiny(8 * 1024, 4096);
+    c = open_cache(&tiny, 64, 0, 100);
+    check("flash too small for one entry: memory only",
+          stats(c).log_size == 0 && response_cache_put(c, "a", "b", T0) && response_cache_flush(c, T0));
+    response_cache_destroy(c);
+}
+
+// Cut the power at every point of a flush and of a compaction
+static void check_power_cuts() {
+    printf("power cuts\n");
+    bool appends_ok = true, compact_ok = true, recovers = true;
+    for (long cut = 0; cut < 2000; cut += 7) {
+        MemFlash f(64 * 1024, 4096);
+        response_cache_t *c = open_cache(&f, 32, 0, 3600);
+        for (int i = 0; i < 3; i++) response_cache_put(c, question(i).c_str(), answer(i).c_str(), T0);
+        response_cache_flush(c, T0);
+        for (int i = 3; i < 6; i++) response_cache_put(c, question(i).c_str(), answer(i).c_str(), T0);
+        f.cut_after = cut;
+        response_cache_flush(c, T0);
+        response_cache_destroy(c);
+
+        // Back up: the first three for sure, any of the rest whole or not at all
+        f.power_on();
+        c = open_cache(&f, 32, 0, 3600);
+        for (int i = 0; i < 3; i++) appends_ok = appends_ok && get(c, question(i).c_str()) == answer(i);
+        for (int i = 3; i < 6; i++) {
+            std::string a = get(c, question(i).c_str());
+            appends_ok = appends_ok && (a.empty() || a == answer(i));
+        }
+        response_cache_put(c, question(9).c_str(), answer(9).c_str(), T0);
+        recovers = recovers && response_cache_flush(c, T0);
+        response_cache_destroy(c);
+        c = open_cache(&f, 32, 0, 3600);
+        recovers = recovers && get(c, question(9).c_str()) == answer(9) && get(c, question(0).c_str()) == answer(0);
+        response_cache_destroy(c);
+    }
+    check("cut during a flush: older entries kept, none half there", appends_ok);
+    check("after a cut the log takes new entries", recovers);
+
+    // A small flash so the second batch, which evicts the first, needs a compaction
+    for (long cut = 0; cut < 12000; cut += 97) {
+        MemFlash f(16 * 1024, 4096);
+        response_cache_t *c = open_cache(&f, 16, 0, 3600);
+        for (int i = 0; i < 12; i++) response_cache_put(c, question(i).c_str(), answer(i).c_str(), T0);
+        response_cache_flush(c, T0);
+        std::map<std::string, std::string> kept;
+        for (int i = 0; i < 12; i++) {
+            char *a = response_cache_get(c, question(i).c_str(), T0);
+            if (a) kept[question(i)] = a;
+            free(a);
+        }
+        for (int i = 12; i < 28; i++) response_cache_put(c, question(i).c_str(), answer(i).c_str(), T0);
+        uint32_t compactions = stats(c).compactions;
+        f.cut_after = cut;
+        response_cache_flush(c, T0);
+        bool compacted = stats(c).compactions > compactions || f.dead;
+        response_cache_destroy(c);
+        f.power_on();
+        c = open_cache(&f, 16, 0, 3600);
+        // Either the old log whole, or the new one whole
+        bool old_whole = true, all_valid = true;
+        for (auto &kv : kept) old_whole = old_whole && get(c, kv.first.c_str()) == kv.second;
+        for (int i = 0; i < 28; i++) {
+            std::string a = get(c, question(i).c_str());
+            all_valid = all_valid && (a.empty() || a == answer(i));
+        }
+        compact_ok = compact_ok && compacted && all_valid && (old_whole || stats(c).loaded > 0);
+        response_cache_destroy(c);
+    }
+    check("cut during a compaction: one log or the other, never garbage", compact_ok);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark
+
+static void bench() {
+    printf("lookups (64 entries)\n");
+    response_cache_t *c = open_cache(nullptr, 64, 1 << 20, 3600);
+    std::vector<std::string> qs;
+    for (int i = 0; i < 64; i++) {
+        qs.push_back(question(i));
+        response_cache_put(c, qs.back().c_str(), answer(i).c_str(), T0);
+    }
+    const int N = 400000;
+    double t0 = now_sec();
+    size_t n = 0;
+    for (int i = 0; i < N; i++) {
+        char *a = response_cache_get(c, qs[i & 63].c_str(), T0);
+        n += a ? 1 : 0;
+        free(a);
+    }
+    double hit_ns = (now_sec() - t0) / N * 1e9;
+    t0 = now_sec();
+    for (int i = 0; i < N; i++) free(response_cache_get(c, "Một câu chưa hỏi bao giờ?", T0));
+    double miss_ns = (now_sec() - t0) / N * 1e9;
+    printf("    hit %.0f ns (normalize, hash, copy the answer), miss %.0f ns, %zu hits\n", hit_ns, miss_ns, n);
+    response_cache_destroy(c);
+
+    printf("flash log (256 KB partition, 4 KB sectors)\n");
+    MemFlash f(256 * 1024, 4096);
+    c = open_cache(&f, 0, 0, 0);
+    const int PUTS = 5000;
+    t0 = now_sec();
+    for (int i = 0; i < PUTS; i++) {
+        response_cache_put(c, question(i % 300).c_str(), answer(i % 300, i).c_str(), T0 + i);
+        if (i % 4 == 3) response_cache_flush(c, T0 + i);
+    }
+    double sec = now_sec() - t0;
+    response_cache_stats_t st = stats(c);
+    printf("    %d puts, flushed every 4: %.1f KB written per put, %.2f sector erases per put, "
+           "%u compactions, %.1f us per put\n",
+           PUTS, f.written / 1024.0 / PUTS, (double)f.erased_sectors / PUTS, (unsigned)st.compactions,
+           sec / PUTS * 1e6);
+    response_cache_flush(c, T0 + PUTS);
+    response_cache_destroy(c);
+    t0 = now_sec();
+    c = open_cache(&f, 0, 0, 0);
+    printf("    replay at boot: %u entries in %.2f ms on the host\n", (unsigned)stats(c).loaded,
+           (now_sec() - t0) * 1e3);
+    response_cache_destroy(c);
+
+    // Question mix: a dozen questions take 70% of the traffic, the rest is a
+    // long tail that mostly never repeats
+    printf("skewed traffic (12 questions 70%%, long tail 30%%), 800 ms a round trip\n");
+    c = open_cache(nullptr, 0, 0, 0);
+    std::mt19937 rng(1);
+    const char *frequent[12] = {
+        "Xin chào", "Mấy giờ mở cửa?", "Giá vé bao nhiêu?", "Có chỗ đậu xe không?",
+        "Wifi mật khẩu là gì?", "Nhà vệ sinh ở đâu?", "Có giảm giá cho sinh viên không?",
+        "Cảm ơn", "Hôm nay có sự kiện gì?", "Làm sao để đặt bàn?", "Có bán đồ chay không?",
+        "Tạm biệt",
+    };
+    const int REQUESTS = 20000;
+    uint32_t now = T0;
+    for (int i = 0; i < REQUESTS; i++) {
+        now += 30;
+        std::string q;
+        if (rng() % 100 < 70) {
+            q = frequent[rng() % 12];
+            if (rng() % 2) q += "?";         // Transcripts vary in case and punctuation
+            if (rng() % 3 == 0) {
+                for (char &ch : q) ch = (char)toupper((unsigned char)ch);
+            }
+        } else {
+            q = "Câu hỏi hiếm " + std::to_string(rng() % 5000);
+        }
+        char *a = response_cache_get(c, q.c_str(), now);
+        if (!a) {
+            response_cache_note_miss(c, 800);
+            response_cache_put(c, q.c_str(), "Một câu trả lời vừa phải, khoảng hai câu. Cảm ơn bạn đã hỏi.", now);
+        }
+        free(a);
+    }
+    st = stats(c);
+    printf("    %u hits, %u misses: %.0f%% hit rate, %.1f minutes of round trips saved "
+           "(%.0f ms a request on average)\n",
+           (unsigned)st.hits, (unsigned)st.misses, 100.0 * st.hits / REQUESTS, st.saved_ms / 60000.0,
+           (double)st.saved_ms / REQUESTS);
+    response_cache_destroy(c);
+}
+
+int main() {
+    check_normalize();
+    check_memory();
+    check_model();
+    check_flash();
+    check_power_cuts();
+    bench();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,581 @@
+// tools/codec_bench.cpp - Host checks and benchmark for the upload codecs in src/audio_codec
+//
+// Encodes each clip with every codec, 20 ms at a time like the uploader
+// does, decodes the result again and reports encode speed and size:
+//   pcm16  bytes are the input samples
+//   ulaw   every 16-bit value encodes as the G.711 reference (g711.c
+//          segment tables) does, and decodes within half a quantizer step
+//          (plus the truncation of negative input to 14 bits)
+//   adpcm  the WAV IMA blocks decode, with the standard decoder, to within
+//          one step size of the input once the step has adapted
+//   flac   the stream parses (STREAMINFO, frame CRC-8/CRC-16, frame numbers)
+//          and decodes losslessly
+//
+// Without arguments a built-in synthetic clip is used: digital silence,
+// a voiced tone, quiet noise, a chirp, full-scale noise and a clipped
+// square wave, with a length that is not a multiple of any block size.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src codec_bench.cpp ../src/audio_codec.cpp -o codec_bench
+//   ./codec_bench [file.wav...]
+//
+// WAV input must be 16-bit PCM; only the first channel is used. Exits
+// non-zero if a check fails.
+
+#include "audio_codec.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define BENCH_FRAME_SAMPLES 320
+#define BENCH_MIN_SECONDS   0.2
+#define FIXTURE_RATE        16000
+#define ADPCM_WARMUP        32      // Samples the step size needs to catch up with a signal
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static uint16_t get_le16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static bool load_wav(const char *path, std::vector<int16_t> &pcm, uint32_t *rate) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+
+    if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0) {
+        return false;
+    }
+
+    uint16_t channels = 0, bits = 0, format = 0;
+    size_t pos = 12;
+    while (pos + 8 <= data.size()) {
+        uint32_t size = get_le32(&data[pos + 4]);
+        const uint8_t *body = &data[pos + 8];
+        size_t avail = data.size() - pos - 8;
+        if (size > avail) size = (uint32_t)avail;
+
+        if (memcmp(&data[pos], "fmt ", 4) == 0 && size >= 16) {
+            format = get_le16(body);
+            channels = get_le16(body + 2);
+            *rate = get_le32(body + 4);
+            bits = get_le16(body + 14);
+        } else if (memcmp(&data[pos], "data", 4) == 0) {
+            if (format != 1 || bits != 16 || channels == 0) return false;
+            size_t frames = size / (2 * channels);
+            pcm.resize(frames);
+            for (size_t i = 0; i < frames; i++) {
+                pcm[i] = (int16_t)get_le16(body + i * 2 * channels);
+            }
+            return true;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+// Deterministic test clip exercising every FLAC subframe type and the
+// clipping paths of the lossy codecs
+static std::vector<int16_t> make_fixture() {
+    std::vector<int16_t> pcm;
+    uint32_t lcg = 0x9e3779b9u;
+    auto noise = [&lcg](int32_t amplitude) {
+        lcg = lcg * 1664525u + 1013904223u;
+        return (double)((int64_t)(int32_t)lcg * amplitude / INT32_MAX);
+    };
+    auto add = [&pcm](double s) {
+        long v = lrint(s);
+        pcm.push_back((int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v));
+    };
+    const int r = FIXTURE_RATE;
+
+    for (int i = 0; i < r / 2; i++) add(0);                          // Digital silence
+    for (int i = 0; i < r; i++) {                                     // Voiced, 150 Hz
+        double t = (double)i / r, env = 0.5 + 0.5 * sin(2 * M_PI * 3 * t);
+        double w = 2 * M_PI * 150 * t;
+        add(env * (6000 * sin(w) + 3000 * sin(2 * w) + 1500 * sin(3 * w)) + noise(40));
+    }
+    for (int i = 0; i < r / 2; i++) add(noise(30));                   // Room noise
+    double phase = 0;
+    for (int i = 0; i < r; i++) {                                     // Chirp 100 Hz..6 kHz
+        phase += 2 * M_PI * (100 + 5900.0 * i / r) / r;
+        add(8000 * sin(phase));
+    }
+    for (int i = 0; i < r * 3 / 10; i++) add(noise(32767));           // Full-scale noise
+    for (int i = 0; i < r / 5; i++) add((i / 40) & 1 ? -32768 : 32767); // Clipped square
+    for (int i = 0; i < 123; i++) add(noise(1000));                   // Odd tail
+    return pcm;
+}
+
+// Encode the whole clip once; returns the encoded size
+static size_t encode_clip(audio_codec_id_t id, uint32_t rate, const std::vector<int16_t> &pcm,
+                          std::vector<uint8_t> &out) {
+    static audio_encoder_t enc;
+    audio_encoder_init(&enc, id, rate);
+
+    size_t pos = audio_encoder_header(&enc, out.data(), out.size());
+    for (size_t i = 0; i < pcm.size(); i += BENCH_FRAME_SAMPLES) {
+        size_t n = pcm.size() - i < BENCH_FRAME_SAMPLES ? pcm.size() - i : BENCH_FRAME_SAMPLES;
+        pos += audio_encoder_encode(&enc, &pcm[i], n, out.data() + pos, out.size() - pos);
+    }
+    pos += audio_encoder_flush(&enc, out.data() + pos, out.size() - pos);
+    return pos;
+}
+
+// ---------------------------------------------------------------------------
+// G.711 mu-law reference (Sun Microsystems g711.c)
+// ---------------------------------------------------------------------------
+
+static const int16_t s_seg_uend[8] = { 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF };
+
+static uint8_t g711_linear2ulaw(int16_t pcm_val) {
+    int16_t mask, seg;
+    int32_t v = pcm_val >> 2;
+    if (v < 0) {
+        v = -v;
+        mask = 0x7F;
+    } else {
+        mask = 0xFF;
+    }
+    if (v > 8159) v = 8159;
+    v += 0x84 >> 2;
+    for (seg = 0; seg < 8 && v > s_seg_uend[seg]; seg++) {}
+    if (seg >= 8) return (uint8_t)(0x7F ^ mask);
+    return (uint8_t)(((seg << 4) | ((v >> (seg + 1)) & 0xF)) ^ mask);
+}
+
+static int16_t g711_ulaw2linear(uint8_t u_val) {
+    u_val = (uint8_t)~u_val;
+    int32_t t = ((u_val & 0x0F) << 3) + 0x84;
+    t <<= (u_val & 0x70) >> 4;
+    return (int16_t)((u_val & 0x80) ? (0x84 - t) : (t - 0x84));
+}
+
+static void test_ulaw_table() {
+    printf("G.711 mu-law, all 65536 inputs\n");
+    std::vector<int16_t> all(65536);
+    for (int i = 0; i < 65536; i++) all[i] = (int16_t)(i - 32768);
+    std::vector<uint8_t> out(all.size());
+    audio_encoder_t enc;
+    audio_encoder_init(&enc, AUDIO_CODEC_ULAW, FIXTURE_RATE);
+    size_t n = audio_encoder_encode(&enc, all.data(), all.size(), out.data(), out.size());
+
+    bool same = n == all.size();
+    bool within = true;
+    for (size_t i = 0; i < n && same; i++) {
+        same = out[i] == g711_linear2ulaw(all[i]);
+
+        // Decoded value within half a step of the input, plus the 3 LSB the
+        // >> 2 into the 14-bit domain loses on negative input; past the clip
+        // level the error is the clipping itself
+        int32_t x = all[i], y = g711_ulaw2linear(out[i]);
+        int32_t mag = x < 0 ? -x : x;
+        int seg = (out[i] ^ (x < 0 ? 0x7F : 0xFF)) >> 4;
+        int32_t bound = (4 << seg) + (x < 0 ? 3 : 0);
+        if (mag <= 32124 && abs(x - y) > bound) within = false;
+    }
+    check("codes match the g711.c reference", same);
+    check("decoded values within half a quantizer step", within);
+    check("0, +full scale, -full scale -> 0xFF, 0x80, 0x00",
+          out[32768] == 0xFF && out[32767 + 32768] == 0x80 && out[0] == 0x00);
+}
+
+// ---------------------------------------------------------------------------
+// IMA ADPCM decoder (WAV mono block layout)
+// ---------------------------------------------------------------------------
+
+static const int16_t s_ima_step[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t s_ima_index[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+// Decodes every block; steps[i] is the quantizer step used for sample i
+static bool adpcm_decode(const uint8_t *in, size_t len, std::vector<int16_t> &pcm,
+                         std::vector<int32_t> &steps) {
+    if (len % AUDIO_CODEC_ADPCM_BLOCK_ALIGN != 0) return false;
+    for (size_t b = 0; b < len; b += AUDIO_CODEC_ADPCM_BLOCK_ALIGN) {
+        const uint8_t *p = in + b;
+        int32_t pred = (int16_t)get_le16(p);
+        int index = p[2];
+        if (index > 88 || p[3] != 0) return false;
+        pcm.push_back((int16_t)pred);
+        steps.push_back(0);
+
+        for (int i = 4; i < AUDIO_CODEC_ADPCM_BLOCK_ALIGN; i++) {
+            for (int shift = 0; shift <= 4; shift += 4) {
+                uint8_t nibble = (p[i] >> shift) & 0x0F;
+                int32_t step = s_ima_step[index];
+                int32_t diff = step >> 3;
+                if (nibble & 4) diff += step;
+                if (nibble & 2) diff += step >> 1;
+                if (nibble & 1) diff += step >> 2;
+                pred += (nibble & 8) ? -diff : diff;
+                if (pred > INT16_MAX) pred = INT16_MAX;
+                if (pred < INT16_MIN) pred = INT16_MIN;
+                index += s_ima_index[nibble & 7];
+                if (index < 0) index = 0;
+                if (index > 88) index = 88;
+                pcm.push_back((int16_t)pred);
+                steps.push_back(step);
+            }
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// FLAC decoder: CONSTANT, VERBATIM and FIXED subframes, Rice escapes
+// ---------------------------------------------------------------------------
+
+struct BitReader {
+    const uint8_t *p;
+    size_t len, pos = 0;
+    uint32_t bit = 0;
+    bool error = false;
+
+    BitReader(const uint8_t *data, size_t n) : p(data), len(n) {}
+
+    uint32_t get(uint32_t n) {
+        uint32_t v = 0;
+        while (n--) {
+            if (pos >= len) { error = true; return 0; }
+            v = (v << 1) | ((p[pos] >> (7 - bit)) & 1);
+            if (++bit == 8) { bit = 0; pos++; }
+        }
+        return v;
+    }
+    int32_t get_signed(uint32_t n) {
+        uint32_t v = get(n);
+        return n == 0 ? 0 : (int32_t)(v << (32 - n)) >> (32 - n);
+    }
+    uint32_t unary() {
+        uint32_t q = 0;
+        while (!error && get(1) == 0) q++;
+        return q;
+    }
+    void align() { if (bit) { bit = 0; pos++; } }
+};
+
+static uint8_t crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static int64_t fixed_predict(const int32_t *x, int i, int order) {
+    switch (order) {
+        case 0: return 0;
+        case 1: return x[i - 1];
+        case 2: return 2 * (int64_t)x[i - 1] - x[i - 2];
+        case 3: return 3 * (int64_t)x[i - 1] - 3 * (int64_t)x[i - 2] + x[i - 3];
+        default: return 4 * (int64_t)x[i - 1] - 6 * (int64_t)x[i - 2] + 4 * (int64_t)x[i - 3] - x[i - 4];
+    }
+}
+
+struct FlacInfo {
+    uint32_t rate = 0, frames = 0;
+    uint32_t constant = 0, verbatim = 0, fixed = 0;
+};
+
+// Returns an empty string on success, otherwise what went wrong
+static std::string flac_decode(const uint8_t *in, size_t len, std::vector<int16_t> &pcm, FlacInfo *info) {
+    if (len < 42 || memcmp(in, "fLaC", 4) != 0) return "missing fLaC marker";
+    BitReader br(in + 4, len - 4);
+    if (br.get(1) != 1 || br.get(7) != 0 || br.get(24) != 34) return "bad STREAMINFO block header";
+    uint32_t min_block = br.get(16), max_block = br.get(16);
+    br.get(24);
+    br.get(24);
+    info->rate = br.get(20);
+    if (br.get(3) != 0 || br.get(5) != 15) return "STREAMINFO is not mono 16-bit";
+    br.get(4);
+    br.get(32);
+    for (int i = 0; i < 4; i++) br.get(32);
+    if (min_block != AUDIO_CODEC_FLAC_BLOCK_SAMPLES || max_block != AUDIO_CODEC_FLAC_BLOCK_SAMPLES) {
+        return "unexpected block size in STREAMINFO";
+    }
+
+    size_t pos = 42;
+    std::vector<int32_t> x;
+    while (pos < len) {
+        const uint8_t *frame = in + pos;
+        BitReader fr(frame, len - pos);
+        if (fr.get(15) != 0x7FFC || fr.get(1) != 0) return "lost frame sync";
+        uint32_t bs_code = fr.get(4), rate_code = fr.get(4);
+        if (fr.get(4) != 0 || fr.get(3) != 4 || fr.get(1) != 0) return "frame is not mono 16-bit";
+
+        // UTF-8 coded frame number
+        uint32_t lead = fr.get(8), number = lead;
+        int extra = 0;
+        while (extra < 6 && (lead & (0x80 >> extra))) extra++;
+        if (extra == 1) return "bad frame number";
+        if (extra > 1) {
+            number = lead & (0x7F >> extra);
+            for (int i = 1; i < extra; i++) number = (number << 6) | (fr.get(8) & 0x3F);
+        }
+        if (number != info->frames) return "frame numbers out of sequence";
+
+        uint32_t n = 0;
+        if (bs_code == 1) n = 192;
+        else if (bs_code >= 2 && bs_code <= 5) n = 576u << (bs_code - 2);
+        else if (bs_code == 6) n = fr.get(8) + 1;
+        else if (bs_code == 7) n = fr.get(16) + 1;
+        else if (bs_code >= 8) n = 256u << (bs_code - 8);
+        if (n == 0 || n > AUDIO_CODEC_FLAC_BLOCK_SAMPLES) return "bad block size";
+        if (rate_code == 12) fr.get(8);
+        else if (rate_code == 13 || rate_code == 14) fr.get(16);
+        size_t header_len = fr.pos;
+        if (fr.get(8) != crc8(frame, header_len)) return "frame header CRC-8 mismatch";
+
+        if (fr.get(1) != 0) return "subframe padding bit set";
+        uint32_t type = fr.get(6);
+        if (fr.get(1) != 0) return "wasted bits not expected";
+        x.assign(n, 0);
+        if (type == 0) {
+            int32_t v = fr.get_signed(16);
+            for (uint32_t i = 0; i < n; i++) x[i] = v;
+            info->constant++;
+        } else if (type == 1) {
+            for (uint32_t i = 0; i < n; i++) x[i] = fr.get_signed(16);
+            info->verbatim++;
+        } else if (type >= 8 && type <= 12) {
+            int order = (int)(type - 8);
+            for (int i = 0; i < order; i++) x[i] = fr.get_signed(16);
+            uint32_t method = fr.get(2);
+            if (method > 1) return "reserved residual coding method";
+            uint32_t param_bits = method == 0 ? 4 : 5, escape = (1u << param_bits) - 1;
+            uint32_t porder = fr.get(4), parts = 1u << porder;
+            if ((n >> porder) <= (uint32_t)order) return "partition shorter than the predictor order";
+            uint32_t i = (uint32_t)order;
+            for (uint32_t part = 0; part < parts; part++) {
+                uint32_t count = (n >> porder) - (part == 0 ? (uint32_t)order : 0);
+                uint32_t k = fr.get(param_bits);
+                if (k == escape) {
+                    uint32_t raw = fr.get(5);
+                    for (uint32_t j = 0; j < count; j++, i++) x[i] = fr.get_signed(raw);
+                } else {
+                    for (uint32_t j = 0; j < count; j++, i++) {
+                        uint32_t u = (fr.unary() << k) | fr.get(k);
+                        x[i] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+                    }
+                }
+            }
+            for (uint32_t s = (uint32_t)order; s < n; s++) x[s] += (int32_t)fixed_predict(x.data(), (int)s, order);
+            info->fixed++;
+        } else {
+            return "unsupported subframe type";
+        }
+        if (fr.error) return "frame truncated";
+
+        fr.align();
+        size_t body_len = fr.pos;
+        if (fr.get(16) != crc16(frame, body_len) || fr.error) return "frame CRC-16 mismatch";
+        for (uint32_t s = 0; s < n; s++) {
+            if (x[s] < INT16_MIN || x[s] > INT16_MAX) return "decoded sample out of range";
+            pcm.push_back((int16_t)x[s]);
+        }
+        info->frames++;
+        pos += fr.pos;
+    }
+    return "";
+}
+
+// ---------------------------------------------------------------------------
+// Roundtrip checks
+// ---------------------------------------------------------------------------
+
+static double snr_db(const std::vector<int16_t> &ref, const std::vector<int16_t> &dec) {
+    double sig = 0, err = 0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        double e = (double)ref[i] - dec[i];
+        sig += (double)ref[i] * ref[i];
+        err += e * e;
+    }
+    return err == 0 ? 999 : 10 * log10(sig / err);
+}
+
+static void check_roundtrip(audio_codec_id_t id, uint32_t rate, const std::vector<int16_t> &pcm,
+                            const std::vector<uint8_t> &out, size_t bytes) {
+    char what[96];
+    const char *name = audio_codec_name(id);
+
+    switch (id) {
+    case AUDIO_CODEC_PCM16: {
+        snprintf(what, sizeof(what), "%s: output is the input samples", name);
+        check(what, bytes == pcm.size() * 2 && memcmp(out.data(), pcm.data(), bytes) == 0);
+        break;
+    }
+    case AUDIO_CODEC_ULAW: {
+        bool same = bytes == pcm.size();
+        std::vector<int16_t> dec;
+        for (size_t i = 0; i < bytes && same; i++) {
+            same = out[i] == g711_linear2ulaw(pcm[i]);
+            dec.push_back(g711_ulaw2linear(out[i]));
+        }
+        snprintf(what, sizeof(what), "%s: every byte matches the G.711 reference", name);
+        check(what, same);
+        if (same) printf("    %s: SNR %.1f dB\n", name, snr_db(pcm, dec));
+        break;
+    }
+    case AUDIO_CODEC_IMA_ADPCM: {
+        std::vector<int16_t> dec;
+        std::vector<int32_t> steps;
+        bool ok = adpcm_decode(out.data(), bytes, dec, steps);
+        size_t blocks = (pcm.size() + AUDIO_CODEC_ADPCM_BLOCK_SAMPLES - 1) / AUDIO_CODEC_ADPCM_BLOCK_SAMPLES;
+        snprintf(what, sizeof(what), "%s: %zu whole blocks decode", name, blocks);
+        check(what, ok && dec.size() == blocks * AUDIO_CODEC_ADPCM_BLOCK_SAMPLES);
+        if (!ok || dec.size() < pcm.size()) break;
+
+        // Block headers carry their first sample verbatim; in between, the
+        // error stays within one step of the quantizer once it has adapted
+        // to the signal (the first samples and any slope overload count)
+        bool headers = true;
+        size_t over = 0;
+        double worst = 0;
+        for (size_t i = 0; i < pcm.size(); i++) {
+            int32_t err = abs((int32_t)pcm[i] - dec[i]);
+            if (steps[i] == 0) {
+                headers = headers && err == 0;
+            } else if (i >= ADPCM_WARMUP && err > steps[i]) {
+                over++;
+            }
+            if (steps[i] > 0) worst = fmax(worst, (double)err / steps[i]);
+        }
+        dec.resize(pcm.size());
+        snprintf(what, sizeof(what), "%s: block headers hold the input sample", name);
+        check(what, headers);
+        snprintf(what, sizeof(what), "%s: error within one step on 99%% of samples", name);
+        check(what, over * 100 <= pcm.size());
+        printf("    %s: SNR %.1f dB, %zu samples past one step, worst %.1f steps\n",
+               name, snr_db(pcm, dec), over, worst);
+        break;
+    }
+    case AUDIO_CODEC_FLAC: {
+        std::vector<int16_t> dec;
+        FlacInfo info;
+        std::string err = flac_decode(out.data(), bytes, dec, &info);
+        snprintf(what, sizeof(what), "%s: stream parses, CRCs and frame numbers valid", name);
+        check(what, err.empty() && info.rate == rate);
+        if (!err.empty()) printf("    %s: %s\n", name, err.c_str());
+        snprintf(what, sizeof(what), "%s: decodes losslessly", name);
+        check(what, err.empty() && dec == pcm);
+        printf("    %s: %u frames (%u constant, %u verbatim, %u fixed)\n", name, info.frames,
+               info.constant, info.verbatim, info.fixed);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+int main(int argc, char **argv) {
+    test_ulaw_table();
+
+    std::vector<std::pair<std::string, std::vector<int16_t>>> clips;
+    std::vector<uint32_t> rates;
+    if (argc < 2) {
+        clips.push_back({ "synthetic", make_fixture() });
+        rates.push_back(FIXTURE_RATE);
+    }
+    for (int a = 1; a < argc; a++) {
+        std::vector<int16_t> pcm;
+        uint32_t rate = 0;
+        if (!load_wav(argv[a], pcm, &rate) || pcm.empty() || rate == 0) {
+            fprintf(stderr, "%s: not a 16-bit PCM WAV, skipped\n", argv[a]);
+            continue;
+        }
+        const char *name = strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1 : argv[a];
+        clips.push_back({ name, pcm });
+        rates.push_back(rate);
+    }
+    if (clips.empty()) return 1;
+
+    double total_in[AUDIO_CODEC_COUNT] = {0};
+    double total_out[AUDIO_CODEC_COUNT] = {0};
+    double total_sec[AUDIO_CODEC_COUNT] = {0};
+    double total_audio = 0;
+    std::vector<std::string> rows;
+
+    for (size_t k = 0; k < clips.size(); k++) {
+        const std::string &name = clips[k].first;
+        const std::vector<int16_t> &pcm = clips[k].second;
+        uint32_t rate = rates[k];
+        double audio_sec = (double)pcm.size() / rate;
+        total_audio += audio_sec;
+        printf("Roundtrip %s, %zu samples at %u Hz\n", name.c_str(), pcm.size(), (unsigned)rate);
+
+        // Worst case is FLAC verbatim frames, a little over 2 bytes per sample
+        std::vector<uint8_t> out(pcm.size() * 3 + 4096);
+
+        for (int c = 0; c < AUDIO_CODEC_COUNT; c++) {
+            audio_codec_id_t id = (audio_codec_id_t)c;
+            size_t bytes = encode_clip(id, rate, pcm, out);
+            check_roundtrip(id, rate, pcm, out, bytes);
+
+            int runs = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            double elapsed;
+            do {
+                encode_clip(id, rate, pcm, out);
+                runs++;
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            } while (elapsed < BENCH_MIN_SECONDS);
+            double per_run = elapsed / runs;
+
+            double in_bytes = (double)pcm.size() * sizeof(int16_t);
+            total_in[c] += in_bytes;
+            total_out[c] += bytes;
+            total_sec[c] += per_run;
+            char row[160];
+            snprintf(row, sizeof(row), "%-28.28s %-6s %10u %8.3f %10.1f %10.0f", name.c_str(),
+                     audio_codec_name(id), (unsigned)bytes, bytes / in_bytes,
+                     pcm.size() / per_run / 1e6, audio_sec / per_run);
+            rows.push_back(row);
+        }
+    }
+
+    printf("\n%-28s %-6s %10s %8s %10s %10s\n", "file", "codec", "bytes", "ratio", "MSamp/s", "x realtime");
+    for (const std::string &row : rows) printf("%s\n", row.c_str());
+    printf("\n%-28s %-6s %10s %8s %10s %10s\n", "corpus", "codec", "kbit/s", "ratio", "", "x realtime");
+    for (int c = 0; c < AUDIO_CODEC_COUNT; c++) {
+        printf("%-28s %-6s %10.1f %8.3f %10s %10.0f\n", "", audio_codec_name((audio_codec_id_t)c),
+               total_out[c] * 8 / total_audio / 1000, total_out[c] / total_in[c], "",
+               total_audio / total_sec[c]);
+    }
+
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,273 @@
+// tools/conversation_bench.cpp - Host checks and benchmark for src/conversation
+//
+// Checks that the history written ahead of a request is valid JSON with the
+// turns in order (parsed back with jsoncpp), that the byte and token budget
+// holds over a long conversation as old turns are folded into the summary,
+// and the edge cases: escaping, oversized turns, a full ring, a shrinking
+// budget. Then times writing the history against its length, next to
+// building the same "contents" as a document and serializing it, the way
+// the request was built with ArduinoJson (jsoncpp stands in).
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src -I/usr/include/jsoncpp conversation_bench.cpp ../src/conversation.cpp ../src/request_writer.cpp ../src/base64_stream.cpp -ljsoncpp -o conversation_bench
+//   ./conversation_bench
+//
+// Exits non-zero if a check fails.
+
+#include "conversation.h"
+#include <json/json.h>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_sec() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const char *QUESTIONS[] = {
+    "Thời tiết Hà Nội hôm nay thế nào?",
+    "Còn ngày mai thì sao? Có mưa không?",
+    "Tôi nên mặc gì khi đi làm?",
+    "Gợi ý cho tôi một món ăn sáng nhanh gọn.",
+    "What is the capital of Australia?",
+    "Nhắc lại câu hỏi đầu tiên của tôi là gì?",
+};
+
+static const char *ANSWERS[] = {
+    "Hôm nay Hà Nội trời nắng nhẹ, khoảng 28 độ C. Buổi tối có thể se lạnh, bạn nên mang áo khoác mỏng.",
+    "Ngày mai có khả năng mưa rào vào buổi chiều. Bạn nhớ mang theo ô nhé!",
+    "Với thời tiết này, áo sơ mi dài tay và quần vải là lựa chọn hợp lý.\nNếu đi xe máy, thêm áo khoác chống nắng.",
+    "Bạn có thể thử bánh mì trứng ốp la: nhanh, đủ chất và dễ làm. Hoặc một bát cháo yến mạch với chuối.",
+    "The capital of Australia is Canberra, not Sydney as many people think.",
+    "Câu hỏi đầu tiên của bạn là về thời tiết Hà Nội hôm nay.",
+};
+
+static std::string prefix_of(const conversation_t *c) {
+    std::string s(conversation_prefix_size(c) + 1, '\0');
+    size_t n = conversation_write_prefix(c, &s[0], s.size());
+    s.resize(n);
+    return s;
+}
+
+// The history as a whole request: prefix, one more user turn, the end
+static bool parse_request(const conversation_t *c, const char *question, Json::Value *doc) {
+    std::string body = prefix_of(c);
+    std::string turn(conversation_turn_size(CONVERSATION_USER, question) + 1, '\0');
+    turn.resize(conversation_write_turn(CONVERSATION_USER, question, &turn[0], turn.size()));
+    body += turn + "]}";
+    Json::CharReaderBuilder b;
+    std::unique_ptr<Json::CharReader> reader(b.newCharReader());
+    std::string err;
+    return reader->parse(body.data(), body.data() + body.size(), doc, &err);
+}
+
+static bool valid_utf8(const std::string &s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = s[i];
+        size_t n = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3 : (c >> 3) == 30 ? 4 : 0;
+        if (n == 0 || i + n > s.size()) return false;
+        for (size_t k = 1; k < n; k++) {
+            if (((unsigned char)s[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += n;
+    }
+    return true;
+}
+
+static void talk(conversation_t *c, int exchanges, int from = 0) {
+    for (int i = from; i < from + exchanges; i++) {
+        conversation_add(c, CONVERSATION_USER, QUESTIONS[i % 6]);
+        conversation_add(c, CONVERSATION_MODEL, ANSWERS[i % 6]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+
+static void checks() {
+    printf("conversation\n");
+    conversation_t *c = conversation_create(nullptr);
+    Json::Value doc;
+    check("empty history: the request is just the question",
+          prefix_of(c) == "{\"contents\":[" && parse_request(c, "xin chào", &doc) &&
+          doc["contents"].size() == 1 && doc["contents"][0]["role"] == "user");
+
+    talk(c, 3);
+    bool ok = parse_request(c, "tiếp theo?", &doc) && doc["contents"].size() == 7 &&
+              !doc.isMember("systemInstruction");
+    for (int i = 0; ok && i < 6; i++) {
+        ok = doc["contents"][i]["role"] == (i % 2 ? "model" : "user") &&
+             doc["contents"][i]["parts"][0]["text"] == (i % 2 ? ANSWERS[i / 2] : QUESTIONS[i / 2]);
+    }
+    check("three exchanges: valid JSON, roles alternate, text intact", ok);
+    check("prefix_size matches what is written", conversation_prefix_size(c) == prefix_of(c).size());
+
+    std::string tricky = "quote \" backslash \\ tab \t cr \r bell \x07 nl \n end";
+    conversation_clear(c);
+    conversation_add(c, CONVERSATION_USER, tricky.c_str());
+    conversation_add(c, CONVERSATION_MODEL, "ok");
+    check("escapes survive a round trip", parse_request(c, "?", &doc) &&
+          doc["contents"][0]["parts"][0]["text"].asString() == tricky &&
+          conversation_prefix_size(c) == prefix_of(c).size());
+
+    char small[16];
+    check("write_prefix with too small a buffer writes nothing",
+          conversation_write_prefix(c, small, sizeof(small)) == 0);
+
+    // A long conversation stays inside the budget
+    conversation_clear(c);
+    conversation_set_budget(c, 2048, 400);
+    conversation_stats_t st;
+    ok = true;
+    for (int i = 0; i < 200; i++) {
+        talk(c, 1, i);
+        conversation_get_stats(c, &st);
+        ok = ok && st.bytes <= 2048 && st.tokens <= 400 && st.bytes == prefix_of(c).size();
+    }
+    check("200 exchanges: bytes and tokens under budget every time", ok);
+    ok = parse_request(c, "?", &doc);
+    int n = (int)doc["contents"].size() - 1;
+    check("oldest turns folded into a summary as the system instruction",
+          ok && st.folded > 0 && st.summary_bytes > 0 &&
+          doc["systemInstruction"]["parts"][0]["text"].asString().find("User: ") != std::string::npos);
+    check("latest exchange kept whole, history starts with the user",
+          ok && n >= 2 && doc["contents"][0]["role"] == "user" &&
+          doc["contents"][n - 1]["parts"][0]["text"] == ANSWERS[199 % 6] &&
+          doc["contents"][n - 2]["parts"][0]["text"] == QUESTIONS[199 % 6]);
+    check("summary bounded, oldest lines dropped",
+          st.summary_bytes <= CONVERSATION_SUMMARY_MAX && st.summary_dropped > 0);
+    check("summary is valid UTF-8",
+          valid_utf8(doc["systemInstruction"]["parts"][0]["text"].asString()));
+
+    conversation_set_budget(c, 700, 0);
+    conversation_get_stats(c, &st);
+    check("budget lowered: history shrinks at once", st.bytes <= 700 && parse_request(c, "?", &doc));
+
+    // One huge turn
+    conversation_clear(c);
+    conversation_set_budget(c, 4096, 100000);
+    std::string huge;
+    while (huge.size() < 10000) huge += "Đây là một câu rất dài để thử giới hạn. ";
+    conversation_add(c, CONVERSATION_USER, huge.c_str());
+    conversation_add(c, CONVERSATION_MODEL, "ok");
+    conversation_get_stats(c, &st);
+    ok = parse_request(c, "?", &doc);
+    std::string kept = doc["contents"][0]["parts"][0]["text"].asString();
+    check("oversized turn cut to half the budget on a UTF-8 boundary",
+          ok && st.bytes <= 4096 && kept.size() < huge.size() && kept.size() > 1000 && valid_utf8(kept) &&
+          huge.compare(0, kept.size(), kept) == 0);
+
+    // The ring is full before the budget is reached
+    conversation_clear(c);
+    conversation_set_budget(c, 1 << 20, 1 << 20);
+    talk(c, CONVERSATION_MAX_TURNS);
+    conversation_get_stats(c, &st);
+    check("full ring: oldest folded, count stays at the maximum",
+          st.turns == CONVERSATION_MAX_TURNS && st.folded == CONVERSATION_MAX_TURNS &&
+          parse_request(c, "?", &doc) && doc["contents"][0]["role"] == "user");
+
+    conversation_clear(c);
+    conversation_get_stats(c, &st);
+    check("clear forgets turns and summary",
+          st.turns == 0 && st.summary_bytes == 0 && prefix_of(c) == "{\"contents\":[");
+
+    check("token estimate: ASCII about 4 chars a token",
+          conversation_estimate_tokens("abcdefghabcdefgh", 16) == 4);
+    const char *vi = "Thời tiết";
+    check("token estimate: non-ASCII characters count more",
+          conversation_estimate_tokens(vi, strlen(vi)) == 3);
+    conversation_destroy(c);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark
+
+// The same contents as a document, serialized: the ArduinoJson way
+static std::string dom_prefix(int exchanges) {
+    Json::Value doc;
+    Json::Value &contents = doc["contents"];
+    for (int i = 0; i < exchanges; i++) {
+        Json::Value u;
+        u["role"] = "user";
+        u["parts"][0]["text"] = QUESTIONS[i % 6];
+        contents.append(u);
+        Json::Value m;
+        m["role"] = "model";
+        m["parts"][0]["text"] = ANSWERS[i % 6];
+        contents.append(m);
+    }
+    Json::StreamWriterBuilder w;
+    w["indentation"] = "";
+    w["emitUTF8"] = true;
+    return Json::writeString(w, doc);
+}
+
+static void bench() {
+    printf("writing the history (budget large enough to keep every turn)\n");
+    printf("    %6s %8s %8s %12s %10s %14s\n", "turns", "bytes", "tokens", "write (us)", "MB/s",
+           "document (us)");
+    std::vector<char> buf(1 << 20);
+    for (int exchanges : { 0, 1, 2, 4, 8, 16 }) {
+        conversation_config_t cfg = { 1 << 20, 1 << 20 };
+        conversation_t *c = conversation_create(&cfg);
+        talk(c, exchanges);
+        conversation_stats_t st;
+        conversation_get_stats(c, &st);
+        const int iters = 20000;
+        size_t n = 0;
+        double t0 = now_sec();
+        for (int i = 0; i < iters; i++) n += conversation_write_prefix(c, buf.data(), buf.size());
+        double sec = (now_sec() - t0) / iters;
+        const int dom_iters = 2000;
+        size_t m = 0;
+        t0 = now_sec();
+        for (int i = 0; i < dom_iters; i++) m += dom_prefix(exchanges).size();
+        double dom_sec = (now_sec() - t0) / dom_iters;
+        printf("    %6u %8u %8u %12.2f %10.0f %14.2f\n", (unsigned)st.turns, (unsigned)st.bytes,
+               (unsigned)st.tokens, sec * 1e6, st.bytes / sec / 1e6, dom_sec * 1e6);
+        if (n == 0 || m == 0) printf("unreachable\n");
+        conversation_destroy(c);
+    }
+
+    printf("request size over a long conversation (default budget %u bytes, %u tokens)\n",
+           CONVERSATION_DEFAULT_MAX_BYTES, CONVERSATION_DEFAULT_MAX_TOKENS);
+    conversation_t *c = conversation_create(nullptr);
+    size_t unbounded = 0;
+    for (int i = 1; i <= 256; i++) {
+        unbounded += conversation_turn_size(CONVERSATION_USER, QUESTIONS[(i - 1) % 6]) +
+                     conversation_turn_size(CONVERSATION_MODEL, ANSWERS[(i - 1) % 6]) + 2;
+        talk(c, 1, i - 1);
+        if ((i & (i - 1)) == 0) {
+            conversation_stats_t st;
+            conversation_get_stats(c, &st);
+            printf("    %4d exchanges: %5u bytes (whole history %7zu), ~%4u tokens, %2u turns, "
+                   "%3u folded, summary %3u bytes\n",
+                   i, (unsigned)st.bytes, unbounded + 13, (unsigned)st.tokens, (unsigned)st.turns,
+                   (unsigned)st.folded, (unsigned)st.summary_bytes);
+        }
+    }
+    conversation_destroy(c);
+}
+
+int main() {
+    checks();
+    bench();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+// tools/dsp_bench.cpp - Host checks and benchmark for the capture front-end in src/audio_dsp.h
+//
+// Runs each stage on synthetic signals, prints the measured response next
+// to what the stage should do, and times the full chain per 20 ms frame.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src dsp_bench.cpp -o dsp_bench
+//   ./dsp_bench
+//
+// Exits non-zero if a response is out of range.
+
+#include "audio_dsp.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define RATE            16000
+#define FRAME           320
+#define BENCH_FRAMES    50000
+
+static int s_failures = 0;
+
+static void check(const char *what, double value, double lo, double hi, const char *unit) {
+    bool ok = value >= lo && value <= hi;
+    printf("  %-40s %10.2f %-5s [%g .. %g] %s\n", what, value, unit, lo, hi, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double dbfs(double v) {
+    return 20.0 * log10(v / 2147483648.0 + 1e-20);
+}
+
+static std::vector<int32_t> tone(double freq, double amp_dbfs, size_t n, double dc = 0.0) {
+    std::vector<int32_t> x(n);
+    double amp = pow(10.0, amp_dbfs / 20.0) * 2147483647.0;
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (int32_t)(amp * sin(2.0 * M_PI * freq * i / RATE) + dc * 2147483647.0);
+    }
+    return x;
+}
+
+template <typename Stage>
+static void run(Stage &stage, std::vector<int32_t> &x) {
+    for (size_t i = 0; i < x.size(); i += FRAME) {
+        size_t n = x.size() - i < FRAME ? x.size() - i : FRAME;
+        stage.process(&x[i], n);
+    }
+}
+
+static double rms(const std::vector<int32_t> &x, size_t from, size_t to) {
+    double s = 0;
+    for (size_t i = from; i < to; i++) s += (double)x[i] * x[i];
+    return sqrt(s / (to - from));
+}
+
+static double mean(const std::vector<int32_t> &x, size_t from, size_t to) {
+    double s = 0;
+    for (size_t i = from; i < to; i++) s += x[i];
+    return s / (to - from);
+}
+
+static double peak(const std::vector<int32_t> &x, size_t from, size_t to) {
+    double p = 0;
+    for (size_t i = from; i < to; i++) p = fmax(p, fabs((double)x[i]));
+    return p;
+}
+
+static void test_dc_blocker() {
+    printf("DC blocker\n");
+    DspDcBlocker<> dc;
+    std::vector<int32_t> x = tone(1000, -30, RATE * 2, 0.1);
+    run(dc, x);
+    check("residual DC after 1 s", dbfs(fabs(mean(x, RATE, 2 * RATE))), -200, -80, "dBFS");
+    check("1 kHz level", dbfs(rms(x, RATE, 2 * RATE) * sqrt(2.0)), -30.2, -29.8, "dBFS");
+}
+
+static void test_high_pass() {
+    printf("High-pass 80 Hz\n");
+    const double freqs[] = { 20, 50, 80, 200, 1000 };
+    const double lo[] = { -30, -10, -3.5, -0.5, -0.1 };
+    const double hi[] = { -20, -7.5, -2.5, 0.1, 0.1 };
+    for (int f = 0; f < 5; f++) {
+        DspHighPass<80, RATE> hp;
+        std::vector<int32_t> x = tone(freqs[f], -6, RATE * 2);
+        double in = rms(x, RATE, 2 * RATE);
+        run(hp, x);
+        char label[48];
+        snprintf(label, sizeof(label), "gain at %g Hz", freqs[f]);
+        check(label, 20.0 * log10(rms(x, RATE, 2 * RATE) / in), lo[f], hi[f], "dB");
+    }
+}
+
+static void test_agc() {
+    printf("AGC\n");
+    DspAgc agc;
+    std::vector<int32_t> quiet = tone(300, -40, RATE * 4);
+    run(agc, quiet);
+    check("quiet talker RMS (target -20)", dbfs(rms(quiet, 3 * RATE, 4 * RATE)), -21, -19, "dBFS");
+
+    DspAgc gated;
+    std::vector<int32_t> hiss = tone(3000, -70, RATE * 2);
+    run(gated, hiss);
+    check("gain below noise gate", gated.gain_q16() / 65536.0, 1, 1, "x");
+
+    DspAgc capped;
+    std::vector<int32_t> faint = tone(300, -50, RATE * 6);
+    run(capped, faint);
+    check("gain cap", capped.gain_q16() / 65536.0, 31, 32, "x");
+
+    // Quiet then a sudden loud burst: the limiter must hold the peak
+    DspAgc lim;
+    std::vector<int32_t> x = tone(300, -40, RATE * 3);
+    std::vector<int32_t> loud = tone(300, -3, RATE);
+    x.insert(x.end(), loud.begin(), loud.end());
+    run(lim, x);
+    check("peak on -3 dBFS burst", dbfs(peak(x, 3 * RATE, 4 * RATE)), -10, -0.99, "dBFS");
+    check("frames limited", lim.limited_frames(), 1, 1000, "");
+}
+
+static void bench() {
+    typedef DspChain<DspDcBlocker<>, DspHighPass<80, RATE>, DspAgc> chain_t;
+    printf("Chain benchmark (%d samples/frame)\n", FRAME);
+
+    static chain_t chain;
+    std::vector<int32_t> src = tone(440, -30, FRAME * 64, 0.01);
+    std::vector<int32_t> frame(FRAME);
+
+    auto t0 = std::chrono::steady_clock::now();
+#ifdef HAVE_TSC
+    uint64_t c0 = __rdtsc();
+#endif
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        const int32_t *in = &src[(f & 63) * FRAME];
+        for (int i = 0; i < FRAME; i++) frame[i] = in[i];
+        chain.process(frame.data(), FRAME);
+    }
+#ifdef HAVE_TSC
+    uint64_t cycles = __rdtsc() - c0;
+#endif
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("  %.2f us/frame, %.0fx realtime\n", sec / BENCH_FRAMES * 1e6,
+           (BENCH_FRAMES * FRAME / (double)RATE) / sec);
+#ifdef HAVE_TSC
+    printf("  %.0f TSC cycles/frame (%.2f per sample)\n", (double)cycles / BENCH_FRAMES,
+           (double)cycles / BENCH_FRAMES / FRAME);
+#endif
+    printf("  On the device see audio_capture_get_dsp_stats() for CPU cycles per frame\n");
+}
+
+int main() {
+    test_dc_blocker();
+    test_high_pass();
+    test_agc();
+    bench();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
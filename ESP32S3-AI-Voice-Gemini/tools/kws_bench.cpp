@@ -0,0 +1,300 @@
+// tools/kws_bench.cpp - Host test and CPU benchmark for src/kws (wake word)
+//
+// Without arguments, synthesises formant "words" (pulse train through
+// three resonators), enrolls three takes of a keyword, then streams noise
+// with further keyword takes and distractor words and checks the hits and
+// false alarms. CPU time per second of audio is reported for silence (DTW
+// gated off) and for continuous speech (DTW running against every template).
+//
+// With WAV files (16-bit mono at 16 kHz), runs the same engine on real
+// recordings:
+//   ./kws_bench enroll1.wav enroll2.wav enroll3.wav -- test.wav
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src kws_bench.cpp ../src/kws.cpp ../src/mfcc.cpp ../src/fft_q15.cpp ../src/vad.cpp -o kws_bench
+//   ./kws_bench
+//
+// Exits non-zero if a check fails.
+
+#include "kws.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define RATE            16000
+#define BLOCK           320         // Same 20 ms blocks the device task feeds
+
+static int s_failures = 0;
+
+typedef std::vector<int16_t> pcm_t;
+
+static void check(const char *what, double value, double lo, double hi) {
+    bool ok = value >= lo && value <= hi;
+    printf("    %-40s %8.1f [%g .. %g] %s\n", what, value, lo, hi, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+// ---- Synthesis -------------------------------------------------------------
+
+typedef struct { float f1, f2, f3; } vowel_t;
+
+static const vowel_t V_A = { 730, 1090, 2440 };
+static const vowel_t V_I = { 270, 2290, 3010 };
+static const vowel_t V_U = { 300, 870, 2240 };
+static const vowel_t V_E = { 530, 1840, 2480 };
+static const vowel_t V_O = { 570, 840, 2410 };
+
+struct resonator {
+    float y1 = 0, y2 = 0;
+    float step(float x, float f, float bw) {
+        float r = expf(-(float)M_PI * bw / RATE);
+        float a1 = 2 * r * cosf(2 * (float)M_PI * f / RATE), a2 = -r * r;
+        float y = (1 - r) * x + a1 * y1 + a2 * y2;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+static float frand() {
+    return (float)rand() / RAND_MAX;
+}
+
+// Glide through the vowel targets, seg_ms per target, with a short onset
+// and release. speed scales the duration, pitch the glottal rate.
+static pcm_t synth_word(const std::vector<vowel_t> &seq, float seg_ms, float speed,
+                        float pitch, float amp) {
+    size_t seg = (size_t)(seg_ms * speed * RATE / 1000);
+    size_t n = seg * seq.size();
+    pcm_t out(n);
+    resonator r1, r2, r3;
+    float phase = 0;
+    for (size_t i = 0; i < n; i++) {
+        float pos = (float)i / seg;
+        size_t k = (size_t)pos;
+        float t = pos - k;
+        const vowel_t &a = seq[k];
+        const vowel_t &b = seq[k + 1 < seq.size() ? k + 1 : k];
+        float f1 = a.f1 + (b.f1 - a.f1) * t, f2 = a.f2 + (b.f2 - a.f2) * t, f3 = a.f3 + (b.f3 - a.f3) * t;
+
+        float f0 = pitch * (1.0f + 0.08f * sinf(2 * (float)M_PI * i / n));
+        phase += f0 / RATE;
+        float src = 0;
+        if (phase >= 1) {
+            phase -= 1;
+            src = 1;
+        }
+        float y = r1.step(src, f1, 80) * 1.0f + r2.step(src, f2, 100) * 0.5f + r3.step(src, f3, 150) * 0.25f;
+        float env = fminf(1.0f, fminf(i / (0.03f * RATE), (n - i) / (0.05f * RATE)));
+        float v = y * env * amp * 60000.0f;
+        out[i] = (int16_t)fmaxf(-32768, fminf(32767, v));
+    }
+    return out;
+}
+
+static const std::vector<vowel_t> KEYWORD = { V_A, V_I, V_U, V_A };
+static const std::vector<std::vector<vowel_t>> DISTRACTORS = {
+    { V_U, V_E, V_A, V_I },
+    { V_O, V_O, V_E, V_E },
+    { V_I, V_A, V_O, V_U, V_I },
+};
+
+static pcm_t keyword_take() {
+    return synth_word(KEYWORD, 150, 0.85f + 0.3f * frand(), 100 + 50 * frand(), 0.4f + 0.5f * frand());
+}
+
+static void add_noise(pcm_t &x, float rms) {
+    for (auto &s : x) {
+        float n = (frand() + frand() + frand() - 1.5f) * 2.0f * rms;
+        s = (int16_t)fmaxf(-32768, fminf(32767, s + n));
+    }
+}
+
+static void append(pcm_t &dst, const pcm_t &src) {
+    dst.insert(dst.end(), src.begin(), src.end());
+}
+
+static void append_silence(pcm_t &dst, float seconds) {
+    dst.insert(dst.end(), (size_t)(seconds * RATE), 0);
+}
+
+// ---- Driving the engine ----------------------------------------------------
+
+struct run_result {
+    std::vector<double> detections;     // Seconds
+    kws_event_t last_enroll = KWS_EVENT_NONE;
+    double cpu_seconds = 0;
+};
+
+static run_result run(kws_t *kws, const pcm_t &x) {
+    run_result r;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < x.size(); i += BLOCK) {
+        size_t n = x.size() - i < BLOCK ? x.size() - i : BLOCK;
+        kws_result_t res;
+        kws_event_t ev = kws_process(kws, x.data() + i, n, &res);
+        if (ev == KWS_EVENT_DETECTED) {
+            r.detections.push_back((double)(i + n) / RATE);
+        } else if (ev == KWS_EVENT_ENROLLED || ev == KWS_EVENT_ENROLL_FAILED) {
+            r.last_enroll = ev;
+        }
+    }
+    r.cpu_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return r;
+}
+
+static bool enroll(kws_t *kws, const pcm_t &utterance) {
+    pcm_t x;
+    append_silence(x, 0.5f);
+    append(x, utterance);
+    append_silence(x, 0.6f);
+    add_noise(x, 30);
+    if (!kws_enroll_begin(kws)) return false;
+    run_result r = run(kws, x);
+    return r.last_enroll == KWS_EVENT_ENROLLED;
+}
+
+static bool load_wav(const char *path, pcm_t &out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t hdr[12];
+    bool ok = fread(hdr, 1, 12, f) == 12 && !memcmp(hdr, "RIFF", 4) && !memcmp(hdr + 8, "WAVE", 4);
+    uint16_t channels = 0, bits = 0;
+    uint32_t rate = 0;
+    while (ok) {
+        uint8_t ch[8];
+        if (fread(ch, 1, 8, f) != 8) { ok = false; break; }
+        uint32_t size = ch[4] | ch[5] << 8 | ch[6] << 16 | (uint32_t)ch[7] << 24;
+        if (!memcmp(ch, "fmt ", 4)) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16) { ok = false; break; }
+            channels = fmt[2] | fmt[3] << 8;
+            rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            bits = fmt[14] | fmt[15] << 8;
+            fseek(f, size - 16 + (size & 1), SEEK_CUR);
+        } else if (!memcmp(ch, "data", 4)) {
+            if (channels != 1 || bits != 16 || rate != RATE) {
+                fprintf(stderr, "%s: need 16-bit mono %d Hz\n", path, RATE);
+                ok = false;
+                break;
+            }
+            out.resize(size / 2);
+            out.resize(fread(out.data(), 2, out.size(), f));
+            break;
+        } else {
+            fseek(f, size + (size & 1), SEEK_CUR);
+        }
+    }
+    fclose(f);
+    return ok && !out.empty();
+}
+
+static int run_files(int argc, char **argv) {
+    kws_t *kws = kws_create(RATE, NULL);
+    int i = 1;
+    for (; i < argc && strcmp(argv[i], "--") != 0; i++) {
+        pcm_t x;
+        if (!load_wav(argv[i], x)) return 1;
+        kws_enroll_begin(kws);
+        run_result r = run(kws, x);
+        printf("enroll %s: %s\n", argv[i], r.last_enroll == KWS_EVENT_ENROLLED ? "ok" : "failed");
+    }
+    printf("threshold %u\n", kws_calibrate(kws));
+    for (i++; i < argc; i++) {
+        pcm_t x;
+        if (!load_wav(argv[i], x)) return 1;
+        kws_reset(kws);
+        run_result r = run(kws, x);
+        kws_stats_t st;
+        kws_get_stats(kws, &st);
+        printf("%s: %zu detection(s), best score %u, %.2f ms CPU per second of audio\n",
+               argv[i], r.detections.size(), st.best_score,
+               r.cpu_seconds * 1000 / ((double)x.size() / RATE));
+        for (double t : r.detections) printf("    at %.2f s\n", t);
+    }
+    kws_destroy(kws);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) return run_files(argc, argv);
+    srand(1);
+
+    kws_t *kws = kws_create(RATE, NULL);
+    if (!kws) {
+        printf("create failed\n");
+        return 1;
+    }
+
+    printf("Enrollment\n");
+    int enrolled = 0;
+    for (int i = 0; i < 3; i++) enrolled += enroll(kws, keyword_take());
+    check("templates stored", enrolled, 3, 3);
+    uint16_t threshold = kws_calibrate(kws);
+    printf("    calibrated threshold %u\n", threshold);
+    pcm_t blip;
+    append_silence(blip, 0.5f);
+    for (int i = 0; i < RATE / 10; i++) blip.push_back((int16_t)(8000 * sinf(2 * (float)M_PI * 440 * i / RATE)));
+    append_silence(blip, 1.0f);
+    kws_enroll_begin(kws);
+    check("too-short utterance rejected", run(kws, blip).last_enroll == KWS_EVENT_ENROLL_FAILED, 1, 1);
+
+    printf("Detection\n");
+    const int keywords = 10, distractors = 12;
+    std::vector<double> expected;
+    pcm_t stream;
+    append_silence(stream, 2.0f);
+    for (int i = 0, k = 0, d = 0; k < keywords || d < distractors; i++) {
+        if (k < keywords && (i % 2 == 0 || d >= distractors)) {
+            pcm_t w = keyword_take();
+            expected.push_back((double)(stream.size() + w.size()) / RATE);
+            append(stream, w);
+            k++;
+        } else {
+            const auto &seq = DISTRACTORS[d % DISTRACTORS.size()];
+            append(stream, synth_word(seq, 150, 0.85f + 0.3f * frand(), 100 + 50 * frand(), 0.4f + 0.5f * frand()));
+            d++;
+        }
+        append_silence(stream, 1.2f + frand());
+    }
+    add_noise(stream, 30);
+
+    kws_reset(kws);
+    run_result r = run(kws, stream);
+    int hits = 0, false_alarms = 0;
+    for (double t : r.detections) {
+        bool hit = false;
+        for (double e : expected) {
+            if (t > e - 0.3 && t < e + 0.5) hit = true;
+        }
+        hits += hit;
+        false_alarms += !hit;
+    }
+    check("keywords detected", hits, keywords - 1, keywords);
+    check("false alarms", false_alarms, 0, 0);
+
+    printf("CPU per second of audio\n");
+    pcm_t silence;
+    append_silence(silence, 20.0f);
+    add_noise(silence, 30);
+    kws_reset(kws);
+    run_result idle = run(kws, silence);
+    printf("    idle (gated)     %8.3f ms\n", idle.cpu_seconds * 1000 / 20.0);
+
+    pcm_t babble;
+    while (babble.size() < 20u * RATE) append(babble, synth_word(DISTRACTORS[babble.size() % 3], 150, 1, 120, 0.8f));
+    kws_reset(kws);
+    run_result busy = run(kws, babble);
+    printf("    active, %zu templates %6.3f ms\n", kws_template_count(kws),
+           busy.cpu_seconds * 1000 / ((double)babble.size() / RATE));
+
+    kws_destroy(kws);
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,584 @@
+// tools/latency_bench.cpp - End-to-end turn latency against tools/mock_gemini_server
+//
+// Runs the firmware's network and answer pipeline natively: request bodies
+// of src/text_query and src/voice_query with the history of
+// src/conversation, sent by src/http_session over src/tls_conn (a plain
+// socket transport here, like tls_transport_mbedtls_create(false) on the
+// device), read by src/gemini_stream into src/stream_collector or by
+// src/gemini_reply, cut by src/sentence_split into the sentences
+// text-to-speech fetches one by one from translate_tts, on a connection of
+// their own each as the Audio library does. Text turns,
+// streamed and whole, then streamed voice turns are asked one after
+// another, and the report gives p50/p95/p99 of:
+//   first token   the first text of the answer on screen
+//   first audio   the first byte of speech for the first sentence
+//   turn          until the last sentence has been spoken
+// Sentences are spoken in order, each once its audio starts and the one
+// before has ended; playback runs on a clock kept here rather than in real
+// time, so a turn takes as long as its network part.
+//
+// The model's delays are the mock's settings; --set name=value changes one
+// through /mock/config before the run (see mock_gemini_server --help).
+//
+// Build and run from this directory:
+//   g++ -O2 mock_gemini_server.cpp -lpthread -o mock_gemini_server
+//   g++ -O2 -I../src latency_bench.cpp ../src/text_query.cpp ../src/voice_query.cpp ../src/request_writer.cpp ../src/conversation.cpp ../src/base64_stream.cpp ../src/http_session.cpp ../src/tls_conn.cpp ../src/gemini_stream.cpp ../src/gemini_reply.cpp ../src/sse_parser.cpp ../src/sentence_split.cpp ../src/stream_collector.cpp -lpthread -o latency_bench
+//   ./mock_gemini_server --port 8787 & ./latency_bench --port 8787 [--turns 40] [--uplink-kbps 2000] [--set jitter_ms=300]; kill %1
+//
+// Exits non-zero if a check fails.
+
+#include "conversation.h"
+#include "gemini_reply.h"
+#include "gemini_stream.h"
+#include "http_session.h"
+#include "request_writer.h"
+#include "sentence_split.h"
+#include "stream_collector.h"
+#include "text_query.h"
+#include "tls_conn.h"
+#include "voice_query.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define REQUEST_TIMEOUT_MS  30000
+#define ANSWER_MAX          4096
+#define MP3_FRAME_BYTES     96          // The mock's frames: 32 kbps
+#define MP3_FRAME_MS        24
+#define SAMPLE_RATE         16000
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const char *s_host = "127.0.0.1";
+static uint16_t s_port = 8787;
+static int s_uplink_kbps = 0;
+
+// ---------------------------------------------------------------------------
+// Plain socket transport; with an uplink rate, writes take as long as they
+// would on a link that slow
+
+struct SockTransport {
+    tls_transport_t base;
+    int fd;
+};
+
+static SockTransport *self(tls_transport_t *t) {
+    return (SockTransport *)t;
+}
+
+static void st_close(tls_transport_t *t) {
+    if (self(t)->fd >= 0) close(self(t)->fd);
+    self(t)->fd = -1;
+}
+
+static tls_connect_result_t st_connect(tls_transport_t *t, const char *host, uint16_t port,
+                                       bool resume, uint32_t timeout_ms) {
+    (void)resume;
+    (void)timeout_ms;
+    st_close(t);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return TLS_CONNECT_FAILED;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    self(t)->fd = fd;
+    return TLS_CONNECT_FULL;
+}
+
+static bool st_alive(tls_transport_t *t) {
+    char b;
+    if (self(t)->fd < 0) return false;
+    int n = recv(self(t)->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static bool st_write(tls_transport_t *t, const void *data, size_t len, uint32_t timeout_ms) {
+    (void)timeout_ms;
+    if (s_uplink_kbps > 0) usleep((useconds_t)(len * 8000.0 / s_uplink_kbps));
+    return self(t)->fd >= 0 && send(self(t)->fd, data, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static int st_read(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms) {
+    if (self(t)->fd < 0) return -1;
+    struct pollfd p = { self(t)->fd, POLLIN, 0 };
+    if (poll(&p, 1, (int)timeout_ms) == 0) return 0;
+    ssize_t n = recv(self(t)->fd, buf, len, 0);
+    return n > 0 ? (int)n : -1;
+}
+
+static void st_forget_session(tls_transport_t *t) {
+    (void)t;
+}
+
+static void st_destroy(tls_transport_t *t) {
+    st_close(t);
+    delete self(t);
+}
+
+static const tls_transport_ops_t s_sock_ops = {
+    st_connect, st_alive, st_write, st_read, st_close, st_forget_session, st_destroy,
+};
+
+static tls_conn_t *make_conn(uint32_t max_requests) {
+    SockTransport *s = new SockTransport();
+    s->base.ops = &s_sock_ops;
+    s->fd = -1;
+    tls_conn_config_t cfg;
+    tls_conn_default_config(&cfg);
+    cfg.max_requests = max_requests;
+    return tls_conn_create(&s->base, s_host, s_port, &cfg);
+}
+
+// ---------------------------------------------------------------------------
+// Requests, with the bodies of src/text_query and src/voice_query
+
+static constexpr char GEMINI_MODEL_PATH[] = "/v1beta/models/gemini-2.0-flash:generateContent?key=mock";
+static constexpr char GEMINI_STREAM_PATH[] =
+    "/v1beta/models/gemini-2.0-flash:streamGenerateContent?alt=sse&key=mock";
+// What the microphone recorded: a 16 kHz mono WAV of a tone
+static std::vector<uint8_t> make_clip(int seconds) {
+    size_t samples = (size_t)SAMPLE_RATE * seconds;
+    std::vector<uint8_t> wav(44 + samples * 2);
+    uint32_t data = (uint32_t)samples * 2;
+    uint32_t riff = 36 + data, fmt = 16, rate = SAMPLE_RATE, bytes_per_sec = SAMPLE_RATE * 2;
+    uint16_t pcm = 1, channels = 1, align = 2, bits = 16;
+    uint8_t *p = wav.data();
+    memcpy(p, "RIFF", 4); memcpy(p + 4, &riff, 4); memcpy(p + 8, "WAVEfmt ", 8);
+    memcpy(p + 16, &fmt, 4); memcpy(p + 20, &pcm, 2); memcpy(p + 22, &channels, 2);
+    memcpy(p + 24, &rate, 4); memcpy(p + 28, &bytes_per_sec, 4); memcpy(p + 32, &align, 2);
+    memcpy(p + 34, &bits, 2); memcpy(p + 36, "data", 4); memcpy(p + 40, &data, 4);
+    for (size_t i = 0; i < samples; i++) {
+        int16_t s = (int16_t)(8000 * ((i / 20) % 2 ? 1 : -1));
+        memcpy(p + 44 + i * 2, &s, 2);
+    }
+    return wav;
+}
+
+// ---------------------------------------------------------------------------
+// Text-to-speech: the audio task takes sentences in order and fetches each
+// from translate_tts
+
+struct Sentence {
+    std::string text;
+    double arrived_ms;              // From the start of the turn
+    double latency_ms;              // Request to the first byte of audio
+    double duration_ms;             // Of the audio
+    bool ok;
+};
+
+struct Speaker {
+    tls_conn_t *conn;
+    double start_ms;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<size_t> queue;
+    std::vector<Sentence> sentences;
+    bool ended;
+    std::thread thread;
+};
+
+static void url_encode(const char *s, std::string *out) {
+    static const char HEX[] = "0123456789ABCDEF";
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~') {
+            *out += (char)c;
+        } else {
+            *out += '%';
+            *out += HEX[c >> 4];
+            *out += HEX[c & 15];
+        }
+    }
+}
+
+static void speak(Speaker *sp, Sentence *s) {
+    std::string path = "/translate_tts?ie=UTF-8&tl=vi&client=tw-ob&q=";
+    url_encode(s->text.c_str(), &path);
+    http_request_t req = {};
+    req.method = "GET";
+    req.path = path.c_str();
+    req.timeout_ms = REQUEST_TIMEOUT_MS;
+
+    double t0 = now_ms();
+    http_session_t hs;
+    int status = http_session_begin(&hs, sp->conn, &req);
+    size_t bytes = 0;
+    char buf[1024];
+    int n;
+    while (status == 200 && (n = http_session_read(&hs, buf, sizeof(buf))) > 0) {
+        if (bytes == 0) s->latency_ms = now_ms() - t0;
+        bytes += (size_t)n;
+    }
+    http_session_end(&hs);
+    s->duration_ms = (double)(bytes / MP3_FRAME_BYTES) * MP3_FRAME_MS;
+    s->ok = status == 200 && bytes > 0 && hs.done;
+}
+
+static void speaker_task(Speaker *sp) {
+    for (;;) {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lock(sp->lock);
+            sp->wake.wait(lock, [&] { return !sp->queue.empty() || sp->ended; });
+            if (sp->queue.empty()) return;
+            i = sp->queue.front();
+            sp->queue.pop_front();
+        }
+        Sentence s;
+        {
+            std::lock_guard<std::mutex> lock(sp->lock);
+            s = sp->sentences[i];
+        }
+        speak(sp, &s);
+        std::lock_guard<std::mutex> lock(sp->lock);
+        sp->sentences[i] = s;
+    }
+}
+
+static void speaker_start(Speaker *sp, double start_ms) {
+    sp->start_ms = start_ms;
+    sp->queue.clear();
+    sp->sentences.clear();
+    sp->ended = false;
+    sp->thread = std::thread(speaker_task, sp);
+}
+
+static void on_sentence(void *ctx, const char *text, size_t len) {
+    Speaker *sp = (Speaker *)ctx;
+    std::lock_guard<std::mutex> lock(sp->lock);
+    sp->sentences.push_back({std::string(text, len), now_ms() - sp->start_ms, 0, 0, false});
+    sp->queue.push_back(sp->sentences.size() - 1);
+    sp->wake.notify_one();
+}
+
+static void speaker_finish(Speaker *sp) {
+    {
+        std::lock_guard<std::mutex> lock(sp->lock);
+        sp->ended = true;
+        sp->wake.notify_one();
+    }
+    sp->thread.join();
+}
+
+// ---------------------------------------------------------------------------
+// Turns
+
+enum Mode { TEXT_STREAM, TEXT_WHOLE, VOICE_STREAM, MODE_COUNT };
+
+static const char *MODE_NAMES[MODE_COUNT] = {
+    "text, streamGenerateContent",
+    "text, generateContent",
+    "voice, streamGenerateContent",
+};
+
+static const char *QUESTIONS[] = {
+    "Thời tiết Hà Nội hôm nay thế nào?",
+    "Bây giờ là mấy giờ?",
+    "Kể chuyện cho tôi nghe đi",
+    "Bạn tên là gì?",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+struct Turn {
+    int status;
+    double first_token_ms;
+    double first_audio_ms;
+    double total_ms;
+    std::string transcript;
+    std::string answer;
+    std::vector<Sentence> sentences;
+    bool spoken;                    // Every sentence's audio came
+};
+
+// The streamed answer, collected by src/stream_collector as in
+// gemini_client.cpp: shown and cut into sentences as it comes
+struct Collector {
+    Turn *turn;
+    double start_ms;
+    sentence_split_t split;
+};
+
+static void show_transcript(void *ctx, const char *text) {
+    ((Collector *)ctx)->turn->transcript = text;
+}
+
+static void show_piece(void *ctx, const char *text, size_t len) {
+    Collector *c = (Collector *)ctx;
+    if (c->turn->first_token_ms == 0) c->turn->first_token_ms = now_ms() - c->start_ms;
+    sentence_split_feed(&c->split, text, len);
+}
+
+// Spoken in order: each sentence once its audio starts and the previous
+// one has ended
+static void play_out(Turn *t, double answer_end_ms) {
+    double end = 0;
+    t->spoken = !t->sentences.empty();
+    for (size_t i = 0; i < t->sentences.size(); i++) {
+        const Sentence &s = t->sentences[i];
+        t->spoken = t->spoken && s.ok;
+        double start = std::max(s.arrived_ms, end) + s.latency_ms;
+        if (i == 0) t->first_audio_ms = start;
+        end = start + s.duration_ms;
+    }
+    t->total_ms = std::max(end, answer_end_ms);
+}
+
+static void remember(conversation_t *history, const std::string &question, const std::string &answer) {
+    conversation_add(history, CONVERSATION_USER, question.c_str());
+    conversation_add(history, CONVERSATION_MODEL, answer.c_str());
+}
+
+static Turn run_turn(Mode mode, tls_conn_t *conn, Speaker *sp, conversation_t *history,
+                     const char *question, const std::vector<uint8_t> &clip) {
+    Turn t = {};
+    Collector c = {&t, now_ms(), {}};
+    sentence_split_init(&c.split, on_sentence, sp);
+    speaker_start(sp, c.start_ms);
+
+    request_writer_t body;
+    if (mode == VOICE_STREAM) {
+        voice_query_body(&body, history, clip.data(), clip.size(), VOICE_QUERY_STREAM);
+    } else {
+        text_query_body(&body, history, question);
+    }
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = mode == TEXT_WHOLE ? GEMINI_MODEL_PATH : GEMINI_STREAM_PATH;
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = mode == TEXT_WHOLE ? "application/json" : "text/event-stream";
+    req.body_fn = request_writer_read;
+    req.body_ctx = &body;
+    req.body_len = request_writer_size(&body);
+    req.timeout_ms = REQUEST_TIMEOUT_MS;
+
+    if (mode == TEXT_WHOLE) {
+        // Nothing to show or say until the whole reply is in
+        http_session_t hs;
+        t.status = http_session_begin(&hs, conn, &req);
+        char answer[ANSWER_MAX];
+        gemini_reply_t reply;
+        gemini_reply_init(&reply, answer, sizeof(answer));
+        char buf[512];
+        int n;
+        while (t.status == 200 && (n = http_session_read(&hs, buf, sizeof(buf))) > 0) {
+            gemini_reply_feed(&reply, buf, (size_t)n);
+        }
+        http_session_end(&hs);
+        if (t.status == 200 && gemini_reply_finish(&reply) && reply.len > 0) {
+            t.first_token_ms = now_ms() - c.start_ms;
+            t.answer.assign(answer, reply.len);
+            sentence_split_feed(&c.split, answer, reply.len);
+        }
+    } else {
+        stream_collector_t sc;
+        stream_collector_init(&sc, mode == VOICE_STREAM);
+        sc.on_transcript = show_transcript;
+        sc.on_text = show_piece;
+        sc.ctx = &c;
+        gemini_stream_result_t res;
+        t.status = gemini_stream_run(conn, &req, stream_collector_feed, &sc, &res);
+        char *answer = stream_collector_finish(&sc);
+        if (answer) t.answer = answer;
+        free(answer);
+    }
+    sentence_split_finish(&c.split);
+    double answer_end = now_ms() - c.start_ms;
+    speaker_finish(sp);
+
+    t.sentences = sp->sentences;
+    if (t.status == 200 && !t.answer.empty()) {
+        play_out(&t, answer_end);
+        remember(history, mode == VOICE_STREAM ? t.transcript : question, t.answer);
+    }
+    return t;
+}
+
+// ---------------------------------------------------------------------------
+// Report
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t rank = (size_t)(p / 100.0 * v.size() + 0.999999);
+    return v[rank > 0 ? rank - 1 : 0];
+}
+
+struct Run {
+    std::vector<Turn> turns;
+    std::vector<double> first_token, first_audio, total;
+    int failed = 0;
+    bool refused_only = true;       // Every failure was the mock's injected 503
+};
+
+static void print_row(const char *name, const std::vector<double> &v) {
+    printf("    %-22s %8.0f %8.0f %8.0f\n", name, percentile(v, 50), percentile(v, 95), percentile(v, 99));
+}
+
+// A setting of the mock, from the /mock/config reply
+static int mock_setting(const std::string &json, const char *name) {
+    std::string key = std::string("\"") + name + "\": ";
+    size_t at = json.find(key);
+    return at == std::string::npos ? -1 : atoi(json.c_str() + at + key.size());
+}
+
+static bool mock_config(tls_conn_t *conn, const std::string &query, std::string *json) {
+    std::string path = "/mock/config" + (query.empty() ? "" : "?" + query);
+    http_request_t req = {};
+    req.method = "GET";
+    req.path = path.c_str();
+    req.timeout_ms = 2000;
+    http_session_t hs;
+    int status = http_session_begin(&hs, conn, &req);
+    char *body = status == 200 ? http_session_read_body(&hs, 4096, NULL) : NULL;
+    http_session_end(&hs);
+    if (!body) return false;
+    *json = body;
+    free(body);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int turns = 40;
+    int voice_seconds = 3;
+    std::string set;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--host") == 0 && has_value) s_host = argv[++i];
+        else if (strcmp(argv[i], "--port") == 0 && has_value) s_port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--turns") == 0 && has_value) turns = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--voice-seconds") == 0 && has_value) voice_seconds = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--uplink-kbps") == 0 && has_value) s_uplink_kbps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--set") == 0 && has_value) set += (set.empty() ? "" : "&") + std::string(argv[++i]);
+        else {
+            printf("latency_bench [--host ADDR] [--port N] [--turns N] [--voice-seconds N] "
+                   "[--uplink-kbps N] [--set name=value]...\n");
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    tls_conn_t *conn = make_conn(0);
+    std::string config;
+    if (!mock_config(conn, set, &config)) {
+        printf("No mock server at %s:%u (start ./mock_gemini_server first), or a bad --set\n", s_host, s_port);
+        tls_conn_destroy(conn);
+        return 1;
+    }
+    int first_token = mock_setting(config, "first_token_ms");
+    int fail_every = mock_setting(config, "fail_every");
+    printf("Mock at %s:%u: %s\n", s_host, s_port, config.c_str());
+    printf("%d turns per mode, %d s voice clips, uplink %s\n\n", turns, voice_seconds,
+           s_uplink_kbps > 0 ? (std::to_string(s_uplink_kbps) + " kbps").c_str() : "unlimited");
+
+    // translate_tts: a new connection for every sentence, as the Audio library makes
+    Speaker sp;
+    sp.conn = make_conn(1);
+    std::vector<uint8_t> clip = make_clip(voice_seconds);
+    Run runs[MODE_COUNT];
+
+    for (int m = 0; m < MODE_COUNT; m++) {
+        Run &r = runs[m];
+        conversation_t *history = conversation_create(NULL);
+        for (int i = 0; i < turns; i++) {
+            Turn t = run_turn((Mode)m, conn, &sp, history, QUESTIONS[i % COUNT(QUESTIONS)], clip);
+            if (t.status != 200 || t.answer.empty() || !t.spoken) {
+                r.failed++;
+                r.refused_only = r.refused_only && t.status == 503 && fail_every > 0;
+            } else {
+                r.first_token.push_back(t.first_token_ms);
+                r.first_audio.push_back(t.first_audio_ms);
+                r.total.push_back(t.total_ms);
+            }
+            r.turns.push_back(t);
+        }
+        conversation_stats_t st;
+        conversation_get_stats(history, &st);
+        conversation_destroy(history);
+
+        printf("%s\n", MODE_NAMES[m]);
+        char label[128];
+        snprintf(label, sizeof(label), "%d of %d turns answered and spoken", turns - r.failed, turns);
+        check(label, r.failed == 0 || r.refused_only);
+        bool ordered = true;
+        for (const Turn &t : r.turns) {
+            if (t.status == 200 && t.spoken) {
+                ordered = ordered && t.first_token_ms <= t.first_audio_ms && t.first_audio_ms <= t.total_ms;
+            }
+        }
+        check("first token, then first audio, then the end of the turn", ordered);
+        check("history sent with each request", st.added == (uint32_t)(turns - r.failed) * 2);
+        if (m != TEXT_WHOLE) {
+            check("first token no sooner than the model's first piece",
+                  !r.first_token.empty() && percentile(r.first_token, 0) >= first_token);
+        }
+        if (m == VOICE_STREAM) {
+            bool heard = true;
+            for (const Turn &t : r.turns) {
+                if (t.status != 200) continue;
+                heard = heard && !t.transcript.empty() && t.transcript.compare(0, 2, "Q:") != 0 &&
+                        !t.sentences.empty() && t.sentences[0].text.find("Q:") == std::string::npos &&
+                        t.answer.find(t.transcript) == std::string::npos;
+            }
+            check("transcript line shown, not spoken", heard);
+        }
+        printf("    %-22s %8s %8s %8s\n", "ms", "p50", "p95", "p99");
+        print_row("first token", r.first_token);
+        print_row("first audio", r.first_audio);
+        print_row("turn", r.total);
+        printf("\n");
+    }
+
+    double streamed = percentile(runs[TEXT_STREAM].first_audio, 50);
+    double whole = percentile(runs[TEXT_WHOLE].first_audio, 50);
+    check("streaming starts speech sooner (p50 first audio)", streamed < whole);
+    printf("    first audio p50: %.0f ms streamed, %.0f ms whole, %.0f ms sooner\n",
+           streamed, whole, whole - streamed);
+
+    tls_conn_stats_t cs;
+    tls_conn_get_stats(conn, &cs);
+    printf("    model connection: %u requests, %u on the open connection, %u connects\n",
+           (unsigned)cs.requests, (unsigned)cs.reused, (unsigned)cs.full_handshakes);
+
+    tls_conn_destroy(sp.conn);
+    tls_conn_destroy(conn);
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,355 @@
+// tools/minhash_bench.cpp - Host checks and benchmark for src/minhash_index
+//
+// Checks that signatures estimate the Jaccard similarity of the 3-gram sets
+// (against the exact value), that the index finds a near duplicate among
+// thousands of unrelated questions and forgets removed ones, and that
+// response_cache answers a reworded question from the index and not a
+// different one. Prints the similarity of labelled question pairs, the
+// basis for RESPONSE_CACHE_DEFAULT_SIMILARITY. Then times lookups against
+// the size of the index, next to comparing with every signature.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src minhash_bench.cpp ../src/minhash_index.cpp ../src/response_cache.cpp -o minhash_bench
+//   ./minhash_bench
+//
+// Exits non-zero if a check fails.
+
+#include "minhash_index.h"
+#include "response_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_sec() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string norm(const std::string &text) {
+    char out[RESPONSE_CACHE_QUESTION_MAX + 1];
+    size_t n = response_cache_normalize(text.c_str(), out, sizeof(out));
+    return std::string(out, n);
+}
+
+static minhash_sig_t sig_of(const std::string &text) {
+    minhash_sig_t sig;
+    std::string n = norm(text);
+    minhash_signature(n.data(), n.size(), &sig);
+    return sig;
+}
+
+// The exact value the signatures estimate
+static double jaccard(const std::string &a, const std::string &b) {
+    auto grams = [](const std::string &text) {
+        std::string t = " " + norm(text) + " ";
+        std::vector<size_t> starts;
+        for (size_t i = 0; i < t.size(); i++) {
+            if (((unsigned char)t[i] & 0xC0) != 0x80) starts.push_back(i);
+        }
+        starts.push_back(t.size());
+        std::set<std::string> out;
+        for (size_t i = 0; i + MINHASH_NGRAM < starts.size(); i++) {
+            out.insert(t.substr(starts[i], starts[i + MINHASH_NGRAM] - starts[i]));
+        }
+        if (out.empty()) out.insert(t);
+        return out;
+    };
+    std::set<std::string> x = grams(a), y = grams(b);
+    size_t common = 0;
+    for (const std::string &g : x) common += y.count(g);
+    return (double)common / (x.size() + y.size() - common);
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic questions
+
+static const char *SYLLABLES[] = {
+    "mấy", "giờ", "mở", "cửa", "hàng", "giá", "vé", "bao", "nhiêu", "có", "chỗ", "đậu", "xe", "không",
+    "wifi", "mật", "khẩu", "là", "gì", "nhà", "vệ", "sinh", "ở", "đâu", "giảm", "cho", "sinh", "viên",
+    "hôm", "nay", "sự", "kiện", "làm", "sao", "để", "đặt", "bàn", "bán", "đồ", "chay", "thời", "tiết",
+    "ngày", "mai", "phòng", "họp", "tầng", "mấy", "thang", "máy", "thanh", "toán", "thẻ", "tiền", "mặt",
+    "giao", "hàng", "tận", "nơi", "bảo", "hành", "đổi", "trả", "món", "ăn", "ngon", "nhất", "trẻ", "em",
+    "người", "lớn", "cuối", "tuần", "buổi", "sáng", "chiều", "tối", "đường", "đi", "bến", "xe", "buýt",
+};
+static const size_t SYLLABLE_COUNT = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+static std::vector<std::string> words_of(const std::string &s) {
+    std::vector<std::string> w;
+    size_t i = 0;
+    while (i < s.size()) {
+        size_t j = s.find(' ', i);
+        if (j == std::string::npos) j = s.size();
+        w.push_back(s.substr(i, j - i));
+        i = j + 1;
+    }
+    return w;
+}
+
+static std::string join(const std::vector<std::string> &w) {
+    std::string s;
+    for (const std::string &x : w) s += (s.empty() ? "" : " ") + x;
+    return s;
+}
+
+static std::string random_question(std::mt19937 &rng) {
+    std::vector<std::string> w;
+    int n = 5 + rng() % 6;
+    for (int i = 0; i < n; i++) w.push_back(SYLLABLES[rng() % SYLLABLE_COUNT]);
+    return join(w);
+}
+
+// How a transcript of the same question tends to differ
+static std::string reword(const std::string &q, std::mt19937 &rng) {
+    std::vector<std::string> w = words_of(q);
+    switch (rng() % 4) {
+    case 0:                                         // A filler word
+        w.push_back(rng() % 2 ? "vậy" : "ạ");
+        break;
+    case 1:                                         // Two neighbours swapped
+        if (w.size() > 2) {
+            size_t i = rng() % (w.size() - 1);
+            std::swap(w[i], w[i + 1]);
+        }
+        break;
+    case 2:                                         // A word at the start
+        w.insert(w.begin(), rng() % 2 ? "cho hỏi" : "bạn ơi");
+        break;
+    default:                                        // Punctuation and case
+        return "  " + q + "???";
+    }
+    return join(w);
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+
+struct Pair {
+    const char *a;
+    const char *b;
+    bool same;
+};
+
+static const Pair PAIRS[] = {
+    { "mấy giờ mở cửa", "cửa hàng mở cửa mấy giờ", true },
+    { "giá vé bao nhiêu", "vé giá bao nhiêu vậy", true },
+    { "có chỗ đậu xe không", "ở đây có chỗ đậu xe không", true },
+    { "wifi mật khẩu là gì", "mật khẩu wifi là gì", true },
+    { "nhà vệ sinh ở đâu", "nhà vệ sinh ở đâu vậy bạn", true },
+    { "xin chào", "Xin chào bạn!", true },
+    { "mấy giờ mở cửa", "mấy giờ đóng cửa", false },
+    { "giá vé bao nhiêu", "giá vé người lớn bao nhiêu", false },
+    { "nhà vệ sinh ở đâu", "nhà hàng ở đâu", false },
+    { "thời tiết hôm nay thế nào", "thời tiết ngày mai thế nào", false },
+};
+
+static void check_signatures() {
+    printf("signatures\n");
+    minhash_sig_t a = sig_of("mấy giờ mở cửa"), b = sig_of("Mấy giờ mở cửa?");
+    check("same question: similarity 1", minhash_similarity(&a, &b) == 1.0f);
+    minhash_sig_t e = sig_of(""), x = sig_of("x");
+    check("empty and one-letter texts still get a signature",
+          minhash_similarity(&e, &e) == 1.0f && minhash_similarity(&e, &x) < 1.0f);
+
+    std::mt19937 rng(3);
+    double err = 0, worst = 0;
+    const int N = 3000;
+    for (int i = 0; i < N; i++) {
+        std::string p = random_question(rng);
+        std::string q = i % 2 ? reword(p, rng) : random_question(rng);
+        minhash_sig_t sp = sig_of(p), sq = sig_of(q);
+        double d = fabs(minhash_similarity(&sp, &sq) - jaccard(p, q));
+        err += d;
+        worst = std::max(worst, d);
+    }
+    printf("    estimate vs exact Jaccard: mean error %.3f, worst %.3f over %d pairs\n", err / N, worst, N);
+    check("estimate within 0.05 of the exact value on average", err / N < 0.05);
+
+    printf("    %-28s %-30s %6s %6s\n", "", "", "exact", "est.");
+    bool separated = true;
+    double lowest_same = 1, highest_other = 0;
+    for (const Pair &p : PAIRS) {
+        minhash_sig_t sa = sig_of(p.a), sb = sig_of(p.b);
+        double j = jaccard(p.a, p.b);
+        printf("    %s %-26s %-30s %6.2f %6.2f\n", p.same ? "=" : "x", p.a, p.b, j, minhash_similarity(&sa, &sb));
+        if (p.same) lowest_same = std::min(lowest_same, j);
+        else highest_other = std::max(highest_other, j);
+    }
+    separated = lowest_same >= RESPONSE_CACHE_DEFAULT_SIMILARITY && highest_other < RESPONSE_CACHE_DEFAULT_SIMILARITY;
+    check("default threshold between the labelled pairs (exact values)", separated);
+}
+
+static void check_index() {
+    printf("index\n");
+    const int N = 4096;
+    minhash_index_t *idx = minhash_index_create(N);
+    std::mt19937 rng(5);
+    std::vector<std::string> qs;
+    for (int i = 0; i < N; i++) {
+        qs.push_back(random_question(rng));
+        minhash_sig_t s = sig_of(qs.back());
+        minhash_index_set(idx, (uint16_t)i, &s);
+    }
+    int found = 0, exact = 0;
+    const int Q = 1000;
+    for (int i = 0; i < Q; i++) {
+        int id = rng() % N;
+        std::string r = reword(qs[id], rng);
+        if (jaccard(r, qs[id]) < 0.7) continue;
+        exact++;
+        minhash_sig_t s = sig_of(r);
+        float sim = 0;
+        int got = minhash_index_query(idx, &s, 0.6f, &sim);
+        found += got == id || (got >= 0 && norm(qs[got]) == norm(qs[id]));
+    }
+    printf("    %d of %d rewordings at 0.7 or more found among %d questions\n", found, exact, N);
+    check("near duplicates found (recall at least 95%)", found >= exact * 95 / 100);
+
+    minhash_sig_t s = sig_of(qs[7]);
+    check("exact question found", minhash_index_query(idx, &s, 0.6f, NULL) == 7);
+    minhash_index_remove(idx, 7);
+    int after = minhash_index_query(idx, &s, 0.6f, NULL);
+    check("removed entry not returned", after != 7);
+    minhash_index_set(idx, 7, &s);
+    minhash_index_set(idx, 7, &s);
+    minhash_index_stats_t st;
+    minhash_index_get_stats(idx, &st);
+    check("setting an id twice indexes it once", st.entries == (uint32_t)N && minhash_index_query(idx, &s, 0.6f, NULL) == 7);
+    minhash_sig_t other = sig_of("một câu hoàn toàn khác không liên quan gì");
+    check("unrelated question: nothing", minhash_index_query(idx, &other, 0.6f, NULL) == -1);
+
+    // Every signature the same: buckets hold everything, the limits hold the time
+    minhash_index_clear(idx);
+    for (int i = 0; i < N; i++) minhash_index_set(idx, (uint16_t)i, &s);
+    minhash_index_stats_t before;
+    minhash_index_get_stats(idx, &before);
+    minhash_sig_t near = sig_of(qs[7] + " vậy");
+    minhash_index_query(idx, &near, 0.99f, NULL);
+    minhash_index_get_stats(idx, &st);
+    check("crowded buckets: query stops at the limits",
+          st.probes - before.probes <= MINHASH_MAX_PROBES && st.candidates - before.candidates <= MINHASH_MAX_CANDIDATES &&
+              st.capped == before.capped + 1);
+    minhash_index_destroy(idx);
+    check("capacity over the maximum refused", minhash_index_create(MINHASH_MAX_CAPACITY + 1) == NULL);
+}
+
+static std::string cache_get(response_cache_t *c, const char *q) {
+    char *a = response_cache_get(c, q, 1760000000);
+    std::string s = a ? a : "";
+    free(a);
+    return s;
+}
+
+static void check_cache() {
+    printf("response_cache near matches\n");
+    const uint32_t now = 1760000000;
+    response_cache_config_t cfg = {};
+    cfg.max_entries = 4;
+    cfg.similarity = RESPONSE_CACHE_DEFAULT_SIMILARITY;
+    response_cache_t *c = response_cache_create(&cfg);
+    response_cache_put(c, "Mấy giờ mở cửa?", "Từ 8 giờ sáng.", now);
+    check("reworded question answered", cache_get(c, "Cửa hàng mở cửa mấy giờ") == "Từ 8 giờ sáng.");
+    response_cache_stats_t st;
+    response_cache_get_stats(c, &st);
+    check("counted as a near hit", st.hits == 1 && st.near_hits == 1);
+    check("different question not answered", cache_get(c, "Mấy giờ đóng cửa?") == "");
+    response_cache_set_similarity(c, 0);
+    check("threshold 0: exact matches only",
+          cache_get(c, "Cửa hàng mở cửa mấy giờ") == "" && cache_get(c, "mấy giờ mở cửa") == "Từ 8 giờ sáng.");
+    response_cache_set_similarity(c, RESPONSE_CACHE_DEFAULT_SIMILARITY);
+    for (const char *q : { "một", "hai", "ba", "bốn" }) response_cache_put(c, q, q, now);
+    check("evicted entry no longer matched", cache_get(c, "Cửa hàng mở cửa mấy giờ") == "");
+    response_cache_destroy(c);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark
+
+static void bench() {
+    printf("lookup time against index size (rewordings and unrelated questions)\n");
+    printf("    %7s %9s %10s %10s %10s %8s %8s %10s\n", "entries", "memory", "hit (us)", "p99 (us)", "miss (us)",
+           "compared", "walked", "scan (us)");
+    std::mt19937 rng(11);
+    for (int n : { 64, 256, 1024, 4096, 16384, 32767 }) {
+        minhash_index_t *idx = minhash_index_create((uint16_t)n);
+        std::vector<std::string> qs;
+        std::vector<minhash_sig_t> sigs;
+        for (int i = 0; i < n; i++) {
+            qs.push_back(random_question(rng));
+            sigs.push_back(sig_of(qs.back()));
+            minhash_index_set(idx, (uint16_t)i, &sigs.back());
+        }
+        const int Q = 2000;
+        std::vector<std::string> hits, misses;
+        for (int i = 0; i < Q; i++) {
+            hits.push_back(norm(reword(qs[rng() % n], rng)));
+            misses.push_back(norm(random_question(rng)));
+        }
+        std::vector<double> times;
+        minhash_index_stats_t st0, st1;
+        minhash_index_get_stats(idx, &st0);
+        int found = 0;
+        for (const std::string &h : hits) {
+            double t0 = now_sec();
+            minhash_sig_t s;
+            minhash_signature(h.data(), h.size(), &s);
+            found += minhash_index_query(idx, &s, 0.6f, NULL) >= 0;
+            times.push_back(now_sec() - t0);
+        }
+        minhash_index_get_stats(idx, &st1);
+        std::sort(times.begin(), times.end());
+        double hit_us = 0;
+        for (double t : times) hit_us += t;
+        hit_us = hit_us / Q * 1e6;
+        double p99 = times[Q * 99 / 100] * 1e6;
+        double t0 = now_sec();
+        for (const std::string &m : misses) {
+            minhash_sig_t s;
+            minhash_signature(m.data(), m.size(), &s);
+            found += minhash_index_query(idx, &s, 0.6f, NULL) >= 0;
+        }
+        double miss_us = (now_sec() - t0) / Q * 1e6;
+        // Without the index: every signature compared
+        t0 = now_sec();
+        for (const std::string &h : hits) {
+            minhash_sig_t s;
+            minhash_signature(h.data(), h.size(), &s);
+            float best = 0;
+            for (const minhash_sig_t &g : sigs) best = std::max(best, minhash_similarity(&s, &g));
+            found += best >= 0.6f;
+        }
+        double scan_us = (now_sec() - t0) / Q * 1e6;
+        minhash_index_stats_t st;
+        minhash_index_get_stats(idx, &st);
+        printf("    %7d %7.0fKB %10.2f %10.2f %10.2f %8.1f %8.1f %10.2f\n", n, st.memory / 1024.0, hit_us, p99,
+               miss_us, (double)(st1.candidates - st0.candidates) / Q, (double)(st1.probes - st0.probes) / Q,
+               scan_us);
+        if (found < 0) printf("unreachable\n");
+        minhash_index_destroy(idx);
+    }
+}
+
+int main() {
+    check_signatures();
+    check_index();
+    check_cache();
+    bench();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
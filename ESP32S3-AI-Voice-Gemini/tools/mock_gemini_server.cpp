@@ -0,0 +1,598 @@
+// tools/mock_gemini_server.cpp - Local stand-in for the services a turn talks to
+//
+// Plain HTTP/1.1 with keep-alive on a Linux host, answering what the
+// firmware sends:
+//   POST .../models/<model>:generateContent?key=K          the whole reply, once the model is done
+//   POST .../models/<model>:streamGenerateContent?alt=sse  the answer in server-sent events
+//   GET  .../models/<model>:generateContent?key=K          the API key test
+//   GET  /translate_tts?...&q=TEXT                         MP3 frames for TEXT (Google Translate TTS)
+//   GET  /mock/config?name=value&...                       change the settings below; replies with them all
+//
+// Answers come from a script: lines of "match<TAB>answer", the first whose
+// match is part of the question wins, "*" matches anything, "\n" in an
+// answer is a line break, '#' starts a comment. Voice queries are answered
+// as if the speaker said --transcript. The key "bad" is refused the way the
+// API refuses an invalid key.
+//
+// The model's time is injectable: the first piece of an answer comes after
+// first_token_ms plus an exponential extra of mean jitter_ms (the long tail
+// of a real service), then a piece of piece_bytes every piece_ms. A
+// generateContent reply waits for the whole answer. TTS audio starts after
+// tts_first_byte_ms and lasts tts_ms_per_char per character, sent at
+// tts_kbps (0: at once). Every fail_every-th model request is answered 503,
+// and idle_close_ms closes connections idle that long, as Google does.
+//
+// Point tools/latency_bench.cpp at it, or a device at http://<host>:<port>
+// through gemini_client_set_base_url().
+//
+// Build and run from this directory:
+//   g++ -O2 mock_gemini_server.cpp -lpthread -o mock_gemini_server
+//   ./mock_gemini_server --port 8787 [--bind 0.0.0.0] [--script FILE] [--first-token-ms 450 ...] [--verbose]
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fstream>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define MAX_BODY            (2 * 1024 * 1024)
+#define MAX_HEAD            8192
+#define MP3_FRAME_BYTES     96          // MPEG-2 layer III, 32 kbps, 24 kHz, mono
+#define MP3_FRAME_MS        24
+#define TTS_SEND_FRAMES     10          // Frames per write when paced
+
+// ---------------------------------------------------------------------------
+// Settings, from the command line and /mock/config
+
+struct Setting {
+    const char *name;
+    std::atomic<int> value;
+    const char *help;
+};
+
+static Setting s_settings[] = {
+    {"first_token_ms", {450}, "model time before the first piece"},
+    {"jitter_ms", {150}, "mean of the exponential extra before the first piece"},
+    {"piece_ms", {40}, "between pieces"},
+    {"piece_bytes", {32}, "answer bytes per event"},
+    {"tts_first_byte_ms", {180}, "before the first byte of TTS audio"},
+    {"tts_ms_per_char", {65}, "speech per character of TTS text"},
+    {"tts_kbps", {0}, "TTS download rate, 0 for unpaced"},
+    {"fail_every", {0}, "answer every Nth model request with 503, 0 for never"},
+    {"idle_close_ms", {0}, "close connections idle this long, 0 for never"},
+};
+
+#define SETTING_COUNT (sizeof(s_settings) / sizeof(s_settings[0]))
+
+static Setting *setting(const char *name, size_t len) {
+    for (Setting &s : s_settings) {
+        if (strlen(s.name) == len && memcmp(s.name, name, len) == 0) return &s;
+    }
+    return nullptr;
+}
+
+static int get(const char *name) {
+    return setting(name, strlen(name))->value;
+}
+
+struct Entry {
+    std::string match;
+    std::string answer;
+};
+
+static std::vector<Entry> s_script = {
+    {"thời tiết", "Hôm nay Hà Nội trời nắng nhẹ, khoảng 28 độ. Chiều tối có thể có mưa rào rải rác. "
+                  "Bạn nhớ mang theo ô nếu ra ngoài nhé!"},
+    {"mấy giờ", "Bây giờ là 3 giờ chiều. Bạn cần tôi đặt lời nhắc không?"},
+    {"kể chuyện", "Ngày xưa có một chú mèo rất thích ngắm mưa. Mỗi chiều, chú ngồi bên cửa sổ đếm giọt. "
+                  "Một hôm trời nắng, chú buồn lắm. Thế là chú đi ngủ sớm."},
+    {"*", "Tôi hiểu rồi. Đây là câu trả lời ngắn của tôi cho câu hỏi của bạn. "
+          "Bạn muốn biết thêm điều gì nữa không?"},
+};
+static std::string s_transcript = "Thời tiết Hà Nội hôm nay thế nào?";
+static bool s_verbose = false;
+static std::atomic<bool> s_stop{false};
+static std::atomic<unsigned> s_model_requests{0};
+static std::atomic<unsigned> s_connections{0};
+static std::atomic<unsigned> s_seed{1};
+static std::mutex s_log_lock;
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void sleep_ms(double ms) {
+    if (ms > 0) usleep((useconds_t)(ms * 1000));
+}
+
+// ---------------------------------------------------------------------------
+// Text
+
+static std::string json_escape(const std::string &s) {
+    std::string out;
+    for (unsigned char c : s) {
+        if (c == '"') out += "\\\"";
+        else if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else if (c == '\r') out += "\\r";
+        else if (c == '\t') out += "\\t";
+        else if (c < 0x20) {
+            char u[8];
+            snprintf(u, sizeof(u), "\\u%04x", c);
+            out += u;
+        } else {
+            out += (char)c;
+        }
+    }
+    return out;
+}
+
+// The JSON string starting at s (after its opening quote); \uXXXX is kept
+// as it is, which is enough to match against the script
+static std::string json_string_at(const char *s, const char *end) {
+    std::string out;
+    while (s < end && *s != '"') {
+        if (*s == '\\' && s + 1 < end) {
+            s++;
+            switch (*s) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': out += "\\u"; break;
+            default: out += *s; break;
+            }
+        } else {
+            out += *s;
+        }
+        s++;
+    }
+    return out;
+}
+
+static std::string url_decode(const std::string &s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size()) {
+            out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+static std::string query_param(const std::string &target, const char *name) {
+    size_t q = target.find('?');
+    if (q == std::string::npos) return "";
+    std::string key = std::string(name) + "=";
+    size_t at = q + 1;
+    while (at < target.size()) {
+        size_t end = target.find('&', at);
+        if (end == std::string::npos) end = target.size();
+        if (target.compare(at, key.size(), key) == 0) {
+            return url_decode(target.substr(at + key.size(), end - at - key.size()));
+        }
+        at = end + 1;
+    }
+    return "";
+}
+
+static size_t utf8_chars(const std::string &s) {
+    size_t n = 0;
+    for (unsigned char c : s) n += (c & 0xC0) != 0x80;
+    return n;
+}
+
+// Lower case for the ASCII letters; enough for script matches typed in
+// lower case against questions that start with a capital
+static std::string lower(std::string s) {
+    for (char &c : s) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return s;
+}
+
+static const std::string &answer_for(const std::string &question) {
+    std::string q = lower(question);
+    for (const Entry &e : s_script) {
+        if (e.match == "*" || q.find(lower(e.match)) != std::string::npos) return e.answer;
+    }
+    static const std::string none = "Xin lỗi, tôi không có câu trả lời.";
+    return none;
+}
+
+// The answer in pieces of about piece_bytes, never inside a UTF-8 sequence
+static std::vector<std::string> pieces_of(const std::string &a) {
+    size_t size = (size_t)std::max(1, get("piece_bytes"));
+    std::vector<std::string> pieces;
+    size_t i = 0;
+    while (i < a.size()) {
+        size_t n = size < a.size() - i ? size : a.size() - i;
+        while (i + n < a.size() && ((unsigned char)a[i + n] & 0xC0) == 0x80) n++;
+        pieces.push_back(a.substr(i, n));
+        i += n;
+    }
+    return pieces;
+}
+
+static bool load_script(const char *path) {
+    std::ifstream f(path);
+    if (!f) return false;
+    std::vector<Entry> script;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        Entry e = {line.substr(0, tab), ""};
+        for (size_t i = tab + 1; i < line.size(); i++) {
+            if (line[i] == '\\' && i + 1 < line.size() && line[i + 1] == 'n') {
+                e.answer += '\n';
+                i++;
+            } else {
+                e.answer += line[i];
+            }
+        }
+        script.push_back(e);
+    }
+    s_script = script;
+    return !s_script.empty();
+}
+
+// ---------------------------------------------------------------------------
+// Requests
+
+struct Request {
+    std::string method;
+    std::string target;
+    std::string body;
+};
+
+struct Connection {
+    int fd;
+    std::string in;                 // Read ahead of the current request
+    std::mt19937 rng;
+};
+
+static bool send_all(int fd, const std::string &s) {
+    size_t at = 0;
+    while (at < s.size()) {
+        ssize_t n = send(fd, s.data() + at, s.size() - at, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        at += (size_t)n;
+    }
+    return true;
+}
+
+static std::string chunk(const std::string &s) {
+    char head[16];
+    snprintf(head, sizeof(head), "%zx\r\n", s.size());
+    return head + s + "\r\n";
+}
+
+// More bytes into c->in; false when the peer closed, idle_close_ms passed
+// with nothing, or the server is stopping
+static bool fill(Connection *c, bool idle) {
+    int idle_close = get("idle_close_ms");
+    double since = now_ms();
+    for (;;) {
+        if (s_stop) return false;
+        struct pollfd p = { c->fd, POLLIN, 0 };
+        int r = poll(&p, 1, 100);
+        if (r > 0) {
+            char buf[16384];
+            ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+            if (n <= 0) return false;
+            c->in.append(buf, (size_t)n);
+            return true;
+        }
+        if (idle && idle_close > 0 && now_ms() - since >= idle_close) return false;
+    }
+}
+
+static bool read_request(Connection *c, Request *req) {
+    size_t end;
+    bool idle = c->in.empty();
+    while ((end = c->in.find("\r\n\r\n")) == std::string::npos) {
+        if (c->in.size() > MAX_HEAD || !fill(c, idle)) return false;
+    }
+    std::string head = c->in.substr(0, end + 4);
+    c->in.erase(0, end + 4);
+
+    size_t sp1 = head.find(' ');
+    size_t sp2 = head.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos) return false;
+    req->method = head.substr(0, sp1);
+    req->target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    size_t len = 0;
+    const char *cl = strcasestr(head.c_str(), "\r\nContent-Length:");
+    if (cl) len = strtoul(cl + 17, nullptr, 10);
+    if (len > MAX_BODY) return false;
+    while (c->in.size() < len) {
+        if (!fill(c, false)) return false;
+    }
+    req->body = c->in.substr(0, len);
+    c->in.erase(0, len);
+    return true;
+}
+
+static bool reply(int fd, int status, const char *reason, const char *type, const std::string &body) {
+    char head[192];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+             status, reason, type, body.size());
+    return send_all(fd, head + body);
+}
+
+static bool reply_error(int fd, int status, const char *reason, const char *api_status, const char *message) {
+    std::string body = "{\"error\": {\"code\": " + std::to_string(status) + ", \"message\": \"" +
+                       message + "\", \"status\": \"" + api_status + "\"}}";
+    return reply(fd, status, reason, "application/json; charset=UTF-8", body);
+}
+
+// What the model is asked: the last user turn of a text query; the script
+// answers a voice query as if the speaker said s_transcript
+static std::string question_of(const Request &req, bool *voice) {
+    *voice = req.body.find("\"inline_data\"") != std::string::npos;
+    if (*voice) return s_transcript;
+    static const char TURN[] = "{\"role\":\"user\",\"parts\":[{\"text\":\"";
+    size_t at = req.body.rfind(TURN);
+    if (at == std::string::npos) return "";
+    const char *s = req.body.c_str() + at + sizeof(TURN) - 1;
+    return json_string_at(s, req.body.c_str() + req.body.size());
+}
+
+static double first_token_delay(Connection *c) {
+    double jitter = get("jitter_ms");
+    double extra = 0;
+    if (jitter > 0) {
+        std::exponential_distribution<double> d(1.0 / jitter);
+        extra = std::min(d(c->rng), jitter * 10);
+    }
+    return get("first_token_ms") + extra;
+}
+
+static std::string event(const std::string &text, bool last) {
+    return "data: {\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"" + json_escape(text) +
+           "\"}],\"role\": \"model\"}" + (last ? ",\"finishReason\": \"STOP\"" : "") +
+           "}],\"usageMetadata\": {\"promptTokenCount\": 12},\"modelVersion\": \"gemini-2.0-flash\"}\r\n\r\n";
+}
+
+static bool serve_stream(Connection *c, const std::string &answer) {
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                       "Transfer-Encoding: chunked\r\n\r\n";
+    if (!send_all(c->fd, head)) return false;
+    sleep_ms(first_token_delay(c));
+    std::vector<std::string> pieces = pieces_of(answer);
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (i > 0) sleep_ms(get("piece_ms"));
+        if (!send_all(c->fd, chunk(event(pieces[i], i + 1 == pieces.size())))) return false;
+    }
+    return send_all(c->fd, "0\r\n\r\n");
+}
+
+static bool serve_whole(Connection *c, const std::string &text) {
+    size_t pieces = pieces_of(text).size();
+    sleep_ms(first_token_delay(c) + (double)get("piece_ms") * (pieces > 0 ? pieces - 1 : 0));
+    std::string body = "{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"" + json_escape(text) +
+                       "\"}],\"role\": \"model\"},\"finishReason\": \"STOP\"}],"
+                       "\"usageMetadata\": {\"promptTokenCount\": 12},\"modelVersion\": \"gemini-2.0-flash\"}";
+    return reply(c->fd, 200, "OK", "application/json; charset=UTF-8", body);
+}
+
+static bool serve_model(Connection *c, const Request &req, int *status) {
+    std::string key = query_param(req.target, "key");
+    if (key.empty() || key == "bad") {
+        *status = 400;
+        return reply_error(c->fd, 400, "Bad Request", "INVALID_ARGUMENT",
+                           "API key not valid. Please pass a valid API key.");
+    }
+    if (req.method == "GET") {
+        *status = 200;
+        return reply(c->fd, 200, "OK", "application/json; charset=UTF-8",
+                     "{\"name\": \"models/gemini-2.0-flash\", \"displayName\": \"Gemini 2.0 Flash\"}");
+    }
+    unsigned n = ++s_model_requests;
+    int every = get("fail_every");
+    if (every > 0 && n % (unsigned)every == 0) {
+        *status = 503;
+        return reply_error(c->fd, 503, "Service Unavailable", "UNAVAILABLE",
+                           "The model is overloaded. Please try again later.");
+    }
+    bool voice;
+    std::string question = question_of(req, &voice);
+    const std::string &answer = answer_for(question);
+    *status = 200;
+    if (req.target.find(":streamGenerateContent") != std::string::npos) {
+        // A streamed voice answer starts with the transcript on its own line
+        return serve_stream(c, voice ? "Q: " + s_transcript + "\n" + answer : answer);
+    }
+    if (voice && req.body.find("\"responseSchema\"") != std::string::npos) {
+        return serve_whole(c, "{\"transcript\": \"" + json_escape(s_transcript) + "\", \"answer\": \"" +
+                                  json_escape(answer) + "\"}");
+    }
+    return serve_whole(c, answer);
+}
+
+static bool serve_tts(Connection *c, const Request &req) {
+    std::string text = query_param(req.target, "q");
+    size_t frames = (utf8_chars(text) * (size_t)get("tts_ms_per_char") + MP3_FRAME_MS - 1) / MP3_FRAME_MS;
+    sleep_ms(get("tts_first_byte_ms"));
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Type: audio/mpeg\r\nTransfer-Encoding: chunked\r\n\r\n";
+    if (!send_all(c->fd, head)) return false;
+
+    static const unsigned char HEADER[4] = {0xFF, 0xF3, 0x44, 0xC4};
+    std::string frame(MP3_FRAME_BYTES, '\0');
+    memcpy(&frame[0], HEADER, sizeof(HEADER));
+    int kbps = get("tts_kbps");
+    for (size_t i = 0; i < frames; i += TTS_SEND_FRAMES) {
+        size_t n = frames - i < TTS_SEND_FRAMES ? frames - i : TTS_SEND_FRAMES;
+        std::string data;
+        for (size_t k = 0; k < n; k++) data += frame;
+        if (i > 0 && kbps > 0) sleep_ms(data.size() * 8.0 / kbps);
+        if (!send_all(c->fd, chunk(data))) return false;
+    }
+    return send_all(c->fd, "0\r\n\r\n");
+}
+
+static std::string config_json() {
+    std::string out = "{";
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        out += (i ? ", \"" : "\"") + std::string(s_settings[i].name) + "\": " +
+               std::to_string(s_settings[i].value.load());
+    }
+    out += ", \"model_requests\": " + std::to_string(s_model_requests.load());
+    out += ", \"connections\": " + std::to_string(s_connections.load()) + "}";
+    return out;
+}
+
+// name=value pairs of the query; false for an unknown name
+static bool configure(const std::string &target) {
+    size_t q = target.find('?');
+    if (q == std::string::npos) return true;
+    std::string query = target.substr(q + 1);
+    size_t at = 0;
+    while (at < query.size()) {
+        size_t end = query.find('&', at);
+        if (end == std::string::npos) end = query.size();
+        size_t eq = query.find('=', at);
+        if (eq == std::string::npos || eq > end) return false;
+        Setting *s = setting(query.c_str() + at, eq - at);
+        if (!s) return false;
+        s->value = atoi(query.c_str() + eq + 1);
+        at = end + 1;
+    }
+    return true;
+}
+
+static void serve_connection(int fd) {
+    Connection c = {fd, std::string(), std::mt19937(s_seed++)};
+    s_connections++;
+    Request req;
+    while (read_request(&c, &req)) {
+        double t0 = now_ms();
+        int status = 200;
+        bool ok;
+        if (req.target.compare(0, 12, "/mock/config") == 0) {
+            ok = configure(req.target) ? reply(fd, 200, "OK", "application/json", config_json())
+                                       : reply(fd, status = 400, "Bad Request", "text/plain", "unknown setting\n");
+        } else if (req.target.compare(0, 14, "/translate_tts") == 0) {
+            ok = serve_tts(&c, req);
+        } else if (req.target.find(":generateContent") != std::string::npos ||
+                   req.target.find(":streamGenerateContent") != std::string::npos) {
+            ok = serve_model(&c, req, &status);
+        } else {
+            status = 404;
+            ok = reply_error(fd, 404, "Not Found", "NOT_FOUND", "Not found");
+        }
+        if (s_verbose) {
+            std::lock_guard<std::mutex> lock(s_log_lock);
+            printf("%s %.60s -> %d, %.0f ms\n", req.method.c_str(), req.target.c_str(), status, now_ms() - t0);
+            fflush(stdout);
+        }
+        if (!ok) break;
+    }
+    close(fd);
+}
+
+// ---------------------------------------------------------------------------
+
+static void usage() {
+    printf("mock_gemini_server [--port N] [--bind ADDR] [--script FILE] [--transcript TEXT] [--verbose]\n");
+    for (const Setting &s : s_settings) {
+        std::string flag = s.name;
+        for (char &ch : flag) {
+            if (ch == '_') ch = '-';
+        }
+        printf("  --%-20s %6d  %s\n", flag.c_str(), s.value.load(), s.help);
+    }
+}
+
+static void on_signal(int) {
+    s_stop = true;
+}
+
+int main(int argc, char **argv) {
+    int port = 8787;
+    const char *bind_addr = "127.0.0.1";
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(a, "--port") == 0 && has_value) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(a, "--bind") == 0 && has_value) {
+            bind_addr = argv[++i];
+        } else if (strcmp(a, "--script") == 0 && has_value) {
+            if (!load_script(argv[++i])) {
+                fprintf(stderr, "No script entries in %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(a, "--transcript") == 0 && has_value) {
+            s_transcript = argv[++i];
+        } else if (strcmp(a, "--verbose") == 0) {
+            s_verbose = true;
+        } else if (strncmp(a, "--", 2) == 0 && has_value) {
+            std::string name = a + 2;
+            for (char &ch : name) {
+                if (ch == '-') ch = '_';
+            }
+            Setting *s = setting(name.c_str(), name.size());
+            if (!s) {
+                usage();
+                return 1;
+            }
+            s->value = atoi(argv[++i]);
+        } else {
+            usage();
+            return a[1] == 'h' || strcmp(a, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, bind_addr, &addr.sin_addr) != 1 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        fprintf(stderr, "Cannot listen on %s:%d: %s\n", bind_addr, port, strerror(errno));
+        return 1;
+    }
+    printf("Listening on http://%s:%d\n", bind_addr, port);
+    fflush(stdout);
+
+    while (!s_stop) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 200) <= 0) continue;
+        int conn = accept(fd, nullptr, nullptr);
+        if (conn < 0) continue;
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(serve_connection, conn).detach();
+    }
+    close(fd);
+    return 0;
+}
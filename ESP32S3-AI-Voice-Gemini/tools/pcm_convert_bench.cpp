@@ -0,0 +1,199 @@
+// tools/pcm_convert_bench.cpp - Host checks and benchmark for src/pcm_convert
+//
+// Runs the scalar reference and the dispatcher (and the SIMD entry point
+// directly) over random input and edge cases - full-scale values, every
+// length from 0 to 67, buffers offset from 16-byte alignment so the
+// blocked kernel leaves an unaligned head or tail - for several gain and
+// shift settings, and checks the outputs match bit for bit. The reference
+// is also checked against the formula in pcm_convert.h computed in 64 bits.
+// Reports samples/us for each path.
+//
+// On the host there is no PIE kernel, so the SIMD path falls back to the
+// reference; the same file built for the ESP32-S3 exercises the real one.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src pcm_convert_bench.cpp ../src/pcm_convert.cpp -o pcm_convert_bench
+//   ./pcm_convert_bench
+//
+// Exits non-zero if a check fails.
+
+#include "pcm_convert.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_SAMPLES     4096
+#define MAX_OFFSET      4       // In samples; 4 x int32 covers every 16-byte offset
+#define MAX_SHORT_LEN   67
+#define BENCH_SAMPLES   (16000 / 50 * 2)   // Two 20 ms frames at 16 kHz
+#define BENCH_ROUNDS    20000
+
+static const pcm_convert_cfg_t s_cfgs[] = {
+    { 1, 0 },           // Plain >> 16
+    { 4, 0 },           // x4, saturates on loud input
+    { 384, 8 },         // x1.5 in Q8
+    { -3, 1 },          // Negative gain
+    { INT16_MAX, 0 },   // Saturates on almost anything
+    { INT16_MIN, 15 },  // -1.0 in Q15: -32768 x -32768 overflows int16
+    { 0, 0 },           // Silence
+    { 1, 31 },          // Everything shifts out
+};
+#define NUM_CFGS (sizeof(s_cfgs) / sizeof(s_cfgs[0]))
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static uint32_t s_lcg = 0x2545f491u;
+
+static int32_t rnd() {
+    s_lcg = s_lcg * 1664525u + 1013904223u;
+    return (int32_t)s_lcg;
+}
+
+static int16_t expected(int32_t in, const pcm_convert_cfg_t *cfg) {
+    int64_t v = ((int64_t)(in >> 16) * cfg->gain) >> cfg->shift;
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+// Run all three paths on in[0..count) and compare. Output buffers carry a
+// guard sample past the end that must not be touched.
+static bool same_output(const int32_t *in, size_t count, size_t out_offset,
+                        const pcm_convert_cfg_t *cfg, bool check_formula) {
+    alignas(16) static int16_t ref[MAX_SAMPLES + MAX_OFFSET + 1];
+    alignas(16) static int16_t disp[MAX_SAMPLES + MAX_OFFSET + 1];
+    alignas(16) static int16_t simd[MAX_SAMPLES + MAX_OFFSET + 1];
+    const int16_t guard = 0x5a5a;
+
+    int16_t *r = ref + out_offset, *d = disp + out_offset, *s = simd + out_offset;
+    r[count] = d[count] = s[count] = guard;
+    pcm_convert_s32_to_s16_ref(in, r, count, cfg);
+    pcm_convert_s32_to_s16(in, d, count, cfg);
+    pcm_convert_s32_to_s16_simd(in, s, count, cfg);
+
+    if (memcmp(r, d, count * sizeof(int16_t)) != 0) return false;
+    if (memcmp(r, s, count * sizeof(int16_t)) != 0) return false;
+    if (r[count] != guard || d[count] != guard || s[count] != guard) return false;
+    if (check_formula) {
+        for (size_t i = 0; i < count; i++) {
+            if (r[i] != expected(in[i], cfg)) return false;
+        }
+    }
+    return true;
+}
+
+static void test_self_test() {
+    printf("Self test\n");
+    bool ok = pcm_convert_self_test();
+    check("pcm_convert_self_test passes", ok);
+    printf("    SIMD kernel %s\n", pcm_convert_has_simd() ? "enabled" : "not available");
+}
+
+static void test_random() {
+    printf("Random input, %d samples\n", MAX_SAMPLES);
+    alignas(16) static int32_t in[MAX_SAMPLES];
+    for (int i = 0; i < MAX_SAMPLES; i++) in[i] = rnd();
+
+    bool ok = true;
+    for (size_t c = 0; c < NUM_CFGS; c++) ok = ok && same_output(in, MAX_SAMPLES, 0, &s_cfgs[c], true);
+    check("aligned buffers: all paths match the formula", ok);
+}
+
+static void test_full_scale() {
+    printf("Full-scale input\n");
+    static const int32_t edges[] = {
+        INT32_MAX, INT32_MIN, 0, -1, 1, 0x7fff0000, (int32_t)0x80000000, (int32_t)0x8000ffff,
+        0x0000ffff, (int32_t)0xffff0000, 0x00010000, (int32_t)0xfffeffff,
+    };
+    alignas(16) static int32_t in[MAX_SAMPLES];
+    for (int i = 0; i < MAX_SAMPLES; i++) in[i] = edges[i % (sizeof(edges) / sizeof(edges[0]))];
+    bool ok = true;
+    for (size_t c = 0; c < NUM_CFGS; c++) ok = ok && same_output(in, MAX_SAMPLES, 0, &s_cfgs[c], true);
+    check("extremes, +-1 and 16-bit boundaries match", ok);
+
+    // Alternating rails: the worst case for saturation on every lane
+    for (int i = 0; i < MAX_SAMPLES; i++) in[i] = (i & 1) ? INT32_MIN : INT32_MAX;
+    ok = true;
+    for (size_t c = 0; c < NUM_CFGS; c++) ok = ok && same_output(in, MAX_SAMPLES, 0, &s_cfgs[c], true);
+    check("alternating rails match", ok);
+}
+
+static void test_lengths_and_alignment() {
+    printf("Lengths 0..%d at every 16-byte offset\n", MAX_SHORT_LEN);
+    alignas(16) static int32_t buf[MAX_SAMPLES + MAX_OFFSET];
+    for (int i = 0; i < MAX_SAMPLES + MAX_OFFSET; i++) buf[i] = rnd();
+    buf[5] = INT32_MAX;
+    buf[6] = INT32_MIN;
+
+    bool lengths_ok = true, offsets_ok = true, mixed_ok = true;
+    for (size_t len = 0; len <= MAX_SHORT_LEN; len++) {
+        for (size_t c = 0; c < NUM_CFGS; c++) {
+            lengths_ok = lengths_ok && same_output(buf, len, 0, &s_cfgs[c], true);
+            for (size_t off = 1; off < MAX_OFFSET; off++) {
+                // Input off alignment, output aligned
+                offsets_ok = offsets_ok && same_output(buf + off, len, 0, &s_cfgs[c], true);
+                // Output off alignment (2-byte steps), input aligned
+                mixed_ok = mixed_ok && same_output(buf, len, off, &s_cfgs[c], true);
+            }
+        }
+    }
+    check("aligned, every length including odd and partial blocks", lengths_ok);
+    check("unaligned input", offsets_ok);
+    check("unaligned output", mixed_ok);
+
+    // Long odd lengths: blocked body plus a tail of 1..7
+    bool tail_ok = true;
+    for (size_t len = MAX_SAMPLES - 9; len <= MAX_SAMPLES; len++) {
+        for (size_t c = 0; c < NUM_CFGS; c++) tail_ok = tail_ok && same_output(buf, len, 0, &s_cfgs[c], false);
+    }
+    check("long buffers with every tail length", tail_ok);
+
+    // A null config falls back to gain 1, shift 0
+    alignas(16) static int16_t a[MAX_SHORT_LEN], b[MAX_SHORT_LEN];
+    pcm_convert_s32_to_s16(buf, a, MAX_SHORT_LEN, nullptr);
+    pcm_convert_s32_to_s16_ref(buf, b, MAX_SHORT_LEN, &s_cfgs[0]);
+    check("null config is a plain >> 16", memcmp(a, b, sizeof(a)) == 0);
+}
+
+typedef void (*convert_fn)(const int32_t *, int16_t *, size_t, const pcm_convert_cfg_t *);
+
+static double samples_per_us(convert_fn fn, const int32_t *in, int16_t *out) {
+    const pcm_convert_cfg_t cfg = { 384, 8 };
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        fn(in, out, BENCH_SAMPLES, &cfg);
+        asm volatile("" : : "r"(out) : "memory");   // Keep the stores
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    return (double)BENCH_SAMPLES * BENCH_ROUNDS / us;
+}
+
+static void bench() {
+    printf("Throughput, %d sample frames x %d\n", BENCH_SAMPLES, BENCH_ROUNDS);
+    alignas(16) static int32_t in[BENCH_SAMPLES + 1];
+    alignas(16) static int16_t out[BENCH_SAMPLES + 1];
+    for (int i = 0; i < BENCH_SAMPLES + 1; i++) in[i] = rnd();
+
+    printf("    %-24s %8.1f samples/us\n", "reference", samples_per_us(pcm_convert_s32_to_s16_ref, in, out));
+    printf("    %-24s %8.1f samples/us\n", "simd", samples_per_us(pcm_convert_s32_to_s16_simd, in, out));
+    printf("    %-24s %8.1f samples/us\n", "dispatcher", samples_per_us(pcm_convert_s32_to_s16, in, out));
+    printf("    %-24s %8.1f samples/us\n", "dispatcher, unaligned", samples_per_us(pcm_convert_s32_to_s16, in + 1, out + 1));
+}
+
+int main() {
+    test_self_test();
+    test_random();
+    test_full_scale();
+    test_lengths_and_alignment();
+    bench();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,328 @@
+// tools/pipeline_bench.cpp - Host run of the capture pipeline through the audio HAL
+//
+// Plays a synthetic far end (24 kHz, like the TTS stream) through a memory
+// speaker sink while a memory mic source delivers its echo plus near-end
+// speech, on a virtual clock. Every mic frame goes through the same
+// capture_pipeline the device runs (DSP, resampling, echo cancellation,
+// noise suppression) into the capture ring. Checks that two runs are
+// bit-identical, that the echo is cancelled, that near-end speech with the
+// speaker silent passes, and reports the cost per stage.
+//
+// With WAV files (16-bit mono; the mic at AUDIO_CAPTURE_I2S_RATE, the far
+// end at any rate, time aligned), runs the pipeline on a recording:
+//   ./pipeline_bench mic.wav [far.wav [out.wav]]
+//
+// Build and run from this directory (add -DAUDIO_CAPTURE_I2S_RATE=48000 to
+// include the capture resampler):
+//   g++ -O2 -I../src pipeline_bench.cpp ../src/capture_pipeline.cpp ../src/audio_hal.cpp ../src/audio_hal_file.cpp ../src/echo_ref.cpp ../src/audio_ring.cpp ../src/aec.cpp ../src/denoise.cpp ../src/fft_q15.cpp ../src/resampler.cpp ../src/pcm_convert.cpp ../src/audio_level.cpp -o pipeline_bench
+//   ./pipeline_bench
+//
+// Exits non-zero if a check fails.
+
+#include "audio_hal.h"
+#include "capture_pipeline.h"
+#include "echo_ref.h"
+#include "resampler.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define MIC_RATE        AUDIO_CAPTURE_I2S_RATE
+#define OUT_RATE        AUDIO_CAPTURE_SAMPLE_RATE
+#define FAR_RATE        24000
+#define MIC_FRAME       CAPTURE_PIPELINE_I2S_FRAME
+#define FAR_FRAME       (FAR_RATE / 50)
+
+static int s_failures = 0;
+
+typedef std::vector<int16_t> pcm_t;
+
+static void check(const char *what, double value, double lo, double hi) {
+    bool ok = value >= lo && value <= hi;
+    printf("    %-44s %8.1f [%g .. %g] %s\n", what, value, lo, hi, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static float frand() {
+    return (float)rand() / RAND_MAX;
+}
+
+static float gauss() {
+    return (frand() + frand() + frand() - 1.5f) * 2.0f;
+}
+
+static int16_t clip16(float v) {
+    return (int16_t)fmaxf(-32768, fminf(32767, v));
+}
+
+// ---- Fixtures --------------------------------------------------------------
+
+struct resonator {
+    float y1 = 0, y2 = 0;
+    float step(float x, float f, float bw, float rate) {
+        float r = expf(-(float)M_PI * bw / rate);
+        float a1 = 2 * r * cosf(2 * (float)M_PI * f / rate), a2 = -r * r;
+        float y = (1 - r) * x + a1 * y1 + a2 * y2;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+// Formant "speech" at rate between the start and end times, in seconds
+static std::vector<float> synth_speech(float rate, float seconds, float start, float end,
+                                       float syl_ms, float pitch, float amp) {
+    static const float F[][3] = {
+        { 730, 1090, 2440 }, { 270, 2290, 3010 }, { 300, 870, 2240 },
+        { 530, 1840, 2480 }, { 570, 840, 2410 },
+    };
+    std::vector<float> y((size_t)(seconds * rate), 0.0f);
+    resonator r1, r2, r3;
+    float phase = 0;
+    const size_t syl = (size_t)(syl_ms * rate / 1000);
+    const size_t from = (size_t)(start * rate), to = (size_t)(end * rate);
+    int v = 0;
+    for (size_t i = from; i < to && i < y.size(); i++) {
+        if ((i - from) % syl == 0) v = rand() % 5;
+        float env = sinf((float)M_PI * ((i - from) % syl) / syl);
+        phase += pitch * (1.0f + 0.1f * sinf(5.0f * i / rate)) / rate;
+        float src = 0;
+        if (phase >= 1) {
+            phase -= 1;
+            src = 1;
+        }
+        float s = r1.step(src, F[v][0], 80, rate) + 0.5f * r2.step(src, F[v][1], 100, rate) +
+                  0.25f * r3.step(src, F[v][2], 150, rate);
+        y[i] = s * (0.3f + 0.7f * env) * amp;
+    }
+    return y;
+}
+
+struct fixture {
+    pcm_t far;                  // At FAR_RATE
+    pcm_t mic;                  // At MIC_RATE
+    float far_end;              // Far end silent from here on, seconds
+    float near_start, near_end; // Near-end speech, seconds
+};
+
+// Far end 0-8 s, near end 8.5-10 s with the speaker silent
+static fixture make_fixture() {
+    fixture f;
+    const float seconds = 10;
+    f.far_end = 8;
+    f.near_start = 8.5f;
+    f.near_end = 10;
+
+    std::vector<float> farf = synth_speech(FAR_RATE, seconds, 0, f.far_end, 150, 120, 140000);
+    for (float v : farf) f.far.push_back(clip16(v));
+
+    // What the mic hears of the speaker: the far end at the mic rate, 3 ms
+    // of acoustic delay and a decaying room response
+    pcm_t played(f.far.size() * MIC_RATE / FAR_RATE + 64);
+    resampler_t *rs = resampler_create(FAR_RATE, MIC_RATE, 0);
+    size_t played_n = resampler_process(rs, f.far.data(), f.far.size(), played.data(), played.size());
+    resampler_destroy(rs);
+    played.resize(played_n);
+
+    const size_t delay = MIC_RATE * 3 / 1000, length = MIC_RATE * 10 / 1000;
+    std::vector<float> h(delay + length, 0.0f);
+    double e = 0;
+    for (size_t k = 0; k < length; k++) {
+        h[delay + k] = gauss() * expf(-6.9f * k / length);
+        e += h[delay + k] * h[delay + k];
+    }
+    for (auto &v : h) v *= 0.5f / (float)sqrt(e);
+
+    std::vector<float> nearf = synth_speech(MIC_RATE, seconds, f.near_start, f.near_end, 110, 210, 40000);
+    f.mic.resize(nearf.size());
+    for (size_t i = 0; i < f.mic.size(); i++) {
+        float acc = 0;
+        for (size_t k = 0; k < h.size() && k <= i; k++) {
+            if (i - k < played.size()) acc += h[k] * played[i - k];
+        }
+        f.mic[i] = clip16(acc + nearf[i] + 20 * gauss());
+    }
+    return f;
+}
+
+// ---- Pipeline run ----------------------------------------------------------
+
+struct run_result {
+    pcm_t out;
+    capture_pipeline_stats_t stats;
+    audio_level_stats_t level;
+    echo_ref_stats_t ref_stats;
+    double wall_us;
+};
+
+// One pass over the mic source, playing the far end frame by frame as the
+// device would while it listens. The source advances vc, which becomes the
+// audio clock for the run.
+static run_result run(audio_source_t *mic, audio_virtual_clock_t *vc, const pcm_t &far,
+                      uint32_t far_rate, bool aec) {
+    run_result r;
+    vc->now_us = 0;
+    audio_clock_t clock = audio_virtual_clock(vc);
+    audio_hal_set_clock(&clock);
+    echo_ref_init(OUT_RATE);
+    echo_ref_reset();
+
+    capture_pipeline_t *p = capture_pipeline_create();
+    capture_pipeline_set_echo_cancel(p, aec);
+    audio_ring_t *ring = audio_ring_create(4096);
+    int reader = audio_ring_reader_open(ring);
+    audio_sink_t *speaker = audio_sink_memory_create(far.size());
+
+    // The speaker queue holds a frame beyond the one playing, so the
+    // reference for a whole mic frame is written before the frame is read
+    const size_t far_frame = far_rate / 50;
+    size_t far_pos = 0, far_queued = far_frame;
+    int16_t block[2048];
+    auto t0 = std::chrono::steady_clock::now();
+    audio_source_start(mic);
+    for (;;) {
+        far_queued += far_frame;
+        if (far_pos < far.size()) {
+            size_t n = far.size() - far_pos < far_queued - far_pos ? far.size() - far_pos : far_queued - far_pos;
+            audio_hal_play(speaker, far.data() + far_pos, n, far_rate);
+            far_pos += n;
+        }
+
+        int32_t *frame;
+        int64_t start_us;
+        size_t n = audio_source_read(mic, &frame, &start_us, 0);
+        if (n == 0) break;
+        capture_pipeline_process(p, frame, n, start_us, ring);
+        size_t got;
+        while ((got = audio_ring_read(ring, reader, block, sizeof(block) / sizeof(block[0]))) > 0) {
+            r.out.insert(r.out.end(), block, block + got);
+        }
+    }
+    r.wall_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+    capture_pipeline_get_stats(p, &r.stats);
+    capture_pipeline_get_level(p, &r.level);
+    echo_ref_get_stats(&r.ref_stats);
+    audio_sink_destroy(speaker);
+    audio_ring_destroy(ring);
+    capture_pipeline_destroy(p);
+    audio_hal_set_clock(NULL);
+    return r;
+}
+
+static run_result run_fixture(const fixture &f, bool aec) {
+    audio_virtual_clock_t vc = { 0 };
+    audio_source_t *mic = audio_source_memory_create(f.mic.data(), f.mic.size(), MIC_RATE, MIC_FRAME, &vc);
+    run_result r = run(mic, &vc, f.far, FAR_RATE, aec);
+    audio_source_destroy(mic);
+    return r;
+}
+
+static double energy(const pcm_t &x, float from, float to) {
+    double e = 0;
+    for (size_t i = (size_t)(from * OUT_RATE); i < (size_t)(to * OUT_RATE) && i < x.size(); i++) {
+        e += (double)x[i] * x[i];
+    }
+    return e + 1;
+}
+
+static void print_costs(const run_result &r, size_t samples) {
+    const double frames = (double)r.stats.frames;
+    printf("    per 20 ms frame, host ns: DSP %u, echo cancel %u, noise suppression %u\n",
+           (unsigned)r.stats.cycles_avg, (unsigned)r.stats.aec_cycles_avg, (unsigned)r.stats.ns_cycles_avg);
+    printf("    whole pipeline %.1f us per frame, %.4fx real time\n", r.wall_us / frames,
+           r.wall_us / (samples * 1e6 / MIC_RATE));
+    printf("    mic level: %u frames, noise floor %.1f dBFS, %u clipped samples\n", (unsigned)r.level.frames,
+           r.level.noise_floor_db10 / 10.0, (unsigned)r.level.clipped_samples);
+    printf("    echo reference: %u stream(s), %u sync(s), %u lost\n", (unsigned)r.ref_stats.streams,
+           (unsigned)r.ref_stats.syncs, (unsigned)r.ref_stats.lost);
+}
+
+// ---- WAV mode --------------------------------------------------------------
+
+static int run_wav(const char *mic_path, const char *far_path, const char *out_path) {
+    audio_virtual_clock_t vc = { 0 };
+    audio_source_t *mic = audio_source_wav_create(mic_path, MIC_FRAME, &vc);
+    if (!mic) {
+        fprintf(stderr, "%s: not a 16-bit mono WAV file\n", mic_path);
+        return 2;
+    }
+    if (mic->sample_rate != MIC_RATE) {
+        fprintf(stderr, "%s: %u Hz, built for %u Hz\n", mic_path, (unsigned)mic->sample_rate, MIC_RATE);
+        audio_source_destroy(mic);
+        return 2;
+    }
+
+    // The far end is read whole so it can be played frame by frame
+    pcm_t far;
+    uint32_t far_rate = OUT_RATE;
+    if (far_path) {
+        audio_source_t *src = audio_source_wav_create(far_path, 1024, NULL);
+        if (!src) {
+            fprintf(stderr, "%s: not a 16-bit mono WAV file\n", far_path);
+            audio_source_destroy(mic);
+            return 2;
+        }
+        far_rate = src->sample_rate;
+        audio_source_start(src);
+        int32_t *frame;
+        int64_t t;
+        size_t n;
+        while ((n = audio_source_read(src, &frame, &t, 0)) > 0) {
+            for (size_t i = 0; i < n; i++) far.push_back((int16_t)(frame[i] >> 16));
+        }
+        audio_source_destroy(src);
+    }
+
+    run_result r = run(mic, &vc, far, far_rate, far_path != NULL);
+    audio_source_destroy(mic);
+    printf("%s: %.1f s\n", mic_path, (double)r.out.size() / OUT_RATE);
+    printf("    echo canceller ERLE estimate %.1f dB\n", r.stats.aec_erle_db10 / 10.0);
+    print_costs(r, r.out.size() * MIC_RATE / OUT_RATE);
+
+    if (out_path) {
+        audio_sink_t *out = audio_sink_wav_create(out_path);
+        if (!out) {
+            fprintf(stderr, "%s: cannot write\n", out_path);
+            return 2;
+        }
+        audio_sink_write(out, r.out.data(), r.out.size(), OUT_RATE);
+        audio_sink_destroy(out);
+        printf("    wrote %s\n", out_path);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        return run_wav(argv[1], argc > 2 ? argv[2] : NULL, argc > 3 ? argv[3] : NULL);
+    }
+
+    srand(1);
+    fixture f = make_fixture();
+    printf("Pipeline %d Hz mic -> %d Hz ring, far end %d Hz\n", MIC_RATE, OUT_RATE, FAR_RATE);
+
+    run_result a = run_fixture(f, true);
+    run_result b = run_fixture(f, true);
+    run_result off = run_fixture(f, false);
+
+    printf("Determinism\n");
+    check("runs with identical output, %", a.out == b.out ? 100 : 0, 100, 100);
+
+    printf("Echo\n");
+    check("echo removed 2-8 s, AEC on vs off, dB",
+          10 * log10(energy(off.out, 2, f.far_end) / energy(a.out, 2, f.far_end)), 15, 99);
+    check("near end 8.5-10 s, AEC on vs off, dB",
+          10 * log10(energy(a.out, f.near_start, f.near_end) / energy(off.out, f.near_start, f.near_end)), -1, 1);
+    check("echo reference streams", a.ref_stats.streams, 1, 1);
+
+    printf("Cost\n");
+    print_costs(a, f.mic.size());
+    check("real-time factor, x1000", 1000 * a.wall_us / (f.mic.size() * 1e6 / MIC_RATE), 0, 500);
+
+    printf("%s\n", s_failures ? "FAILED" : "All checks passed");
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+// tools/reply_bench.cpp - Host checks and benchmark for src/gemini_reply
+//
+// Checks the incremental extractor on replies shaped like recorded
+// generateContent responses (safety ratings, citation and grounding
+// metadata, several parts and candidates, API errors), fed whole and in
+// pieces of every size, and compares its text with a full DOM parse. Then
+// times both on large replies and reports peak heap: the old path held the
+// body in a String, parsed it into a document, copied the answer out and
+// rebuilt it a character at a time; jsoncpp stands in for ArduinoJson.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src -I/usr/include/jsoncpp reply_bench.cpp ../src/gemini_reply.cpp -ljsoncpp -o reply_bench
+//   ./reply_bench
+//
+// Exits non-zero if a check fails.
+
+#include "gemini_reply.h"
+#include <json/json.h>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_sec() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------------------------------------------------------------------
+// Heap accounting for everything allocated with new
+
+static size_t s_heap_now = 0;
+static size_t s_heap_peak = 0;
+
+void *operator new(size_t n) {
+    size_t *p = (size_t *)malloc(n + sizeof(size_t) * 2);
+    if (!p) throw std::bad_alloc();
+    p[0] = n;
+    s_heap_now += n;
+    if (s_heap_now > s_heap_peak) s_heap_peak = s_heap_now;
+    return p + 2;
+}
+
+// Not inlined, or the header arithmetic trips -Warray-bounds on stack buffers
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+    if (!ptr) return;
+    size_t *p = (size_t *)ptr - 2;
+    s_heap_now -= p[0];
+    free(p);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+static void heap_reset() {
+    s_heap_peak = s_heap_now;
+}
+
+// ---------------------------------------------------------------------------
+// Replies
+
+static std::string json_escape(const std::string &s) {
+    std::string out;
+    char u[8];
+    for (unsigned char c : s) {
+        if (c == '"') out += "\\\"";
+        else if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else if (c == '\r') out += "\\r";
+        else if (c < 0x20) {
+            snprintf(u, sizeof(u), "\\u%04x", c);
+            out += u;
+        } else out += (char)c;
+    }
+    return out;
+}
+
+static const char SAFETY[] =
+    "\"safetyRatings\": [{\"category\": \"HARM_CATEGORY_HATE_SPEECH\", \"probability\": \"NEGLIGIBLE\"},"
+    "{\"category\": \"HARM_CATEGORY_DANGEROUS_CONTENT\", \"probability\": \"NEGLIGIBLE\"},"
+    "{\"category\": \"HARM_CATEGORY_HARASSMENT\", \"probability\": \"NEGLIGIBLE\"},"
+    "{\"category\": \"HARM_CATEGORY_SEXUALLY_EXPLICIT\", \"probability\": \"NEGLIGIBLE\"}]";
+
+static const char USAGE[] =
+    "\"usageMetadata\": {\"promptTokenCount\": 12, \"candidatesTokenCount\": 85, \"totalTokenCount\": 97,"
+    "\"promptTokensDetails\": [{\"modality\": \"TEXT\", \"tokenCount\": 12}]},"
+    "\"modelVersion\": \"gemini-2.0-flash\", \"responseId\": \"b1kOaLLfIt2hz7IPx7TqgQQ\"";
+
+// A generateContent reply with the given parts as its first candidate,
+// pretty-printed as the API sends it, and `extra` bytes of grounding
+// metadata with "text" keys of its own
+static std::string make_reply(const std::vector<std::string> &parts, size_t extra = 0,
+                              bool second_candidate = false) {
+    std::string r = "{\n  \"candidates\": [\n    {\n      \"content\": {\n        \"parts\": [\n";
+    for (size_t i = 0; i < parts.size(); i++) {
+        r += "          {\n            \"text\": \"" + json_escape(parts[i]) + "\"\n          }";
+        r += i + 1 < parts.size() ? ",\n" : "\n";
+    }
+    r += "        ],\n        \"role\": \"model\"\n      },\n      \"finishReason\": \"STOP\",\n      ";
+    r += SAFETY;
+    r += ",\n      \"avgLogprobs\": -0.1726312637329102";
+    if (extra) {
+        r += ",\n      \"groundingMetadata\": {\"groundingSupports\": [";
+        int n = 0;
+        while (r.size() < extra) {
+            char seg[256];
+            snprintf(seg, sizeof(seg),
+                     "%s{\"segment\": {\"startIndex\": %d, \"endIndex\": %d, \"text\": \"Đoạn trích số %d "
+                     "từ nguồn tham khảo \\u0111\\u00e3 \\\"dẫn\\\" ở đây.\"}, \"groundingChunkIndices\": [%d, %d], "
+                     "\"confidenceScores\": [0.91, 7.5e-1]}",
+                     n ? ", " : "", n * 40, n * 40 + 39, n, n % 5, n % 7);
+            r += seg;
+            n++;
+        }
+        r += "]}";
+    }
+    r += "\n    }";
+    if (second_candidate) {
+        r += ",\n    {\"content\": {\"parts\": [{\"text\": \"second candidate\"}], \"role\": \"model\"}, "
+             "\"finishReason\": \"STOP\", \"index\": 1}";
+    }
+    r += "\n  ],\n  ";
+    r += USAGE;
+    r += "\n}\n";
+    return r;
+}
+
+static const char ERROR_REPLY[] =
+    "{\n  \"error\": {\n    \"code\": 400,\n    \"message\": \"API key not valid. Please pass a valid API key.\",\n"
+    "    \"status\": \"INVALID_ARGUMENT\",\n    \"details\": [{\"@type\": \"type.googleapis.com/google.rpc.ErrorInfo\","
+    " \"reason\": \"API_KEY_INVALID\", \"domain\": \"googleapis.com\", \"metadata\": {\"service\": "
+    "\"generativelanguage.googleapis.com\", \"message\": \"not this one\"}}]\n  }\n}\n";
+
+static std::string vietnamese_answer(size_t bytes) {
+    static const char *sentences[] = {
+        "Hà Nội hôm nay trời nắng nhẹ, nhiệt độ khoảng 28 độ C. ",
+        "Bạn nên mang theo áo khoác mỏng vì buổi tối có thể se lạnh. ",
+        "Nếu đi xa, hãy kiểm tra dự báo thời tiết trước khi xuất phát.\n",
+        "Chúc bạn một ngày tốt lành! 😀 ",
+    };
+    std::string s;
+    for (int i = 0; s.size() < bytes; i++) s += sentences[i % 4];
+    return s;
+}
+
+struct Result {
+    std::string text;
+    std::string error;
+    uint32_t parts;
+    bool complete;
+    bool failed;
+    bool truncated;
+};
+
+// Feed body in pieces of `step` bytes (0: whole)
+static Result extract(const std::string &body, size_t step, size_t cap = 65536) {
+    std::vector<char> buf(cap);
+    gemini_reply_t r;
+    gemini_reply_init(&r, buf.data(), cap);
+    if (step == 0) step = body.size();
+    for (size_t i = 0; i < body.size(); i += step) {
+        gemini_reply_feed(&r, body.data() + i, body.size() - i < step ? body.size() - i : step);
+    }
+    Result res;
+    res.complete = gemini_reply_finish(&r);
+    res.text.assign(r.text, r.len);
+    res.error = r.error;
+    res.parts = r.parts;
+    res.failed = r.failed;
+    res.truncated = r.truncated;
+    return res;
+}
+
+// What a full parse gives: parts of candidates[0] joined, '\r' and NUL removed
+static std::string dom_text(const std::string &body) {
+    Json::CharReaderBuilder b;
+    std::unique_ptr<Json::CharReader> reader(b.newCharReader());
+    Json::Value doc;
+    std::string err;
+    if (!reader->parse(body.data(), body.data() + body.size(), &doc, &err)) return "<parse error>";
+    std::string out;
+    for (const Json::Value &p : doc["candidates"][0]["content"]["parts"]) {
+        if (p["text"].isString()) out += p["text"].asString();
+    }
+    std::string clean;
+    for (char c : out) {
+        if (c != '\r' && c != '\0') clean += c;
+    }
+    return clean;
+}
+
+static bool valid_utf8(const std::string &s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = s[i];
+        size_t n = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3 : (c >> 3) == 30 ? 4 : 0;
+        if (n == 0 || i + n > s.size()) return false;
+        for (size_t k = 1; k < n; k++) {
+            if (((unsigned char)s[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += n;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+
+static void checks() {
+    printf("gemini_reply\n");
+    std::string answer = "Xin chào! Tôi là trợ lý \"Gemini\".\r\nBạn cần gì?\t😀";
+    std::string body = make_reply({ answer });
+    Result r = extract(body, 0);
+    check("typical reply: text of the first part", r.complete && r.parts == 1 &&
+          r.text == "Xin chào! Tôi là trợ lý \"Gemini\".\nBạn cần gì?\t😀" && r.error.empty());
+    check("same text as a full parse", r.text == dom_text(body));
+
+    bool ok = true;
+    for (size_t step = 1; step <= 64; step++) {
+        Result p = extract(body, step);
+        ok = ok && p.complete && p.text == r.text;
+    }
+    check("fed in pieces of 1..64 bytes: same text", ok);
+
+    body = make_reply({ "Phần một. ", "Phần hai, ", "phần ba." }, 4000, true);
+    r = extract(body, 7);
+    check("parts joined; grounding text and candidates[1] skipped",
+          r.complete && r.parts == 3 && r.text == "Phần một. Phần hai, phần ba." && r.text == dom_text(body));
+
+    body = "{\"candidates\":[{\"content\":{\"parts\":[{\"text\":\"a\\u0000b\\ud83d\\ude00 \\ud83d x\\udc00"
+           "\\u00e9\\u20ac\\/\"}]}}]}";
+    r = extract(body, 3);
+    check("\\u escapes, surrogate pairs, lone halves, NUL dropped",
+          r.complete && r.text == "ab😀 \xEF\xBF\xBD x\xEF\xBF\xBD" "é€/");
+
+    r = extract(ERROR_REPLY, 5);
+    check("API error: error.message only", r.complete && r.parts == 0 &&
+          r.error == "API key not valid. Please pass a valid API key.");
+
+    body = make_reply({ vietnamese_answer(600) });
+    ok = true;
+    for (size_t cap = 2; cap < 80; cap++) {
+        Result t = extract(body, 11, cap);
+        ok = ok && t.truncated && valid_utf8(t.text) && t.text.size() < cap &&
+             t.text.size() + 4 >= cap - 1 &&
+             vietnamese_answer(600).compare(0, t.text.size(), t.text) == 0;
+    }
+    check("small buffer: cut between UTF-8 sequences, flagged", ok);
+
+    {
+        std::string copy = make_reply({ answer, vietnamese_answer(900) }, 2000);
+        std::string expect = dom_text(copy);
+        gemini_reply_t rr;
+        gemini_reply_init(&rr, &copy[0], copy.size() + 1);
+        gemini_reply_feed(&rr, copy.data(), copy.size());
+        gemini_reply_finish(&rr);
+        check("decoded over its own input", rr.complete && std::string(rr.text, rr.len) == expect);
+    }
+
+    r = extract("<html><body>502 Bad Gateway</body></html>", 0);
+    check("not JSON: failed", r.failed && !r.complete);
+    r = extract("{\"candidates\": [1, 2}", 0);
+    check("mismatched brackets: failed", r.failed);
+    body = make_reply({ answer });
+    r = extract(body.substr(0, body.size() / 2), 4);
+    check("body cut short: not complete", !r.failed && !r.complete);
+    r = extract(std::string(40, '[') + std::string(40, ']'), 0);
+    check("nesting deeper than GEMINI_REPLY_DEPTH rejected", r.failed);
+    r = extract("{\"candidates\": [], \"n\": -1.5e+3, \"ok\": true, \"x\": null}", 2);
+    check("numbers and literals, no candidates", r.complete && r.parts == 0 && r.text.empty());
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark
+
+// The old path: String body, document, answer String, cleanAnswer += c
+static std::string old_path(const std::string &wire, size_t piece) {
+    std::string body;
+    for (size_t i = 0; i < wire.size(); i += piece) body.append(wire, i, piece);
+    Json::CharReaderBuilder b;
+    std::unique_ptr<Json::CharReader> reader(b.newCharReader());
+    Json::Value doc;
+    std::string err;
+    reader->parse(body.data(), body.data() + body.size(), &doc, &err);
+    std::string answer = doc["candidates"][0]["content"]["parts"][0]["text"].asString();
+    std::string clean;
+    for (char c : answer) {
+        if (c != 0 && c != '\r') clean += c;
+    }
+    return clean;
+}
+
+static size_t new_path(const std::string &wire, size_t piece, char *buf, size_t cap) {
+    gemini_reply_t r;
+    gemini_reply_init(&r, buf, cap);
+    for (size_t i = 0; i < wire.size(); i += piece) {
+        gemini_reply_feed(&r, wire.data() + i, wire.size() - i < piece ? wire.size() - i : piece);
+    }
+    gemini_reply_finish(&r);
+    return r.len;
+}
+
+static void bench(const char *name, const std::string &wire, size_t cap) {
+    const size_t piece = 512;
+    int iters = (int)(64u * 1024 * 1024 / wire.size());
+    if (iters < 5) iters = 5;
+    std::vector<char> buf(cap);
+
+    heap_reset();
+    size_t base = s_heap_now;
+    std::string a = old_path(wire, piece);
+    size_t old_peak = s_heap_peak - base;
+    double t0 = now_sec();
+    for (int i = 0; i < iters; i++) a = old_path(wire, piece);
+    double old_sec = (now_sec() - t0) / iters;
+
+    heap_reset();
+    base = s_heap_now;
+    size_t len = new_path(wire, piece, buf.data(), cap);
+    size_t new_peak = s_heap_peak - base;
+    t0 = now_sec();
+    for (int i = 0; i < iters; i++) len = new_path(wire, piece, buf.data(), cap);
+    double new_sec = (now_sec() - t0) / iters;
+    std::string b(buf.data(), len);
+
+    char label[96];
+    snprintf(label, sizeof(label), "%s: same answer", name);
+    check(label, a == b);
+    printf("      reply %7zu B, answer %6zu B\n", wire.size(), b.size());
+    printf("      String + document: %8.1f us, %8.1f MB/s, peak heap %8zu B\n",
+           old_sec * 1e6, wire.size() / old_sec / 1e6, old_peak);
+    printf("      gemini_reply:      %8.1f us, %8.1f MB/s, heap %zu B, buffer %zu B + state %zu B\n",
+           new_sec * 1e6, wire.size() / new_sec / 1e6, new_peak, cap, sizeof(gemini_reply_t));
+}
+
+int main() {
+    checks();
+    printf("benchmark (512 byte reads, as from the connection)\n");
+    bench("short answer", make_reply({ vietnamese_answer(400) }), 4096);
+    bench("long answer", make_reply({ vietnamese_answer(8000) }), 16384);
+    bench("grounded reply", make_reply({ vietnamese_answer(3000) }, 256 * 1024), 4096);
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
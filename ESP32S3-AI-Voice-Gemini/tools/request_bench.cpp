@@ -0,0 +1,406 @@
+// tools/request_bench.cpp - Host checks and benchmark for src/request_writer
+//
+// Checks that the escaped text matches a plain escaper at every split
+// point, that a text and a voice request read through the writer in
+// chunks of any size are the bodies gemini_client built before (history
+// written into a malloc'd buffer, then the turn and tail) and parse with
+// jsoncpp, that a retry reads the same body again from offset 0, and that
+// the history read at an offset is that slice of the written history.
+// Counts the heap allocations made while a request is produced: none.
+// Then times producing a text request three ways, in bytes/us: building a
+// document and serializing it (ArduinoJson into a String, jsoncpp stands
+// in), writing into one buffer, and the writer into 1400 byte send chunks.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src -I/usr/include/jsoncpp request_bench.cpp ../src/text_query.cpp ../src/voice_query.cpp ../src/request_writer.cpp ../src/conversation.cpp ../src/base64_stream.cpp -ljsoncpp -o request_bench
+//   ./request_bench
+//
+// Exits non-zero if a check fails.
+
+#include "request_writer.h"
+#include "text_query.h"
+#include "voice_query.h"
+#include "conversation.h"
+#include "base64_stream.h"
+#include <json/json.h>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define BENCH_MIN_SECONDS   0.5
+#define SEND_CHUNK          1400        // HTTP_SESSION_SEND_CHUNK
+#define CLIP_BYTES          (16000 * 2 * 3 + 44)
+
+// ---------------------------------------------------------------------------
+// Heap allocations, counted while s_counting is set
+
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+
+static bool s_counting = false;
+static size_t s_allocs = 0;
+
+extern "C" void *malloc(size_t n) {
+    if (s_counting) s_allocs++;
+    return __libc_malloc(n);
+}
+
+extern "C" void *calloc(size_t k, size_t n) {
+    if (s_counting) s_allocs++;
+    return __libc_calloc(k, n);
+}
+
+extern "C" void *realloc(void *p, size_t n) {
+    if (s_counting) s_allocs++;
+    return __libc_realloc(p, n);
+}
+
+extern "C" void free(void *p) {
+    __libc_free(p);
+}
+
+// ---------------------------------------------------------------------------
+// The bodies as gemini_client.cpp built them before, to compare with
+
+static constexpr char OLD_TEXT_QUERY_TAIL[] =
+    "],\"generationConfig\":{\"maxOutputTokens\":100,\"temperature\":0.7}}";
+static constexpr char VOICE_STREAM_TURN[] =
+    "{\"role\":\"user\",\"parts\":["
+    "{\"text\":\"First write exactly what the speaker in this audio says, on one line "
+    "starting with Q:. Then, on the next line, answer it briefly in the same language.\"},"
+    "{\"inline_data\":{\"mime_type\":\"audio/wav\",\"data\":\"";
+static constexpr char VOICE_STREAM_SUFFIX[] =
+    "\"}}]}],"
+    "\"generationConfig\":{\"maxOutputTokens\":256,\"temperature\":0.7}}";
+
+// The text body as it was built before: one buffer for all of it
+static char *old_text_body(conversation_t *history, const char *input, size_t *len) {
+    size_t size = conversation_prefix_size(history) +
+                  conversation_turn_size(CONVERSATION_USER, input) + sizeof(OLD_TEXT_QUERY_TAIL);
+    char *body = (char *)malloc(size);
+    if (!body) return NULL;
+    size_t n = conversation_write_prefix(history, body, size);
+    n += conversation_write_turn(CONVERSATION_USER, input, body + n, size - n);
+    memcpy(body + n, OLD_TEXT_QUERY_TAIL, sizeof(OLD_TEXT_QUERY_TAIL));
+    *len = n + sizeof(OLD_TEXT_QUERY_TAIL) - 1;
+    return body;
+}
+
+// And before that: a document serialized into a growing string
+static std::string document_body(const std::vector<std::pair<std::string, std::string>> &turns,
+                                 const char *input) {
+    Json::Value doc;
+    Json::Value &contents = doc["contents"];
+    for (const auto &t : turns) {
+        Json::Value turn;
+        turn["role"] = t.first;
+        turn["parts"][0]["text"] = t.second;
+        contents.append(turn);
+    }
+    Json::Value turn;
+    turn["role"] = "user";
+    turn["parts"][0]["text"] = input;
+    contents.append(turn);
+    doc["generationConfig"]["maxOutputTokens"] = 100;
+    doc["generationConfig"]["temperature"] = 0.7;
+    Json::StreamWriterBuilder b;
+    b["indentation"] = "";
+    return Json::writeString(b, doc);
+}
+
+// The whole body, read in chunks cycling through sizes
+static std::string read_all(request_writer_t *w, const size_t *sizes, size_t count) {
+    std::string out;
+    std::vector<char> buf(SEND_CHUNK * 4);
+    for (size_t i = 0;; i++) {
+        size_t cap = sizes[i % count];
+        size_t n = request_writer_read(w, out.size(), buf.data(), cap);
+        out.append(buf.data(), n);
+        if (n < cap) break;
+    }
+    return out;
+}
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static const char *QUESTIONS[] = {
+    "Thời tiết Hà Nội hôm nay thế nào?",
+    "Nói \"xin chào\" bằng tiếng Nhật",
+    "Đường dẫn C:\\Users\\pi có đúng không?",
+    "Dòng một\nDòng hai\tcó tab\r",
+    "Ký tự điều khiển \x01\x1f ở giữa",
+    "Tôi nên mang ô không?",
+};
+
+static const char *ANSWERS[] = {
+    "Hà Nội hôm nay nắng nhẹ, khoảng 28 độ.",
+    "Konnichiwa (こんにちは).",
+    "Có, \"C:\\Users\\pi\" là thư mục của người dùng pi.",
+    "Hai dòng, một tab.",
+    "Đã bỏ qua.",
+    "Có, chiều nay có thể mưa.",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static std::unique_ptr<conversation_t, void (*)(conversation_t *)> make_history(size_t pairs) {
+    std::unique_ptr<conversation_t, void (*)(conversation_t *)> c(conversation_create(NULL), conversation_destroy);
+    for (size_t i = 0; i < pairs; i++) {
+        conversation_add(c.get(), CONVERSATION_USER, QUESTIONS[i % COUNT(QUESTIONS)]);
+        conversation_add(c.get(), CONVERSATION_MODEL, ANSWERS[i % COUNT(ANSWERS)]);
+    }
+    return c;
+}
+
+static std::string plain_escape(const std::string &s) {
+    std::string out;
+    for (unsigned char c : s) {
+        char hex[8];
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                snprintf(hex, sizeof(hex), "\\u%04x", c);
+                out += hex;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    return out;
+}
+
+static bool parses(const std::string &body, Json::Value *root) {
+    Json::CharReaderBuilder b;
+    std::unique_ptr<Json::CharReader> r(b.newCharReader());
+    std::string err;
+    return r->parse(body.data(), body.data() + body.size(), root, &err);
+}
+
+static void test_escape() {
+    printf("Escaping\n");
+    bool size_ok = true, split_ok = true;
+    for (size_t q = 0; q < COUNT(QUESTIONS); q++) {
+        std::string text = QUESTIONS[q];
+        std::string want = plain_escape(text);
+        size_ok = size_ok && json_escaped_size(text.data(), text.size()) == want.size();
+        char buf[256];
+        for (size_t skip = 0; skip <= want.size(); skip++) {
+            for (size_t cap = 1; cap <= 9; cap++) {
+                size_t n = json_escape_at(text.data(), text.size(), skip, buf, cap);
+                split_ok = split_ok && std::string(buf, n) == want.substr(skip, cap);
+            }
+        }
+    }
+    check("json_escaped_size matches a plain escaper", size_ok);
+    check("json_escape_at, every offset, 1..9 bytes at a time", split_ok);
+}
+
+static void test_history() {
+    printf("History\n");
+    auto h = make_history(5);
+    size_t size = conversation_prefix_size(h.get());
+    std::vector<char> whole(size + 1);
+    size_t n = conversation_write_prefix(h.get(), whole.data(), whole.size());
+    std::string want(whole.data(), n);
+    bool ok = n == size;
+    char buf[32];
+    for (size_t off = 0; off <= size; off++) {
+        for (size_t cap = 1; cap <= 17; cap += 4) {
+            size_t k = conversation_read_prefix(h.get(), off, buf, cap);
+            ok = ok && std::string(buf, k) == want.substr(off, cap);
+        }
+    }
+    check("read_prefix is the written history at any offset", ok);
+}
+
+static void test_text_body() {
+    printf("Text request\n");
+    static const size_t sizes_1400[] = {SEND_CHUNK};
+    static const size_t sizes_odd[] = {1, 7, 3, 64, 2, 333, 5};
+    bool same = true, same_odd = true, json_ok = true, retry_ok = true;
+    for (size_t pairs = 0; pairs <= 6; pairs += 3) {
+        auto h = make_history(pairs);
+        for (size_t q = 0; q < COUNT(QUESTIONS); q++) {
+            size_t old_len = 0;
+            char *old = old_text_body(h.get(), QUESTIONS[q], &old_len);
+            std::string want(old, old_len);
+            free(old);
+
+            request_writer_t w;
+            text_query_body(&w, h.get(), QUESTIONS[q]);
+            std::string got = read_all(&w, sizes_1400, COUNT(sizes_1400));
+            same = same && got == want && request_writer_size(&w) == want.size();
+            same_odd = same_odd && read_all(&w, sizes_odd, COUNT(sizes_odd)) == want;
+
+            Json::Value root;
+            json_ok = json_ok && parses(got, &root) &&
+                      root["contents"].size() == pairs * 2 + 1 &&
+                      root["contents"][(int)(pairs * 2)]["parts"][0]["text"].asString() == QUESTIONS[q];
+
+            // A retry reads from 0 again after part of the body went out
+            char buf[97];
+            request_writer_read(&w, 0, buf, sizeof(buf));
+            request_writer_read(&w, sizeof(buf), buf, sizeof(buf));
+            retry_ok = retry_ok && read_all(&w, sizes_odd, COUNT(sizes_odd)) == want;
+        }
+    }
+    check("same body as before, 1400 byte chunks", same);
+    check("same body, chunks of 1..333 bytes", same_odd);
+    check("parses, question is the last turn", json_ok);
+    check("retry from offset 0 reads the same body", retry_ok);
+}
+
+static void test_voice_body() {
+    printf("Voice request\n");
+    std::vector<uint8_t> clip(CLIP_BYTES);
+    for (size_t i = 0; i < clip.size(); i++) clip[i] = (uint8_t)(i * 2654435761u >> 13);
+    auto h = make_history(2);
+
+    std::string want(conversation_prefix_size(h.get()), '\0');
+    std::vector<char> prefix(want.size() + 1);
+    conversation_write_prefix(h.get(), prefix.data(), prefix.size());
+    want.assign(prefix.data(), want.size());
+    want += VOICE_STREAM_TURN;
+    std::string b64(BASE64_ENCODED_SIZE(clip.size()), '\0');
+    base64_encode(clip.data(), clip.size(), &b64[0]);
+    want += b64;
+    want += VOICE_STREAM_SUFFIX;
+
+    static const size_t sizes_1400[] = {SEND_CHUNK};
+    static const size_t sizes_odd[] = {1, 2, 5, 1021, 3, 640};
+    bool ok = true;
+    for (size_t tail = 0; tail < 3; tail++) {
+        request_writer_t w;
+        voice_query_body(&w, h.get(), clip.data(), clip.size() - tail, VOICE_QUERY_STREAM);
+        std::string b(BASE64_ENCODED_SIZE(clip.size() - tail), '\0');
+        base64_encode(clip.data(), clip.size() - tail, &b[0]);
+        std::string exp = want.substr(0, want.size() - b64.size() - strlen(VOICE_STREAM_SUFFIX)) + b +
+                          VOICE_STREAM_SUFFIX;
+        ok = ok && read_all(&w, sizes_1400, 1) == exp && read_all(&w, sizes_odd, COUNT(sizes_odd)) == exp &&
+             request_writer_size(&w) == exp.size();
+    }
+    check("prefix, turn, base64 audio, suffix; any chunk size", ok);
+
+    Json::Value root;
+    request_writer_t w;
+    voice_query_body(&w, h.get(), clip.data(), clip.size(), VOICE_QUERY_STREAM);
+    check("parses", parses(read_all(&w, sizes_1400, 1), &root) && root["contents"].size() == 5);
+
+    request_writer_init(&w);
+    bool added = true;
+    for (int i = 0; i < REQUEST_WRITER_MAX_PARTS; i++) added = added && REQUEST_WRITER_LITERAL(&w, "x");
+    check("a part past the maximum is refused",
+          added && !REQUEST_WRITER_LITERAL(&w, "x") && w.overflow && request_writer_size(&w) == REQUEST_WRITER_MAX_PARTS);
+}
+
+static void test_allocations() {
+    printf("Heap allocations while producing a request\n");
+    auto h = make_history(6);
+    std::vector<uint8_t> clip(CLIP_BYTES, 0x5a);
+    char chunk[SEND_CHUNK];
+
+    s_allocs = 0;
+    s_counting = true;
+    request_writer_t w;
+    text_query_body(&w, h.get(), QUESTIONS[2]);
+    for (size_t off = 0, n; (n = request_writer_read(&w, off, chunk, sizeof(chunk))) > 0; off += n) {}
+    s_counting = false;
+    check("text request", s_allocs == 0);
+
+    s_allocs = 0;
+    s_counting = true;
+    voice_query_body(&w, h.get(), clip.data(), clip.size(), VOICE_QUERY_STREAM);
+    for (size_t off = 0, n; (n = request_writer_read(&w, off, chunk, sizeof(chunk))) > 0; off += n) {}
+    s_counting = false;
+    check("voice request", s_allocs == 0);
+}
+
+template <typename F>
+static double run_for(F fn, size_t *allocs) {
+    int runs = 0;
+    double elapsed;
+    s_allocs = 0;
+    s_counting = true;
+    fn();
+    s_counting = false;
+    *allocs = s_allocs;
+    auto t0 = std::chrono::steady_clock::now();
+    do {
+        fn();
+        runs++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed / runs;
+}
+
+static void bench() {
+    printf("\nProducing a text request, bytes/us (allocations per request)\n");
+    printf("    %-8s %7s   %-20s %-20s %-20s\n", "turns", "bytes", "document + string", "one buffer", "writer, 1400 B");
+    static const size_t pairs[] = {0, 2, 6, 12};
+    volatile size_t keep = 0;
+    const char *input = QUESTIONS[1];
+    for (size_t p = 0; p < COUNT(pairs); p++) {
+        auto h = make_history(pairs[p]);
+        std::vector<std::pair<std::string, std::string>> turns;
+        for (size_t i = 0; i < pairs[p]; i++) {
+            turns.push_back({"user", QUESTIONS[i % COUNT(QUESTIONS)]});
+            turns.push_back({"model", ANSWERS[i % COUNT(ANSWERS)]});
+        }
+        request_writer_t w;
+        text_query_body(&w, h.get(), input);
+        size_t bytes = request_writer_size(&w);
+
+        size_t a_doc, a_buf, a_writer;
+        double t_doc = run_for([&] { keep = keep + document_body(turns, input).size(); }, &a_doc);
+        double t_buf = run_for([&] {
+            size_t len;
+            char *b = old_text_body(h.get(), input, &len);
+            keep = keep + len;
+            free(b);
+        }, &a_buf);
+        char chunk[SEND_CHUNK];
+        double t_writer = run_for([&] {
+            request_writer_t rw;
+            text_query_body(&rw, h.get(), input);
+            for (size_t off = 0, n; (n = request_writer_read(&rw, off, chunk, sizeof(chunk))) > 0; off += n) {}
+            keep = keep + chunk[0];
+        }, &a_writer);
+
+        char c1[24], c2[24], c3[24];
+        snprintf(c1, sizeof(c1), "%7.1f (%u)", bytes / t_doc / 1e6, (unsigned)a_doc);
+        snprintf(c2, sizeof(c2), "%7.1f (%u)", bytes / t_buf / 1e6, (unsigned)a_buf);
+        snprintf(c3, sizeof(c3), "%7.1f (%u)", bytes / t_writer / 1e6, (unsigned)a_writer);
+        printf("    %-8u %7u   %-20s %-20s %-20s\n", (unsigned)(pairs[p] * 2), (unsigned)bytes, c1, c2, c3);
+    }
+    (void)keep;
+}
+
+int main() {
+    test_escape();
+    test_history();
+    test_text_body();
+    test_voice_body();
+    test_allocations();
+    bench();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+// tools/resampler_bench.cpp - Host frequency response and benchmark for src/resampler
+//
+// For each rate pair, measures passband gain, alias/image rejection with
+// single tones (Goertzel at the expected output frequency), and throughput
+// with 20 ms input frames.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src resampler_bench.cpp ../src/resampler.cpp -o resampler_bench
+//   ./resampler_bench
+//
+// Exits non-zero if a response is out of range.
+
+#include "resampler.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#define BENCH_SECONDS   20
+
+static int s_failures = 0;
+
+static void check(const char *what, double value, double lo, double hi, const char *unit) {
+    bool ok = value >= lo && value <= hi;
+    printf("    %-34s %9.2f %-3s [%g .. %g] %s\n", what, value, unit, lo, hi, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+// Resample a tone in 20 ms frames and return the output
+static std::vector<int16_t> run_tone(resampler_t *rs, uint32_t in_rate, double freq, double amp,
+                                     double seconds) {
+    resampler_reset(rs);
+    size_t frame = in_rate / 50;
+    size_t total = (size_t)(in_rate * seconds);
+    std::vector<int16_t> in(frame);
+    std::vector<int16_t> tmp(resampler_max_output(rs, frame));
+    std::vector<int16_t> out;
+    for (size_t i = 0; i < total; i += frame) {
+        for (size_t k = 0; k < frame; k++) {
+            in[k] = (int16_t)lrint(amp * sin(2.0 * M_PI * freq * (i + k) / in_rate));
+        }
+        size_t n = resampler_process(rs, in.data(), frame, tmp.data(), tmp.size());
+        out.insert(out.end(), tmp.begin(), tmp.begin() + n);
+    }
+    return out;
+}
+
+// Amplitude of one frequency component over the second half of x
+static double goertzel_amp(const std::vector<int16_t> &x, uint32_t rate, double freq) {
+    size_t from = x.size() / 2;
+    size_t n = x.size() - from;
+    double w = 2.0 * M_PI * freq / rate;
+    double c = 2.0 * cos(w), s1 = 0, s2 = 0;
+    for (size_t i = from; i < x.size(); i++) {
+        double s0 = x[i] + c * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    double re = s1 - s2 * cos(w), im = s2 * sin(w);
+    return 2.0 * sqrt(re * re + im * im) / n;
+}
+
+static double db(double ratio) {
+    return 20.0 * log10(ratio + 1e-12);
+}
+
+static void test_pair(uint32_t in_rate, uint32_t out_rate) {
+    printf("%u -> %u Hz\n", (unsigned)in_rate, (unsigned)out_rate);
+    resampler_t *rs = resampler_create(in_rate, out_rate, 0);
+    if (!rs) {
+        printf("    create failed\n");
+        s_failures++;
+        return;
+    }
+
+    const double amp = 16000.0;
+    uint32_t nyq = (in_rate < out_rate ? in_rate : out_rate) / 2;
+
+    // Passband
+    const double pass[] = { 100, 1000, 0.5 * nyq, 0.75 * nyq };
+    for (int i = 0; i < 4; i++) {
+        std::vector<int16_t> y = run_tone(rs, in_rate, pass[i], amp, 1.0);
+        char label[48];
+        snprintf(label, sizeof(label), "gain at %.0f Hz", pass[i]);
+        check(label, db(goertzel_amp(y, out_rate, pass[i]) / amp), i < 3 ? -0.3 : -1.5, 0.3, "dB");
+    }
+
+    if (in_rate > out_rate) {
+        // A tone above the output Nyquist must not alias back into the band
+        double f = nyq + 0.35 * nyq;
+        double alias = out_rate - f;
+        std::vector<int16_t> y = run_tone(rs, in_rate, f, amp, 1.0);
+        char label[48];
+        snprintf(label, sizeof(label), "alias of %.0f Hz at %.0f Hz", f, alias);
+        check(label, db(goertzel_amp(y, out_rate, alias) / amp), -1000, -50, "dB");
+    } else {
+        // The first image of a 1 kHz tone must be suppressed
+        double image = in_rate - 1000.0;
+        std::vector<int16_t> y = run_tone(rs, in_rate, 1000.0, amp, 1.0);
+        char label[48];
+        snprintf(label, sizeof(label), "image at %.0f Hz", image);
+        check(label, db(goertzel_amp(y, out_rate, image) / amp), -1000, -50, "dB");
+    }
+
+    // Throughput
+    size_t frame = in_rate / 50;
+    std::vector<int16_t> in(frame, 0), out(resampler_max_output(rs, frame));
+    for (size_t k = 0; k < frame; k++) in[k] = (int16_t)(k * 97);
+    size_t frames = BENCH_SECONDS * 50;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t produced = 0;
+    for (size_t f = 0; f < frames; f++) {
+        produced += resampler_process(rs, in.data(), frame, out.data(), out.size());
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("    %.2f us per 20 ms frame, %.0fx realtime, delay %u samples, %u out samples\n",
+           sec / frames * 1e6, BENCH_SECONDS / sec, (unsigned)resampler_delay(rs), (unsigned)produced);
+
+    resampler_destroy(rs);
+}
+
+int main() {
+    test_pair(48000, 16000);
+    test_pair(32000, 16000);
+    test_pair(48000, 8000);
+    test_pair(16000, 8000);
+    test_pair(16000, 48000);
+    test_pair(24000, 44100);
+    test_pair(44100, 16000);
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
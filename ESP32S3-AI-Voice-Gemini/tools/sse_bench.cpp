@@ -0,0 +1,670 @@
+// tools/sse_bench.cpp - Host checks and timing for the streamed answer path
+//
+// Checks src/sse_parser and src/sentence_split on their own, then runs gemini_stream_run against a
+// local stand-in for streamGenerateContent (plain HTTP/1.1, chunked
+// text/event-stream, a delay before the first piece and between pieces, the
+// way the model writes) over a socket transport for tls_conn. The same
+// answer is also fetched as one generateContent reply, which only comes
+// once the model is done; the report compares when the first text and the
+// first sentence for text-to-speech are available in each case. A stream
+// cancelled from another thread must stop within a poll interval.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src sse_bench.cpp ../src/sse_parser.cpp ../src/sentence_split.cpp ../src/gemini_stream.cpp ../src/gemini_reply.cpp ../src/http_session.cpp ../src/tls_conn.cpp -lpthread -o sse_bench
+//   ./sse_bench
+//
+// Exits non-zero if a check fails.
+
+#include "gemini_reply.h"
+#include "gemini_stream.h"
+#include "http_session.h"
+#include "sentence_split.h"
+#include "sse_parser.h"
+#include "tls_conn.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define REQUEST_TIMEOUT_MS  3000
+#define FIRST_TOKEN_MS      250     // Model time before the first piece
+#define PIECE_MS            20      // ... and between pieces
+#define PIECE_BYTES         8       // Answer bytes per event, about two tokens
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// The answer the stand-in writes; the \" and line break exercise escapes
+static const char ANSWER[] =
+    "Chào bạn! Hôm nay trời Hà Nội nắng nhẹ, khoảng 28 độ. "
+    "Bạn nên mang theo \"áo khoác mỏng\" vì buổi tối có thể se lạnh.\n"
+    "Nếu đi xa, hãy kiểm tra dự báo 3.5 giờ trước khi xuất phát nhé 😀";
+
+// ---------------------------------------------------------------------------
+// SSE parser
+
+struct Events {
+    std::vector<std::string> names, data;
+};
+
+static void collect_event(void *ctx, const char *event, char *data, size_t len) {
+    Events *e = (Events *)ctx;
+    e->names.push_back(event);
+    e->data.push_back(std::string(data, len));
+}
+
+// Feed text in pieces of `step` bytes (0: all at once)
+static Events parse(const std::string &text, size_t step, size_t cap = 256) {
+    Events e;
+    std::vector<char> buf(cap);
+    sse_parser_t p;
+    sse_parser_init(&p, buf.data(), cap, collect_event, &e);
+    if (step == 0) step = text.size();
+    for (size_t i = 0; i < text.size(); i += step) {
+        sse_parser_feed(&p, text.data() + i, text.size() - i < step ? text.size() - i : step);
+    }
+    return e;
+}
+
+static std::string with_line_ends(std::string text, const char *eol) {
+    std::string out;
+    for (char c : text) {
+        if (c == '\n') out += eol;
+        else out += c;
+    }
+    return out;
+}
+
+static void parser_checks() {
+    printf("sse_parser\n");
+    const std::string stream =
+        ": keep-alive comment\n"
+        "data: {\"a\":1}\n"
+        "\n"
+        "event: error\n"
+        "data:{\"b\":2}\n"
+        "id: 7\n"
+        "retry: 100\n"
+        "\n"
+        "data: first\n"
+        "data\n"
+        "data:  third\n"
+        "\n"
+        "\n"
+        "unknown: field\n"
+        "\n";
+    const char *ends[] = { "\n", "\r\n", "\r" };
+    const char *end_names[] = { "LF", "CRLF", "CR" };
+    for (int k = 0; k < 3; k++) {
+        std::string text = with_line_ends(stream, ends[k]);
+        bool ok = true;
+        for (size_t step = 0; step <= 7; step++) {
+            Events e = parse(text, step);
+            ok = ok && e.data.size() == 3 && e.data[0] == "{\"a\":1}" && e.names[0] == "" &&
+                 e.data[1] == "{\"b\":2}" && e.names[1] == "error" &&
+                 e.data[2] == "first\n\n third" && e.names[2] == "";
+        }
+        char label[96];
+        snprintf(label, sizeof(label), "%s line ends, fed whole and in 1..7 byte pieces", end_names[k]);
+        check(label, ok);
+    }
+
+    // CR at the end of one piece and LF at the start of the next is one line end
+    Events e = parse("data: x\r", 0);
+    Events e2;
+    {
+        char buf[64];
+        sse_parser_t p;
+        sse_parser_init(&p, buf, sizeof(buf), collect_event, &e2);
+        sse_parser_feed(&p, "data: x\r", 8);
+        sse_parser_feed(&p, "\n", 1);
+        sse_parser_feed(&p, "\r\n", 2);
+    }
+    check("CRLF split across pieces is one line end", e.data.empty() && e2.data.size() == 1 &&
+          e2.data[0] == "x");
+
+    std::string big = "data: " + std::string(300, 'x') + "\n\ndata: small\n\n";
+    Events over;
+    {
+        char buf[64];
+        sse_parser_t p;
+        sse_parser_init(&p, buf, sizeof(buf), collect_event, &over);
+        sse_parser_feed(&p, big.data(), big.size());
+        check("event longer than the buffer dropped, next one kept",
+              over.data.size() == 1 && over.data[0] == "small" && p.dropped == 1 && p.events == 1);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Sentence splitter
+
+static void collect_sentence(void *ctx, const char *s, size_t len) {
+    std::vector<std::string> *v = (std::vector<std::string> *)ctx;
+    v->push_back(std::string(s, len));
+    if (strlen(s) != len) v->push_back("<not NUL-terminated>");
+}
+
+static std::vector<std::string> sentences_of(const std::string &text, size_t step) {
+    std::vector<std::string> v;
+    sentence_split_t s;
+    sentence_split_init(&s, collect_sentence, &v);
+    for (size_t i = 0; i < text.size(); i += step) {
+        sentence_split_feed(&s, text.data() + i, text.size() - i < step ? text.size() - i : step);
+    }
+    sentence_split_finish(&s);
+    return v;
+}
+
+static bool valid_utf8(const std::string &s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = s[i];
+        size_t n = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3 : (c >> 3) == 30 ? 4 : 0;
+        if (n == 0 || i + n > s.size()) return false;
+        for (size_t k = 1; k < n; k++) {
+            if (((unsigned char)s[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += n;
+    }
+    return true;
+}
+
+static void split_checks() {
+    printf("sentence_split\n");
+    bool ok = true;
+    for (size_t step = 1; step <= 9; step++) {
+        std::vector<std::string> v = sentences_of("Xin chào bạn. Hôm nay trời đẹp! Bạn cần gì không?", step);
+        ok = ok && v.size() == 3 && v[0] == "Xin chào bạn." && v[1] == "Hôm nay trời đẹp!" &&
+             v[2] == "Bạn cần gì không?";
+    }
+    check("three sentences, any piece size", ok);
+
+    std::vector<std::string> v = sentences_of("Ok. Tôi hiểu rồi bạn ạ. 1. Một điều nữa là thế này", 3);
+    check("short sentence joined to the next", v.size() == 2 && v[0] == "Ok. Tôi hiểu rồi bạn ạ." &&
+          v[1] == "1. Một điều nữa là thế này");
+
+    v = sentences_of("Số pi là 3.14159 và e là 2.71828 nhé bạn.", 4);
+    check("decimal point is not a sentence end", v.size() == 1);
+
+    v = sentences_of("**Lưu ý:** dùng `code` và # tiêu đề ở đây.\nDòng thứ hai ở đây", 5);
+    check("markdown marks dropped, line break ends a sentence",
+          v.size() == 2 && v[0] == "Lưu ý: dùng code và  tiêu đề ở đây." && v[1] == "Dòng thứ hai ở đây");
+
+    std::string words;
+    for (int i = 0; i < 80; i++) words += "từ ngữ, ";
+    v = sentences_of(words, 7);
+    ok = v.size() > 1;
+    size_t total = 0;
+    for (const std::string &s : v) {
+        ok = ok && s.size() <= SENTENCE_SPLIT_MAX && valid_utf8(s) && s.find("<not") == std::string::npos;
+        total += s.size();
+    }
+    check("long run cut at spaces or commas, each under the limit", ok && total > words.size() * 9 / 10);
+
+    std::string solid;
+    for (int i = 0; i < 150; i++) solid += "ạ";
+    v = sentences_of(solid, 5);
+    ok = v.size() > 1;
+    total = 0;
+    for (const std::string &s : v) {
+        ok = ok && s.size() <= SENTENCE_SPLIT_MAX && valid_utf8(s);
+        total += s.size();
+    }
+    check("no space to cut at: cut between UTF-8 sequences", ok && total == solid.size());
+}
+
+// ---------------------------------------------------------------------------
+// Stand-in server: streamGenerateContent and generateContent over plain HTTP
+
+struct Server {
+    int listen_fd = -1;
+    uint16_t port = 0;
+    std::thread thread;
+    std::atomic<bool> stop{false};
+
+    std::atomic<int> first_ms{FIRST_TOKEN_MS};
+    std::atomic<int> piece_ms{PIECE_MS};
+    std::atomic<int> fail_status{0};        // Reply with this status and an error body
+    std::atomic<bool> error_event{false};   // End the stream with an error event
+    std::atomic<bool> tiny_writes{false};   // Send the stream in 5 byte writes
+    std::atomic<int> connections{0};
+    std::atomic<int> requests{0};
+};
+
+static bool send_all(int fd, const std::string &s, bool tiny) {
+    size_t step = tiny ? 5 : s.size();
+    for (size_t i = 0; i < s.size(); i += step) {
+        size_t n = s.size() - i < step ? s.size() - i : step;
+        if (send(fd, s.data() + i, n, MSG_NOSIGNAL) != (ssize_t)n) return false;
+    }
+    return true;
+}
+
+static std::string chunk(const std::string &s) {
+    char head[16];
+    snprintf(head, sizeof(head), "%zx\r\n", s.size());
+    return head + s + "\r\n";
+}
+
+static std::string json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"') out += "\\\"";
+        else if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+// The answer in pieces of about PIECE_BYTES, never inside a UTF-8 sequence
+static std::vector<std::string> answer_pieces() {
+    std::vector<std::string> pieces;
+    std::string a = ANSWER;
+    size_t i = 0;
+    while (i < a.size()) {
+        size_t n = PIECE_BYTES < a.size() - i ? PIECE_BYTES : a.size() - i;
+        while (i + n < a.size() && ((unsigned char)a[i + n] & 0xC0) == 0x80) n++;
+        pieces.push_back(a.substr(i, n));
+        i += n;
+    }
+    return pieces;
+}
+
+static bool read_request(int fd, std::string &head) {
+    head.clear();
+    char c;
+    while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 100) == 0) return false;
+        if (recv(fd, &c, 1, 0) != 1) return false;
+        head += c;
+    }
+    size_t len = 0;
+    const char *cl = strcasestr(head.c_str(), "\r\nContent-Length:");
+    if (cl) len = strtoul(cl + 17, nullptr, 10);
+    std::string body(len, '\0');
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = recv(fd, &body[got], len - got, 0);
+        if (n <= 0) return false;
+        got += n;
+    }
+    return true;
+}
+
+static void serve_stream(Server *srv, int fd) {
+    bool tiny = srv->tiny_writes;
+    std::string out = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                      "Transfer-Encoding: chunked\r\n\r\n";
+    send_all(fd, out, false);
+    usleep(srv->first_ms * 1000);
+    std::vector<std::string> pieces = answer_pieces();
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (i > 0) usleep(srv->piece_ms * 1000);
+        std::string ev = "data: {\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"" +
+                         json_escape(pieces[i]) + "\"}],\"role\": \"model\"}}],"
+                         "\"usageMetadata\": {\"promptTokenCount\": 9}}\r\n\r\n";
+        send_all(fd, chunk(ev), tiny);
+    }
+    if (srv->error_event) {
+        send_all(fd, chunk("data: {\"error\": {\"code\": 500, \"message\": \"Internal error\"}}\r\n\r\n"), tiny);
+    }
+    send_all(fd, "0\r\n\r\n", false);
+}
+
+static void serve_whole(Server *srv, int fd) {
+    // The model writes the same answer; the reply is sent once it is done
+    std::vector<std::string> pieces = answer_pieces();
+    usleep((srv->first_ms + srv->piece_ms * (int)(pieces.size() - 1)) * 1000);
+    std::string body = "{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"" +
+                       json_escape(ANSWER) + "\"}],\"role\": \"model\"}}]}";
+    char head[160];
+    snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+             "Content-Length: %zu\r\n\r\n", body.size());
+    send_all(fd, head + body, false);
+}
+
+static void serve_connection(Server *srv, int fd) {
+    srv->connections++;
+    std::string head;
+    while (!srv->stop && read_request(fd, head)) {
+        srv->requests++;
+        int fail = srv->fail_status;
+        if (fail) {
+            std::string body = "{\"error\": {\"code\": " + std::to_string(fail) +
+                               ", \"message\": \"API key not valid. Please pass a valid API key.\"}}";
+            char h[160];
+            snprintf(h, sizeof(h), "HTTP/1.1 %d Bad Request\r\nContent-Type: application/json\r\n"
+                     "Content-Length: %zu\r\n\r\n", fail, body.size());
+            send_all(fd, h + body, false);
+        } else if (head.find(":streamGenerateContent") != std::string::npos) {
+            serve_stream(srv, fd);
+        } else {
+            serve_whole(srv, fd);
+        }
+    }
+    close(fd);
+}
+
+static void server_loop(Server *srv) {
+    while (!srv->stop) {
+        struct pollfd p = { srv->listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) <= 0) continue;
+        int fd = accept(srv->listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        serve_connection(srv, fd);
+    }
+}
+
+static bool server_start(Server *srv) {
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, 4) != 0 ||
+        getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+        return false;
+    }
+    srv->port = ntohs(addr.sin_port);
+    srv->thread = std::thread(server_loop, srv);
+    return true;
+}
+
+static void server_stop(Server *srv) {
+    srv->stop = true;
+    if (srv->thread.joinable()) srv->thread.join();
+    if (srv->listen_fd >= 0) close(srv->listen_fd);
+    srv->listen_fd = -1;
+}
+
+// ---------------------------------------------------------------------------
+// Plain socket transport, what tls_transport_mbedtls_create(false) does on
+// the device
+
+struct SockTransport {
+    tls_transport_t base;
+    int fd;
+};
+
+static SockTransport *self(tls_transport_t *t) {
+    return (SockTransport *)t;
+}
+
+static void st_close(tls_transport_t *t) {
+    if (self(t)->fd >= 0) close(self(t)->fd);
+    self(t)->fd = -1;
+}
+
+static tls_connect_result_t st_connect(tls_transport_t *t, const char *host, uint16_t port,
+                                       bool resume, uint32_t timeout_ms) {
+    (void)resume;
+    (void)timeout_ms;
+    st_close(t);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return TLS_CONNECT_FAILED;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    self(t)->fd = fd;
+    return TLS_CONNECT_FULL;
+}
+
+static bool st_alive(tls_transport_t *t) {
+    char b;
+    if (self(t)->fd < 0) return false;
+    int n = recv(self(t)->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static bool st_write(tls_transport_t *t, const void *data, size_t len, uint32_t timeout_ms) {
+    (void)timeout_ms;
+    return self(t)->fd >= 0 && send(self(t)->fd, data, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static int st_read(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms) {
+    if (self(t)->fd < 0) return -1;
+    struct pollfd p = { self(t)->fd, POLLIN, 0 };
+    if (poll(&p, 1, (int)timeout_ms) == 0) return 0;
+    ssize_t n = recv(self(t)->fd, buf, len, 0);
+    return n > 0 ? (int)n : -1;
+}
+
+static void st_forget_session(tls_transport_t *t) {
+    (void)t;
+}
+
+static void st_destroy(tls_transport_t *t) {
+    st_close(t);
+    delete self(t);
+}
+
+static const tls_transport_ops_t s_sock_ops = {
+    st_connect, st_alive, st_write, st_read, st_close, st_forget_session, st_destroy,
+};
+
+static tls_conn_t *make_conn(Server *srv) {
+    SockTransport *s = new SockTransport();
+    s->base.ops = &s_sock_ops;
+    s->fd = -1;
+    return tls_conn_create(&s->base, "127.0.0.1", srv->port, nullptr);
+}
+
+// ---------------------------------------------------------------------------
+// Streamed and whole answers
+
+struct Listener {
+    double start_ms = 0;
+    double first_sentence_ms = 0;
+    std::string text;
+    std::vector<std::string> sentences;
+    sentence_split_t split;
+    bool pieces_terminated = true;
+};
+
+static void on_sentence(void *ctx, const char *s, size_t len) {
+    Listener *l = (Listener *)ctx;
+    if (l->sentences.empty()) l->first_sentence_ms = now_ms() - l->start_ms;
+    l->sentences.push_back(std::string(s, len));
+}
+
+static void on_piece(void *ctx, const char *text, size_t len) {
+    Listener *l = (Listener *)ctx;
+    if (strlen(text) != len) l->pieces_terminated = false;
+    l->text.append(text, len);
+    sentence_split_feed(&l->split, text, len);
+}
+
+static int stream(tls_conn_t *conn, Listener *l, gemini_stream_result_t *res,
+                  const volatile bool *cancel = NULL) {
+    static const char body[] = "{\"contents\":[{\"parts\":[{\"text\":\"Thời tiết hôm nay?\"}]}]}";
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = "/v1beta/models/gemini-2.0-flash:streamGenerateContent?alt=sse&key=test";
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "text/event-stream";
+    req.body = body;
+    req.body_len = sizeof(body) - 1;
+    req.timeout_ms = REQUEST_TIMEOUT_MS;
+    req.cancel = cancel;
+    sentence_split_init(&l->split, on_sentence, l);
+    l->start_ms = now_ms();
+    int status = gemini_stream_run(conn, &req, on_piece, l, res);
+    sentence_split_finish(&l->split);
+    return status;
+}
+
+// generateContent: nothing to show or say until the whole reply is in
+static double whole(tls_conn_t *conn, std::string *text) {
+    static const char body[] = "{\"contents\":[{\"parts\":[{\"text\":\"Thời tiết hôm nay?\"}]}]}";
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = "/v1beta/models/gemini-2.0-flash:generateContent?key=test";
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "application/json";
+    req.body = body;
+    req.body_len = sizeof(body) - 1;
+    req.timeout_ms = REQUEST_TIMEOUT_MS;
+    double t0 = now_ms();
+    http_session_t s;
+    int status = http_session_begin(&s, conn, &req);
+    char answer[1024];
+    gemini_reply_t reply;
+    gemini_reply_init(&reply, answer, sizeof(answer));
+    char chunk[512];
+    int n;
+    while (status == 200 && (n = http_session_read(&s, chunk, sizeof(chunk))) > 0) {
+        gemini_reply_feed(&reply, chunk, (size_t)n);
+    }
+    http_session_end(&s);
+    double ms = now_ms() - t0;
+    if (gemini_reply_finish(&reply) && reply.parts == 1) *text = answer;
+    return ms;
+}
+
+static void stream_checks() {
+    printf("gemini_stream_run against the stand-in\n");
+    Server srv;
+    if (!server_start(&srv)) {
+        check("stand-in server starts", false);
+        return;
+    }
+    tls_conn_t *conn = make_conn(&srv);
+    char label[128];
+
+    Listener l;
+    gemini_stream_result_t res;
+    int status = stream(conn, &l, &res);
+    size_t pieces = answer_pieces().size();
+    check("streamed answer arrives whole", status == 200 && l.text == ANSWER && l.pieces_terminated);
+    snprintf(label, sizeof(label), "one event per piece (%u of %zu), none dropped",
+             (unsigned)res.events, pieces);
+    check(label, res.events == pieces && res.dropped_events == 0 && res.text_bytes == strlen(ANSWER));
+    snprintf(label, sizeof(label), "%zu sentences for text-to-speech", l.sentences.size());
+    check(label, l.sentences.size() == 4 && l.sentences[0] == "Chào bạn!" &&
+          l.sentences[3] == "Nếu đi xa, hãy kiểm tra dự báo 3.5 giờ trước khi xuất phát nhé 😀");
+
+    double stream_first = res.first_text_ms, stream_total = res.total_ms;
+    double first_sentence = l.first_sentence_ms;
+    std::string whole_text;
+    double whole_ms = whole(conn, &whole_text);
+    check("same answer from generateContent", whole_text == ANSWER);
+    check("first text well before the whole reply", stream_first < whole_ms / 2);
+
+    Listener tiny;
+    srv.tiny_writes = true;
+    srv.first_ms = 5;
+    srv.piece_ms = 0;
+    status = stream(conn, &tiny, &res);
+    srv.tiny_writes = false;
+    check("stream sent 5 bytes at a time", status == 200 && tiny.text == ANSWER && res.events == pieces);
+
+    Listener err;
+    srv.error_event = true;
+    status = stream(conn, &err, &res);
+    srv.error_event = false;
+    check("error event at the end: text kept, message reported",
+          status == 200 && err.text == ANSWER && strcmp(res.error, "Internal error") == 0);
+
+    Listener bad;
+    srv.fail_status = 400;
+    status = stream(conn, &bad, &res);
+    srv.fail_status = 0;
+    check("HTTP 400: error.message from the body, no text",
+          status == 400 && bad.text.empty() && res.first_text_ms == 0 &&
+          strcmp(res.error, "API key not valid. Please pass a valid API key.") == 0);
+
+    Listener again;
+    srv.first_ms = FIRST_TOKEN_MS;
+    srv.piece_ms = PIECE_MS;
+    status = stream(conn, &again, &res);
+    check("connection kept across streams and errors",
+          status == 200 && res.reused && srv.connections == 1 && again.text == ANSWER);
+
+    // Given up from another thread while waiting for the first piece, then
+    // in the middle of the answer: the stream stops within a poll interval
+    // and the connection, with the rest of the reply unread, is not reused
+    const int cancel_after[] = { FIRST_TOKEN_MS / 2, FIRST_TOKEN_MS + PIECE_MS * 10 };
+    for (int k = 0; k < 2; k++) {
+        Listener cut;
+        volatile bool cancel = false;
+        double set_at = 0;
+        int before = srv.connections;
+        std::thread canceller([&] {
+            usleep(cancel_after[k] * 1000);
+            set_at = now_ms();
+            cancel = true;
+        });
+        status = stream(conn, &cut, &res, &cancel);
+        double stopped_at = now_ms();
+        canceller.join();
+        double late = stopped_at - set_at;
+        snprintf(label, sizeof(label), "cancelled %s: stopped %.0f ms after the flag",
+                 k == 0 ? "before any text" : "mid-answer", late);
+        check(label, status == HTTP_SESSION_ERR_CANCELLED && late < HTTP_SESSION_CANCEL_POLL_MS + 50 &&
+                         (k == 0 ? cut.text.empty()
+                                 : !cut.text.empty() && cut.text.size() < strlen(ANSWER) &&
+                                       strncmp(ANSWER, cut.text.c_str(), cut.text.size()) == 0));
+        Listener next;
+        status = stream(conn, &next, &res);
+        check("next request answered on a new connection",
+              status == 200 && !res.reused && srv.connections == before + 1 && next.text == ANSWER);
+    }
+
+    printf("    model: %d ms to the first piece, %d ms per piece, %zu pieces\n",
+           FIRST_TOKEN_MS, PIECE_MS, pieces);
+    printf("    generateContent:        text and speech after %7.1f ms\n", whole_ms);
+    printf("    streamGenerateContent:  first text after      %7.1f ms\n", stream_first);
+    printf("                            first sentence after  %7.1f ms\n", first_sentence);
+    printf("                            stream ends after     %7.1f ms\n", stream_total);
+    printf("    speech can start %.1f ms (%.0f%%) sooner\n", whole_ms - first_sentence,
+           (whole_ms - first_sentence) * 100.0 / whole_ms);
+
+    tls_conn_destroy(conn);
+    server_stop(&srv);
+}
+
+int main() {
+    signal(SIGPIPE, SIG_IGN);
+    parser_checks();
+    split_checks();
+    stream_checks();
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,573 @@
+// tools/tls_conn_bench.cpp - Host checks for src/tls_conn and src/http_session
+//
+// Runs a local TLS stand-in for the Gemini endpoint (OpenSSL, self-signed
+// certificate, HTTP/1.1 keep-alive, session tickets) in a thread, and sends
+// requests to it through tls_conn and http_session with an OpenSSL client
+// transport, the host counterpart of tls_conn_mbedtls.cpp. The server can
+// close connections after some requests, after sitting idle, or in the
+// middle of a request, and can rotate its ticket keys; the checks are on
+// what the connection manager does about each. Everything runs with
+// TLS 1.2 (what mbedTLS on the device negotiates) and again with TLS 1.3.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src tls_conn_bench.cpp ../src/tls_conn.cpp ../src/http_session.cpp -lssl -lcrypto -lpthread -o tls_conn_bench
+//   ./tls_conn_bench
+//
+// Exits non-zero if a check fails.
+
+#include "http_session.h"
+#include "tls_conn.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#define VOICE_BODY_BYTES    (BASE64_LEN(16000 * 2 * 5) + 400)
+#define BASE64_LEN(n)       (((n) + 2) / 3 * 4)
+#define REQUEST_TIMEOUT_MS  2000
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_sec() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------------------------------------------------------------------
+// Stand-in server
+
+struct Server {
+    SSL_CTX *ctx = nullptr;
+    int listen_fd = -1;
+    uint16_t port = 0;
+    std::thread thread;
+    std::atomic<bool> stop{false};
+
+    // Behaviour
+    std::atomic<int> close_every{0};        // Connection: close on every n-th request, 0 never
+    std::atomic<int> idle_close_ms{0};      // Close connections idle this long, 0 never
+    std::atomic<bool> drop_next{false};     // Read the next request, then close without a reply
+    std::atomic<bool> chunked{false};       // Chunked replies instead of Content-Length
+
+    // What happened
+    std::atomic<int> connections{0};
+    std::atomic<int> resumed{0};
+    std::atomic<int> requests{0};
+    std::atomic<size_t> last_body_len{0};
+    std::atomic<uint32_t> last_body_sum{0};
+};
+
+static bool make_cert(SSL_CTX *ctx) {
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *x = X509_new();
+    if (!key || !x) return false;
+    ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x), 3600);
+    X509_set_pubkey(x, key);
+    X509_NAME *name = X509_get_subject_name(x);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(x, name);
+    bool ok = X509_sign(x, key, EVP_sha256()) > 0 && SSL_CTX_use_certificate(ctx, x) == 1 &&
+              SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    X509_free(x);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+static void rotate_ticket_keys(Server *srv) {
+    unsigned char keys[80];
+    RAND_bytes(keys, sizeof(keys));
+    SSL_CTX_set_tlsext_ticket_keys(srv->ctx, keys, sizeof(keys));
+    SSL_CTX_flush_sessions(srv->ctx, 0x7FFFFFFF);
+}
+
+// Read one request; false when the client closed or went quiet for idle_ms
+static bool read_request(Server *srv, SSL *ssl, int fd, std::string &body) {
+    std::string head;
+    char c;
+    while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0) {
+        if (SSL_pending(ssl) == 0 && head.empty()) {
+            int idle = srv->idle_close_ms.load();
+            struct pollfd p = { fd, POLLIN, 0 };
+            int r = poll(&p, 1, idle > 0 ? idle : 100);
+            if (r == 0) {
+                if (idle > 0 || srv->stop) return false;
+                continue;
+            }
+        }
+        if (SSL_read(ssl, &c, 1) != 1) return false;
+        head += c;
+    }
+    size_t len = 0;
+    const char *cl = strcasestr(head.c_str(), "\r\nContent-Length:");
+    if (cl) len = strtoul(cl + 17, nullptr, 10);
+    body.resize(len);
+    size_t got = 0;
+    while (got < len) {
+        int n = SSL_read(ssl, &body[got], (int)(len - got));
+        if (n <= 0) return false;
+        got += n;
+    }
+    return true;
+}
+
+static void serve_connection(Server *srv, int fd) {
+    SSL *ssl = SSL_new(srv->ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) != 1) {
+        SSL_free(ssl);
+        close(fd);
+        return;
+    }
+    srv->connections++;
+    if (SSL_session_reused(ssl)) srv->resumed++;
+
+    int on_conn = 0;
+    std::string body;
+    while (!srv->stop && read_request(srv, ssl, fd, body)) {
+        on_conn++;
+        int n = ++srv->requests;
+        if (srv->drop_next.exchange(false)) break;
+
+        uint32_t sum = 0;
+        for (unsigned char b : body) sum = sum * 31 + b;
+        srv->last_body_len = body.size();
+        srv->last_body_sum = sum;
+
+        char text[256];
+        int tl = snprintf(text, sizeof(text),
+                          "{\"candidates\":[{\"content\":{\"parts\":[{\"text\":\"reply %d\"}]}}]}", n);
+        int every = srv->close_every.load();
+        bool last = every > 0 && on_conn % every == 0;
+        char head[256];
+        int hl;
+        std::string out;
+        if (srv->chunked) {
+            hl = snprintf(head, sizeof(head),
+                          "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                          "Transfer-Encoding: chunked\r\n%s\r\n", last ? "Connection: close\r\n" : "");
+            out.assign(head, hl);
+            // Split the reply over chunks of 7 bytes, with an extension on one
+            for (int i = 0; i < tl; i += 7) {
+                int k = tl - i < 7 ? tl - i : 7;
+                snprintf(head, sizeof(head), i == 0 ? "%x;ext=1\r\n" : "%x\r\n", k);
+                out += head;
+                out.append(text + i, k);
+                out += "\r\n";
+            }
+            out += "0\r\nX-Trailer: 1\r\n\r\n";
+        } else {
+            hl = snprintf(head, sizeof(head),
+                          "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                          "Content-Length: %d\r\n%s\r\n", tl, last ? "Connection: close\r\n" : "");
+            out.assign(head, hl);
+            out.append(text, tl);
+        }
+        SSL_write(ssl, out.data(), (int)out.size());
+        if (last) break;
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+}
+
+static void server_loop(Server *srv) {
+    while (!srv->stop) {
+        struct pollfd p = { srv->listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) <= 0) continue;
+        int fd = accept(srv->listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        serve_connection(srv, fd);
+    }
+}
+
+static bool server_start(Server *srv) {
+    srv->ctx = SSL_CTX_new(TLS_server_method());
+    if (!srv->ctx || !make_cert(srv->ctx)) return false;
+    SSL_CTX_set_session_id_context(srv->ctx, (const unsigned char *)"gemini", 6);
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, 4) != 0 ||
+        getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+        return false;
+    }
+    srv->port = ntohs(addr.sin_port);
+    srv->thread = std::thread(server_loop, srv);
+    return true;
+}
+
+static void server_stop(Server *srv) {
+    srv->stop = true;
+    if (srv->thread.joinable()) srv->thread.join();
+    if (srv->listen_fd >= 0) close(srv->listen_fd);
+    srv->listen_fd = -1;
+    SSL_CTX_free(srv->ctx);
+    srv->ctx = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// OpenSSL client transport
+
+struct OsslTransport {
+    tls_transport_t base;
+    SSL_CTX *ctx;
+    SSL *ssl;
+    int fd;
+    SSL_SESSION *session;       // Latest from the server, for the next connect
+};
+
+static OsslTransport *self(tls_transport_t *t) {
+    return (OsslTransport *)t;
+}
+
+static int s_ex_index = -1;
+
+// TLS 1.3 tickets arrive after the handshake, so sessions are taken when
+// they come rather than right after connecting
+static int on_new_session(SSL *ssl, SSL_SESSION *sess) {
+    OsslTransport *o = (OsslTransport *)SSL_get_ex_data(ssl, s_ex_index);
+    if (o->session) SSL_SESSION_free(o->session);
+    o->session = sess;
+    return 1;
+}
+
+static void ot_close(tls_transport_t *t) {
+    OsslTransport *o = self(t);
+    if (o->ssl) {
+        SSL_shutdown(o->ssl);
+        SSL_free(o->ssl);
+        o->ssl = nullptr;
+    }
+    if (o->fd >= 0) close(o->fd);
+    o->fd = -1;
+}
+
+static tls_connect_result_t ot_connect(tls_transport_t *t, const char *host, uint16_t port,
+                                       bool resume, uint32_t timeout_ms) {
+    OsslTransport *o = self(t);
+    (void)timeout_ms;
+    ot_close(t);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, strcmp(host, "localhost") == 0 ? "127.0.0.1" : host, &addr.sin_addr);
+    o->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(o->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ot_close(t);
+        return TLS_CONNECT_FAILED;
+    }
+    int one = 1;
+    setsockopt(o->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    o->ssl = SSL_new(o->ctx);
+    SSL_set_ex_data(o->ssl, s_ex_index, o);
+    SSL_set_fd(o->ssl, o->fd);
+    SSL_set_tlsext_host_name(o->ssl, host);
+    if (resume && o->session) SSL_set_session(o->ssl, o->session);
+    if (SSL_connect(o->ssl) != 1) {
+        ot_close(t);
+        return TLS_CONNECT_FAILED;
+    }
+    return SSL_session_reused(o->ssl) ? TLS_CONNECT_RESUMED : TLS_CONNECT_FULL;
+}
+
+static bool ot_alive(tls_transport_t *t) {
+    OsslTransport *o = self(t);
+    if (o->fd < 0 || SSL_pending(o->ssl) > 0) return false;
+    char b;
+    int n = recv(o->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static bool ot_write(tls_transport_t *t, const void *data, size_t len, uint32_t timeout_ms) {
+    OsslTransport *o = self(t);
+    (void)timeout_ms;
+    return o->ssl && SSL_write(o->ssl, data, (int)len) == (int)len;
+}
+
+static int ot_read(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms) {
+    OsslTransport *o = self(t);
+    if (!o->ssl) return -1;
+    if (SSL_pending(o->ssl) == 0) {
+        struct pollfd p = { o->fd, POLLIN, 0 };
+        int r = poll(&p, 1, (int)timeout_ms);
+        if (r == 0) return 0;
+    }
+    int n = SSL_read(o->ssl, buf, (int)len);
+    if (n > 0) return n;
+    return SSL_get_error(o->ssl, n) == SSL_ERROR_WANT_READ ? 0 : -1;
+}
+
+static void ot_forget_session(tls_transport_t *t) {
+    OsslTransport *o = self(t);
+    if (o->session) SSL_SESSION_free(o->session);
+    o->session = nullptr;
+}
+
+static void ot_destroy(tls_transport_t *t) {
+    OsslTransport *o = self(t);
+    ot_close(t);
+    ot_forget_session(t);
+    SSL_CTX_free(o->ctx);
+    delete o;
+}
+
+static const tls_transport_ops_t s_ossl_ops = {
+    ot_connect, ot_alive, ot_write, ot_read, ot_close, ot_forget_session, ot_destroy,
+};
+
+static tls_transport_t *ossl_transport_create(int max_version) {
+    OsslTransport *o = new OsslTransport();
+    o->base.ops = &s_ossl_ops;
+    o->ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_max_proto_version(o->ctx, max_version);
+    SSL_CTX_set_verify(o->ctx, SSL_VERIFY_NONE, nullptr);
+    SSL_CTX_set_session_cache_mode(o->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(o->ctx, on_new_session);
+    o->ssl = nullptr;
+    o->fd = -1;
+    o->session = nullptr;
+    return &o->base;
+}
+
+// ---------------------------------------------------------------------------
+// Requests
+
+struct Timing {
+    double reused_sec = 0, full_sec = 0, resumed_sec = 0;
+    int reused = 0, full = 0, resumed = 0;
+};
+
+// One generateContent-like POST; true if the reply came back intact
+static bool post(tls_conn_t *conn, int *reply_n, bool *reused, Timing *timing = nullptr) {
+    static const char body[] = "{\"contents\":[{\"parts\":[{\"text\":\"hello\"}]}]}";
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = "/v1beta/models/gemini-2.0-flash:generateContent?key=test";
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "application/json";
+    req.body = body;
+    req.body_len = sizeof(body) - 1;
+    req.timeout_ms = REQUEST_TIMEOUT_MS;
+
+    tls_conn_stats_t before;
+    tls_conn_get_stats(conn, &before);
+    double t0 = now_sec();
+
+    http_session_t s;
+    int status = http_session_begin(&s, conn, &req);
+    char *reply = status == 200 ? http_session_read_body(&s, 4096, nullptr) : nullptr;
+    if (reused) *reused = s.reused;
+    http_session_end(&s);
+
+    double sec = now_sec() - t0;
+    tls_conn_stats_t after;
+    tls_conn_get_stats(conn, &after);
+    if (timing && status == 200) {
+        if (after.resumed_handshakes > before.resumed_handshakes) {
+            timing->resumed_sec += sec;
+            timing->resumed++;
+        } else if (after.full_handshakes > before.full_handshakes) {
+            timing->full_sec += sec;
+            timing->full++;
+        } else {
+            timing->reused_sec += sec;
+            timing->reused++;
+        }
+    }
+
+    bool ok = reply && sscanf(reply, "{\"candidates\":[{\"content\":{\"parts\":[{\"text\":\"reply %d", reply_n) == 1;
+    free(reply);
+    return ok;
+}
+
+static size_t produce_voice(void *ctx, size_t offset, char *buf, size_t cap) {
+    size_t len = *(size_t *)ctx;
+    size_t n = len - offset < cap ? len - offset : cap;
+    for (size_t i = 0; i < n; i++) buf[i] = (char)('A' + (offset + i) % 26);
+    return n;
+}
+
+static uint32_t voice_sum(size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len; i++) sum = sum * 31 + (unsigned char)('A' + i % 26);
+    return sum;
+}
+
+static tls_conn_t *make_conn(Server *srv, int version, uint32_t idle_timeout_ms) {
+    tls_conn_config_t cfg;
+    tls_conn_default_config(&cfg);
+    cfg.idle_timeout_ms = idle_timeout_ms;
+    return tls_conn_create(ossl_transport_create(version), "127.0.0.1", srv->port, &cfg);
+}
+
+static void run(int version, const char *name) {
+    printf("%s\n", name);
+    Server srv;
+    if (!server_start(&srv)) {
+        check("stand-in server starts", false);
+        return;
+    }
+    tls_conn_stats_t st;
+    Timing timing;
+    char label[96];
+    bool ok;
+    int n = 0;
+    bool reused = false;
+
+    // Keep-alive: one handshake for the whole conversation
+    tls_conn_t *conn = make_conn(&srv, version, 60000);
+    ok = true;
+    for (int i = 0; i < 20; i++) ok = post(conn, &n, nullptr, &timing) && ok;
+    tls_conn_get_stats(conn, &st);
+    check("20 requests, all answered", ok && n == 20);
+    snprintf(label, sizeof(label), "one full handshake, 19 reused (%u full, %u reused)",
+             (unsigned)st.full_handshakes, (unsigned)st.reused);
+    check(label, st.full_handshakes == 1 && st.reused == 19 && srv.connections == 1);
+
+    // Voice-sized body produced while sending
+    size_t voice_len = VOICE_BODY_BYTES;
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = "/v1beta/models/gemini-2.0-flash:generateContent?key=test";
+    req.content_type = "application/json; charset=utf-8";
+    req.body_fn = produce_voice;
+    req.body_ctx = &voice_len;
+    req.body_len = voice_len;
+    req.timeout_ms = REQUEST_TIMEOUT_MS;
+    http_session_t s;
+    int status = http_session_begin(&s, conn, &req);
+    char *reply = http_session_read_body(&s, 4096, nullptr);
+    http_session_end(&s);
+    free(reply);
+    snprintf(label, sizeof(label), "%u byte produced body arrives intact, same connection",
+             (unsigned)voice_len);
+    check(label, status == 200 && s.reused && srv.last_body_len == voice_len &&
+                 srv.last_body_sum == voice_sum(voice_len));
+
+    // Server closes every 5th request: the reconnects resume the session
+    tls_conn_reset_stats(conn);
+    srv.close_every = 5;
+    ok = true;
+    for (int i = 0; i < 20; i++) ok = post(conn, &n, nullptr, &timing) && ok;
+    tls_conn_get_stats(conn, &st);
+    srv.close_every = 0;
+    snprintf(label, sizeof(label), "Connection: close every 5th: %u resumed, %u full, %u reused",
+             (unsigned)st.resumed_handshakes, (unsigned)st.full_handshakes, (unsigned)st.reused);
+    check(label, ok && st.resumed_handshakes == 4 && st.full_handshakes == 0 && st.reused == 16);
+
+    // Server closes idle connections: noticed before sending, then resumed
+    tls_conn_reset_stats(conn);
+    srv.idle_close_ms = 30;
+    ok = true;
+    for (int i = 0; i < 3; i++) {
+        usleep(200 * 1000);
+        ok = post(conn, &n, nullptr, &timing) && ok;
+    }
+    tls_conn_get_stats(conn, &st);
+    srv.idle_close_ms = 0;
+    snprintf(label, sizeof(label), "server idle close: %u seen closed, %u resumed, %u stale",
+             (unsigned)st.peer_closed, (unsigned)st.resumed_handshakes, (unsigned)st.stale);
+    check(label, ok && st.peer_closed == 3 && st.resumed_handshakes == 3 && st.stale == 0);
+
+    // Server closes as the request arrives: sent again once on a new connection
+    usleep(100 * 1000);
+    post(conn, &n, nullptr);
+    tls_conn_reset_stats(conn);
+    srv.drop_next = true;
+    ok = post(conn, &n, &reused);
+    tls_conn_get_stats(conn, &st);
+    snprintf(label, sizeof(label), "closed under a request: retried, %u stale, %u resumed",
+             (unsigned)st.stale, (unsigned)st.resumed_handshakes);
+    check(label, ok && !reused && st.stale == 1 && st.resumed_handshakes == 1);
+
+    // Chunked replies, with extensions and trailers, keep the connection
+    tls_conn_reset_stats(conn);
+    srv.chunked = true;
+    int first = 0;
+    ok = post(conn, &first, nullptr) && post(conn, &n, nullptr) && post(conn, &n, nullptr);
+    tls_conn_get_stats(conn, &st);
+    srv.chunked = false;
+    check("chunked replies decoded, connection reused", ok && n == first + 2 && st.reused == 3);
+
+    // New ticket keys on the server: the stale session falls back to full
+    tls_conn_close(conn);
+    tls_conn_reset_stats(conn);
+    rotate_ticket_keys(&srv);
+    ok = post(conn, &n, nullptr);
+    tls_conn_get_stats(conn, &st);
+    check("server forgot the session: full handshake", ok && st.full_handshakes == 1 &&
+                                                          st.resumed_handshakes == 0);
+    tls_conn_destroy(conn);
+
+    // Client-side idle limit: closed here, resumed on the next request
+    conn = make_conn(&srv, version, 50);
+    ok = post(conn, &n, nullptr);
+    usleep(80 * 1000);
+    ok = post(conn, &n, nullptr) && ok;
+    tls_conn_get_stats(conn, &st);
+    check("idle longer than idle_timeout_ms: closed and resumed",
+          ok && st.idle_expired == 1 && st.full_handshakes == 1 && st.resumed_handshakes == 1);
+    tls_conn_destroy(conn);
+
+    // Nothing listening
+    uint16_t port = srv.port;
+    server_stop(&srv);
+    Server gone;
+    gone.port = port;
+    conn = make_conn(&gone, version, 60000);
+    status = http_session_begin(&s, conn, &req);
+    http_session_end(&s);
+    tls_conn_get_stats(conn, &st);
+    check("server down: connect error", status == HTTP_SESSION_ERR_CONNECT && st.connect_failures == 1);
+    tls_conn_destroy(conn);
+
+    printf("    request time: %.2f ms reused (%d), %.2f ms resumed (%d), %.2f ms full handshake (%d)\n",
+           timing.reused ? timing.reused_sec / timing.reused * 1e3 : 0, timing.reused,
+           timing.resumed ? timing.resumed_sec / timing.resumed * 1e3 : 0, timing.resumed,
+           timing.full ? timing.full_sec / timing.full * 1e3 : 0, timing.full);
+}
+
+int main() {
+    signal(SIGPIPE, SIG_IGN);
+    s_ex_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    run(TLS1_2_VERSION, "TLS 1.2");
+    run(TLS1_3_VERSION, "TLS 1.3");
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
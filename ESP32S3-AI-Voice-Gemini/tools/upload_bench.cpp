@@ -0,0 +1,756 @@
+// tools/upload_bench.cpp - Host checks and timing for the streaming audio upload
+//
+// Runs the upload path of src/audio_uploader - upload_stream_body() as the
+// chunked body of an http_session request over tls_conn - against a local
+// stand-in for the upload endpoint. A capture thread pushes 20 ms frames
+// into the ring in real time while the upload runs, next to a recorder
+// reading every sample the way speech_to_text does. The server parses the
+// chunked body strictly (hex size line, exact data length, CRLF after the
+// data, the terminating chunk) and notes when each chunk arrives.
+//
+// Checked:
+//   - request head: POST, Transfer-Encoding: chunked, no Content-Length,
+//     the codec's Content-Type
+//   - the body is the container header, then the pre-roll and captured
+//     audio in order (raw PCM16), or exactly what encoding the same audio
+//     in one go gives (mu-law, IMA ADPCM, FLAC)
+//   - every sample reaches the server within the batching delay of being
+//     captured, and the body ends within a poll interval of capture ending
+//   - replies framed with Content-Length and with chunked coding are
+//     decoded; the next upload reuses the connection
+//   - an aborted upload stops within a poll interval
+//   - a server that stops reading does not hold the capture back: the
+//     recorder still gets every sample, and the uploader skips ahead in the
+//     ring with the samples it lost counted
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src upload_bench.cpp ../src/upload_stream.cpp ../src/audio_ring.cpp ../src/audio_codec.cpp ../src/http_session.cpp ../src/tls_conn.cpp -lpthread -o upload_bench
+//   ./upload_bench
+//
+// Exits non-zero if a check fails.
+
+#include "audio_codec.h"
+#include "audio_ring.h"
+#include "http_session.h"
+#include "tls_conn.h"
+#include "upload_stream.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <math.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define SAMPLE_RATE     16000
+#define FRAME_SAMPLES   320         // 20 ms capture frames
+#define FRAME_MS        20
+#define MIN_CHUNK       1600        // As in audio_uploader.cpp
+#define MAX_CHUNK       8000
+#define POLL_MS         20
+#define RING_SAMPLES    16384
+#define PREROLL_FRAMES  15          // 300 ms
+#define CAPTURE_FRAMES  60          // 1.2 s
+#define STALL_MS        2500
+#define UPLOAD_PATH     "/v1/speech:recognize?lang=vi"
+#define TRANSCRIPT      "{\"transcript\": \"xin ch\\u00e0o, h\\u00f4m nay tr\\u1eddi \\u0111\\u1eb9p qu\\u00e1\"}"
+
+static int s_failures = 0;
+static std::chrono::steady_clock::time_point s_t0 = std::chrono::steady_clock::now();
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_t0).count();
+}
+
+static void sleep_ms(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// ---------------------------------------------------------------------------
+// Stand-in upload endpoint
+
+enum { REPLY_CHUNKED = 0, REPLY_LENGTH };
+
+struct Upload {
+    std::string head;
+    std::string body;
+    std::string framing_error;              // Empty if every chunk was well formed
+    std::vector<double> chunk_ms;           // Arrival of each chunk's data
+    std::vector<size_t> chunk_end;          // Body length after each chunk
+    double end_ms = 0;                      // Terminating chunk
+    bool complete = false;
+};
+
+struct Server {
+    int listen_fd = -1;
+    uint16_t port = 0;
+    std::thread thread;
+    std::atomic<bool> stop{false};
+
+    std::atomic<int> reply{REPLY_CHUNKED};
+    std::atomic<long> stall_after{-1};      // Stop reading once this much body arrived
+    std::atomic<int> stall_ms{0};
+    std::atomic<int> connections{0};
+
+    std::mutex mu;
+    std::vector<Upload> uploads;
+};
+
+// Buffered reads from the client socket
+struct Conn {
+    int fd;
+    char buf[4096];
+    size_t pos = 0, len = 0;
+
+    bool fill() {
+        if (pos < len) return true;
+        for (;;) {
+            struct pollfd p = { fd, POLLIN, 0 };
+            int r = poll(&p, 1, 3000);
+            if (r <= 0) return false;
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) return false;
+            pos = 0;
+            len = (size_t)n;
+            return true;
+        }
+    }
+    // A CRLF terminated line; a bare LF is a framing error
+    bool line(std::string &out, bool *bare_lf) {
+        out.clear();
+        *bare_lf = false;
+        for (;;) {
+            if (!fill()) return false;
+            char c = buf[pos++];
+            if (c == '\n') {
+                if (out.empty() || out.back() != '\r') *bare_lf = true;
+                else out.pop_back();
+                return true;
+            }
+            out += c;
+        }
+    }
+    bool bytes(std::string &out, size_t n) {
+        while (n > 0) {
+            if (!fill()) return false;
+            size_t k = std::min(n, len - pos);
+            out.append(buf + pos, k);
+            pos += k;
+            n -= k;
+        }
+        return true;
+    }
+};
+
+static bool send_all(int fd, const std::string &s) {
+    return send(fd, s.data(), s.size(), MSG_NOSIGNAL) == (ssize_t)s.size();
+}
+
+static bool read_upload(Server *srv, Conn &c, Upload &up) {
+    std::string line;
+    bool bare;
+    for (;;) {
+        if (!c.line(line, &bare)) return false;
+        up.head += line + "\r\n";
+        if (line.empty()) break;
+    }
+    if (strcasestr(up.head.c_str(), "\r\nTransfer-Encoding: chunked\r\n") == nullptr) {
+        up.framing_error = "request is not chunked";
+        return true;
+    }
+
+    bool stalled = false;
+    for (;;) {
+        long after = srv->stall_after;
+        if (!stalled && after >= 0 && (long)up.body.size() >= after) {
+            stalled = true;
+            sleep_ms(srv->stall_ms);
+        }
+        if (!c.line(line, &bare)) {
+            up.framing_error = "connection closed inside the body";
+            return false;
+        }
+        char *end;
+        unsigned long size = strtoul(line.c_str(), &end, 16);
+        if (bare || line.empty() || *end != '\0') {
+            up.framing_error = "bad chunk size line '" + line + "'";
+            return false;
+        }
+        if (size == 0) {
+            if (!c.line(line, &bare) || bare || !line.empty()) {
+                up.framing_error = "no empty line after the last chunk";
+                return false;
+            }
+            up.end_ms = now_ms();
+            up.complete = true;
+            return true;
+        }
+        std::string crlf;
+        if (!c.bytes(up.body, size) || !c.bytes(crlf, 2)) {
+            up.framing_error = "chunk data cut short";
+            return false;
+        }
+        if (crlf != "\r\n") {
+            up.framing_error = "chunk data not followed by CRLF";
+            return false;
+        }
+        up.chunk_ms.push_back(now_ms());
+        up.chunk_end.push_back(up.body.size());
+    }
+}
+
+static void reply(Server *srv, int fd) {
+    std::string json = TRANSCRIPT;
+    if (srv->reply == REPLY_LENGTH) {
+        send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                     std::to_string(json.size()) + "\r\n\r\n" + json);
+        return;
+    }
+    // In three pieces with a pause, the way a recogniser finishes
+    send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n");
+    size_t a = json.size() / 3, b = json.size() * 2 / 3;
+    const std::string pieces[3] = { json.substr(0, a), json.substr(a, b - a), json.substr(b) };
+    for (const std::string &p : pieces) {
+        char size[16];
+        snprintf(size, sizeof(size), "%zx\r\n", p.size());
+        send_all(fd, size + p + "\r\n");
+        sleep_ms(5);
+    }
+    send_all(fd, "0\r\n\r\n");
+}
+
+static void serve_connection(Server *srv, int fd) {
+    srv->connections++;
+    Conn c;
+    c.fd = fd;
+    while (!srv->stop) {
+        Upload up;
+        bool keep = read_upload(srv, c, up);
+        bool answer = up.complete && up.framing_error.empty();
+        {
+            std::lock_guard<std::mutex> lock(srv->mu);
+            if (!up.head.empty()) srv->uploads.push_back(up);
+        }
+        if (!keep || !answer) break;
+        reply(srv, fd);
+    }
+    close(fd);
+}
+
+static void server_loop(Server *srv) {
+    while (!srv->stop) {
+        struct pollfd p = { srv->listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) <= 0) continue;
+        int fd = accept(srv->listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(serve_connection, srv, fd).detach();
+    }
+}
+
+static bool server_start(Server *srv) {
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    // A small receive window, so a server that stops reading pushes back
+    // on the uploader within a few kB, as a slow uplink would
+    int rcvbuf = 4096;
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, 4) != 0 ||
+        getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+        return false;
+    }
+    srv->port = ntohs(addr.sin_port);
+    srv->thread = std::thread(server_loop, srv);
+    return true;
+}
+
+static void server_stop(Server *srv) {
+    srv->stop = true;
+    if (srv->thread.joinable()) srv->thread.join();
+    if (srv->listen_fd >= 0) close(srv->listen_fd);
+    srv->listen_fd = -1;
+}
+
+static Upload last_upload(Server *srv) {
+    // The server thread files the upload just after the client has read
+    // the reply; give it a moment
+    for (int i = 0; i < 100; i++) {
+        {
+            std::lock_guard<std::mutex> lock(srv->mu);
+            if (!srv->uploads.empty()) {
+                Upload up = srv->uploads.back();
+                srv->uploads.clear();
+                return up;
+            }
+        }
+        sleep_ms(5);
+    }
+    return Upload();
+}
+
+// ---------------------------------------------------------------------------
+// Plain socket transport, what tls_transport_mbedtls_create(false) does on
+// the device
+
+struct SockTransport {
+    tls_transport_t base;
+    int fd;
+};
+
+static SockTransport *self(tls_transport_t *t) {
+    return (SockTransport *)t;
+}
+
+static void st_close(tls_transport_t *t) {
+    if (self(t)->fd >= 0) close(self(t)->fd);
+    self(t)->fd = -1;
+}
+
+static tls_connect_result_t st_connect(tls_transport_t *t, const char *host, uint16_t port,
+                                       bool resume, uint32_t timeout_ms) {
+    (void)resume;
+    (void)timeout_ms;
+    st_close(t);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int sndbuf = 4096;      // As small as lwIP's send buffer
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return TLS_CONNECT_FAILED;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    self(t)->fd = fd;
+    return TLS_CONNECT_FULL;
+}
+
+static bool st_alive(tls_transport_t *t) {
+    char b;
+    if (self(t)->fd < 0) return false;
+    int n = recv(self(t)->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static bool st_write(tls_transport_t *t, const void *data, size_t len, uint32_t timeout_ms) {
+    (void)timeout_ms;
+    return self(t)->fd >= 0 && send(self(t)->fd, data, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static int st_read(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms) {
+    if (self(t)->fd < 0) return -1;
+    struct pollfd p = { self(t)->fd, POLLIN, 0 };
+    if (poll(&p, 1, (int)timeout_ms) == 0) return 0;
+    ssize_t n = recv(self(t)->fd, buf, len, 0);
+    return n > 0 ? (int)n : -1;
+}
+
+static void st_forget_session(tls_transport_t *t) {
+    (void)t;
+}
+
+static void st_destroy(tls_transport_t *t) {
+    st_close(t);
+    delete self(t);
+}
+
+static const tls_transport_ops_t s_sock_ops = {
+    st_connect, st_alive, st_write, st_read, st_close, st_forget_session, st_destroy,
+};
+
+static tls_conn_t *make_conn(Server *srv) {
+    SockTransport *s = new SockTransport();
+    s->base.ops = &s_sock_ops;
+    s->fd = -1;
+    return tls_conn_create(&s->base, "127.0.0.1", srv->port, nullptr);
+}
+
+// ---------------------------------------------------------------------------
+// Capture: a producer pushing 20 ms frames in real time and a recorder
+// reading every sample, as audio_capture and speech_to_text do
+
+static int16_t sample_at(uint32_t n, bool tone) {
+    if (!tone) return (int16_t)n;       // Sequence numbers: gaps and order are visible
+    double t = (double)n / SAMPLE_RATE;
+    return (int16_t)lrint(6000 * sin(2 * M_PI * 180 * t) + 2000 * sin(2 * M_PI * 1130 * t));
+}
+
+struct Capture {
+    audio_ring_t *ring;
+    bool tone;
+    uint32_t frames;
+    uint32_t first;                         // Index of the first sample pushed by the thread
+    std::vector<double> frame_ms;           // When each frame was pushed
+    volatile bool finish = false;
+    double finish_ms = 0;
+    std::atomic<bool> recorder_ok{true};
+    std::atomic<uint32_t> recorded{0};
+    std::thread producer, recorder;
+};
+
+static void capture_start(Capture *cap) {
+    int rec = audio_ring_reader_open(cap->ring);
+    cap->frame_ms.assign(cap->frames, 0);
+
+    cap->recorder = std::thread([cap, rec] {
+        int16_t buf[1024];
+        uint32_t expect = cap->first;
+        for (;;) {
+            bool done = cap->finish;
+            size_t n = audio_ring_read(cap->ring, rec, buf, 1024);
+            for (size_t i = 0; i < n; i++) {
+                if (buf[i] != sample_at(expect++, cap->tone)) cap->recorder_ok = false;
+            }
+            cap->recorded += (uint32_t)n;
+            if (done && n == 0) break;
+            if (n == 0) sleep_ms(5);
+        }
+        audio_ring_reader_close(cap->ring, rec);
+    });
+
+    cap->producer = std::thread([cap] {
+        int16_t frame[FRAME_SAMPLES];
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t f = 0; f < cap->frames; f++) {
+            std::this_thread::sleep_until(start + std::chrono::milliseconds(FRAME_MS * (f + 1)));
+            for (int i = 0; i < FRAME_SAMPLES; i++) frame[i] = sample_at(cap->first + f * FRAME_SAMPLES + i, cap->tone);
+            audio_ring_push(cap->ring, frame, FRAME_SAMPLES);
+            cap->frame_ms[f] = now_ms();
+        }
+        cap->finish_ms = now_ms();
+        cap->finish = true;
+    });
+}
+
+static void capture_join(Capture *cap) {
+    cap->producer.join();
+    cap->recorder.join();
+}
+
+// ---------------------------------------------------------------------------
+// One upload
+
+struct Result {
+    int status = 0;
+    bool reused = false;
+    std::string reply;
+    std::string header;             // What was sent before the audio
+    std::string expected;           // The whole body the server should have
+    upload_stream_t stats;
+    uint32_t dropped = 0;           // By the producer, for every reader
+    double start_ms = 0;
+    double done_ms = 0;
+    Capture *cap = nullptr;
+};
+
+static size_t wav_header(uint8_t *out, const audio_codec_wav_format_t *fmt) {
+    auto le16 = [](uint8_t *p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; };
+    auto le32 = [](uint8_t *p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF; };
+    size_t fmt_len = fmt->samples_per_block ? 20 : 16;
+    memcpy(out, "RIFF", 4);
+    le32(out + 4, 0xFFFFFFFF);
+    memcpy(out + 8, "WAVEfmt ", 8);
+    le32(out + 16, (uint32_t)fmt_len);
+    le16(out + 20, fmt->format_tag);
+    le16(out + 22, 1);
+    le32(out + 24, SAMPLE_RATE);
+    le32(out + 28, fmt->byte_rate);
+    le16(out + 32, fmt->block_align);
+    le16(out + 34, fmt->bits_per_sample);
+    size_t pos = 36;
+    if (fmt->samples_per_block) {
+        le16(out + 36, 2);
+        le16(out + 38, fmt->samples_per_block);
+        pos = 40;
+    }
+    memcpy(out + pos, "data", 4);
+    le32(out + pos + 4, 0xFFFFFFFF);
+    return pos + 8;
+}
+
+static upload_stream_t s_stream;        // Buffers kept between uploads, as on the device
+
+static Result upload(tls_conn_t *conn, audio_codec_id_t codec, bool tone, size_t ring_samples,
+                     uint32_t frames = CAPTURE_FRAMES,
+                     volatile bool *abort_flag = nullptr, int abort_after_ms = -1) {
+    Result r;
+    audio_ring_t *ring = audio_ring_create(ring_samples);
+
+    // Pre-roll already in the ring when the upload starts
+    uint32_t preroll = PREROLL_FRAMES * FRAME_SAMPLES;
+    std::vector<int16_t> pre(preroll);
+    for (uint32_t i = 0; i < preroll; i++) pre[i] = sample_at(i, tone);
+    audio_ring_push(ring, pre.data(), preroll);
+
+    audio_encoder_t enc;
+    audio_encoder_init(&enc, codec, SAMPLE_RATE);
+    uint8_t header[UPLOAD_STREAM_HEADER_MAX];
+    size_t header_len;
+    audio_codec_wav_format_t fmt;
+    if (audio_codec_wav_format(codec, SAMPLE_RATE, &fmt)) {
+        header_len = wav_header(header, &fmt);
+    } else {
+        header_len = audio_encoder_header(&enc, header, sizeof(header));
+    }
+    r.header.assign((const char *)header, header_len);
+
+    Capture *cap = new Capture();
+    cap->ring = ring;
+    cap->tone = tone;
+    cap->frames = frames;
+    cap->first = preroll;
+    r.cap = cap;
+
+    int reader = audio_ring_reader_open_lossy(ring, preroll);
+    static volatile bool no_abort = false;
+    volatile bool *abort = abort_flag ? abort_flag : &no_abort;
+    *abort = false;
+    const upload_stream_config_t cfg = { MIN_CHUNK, MAX_CHUNK, POLL_MS, sleep_ms };
+    upload_stream_init(&s_stream, &cfg, ring, reader, &cap->finish, abort, &enc, header, header_len);
+
+    // The expected body: everything encoded in one go
+    uint32_t total = preroll + frames * FRAME_SAMPLES;
+    std::vector<int16_t> all(total);
+    for (uint32_t i = 0; i < total; i++) all[i] = sample_at(i, tone);
+    r.expected = r.header;
+    if (codec == AUDIO_CODEC_PCM16) {
+        r.expected.append((const char *)all.data(), total * sizeof(int16_t));
+    } else {
+        audio_encoder_t ref = enc;
+        std::vector<uint8_t> out(audio_encoder_max_output(&ref, total));
+        size_t n = audio_encoder_encode(&ref, all.data(), total, out.data(), out.size());
+        n += audio_encoder_flush(&ref, out.data() + n, out.size() - n);
+        r.expected.append((const char *)out.data(), n);
+    }
+
+    std::thread aborter;
+    if (abort_after_ms >= 0) {
+        aborter = std::thread([abort, abort_after_ms] {
+            sleep_ms(abort_after_ms);
+            *abort = true;
+        });
+    }
+
+    capture_start(cap);
+    r.start_ms = now_ms();
+
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = UPLOAD_PATH;
+    req.content_type = audio_codec_mime(codec);
+    req.body_fn = upload_stream_body;
+    req.body_ctx = &s_stream;
+    req.body_len = HTTP_SESSION_CHUNKED_BODY;
+    req.timeout_ms = 5000;
+    req.cancel = abort;
+
+    http_session_t s;
+    r.status = http_session_begin(&s, conn, &req);
+    r.reused = s.reused;
+    if (r.status > 0) {
+        size_t len = 0;
+        char *body = http_session_read_body(&s, 2048, &len);
+        if (body) r.reply.assign(body, len);
+        free(body);
+    }
+    http_session_end(&s);
+    r.done_ms = now_ms();
+
+    if (aborter.joinable()) aborter.join();
+    cap->finish = true;
+    capture_join(cap);
+    r.stats = s_stream;
+    audio_ring_stats_t rs;
+    audio_ring_get_stats(ring, &rs);
+    r.dropped = rs.dropped;
+    audio_ring_reader_close(ring, reader);
+    audio_ring_destroy(ring);
+    return r;
+}
+
+// Latency from capture to arrival at the server of every raw PCM16 sample
+static void sample_latency(const Result &r, const Upload &up, double *p50, double *max) {
+    std::vector<double> lat;
+    size_t hdr = r.header.size();
+    size_t from = hdr;
+    for (size_t c = 0; c < up.chunk_end.size(); c++) {
+        for (size_t b = std::max(from, hdr); b + 1 < up.chunk_end[c]; b += 2) {
+            size_t sample = (b - hdr) / 2;
+            double captured;
+            if (sample < r.cap->first) {
+                captured = r.start_ms;      // Pre-roll: there when the upload started
+            } else {
+                size_t frame = (sample - r.cap->first) / FRAME_SAMPLES;
+                captured = r.cap->frame_ms[frame];
+            }
+            lat.push_back(up.chunk_ms[c] - captured);
+        }
+        from = up.chunk_end[c];
+    }
+    std::sort(lat.begin(), lat.end());
+    *p50 = lat.empty() ? 0 : lat[lat.size() / 2];
+    *max = lat.empty() ? 0 : lat.back();
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+
+static void test_framing_and_timing(Server *srv, tls_conn_t *conn) {
+    printf("Raw PCM16, %d ms pre-roll + %d ms capture, chunked reply\n",
+           PREROLL_FRAMES * FRAME_MS, CAPTURE_FRAMES * FRAME_MS);
+    srv->reply = REPLY_CHUNKED;
+    Result r = upload(conn, AUDIO_CODEC_PCM16, false, RING_SAMPLES);
+    Upload up = last_upload(srv);
+
+    check("request head: POST, chunked, no Content-Length, audio/wav",
+          up.head.compare(0, strlen("POST " UPLOAD_PATH " HTTP/1.1\r\n"), "POST " UPLOAD_PATH " HTTP/1.1\r\n") == 0 &&
+              strcasestr(up.head.c_str(), "\r\nTransfer-Encoding: chunked\r\n") &&
+              !strcasestr(up.head.c_str(), "\r\nContent-Length:") &&
+              strcasestr(up.head.c_str(), "\r\nContent-Type: audio/wav\r\n"));
+    check("every chunk well framed, terminating chunk seen", up.framing_error.empty() && up.complete);
+    if (!up.framing_error.empty()) printf("    %s\n", up.framing_error.c_str());
+    check("one HTTP chunk per piece the body produced", up.chunk_ms.size() == r.stats.chunks);
+    check("body: WAV header, then pre-roll and capture in order", up.body == r.expected);
+    check("chunked reply decoded", r.status == 200 && r.reply == TRANSCRIPT);
+    check("recorder got every sample next to the upload",
+          r.cap->recorder_ok && r.cap->recorded == CAPTURE_FRAMES * FRAME_SAMPLES);
+
+    double p50 = 0, max = 0;
+    sample_latency(r, up, &p50, &max);
+    double first = up.chunk_ms.size() > 1 ? up.chunk_ms[1] - r.start_ms : 1e9;
+    double tail = up.end_ms - r.cap->finish_ms;
+    char label[96];
+    snprintf(label, sizeof(label), "pre-roll on the wire at once (%.0f ms)", first);
+    check(label, first < 50);
+    snprintf(label, sizeof(label), "capture to server within the batch delay (max %.0f ms)", max);
+    check(label, max < FRAME_MS + MIN_CHUNK * 1000.0 / SAMPLE_RATE + POLL_MS + 40);
+    snprintf(label, sizeof(label), "body ends within a poll of capture ending (%.0f ms)", tail);
+    check(label, tail < POLL_MS + 30);
+    printf("    %zu chunks, sample latency p50 %.0f ms, max %.0f ms\n", up.chunk_ms.size(), p50, max);
+    delete r.cap;
+}
+
+static void test_codecs(Server *srv, tls_conn_t *conn) {
+    printf("Encoded uploads, Content-Length reply, kept-alive connection\n");
+    srv->reply = REPLY_LENGTH;
+    const audio_codec_id_t codecs[] = { AUDIO_CODEC_ULAW, AUDIO_CODEC_IMA_ADPCM, AUDIO_CODEC_FLAC };
+    for (audio_codec_id_t codec : codecs) {
+        Result r = upload(conn, codec, true, RING_SAMPLES);
+        Upload up = last_upload(srv);
+        std::string type = std::string("\r\nContent-Type: ") + audio_codec_mime(codec) + "\r\n";
+        char label[96];
+        snprintf(label, sizeof(label), "%s: well framed, Content-Type %s", audio_codec_name(codec),
+                 audio_codec_mime(codec));
+        check(label, up.framing_error.empty() && up.complete && strcasestr(up.head.c_str(), type.c_str()));
+        snprintf(label, sizeof(label), "%s: body is the clip encoded in one go (%zu bytes)",
+                 audio_codec_name(codec), up.body.size());
+        check(label, up.body == r.expected);
+        snprintf(label, sizeof(label), "%s: reply decoded on the reused connection", audio_codec_name(codec));
+        check(label, r.status == 200 && r.reply == TRANSCRIPT && r.reused);
+        delete r.cap;
+    }
+    check("all uploads on one connection", srv->connections == 1);
+}
+
+static void test_abort(Server *srv, tls_conn_t *conn) {
+    printf("Abort\n");
+    static volatile bool abort_flag = false;
+    Result r = upload(conn, AUDIO_CODEC_PCM16, false, RING_SAMPLES, CAPTURE_FRAMES, &abort_flag, 400);
+    Upload up = last_upload(srv);
+    double took = r.done_ms - r.start_ms;
+    char label[96];
+    snprintf(label, sizeof(label), "cancelled within a poll interval (%.0f ms after 400)", took);
+    check(label, r.status == HTTP_SESSION_ERR_CANCELLED && took < 400 + HTTP_SESSION_CANCEL_POLL_MS + 30);
+    check("server never saw the end of the body", !up.complete);
+    delete r.cap;
+}
+
+static void test_stall(Server *srv, tls_conn_t *conn) {
+    const uint32_t frames = 200;
+    printf("Server stops reading for %d ms of a %u ms capture\n", STALL_MS, frames * FRAME_MS);
+    srv->reply = REPLY_CHUNKED;
+    srv->stall_ms = STALL_MS;
+    srv->stall_after = 20000;
+    Result r = upload(conn, AUDIO_CODEC_PCM16, false, RING_SAMPLES, frames);
+    Upload up = last_upload(srv);
+    srv->stall_after = -1;
+
+    // Sequence numbers: the body is runs of consecutive samples, and the
+    // gaps between them are what the uploader skipped
+    uint32_t total = PREROLL_FRAMES * FRAME_SAMPLES + frames * FRAME_SAMPLES;
+    size_t hdr = r.header.size();
+    bool header_ok = up.body.compare(0, hdr, r.header) == 0;
+    bool runs_ok = header_ok && (up.body.size() - hdr) % 2 == 0;
+    uint32_t expect = 0, gaps = 0, sent = 0, runs = 0;
+    for (size_t b = hdr; runs_ok && b + 1 < up.body.size(); b += 2) {
+        int16_t v;
+        memcpy(&v, up.body.data() + b, sizeof(v));
+        uint16_t gap = (uint16_t)(v - (int16_t)expect);
+        if (gap) runs++;
+        gaps += gap;
+        expect += gap + 1;
+        sent++;
+    }
+
+    check("well framed and complete after the stall", up.framing_error.empty() && up.complete);
+    check("producer never held back: nothing dropped", r.dropped == 0);
+    check("recorder got every sample",
+          r.cap->recorder_ok && r.cap->recorded == frames * FRAME_SAMPLES);
+    check("uploader skipped ahead", r.stats.skipped > 0 && runs > 0);
+    check("gaps in the body are the samples counted as skipped",
+          runs_ok && gaps == r.stats.skipped && sent == r.stats.samples);
+    check("uploaded + skipped == captured", r.stats.samples + r.stats.skipped == total && expect == total);
+    check("reply still decoded", r.status == 200 && r.reply == TRANSCRIPT);
+    printf("    %u of %u samples uploaded, %u skipped in %u gap(s), body ended %.0f ms after capture\n",
+           (unsigned)r.stats.samples, total, (unsigned)r.stats.skipped, runs, up.end_ms - r.cap->finish_ms);
+    delete r.cap;
+}
+
+int main() {
+    Server srv;
+    if (!server_start(&srv)) {
+        printf("Cannot start the stand-in server\n");
+        return 1;
+    }
+    tls_conn_t *conn = make_conn(&srv);
+
+    test_framing_and_timing(&srv, conn);
+    test_codecs(&srv, conn);
+    test_abort(&srv, conn);
+    test_stall(&srv, conn);
+
+    tls_conn_destroy(conn);
+    server_stop(&srv);
+    upload_stream_free(&s_stream);
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
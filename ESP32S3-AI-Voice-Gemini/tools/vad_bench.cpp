@@ -0,0 +1,266 @@
+// tools/vad_bench.cpp - Host checks and benchmark for src/vad
+//
+// Builds synthetic 16 kHz clips from 20 ms frames of silence (~6 LSB RMS),
+// voiced speech (a 150 Hz tone with harmonics), fricatives (quiet
+// high-ZCR noise) and steady background noise, runs them through
+// vad_process_frame with the default config and checks the frame each
+// event fires on and the segment vad_get_segment returns: speech start
+// after start_frames, end after exactly hangover_frames of silence, pauses
+// one frame shorter than the hangover bridged, lead/tail padding and its
+// clamping, the no-speech timeout and the max_frames cap. Reports the cost
+// of one frame in us.
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src vad_bench.cpp ../src/vad.cpp -o vad_bench
+//   ./vad_bench
+//
+// Exits non-zero if a check fails.
+
+#include "vad.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#define SAMPLE_RATE     16000
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+// ---------------------------------------------------------------------------
+// Clip builder
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    SILENCE,        // Uniform noise, ~6 LSB RMS: below min_energy
+    SPEECH,         // 150 Hz + harmonics, ~2000 LSB RMS, low ZCR
+    FRICATIVE,      // Uniform noise, ~35 LSB RMS: high ZCR, 3x min_energy
+    HUM,            // 150 Hz tone at the same energy as FRICATIVE, low ZCR
+    NOISE,          // Uniform noise, ~300 LSB RMS
+    SPEECH_NOISE,   // SPEECH on top of NOISE
+} kind_t;
+
+struct Clip {
+    uint16_t frame_samples;
+    std::vector<int16_t> pcm;
+    uint32_t lcg = 0x1234567u;
+    double phase = 0;
+
+    explicit Clip(uint16_t fs) : frame_samples(fs) {}
+
+    int32_t noise(int32_t amplitude) {
+        lcg = lcg * 1664525u + 1013904223u;
+        return (int32_t)((int64_t)(int32_t)lcg * amplitude / INT32_MAX);
+    }
+
+    double voice() {
+        phase += 2 * M_PI * 150 / SAMPLE_RATE;
+        return 2000 * sin(phase) + 1000 * sin(2 * phase) + 500 * sin(3 * phase);
+    }
+
+    Clip &add(kind_t kind, int frames) {
+        for (int i = 0; i < frames * frame_samples; i++) {
+            double s = 0;
+            switch (kind) {
+            case SILENCE:       s = noise(10); break;
+            case SPEECH:        s = voice(); break;
+            case FRICATIVE:     s = noise(60); break;
+            case HUM:           phase += 2 * M_PI * 150 / SAMPLE_RATE; s = 49 * sin(phase); break;
+            case NOISE:         s = noise(520); break;
+            case SPEECH_NOISE:  s = voice() + noise(520); break;
+            }
+            pcm.push_back((int16_t)lrint(s));
+        }
+        return *this;
+    }
+
+    int frames() const { return (int)(pcm.size() / frame_samples); }
+};
+
+// Result of running a clip: the frame index each event fired on (-1 if
+// none) and the segment in frames.
+struct Run {
+    int start_at = -1, end_at = -1, timeout_at = -1;
+    int frames = 0;
+    bool has_segment = false;
+    size_t seg_start = 0, seg_end = 0;
+};
+
+static Run run(const Clip &clip, const vad_config_t *cfg) {
+    vad_t vad;
+    vad_init(&vad, cfg);
+    Run r;
+    for (int f = 0; f < clip.frames() && vad.state != VAD_STATE_ENDED; f++) {
+        switch (vad_process_frame(&vad, &clip.pcm[(size_t)f * clip.frame_samples])) {
+        case VAD_EVENT_SPEECH_START: r.start_at = f; break;
+        case VAD_EVENT_SPEECH_END:   r.end_at = f; break;
+        case VAD_EVENT_TIMEOUT:      r.timeout_at = f; break;
+        default: break;
+        }
+        r.frames = f + 1;
+    }
+    r.has_segment = vad_get_segment(&vad, &r.seg_start, &r.seg_end);
+    r.seg_start /= clip.frame_samples;
+    r.seg_end /= clip.frame_samples;
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+// ---------------------------------------------------------------------------
+
+static void test_speech_in_silence(const vad_config_t *cfg) {
+    printf("Speech in silence\n");
+    const int lead = 50, speech = 100;
+    Clip clip(cfg->frame_samples);
+    clip.add(SILENCE, lead).add(SPEECH, speech).add(SILENCE, 100);
+    Run r = run(clip, cfg);
+
+    check("start fires on the start_frames-th speech frame", r.start_at == lead + cfg->start_frames - 1);
+    check("end fires on the hangover_frames-th silent frame",
+          r.end_at == lead + speech + cfg->hangover_frames - 1);
+    check("no timeout", r.timeout_at < 0);
+    check("nothing processed after the end", r.frames == r.end_at + 1);
+    check("segment starts lead_frames before the speech",
+          r.has_segment && r.seg_start == (size_t)(lead - cfg->lead_frames));
+    check("segment ends tail_frames after the last speech frame",
+          r.seg_end == (size_t)(lead + speech + cfg->tail_frames));
+}
+
+static void test_hangover(const vad_config_t *cfg) {
+    printf("Hangover of %u frames\n", cfg->hangover_frames);
+    const int gap_ok = cfg->hangover_frames - 1;
+
+    // A pause one frame shorter than the hangover is bridged
+    Clip bridged(cfg->frame_samples);
+    bridged.add(SILENCE, 20).add(SPEECH, 30).add(SILENCE, gap_ok).add(SPEECH, 30).add(SILENCE, 100);
+    Run r = run(bridged, cfg);
+    check("pause of hangover - 1 frames does not end the speech",
+          r.end_at == 20 + 30 + gap_ok + 30 + cfg->hangover_frames - 1);
+    check("bridged segment covers both words",
+          r.seg_start == (size_t)(20 - cfg->lead_frames) &&
+              r.seg_end == (size_t)(20 + 30 + gap_ok + 30 + cfg->tail_frames));
+
+    // A pause of exactly the hangover ends it, and the second word is lost
+    Clip split(cfg->frame_samples);
+    split.add(SILENCE, 20).add(SPEECH, 30).add(SILENCE, cfg->hangover_frames).add(SPEECH, 30);
+    r = run(split, cfg);
+    check("pause of hangover frames ends the speech at the pause",
+          r.end_at == 20 + 30 + cfg->hangover_frames - 1);
+    check("segment holds only the first word", r.seg_end == (size_t)(20 + 30 + cfg->tail_frames));
+}
+
+static void test_short_bursts(const vad_config_t *cfg) {
+    printf("Bursts shorter than start_frames\n");
+    Clip clip(cfg->frame_samples);
+    for (int i = 0; i < 20; i++) clip.add(SILENCE, 8).add(SPEECH, cfg->start_frames - 1);
+    clip.add(SILENCE, 300);
+    Run r = run(clip, cfg);
+    check("clicks never start speech", r.start_at < 0 && !r.has_segment);
+    check("timeout after no_speech_frames", r.timeout_at == cfg->no_speech_frames - 1);
+}
+
+static void test_silence_only(const vad_config_t *cfg) {
+    printf("Silence only\n");
+    Clip clip(cfg->frame_samples);
+    clip.add(SILENCE, 400);
+    Run r = run(clip, cfg);
+    check("timeout on frame no_speech_frames", r.timeout_at == cfg->no_speech_frames - 1);
+    check("no speech, no segment", r.start_at < 0 && r.end_at < 0 && !r.has_segment);
+}
+
+static void test_noise(const vad_config_t *cfg) {
+    printf("Steady background noise\n");
+    Clip noise(cfg->frame_samples);
+    noise.add(NOISE, 400);
+    Run r = run(noise, cfg);
+    check("noise alone is not speech", r.start_at < 0 && r.timeout_at == cfg->no_speech_frames - 1);
+
+    Clip clip(cfg->frame_samples);
+    clip.add(NOISE, 60).add(SPEECH_NOISE, 80).add(NOISE, 100);
+    r = run(clip, cfg);
+    check("speech over noise starts on time", r.start_at == 60 + cfg->start_frames - 1);
+    check("and ends after the hangover", r.end_at == 60 + 80 + cfg->hangover_frames - 1);
+    check("segment is padded the same way",
+          r.seg_start == (size_t)(60 - cfg->lead_frames) && r.seg_end == (size_t)(60 + 80 + cfg->tail_frames));
+}
+
+static void test_fricative(const vad_config_t *cfg) {
+    printf("Unvoiced threshold\n");
+    Clip fric(cfg->frame_samples);
+    fric.add(SILENCE, 30).add(FRICATIVE, 20).add(SILENCE, 100);
+    Run r = run(fric, cfg);
+    check("quiet high-ZCR frames start speech", r.start_at == 30 + cfg->start_frames - 1);
+
+    Clip hum(cfg->frame_samples);
+    hum.add(SILENCE, 30).add(HUM, 20).add(SILENCE, 300);
+    r = run(hum, cfg);
+    check("low-ZCR frames of the same energy do not", r.start_at < 0);
+}
+
+static void test_clamping(const vad_config_t *defaults) {
+    printf("Padding clamped to the clip\n");
+    Clip early(defaults->frame_samples);
+    early.add(SILENCE, 3).add(SPEECH, 20).add(SILENCE, 100);
+    Run r = run(early, defaults);
+    check("lead padding stops at sample 0", r.seg_start == 0);
+
+    // Speech that runs into max_frames ends there; the tail cannot reach
+    // past the frames processed
+    vad_config_t cfg = *defaults;
+    cfg.max_frames = 100;
+    Clip capped(cfg.frame_samples);
+    capped.add(SILENCE, 20).add(SPEECH, 200);
+    r = run(capped, &cfg);
+    check("max_frames ends ongoing speech", r.end_at == 99 && r.timeout_at < 0);
+    check("tail padding stops at the last frame processed", r.seg_end == 100);
+
+    Clip nothing(cfg.frame_samples);
+    nothing.add(SILENCE, 200);
+    r = run(nothing, &cfg);
+    check("max_frames without speech is a timeout", r.timeout_at == 99 && !r.has_segment);
+}
+
+static void bench(const vad_config_t *cfg) {
+    printf("Throughput\n");
+    Clip clip(cfg->frame_samples);
+    clip.add(SPEECH_NOISE, 500);
+    vad_config_t endless = *cfg;
+    endless.hangover_frames = UINT16_MAX;
+    endless.max_frames = UINT16_MAX;
+
+    const int rounds = 40;
+    vad_t vad;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int k = 0; k < rounds; k++) {
+        vad_init(&vad, &endless);
+        for (int f = 0; f < clip.frames(); f++) {
+            vad_process_frame(&vad, &clip.pcm[(size_t)f * clip.frame_samples]);
+        }
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    printf("    %.2f us per %u sample frame\n", us / (rounds * clip.frames()), cfg->frame_samples);
+}
+
+int main() {
+    vad_config_t cfg;
+    vad_config_default(&cfg, SAMPLE_RATE);
+
+    test_speech_in_silence(&cfg);
+    test_hangover(&cfg);
+    test_short_bursts(&cfg);
+    test_silence_only(&cfg);
+    test_noise(&cfg);
+    test_fricative(&cfg);
+    test_clamping(&cfg);
+    bench(&cfg);
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
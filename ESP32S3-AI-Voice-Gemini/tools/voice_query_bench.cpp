@@ -0,0 +1,715 @@
+// tools/voice_query_bench.cpp - Host checks for src/voice_query
+//
+// Posts a recorded WAV the way gemini_client_request_audio() does - the
+// body from voice_query_body() sent by http_session over tls_conn, the
+// reply read through gemini_reply, its text split by voice_query_parse() -
+// to a local stand-in for generateContent, which keeps what it received
+// and answers with a schema reply.
+//
+// Checked:
+//   - request head: POST to the model path, JSON content type, a
+//     Content-Length that is the body's size
+//   - the body starts with the conversation so far, byte for byte, and
+//     parses with jsoncpp; the user turn carries inline_data of type
+//     audio/wav whose data is exactly the WAV in base64 (encoded here
+//     independently), and the schema asks for transcript and answer; the
+//     streamed kind asks for a "Q:" line and no schema
+//   - transcript and answer come back exact through both layers of JSON:
+//     quotes, backslashes, line breaks, \u escapes with surrogate pairs,
+//     '\r' removed; with a chunked reply and then a Content-Length one on
+//     the same connection
+//   - voice_query_parse() on its own: member order, other members, nested
+//     values, a missing transcript, a later duplicate, lone surrogates,
+//     and text that is not the object (left untouched)
+//   - a streamed reply through stream_collector in pieces of any size: the
+//     "Q:" line handed over first, a single line, a first line too long
+//     to be a transcript, cancellation
+//
+// Build and run from this directory:
+//   g++ -O2 -I../src -I/usr/include/jsoncpp voice_query_bench.cpp ../src/voice_query.cpp ../src/request_writer.cpp ../src/conversation.cpp ../src/base64_stream.cpp ../src/gemini_reply.cpp ../src/http_session.cpp ../src/tls_conn.cpp ../src/stream_collector.cpp -ljsoncpp -lpthread -o voice_query_bench
+//   ./voice_query_bench
+//
+// Exits non-zero if a check fails.
+
+#include "voice_query.h"
+#include "conversation.h"
+#include "gemini_reply.h"
+#include "http_session.h"
+#include "request_writer.h"
+#include "stream_collector.h"
+#include "tls_conn.h"
+#include <json/json.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define SAMPLE_RATE     16000
+#define CLIP_SAMPLES    (SAMPLE_RATE * 3 / 2)
+#define READ_CHUNK      512         // GEMINI_READ_CHUNK
+#define MAX_ANSWER      4096        // GEMINI_MAX_ANSWER
+#define MODEL_PATH      "/v1beta/models/gemini-2.0-flash:generateContent?key=bench-key"
+
+static int s_failures = 0;
+
+static void check(const char *what, bool ok) {
+    printf("    %-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) s_failures++;
+}
+
+// ---------------------------------------------------------------------------
+// JSON strings, written independently of the code under test
+
+static void put_u(std::string &out, unsigned v) {
+    char hex[8];
+    snprintf(hex, sizeof(hex), "\\u%04x", v);
+    out += hex;
+}
+
+// ascii: non-ASCII characters as \u escapes (pairs above U+FFFF), as some
+// encoders write them
+static std::string json_string(const std::string &s, bool ascii) {
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = (unsigned char)s[i];
+        switch (c) {
+        case '"':  out += "\\\""; continue;
+        case '\\': out += "\\\\"; continue;
+        case '\n': out += "\\n"; continue;
+        case '\r': out += "\\r"; continue;
+        case '\t': out += "\\t"; continue;
+        }
+        if (c < 0x20) {
+            put_u(out, c);
+        } else if (c < 0x80 || !ascii) {
+            out += (char)c;
+        } else {
+            int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1;
+            unsigned cp = c & (0x3F >> extra);
+            for (int k = 0; k < extra; k++) cp = (cp << 6) | ((unsigned char)s[++i] & 0x3F);
+            if (cp >= 0x10000) {
+                cp -= 0x10000;
+                put_u(out, 0xD800 + (cp >> 10));
+                put_u(out, 0xDC00 + (cp & 0x3FF));
+            } else {
+                put_u(out, cp);
+            }
+        }
+    }
+    return out + "\"";
+}
+
+static std::string base64(const std::string &in) {
+    static const char *T = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        uint32_t v = ((uint8_t)in[i] << 16) | ((uint8_t)in[i + 1] << 8) | (uint8_t)in[i + 2];
+        out += T[v >> 18];
+        out += T[(v >> 12) & 63];
+        out += T[(v >> 6) & 63];
+        out += T[v & 63];
+    }
+    if (i < in.size()) {
+        uint32_t v = (uint8_t)in[i] << 16;
+        if (i + 1 < in.size()) v |= (uint8_t)in[i + 1] << 8;
+        out += T[v >> 18];
+        out += T[(v >> 12) & 63];
+        out += i + 1 < in.size() ? T[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// A generateContent reply whose text is the model's output, with the
+// metadata a real one carries
+static std::string model_reply(const std::string &text) {
+    return "{\n  \"candidates\": [{\"content\": {\"parts\": [{\"text\": " + json_string(text, false) +
+           "}], \"role\": \"model\"}, \"finishReason\": \"STOP\", \"safetyRatings\": ["
+           "{\"category\": \"HARM_CATEGORY_HARASSMENT\", \"probability\": \"NEGLIGIBLE\"}]}],\n"
+           "  \"usageMetadata\": {\"promptTokenCount\": 1210, \"candidatesTokenCount\": 41},\n"
+           "  \"modelVersion\": \"gemini-2.0-flash\"\n}\n";
+}
+
+// ---------------------------------------------------------------------------
+// Stand-in for generateContent
+
+enum { REPLY_CHUNKED = 0, REPLY_LENGTH };
+
+struct Request {
+    std::string head;
+    std::string body;
+};
+
+struct Server {
+    int listen_fd = -1;
+    uint16_t port = 0;
+    std::thread thread;
+    std::atomic<bool> stop{false};
+    std::atomic<int> reply{REPLY_CHUNKED};
+    std::atomic<int> connections{0};
+
+    std::mutex mu;
+    std::string answer;                     // Body of the next reply
+    std::vector<Request> requests;
+};
+
+static bool send_all(int fd, const std::string &s) {
+    return send(fd, s.data(), s.size(), MSG_NOSIGNAL) == (ssize_t)s.size();
+}
+
+// Buffered reads from the client socket
+struct Conn {
+    int fd;
+    std::string buf;
+
+    bool fill() {
+        char tmp[4096];
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 3000) <= 0) return false;
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buf.append(tmp, (size_t)n);
+        return true;
+    }
+};
+
+static bool read_request(Conn &c, Request &req) {
+    size_t end;
+    while ((end = c.buf.find("\r\n\r\n")) == std::string::npos) {
+        if (!c.fill()) return false;
+    }
+    req.head = c.buf.substr(0, end + 4);
+    c.buf.erase(0, end + 4);
+    const char *cl = strcasestr(req.head.c_str(), "\r\nContent-Length:");
+    size_t len = cl ? strtoul(cl + 17, nullptr, 10) : 0;
+    while (c.buf.size() < len) {
+        if (!c.fill()) return false;
+    }
+    req.body = c.buf.substr(0, len);
+    c.buf.erase(0, len);
+    return true;
+}
+
+static void send_reply(Server *srv, int fd, const std::string &json) {
+    if (srv->reply == REPLY_LENGTH) {
+        send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=UTF-8\r\nContent-Length: " +
+                     std::to_string(json.size()) + "\r\n\r\n" + json);
+        return;
+    }
+    // Small pieces, so escapes and UTF-8 sequences are cut at every point
+    send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=UTF-8\r\n"
+                 "Transfer-Encoding: chunked\r\n\r\n");
+    for (size_t i = 0; i < json.size(); i += 7) {
+        std::string piece = json.substr(i, 7);
+        char size[16];
+        snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+        send_all(fd, size + piece + "\r\n");
+    }
+    send_all(fd, "0\r\n\r\n");
+}
+
+static void serve_connection(Server *srv, int fd) {
+    srv->connections++;
+    Conn c = { fd, std::string() };
+    while (!srv->stop) {
+        Request req;
+        if (!read_request(c, req)) break;
+        std::string answer;
+        {
+            std::lock_guard<std::mutex> lock(srv->mu);
+            srv->requests.push_back(req);
+            answer = srv->answer;
+        }
+        send_reply(srv, fd, answer);
+    }
+    close(fd);
+}
+
+static void server_loop(Server *srv) {
+    while (!srv->stop) {
+        struct pollfd p = { srv->listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) <= 0) continue;
+        int fd = accept(srv->listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(serve_connection, srv, fd).detach();
+    }
+}
+
+static bool server_start(Server *srv) {
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, 4) != 0 ||
+        getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+        return false;
+    }
+    srv->port = ntohs(addr.sin_port);
+    srv->thread = std::thread(server_loop, srv);
+    return true;
+}
+
+static void server_stop(Server *srv) {
+    srv->stop = true;
+    if (srv->thread.joinable()) srv->thread.join();
+    if (srv->listen_fd >= 0) close(srv->listen_fd);
+}
+
+static Request last_request(Server *srv) {
+    std::lock_guard<std::mutex> lock(srv->mu);
+    Request r = srv->requests.empty() ? Request() : srv->requests.back();
+    srv->requests.clear();
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// Plain socket transport, what tls_transport_mbedtls_create(false) does on
+// the device
+
+struct SockTransport {
+    tls_transport_t base;
+    int fd;
+};
+
+static SockTransport *self(tls_transport_t *t) {
+    return (SockTransport *)t;
+}
+
+static void st_close(tls_transport_t *t) {
+    if (self(t)->fd >= 0) close(self(t)->fd);
+    self(t)->fd = -1;
+}
+
+static tls_connect_result_t st_connect(tls_transport_t *t, const char *host, uint16_t port,
+                                       bool resume, uint32_t timeout_ms) {
+    (void)resume;
+    (void)timeout_ms;
+    st_close(t);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return TLS_CONNECT_FAILED;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    self(t)->fd = fd;
+    return TLS_CONNECT_FULL;
+}
+
+static bool st_alive(tls_transport_t *t) {
+    char b;
+    if (self(t)->fd < 0) return false;
+    int n = recv(self(t)->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static bool st_write(tls_transport_t *t, const void *data, size_t len, uint32_t timeout_ms) {
+    (void)timeout_ms;
+    return self(t)->fd >= 0 && send(self(t)->fd, data, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static int st_read(tls_transport_t *t, void *buf, size_t len, uint32_t timeout_ms) {
+    if (self(t)->fd < 0) return -1;
+    struct pollfd p = { self(t)->fd, POLLIN, 0 };
+    if (poll(&p, 1, (int)timeout_ms) == 0) return 0;
+    ssize_t n = recv(self(t)->fd, buf, len, 0);
+    return n > 0 ? (int)n : -1;
+}
+
+static void st_forget_session(tls_transport_t *t) {
+    (void)t;
+}
+
+static void st_destroy(tls_transport_t *t) {
+    st_close(t);
+    delete self(t);
+}
+
+static const tls_transport_ops_t s_sock_ops = {
+    st_connect, st_alive, st_write, st_read, st_close, st_forget_session, st_destroy,
+};
+
+static tls_conn_t *make_conn(Server *srv) {
+    SockTransport *s = new SockTransport();
+    s->base.ops = &s_sock_ops;
+    s->fd = -1;
+    return tls_conn_create(&s->base, "127.0.0.1", srv->port, nullptr);
+}
+
+// ---------------------------------------------------------------------------
+// The client side of gemini_client's run_request_audio()
+
+static std::string make_wav() {
+    std::string wav(44 + CLIP_SAMPLES * 2, '\0');
+    uint8_t *p = (uint8_t *)&wav[0];
+    auto le16 = [](uint8_t *q, uint16_t v) { q[0] = v & 0xFF; q[1] = v >> 8; };
+    auto le32 = [](uint8_t *q, uint32_t v) { for (int i = 0; i < 4; i++) q[i] = (v >> (8 * i)) & 0xFF; };
+    memcpy(p, "RIFF", 4);
+    le32(p + 4, (uint32_t)wav.size() - 8);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    le32(p + 16, 16);
+    le16(p + 20, 1);
+    le16(p + 22, 1);
+    le32(p + 24, SAMPLE_RATE);
+    le32(p + 28, SAMPLE_RATE * 2);
+    le16(p + 32, 2);
+    le16(p + 34, 16);
+    memcpy(p + 36, "data", 4);
+    le32(p + 40, CLIP_SAMPLES * 2);
+    for (int i = 0; i < CLIP_SAMPLES; i++) {
+        int16_t s = (int16_t)lrint(7000 * sin(2 * M_PI * 220 * i / SAMPLE_RATE));
+        le16(p + 44 + 2 * i, (uint16_t)s);
+    }
+    return wav;
+}
+
+struct Exchange {
+    int status = 0;
+    bool reused = false;
+    bool parsed = false;
+    std::string text;               // The reply's text before it was split
+    std::string transcript;
+    std::string answer;
+    bool has_transcript = false;
+};
+
+static Exchange post_audio(tls_conn_t *conn, const conversation_t *history, const std::string &wav,
+                           voice_query_kind_t kind) {
+    Exchange ex;
+    request_writer_t body;
+    voice_query_body(&body, history, (const uint8_t *)wav.data(), wav.size(), kind);
+
+    http_request_t req = {};
+    req.method = "POST";
+    req.path = MODEL_PATH;
+    req.content_type = "application/json; charset=utf-8";
+    req.accept = "application/json";
+    req.body_fn = request_writer_read;
+    req.body_ctx = &body;
+    req.body_len = request_writer_size(&body);
+    req.timeout_ms = 5000;
+
+    std::vector<char> buf(MAX_ANSWER);
+    gemini_reply_t reply;
+    gemini_reply_init(&reply, buf.data(), buf.size());
+    http_session_t session;
+    ex.status = http_session_begin(&session, conn, &req);
+    ex.reused = session.reused;
+    if (ex.status > 0) {
+        char chunk[READ_CHUNK];
+        int n;
+        while ((n = http_session_read(&session, chunk, sizeof(chunk))) > 0) {
+            gemini_reply_feed(&reply, chunk, (size_t)n);
+        }
+    }
+    gemini_reply_finish(&reply);
+    http_session_end(&session);
+    if (ex.status != 200 || reply.parts == 0) return ex;
+
+    ex.text.assign(reply.text, reply.len);
+    const char *said, *answer;
+    ex.parsed = voice_query_parse(reply.text, &said, &answer);
+    if (ex.parsed) {
+        ex.answer = answer;
+        ex.has_transcript = said != nullptr;
+        if (said) ex.transcript = said;
+    }
+    return ex;
+}
+
+static std::string without_cr(std::string s) {
+    s.erase(std::remove(s.begin(), s.end(), '\r'), s.end());
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+
+static const char *TRANSCRIPT = "Thời tiết \"Hà Nội\" hôm nay thế nào? \\ 🌤";
+static const char *ANSWER = "Hôm nay Hà Nội nắng, khoảng 32°C.\r\nNhớ mang theo ô ☂️ nhé!\t😀";
+
+static conversation_t *make_history() {
+    conversation_t *c = conversation_create(NULL);
+    conversation_add(c, CONVERSATION_USER, "Xin chào, bạn là ai?");
+    conversation_add(c, CONVERSATION_MODEL, "Tôi là trợ lý \"Gemini\" trên ESP32-S3.");
+    conversation_add(c, CONVERSATION_USER, "Hôm qua trời mưa không?");
+    conversation_add(c, CONVERSATION_MODEL, "Có, chiều qua mưa rào.\nSáng nay đã tạnh.");
+    return c;
+}
+
+static void test_request(Server *srv, tls_conn_t *conn, const conversation_t *history, const std::string &wav) {
+    printf("Voice query with a response schema, chunked reply\n");
+    {
+        std::lock_guard<std::mutex> lock(srv->mu);
+        srv->answer = model_reply("{\"transcript\": " + json_string(TRANSCRIPT, true) +
+                                  ", \"answer\": " + json_string(ANSWER, false) + "}");
+    }
+    srv->reply = REPLY_CHUNKED;
+    Exchange ex = post_audio(conn, history, wav, VOICE_QUERY_SCHEMA);
+    Request req = last_request(srv);
+
+    request_writer_t w;
+    voice_query_body(&w, history, (const uint8_t *)wav.data(), wav.size(), VOICE_QUERY_SCHEMA);
+    std::string length = "\r\nContent-Length: " + std::to_string(req.body.size()) + "\r\n";
+    check("head: POST to the model path, JSON, Content-Length",
+          req.head.compare(0, strlen("POST " MODEL_PATH " HTTP/1.1\r\n"), "POST " MODEL_PATH " HTTP/1.1\r\n") == 0 &&
+              strcasestr(req.head.c_str(), "\r\nContent-Type: application/json; charset=utf-8\r\n") &&
+              strcasestr(req.head.c_str(), length.c_str()) && req.body.size() == request_writer_size(&w));
+
+    std::string prefix(conversation_prefix_size(history), '\0');
+    conversation_write_prefix(history, &prefix[0], prefix.size() + 1);
+    check("body starts with the conversation so far", req.body.compare(0, prefix.size(), prefix) == 0);
+
+    Json::Value root;
+    Json::CharReaderBuilder rb;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(rb.newCharReader());
+    bool json_ok = reader->parse(req.body.data(), req.body.data() + req.body.size(), &root, &errs);
+    const Json::Value &contents = root["contents"];
+    check("body parses; 4 earlier turns, then the user's",
+          json_ok && contents.isArray() && contents.size() == 5 && contents[4]["role"] == "user" &&
+              contents[3]["role"] == "model" &&
+              contents[3]["parts"][0]["text"] == "Có, chiều qua mưa rào.\nSáng nay đã tạnh.");
+    const Json::Value &parts = contents[4]["parts"];
+    check("turn: a prompt, then inline_data audio/wav",
+          parts.size() == 2 && parts[0]["text"].isString() && !parts[0]["text"].asString().empty() &&
+              parts[1]["inline_data"]["mime_type"] == "audio/wav");
+    char label[96];
+    snprintf(label, sizeof(label), "inline_data is the %zu byte WAV in base64, exactly", wav.size());
+    std::string b64 = base64(wav);
+    check(label, parts[1]["inline_data"]["data"].asString() == b64 &&
+                     req.body.find("\"data\":\"" + b64 + "\"") != std::string::npos);
+    const Json::Value &gen = root["generationConfig"];
+    check("schema: JSON reply, transcript and answer required",
+          gen["responseMimeType"] == "application/json" &&
+              gen["responseSchema"]["required"].size() == 2 &&
+              gen["responseSchema"]["required"][0] == "transcript" &&
+              gen["responseSchema"]["required"][1] == "answer" &&
+              gen["responseSchema"]["properties"]["answer"]["type"] == "STRING");
+
+    check("reply 200, schema text found", ex.status == 200 && ex.parsed);
+    check("transcript exact (\\u escapes, surrogate pair, quotes)",
+          ex.has_transcript && ex.transcript == TRANSCRIPT);
+    check("answer exact, '\\r' removed", ex.answer == without_cr(ANSWER));
+
+    printf("Content-Length reply on the same connection\n");
+    srv->reply = REPLY_LENGTH;
+    ex = post_audio(conn, history, wav, VOICE_QUERY_SCHEMA);
+    check("connection reused", ex.reused && srv->connections == 1);
+    check("transcript and answer exact", ex.parsed && ex.transcript == TRANSCRIPT &&
+                                             ex.answer == without_cr(ANSWER));
+
+    printf("Model text that is not the object\n");
+    {
+        std::lock_guard<std::mutex> lock(srv->mu);
+        srv->answer = model_reply("Trời nắng, {\"answer\": 1}");
+    }
+    ex = post_audio(conn, history, wav, VOICE_QUERY_SCHEMA);
+    check("not parsed, and left as it was", ex.status == 200 && !ex.parsed &&
+                                                ex.text == "Trời nắng, {\"answer\": 1}");
+    last_request(srv);
+}
+
+static void test_stream_body(Server *srv, tls_conn_t *conn, const conversation_t *history, const std::string &wav) {
+    printf("Streamed kind\n");
+    post_audio(conn, history, wav, VOICE_QUERY_STREAM);
+    Request req = last_request(srv);
+    Json::Value root;
+    Json::CharReaderBuilder rb;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(rb.newCharReader());
+    bool json_ok = reader->parse(req.body.data(), req.body.data() + req.body.size(), &root, &errs);
+    const Json::Value &parts = root["contents"][4]["parts"];
+    check("asks for a Q: line, same inline_data, no schema",
+          json_ok && parts[0]["text"].asString().find("Q:") != std::string::npos &&
+              parts[1]["inline_data"]["data"].asString() == base64(wav) &&
+              !root["generationConfig"].isMember("responseSchema"));
+}
+
+static bool parse(const std::string &text, std::string *said, std::string *answer, bool *has_said,
+                  std::string *after = nullptr) {
+    std::vector<char> buf(text.begin(), text.end());
+    buf.push_back('\0');
+    const char *t, *a;
+    bool ok = voice_query_parse(buf.data(), &t, &a);
+    *has_said = t != nullptr;
+    if (said) *said = t ? t : "";
+    if (answer) *answer = a ? a : "";
+    if (after) *after = buf.data();
+    return ok;
+}
+
+static void test_parse() {
+    printf("voice_query_parse\n");
+    std::string t, a, after;
+    bool has;
+
+    check("answer first, whitespace, other members and nested values",
+          parse(" \n{ \"answer\" : \"Có\", \"confidence\": 0.93, \"ok\": true, \"x\": null,\n"
+                "  \"alts\": [{\"t\": \"a}]\\\"\"}, [1, -2e3]], \"transcript\":\"Mưa?\" }\n",
+                &t, &a, &has) &&
+              has && t == "Mưa?" && a == "Có");
+    check("no transcript: answer only",
+          parse("{\"answer\": \"Chào bạn\"}", &t, &a, &has) && !has && a == "Chào bạn");
+    check("a later duplicate wins",
+          parse("{\"answer\": \"một\", \"transcript\": \"a\", \"answer\": \"hai\"}", &t, &a, &has) &&
+              a == "hai" && t == "a");
+    check("lone surrogates become U+FFFD, \\u0000 is dropped",
+          parse("{\"answer\": \"x\\ud83dy\\ude00z\\ud83d\\u0000w\\u00e0\"}", &t, &a, &has) &&
+              a == "x\xEF\xBF\xBDy\xEF\xBF\xBDz\xEF\xBF\xBDw\xC3\xA0");
+    check("every simple escape", parse("{\"answer\": \"\\\"\\\\\\/\\b\\f\\n\\r\\t\"}", &t, &a, &has) &&
+                                     a == "\"\\/\b\f\n\t");
+
+    const char *bad[] = {
+        "",
+        "Trời nắng",
+        "{}",
+        "{\"transcript\": \"chỉ có câu hỏi\"}",
+        "{\"answer\": 42}",
+        "{\"answer\": \"a\"} thêm",
+        "{\"answer\": \"cắt",
+        "{\"answer\": \"a\\x\"}",
+        "{\"answer\": \"a\\u12g4\"}",
+        "{\"answer\" \"a\"}",
+        "{\"answer\": \"a\" \"transcript\": \"b\"}",
+        "[\"answer\", \"a\"]",
+    };
+    bool all_refused = true, untouched = true;
+    for (const char *b : bad) {
+        if (parse(b, &t, &a, &has, &after)) all_refused = false;
+        if (after != b) untouched = false;
+    }
+    check("not the object: refused", all_refused);
+    check("and the text left as it was", untouched);
+}
+
+// ---------------------------------------------------------------------------
+// A streamed voice reply through stream_collector, in pieces
+
+struct Collected {
+    std::string transcript;
+    std::string pieces;             // What on_text was given
+    std::string answer;             // What stream_collector_finish() returned
+    int transcripts;
+    bool transcript_first;          // No text before the transcript
+};
+
+static void on_collected_transcript(void *ctx, const char *text) {
+    Collected *c = (Collected *)ctx;
+    c->transcript = text;
+    c->transcripts++;
+    c->transcript_first = c->pieces.empty();
+}
+
+static void on_collected_text(void *ctx, const char *text, size_t len) {
+    ((Collected *)ctx)->pieces.append(text, len);
+}
+
+// reply fed in pieces of step bytes (all at once for 0)
+static Collected collect(const std::string &reply, size_t step, bool voice = true,
+                         const volatile bool *cancel = NULL) {
+    Collected got = {};
+    stream_collector_t c;
+    stream_collector_init(&c, voice);
+    c.on_transcript = on_collected_transcript;
+    c.on_text = on_collected_text;
+    c.ctx = &got;
+    c.cancel = cancel;
+    if (step == 0) step = reply.size();
+    for (size_t i = 0; i < reply.size(); i += step) {
+        std::string piece = reply.substr(i, step);
+        stream_collector_feed(&c, piece.c_str(), piece.size());
+    }
+    char *answer = stream_collector_finish(&c);
+    if (answer) got.answer = answer;
+    free(answer);
+    return got;
+}
+
+static void test_collector() {
+    printf("stream_collector\n");
+    const std::string reply = "**Q:** Trời có mưa không?\r\n\nCó, chiều nay mưa to.\nNhớ mang ô.";
+    bool split_ok = true;
+    for (size_t step = 0; step <= 9; step++) {
+        Collected got = collect(reply, step);
+        split_ok = split_ok && got.transcripts == 1 && got.transcript_first &&
+                   got.transcript == "Trời có mưa không?" &&
+                   got.answer == "Có, chiều nay mưa to.\nNhớ mang ô." && got.pieces == got.answer;
+    }
+    check("transcript line, label dropped, then the answer; any split", split_ok);
+
+    Collected one = collect("Q: Mấy giờ rồi?", 4);
+    check("a labelled single line is the transcript alone",
+          one.transcripts == 1 && one.transcript == "Mấy giờ rồi?" && one.answer.empty());
+    Collected plain = collect("Bây giờ là ba giờ.", 5);
+    check("an unlabelled single line is the answer",
+          plain.transcripts == 0 && plain.answer == "Bây giờ là ba giờ." && plain.pieces == plain.answer);
+
+    std::string rambling(STREAM_COLLECTOR_TRANSCRIPT_MAX + 100, 'a');
+    bool long_ok = true;
+    for (size_t step : {(size_t)0, (size_t)7, (size_t)STREAM_COLLECTOR_TRANSCRIPT_MAX}) {
+        Collected got = collect(rambling + "\nb", step);
+        long_ok = long_ok && got.transcripts == 0 && got.answer == rambling + "\nb" && got.pieces == got.answer;
+    }
+    check("a first line too long for a transcript is all answer", long_ok);
+
+    Collected text = collect("\n  Xin chào", 3, false);
+    check("text query: no transcript, leading space dropped",
+          text.transcripts == 0 && text.answer == "Xin chào" && text.pieces == text.answer);
+
+    volatile bool cancel = true;
+    Collected off = collect(reply, 6, true, &cancel);
+    check("cancelled: kept, but nothing passed on",
+          off.transcripts == 0 && off.pieces.empty() && off.answer == "Có, chiều nay mưa to.\nNhớ mang ô.");
+    check("no text: no answer", collect("", 0).answer.empty() && collect("Q: x\n \n", 2).answer.empty());
+}
+
+int main() {
+    Server srv;
+    if (!server_start(&srv)) {
+        printf("Cannot start the stand-in server\n");
+        return 1;
+    }
+    tls_conn_t *conn = make_conn(&srv);
+    conversation_t *history = make_history();
+    std::string wav = make_wav();
+
+    test_request(&srv, conn, history, wav);
+    test_stream_body(&srv, conn, history, wav);
+    test_parse();
+    test_collector();
+
+    conversation_destroy(history);
+    tls_conn_destroy(conn);
+    server_stop(&srv);
+    if (s_failures) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}